@@ -32,6 +32,7 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <assert.h>
+#include <dps/err.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -82,6 +83,83 @@ void DPS_Log(DPS_LogLevel level, const char* file, int line, const char *functio
  */
 void DPS_LogBytes(DPS_LogLevel level, const char* file, int line, const char *function, const uint8_t *bytes, size_t n);
 
+/**
+ * Function prototype for a log sink
+ *
+ * @param level the logging level of the message
+ * @param msg the formatted message including the timestamp, location, and trailing newline
+ * @param len the length of the message, the message is not NUL terminated
+ * @param data the data passed to DPS_SetLogSink()
+ */
+typedef void (*DPS_LogSink)(DPS_LogLevel level, const char* msg, size_t len, void* data);
+
+/**
+ * Log sink that writes to a file
+ *
+ * @param level the logging level of the message
+ * @param msg the formatted message
+ * @param len the length of the message
+ * @param data the FILE to write to, NULL for stdout
+ */
+void DPS_LogFileSink(DPS_LogLevel level, const char* msg, size_t len, void* data);
+
+#ifndef _WIN32
+/**
+ * Log sink that writes to syslog
+ *
+ * @param level the logging level of the message, this is mapped to a syslog priority
+ * @param msg the formatted message
+ * @param len the length of the message
+ * @param data unused
+ */
+void DPS_LogSyslogSink(DPS_LogLevel level, const char* msg, size_t len, void* data);
+#endif
+
+/**
+ * Set where log messages are written. The default is stdout.
+ *
+ * A sink must not call DPS_Log() or DPS_LogBytes().
+ *
+ * @param sink the sink, NULL to restore the default
+ * @param data passed to the sink
+ */
+void DPS_SetLogSink(DPS_LogSink sink, void* data);
+
+/**
+ * Start asynchronous logging. Messages are formatted on the calling
+ * thread into a per-thread ring buffer and passed to the sink on a
+ * background thread, so logging does not take a lock or do any I/O on
+ * the calling thread. Messages are dropped if a thread's ring buffer is
+ * full. Messages from different threads may be written slightly out of
+ * order, the timestamps give the order they were logged.
+ *
+ * @return DPS_OK if asynchronous logging was started, an error otherwise
+ */
+DPS_Status DPS_StartAsyncLog(void);
+
+/**
+ * Stop asynchronous logging. Messages already logged are written before
+ * this returns and later messages are written synchronously.
+ */
+void DPS_StopAsyncLog(void);
+
+/**
+ * Limit the number of error, warning and debug messages each source
+ * file can log per second. Messages over the limit are dropped.
+ * DPS_PRINT and DPS_PRINTT messages are not limited.
+ *
+ * @param perSecond the maximum messages per second for each source file, 0 for no limit
+ */
+void DPS_SetLogRateLimit(uint32_t perSecond);
+
+/**
+ * Get the number of messages dropped because a ring buffer was full or
+ * the rate limit was exceeded
+ *
+ * @return the number of messages dropped
+ */
+uint64_t DPS_GetLogDropCount(void);
+
 /**
  * Log a message at ERROR level
  */
@@ -493,6 +493,26 @@ void* DPS_GetNodeData(const DPS_Node* node);
  */
 #define DPS_MCAST_PUB_ENABLE_RECV    2
 
+/**
+ * Specify an address for the node to listen on. A node listens on
+ * every transport built into the library; the transport is selected
+ * by the address, for example "tcp:[::]:5000" or "pipe:/tmp/dps".
+ * Transports without an address listen on an ephemeral address.
+ *
+ * This must be called before DPS_StartNode(). An address replaces any
+ * address previously specified for the same transport. The listen
+ * address passed to DPS_StartNode() takes precedence over both.
+ *
+ * @param node   The node
+ * @param addr   The address to listen on
+ *
+ * @return
+ * - DPS_OK if the address was set
+ * - DPS_ERR_NULL node or addr was null
+ * - DPS_ERR_INVALID the node has already been started
+ */
+DPS_Status DPS_SetNodeListenAddress(DPS_Node* node, const DPS_NodeAddress* addr);
+
 /**
  * Initialized and starts running a local node. Node can only be started once.
  *
@@ -541,6 +561,59 @@ DPS_Status DPS_DestroyNode(DPS_Node* node, DPS_OnNodeDestroyed cb, void* data);
  */
 void DPS_SetNodeSubscriptionUpdateDelay(DPS_Node* node, uint32_t subsRateMsecs);
 
+/**
+ * Publications sent over UDP or multicast that do not fit in a single
+ * datagram are sent as fragments. Specify if the node should request
+ * retransmission of missing fragments from the sender, and if the node
+ * should answer such requests for fragments it has sent. Both the sender
+ * and the receiver must enable this. This is off by default.
+ *
+ * @param node        The node
+ * @param retransmit  DPS_TRUE to request and answer retransmission of missing fragments
+ */
+void DPS_SetNodeFragmentRetransmit(DPS_Node* node, int retransmit);
+
+/**
+ * Specify how long acknowledgements are held so that acknowledgements
+ * of the same publication going to the same node can be sent as a
+ * single message. The aggregated acknowledgements are serialized and
+ * encrypted once and are delivered individually to the publication's
+ * acknowledgement handler. A delay of zero, the default, sends each
+ * acknowledgement immediately.
+ *
+ * @param node        The node
+ * @param delayMsecs  Time in milliseconds to hold acknowledgements
+ */
+void DPS_SetNodeAckAggregation(DPS_Node* node, uint32_t delayMsecs);
+
+/**
+ * Specify if the UDP transport should use io_uring for sending and
+ * receiving. This is on by default but only has an effect on Linux
+ * when the library is built with uring=yes. The libuv UDP path is used
+ * if the kernel does not support the io_uring features required.
+ *
+ * Must be called before DPS_StartNode().
+ *
+ * @param node    The node
+ * @param enable  DPS_FALSE to use the libuv UDP path
+ */
+void DPS_SetNodeIoUring(DPS_Node* node, int enable);
+
+/**
+ * Open connections to the nodes that acknowledgements for recently
+ * received publications would be sent to, so the first acknowledgement
+ * does not pay for connection setup. The connections are pooled and
+ * closed if they remain unused. This only has an effect on
+ * connection-oriented transports such as TCP.
+ *
+ * @param node    The node
+ *
+ * @return
+ * - DPS_OK if pre-warming was started
+ * - DPS_ERR_NOT_STARTED if the node is not running
+ */
+DPS_Status DPS_PrewarmConnections(DPS_Node* node);
+
 /**
  * Get the address this node is listening for connections on
  *
@@ -561,6 +634,18 @@ const DPS_NodeAddress* DPS_GetListenAddress(DPS_Node* node);
  */
 const char* DPS_GetListenAddressString(DPS_Node* node);
 
+/**
+ * Get the address this node is listening for connections on for a
+ * specific transport. The text of an address of a transport other
+ * than the default transport is prefixed with the transport name.
+ *
+ * @param node       The node
+ * @param transport  The transport name, for example "tcp"
+ *
+ * @return The address or NULL if the node is not listening on the transport
+ */
+const DPS_NodeAddress* DPS_GetTransportListenAddress(DPS_Node* node, const char* transport);
+
 /**
  * Function prototype for function called when a DPS_Link() completes.
  *
@@ -712,6 +797,40 @@ const DPS_KeyId* DPS_PublicationGetSenderKeyId(const DPS_Publication* pub);
  */
 DPS_Node* DPS_PublicationGetNode(const DPS_Publication* pub);
 
+/**
+ * Opaque type for the buffer holding the payload of a received
+ * publication or acknowledgement
+ */
+typedef struct _DPS_NetRxBuffer DPS_NetRxBuffer;
+
+/**
+ * Take a reference to the buffer holding the payload passed to a
+ * DPS_PublicationHandler or DPS_AcknowledgementHandler. This can only
+ * be called from inside the handler.
+ *
+ * The payload pointer passed to the handler remains valid after the
+ * handler returns until the reference is released by calling
+ * DPS_ReleasePayload(). This allows the payload to be processed on
+ * another thread without copying it. Decrypted payloads are retained
+ * the same way as unencrypted ones.
+ *
+ * @param pub   The publication passed to the handler
+ *
+ * @return The buffer or NULL if not called from inside a handler or if
+ *         the payload is not held in a buffer, in which case the payload
+ *         must be copied. The payload of an unencrypted publication sent
+ *         from the same node is not held in a buffer.
+ */
+DPS_NetRxBuffer* DPS_PublicationRetainPayload(const DPS_Publication* pub);
+
+/**
+ * Release a reference taken by DPS_PublicationRetainPayload(). This
+ * can be called from any thread.
+ *
+ * @param buf   The buffer, may be NULL
+ */
+void DPS_ReleasePayload(DPS_NetRxBuffer* buf);
+
 /**
  * Allocates storage for a publication
  *
@@ -808,6 +927,26 @@ DPS_Status DPS_PublicationAddSubId(DPS_Publication* pub, const DPS_KeyId* keyId)
  */
 void DPS_PublicationRemoveSubId(DPS_Publication* pub, const DPS_KeyId* keyId);
 
+/**
+ * Enable reliable delivery of a local publication. Each hop the
+ * publication is unicast to acknowledges the publications it has
+ * received and requests retransmission of any that are missing from
+ * the window. DPS_Publish() and DPS_PublishBufs() return DPS_ERR_BUSY
+ * while a hop has not acknowledged the oldest publication in the
+ * window.
+ *
+ * Multicast publications are not delivered reliably. Retained
+ * publications only deliver the latest revision so older revisions are
+ * not resent.
+ *
+ * @param pub     The publication
+ * @param window  The maximum number of unacknowledged publications, up
+ *                to 64, or zero to disable reliable delivery
+ *
+ * @return DPS_OK if the window was set, an error otherwise
+ */
+DPS_Status DPS_SetPublicationReliable(DPS_Publication* pub, uint16_t window);
+
 /**
  * Publish a set of topics along with an optional payload. The topics will be published immediately
  * to matching subscribers and then re-published whenever a new matching subscription is received.
@@ -77,6 +77,104 @@ DPS_Status DPS_JSON2CBOR(const char* json, uint8_t* cbor, size_t cborSize, size_
  */
 DPS_Status DPS_CBOR2JSON(const uint8_t* cbor, size_t cborLen, char* json, size_t jsonSize, int pretty);
 
+/**
+ * Opaque type for an incremental JSON to CBOR converter
+ */
+typedef struct _DPS_JSON2CBORStream DPS_JSON2CBORStream;
+
+/**
+ * Create an incremental JSON to CBOR converter.
+ *
+ * Arrays and maps are encoded with indefinite lengths so the CBOR can
+ * be generated before the end of the array or map has been seen.
+ * Empty arrays and maps are encoded with a definite length.
+ *
+ * @return The converter or NULL if there were insufficient resources
+ */
+DPS_JSON2CBORStream* DPS_CreateJSON2CBORStream(void);
+
+/**
+ * Destroy an incremental JSON to CBOR converter
+ *
+ * @param stream   The converter to destroy
+ */
+void DPS_DestroyJSON2CBORStream(DPS_JSON2CBORStream* stream);
+
+/**
+ * Convert a chunk of a JSON document to CBOR. The chunk does not need
+ * to end on a token boundary.
+ *
+ * If the cbor buffer fills up the function returns DPS_ERR_OVERFLOW
+ * and must be called again with the unused input.
+ *
+ * @param stream   The converter
+ * @param json     The next chunk of the JSON document, this does not need to be NUL terminated
+ * @param jsonLen  The length of the chunk
+ * @param last     TRUE if this is the last chunk of the document
+ * @param jsonUsed Returns the number of JSON characters consumed
+ * @param cbor     Destination buffer for the conversion
+ * @param cborSize The size of the cbor buffer
+ * @param cborLen  Returns the number of CBOR bytes written
+ *
+ * @return
+ *         - DPS_OK if the chunk was converted, or the document is complete if last is TRUE
+ *         - DPS_ERR_OVERFLOW if the cbor buffer was filled, call again to continue
+ *         - DPS_ERR_INVALID if the input was not valid JSON
+ *         - DPS_ERR_EOD if last is TRUE and the document is incomplete
+ *         - other error status codes
+ */
+DPS_Status DPS_JSON2CBORStreamConvert(DPS_JSON2CBORStream* stream, const char* json, size_t jsonLen, int last,
+                                      size_t* jsonUsed, uint8_t* cbor, size_t cborSize, size_t* cborLen);
+
+/**
+ * Opaque type for an incremental CBOR to JSON converter
+ */
+typedef struct _DPS_CBOR2JSONStream DPS_CBOR2JSONStream;
+
+/**
+ * Create an incremental CBOR to JSON converter.
+ *
+ * @param pretty   If TRUE format the JSON using indentation and newlines, if FALSE
+ *                 the output is compact with no newlines or whitespace is inserted.
+ *
+ * @return The converter or NULL if there were insufficient resources
+ */
+DPS_CBOR2JSONStream* DPS_CreateCBOR2JSONStream(int pretty);
+
+/**
+ * Destroy an incremental CBOR to JSON converter
+ *
+ * @param stream   The converter to destroy
+ */
+void DPS_DestroyCBOR2JSONStream(DPS_CBOR2JSONStream* stream);
+
+/**
+ * Convert a chunk of CBOR encoded data to JSON. The chunk does not need
+ * to end on a data item boundary. Definite and indefinite length arrays
+ * and maps are supported.
+ *
+ * If the json buffer fills up the function returns DPS_ERR_OVERFLOW
+ * and must be called again with the unused input.
+ *
+ * @param stream   The converter
+ * @param cbor     The next chunk of CBOR encoded data
+ * @param cborLen  The length of the chunk
+ * @param last     TRUE if this is the last chunk of the data
+ * @param cborUsed Returns the number of CBOR bytes consumed
+ * @param json     Destination buffer for the conversion, this is not NUL terminated
+ * @param jsonSize The size of the json buffer
+ * @param jsonLen  Returns the number of JSON characters written
+ *
+ * @return
+ *         - DPS_OK if the chunk was converted, or the data is complete if last is TRUE
+ *         - DPS_ERR_OVERFLOW if the json buffer was filled, call again to continue
+ *         - DPS_ERR_INVALID if the input was not valid CBOR
+ *         - DPS_ERR_EOD if last is TRUE and the data is incomplete
+ *         - other error status codes
+ */
+DPS_Status DPS_CBOR2JSONStreamConvert(DPS_CBOR2JSONStream* stream, const uint8_t* cbor, size_t cborLen, int last,
+                                      size_t* cborUsed, char* json, size_t jsonSize, size_t* jsonLen);
+
 /** @} */
 
 #ifdef __cplusplus
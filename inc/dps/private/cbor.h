@@ -65,6 +65,12 @@ extern "C" {
 #define CBOR_NULL   (CBOR_OTHER | 22)   /**< CBOR option flag for NULL value */
 #define CBOR_FLOAT  (CBOR_OTHER | 26)   /**< CBOR option flag for 32 bit float */
 #define CBOR_DOUBLE (CBOR_OTHER | 27)   /**< CBOR option flag for 64 bit float */
+#define CBOR_BREAK  (CBOR_OTHER | 31)   /**< CBOR stop code for indefinite length items */
+
+/**
+ * Additional information for an indefinite length array, map, or string
+ */
+#define CBOR_INDEFINITE 31
 
 /**
  * Maximum bytes needed to encode any length
@@ -629,7 +635,8 @@ DPS_Status DPS_ParseMapInit(CBOR_MapState* mapState, DPS_RxBuffer* buffer, const
  * decoded from the buffer.
  *
  * @param mapState  Map state struct
- * @param key       Returns the key that was matched
+ * @param key       Returns the key that was matched, or zero if the remaining
+ *                  entries were skipped without matching a key
  *
  * @return
  * - DPS_OK if the required key was matched
@@ -647,6 +654,137 @@ DPS_Status DPS_ParseMapNext(CBOR_MapState* mapState, int32_t* key);
  */
 int DPS_ParseMapDone(CBOR_MapState* mapState);
 
+/**
+ * Types of the values of the map fields described by CBOR_MapField
+ */
+typedef enum {
+    CBOR_FIELD_UINT8,   /**< uint8_t */
+    CBOR_FIELD_UINT16,  /**< uint16_t */
+    CBOR_FIELD_UINT32,  /**< uint32_t */
+    CBOR_FIELD_INT16,   /**< int16_t */
+    CBOR_FIELD_BOOLEAN, /**< int */
+    CBOR_FIELD_UUID,    /**< DPS_UUID */
+    CBOR_FIELD_BYTES,   /**< CBOR_Span, the contents of a byte string */
+    CBOR_FIELD_STRING,  /**< CBOR_Span, the contents of a text string */
+    CBOR_FIELD_RAW      /**< CBOR_Span, the complete encoded value */
+} CBOR_FieldType;
+
+/**
+ * The field is optional
+ */
+#define CBOR_FIELD_OPTIONAL  0x01
+
+/**
+ * The field is encoded with a fixed width so it can be patched in
+ * place, only applies to the CBOR_FIELD_UINT16 and CBOR_FIELD_INT16
+ * types
+ */
+#define CBOR_FIELD_FIXED     0x02
+
+/**
+ * Maximum number of fields in a map described by a CBOR_MapField table
+ */
+#define CBOR_MAP_FIELDS_MAX  32
+
+/**
+ * A span of bytes in an encoded buffer
+ */
+typedef struct {
+    uint8_t* data; /**< Start of the span */
+    size_t len;    /**< Length of the span */
+} CBOR_Span;
+
+/**
+ * Describes a field of a map with integer keys and the location of
+ * the field's value in a C struct. A table of these describes a
+ * fixed message layout that can be encoded or decoded in a single
+ * pass.
+ */
+typedef struct {
+    int32_t key;     /**< The map key */
+    uint8_t type;    /**< The value type, a CBOR_FieldType */
+    uint8_t flags;   /**< CBOR_FIELD_OPTIONAL and CBOR_FIELD_FIXED */
+    uint16_t offset; /**< Offset of the value in the struct */
+} CBOR_MapField;
+
+/**
+ * Initializer for a CBOR_MapField
+ *
+ * @param k  The map key
+ * @param t  The value type without the CBOR_FIELD_ prefix
+ * @param f  The field flags
+ * @param s  The struct type
+ * @param m  The struct member
+ */
+#define CBOR_MAP_FIELD(k, t, f, s, m)  { (k), CBOR_FIELD_##t, (f), (uint16_t)offsetof(s, m) }
+
+/**
+ * Decode a map into a struct in a single pass. The keys must be in
+ * ascending order in the fields array and in the map being parsed.
+ * Entries for keys that are not in the fields array are skipped.
+ *
+ * Decoded string and byte fields point into the buffer.
+ *
+ * @param buffer     Buffer to decode from
+ * @param fields     Array of fields to decode
+ * @param numFields  The number of fields, at most CBOR_MAP_FIELDS_MAX
+ * @param dest       The struct to decode the fields into
+ * @param found      Returns a bit mask of the fields that were decoded,
+ *                   bit i is set if fields[i] was decoded
+ *
+ * @return
+ * - DPS_OK if the map was decoded
+ * - DPS_ERR_MISSING if a field not flagged CBOR_FIELD_OPTIONAL was not found
+ * - other errors if the CBOR was invalid
+ */
+DPS_Status DPS_ParseMapFields(DPS_RxBuffer* buffer, const CBOR_MapField* fields, size_t numFields,
+                              void* dest, uint32_t* found);
+
+/**
+ * Calculate the encoded size of a map described by a fields array
+ *
+ * @param fields     Array of fields to encode
+ * @param numFields  The number of fields, at most CBOR_MAP_FIELDS_MAX
+ * @param src        The struct to encode the fields from
+ * @param present    Bit mask of the fields to encode, bit i selects fields[i]
+ *
+ * @return The encoded size in bytes
+ */
+size_t CBOR_SizeOfMapFields(const CBOR_MapField* fields, size_t numFields, const void* src, uint32_t present);
+
+/**
+ * Encode a map described by a fields array
+ *
+ * @param buffer     Buffer to append to
+ * @param fields     Array of fields to encode
+ * @param numFields  The number of fields, at most CBOR_MAP_FIELDS_MAX
+ * @param src        The struct to encode the fields from
+ * @param present    Bit mask of the fields to encode, bit i selects fields[i]
+ * @param pos        Optional array of numFields entries, returns where
+ *                   the value of each encoded field starts so fields
+ *                   flagged CBOR_FIELD_FIXED can be patched in place
+ *
+ * @return DPS_OK if the map was encoded, an error otherwise
+ */
+DPS_Status CBOR_EncodeMapFields(DPS_TxBuffer* buffer, const CBOR_MapField* fields, size_t numFields,
+                                const void* src, uint32_t present, uint8_t** pos);
+
+/**
+ * Patch a fixed width signed integer encoded with CBOR_FIELD_FIXED
+ *
+ * @param pos  Where the value starts
+ * @param n    The new value
+ */
+void CBOR_PatchInt16(uint8_t* pos, int16_t n);
+
+/**
+ * Patch a fixed width unsigned integer encoded with CBOR_FIELD_FIXED
+ *
+ * @param pos  Where the value starts
+ * @param n    The new value
+ */
+void CBOR_PatchUint16(uint8_t* pos, uint16_t n);
+
 #ifdef DPS_DEBUG
 /**
  * Print an encoded CBOR value
@@ -59,6 +59,14 @@ extern "C" {
 #define DPS_CBOR_KEY_DATA          12   /**< bstr */
 #define DPS_CBOR_KEY_ACK_SEQ_NUM   13   /**< uint */
 #define DPS_CBOR_KEY_PATH          14   /**< tstr */
+#define DPS_CBOR_KEY_BIT_LEN       15   /**< uint */
+#define DPS_CBOR_KEY_NUM_HASHES    16   /**< uint */
+#define DPS_CBOR_KEY_FRAG_NUM      17   /**< uint */
+#define DPS_CBOR_KEY_NUM_FRAGS     18   /**< uint */
+#define DPS_CBOR_KEY_MSG_LEN       19   /**< uint */
+#define DPS_CBOR_KEY_MISSING       20   /**< bstr */
+#define DPS_CBOR_KEY_ACKS          21   /**< array */
+#define DPS_CBOR_KEY_WINDOW        22   /**< uint */
 
 /**
  * Convert seconds to milliseconds
@@ -66,9 +74,14 @@ extern "C" {
 #define DPS_SECS_TO_MS(t)   ((uint64_t)(t) * 1000ull)
 
 /**
- * Maximum length of address text is of the form: "[IPv6%IFNAME]:PORT"
+ * Maximum length of the transport name prefix of address text, for example "dtls:"
  */
-#define DPS_NODE_ADDRESS_MAX_STRING_LEN (1 + INET6_ADDRSTRLEN + 1 + UV_IF_NAMESIZE + 2 + 8)
+#define DPS_TRANSPORT_PREFIX_MAX_LEN 5
+
+/**
+ * Maximum length of address text is of the form: "transport:[IPv6%IFNAME]:PORT"
+ */
+#define DPS_NODE_ADDRESS_MAX_STRING_LEN (DPS_TRANSPORT_PREFIX_MAX_LEN + 1 + INET6_ADDRSTRLEN + 1 + UV_IF_NAMESIZE + 2 + 8)
 
 /**
  * Address types
@@ -81,6 +94,7 @@ typedef enum {
     DPS_TCP,                    /**< TCP */
     DPS_UDP,                    /**< UDP */
     DPS_PIPE,                   /**< Named pipe */
+    DPS_SHM,                    /**< Shared memory */
 } DPS_NodeAddressType;
 
 #ifdef _WIN32
@@ -232,6 +246,50 @@ void DPS_RxBufferToTx(const DPS_RxBuffer* rxBuffer, DPS_TxBuffer* txBuffer);
  */
 void DPS_DumpSubscriptions(DPS_Node* node);
 
+/**
+ * Load factor of a series of interests bit vectors
+ */
+typedef struct _DPS_LoadFactorStats {
+    float current;     /**< Load factor of the most recent sample */
+    float peak;        /**< Highest load factor sampled */
+    float mean;        /**< Mean of the load factors sampled */
+    uint32_t samples;  /**< Number of samples */
+} DPS_LoadFactorStats;
+
+/**
+ * Counters for tuning the Bloom filter configuration.
+ *
+ * Publications are routed on Bloom filter inclusion alone, so a
+ * publication can be sent to a node where it matches the Bloom filter
+ * of a subscription but none of the subscription topic strings. These
+ * false positives waste bandwidth and can be reduced by configuring a
+ * longer bit length or a different number of hashes with
+ * DPS_Configure(). The load factors are the percentage of bits set in
+ * the interests, sampled each time the interests received from or sent
+ * to a remote node change.
+ */
+typedef struct _DPS_BloomStats {
+    uint64_t pubsReceived;         /**< Publications received, not counting duplicates */
+    uint64_t bloomMatches;         /**< Publications that matched the Bloom filter of a subscription */
+    uint64_t falsePositives;       /**< Publications that matched a Bloom filter but no subscription topics */
+    DPS_LoadFactorStats inbound;   /**< Load factor of interests received */
+    DPS_LoadFactorStats outbound;  /**< Load factor of interests sent */
+} DPS_BloomStats;
+
+/**
+ * Get the Bloom filter counters of a node or of one of its links.
+ * The node counters include publications received from multicast
+ * publishers, and the node load factors combine the samples of all
+ * of the links.
+ *
+ * @param node   The node
+ * @param addr   The address of a remote node or NULL for the node counters
+ * @param stats  Returns the counters
+ *
+ * @return DPS_OK or DPS_ERR_MISSING if there is no remote node with the address
+ */
+DPS_Status DPS_GetBloomStats(DPS_Node* node, const DPS_NodeAddress* addr, DPS_BloomStats* stats);
+
 /**
  * Copy a DPS_KeyId
  *
@@ -293,9 +351,6 @@ uint32_t DPS_Rand(void);
  */
 int DPS_PublicationIsEncrypted(const DPS_Publication* pub);
 
-/** @copydoc DPS_NetRxBuffer */
-typedef struct _DPS_NetRxBuffer DPS_NetRxBuffer;
-
 /**
  * Inside a DPS_PublicationHandler, call this to receive the
  * underlying buffer that the payload is in.
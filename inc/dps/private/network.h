@@ -39,11 +39,21 @@ extern "C" {
 #define DPS_MAX_HOST_LEN    256  /**< Per RFC 1034/1035 */
 #define DPS_MAX_SERVICE_LEN  16  /**< Per RFC 6335 section 5.1 */
 
+/**
+ * Maximum number of transports a node can listen on
+ */
+#define DPS_MAX_TRANSPORTS 5
+
 /**
  * Opaque data structure for network-specific state
  */
 typedef struct _DPS_NetContext DPS_NetContext;
 
+/**
+ * Opaque data structure for the state of a single transport
+ */
+typedef struct _DPS_NetTransportContext DPS_NetTransportContext;
+
 /**
  * Opaque type for managing connection state for connection-oriented transports
  */
@@ -259,18 +269,20 @@ DPS_Status DPS_MulticastSend(DPS_MulticastSender* sender, void* appCtx, uv_buf_t
                              DPS_MulticastSendComplete sendCompleteCB);
 
 /**
- * Start listening and receiving data
+ * Start listening and receiving data on all transports
  *
- * @param node  Opaque pointer to the DPS node
- * @param addr  If non-NULL the address to listen on, if NULL use an ephemeral address
- * @param cb    Function to call when data is received
+ * @param node      Opaque pointer to the DPS node
+ * @param addrs     The addresses to listen on, a transport with no address
+ *                  listens on an ephemeral address
+ * @param numAddrs  The number of addresses
+ * @param cb        Function to call when data is received
  *
  * @return   Returns a pointer to an opaque data structure that holds the state of the netCtx.
  */
-DPS_NetContext* DPS_NetStart(DPS_Node* node, const DPS_NodeAddress* addr, DPS_OnReceive cb);
+DPS_NetContext* DPS_NetStart(DPS_Node* node, const DPS_NodeAddress* addrs, size_t numAddrs, DPS_OnReceive cb);
 
 /**
- * Get the address the netCtx is listening on
+ * Get the address the default transport is listening on
  *
  * @param addr    The address to set
  * @param netCtx  Pointer to an opaque data structure that holds the state of the netCtx.
@@ -279,6 +291,18 @@ DPS_NetContext* DPS_NetStart(DPS_Node* node, const DPS_NodeAddress* addr, DPS_On
  */
 DPS_NodeAddress* DPS_NetGetListenAddress(DPS_NodeAddress* addr, DPS_NetContext* netCtx);
 
+/**
+ * Get the addresses all transports are listening on. The address of
+ * the default transport is first.
+ *
+ * @param addrs     The addresses to set
+ * @param maxAddrs  The number of entries in addrs
+ * @param netCtx    Pointer to an opaque data structure that holds the state of the netCtx.
+ *
+ * @return The number of addresses set
+ */
+size_t DPS_NetGetListenAddresses(DPS_NodeAddress* addrs, size_t maxAddrs, DPS_NetContext* netCtx);
+
 /**
  * Stop listening for data
  *
@@ -322,6 +346,22 @@ typedef void (*DPS_NetSendComplete)(DPS_Node* node, void* appCtx, DPS_NetEndpoin
 DPS_Status DPS_NetSend(DPS_Node* node, void* appCtx, DPS_NetEndpoint* endpoint,
                        uv_buf_t* bufs, size_t numBufs, DPS_NetSendComplete sendCompleteCB);
 
+/**
+ * Open a connection to an address ahead of the first send so the send
+ * does not wait for the connection to be established. The connection
+ * is kept idle until a send to the same address uses it. This is only
+ * meaningful for transports that pool connections.
+ *
+ * Must be called on the node's loop thread.
+ *
+ * @param node  The local node
+ * @param addr  The address to connect to
+ *
+ * @return DPS_OK if a connection is being opened or is not needed,
+ *         DPS_ERR_EXISTS if there is already an idle connection
+ */
+DPS_Status DPS_NetPrewarm(DPS_Node* node, const DPS_NodeAddress* addr);
+
 /**
  * Increment the reference count to potentially keeping a underlying connection alive. This is only
  * meaningful for connection-oriented transports.
@@ -338,6 +378,133 @@ void DPS_NetConnectionIncRef(DPS_NetConnection* cn);
  */
 void DPS_NetConnectionDecRef(DPS_NetConnection* cn);
 
+/**
+ * A transport driver. Each transport implements these functions and
+ * the node network layer dispatches to them.
+ *
+ * Connection-oriented transports must declare a pointer to their
+ * driver as the first member of their DPS_NetConnection so the
+ * connection functions can be dispatched from the connection alone.
+ */
+typedef struct _DPS_NetTransport {
+    const char* name;          /**< Name used as an address prefix, for example "tcp" */
+    DPS_NodeAddressType type;  /**< The address type handled by this transport */
+    /**
+     * Start listening and receiving data, see DPS_NetStart()
+     */
+    DPS_NetTransportContext* (*start)(DPS_Node* node, const DPS_NodeAddress* addr, DPS_OnReceive cb);
+    /**
+     * Get the address the transport is listening on, see DPS_NetGetListenAddress()
+     */
+    DPS_NodeAddress* (*getListenAddress)(DPS_NodeAddress* addr, DPS_NetTransportContext* netCtx);
+    /**
+     * Stop listening for data, see DPS_NetStop()
+     */
+    void (*stop)(DPS_NetTransportContext* netCtx);
+    /**
+     * Send data to a specific endpoint, see DPS_NetSend()
+     */
+    DPS_Status (*send)(DPS_NetTransportContext* netCtx, void* appCtx, DPS_NetEndpoint* endpoint,
+                       uv_buf_t* bufs, size_t numBufs, DPS_NetSendComplete sendCompleteCB);
+    /**
+     * Increment the reference count on a connection, see DPS_NetConnectionIncRef()
+     */
+    void (*connectionIncRef)(DPS_NetConnection* cn);
+    /**
+     * Decrement the reference count on a connection, see DPS_NetConnectionDecRef()
+     */
+    void (*connectionDecRef)(DPS_NetConnection* cn);
+    /**
+     * Open a connection that is kept idle until it is used, see
+     * DPS_NetPrewarm(). NULL for transports that do not pool
+     * connections.
+     */
+    DPS_Status (*prewarm)(DPS_NetTransportContext* netCtx, const DPS_NodeAddress* addr);
+} DPS_NetTransport;
+
+extern const DPS_NetTransport DPS_DtlsTransport;   /**< DTLS transport driver */
+extern const DPS_NetTransport DPS_TcpTransport;    /**< TCP transport driver */
+extern const DPS_NetTransport DPS_UdpTransport;    /**< UDP transport driver */
+extern const DPS_NetTransport DPS_UringTransport;  /**< UDP transport driver using io_uring */
+extern const DPS_NetTransport DPS_PipeTransport;   /**< Named pipe transport driver */
+extern const DPS_NetTransport DPS_ShmTransport;    /**< Shared memory transport driver */
+extern const DPS_NetTransport DPS_FuzzerTransport; /**< Fuzzer transport driver */
+extern const DPS_NetTransport DPS_SimTransport;    /**< In-process network simulator driver */
+
+/**
+ * Get the state of a single transport
+ *
+ * @param netCtx     Pointer to an opaque data structure that holds the network state.
+ * @param transport  The transport driver
+ *
+ * @return The transport state or NULL if the transport is not running
+ */
+DPS_NetTransportContext* DPS_NetGetTransportContext(DPS_NetContext* netCtx, const DPS_NetTransport* transport);
+
+/**
+ * Get the name of the transport for an address type if addresses of
+ * this type must be qualified with the transport name. Addresses of
+ * the default transport are never qualified.
+ *
+ * @param type  The address type
+ *
+ * @return The transport name or NULL
+ */
+const char* DPS_NetTransportPrefix(DPS_NodeAddressType type);
+
+/**
+ * Parse an optional transport name prefix, for example "tcp:", from
+ * the text of an address
+ *
+ * @param addrText  The address text
+ * @param type      Returns the address type named by the prefix or the
+ *                  address type of the default transport
+ *
+ * @return The address text following the prefix or NULL if the prefix
+ *         names a transport that is not available
+ */
+const char* DPS_NetParseTransportPrefix(const char* addrText, DPS_NodeAddressType* type);
+
+/**
+ * Get the address type of the default transport. This is the type of
+ * addresses without a transport name prefix and of the listening
+ * address carried in multicast publications.
+ *
+ * @return The address type of the default transport
+ */
+DPS_NodeAddressType DPS_NetDefaultType(void);
+
+/**
+ * Get the address type of a transport from the transport name
+ *
+ * @param name  The transport name, for example "tcp"
+ *
+ * @return The address type or DPS_UNKNOWN if the transport is not available
+ */
+DPS_NodeAddressType DPS_NetTransportType(const char* name);
+
+/**
+ * Traffic counters for one transport of a node
+ */
+typedef struct _DPS_NetStats {
+    const char* transport;  /**< The transport name, for example "tcp" */
+    uint64_t msgsSent;      /**< Number of messages accepted by the transport for sending */
+    uint64_t bytesSent;     /**< Number of bytes in those messages, not counting transport framing */
+} DPS_NetStats;
+
+/**
+ * Get the traffic counters for each transport of a node. The counters
+ * are updated on the node's thread so they are only exact while the
+ * node is idle.
+ *
+ * @param netCtx    Pointer to an opaque data structure that holds the network state.
+ * @param stats     Returns the counters for each transport
+ * @param maxStats  The number of entries in stats
+ *
+ * @return The number of entries returned
+ */
+size_t DPS_NetGetStats(DPS_NetContext* netCtx, DPS_NetStats* stats, size_t maxStats);
+
 /**
  * Compare two addresses. This comparison handles the case of ipv6 mapped ipv4 address
  *
@@ -0,0 +1,144 @@
+/**
+ * @file
+ * Control of the in-process network simulator
+ */
+
+/*
+ *******************************************************************
+ *
+ * Copyright 2016 Intel Corporation All rights reserved.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ */
+
+#ifndef _SIM_H
+#define _SIM_H
+
+#include <stdint.h>
+#include <dps/err.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * The simulator replaces the network with an in-process model of
+ * point-to-point links when the library is built with the sim
+ * transport. Every node in the process listens on a simulated port
+ * of "[::1]" and messages between nodes are delivered according to
+ * the model of the link between the two ports.
+ *
+ * Delivery is ordered by a virtual clock. While nodes are busy the
+ * clock runs with real time, so node timers such as retransmissions,
+ * which still run in real time, see the modeled delays. When the
+ * simulation is quiescent, meaning every delivered message has been
+ * processed and no node has sent anything for the quiet period, the
+ * clock skips ahead to the next delivery. Idle time on slow links
+ * therefore costs no real time, and deliveries that follow quiescence
+ * do not depend on thread scheduling.
+ */
+
+/**
+ * Number of message counters, indexed by the DPS message type. Index 0
+ * counts messages that are not DPS requests.
+ */
+#define DPS_SIM_MSG_TYPES 8
+
+/**
+ * The model of a directed link between two nodes
+ */
+typedef struct _DPS_SimLink {
+    uint32_t latency;    /**< Propagation delay in usecs */
+    uint32_t jitter;     /**< Maximum random delay added to the latency in usecs */
+    uint32_t loss;       /**< Probability a message is lost in parts per million */
+    uint32_t bandwidth;  /**< Link bandwidth in kbits per second, 0 for unlimited */
+} DPS_SimLink;
+
+/**
+ * Message counters of a single node or of the whole simulation
+ */
+typedef struct _DPS_SimStats {
+    uint64_t sent[DPS_SIM_MSG_TYPES];           /**< Messages sent */
+    uint64_t sentBytes[DPS_SIM_MSG_TYPES];      /**< Bytes sent */
+    uint64_t received[DPS_SIM_MSG_TYPES];       /**< Messages delivered */
+    uint64_t receivedBytes[DPS_SIM_MSG_TYPES];  /**< Bytes delivered */
+    uint64_t lost;                              /**< Messages lost on a link */
+    uint64_t undeliverable;                     /**< Messages sent to a port no node is listening on */
+} DPS_SimStats;
+
+/**
+ * Configure the simulator. This must be called before any node is
+ * started.
+ *
+ * @param seed      Seed for the per-link loss and jitter
+ * @param link      The model applied to links without a model of their own,
+ *                  NULL for links without delay or loss
+ * @param quiet     Real time in usecs without any network activity after
+ *                  which the simulation is considered quiescent
+ * @param speed     Virtual usecs that pass per real usec while the simulation
+ *                  is not quiescent, 0 for the default of 1
+ *
+ * @return DPS_OK or DPS_ERR_INVALID if a node has already been started
+ */
+DPS_Status DPS_SimConfigure(uint64_t seed, const DPS_SimLink* link, uint32_t quiet, uint32_t speed);
+
+/**
+ * Set the model of the links in both directions between two ports.
+ *
+ * @param port1  The port of one node
+ * @param port2  The port of the other node
+ * @param link   The link model
+ *
+ * @return DPS_OK or DPS_ERR_RESOURCES
+ */
+DPS_Status DPS_SimSetLink(uint16_t port1, uint16_t port2, const DPS_SimLink* link);
+
+/**
+ * Get the current virtual time
+ *
+ * @return The virtual time in usecs since the simulator was configured
+ */
+uint64_t DPS_SimNow(void);
+
+/**
+ * Wait until no messages are in flight and nothing has been sent for
+ * the settle time. The settle time should be longer than the
+ * subscription update delay of the nodes so updates held back by a
+ * node timer are not missed.
+ *
+ * @param settle   Real time in msecs without any network activity
+ * @param timeout  Maximum real time to wait in msecs
+ *
+ * @return DPS_OK or DPS_ERR_TIMEOUT
+ */
+DPS_Status DPS_SimWaitIdle(uint32_t settle, uint32_t timeout);
+
+/**
+ * Get the message counters
+ *
+ * @param port   The port of a node or 0 for the whole simulation
+ * @param stats  Returns the counters
+ *
+ * @return DPS_OK or DPS_ERR_MISSING if no node is listening on the port
+ */
+DPS_Status DPS_SimGetStats(uint16_t port, DPS_SimStats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
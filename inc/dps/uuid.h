@@ -62,6 +62,9 @@ DPS_Status DPS_InitUUID(void);
 /**
  * Non secure generation of a random UUID.
  *
+ * This is safe to call from multiple threads and does not take a lock.
+ * UUIDs generated in the same process are always distinct.
+ *
  * @param uuid The generated UUID.
  */
 void DPS_GenerateUUID(DPS_UUID* uuid);
@@ -43,6 +43,32 @@
  */
 DPS_DEBUG_CONTROL(DPS_DEBUG_ON);
 
+/*
+ * Maximum number of acknowledgements aggregated into one message
+ */
+#define MAX_AGGREGATED_ACKS 64
+
+#ifdef DPS_DEBUG
+int _DPS_NumAckMsgs = 0;
+int _DPS_NumAggregatedAckMsgs = 0;
+#endif
+
+/*
+ * Layout of the protected map of an acknowledgement
+ */
+typedef struct {
+    DPS_UUID pubId;
+    uint32_t sequenceNum;
+} AckProtected;
+
+static const CBOR_MapField AckProtectedFields[] = {
+    CBOR_MAP_FIELD(DPS_CBOR_KEY_PUB_ID, UUID, 0, AckProtected, pubId),
+    CBOR_MAP_FIELD(DPS_CBOR_KEY_ACK_SEQ_NUM, UINT32, 0, AckProtected, sequenceNum)
+};
+
+static void AckPublicationComplete(DPS_Publication* pub, const DPS_Buffer* bufs, size_t numBufs,
+                                   DPS_Status status, void* data);
+
 static PublicationAck* CreateAck(const DPS_Publication* pub, size_t numBufs,
                                  DPS_AckPublicationBufsComplete cb, void* data)
 {
@@ -64,9 +90,33 @@ static PublicationAck* CreateAck(const DPS_Publication* pub, size_t numBufs,
     ack->completeCB = cb;
     ack->data = data;
     ack->numBufs = numBufs;
+    DPS_QueueInit(&ack->aggregated);
     return ack;
 }
 
+static size_t GetPayloadBufs(const PublicationAck* ack, DPS_Buffer* bufs)
+{
+    size_t numBufs = ack->numBufs - NUM_INTERNAL_ACK_BUFS;
+    size_t i;
+
+    for (i = 0; i < numBufs; ++i) {
+        bufs[i].base = ack->bufs[i + 3].base;
+        bufs[i].len = DPS_TxBufferUsed(&ack->bufs[i + 3]);
+    }
+    return numBufs;
+}
+
+static void SetPayloadBufs(PublicationAck* ack, const DPS_Buffer* bufs, size_t numBufs)
+{
+    size_t i;
+
+    for (i = 0; i < numBufs; ++i) {
+        ack->bufs[i + 3].base = bufs[i].base;
+        ack->bufs[i + 3].eob = bufs[i].base + bufs[i].len;
+        ack->bufs[i + 3].txPos = ack->bufs[i + 3].eob;
+    }
+}
+
 static void DestroyAck(PublicationAck* ack)
 {
     if (ack) {
@@ -85,17 +135,20 @@ static void DestroyAck(PublicationAck* ack)
 void DPS_AckPublicationCompletion(PublicationAck* ack)
 {
     DPS_Buffer bufs[DPS_BUFS_MAX];
-    size_t numBufs = 0;
-    size_t i;
+    PublicationAck* aggregated;
+    size_t numBufs;
 
+    /*
+     * Complete the acknowledgements that were sent as part of this one
+     */
+    while (!DPS_QueueEmpty(&ack->aggregated)) {
+        aggregated = (PublicationAck*)DPS_QueueFront(&ack->aggregated);
+        DPS_QueueRemove(&aggregated->queue);
+        aggregated->status = ack->status;
+        DPS_AckPublicationCompletion(aggregated);
+    }
     if (ack->completeCB) {
-        if (ack->numBufs > NUM_INTERNAL_ACK_BUFS) {
-            numBufs = ack->numBufs - NUM_INTERNAL_ACK_BUFS;
-            for (i = 0; i < numBufs; ++i) {
-                bufs[i].base = ack->bufs[i + 3].base;
-                bufs[i].len = DPS_TxBufferUsed(&ack->bufs[i + 3]);
-            }
-        }
+        numBufs = GetPayloadBufs(ack, bufs);
         ack->completeCB(ack->pub, numBufs ? bufs : NULL, numBufs, ack->status, ack->data);
     }
     DestroyAck(ack);
@@ -237,16 +290,24 @@ static DPS_Status SerializeAck(const DPS_Publication* pub, PublicationAck* ack,
     if (ret == DPS_OK) {
         ret = CBOR_EncodeMap(&ack->bufs[2], 1);
     }
-    if (ret == DPS_OK) {
-        ret = CBOR_EncodeUint8(&ack->bufs[2], DPS_CBOR_KEY_DATA);
+    if (DPS_QueueEmpty(&ack->aggregated)) {
+        if (ret == DPS_OK) {
+            ret = CBOR_EncodeUint8(&ack->bufs[2], DPS_CBOR_KEY_DATA);
+        }
+        if (ret == DPS_OK) {
+            ret = CBOR_EncodeLength(&ack->bufs[2], dataLen, CBOR_BYTES);
+        }
+    } else {
+        /*
+         * The payload of an aggregated ack is the already encoded
+         * array of acks
+         */
+        if (ret == DPS_OK) {
+            ret = CBOR_EncodeUint8(&ack->bufs[2], DPS_CBOR_KEY_ACKS);
+        }
     }
     if (ret == DPS_OK) {
-        ret = CBOR_EncodeLength(&ack->bufs[2], dataLen, CBOR_BYTES);
-    }
-    for (i = 0; (ret == DPS_OK) && (i < numBufs); ++i) {
-        ack->bufs[i + 3].base = bufs[i].base;
-        ack->bufs[i + 3].eob = bufs[i].base + bufs[i].len;
-        ack->bufs[i + 3].txPos = ack->bufs[i + 3].eob;
+        SetPayloadBufs(ack, bufs, numBufs);
     }
     DPS_TxBufferClear(&ack->bufs[ack->numBufs - 1]);
     if (ret != DPS_OK) {
@@ -277,6 +338,139 @@ static DPS_Status SerializeAck(const DPS_Publication* pub, PublicationAck* ack,
     return ret;
 }
 
+static DPS_Status SerializeAggregatedAck(PublicationAck* ack, size_t numAcks)
+{
+    DPS_Buffer bufs[DPS_BUFS_MAX];
+    PublicationAck* aggregated;
+    DPS_TxBuffer payload;
+    DPS_Buffer buf;
+    DPS_Queue* q;
+    DPS_Status ret;
+    size_t numBufs;
+    size_t dataLen;
+    size_t len;
+    size_t i;
+
+    DPS_DBGTRACE();
+
+    /*
+     * The acks are encoded into a single payload so the aggregated
+     * ack is only encrypted once
+     */
+    len = CBOR_SIZEOF_ARRAY(numAcks);
+    for (q = DPS_QueueFront(&ack->aggregated); q != &ack->aggregated; q = q->next) {
+        aggregated = (PublicationAck*)q;
+        numBufs = GetPayloadBufs(aggregated, bufs);
+        dataLen = 0;
+        for (i = 0; i < numBufs; ++i) {
+            dataLen += bufs[i].len;
+        }
+        len += CBOR_SIZEOF_ARRAY(2) + CBOR_SIZEOF(uint32_t) + CBOR_SIZEOF_LEN(dataLen) + dataLen;
+    }
+    ret = DPS_TxBufferInit(&payload, NULL, len);
+    if (ret != DPS_OK) {
+        return ret;
+    }
+    /*
+     * The payload belongs to the aggregated ack from here on
+     */
+    buf.base = payload.base;
+    buf.len = len;
+    SetPayloadBufs(ack, &buf, 1);
+    ret = CBOR_EncodeArray(&payload, numAcks);
+    for (q = DPS_QueueFront(&ack->aggregated); (ret == DPS_OK) && (q != &ack->aggregated); q = q->next) {
+        aggregated = (PublicationAck*)q;
+        numBufs = GetPayloadBufs(aggregated, bufs);
+        dataLen = 0;
+        for (i = 0; i < numBufs; ++i) {
+            dataLen += bufs[i].len;
+        }
+        ret = CBOR_EncodeArray(&payload, 2);
+        if (ret == DPS_OK) {
+            ret = CBOR_EncodeUint32(&payload, aggregated->sequenceNum);
+        }
+        if (ret == DPS_OK) {
+            ret = CBOR_EncodeLength(&payload, dataLen, CBOR_BYTES);
+        }
+        for (i = 0; (ret == DPS_OK) && (i < numBufs); ++i) {
+            ret = CBOR_Copy(&payload, bufs[i].base, bufs[i].len);
+        }
+    }
+    if (ret == DPS_OK) {
+        buf.len = DPS_TxBufferUsed(&payload);
+        ret = SerializeAck(ack->pub, ack, &buf, 1);
+    }
+    return ret;
+}
+
+void DPS_AggregateAcks(DPS_Node* node)
+{
+    DPS_Buffer bufs[DPS_BUFS_MAX];
+    PublicationAck* aggregated;
+    PublicationAck* ack;
+    DPS_Queue* next;
+    DPS_Queue* q;
+    DPS_Status ret;
+    size_t numAcks;
+    size_t numBufs;
+
+    DPS_DBGTRACE();
+
+    while (!DPS_QueueEmpty(&node->pendingAckQueue)) {
+        aggregated = (PublicationAck*)DPS_QueueFront(&node->pendingAckQueue);
+        ack = CreateAck(aggregated->pub, 1, AckPublicationComplete, NULL);
+        if (!ack) {
+            DPS_QueueRemove(&aggregated->queue);
+            aggregated->status = DPS_ERR_RESOURCES;
+            DPS_AckPublicationCompletion(aggregated);
+            continue;
+        }
+        ack->destAddr = aggregated->destAddr;
+        ack->sequenceNum = 0;
+        /*
+         * Gather the pending acks for the same publication going to
+         * the same destination
+         */
+        numAcks = 0;
+        q = DPS_QueueFront(&node->pendingAckQueue);
+        while ((q != &node->pendingAckQueue) && (numAcks < MAX_AGGREGATED_ACKS)) {
+            next = q->next;
+            aggregated = (PublicationAck*)q;
+            if ((DPS_UUIDCompare(&aggregated->pub->pubId, &ack->pub->pubId) == 0) &&
+                DPS_SameAddr(&aggregated->destAddr, &ack->destAddr)) {
+                DPS_QueueRemove(&aggregated->queue);
+                DPS_QueuePushBack(&ack->aggregated, &aggregated->queue);
+                if (aggregated->sequenceNum > ack->sequenceNum) {
+                    ack->sequenceNum = aggregated->sequenceNum;
+                }
+                ++numAcks;
+            }
+            q = next;
+        }
+        if (numAcks == 1) {
+            /*
+             * Nothing to aggregate so send the ack as is
+             */
+            aggregated = (PublicationAck*)DPS_QueueFront(&ack->aggregated);
+            DPS_QueueRemove(&aggregated->queue);
+            DestroyAck(ack);
+            ack = aggregated;
+            numBufs = GetPayloadBufs(ack, bufs);
+            ret = SerializeAck(ack->pub, ack, bufs, numBufs);
+        } else {
+            DPS_DBGPRINT("Aggregated %d acknowledgements for %s to %s\n", (int)numAcks,
+                         DPS_UUIDToString(&ack->pub->pubId), DPS_NodeAddrToString(&ack->destAddr));
+            ret = SerializeAggregatedAck(ack, numAcks);
+        }
+        if (ret == DPS_OK) {
+            DPS_QueuePushBack(&node->ackQueue, &ack->queue);
+        } else {
+            ack->status = ret;
+            DPS_AckPublicationCompletion(ack);
+        }
+    }
+}
+
 static void OnSendComplete(DPS_Node* node, void* appCtx, DPS_NetEndpoint* ep, uv_buf_t* bufs, size_t numBufs,
                            DPS_Status status)
 {
@@ -287,12 +481,12 @@ static void OnSendComplete(DPS_Node* node, void* appCtx, DPS_NetEndpoint* ep, uv
 
 DPS_Status DPS_DecodeAcknowledgement(DPS_Node* node, DPS_NetEndpoint* ep, DPS_NetRxBuffer* buf)
 {
-    static const int32_t ProtectedKeys[] = { DPS_CBOR_KEY_PUB_ID, DPS_CBOR_KEY_ACK_SEQ_NUM };
-    static const int32_t EncryptedKeys[] = { DPS_CBOR_KEY_DATA };
+    static const int32_t EncryptedKeys[] = { DPS_CBOR_KEY_DATA, DPS_CBOR_KEY_ACKS };
     DPS_RxBuffer* rxBuf = (DPS_RxBuffer*)buf;
     DPS_Status ret;
     DPS_Publication* pub;
     CBOR_MapState mapState;
+    AckProtected prot;
     uint32_t sn;
     uint32_t sequenceNum;
     DPS_UUID pubId;
@@ -318,34 +512,15 @@ DPS_Status DPS_DecodeAcknowledgement(DPS_Node* node, DPS_NetEndpoint* ep, DPS_Ne
      * Decode the protected map
      */
     aadPos = rxBuf->rxPos;
-    ret = DPS_ParseMapInit(&mapState, rxBuf, ProtectedKeys, A_SIZEOF(ProtectedKeys), NULL, 0);
+    ret = DPS_ParseMapFields(rxBuf, AckProtectedFields, A_SIZEOF(AckProtectedFields), &prot, NULL);
     if (ret != DPS_OK) {
         return ret;
     }
-    while (!DPS_ParseMapDone(&mapState)) {
-        int32_t key;
-        ret = DPS_ParseMapNext(&mapState, &key);
-        if (ret != DPS_OK) {
-            break;
-        }
-        switch (key) {
-        case DPS_CBOR_KEY_PUB_ID:
-            ret = CBOR_DecodeUUID(rxBuf, &pubId);
-            break;
-        case DPS_CBOR_KEY_ACK_SEQ_NUM:
-            ret = CBOR_DecodeUint32(rxBuf, &sequenceNum);
-            if ((ret == DPS_OK) && (sequenceNum == 0)) {
-                ret = DPS_ERR_INVALID;
-            }
-            break;
-        }
-        if (ret != DPS_OK) {
-            break;
-        }
-    }
-    if (ret != DPS_OK) {
-        return ret;
+    if (prot.sequenceNum == 0) {
+        return DPS_ERR_INVALID;
     }
+    pubId = prot.pubId;
+    sequenceNum = prot.sequenceNum;
     DPS_LockNode(node);
     /*
      * See if this is an ACK for a local publication
@@ -358,6 +533,7 @@ DPS_Status DPS_DecodeAcknowledgement(DPS_Node* node, DPS_NetEndpoint* ep, DPS_Ne
         DPS_RxBuffer aadBuf;
         DPS_RxBuffer cipherTextBuf;
         DPS_TxBuffer plainTextBuf;
+        DPS_NetRxBuffer* plainTextRxBuf;
         uint8_t type;
         uint64_t tag;
         /*
@@ -372,16 +548,29 @@ DPS_Status DPS_DecodeAcknowledgement(DPS_Node* node, DPS_NetEndpoint* ep, DPS_Ne
         DPS_MakeNonce(&pubId, sequenceNum, DPS_MSG_TYPE_ACK, nonce);
         DPS_RxBufferInit(&aadBuf, aadPos, rxBuf->rxPos - aadPos);
         DPS_RxBufferInit(&cipherTextBuf, rxBuf->rxPos, DPS_RxBufferAvail(rxBuf));
-        DPS_TxBufferClear(&plainTextBuf);
         ret = CBOR_Peek(&cipherTextBuf, &type, &tag);
         if ((ret == DPS_OK) && (type == CBOR_TAG)) {
             if ((tag == COSE_TAG_ENCRYPT0) || (tag == COSE_TAG_ENCRYPT)) {
-                ret = COSE_Decrypt(nonce, &unused, &aadBuf, &cipherTextBuf, node->keyStore, &pub->ack.sender,
-                                   &plainTextBuf);
+                /*
+                 * Decrypt into a receive buffer so the handler can retain the payload
+                 */
+                plainTextRxBuf = DPS_CreateNetRxBuffer(DPS_RxBufferAvail(&cipherTextBuf));
+                if (plainTextRxBuf) {
+                    DPS_TxBufferInit(&plainTextBuf, plainTextRxBuf->data, DPS_RxBufferAvail(&cipherTextBuf));
+                    ret = COSE_Decrypt(nonce, &unused, &aadBuf, &cipherTextBuf, node->keyStore, &pub->ack.sender,
+                                       &plainTextBuf);
+                    if (ret != DPS_OK) {
+                        DPS_NetRxBufferDecRef(plainTextRxBuf);
+                    }
+                } else {
+                    ret = DPS_ERR_RESOURCES;
+                }
                 if (ret == DPS_OK) {
                     DPS_DBGPRINT("Ack was COSE decrypted\n");
                     CBOR_Dump("plaintext", plainTextBuf.base, DPS_TxBufferUsed(&plainTextBuf));
-                    DPS_TxBufferToRx(&plainTextBuf, &encryptedBuf);
+                    DPS_TxBufferToRx(&plainTextBuf, &plainTextRxBuf->rx);
+                    encryptedBuf = plainTextRxBuf->rx;
+                    pub->rxBuf = plainTextRxBuf;
                 }
             } else if (tag == COSE_TAG_SIGN1) {
                 ret = COSE_Verify(&aadBuf, &cipherTextBuf, node->keyStore, &pub->ack.sender);
@@ -403,7 +592,15 @@ DPS_Status DPS_DecodeAcknowledgement(DPS_Node* node, DPS_NetEndpoint* ep, DPS_Ne
         if (ret == DPS_OK) {
             uint8_t* data = NULL;
             size_t dataLen = 0;
-            ret = DPS_ParseMapInit(&mapState, &encryptedBuf, EncryptedKeys, A_SIZEOF(EncryptedKeys), NULL, 0);
+            size_t numAcks = 0;
+            int haveData = DPS_FALSE;
+#ifdef DPS_DEBUG
+            ++_DPS_NumAckMsgs;
+#endif
+            /*
+             * The ack has either data or an array of aggregated acks
+             */
+            ret = DPS_ParseMapInit(&mapState, &encryptedBuf, NULL, 0, EncryptedKeys, A_SIZEOF(EncryptedKeys));
             if (ret == DPS_OK) {
                 while (!DPS_ParseMapDone(&mapState)) {
                     int32_t key;
@@ -417,20 +614,61 @@ DPS_Status DPS_DecodeAcknowledgement(DPS_Node* node, DPS_NetEndpoint* ep, DPS_Ne
                          * Get the pointer to the ack data
                          */
                         ret = CBOR_DecodeBytes(&encryptedBuf, &data, &dataLen);
+                        haveData = DPS_TRUE;
+                        break;
+                    case DPS_CBOR_KEY_ACKS:
+                        /*
+                         * The aggregated acks are the last entry in the map
+                         */
+                        ret = CBOR_DecodeArray(&encryptedBuf, &numAcks);
+                        if ((ret == DPS_OK) && !numAcks) {
+                            ret = DPS_ERR_INVALID;
+                        }
+#ifdef DPS_DEBUG
+                        ++_DPS_NumAggregatedAckMsgs;
+#endif
                         break;
                     }
-                    if (ret != DPS_OK) {
+                    if ((ret != DPS_OK) || numAcks) {
                         break;
                     }
                 }
-                if (ret == DPS_OK) {
+                if ((ret == DPS_OK) && !haveData && !numAcks) {
+                    ret = DPS_ERR_MISSING;
+                }
+                if ((ret == DPS_OK) && haveData) {
                     pub->ack.sequenceNum = sequenceNum;
                     pub->handler(pub, data, dataLen);
                 }
+                while ((ret == DPS_OK) && numAcks--) {
+                    size_t len;
+                    ret = CBOR_DecodeArray(&encryptedBuf, &len);
+                    if ((ret == DPS_OK) && (len != 2)) {
+                        ret = DPS_ERR_INVALID;
+                    }
+                    if (ret == DPS_OK) {
+                        ret = CBOR_DecodeUint32(&encryptedBuf, &sn);
+                    }
+                    if ((ret == DPS_OK) && ((sn == 0) || (sn > sequenceNum))) {
+                        ret = DPS_ERR_INVALID;
+                    }
+                    if (ret == DPS_OK) {
+                        ret = CBOR_DecodeBytes(&encryptedBuf, &data, &dataLen);
+                    }
+                    if (ret == DPS_OK) {
+                        pub->ack.sequenceNum = sn;
+                        pub->handler(pub, data, dataLen);
+                    }
+                }
             }
         }
+        if (pub->rxBuf != buf) {
+            /*
+             * Release the decrypted payload, the handler may still hold a reference
+             */
+            DPS_NetRxBufferDecRef(pub->rxBuf);
+        }
         pub->rxBuf = NULL;
-        DPS_TxBufferFree(&plainTextBuf);
         /* Ack context will be invalid now */
         memset(&pub->ack, 0, sizeof(pub->ack));
         DPS_LockNode(node);
@@ -499,6 +737,20 @@ DPS_Status DPS_AckPublicationBufs(const DPS_Publication* pub, const DPS_Buffer*
     if (!ack) {
         return DPS_ERR_RESOURCES;
     }
+    if (node->ackAggregationDelay) {
+        /*
+         * Serialization is deferred until the ack is aggregated
+         */
+        if (node->netCtx) {
+            SetPayloadBufs(ack, bufs, numBufs);
+            ack->destAddr = *addr;
+            DPS_QueuePendingAck(node, ack);
+        } else {
+            ret = DPS_ERR_NETWORK;
+            DestroyAck(ack);
+        }
+        return ret;
+    }
     ret = SerializeAck(pub, ack, bufs, numBufs);
     if (ret == DPS_OK) {
         ack->destAddr = *addr;
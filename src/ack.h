@@ -51,6 +51,7 @@ typedef struct _PublicationAck {
     DPS_PublishBufsComplete completeCB; /**< The completion callback */
     void* data;                         /**< Context pointer */
     DPS_Status status;                  /**< Result of the publish */
+    DPS_Queue aggregated;               /**< Acknowledgements aggregated into this one */
     size_t numBufs;                     /**< Number of buffers */
     /**
      * Ack fields.
@@ -88,6 +89,16 @@ DPS_Status DPS_DecodeAcknowledgement(DPS_Node* node, DPS_NetEndpoint* ep, DPS_Ne
  */
 DPS_Status DPS_SendAcknowledgement(PublicationAck* ack, RemoteNode* ackNode);
 
+/**
+ * Aggregate the pending acknowledgements for the same publication and
+ * destination into single acknowledgements and queue them to be sent.
+ *
+ * Must be called with the node lock held.
+ *
+ * @param node    The local node
+ */
+void DPS_AggregateAcks(DPS_Node* node);
+
 /**
  * Complete the ack when finished.
  *
@@ -91,6 +91,7 @@ typedef count_t counter_t[CHUNK_SIZE];
 #if defined(__GNUC__) || defined(__MINGW64__)
 #define POPCOUNT(n)    __builtin_popcountll((chunk_t)n)
 #define COUNT_TZ(n)    __builtin_ctzll((chunk_t)n)
+#define LOG2(n)        (31 - __builtin_clz((uint32_t)n))
 #elif defined(_WIN64)
 #define POPCOUNT(n)    (uint32_t)(__popcnt64((chunk_t)n))
 static inline uint32_t COUNT_TZ(uint64_t n)
@@ -102,6 +103,12 @@ static inline uint32_t COUNT_TZ(uint64_t n)
         return 0;
     }
 }
+static inline uint32_t LOG2(uint32_t n)
+{
+    unsigned long index;
+    _BitScanReverse(&index, n);
+    return index;
+}
 #elif defined(_WIN32)
 static inline uint32_t POPCOUNT(chunk_t n)
 {
@@ -118,6 +125,12 @@ static inline uint32_t COUNT_TZ(uint64_t n)
         return 0;
     }
 }
+static inline uint32_t LOG2(uint32_t n)
+{
+    unsigned long index;
+    _BitScanReverse(&index, n);
+    return index;
+}
 #endif
 
 #define UNKNOWN_POPCOUNT(bv)  ((bv)->popCount < 0)
@@ -132,6 +145,8 @@ struct _DPS_BitVector {
 struct _DPS_CountVector {
     size_t entries;
     size_t len;
+    uint64_t revision;
+    uint64_t* chunkRevs;
     DPS_BitVector* bvUnion;
     counter_t counts[1];
 };
@@ -150,6 +165,14 @@ static Configuration config = { DPS_CONFIG_BIT_LEN, (uint8_t)DPS_CONFIG_HASHES }
 
 #define FH_BITVECTOR_LEN  (4 * CHUNK_SIZE)
 
+/*
+ * Upper bound on the length of a bit vector received from the
+ * network. Remote nodes may be configured with a different bit length
+ * than the local node, this limits how much we will allocate to fold
+ * a received bit vector down to the local length.
+ */
+#define MAX_BITVECTOR_LEN  (64 * 1024)
+
 #ifdef DPS_DEBUG
 /*
  * This is a compressed bit dump - it groups bits to keep
@@ -216,6 +239,99 @@ DPS_BitVector* DPS_BitVectorAllocFH()
     return AllocBV(FH_BITVECTOR_LEN);
 }
 
+DPS_BitVector* DPS_BitVectorAllocLen(size_t bitLen)
+{
+    if (!bitLen || (bitLen & 63) || (bitLen > MAX_BITVECTOR_LEN)) {
+        return NULL;
+    }
+    return AllocBV(bitLen);
+}
+
+size_t DPS_BitVectorLen(const DPS_BitVector* bv)
+{
+    return bv->len;
+}
+
+size_t DPS_BitVectorLinkLen(size_t remoteLen)
+{
+    size_t a = config.bitLen;
+    size_t b = remoteLen;
+
+    if (!b || (b & 63)) {
+        return a;
+    }
+    /*
+     * Both lengths are multiples of 64 so the greatest common divisor
+     * is too. Folding to the GCD is always possible from either side.
+     */
+    while (b) {
+        size_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+uint8_t DPS_BitVectorNumHashes(void)
+{
+    return config.numHashes;
+}
+
+int DPS_BitVectorIsDefaultConfig(void)
+{
+    return (config.bitLen == DPS_CONFIG_BIT_LEN) && (config.numHashes == DPS_CONFIG_HASHES);
+}
+
+void DPS_BitVectorDefaultConfig(uint32_t* bitLen, uint8_t* numHashes)
+{
+    *bitLen = DPS_CONFIG_BIT_LEN;
+    *numHashes = (uint8_t)DPS_CONFIG_HASHES;
+}
+
+DPS_Status DPS_BitVectorFold(DPS_BitVector* bvOut, const DPS_BitVector* bv)
+{
+    size_t nOut;
+    size_t nIn;
+    size_t g;
+    size_t i;
+
+    if (!bvOut || !bv) {
+        return DPS_ERR_NULL;
+    }
+    if (bvOut == bv) {
+        return DPS_ERR_ARGS;
+    }
+    nOut = NUM_CHUNKS(bvOut);
+    nIn = NUM_CHUNKS(bv);
+    /*
+     * Bloom filter bit indices are hash % len so bit i maps to bit
+     * i % g in a vector of length g where g divides len. OR-reducing
+     * the input to the GCD of the two lengths and then replicating
+     * the result across the output keeps every item that was in
+     * the input, at the cost of more false positives.
+     */
+    for (g = nOut, i = nIn; i;) {
+        size_t t = g % i;
+        g = i;
+        i = t;
+    }
+    if (g == nIn) {
+        for (i = 0; i < nOut; ++i) {
+            bvOut->bits[i] = bv->bits[i % nIn];
+        }
+    } else {
+        memcpy_s(bvOut->bits, g * sizeof(chunk_t), bv->bits, g * sizeof(chunk_t));
+        for (i = g; i < nIn; ++i) {
+            bvOut->bits[i % g] |= bv->bits[i];
+        }
+        for (i = g; i < nOut; ++i) {
+            bvOut->bits[i] = bvOut->bits[i - g];
+        }
+    }
+    INVALIDATE_POPCOUNT(bvOut);
+    return DPS_OK;
+}
+
 int DPS_BitVectorIsClear(DPS_BitVector* bv)
 {
     if (UNKNOWN_POPCOUNT(bv)) {
@@ -341,6 +457,43 @@ int DPS_BitVectorEquals(const DPS_BitVector* bv1, const DPS_BitVector* bv2)
     return DPS_TRUE;
 }
 
+size_t DPS_BitVectorNextBit(const DPS_BitVector* bv, size_t bit)
+{
+    size_t i = bit / CHUNK_SIZE;
+    chunk_t chunk;
+
+    if (bit >= bv->len) {
+        return bv->len;
+    }
+    chunk = bv->bits[i] & (~0ull << (bit % CHUNK_SIZE));
+    while (!chunk) {
+        if (++i == NUM_CHUNKS(bv)) {
+            return bv->len;
+        }
+        chunk = bv->bits[i];
+    }
+    return i * CHUNK_SIZE + COUNT_TZ(chunk);
+}
+
+int DPS_BitVectorIntersects(const DPS_BitVector* bv1, const DPS_BitVector* bv2)
+{
+    size_t i;
+
+    if (!bv1 || !bv2) {
+        return DPS_FALSE;
+    }
+    assert(bv1->len == bv2->len);
+    if ((bv1->popCount == 0) || (bv2->popCount == 0)) {
+        return DPS_FALSE;
+    }
+    for (i = 0; i < NUM_CHUNKS(bv1); ++i) {
+        if (bv1->bits[i] & bv2->bits[i]) {
+            return DPS_TRUE;
+        }
+    }
+    return DPS_FALSE;
+}
+
 int DPS_BitVectorIncludes(const DPS_BitVector* bv1, const DPS_BitVector* bv2)
 {
     size_t i;
@@ -416,6 +569,18 @@ DPS_Status DPS_BitVectorFuzzyHash(DPS_BitVector* hash, DPS_BitVector* bv)
     return DPS_OK;
 }
 
+void DPS_BitVectorFuzzyHashRelax(DPS_BitVector* hash)
+{
+    assert(hash->len == FH_BITVECTOR_LEN);
+    /*
+     * The first three chunks only depend on bit positions modulo 64
+     * so are unchanged by folding. The population count is not so
+     * it cannot be relied on across a fold.
+     */
+    hash->bits[3] = 0;
+    INVALIDATE_POPCOUNT(hash);
+}
+
 DPS_Status DPS_BitVectorUnion(DPS_BitVector* bvOut, DPS_BitVector* bv)
 {
     size_t i;
@@ -486,9 +651,6 @@ DPS_Status DPS_BitVectorXor(DPS_BitVector* bvOut, DPS_BitVector* bv1, DPS_BitVec
     return DPS_OK;
 }
 
-#define SET_BIT8(a, b)   (a)[(b) >> 3] |= (1 << ((b) & 0x7))
-#define TEST_BIT8(a, b) ((a)[(b) >> 3] &  (1 << ((b) & 0x7)))
-
 /****************************************
 
   Run-length Encoding algorithm.
@@ -531,37 +693,97 @@ Examples:
 00000001  ->     0001  000   =  001000
 000000001 ->     0001  001   =  001001
 
+  Bits are packed least significant bit first so a complete code for
+  a run of N zeroes followed by a 1 is the integer
+
+    (1 << C) | ((N + 1 - (1 << C)) << (C + 1))
+
+  written as 2C + 1 bits. The encoder accumulates codes in a 64 bit
+  word and the decoder extracts them from 64 bit words so neither
+  needs to operate on individual bits.
+
  *****************************************/
 
 /*
- * Compute ceil(log2(n))
+ * Accumulates run length codes and writes them out 64 bits at a time
+ */
+typedef struct {
+    uint8_t* pos;      /* Where the next word will be written */
+    uint64_t acc;      /* Bits not yet written out */
+    size_t numBits;    /* Number of bits in acc */
+    size_t total;      /* Total number of bits encoded so far */
+    size_t limit;      /* Maximum number of bits that can be encoded */
+} BitWriter;
+
+/*
+ * Wire format is little-endian regardless of the host byte order
  */
-static uint32_t Ceil_Log2(uint16_t n)
+static inline void StoreLE64(uint8_t* p, uint64_t w)
 {
-    uint32_t b = 0;
-    if (n & 0xFF00) {
-        n >>= 8;  b += 8;
-    }
-    if (n & 0x00F0) {
-        n >>= 4;  b += 4;
-    }
-    if (n & 0x000C) {
-        n >>= 2;  b += 2;
+    p[0] = (uint8_t)w;
+    p[1] = (uint8_t)(w >> 8);
+    p[2] = (uint8_t)(w >> 16);
+    p[3] = (uint8_t)(w >> 24);
+    p[4] = (uint8_t)(w >> 32);
+    p[5] = (uint8_t)(w >> 40);
+    p[6] = (uint8_t)(w >> 48);
+    p[7] = (uint8_t)(w >> 56);
+}
+
+static inline uint64_t LoadLE64(const uint8_t* p)
+{
+    return (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) |
+        ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) | ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+}
+
+/*
+ * Append up to 64 bits to the output
+ */
+static inline DPS_Status PutBits(BitWriter* bw, uint64_t bits, size_t n)
+{
+    bw->total += n;
+    if (bw->total > bw->limit) {
+        return DPS_ERR_OVERFLOW;
     }
-    if (n & 0x0002) {
-        n >>= 1;  b += 1;
+    bw->acc |= bits << bw->numBits;
+    if ((bw->numBits + n) >= 64) {
+        /*
+         * The limit guarantees there is room for a complete word
+         */
+        StoreLE64(bw->pos, bw->acc);
+        bw->pos += 8;
+        bw->acc = bw->numBits ? bits >> (64 - bw->numBits) : 0;
+        bw->numBits = bw->numBits + n - 64;
+    } else {
+        bw->numBits += n;
     }
-    return b;
+    return DPS_OK;
 }
 
+/*
+ * Append the code for a run of zeroes terminated by a 1
+ */
+static inline DPS_Status PutRun(BitWriter* bw, uint32_t num0)
+{
+    uint32_t sz = LOG2(num0 + 1);
+    uint64_t val = num0 + 1 - ((uint64_t)1 << sz);
+
+    if (sz < 32) {
+        return PutBits(bw, ((uint64_t)1 << sz) | (val << (sz + 1)), 2 * sz + 1);
+    } else {
+        DPS_Status ret = PutBits(bw, (uint64_t)1 << sz, sz + 1);
+        if (ret == DPS_OK) {
+            ret = PutBits(bw, val, sz);
+        }
+        return ret;
+    }
+}
 
 static DPS_Status RunLengthEncode(DPS_BitVector* bv, DPS_TxBuffer* buffer, uint8_t flags)
 {
     size_t i;
-    size_t rleSize = 0;
-    size_t sz;
     uint32_t num0 = 0;
-    uint8_t* packed = buffer->txPos;
+    BitWriter bw;
     chunk_t complement = flags & FLAG_RLE_COMPLEMENT ? ~0 : 0;
 
     /*
@@ -576,10 +798,11 @@ static DPS_Status RunLengthEncode(DPS_BitVector* bv, DPS_TxBuffer* buffer, uint8
     if (DPS_TxBufferSpace(buffer) < (bv->len / 8)) {
         return DPS_ERR_OVERFLOW;
     }
-    /*
-     * We only need to set the 1's so clear the buffer
-     */
-    memzero_s(packed, bv->len / 8);
+    bw.pos = buffer->txPos;
+    bw.acc = 0;
+    bw.numBits = 0;
+    bw.total = 0;
+    bw.limit = bv->len;
 
     for (i = 0; i < NUM_CHUNKS(bv); ++i) {
         uint32_t rem0;
@@ -590,108 +813,111 @@ static DPS_Status RunLengthEncode(DPS_BitVector* bv, DPS_TxBuffer* buffer, uint8
         }
         rem0 = CHUNK_SIZE;
         while (chunk) {
-            uint32_t val;
             int tz = COUNT_TZ(chunk);
-            chunk >>= tz;
-            rem0 -= tz + 1;
-            num0 += tz;
-            /*
-             * Size of the length field
-             */
-            sz = Ceil_Log2(num0 + 1);
-            /*
-             * Adjusted length value to write
-             */
-            val = num0 - ((1 << sz) - 1);
-            /*
-             * Skip zeroes
-             */
-            rleSize += sz;
-            SET_BIT8(packed, rleSize);
-            ++rleSize;
-            if ((rleSize + sz) > bv->len) {
-                return DPS_ERR_OVERFLOW;
+            DPS_Status ret = PutRun(&bw, num0 + tz);
+            if (ret != DPS_OK) {
+                return ret;
             }
             /*
-             * Write length of the zero run - little endian
+             * Two shifts because tz + 1 may be 64
              */
-            while (sz--) {
-                if (val & 1) {
-                    SET_BIT8(packed, rleSize);
-                }
-                val >>= 1;
-                ++rleSize;
-            }
+            chunk >>= tz;
             chunk >>= 1;
+            rem0 -= tz + 1;
             num0 = 0;
         }
         num0 = rem0;
     }
-    if (rleSize > bv->len) {
-        return DPS_ERR_OVERFLOW;
+    /*
+     * Write out any partial word
+     */
+    for (i = 0; i < bw.numBits; i += 8) {
+        *bw.pos++ = (uint8_t)bw.acc;
+        bw.acc >>= 8;
     }
-    buffer->txPos += (rleSize + 7) / 8;
+    buffer->txPos = bw.pos;
     return DPS_OK;
 }
 
-#define TOP_UP_THRESHOLD 56
+/*
+ * Returns the 57 to 64 bits starting at bitPos. Bits past the end of
+ * the packed data are returned as zeroes.
+ */
+static inline uint64_t PeekBits(const uint8_t* packed, size_t packedSize, size_t bitPos)
+{
+    size_t i = bitPos >> 3;
+
+    if ((i + 8) <= packedSize) {
+        return LoadLE64(packed + i) >> (bitPos & 7);
+    } else {
+        uint8_t tail[8] = { 0 };
+        if (i < packedSize) {
+            memcpy_s(tail, sizeof(tail), packed + i, packedSize - i);
+        }
+        return LoadLE64(tail) >> (bitPos & 7);
+    }
+}
 
 static DPS_Status RunLengthDecode(uint8_t* packed, size_t packedSize, chunk_t* bits, size_t len)
 {
-    uint64_t bitPos = 0;
-    uint64_t current;
-    size_t currentBits = 0;
+    size_t totalBits = packedSize * 8;
+    size_t bitPos = 0;
+    size_t pos = 0;
+    size_t avail = 0;
+    uint64_t current = 0;
 
     memzero_s(bits, len / 8);
 
-    if (packedSize) {
-        currentBits = 8;
-        current = *packed++;
-        --packedSize;
-    }
-    while (currentBits) {
-        /*
-         * Keep the current bits above the threshold where we are guaranteed
-         * contiguous bits to decode the lengths below.
-         */
-        while (packedSize && (currentBits <= TOP_UP_THRESHOLD)) {
-            current |= (((uint64_t)*packed++) << currentBits);
-            currentBits += 8;
-            --packedSize;
-        }
+    while (bitPos < totalBits) {
+        uint64_t num0;
+        uint64_t mask;
+        uint32_t codeLen;
+        uint32_t tz;
+
         if (!current) {
-            assert(packedSize == 0);
-            break;
+            current = PeekBits(packed, packedSize, bitPos);
+            avail = 64 - (bitPos & 7);
+            if (!current) {
+                /*
+                 * Only the zero padding in the last byte can remain
+                 */
+                if ((bitPos + avail) < totalBits) {
+                    return DPS_ERR_INVALID;
+                }
+                break;
+            }
         }
-        if (current & 1) {
-            current >>= 1;
-            --currentBits;
-        } else {
-            uint64_t val;
-            uint64_t num0;
-            int tz = COUNT_TZ(current);
-
-            current >>= (tz + 1);
+        tz = COUNT_TZ(current);
+        codeLen = 2 * tz + 1;
+        if (codeLen > avail) {
             /*
-             * We can extract the length with a mask
+             * Top up so the complete code is in the current word
              */
-            val = current & (((uint64_t)1 << tz) - 1);
+            current = PeekBits(packed, packedSize, bitPos);
+            avail = 64 - (bitPos & 7);
+            tz = COUNT_TZ(current);
+            codeLen = 2 * tz + 1;
+        }
+        mask = ((uint64_t)1 << tz) - 1;
+        if (codeLen <= avail) {
+            current >>= tz + 1;
+            num0 = (current & mask) + mask;
+            current >>= tz;
+            avail -= codeLen;
+        } else {
             /*
-             * The value is little-endian so we may need to do an endian swap
+             * Only very long zero runs have codes wider than a word
              */
-#ifdef ENDIAN_SWAP
-            val = BSWAP_64(val);
-#endif
-            num0 = val + (((uint64_t)1 << tz) - 1);
-            bitPos += num0;
-            currentBits -= (1 + tz * 2);
-            current >>= tz;
+            num0 = (PeekBits(packed, packedSize, bitPos + tz + 1) & mask) + mask;
+            current = 0;
         }
-        if (bitPos >= len) {
+        bitPos += codeLen;
+        if ((bitPos > totalBits) || (num0 >= (len - pos))) {
             return DPS_ERR_INVALID;
         }
-        SET_BIT(bits, bitPos);
-        ++bitPos;
+        pos += num0;
+        SET_BIT(bits, pos);
+        ++pos;
     }
     return DPS_OK;
 }
@@ -710,6 +936,7 @@ DPS_Status DPS_BitVectorSerialize(DPS_BitVector* bv, DPS_TxBuffer* buffer)
 {
     DPS_Status ret;
     uint8_t flags;
+    uint8_t* resetPos;
     float load = DPS_BitVectorLoadFactor(bv);
 
     /*
@@ -735,45 +962,50 @@ DPS_Status DPS_BitVectorSerialize(DPS_BitVector* bv, DPS_TxBuffer* buffer)
     } else{
         flags = 0;
     }
-    while (1) {
-        uint8_t* resetPos = buffer->txPos;
+    resetPos = buffer->txPos;
+    if (flags & FLAG_RLE_ENCODED) {
+        uint8_t* wrapPos;
         ret = CBOR_EncodeUint(buffer, flags);
+        if (ret == DPS_OK) {
+            ret = CBOR_EncodeUint(buffer, bv->len);
+        }
+        /*
+         * Reserve space in the buffer
+         */
+        if (ret == DPS_OK) {
+            ret = CBOR_StartWrapBytes(buffer, bv->len / 8, &wrapPos);
+        }
         if (ret != DPS_OK) {
             return ret;
         }
-        ret = CBOR_EncodeUint(buffer, bv->len);
-        if (ret != DPS_OK) {
+        ret = RunLengthEncode(bv, buffer, flags);
+        if (ret == DPS_OK) {
+            return CBOR_EndWrapBytes(buffer, wrapPos);
+        }
+        if (ret != DPS_ERR_OVERFLOW) {
             return ret;
         }
-        if (flags & FLAG_RLE_ENCODED) {
-            uint8_t* wrapPos;
-            /*
-             * Reserve space in the buffer
-             */
-            ret = CBOR_StartWrapBytes(buffer, bv->len / 8, &wrapPos);
-            if (ret == DPS_OK) {
-                ret = RunLengthEncode(bv, buffer, flags);
-                if (ret == DPS_OK) {
-                    ret = CBOR_EndWrapBytes(buffer, wrapPos);
-                }
-            } else if (ret == DPS_ERR_OVERFLOW) {
-                /*
-                 * Reset buffer and use raw encoding
-                 */
-                flags = 0;
-                buffer->txPos = resetPos;
-                continue;
-            }
-        } else {
+        /*
+         * The encoding gave up as soon as it was going to be larger
+         * than the raw bit vector. The space reserved above is enough
+         * for the raw encoding so reset the buffer and use that.
+         */
+        flags = 0;
+        buffer->txPos = resetPos;
+    }
+    ret = CBOR_EncodeUint(buffer, flags);
+    if (ret != DPS_OK) {
+        return ret;
+    }
+    ret = CBOR_EncodeUint(buffer, bv->len);
+    if (ret != DPS_OK) {
+        return ret;
+    }
 #ifdef ENDIAN_SWAP
 #error(TODO bit vector endian swapping not implemented)
 #else
-            ret = CBOR_EncodeBytes(buffer, (const uint8_t*)bv->bits, bv->len / 8);
+    return CBOR_EncodeBytes(buffer, (const uint8_t*)bv->bits, bv->len / 8);
 #endif
-        }
-        break;
-    }
-    return ret;
 }
 
 size_t DPS_BitVectorSerializeMaxSize(DPS_BitVector* bv)
@@ -807,6 +1039,7 @@ DPS_Status DPS_BitVectorDeserializeFH(DPS_BitVector* bv, DPS_RxBuffer* buffer)
 
 DPS_Status DPS_BitVectorDeserialize(DPS_BitVector* bv, DPS_RxBuffer* buffer)
 {
+    DPS_BitVector* wire;
     DPS_Status ret;
     uint64_t flags;
     uint64_t len;
@@ -828,24 +1061,42 @@ DPS_Status DPS_BitVectorDeserialize(DPS_BitVector* bv, DPS_RxBuffer* buffer)
     if (ret != DPS_OK) {
         return ret;
     }
+    /*
+     * The sender may be using a different bit length, in which case
+     * the bit vector is decoded at the sender's length and then
+     * folded to the length of the bit vector passed in.
+     */
     if (len != bv->len) {
-        DPS_ERRPRINT("Deserialized bloom filter has wrong size\n");
-        return DPS_ERR_INVALID;
+        if (!len || (len & 63) || (len > MAX_BITVECTOR_LEN)) {
+            DPS_ERRPRINT("Deserialized bloom filter has wrong size\n");
+            return DPS_ERR_INVALID;
+        }
+        wire = AllocBV((size_t)len);
+        if (!wire) {
+            return DPS_ERR_RESOURCES;
+        }
+    } else {
+        wire = bv;
     }
     ret = CBOR_DecodeBytes(buffer, &data, &size);
-    if (ret != DPS_OK) {
-        return ret;
+    if (ret == DPS_OK) {
+        if (flags & FLAG_RLE_ENCODED) {
+            ret = RunLengthDecode(data, size, wire->bits, wire->len);
+            if ((ret == DPS_OK) && (flags & FLAG_RLE_COMPLEMENT)) {
+                DPS_BitVectorComplement(wire);
+            }
+        } else if (size == wire->len / 8) {
+            memcpy_s(wire->bits, size, data, size);
+        } else {
+            DPS_ERRPRINT("Deserialized bloom filter has wrong length\n");
+            ret = DPS_ERR_INVALID;
+        }
     }
-    if (flags & FLAG_RLE_ENCODED) {
-        ret = RunLengthDecode(data, size, bv->bits, bv->len);
-        if ((ret == DPS_OK) && (flags & FLAG_RLE_COMPLEMENT)) {
-            DPS_BitVectorComplement(bv);
+    if (wire != bv) {
+        if (ret == DPS_OK) {
+            ret = DPS_BitVectorFold(bv, wire);
         }
-    } else if (size == bv->len / 8) {
-        memcpy_s(bv->bits, size, data, size);
-    } else {
-        DPS_ERRPRINT("Deserialized bloom filter has wrong length\n");
-        ret = DPS_ERR_INVALID;
+        DPS_BitVectorFree(wire);
     }
     return ret;
 }
@@ -905,11 +1156,11 @@ static size_t RLE_Size(DPS_BitVector* bv)
             size_t sz;
             int tz = COUNT_TZ(chunk);
             chunk >>= tz;
+            chunk >>= 1;
             rem0 -= tz + 1;
             num0 += tz;
-            sz = Ceil_Log2(num0 + 1);
+            sz = LOG2(num0 + 1);
             rleSize += 1 + sz * 2;
-            chunk >>= 1;
             num0 = 0;
         }
         num0 = rem0;
@@ -946,11 +1197,20 @@ void DPS_BitVectorDump(DPS_BitVector* bv, int dumpBits)
 static DPS_CountVector* AllocCV(size_t sz)
 {
     DPS_CountVector* cv;
+    size_t numChunks = sz / CHUNK_SIZE;
 
     assert((sz % 64) == 0);
-    cv = calloc(1, sizeof(DPS_CountVector) + ((sz / CHUNK_SIZE) - 1) * sizeof(counter_t));
+    /*
+     * The per-chunk revisions are allocated after the counters
+     */
+    cv = calloc(1, sizeof(DPS_CountVector) + (numChunks - 1) * sizeof(counter_t) + numChunks * sizeof(uint64_t));
     if (cv) {
         cv->len = sz;
+        cv->chunkRevs = (uint64_t*)&cv->counts[numChunks];
+        /*
+         * Revision zero is never current so can be used to force a full recomputation
+         */
+        cv->revision = 1;
     }
     return cv;
 }
@@ -993,11 +1253,13 @@ DPS_Status DPS_CountVectorAdd(DPS_CountVector* cv, DPS_BitVector* bv)
     if (cv->entries == CV_MAX) {
         return DPS_ERR_RESOURCES;
     }
+    ++cv->revision;
     if (bv->popCount != 0) {
         for (i = 0; i < NUM_CHUNKS(bv); ++i) {
             chunk_t chunk = bv->bits[i];
             if (chunk) {
                 count_t* count = cv->counts[i];
+                cv->chunkRevs[i] = cv->revision;
                 if (cv->bvUnion) {
                     cv->bvUnion->bits[i] |= chunk;
                 }
@@ -1028,6 +1290,7 @@ DPS_Status DPS_CountVectorDel(DPS_CountVector* cv, DPS_BitVector* bv)
     if (cv->entries == 0) {
         return DPS_ERR_ARGS;
     }
+    ++cv->revision;
     if (bv->popCount != 0) {
         for (i = 0; i < NUM_CHUNKS(bv); ++i) {
             chunk_t chunk = bv->bits[i];
@@ -1035,6 +1298,7 @@ DPS_Status DPS_CountVectorDel(DPS_CountVector* cv, DPS_BitVector* bv)
                 count_t* count = cv->counts[i];
                 chunk_t bit = 1;
                 chunk_t clear = 0;
+                cv->chunkRevs[i] = cv->revision;
                 do {
                     if (chunk & 1) {
                         if (--(*count) == 0) {
@@ -1090,6 +1354,119 @@ DPS_BitVector* DPS_CountVectorToIntersection(DPS_CountVector* cv)
     return bv;
 }
 
+uint64_t DPS_CountVectorRevision(const DPS_CountVector* cv)
+{
+    return cv ? cv->revision : 0;
+}
+
+/*
+ * Returns chunk i of the union with the bits that were only
+ * contributed by the excluded bit vector cleared.
+ */
+static chunk_t UnionExcluding(const DPS_CountVector* cv, const DPS_BitVector* excl, size_t i)
+{
+    chunk_t chunk = cv->bvUnion->bits[i];
+
+    if (excl) {
+        chunk_t shared = chunk & excl->bits[i];
+        while (shared) {
+            uint32_t b = COUNT_TZ(shared);
+            if (cv->counts[i][b] == 1) {
+                chunk &= ~(1ull << b);
+            }
+            shared &= shared - 1;
+        }
+    }
+    return chunk;
+}
+
+DPS_Status DPS_CountVectorUpdateUnion(DPS_BitVector* bvOut, DPS_BitVector* delta, const DPS_CountVector* cv,
+                                      const DPS_BitVector* excl, uint64_t revision, int* same)
+{
+    size_t numChunks;
+    size_t numOut;
+    size_t i;
+    size_t j;
+    int equal = DPS_TRUE;
+
+    if (!bvOut || !cv || !cv->bvUnion) {
+        return DPS_ERR_NULL;
+    }
+    if ((cv->len % bvOut->len) || (excl && (excl->len != cv->len)) || (delta && (delta->len != bvOut->len))) {
+        return DPS_ERR_ARGS;
+    }
+    numChunks = NUM_CHUNKS(cv);
+    numOut = NUM_CHUNKS(bvOut);
+    /*
+     * Output chunk j is the OR of the chunks j, j + numOut, ... so it
+     * only needs to be recomputed if one of those chunks has changed.
+     */
+    for (j = 0; j < numOut; ++j) {
+        int dirty = (revision == 0);
+        chunk_t chunk = 0;
+        for (i = j; !dirty && (i < numChunks); i += numOut) {
+            dirty = cv->chunkRevs[i] > revision;
+        }
+        if (!dirty) {
+            continue;
+        }
+        for (i = j; i < numChunks; i += numOut) {
+            chunk |= UnionExcluding(cv, excl, i);
+        }
+        if (chunk != bvOut->bits[j]) {
+            if (delta) {
+                delta->bits[j] ^= chunk ^ bvOut->bits[j];
+            }
+            bvOut->bits[j] = chunk;
+            equal = DPS_FALSE;
+        }
+    }
+    if (!equal) {
+        INVALIDATE_POPCOUNT(bvOut);
+        if (delta) {
+            INVALIDATE_POPCOUNT(delta);
+        }
+    }
+    if (same) {
+        *same = equal;
+    }
+    return DPS_OK;
+}
+
+DPS_Status DPS_CountVectorIntersectionExcluding(DPS_BitVector* bvOut, const DPS_CountVector* cv, const DPS_BitVector* excl)
+{
+    size_t entries;
+    size_t i;
+
+    if (!bvOut || !cv) {
+        return DPS_ERR_NULL;
+    }
+    if ((bvOut->len != cv->len) || (excl && (excl->len != cv->len))) {
+        return DPS_ERR_ARGS;
+    }
+    entries = cv->entries;
+    if (excl && entries) {
+        --entries;
+    }
+    for (i = 0; i < NUM_CHUNKS(bvOut); ++i) {
+        chunk_t chunk = 0;
+        if (entries && (!cv->bvUnion || cv->bvUnion->bits[i])) {
+            const count_t* count = cv->counts[i];
+            chunk_t e = excl ? excl->bits[i] : 0;
+            chunk_t b = 1;
+            while (b) {
+                if ((size_t)(*count++ - ((e & b) ? 1 : 0)) == entries) {
+                    chunk |= b;
+                }
+                b <<= 1;
+            }
+        }
+        bvOut->bits[i] = chunk;
+    }
+    INVALIDATE_POPCOUNT(bvOut);
+    return DPS_OK;
+}
+
 void DPS_CountVectorDump(DPS_CountVector* cv)
 {
     size_t i;
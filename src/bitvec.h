@@ -48,9 +48,12 @@ typedef struct _DPS_CountVector DPS_CountVector;
 
 /**
  * Global configuration for this module. Overrides the default value
- * for various global parameters. These are system wide parameters
- * that must be the same for all nodes participating in a single DPS
- * network.
+ * for various global parameters. The number of hashes must be the
+ * same for all nodes participating in a single DPS network. The bit
+ * length can differ between nodes, bit vectors are folded to a common
+ * length where nodes with different lengths are linked. Folding is
+ * most effective when the lengths are powers of two multiples of each
+ * other.
  *
  * @param  bitLen        The size of the bit vectors in bits.  The size must be a multiple of 64.
  * @param  numHashes     The number of hashes for Bloom filter operations - must be in the range 1..16.
@@ -95,6 +98,79 @@ DPS_BitVector* DPS_BitVectorAlloc(void);
  */
 DPS_BitVector* DPS_BitVectorAllocFH(void);
 
+/**
+ * Allocates a bit vector with a specific length. This is used for bit
+ * vectors that are sent to a remote node that is configured with a
+ * different bit length.
+ *
+ * @param bitLen  The size of the bit vector in bits, must be a multiple of 64.
+ *
+ * @return  An initialized bit vector or NULL if the allocation failed
+ *          or the length is not valid.
+ */
+DPS_BitVector* DPS_BitVectorAllocLen(size_t bitLen);
+
+/**
+ * Get the length of a bit vector
+ *
+ * @param bv  An initialized bit vector
+ *
+ * @return  The size of the bit vector in bits
+ */
+size_t DPS_BitVectorLen(const DPS_BitVector* bv);
+
+/**
+ * Get the bit length to use for bit vectors exchanged with a remote
+ * node. This is the largest length that both the local and remote
+ * lengths can be folded to.
+ *
+ * @param remoteLen  The bit length configured on the remote node or
+ *                   zero if not known.
+ *
+ * @return  The bit length for the link
+ */
+size_t DPS_BitVectorLinkLen(size_t remoteLen);
+
+/**
+ * Get the number of hashes configured for Bloom filter operations.
+ *
+ * @return  The number of hashes
+ */
+uint8_t DPS_BitVectorNumHashes(void);
+
+/**
+ * Check if the bit length and number of hashes are the compiled
+ * defaults. Nodes only send these parameters to remote nodes if they
+ * have been changed by DPS_Configure() because nodes that predate
+ * the parameters cannot parse messages that include them.
+ *
+ * @return  DPS_TRUE if the parameters are the compiled defaults
+ */
+int DPS_BitVectorIsDefaultConfig(void);
+
+/**
+ * Get the compiled default bit length and number of hashes. These are
+ * assumed for remote nodes that do not send their parameters.
+ *
+ * @param bitLen     Returns the default bit length
+ * @param numHashes  Returns the default number of hashes
+ */
+void DPS_BitVectorDefaultConfig(uint32_t* bitLen, uint8_t* numHashes);
+
+/**
+ * Fold (OR-reduce) a bit vector into a bit vector of a different
+ * length. Items inserted into the input are also present in the
+ * output so Bloom filter tests on the output never give a false
+ * negative. If the output is longer than the input the bits are
+ * replicated.
+ *
+ * @param bvOut  The bit vector to receive the folded bits, must not be the same as bv
+ * @param bv     The bit vector to fold
+ *
+ * @return DPS_OK if the fold is successful, an error otherwise
+ */
+DPS_Status DPS_BitVectorFold(DPS_BitVector* bvOut, const DPS_BitVector* bv);
+
 /**
  * Clone a bit vector
  *
@@ -155,6 +231,15 @@ size_t DPS_BitVectorPopCount(DPS_BitVector* bv);
  */
 DPS_Status DPS_BitVectorFuzzyHash(DPS_BitVector* hash, DPS_BitVector* bv);
 
+/**
+ * Remove the population count constraint from a fuzzy hash. This is
+ * required for a fuzzy hash sent with interests that have been folded
+ * because folding can reduce the population count of a bit vector.
+ *
+ * @param hash  A fuzzy hash bit vector
+ */
+void DPS_BitVectorFuzzyHashRelax(DPS_BitVector* hash);
+
 /**
  * Check if one bit vector includes all bit of another. The two bit
  * vectors must be the same size.  Returns DPS_FALSE is bv1 has no
@@ -170,6 +255,30 @@ DPS_Status DPS_BitVectorFuzzyHash(DPS_BitVector* hash, DPS_BitVector* bv);
  */
 int DPS_BitVectorIncludes(const DPS_BitVector* bv1, const DPS_BitVector* bv2);
 
+/**
+ * Find the next bit that is set in a bit vector
+ *
+ * @param bv    An initialized bit vector
+ * @param bit   The bit to start searching from
+ *
+ * @return  The index of the first set bit at or after bit, or the
+ *          length of the bit vector if there are no more set bits.
+ */
+size_t DPS_BitVectorNextBit(const DPS_BitVector* bv, size_t bit);
+
+/**
+ * Check if two bit vectors have any bits in common. The two bit
+ * vectors must be the same size.
+ *
+ * @param bv1   An initialized bit vector
+ * @param bv2   An initialized bit vector
+ *
+ * @return
+ * - DPS_TRUE  if at least one bit is set in both bit vectors
+ * - DPS_FALSE if the bit vectors have no bits in common
+ */
+int DPS_BitVectorIntersects(const DPS_BitVector* bv1, const DPS_BitVector* bv2);
+
 /**
  * Check if two bit vectors are identical.
  *
@@ -259,7 +368,9 @@ size_t DPS_BitVectorSerializeMaxSize(DPS_BitVector* bv);
 size_t DPS_BitVectorSerializeFHSize(void);
 
 /**
- * Deserialize and decompress a bit vector from a buffer
+ * Deserialize and decompress a bit vector from a buffer. If the
+ * serialized bit vector has a different length it is folded to the
+ * length of the bit vector passed in.
  *
  * @param bv      Allocated bit vector to deserialize into
  * @param buffer  The buffer containing a serialized bit vector
@@ -392,6 +503,51 @@ DPS_BitVector* DPS_CountVectorToUnion(DPS_CountVector* cv);
  */
 DPS_BitVector* DPS_CountVectorToIntersection(DPS_CountVector* cv);
 
+/**
+ * Returns the revision of a count vector. The revision is incremented
+ * each time a bit vector is added to or deleted from the count vector.
+ *
+ * @param cv An initialized count vector
+ *
+ * @return  The revision, this is never zero for an initialized count vector
+ */
+uint64_t DPS_CountVectorRevision(const DPS_CountVector* cv);
+
+/**
+ * Incrementally updates a bit vector to the union of the bit vectors
+ * added to a count vector excluding the contribution of one of those
+ * bit vectors. Only the chunks that have changed since the specified
+ * revision of the count vector are recomputed. If the output bit vector
+ * is shorter than the count vector the union is folded to the output
+ * length.
+ *
+ * @param bvOut     The union to update, the length must divide the count vector length
+ * @param delta     Optional, the bits that changed in bvOut are toggled in
+ *                  delta so deltas accumulate until it is cleared, must be
+ *                  the same length as bvOut
+ * @param cv        A count vector allocated by DPS_CountVectorAlloc()
+ * @param excl      Optional bit vector to exclude, this must have been added to the count vector
+ * @param revision  The count vector revision bvOut was last updated to or
+ *                  zero to recompute the entire union
+ * @param same      Optional, returns non-zero if bvOut did not change
+ *
+ * @return DPS_OK if the union was updated, an error otherwise
+ */
+DPS_Status DPS_CountVectorUpdateUnion(DPS_BitVector* bvOut, DPS_BitVector* delta, const DPS_CountVector* cv,
+                                      const DPS_BitVector* excl, uint64_t revision, int* same);
+
+/**
+ * Computes the intersection of the bit vectors added to a count vector
+ * excluding one of those bit vectors into a preallocated bit vector.
+ *
+ * @param bvOut  Returns the intersection, must be the same length as the count vector
+ * @param cv     An initialized count vector
+ * @param excl   Optional bit vector to exclude, this must have been added to the count vector
+ *
+ * @return DPS_OK if the intersection was computed, an error otherwise
+ */
+DPS_Status DPS_CountVectorIntersectionExcluding(DPS_BitVector* bvOut, const DPS_CountVector* cv, const DPS_BitVector* excl);
+
 /**
  * Print a count vector.
  *
@@ -897,6 +897,11 @@ DPS_Status DPS_ParseMapNext(CBOR_MapState* mapState, int32_t* key)
     if (mapState->result != DPS_OK) {
         return mapState->result;
     }
+    /*
+     * Entries for keys that are not wanted may be skipped without
+     * finding another key, in that case no key is returned.
+     */
+    *key = 0;
     mapState->result = DPS_ERR_MISSING;
     while (mapState->entries && (mapState->needKeys || mapState->wantKeys)) {
         --mapState->entries;
@@ -984,6 +989,255 @@ int DPS_ParseMapDone(CBOR_MapState* mapState)
     }
 }
 
+static DPS_Status DecodeField(DPS_RxBuffer* buffer, const CBOR_MapField* field, uint8_t* val)
+{
+    CBOR_Span* span = (CBOR_Span*)val;
+    DPS_Status ret;
+    char* str;
+    size_t len;
+
+    switch (field->type) {
+    case CBOR_FIELD_UINT8:
+        return CBOR_DecodeUint8(buffer, (uint8_t*)val);
+    case CBOR_FIELD_UINT16:
+        return CBOR_DecodeUint16(buffer, (uint16_t*)val);
+    case CBOR_FIELD_UINT32:
+        return CBOR_DecodeUint32(buffer, (uint32_t*)val);
+    case CBOR_FIELD_INT16:
+        return CBOR_DecodeInt16(buffer, (int16_t*)val);
+    case CBOR_FIELD_BOOLEAN:
+        return CBOR_DecodeBoolean(buffer, (int*)val);
+    case CBOR_FIELD_UUID:
+        return CBOR_DecodeUUID(buffer, (DPS_UUID*)val);
+    case CBOR_FIELD_BYTES:
+        return CBOR_DecodeBytes(buffer, &span->data, &span->len);
+    case CBOR_FIELD_STRING:
+        ret = CBOR_DecodeString(buffer, &str, &len);
+        if (ret == DPS_OK) {
+            span->data = (uint8_t*)str;
+            span->len = len;
+        }
+        return ret;
+    case CBOR_FIELD_RAW:
+        ret = CBOR_Skip(buffer, NULL, &len);
+        if (ret == DPS_OK) {
+            span->data = buffer->rxPos - len;
+            span->len = len;
+        }
+        return ret;
+    default:
+        return DPS_ERR_ARGS;
+    }
+}
+
+DPS_Status DPS_ParseMapFields(DPS_RxBuffer* buffer, const CBOR_MapField* fields, size_t numFields,
+                              void* dest, uint32_t* found)
+{
+    DPS_Status ret;
+    size_t entries;
+    size_t i = 0;
+    uint32_t mask = 0;
+    int32_t key;
+
+    assert(numFields <= CBOR_MAP_FIELDS_MAX);
+    ret = CBOR_DecodeMap(buffer, &entries);
+    while ((ret == DPS_OK) && entries) {
+        --entries;
+        ret = CBOR_DecodeInt32(buffer, &key);
+        if (ret != DPS_OK) {
+            break;
+        }
+        /*
+         * Keys are in ascending order so any field passed over is absent
+         */
+        while ((i < numFields) && (fields[i].key < key)) {
+            if (!(fields[i].flags & CBOR_FIELD_OPTIONAL)) {
+                ret = DPS_ERR_MISSING;
+                break;
+            }
+            ++i;
+        }
+        if (ret != DPS_OK) {
+            break;
+        }
+        if ((i < numFields) && (fields[i].key == key)) {
+            ret = DecodeField(buffer, &fields[i], (uint8_t*)dest + fields[i].offset);
+            mask |= (uint32_t)1 << i;
+            ++i;
+        } else {
+            /*
+             * Skip map entries for keys we are not looking for
+             */
+            ret = CBOR_Skip(buffer, NULL, NULL);
+        }
+    }
+    for (; (ret == DPS_OK) && (i < numFields); ++i) {
+        if (!(fields[i].flags & CBOR_FIELD_OPTIONAL)) {
+            ret = DPS_ERR_MISSING;
+        }
+    }
+    if (found) {
+        *found = mask;
+    }
+    return ret;
+}
+
+static size_t SizeOfField(const CBOR_MapField* field, const uint8_t* val)
+{
+    const CBOR_Span* span = (const CBOR_Span*)val;
+
+    switch (field->type) {
+    case CBOR_FIELD_UINT8:
+        return CBOR_SIZEOF_UINT(*(const uint8_t*)val);
+    case CBOR_FIELD_UINT16:
+        if (field->flags & CBOR_FIELD_FIXED) {
+            return CBOR_SIZEOF(uint16_t);
+        }
+        return CBOR_SIZEOF_UINT(*(const uint16_t*)val);
+    case CBOR_FIELD_UINT32:
+        return CBOR_SIZEOF_UINT(*(const uint32_t*)val);
+    case CBOR_FIELD_INT16:
+        if (field->flags & CBOR_FIELD_FIXED) {
+            return CBOR_SIZEOF(int16_t);
+        }
+        return CBOR_SIZEOF_INT(*(const int16_t*)val);
+    case CBOR_FIELD_BOOLEAN:
+        return CBOR_SIZEOF_BOOLEAN();
+    case CBOR_FIELD_UUID:
+        return CBOR_SIZEOF_BYTES(sizeof(DPS_UUID));
+    case CBOR_FIELD_BYTES:
+        return CBOR_SIZEOF_BYTES(span->len);
+    case CBOR_FIELD_STRING:
+        return CBOR_SIZEOF_STRING_AND_LENGTH(span->len);
+    case CBOR_FIELD_RAW:
+        return span->len;
+    default:
+        return 0;
+    }
+}
+
+size_t CBOR_SizeOfMapFields(const CBOR_MapField* fields, size_t numFields, const void* src, uint32_t present)
+{
+    size_t len = 0;
+    size_t n = 0;
+    size_t i;
+
+    assert(numFields <= CBOR_MAP_FIELDS_MAX);
+    for (i = 0; i < numFields; ++i) {
+        if (present & ((uint32_t)1 << i)) {
+            len += CBOR_SIZEOF_INT(fields[i].key) + SizeOfField(&fields[i], (const uint8_t*)src + fields[i].offset);
+            ++n;
+        }
+    }
+    return len + CBOR_SIZEOF_MAP(n);
+}
+
+static DPS_Status EncodeFixed16(DPS_TxBuffer* buffer, uint16_t n, uint8_t maj)
+{
+    if (DPS_TxBufferSpace(buffer) < CBOR_SIZEOF(uint16_t)) {
+        return DPS_ERR_OVERFLOW;
+    }
+    buffer->txPos[0] = (uint8_t)(maj | CBOR_LEN2);
+    buffer->txPos[1] = (uint8_t)(n >> 8);
+    buffer->txPos[2] = (uint8_t)(n);
+    buffer->txPos += CBOR_SIZEOF(uint16_t);
+    return DPS_OK;
+}
+
+static DPS_Status EncodeField(DPS_TxBuffer* buffer, const CBOR_MapField* field, const uint8_t* val)
+{
+    const CBOR_Span* span = (const CBOR_Span*)val;
+    int16_t i16;
+
+    switch (field->type) {
+    case CBOR_FIELD_UINT8:
+        return CBOR_EncodeUint8(buffer, *(const uint8_t*)val);
+    case CBOR_FIELD_UINT16:
+        if (field->flags & CBOR_FIELD_FIXED) {
+            return EncodeFixed16(buffer, *(const uint16_t*)val, CBOR_UINT);
+        }
+        return CBOR_EncodeUint16(buffer, *(const uint16_t*)val);
+    case CBOR_FIELD_UINT32:
+        return CBOR_EncodeUint32(buffer, *(const uint32_t*)val);
+    case CBOR_FIELD_INT16:
+        i16 = *(const int16_t*)val;
+        if (field->flags & CBOR_FIELD_FIXED) {
+            if (i16 < 0) {
+                return EncodeFixed16(buffer, (uint16_t)~i16, CBOR_NEG);
+            } else {
+                return EncodeFixed16(buffer, (uint16_t)i16, CBOR_UINT);
+            }
+        }
+        return CBOR_EncodeInt16(buffer, i16);
+    case CBOR_FIELD_BOOLEAN:
+        return CBOR_EncodeBoolean(buffer, *(const int*)val);
+    case CBOR_FIELD_UUID:
+        return CBOR_EncodeUUID(buffer, (const DPS_UUID*)val);
+    case CBOR_FIELD_BYTES:
+        return CBOR_EncodeBytes(buffer, span->data, span->len);
+    case CBOR_FIELD_STRING:
+        return CBOR_EncodeStringAndLength(buffer, (const char*)span->data, span->len);
+    case CBOR_FIELD_RAW:
+        return CBOR_Copy(buffer, span->data, span->len);
+    default:
+        return DPS_ERR_ARGS;
+    }
+}
+
+DPS_Status CBOR_EncodeMapFields(DPS_TxBuffer* buffer, const CBOR_MapField* fields, size_t numFields,
+                                const void* src, uint32_t present, uint8_t** pos)
+{
+    DPS_Status ret;
+    size_t n = 0;
+    size_t i;
+
+    assert(numFields <= CBOR_MAP_FIELDS_MAX);
+    for (i = 0; i < numFields; ++i) {
+        if (present & ((uint32_t)1 << i)) {
+            ++n;
+        }
+    }
+    ret = CBOR_EncodeMap(buffer, n);
+    for (i = 0; (ret == DPS_OK) && (i < numFields); ++i) {
+        if (pos) {
+            pos[i] = NULL;
+        }
+        if (!(present & ((uint32_t)1 << i))) {
+            continue;
+        }
+        ret = CBOR_EncodeInt32(buffer, fields[i].key);
+        if (ret == DPS_OK) {
+            if (pos) {
+                pos[i] = buffer->txPos;
+            }
+            ret = EncodeField(buffer, &fields[i], (const uint8_t*)src + fields[i].offset);
+        }
+    }
+    return ret;
+}
+
+static void Patch16(uint8_t* pos, uint16_t n, uint8_t maj)
+{
+    assert((pos[0] & 0x1F) == CBOR_LEN2);
+    pos[0] = (uint8_t)(maj | CBOR_LEN2);
+    pos[1] = (uint8_t)(n >> 8);
+    pos[2] = (uint8_t)(n);
+}
+
+void CBOR_PatchInt16(uint8_t* pos, int16_t n)
+{
+    if (n < 0) {
+        Patch16(pos, (uint16_t)~n, CBOR_NEG);
+    } else {
+        Patch16(pos, (uint16_t)n, CBOR_UINT);
+    }
+}
+
+void CBOR_PatchUint16(uint8_t* pos, uint16_t n)
+{
+    Patch16(pos, n, CBOR_UINT);
+}
+
 #ifdef DPS_DEBUG
 static DPS_Status Dump(DPS_RxBuffer* buffer, int in)
 {
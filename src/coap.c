@@ -300,12 +300,8 @@ void CoAP_DumpOpt(const CoAP_Option* opt)
 static const char DPS_PublicationURI[] = "dps/pub";
 static const uint8_t DPS_ContentFormat = COAP_FORMAT_APPLICATION_CBOR;
 
-DPS_Status CoAP_Wrap(uv_buf_t* bufs, size_t numBufs)
+DPS_Status CoAP_WrapTemplate(DPS_TxBuffer* buf)
 {
-    DPS_Status ret;
-    DPS_TxBuffer coap;
-    size_t i;
-    size_t len = 0;
     CoAP_Option opts[2];
 
     opts[0].id = COAP_OPT_URI_PATH;
@@ -314,14 +310,9 @@ DPS_Status CoAP_Wrap(uv_buf_t* bufs, size_t numBufs)
     opts[1].id = COAP_OPT_CONTENT_FORMAT;
     opts[1].val = (uint8_t*)&DPS_ContentFormat;
     opts[1].len = sizeof(DPS_ContentFormat);
-
-    for (i = 1; i < numBufs; ++i) {
-        len += bufs[i].len;
-    }
-    ret = CoAP_Compose(COAP_CODE(COAP_REQUEST, COAP_PUT), opts, A_SIZEOF(opts), len, &coap);
-    if (ret == DPS_OK) {
-        bufs[0].base = (void*)coap.base;
-        bufs[0].len = DPS_TxBufferUsed(&coap);
-    }
-    return ret;
+    /*
+     * Publications are never empty so the template always includes
+     * the end of options marker
+     */
+    return CoAP_Compose(COAP_CODE(COAP_REQUEST, COAP_PUT), opts, A_SIZEOF(opts), 1, buf);
 }
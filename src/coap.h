@@ -85,6 +85,8 @@ extern "C" {
 
 #define COAP_END_OF_OPTS   0xFF /**< End of options tag */
 
+#define COAP_MSG_ID_OFFSET 2    /**< Offset of the big-endian message ID in a CoAP header */
+
 /*
  * Media types
  */
@@ -155,14 +157,16 @@ DPS_Status CoAP_Compose(uint8_t code, const CoAP_Option* opts, size_t numOpts, s
 void CoAP_DumpOpt(const CoAP_Option* opt);
 
 /**
- * Wrap a multicast DPS publication in a CoAP envelope.
+ * Compose the CoAP envelope for multicast DPS publications. The
+ * envelope is the same for every publication apart from the message
+ * ID so it can be composed once and copied in front of each
+ * publication, updating the message ID at COAP_MSG_ID_OFFSET.
  *
- * @param bufs     Array holding pointers to the publication buffers
- * @param numBufs  The length of the bufs array
+ * @param buf  Returns the envelope, must be freed by the caller
  *
- * @return   Returns DPS_OK if the publication was wrapped or an error if the operation failed.
+ * @return   Returns DPS_OK if the envelope was composed or an error if the operation failed.
  */
-DPS_Status CoAP_Wrap(uv_buf_t* bufs, size_t numBufs);
+DPS_Status CoAP_WrapTemplate(DPS_TxBuffer* buf);
 
 #ifdef __cplusplus
 }
@@ -1398,6 +1398,8 @@ DPS_Status COSE_Decrypt(const uint8_t* nonce, COSE_Entity* recipient, DPS_RxBuff
     uint8_t secret[ECDH_MAX_SHARED_SECRET_LEN];
     size_t secretLen;
     COSE_Key cek;
+    uint8_t* storage;
+    size_t capacity;
     size_t i;
 
     DPS_DBGTRACE();
@@ -1406,6 +1408,11 @@ DPS_Status COSE_Decrypt(const uint8_t* nonce, COSE_Entity* recipient, DPS_RxBuff
         return DPS_ERR_ARGS;
     }
 
+    /*
+     * Decrypt into the caller's storage if there is any
+     */
+    storage = plainText->base;
+    capacity = storage ? DPS_TxBufferCapacity(plainText) : 0;
     DPS_TxBufferClear(plainText);
     DPS_TxBufferClear(&AAD);
     DPS_TxBufferClear(&kdfContext);
@@ -1579,7 +1586,15 @@ DPS_Status COSE_Decrypt(const uint8_t* nonce, COSE_Entity* recipient, DPS_RxBuff
         /*
          * Call the decryption algorithm
          */
-        ret = DPS_TxBufferInit(plainText, plainText->base, contentLen - M);
+        if (storage) {
+            if ((contentLen - M) > capacity) {
+                ret = DPS_ERR_OVERFLOW;
+                goto Exit;
+            }
+            ret = DPS_TxBufferInit(plainText, storage, contentLen - M);
+        } else {
+            ret = DPS_TxBufferInit(plainText, plainText->base, contentLen - M);
+        }
         if (ret != DPS_OK) {
             goto Exit;
         }
@@ -1598,7 +1613,11 @@ Exit:
     DPS_TxBufferFree(&kdfContext);
     DPS_TxBufferFree(&AAD);
     if (ret != DPS_OK) {
-        DPS_TxBufferFree(plainText);
+        if (storage) {
+            DPS_TxBufferClear(plainText);
+        } else {
+            DPS_TxBufferFree(plainText);
+        }
     }
     return ret;
 }
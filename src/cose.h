@@ -118,8 +118,9 @@ DPS_Status COSE_Encrypt(int8_t alg,
  * @param signer     Returns the recipient information used to successfully verify the signed cipherText.
  *                   Note that this points into cipherText so care must be taken to avoid
  *                   referencing freed memory.  This will be memset to 0 if not verified.
- * @param plainText  Buffer for returning the decrypted payload. The storage for this
- *                   buffer is allocated by this function and must be freed by the caller.
+ * @param plainText  Buffer for returning the decrypted payload. If the buffer has
+ *                   storage the payload is decrypted into it, otherwise the storage
+ *                   is allocated by this function and must be freed by the caller.
  *
  * @return
  * - DPS_OK if the payload was successfully decrypted
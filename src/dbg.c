@@ -21,9 +21,16 @@
  */
 
 #include <dps/dbg.h>
+#include <dps/dps.h>
 #include <safe_lib.h>
 #include <uv.h>
 #include <stdarg.h>
+#include <stdlib.h>
+#ifndef _WIN32
+#include <pthread.h>
+#include <syslog.h>
+#endif
+#include "compat.h"
 
 int DPS_Debug = 1;
 
@@ -33,20 +40,527 @@ static const char* LevelTxt[] = { "ERROR", "WARNING", "" /* PRINT */, "" /* PRIN
 
 #define stream stdout
 
+/*
+ * Longest formatted message when using a sink, longer messages are truncated
+ */
+#define LOG_MAX_MSG      1024
+
+/*
+ * Size of each thread's ring buffer, this must be a power of 2
+ */
+#define LOG_RING_SIZE    (64 * 1024)
+
+/*
+ * Number of source files that can be rate limited
+ */
+#define LOG_RATE_SLOTS   128
+
+/*
+ * How often the logging thread drains the ring buffers
+ */
+#define LOG_DRAIN_MSECS  10
+
+#if defined(__GNUC__) || defined(__MINGW64__)
+#define LOAD_ACQUIRE(p)      __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(p, v)  __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define FETCH_ADD(p, v)      __atomic_fetch_add((p), (v), __ATOMIC_RELAXED)
+#define ATOMIC_INC(p)        __atomic_add_fetch((p), 1, __ATOMIC_SEQ_CST)
+#define ATOMIC_DEC(p)        __atomic_sub_fetch((p), 1, __ATOMIC_SEQ_CST)
+#define ATOMIC_LOAD(p)       __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define ATOMIC_STORE(p, v)   __atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define LOAD_ACQUIRE(p)      (*(volatile uint64_t*)(p))
+#define STORE_RELEASE(p, v)  (*(volatile uint64_t*)(p) = (v))
+#define FETCH_ADD(p, v)      (uint64_t)_InterlockedExchangeAdd64((volatile __int64*)(p), (__int64)(v))
+#define ATOMIC_INC(p)        _InterlockedIncrement((volatile long*)(p))
+#define ATOMIC_DEC(p)        _InterlockedDecrement((volatile long*)(p))
+#define ATOMIC_LOAD(p)       _InterlockedCompareExchange((volatile long*)(p), 0, 0)
+#define ATOMIC_STORE(p, v)   _InterlockedExchange((volatile long*)(p), (long)(v))
+#endif
+
+/*
+ * Level of a record that pads the rest of the ring buffer
+ */
+#define LOG_PAD  UINT32_MAX
+
+typedef struct {
+    uint32_t len;
+    uint32_t level;
+} LogRecord;
+
+#define RECORD_SIZE(len)  ((sizeof(LogRecord) + (len) + 7) & ~(size_t)7)
+
+/*
+ * Single producer, single consumer ring buffer. Each thread that logs
+ * asynchronously has one and only that thread writes to it. When the
+ * thread exits the ring is released and handed to the next thread that
+ * needs one.
+ */
+typedef struct _LogRing {
+    struct _LogRing* next;
+    uint64_t head;      /* Advanced by the thread that owns the ring */
+    uint64_t tail;      /* Advanced by the thread draining the ring */
+    uint64_t signaled;  /* Set by the owning thread after waking the logging thread */
+    int released;       /* Set when the owning thread exits, protected by the logger mutex */
+    uint8_t buf[LOG_RING_SIZE];
+} LogRing;
+
+typedef struct {
+    const char* file;
+    uint64_t second;
+    uint64_t count;
+} RateSlot;
+
 static uv_once_t once = UV_ONCE_INIT;
-static uv_mutex_t mutex;
 
-static void InitMutex(void)
+static struct {
+    uv_mutex_t mutex;
+    uv_cond_t cond;
+    uv_thread_t thread;
+    DPS_LogSink sink;
+    void* data;
+    volatile int async;
+    int writers;          /* Number of threads writing to their ring */
+    int stop;
+    LogRing* rings;       /* Rings are never freed, released rings are reused */
+    uint32_t rateLimit;
+    uint64_t dropped;
+    RateSlot rates[LOG_RATE_SLOTS];
+} logger;
+
+static THREAD LogRing* threadRing;
+
+#ifdef DPS_DEBUG
+int _DPS_NumLogRings = 0;
+#endif
+
+/*
+ * Thread local key used to release a thread's ring when the thread exits
+ */
+#ifdef _WIN32
+static DWORD ringKey = FLS_OUT_OF_INDEXES;
+#else
+static pthread_key_t ringKey;
+static int ringKeyValid;
+#endif
+
+#ifdef _WIN32
+static VOID WINAPI ReleaseRing(PVOID arg)
+#else
+static void ReleaseRing(void* arg)
+#endif
+{
+    LogRing* ring = arg;
+
+    /*
+     * This runs on the exiting thread, anything it logs after this
+     * point goes to a newly acquired ring
+     */
+    threadRing = NULL;
+    if (ring) {
+        uv_mutex_lock(&logger.mutex);
+        ring->released = DPS_TRUE;
+        uv_mutex_unlock(&logger.mutex);
+    }
+}
+
+static void InitLogger(void)
+{
+    uv_mutex_init(&logger.mutex);
+    uv_cond_init(&logger.cond);
+#ifdef _WIN32
+    ringKey = FlsAlloc(ReleaseRing);
+#else
+    ringKeyValid = (pthread_key_create(&ringKey, ReleaseRing) == 0);
+#endif
+}
+
+static RateSlot* GetRateSlot(const char* file)
+{
+    size_t h = (size_t)(((uintptr_t)file >> 3) * 2654435761u);
+    size_t i;
+
+    for (i = 0; i < LOG_RATE_SLOTS; ++i) {
+        RateSlot* slot = &logger.rates[(h + i) % LOG_RATE_SLOTS];
+        const char* f;
+#if defined(__GNUC__) || defined(__MINGW64__)
+        f = __atomic_load_n(&slot->file, __ATOMIC_ACQUIRE);
+        if (!f) {
+            if (__atomic_compare_exchange_n(&slot->file, &f, file, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                return slot;
+            }
+        }
+#else
+        f = _InterlockedCompareExchangePointer((void* volatile*)&slot->file, (void*)file, NULL);
+        if (!f) {
+            return slot;
+        }
+#endif
+        if (f == file) {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Approximate per-file limit on the number of messages per second,
+ * concurrent callers may let a few extra messages through
+ */
+static int RateLimited(DPS_LogLevel level, const char* file)
+{
+    uint32_t limit = logger.rateLimit;
+    RateSlot* slot;
+    uint64_t now;
+
+    if (!limit || (level == DPS_LOG_PRINT) || (level == DPS_LOG_PRINTT)) {
+        return DPS_FALSE;
+    }
+    slot = GetRateSlot(file);
+    if (!slot) {
+        return DPS_FALSE;
+    }
+    now = uv_hrtime() / 1000000000;
+    if (LOAD_ACQUIRE(&slot->second) != now) {
+        STORE_RELEASE(&slot->second, now);
+        STORE_RELEASE(&slot->count, 0);
+    }
+    if (FETCH_ADD(&slot->count, 1) >= limit) {
+        FETCH_ADD(&logger.dropped, 1);
+        return DPS_TRUE;
+    }
+    return DPS_FALSE;
+}
+
+static size_t FormatPrefix(char* buf, size_t size, DPS_LogLevel level, const char* file, int line,
+                           const char* function)
+{
+    int n = 0;
+
+    switch (level) {
+    case DPS_LOG_ERROR:
+    case DPS_LOG_WARNING:
+    case DPS_LOG_DBGPRINT:
+        n = snprintf(buf, size, "%09u %-7s %s@%d: ", DPS_DBG_TIME, LevelTxt[level], file, line);
+        break;
+    case DPS_LOG_PRINTT:
+        n = snprintf(buf, size, "%09u ", DPS_DBG_TIME);
+        break;
+    case DPS_LOG_PRINT:
+        break;
+    case DPS_LOG_DBGTRACE:
+        n = snprintf(buf, size, "%09u %-7s %s@%d: %s() ", DPS_DBG_TIME, LevelTxt[level], file, line, function);
+        break;
+    }
+    if (n < 0) {
+        n = 0;
+    } else if ((size_t)n >= size) {
+        n = size - 1;
+    }
+    return n;
+}
+
+static int PutRecord(LogRing* ring, DPS_LogLevel level, const char* msg, size_t len)
+{
+    size_t sz = RECORD_SIZE(len);
+    uint64_t head = ring->head;
+    uint64_t tail = LOAD_ACQUIRE(&ring->tail);
+    size_t off = head & (LOG_RING_SIZE - 1);
+    size_t pad = 0;
+    LogRecord* rec;
+
+    /*
+     * Records are not split across the end of the ring
+     */
+    if ((off + sz) > LOG_RING_SIZE) {
+        pad = LOG_RING_SIZE - off;
+    }
+    if (((head - tail) + pad + sz) > LOG_RING_SIZE) {
+        return DPS_FALSE;
+    }
+    if (pad) {
+        rec = (LogRecord*)(ring->buf + off);
+        rec->len = 0;
+        rec->level = LOG_PAD;
+        head += pad;
+        off = 0;
+    }
+    rec = (LogRecord*)(ring->buf + off);
+    rec->len = (uint32_t)len;
+    rec->level = level;
+    memcpy(rec + 1, msg, len);
+    STORE_RELEASE(&ring->head, head + sz);
+    return DPS_TRUE;
+}
+
+/*
+ * Returns a ring released by a thread that has exited or a new ring
+ */
+static LogRing* AcquireRing(void)
+{
+    LogRing* ring;
+
+    uv_mutex_lock(&logger.mutex);
+    for (ring = logger.rings; ring; ring = ring->next) {
+        if (ring->released) {
+            ring->released = DPS_FALSE;
+            break;
+        }
+    }
+    if (!ring) {
+        ring = calloc(1, sizeof(LogRing));
+        if (ring) {
+            ring->next = logger.rings;
+            logger.rings = ring;
+#ifdef DPS_DEBUG
+            ++_DPS_NumLogRings;
+#endif
+        }
+    }
+    uv_mutex_unlock(&logger.mutex);
+    if (ring) {
+#ifdef _WIN32
+        if (ringKey != FLS_OUT_OF_INDEXES) {
+            FlsSetValue(ringKey, ring);
+        }
+#else
+        if (ringKeyValid) {
+            pthread_setspecific(ringKey, ring);
+        }
+#endif
+    }
+    return ring;
+}
+
+static void Enqueue(DPS_LogLevel level, const char* msg, size_t len)
+{
+    LogRing* ring = threadRing;
+
+    if (!ring) {
+        ring = AcquireRing();
+        threadRing = ring;
+    }
+    if (!ring || !PutRecord(ring, level, msg, len)) {
+        FETCH_ADD(&logger.dropped, 1);
+        return;
+    }
+    /*
+     * Wake the logging thread early when a burst of messages has half
+     * filled the ring, the lock is not needed to signal
+     */
+    if ((ring->head - LOAD_ACQUIRE(&ring->tail)) >= (LOG_RING_SIZE / 2) && !LOAD_ACQUIRE(&ring->signaled)) {
+        STORE_RELEASE(&ring->signaled, 1);
+        uv_cond_signal(&logger.cond);
+    }
+}
+
+static void Flush(DPS_LogSink sink, void* data)
 {
-    uv_mutex_init(&mutex);
+    if (sink == DPS_LogFileSink) {
+        fflush(data ? (FILE*)data : stream);
+    }
+}
+
+/*
+ * Passes a formatted message to the ring buffer or directly to the sink
+ */
+static void Output(DPS_LogLevel level, const char* msg, size_t len)
+{
+    int queued = DPS_FALSE;
+
+    if (logger.async) {
+        /*
+         * Count the writer before checking again so that stopping
+         * waits for the message to reach the ring
+         */
+        ATOMIC_INC(&logger.writers);
+        if (ATOMIC_LOAD(&logger.async)) {
+            Enqueue(level, msg, len);
+            queued = DPS_TRUE;
+        }
+        ATOMIC_DEC(&logger.writers);
+    }
+    if (!queued) {
+        DPS_LogSink sink;
+        void* data;
+
+        uv_mutex_lock(&logger.mutex);
+        sink = logger.sink ? logger.sink : DPS_LogFileSink;
+        data = logger.sink ? logger.data : NULL;
+        sink(level, msg, len, data);
+        Flush(sink, data);
+        uv_mutex_unlock(&logger.mutex);
+    }
+}
+
+static size_t Drain(LogRing* ring, DPS_LogSink sink, void* data)
+{
+    uint64_t tail = ring->tail;
+    uint64_t head = LOAD_ACQUIRE(&ring->head);
+    size_t n = 0;
+
+    while (tail != head) {
+        size_t off = tail & (LOG_RING_SIZE - 1);
+        LogRecord* rec = (LogRecord*)(ring->buf + off);
+        if (rec->level == LOG_PAD) {
+            tail += LOG_RING_SIZE - off;
+        } else {
+            sink((DPS_LogLevel)rec->level, (const char*)(rec + 1), rec->len, data);
+            tail += RECORD_SIZE(rec->len);
+            ++n;
+        }
+        STORE_RELEASE(&ring->tail, tail);
+    }
+    return n;
+}
+
+static void DrainThread(void* arg)
+{
+    DPS_LogSink sink;
+    void* data;
+    LogRing* rings;
+    LogRing* ring;
+    size_t n;
+    int stop;
+
+    uv_mutex_lock(&logger.mutex);
+    do {
+        stop = logger.stop;
+        if (stop) {
+            /*
+             * Let threads that are still writing finish so the last
+             * drain picks up their messages
+             */
+            while (ATOMIC_LOAD(&logger.writers)) {
+                uv_cond_timedwait(&logger.cond, &logger.mutex, 1000000ull);
+            }
+        }
+        /*
+         * Rings are only ever added at the head of the list so the
+         * list can be walked without holding the lock
+         */
+        rings = logger.rings;
+        sink = logger.sink ? logger.sink : DPS_LogFileSink;
+        data = logger.sink ? logger.data : NULL;
+        uv_mutex_unlock(&logger.mutex);
+        n = 0;
+        for (ring = rings; ring; ring = ring->next) {
+            n += Drain(ring, sink, data);
+            STORE_RELEASE(&ring->signaled, 0);
+        }
+        if (n) {
+            Flush(sink, data);
+        }
+        uv_mutex_lock(&logger.mutex);
+        if (!stop && !logger.stop) {
+            uv_cond_timedwait(&logger.cond, &logger.mutex, LOG_DRAIN_MSECS * 1000000ull);
+        }
+    } while (!stop);
+    uv_mutex_unlock(&logger.mutex);
+}
+
+void DPS_LogFileSink(DPS_LogLevel level, const char* msg, size_t len, void* data)
+{
+    fwrite(msg, 1, len, data ? (FILE*)data : stream);
+}
+
+#ifndef _WIN32
+void DPS_LogSyslogSink(DPS_LogLevel level, const char* msg, size_t len, void* data)
+{
+    static const int Priority[] = { LOG_ERR, LOG_WARNING, LOG_INFO, LOG_INFO, LOG_DEBUG, LOG_DEBUG };
+
+    if (len && (msg[len - 1] == '\n')) {
+        --len;
+    }
+    syslog(Priority[level], "%.*s", (int)len, msg);
+}
+#endif
+
+void DPS_SetLogSink(DPS_LogSink sink, void* data)
+{
+    uv_once(&once, InitLogger);
+    uv_mutex_lock(&logger.mutex);
+    logger.sink = sink;
+    logger.data = data;
+    uv_mutex_unlock(&logger.mutex);
+}
+
+DPS_Status DPS_StartAsyncLog(void)
+{
+    DPS_Status ret = DPS_OK;
+
+    uv_once(&once, InitLogger);
+    uv_mutex_lock(&logger.mutex);
+    if (!logger.async) {
+        logger.stop = DPS_FALSE;
+        if (uv_thread_create(&logger.thread, DrainThread, NULL) == 0) {
+            logger.async = DPS_TRUE;
+        } else {
+            ret = DPS_ERR_RESOURCES;
+        }
+    }
+    uv_mutex_unlock(&logger.mutex);
+    return ret;
+}
+
+void DPS_StopAsyncLog(void)
+{
+    uv_once(&once, InitLogger);
+    uv_mutex_lock(&logger.mutex);
+    if (!logger.async) {
+        uv_mutex_unlock(&logger.mutex);
+        return;
+    }
+    ATOMIC_STORE(&logger.async, DPS_FALSE);
+    logger.stop = DPS_TRUE;
+    uv_cond_signal(&logger.cond);
+    uv_mutex_unlock(&logger.mutex);
+    uv_thread_join(&logger.thread);
+}
+
+void DPS_SetLogRateLimit(uint32_t perSecond)
+{
+    logger.rateLimit = perSecond;
+}
+
+uint64_t DPS_GetLogDropCount(void)
+{
+    return LOAD_ACQUIRE(&logger.dropped);
 }
 
 void DPS_Log(DPS_LogLevel level, const char* file, int line, const char *function, const char *fmt, ...)
 {
+    char msg[LOG_MAX_MSG];
+    size_t len;
+    int n;
     va_list ap;
+
+    uv_once(&once, InitLogger);
+    if (RateLimited(level, file)) {
+        return;
+    }
     va_start(ap, fmt);
-    uv_once(&once, InitMutex);
-    uv_mutex_lock(&mutex);
+    if (logger.async || logger.sink) {
+        len = FormatPrefix(msg, sizeof(msg), level, file, line, function);
+        n = vsnprintf(msg + len, sizeof(msg) - len, fmt, ap);
+        if (n > 0) {
+            if ((size_t)n < (sizeof(msg) - len)) {
+                len += (size_t)n;
+            } else {
+                /*
+                 * The message was truncated, the byte taken by the
+                 * terminator holds the newline that ends the record
+                 */
+                len = sizeof(msg);
+                msg[len - 1] = '\n';
+            }
+        }
+        Output(level, msg, len);
+        va_end(ap);
+        return;
+    }
+    uv_mutex_lock(&logger.mutex);
     switch (level) {
     case DPS_LOG_ERROR:
     case DPS_LOG_WARNING:
@@ -66,15 +580,37 @@ void DPS_Log(DPS_LogLevel level, const char* file, int line, const char *functio
         break;
     }
     fflush(stream);
-    uv_mutex_unlock(&mutex);
+    uv_mutex_unlock(&logger.mutex);
     va_end(ap);
 }
 
 void DPS_LogBytes(DPS_LogLevel level, const char* file, int line, const char *function, const uint8_t *bytes, size_t n)
 {
+    char msg[LOG_MAX_MSG];
+    size_t len;
     size_t i;
-    uv_once(&once, InitMutex);
-    uv_mutex_lock(&mutex);
+    size_t j;
+
+    uv_once(&once, InitLogger);
+    if (RateLimited(level, file)) {
+        return;
+    }
+    if (logger.async || logger.sink) {
+        /*
+         * Each line of 16 bytes is a separate message
+         */
+        i = 0;
+        do {
+            len = FormatPrefix(msg, sizeof(msg) - (16 * 3) - 1, level, file, line, function);
+            for (j = 0; (j < 16) && (i < n); ++j, ++i) {
+                len += snprintf(msg + len, sizeof(msg) - len, "%02x ", bytes[i]);
+            }
+            msg[len++] = '\n';
+            Output(level, msg, len);
+        } while (i < n);
+        return;
+    }
+    uv_mutex_lock(&logger.mutex);
     for (i = 0; i < n; ++i) {
         if ((i % 16) == 0) {
             fprintf(stream, "%s%09u %-7s %s@%d: ", i ? "\n" : "", DPS_DBG_TIME, LevelTxt[level], file, line);
@@ -83,5 +619,5 @@ void DPS_LogBytes(DPS_LogLevel level, const char* file, int line, const char *fu
     }
     fprintf(stream, "\n");
     fflush(stream);
-    uv_mutex_unlock(&mutex);
+    uv_mutex_unlock(&logger.mutex);
 }
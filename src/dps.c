@@ -34,6 +34,7 @@
 #include "ack.h"
 #include "bitvec.h"
 #include "coap.h"
+#include "compat.h"
 #include "ec.h"
 #include "history.h"
 #include "linkmon.h"
@@ -51,6 +52,11 @@ DPS_DEBUG_CONTROL(DPS_DEBUG_ON);
 
 #define _MIN_(x, y)  (((x) < (y)) ? (x) : (y))
 
+/*
+ * Maximum number of ack routes connections are pre-warmed for
+ */
+#define MAX_PREWARM_CONNECTIONS 16
+
 typedef enum { NO_REQ, SUB_REQ, PUB_REQ, ACK_REQ } RequestType;
 
 typedef enum { LINK_OP, UNLINK_OP } OpType;
@@ -60,6 +66,7 @@ typedef struct _OnOpCompletion {
     void* data;
     DPS_Node* node;
     struct _RemoteNode* remote;
+    DPS_NodeAddressType addrType;
     union {
         DPS_OnLinkComplete link;
         DPS_OnUnlinkComplete unlink;
@@ -209,6 +216,10 @@ static void FreeOutboundInterests(RemoteNode* remote)
     remote->outbound.interests = NULL;
     DPS_BitVectorFree(remote->outbound.needs);
     remote->outbound.needs = NULL;
+    remote->outbound.interestsRev = 0;
+    remote->outbound.needsRev = 0;
+    remote->outbound.deferred = DPS_FALSE;
+    remote->outbound.needsRelaxed = DPS_FALSE;
 }
 
 DPS_Status DPS_ClearOutboundInterests(RemoteNode* remote)
@@ -227,6 +238,13 @@ DPS_Status DPS_ClearOutboundInterests(RemoteNode* remote)
         FreeOutboundInterests(remote);
         return DPS_ERR_RESOURCES;
     } else {
+        /*
+         * The cleared interests are not current to any revision
+         */
+        remote->outbound.interestsRev = 0;
+        remote->outbound.needsRev = 0;
+        remote->outbound.deferred = DPS_FALSE;
+        remote->outbound.needsRelaxed = DPS_FALSE;
         return DPS_OK;
     }
 }
@@ -302,11 +320,35 @@ static const DPS_UUID* MinMeshId(DPS_Node* node, RemoteNode* excluded)
     return minMeshId;
 }
 
+/*
+ * The base interval between subscription updates to a remote node is the
+ * configured update rate or a couple of round trip times on slow links.
+ */
+static uint32_t SubsBaseInterval(DPS_Node* node, RemoteNode* remote)
+{
+    uint32_t interval = 2 * remote->outbound.rtt;
+    return interval > node->subsRate ? interval : node->subsRate;
+}
+
+/*
+ * The time updates that only remove interests are held back for
+ * doubles with each consecutive update up to a limit.
+ */
+static uint64_t SubsHoldOff(DPS_Node* node, RemoteNode* remote)
+{
+    if (remote->outbound.backoff) {
+        return (uint64_t)SubsBaseInterval(node, remote) << (remote->outbound.backoff - 1);
+    } else {
+        return 0;
+    }
+}
+
 DPS_Status DPS_UpdateOutboundInterests(DPS_Node* node, RemoteNode* destNode, uint8_t* send)
 {
     DPS_Status ret;
-    DPS_BitVector* newInterests = NULL;
-    DPS_BitVector* newNeeds = NULL;
+    size_t linkLen;
+    int sameInterests;
+    int sameNeeds;
 
     DPS_DBGTRACE();
 
@@ -319,68 +361,133 @@ DPS_Status DPS_UpdateOutboundInterests(DPS_Node* node, RemoteNode* destNode, uin
         return DPS_OK;
     }
     /*
-     * Inbound interests from the node we are updating are excluded from the
-     * recalculation of outbound interests
+     * If the remote node is configured with a shorter bit length the
+     * interests are folded to the length of the link.
      */
-    if (destNode->inbound.interests) {
-        ret = DPS_CountVectorDel(node->interests, destNode->inbound.interests);
-        if (ret != DPS_OK) {
-            goto ErrExit;
-        }
-        newInterests = DPS_CountVectorToUnion(node->interests);
-        ret = DPS_CountVectorAdd(node->interests, destNode->inbound.interests);
-        if (ret != DPS_OK) {
-            goto ErrExit;
-        }
-        ret = DPS_CountVectorDel(node->needs, destNode->inbound.needs);
-        if (ret != DPS_OK) {
-            goto ErrExit;
-        }
-        newNeeds = DPS_CountVectorToIntersection(node->needs);
-        ret = DPS_CountVectorAdd(node->needs, destNode->inbound.needs);
-        if (ret != DPS_OK) {
-            goto ErrExit;
-        }
-    } else {
-        assert(!destNode->inbound.needs);
-        newInterests = DPS_CountVectorToUnion(node->interests);
-        newNeeds = DPS_CountVectorToIntersection(node->needs);
-    }
-    if (!newNeeds || !newInterests) {
-        ret = DPS_ERR_RESOURCES;
-        goto ErrExit;
-    }
+    linkLen = DPS_BitVectorLinkLen(destNode->inbound.bitLen);
     /*
-     * Send a delta if we have previously sent interests. The needs vector
-     * is small so it is not worth computing a delta.
+     * Send a delta if we have previously sent interests of the same
+     * length. The needs vector is small so it is not worth computing a
+     * delta.
      */
-    if (destNode->outbound.interests) {
-        int same = DPS_FALSE;
+    if (destNode->outbound.interests &&
+        (DPS_BitVectorLen(destNode->outbound.interests) == linkLen)) {
+        if (destNode->outbound.delta && (DPS_BitVectorLen(destNode->outbound.delta) != linkLen)) {
+            DPS_BitVectorFree(destNode->outbound.delta);
+            destNode->outbound.delta = NULL;
+        }
         if (!destNode->outbound.delta) {
-            destNode->outbound.delta = DPS_BitVectorAlloc();
+            destNode->outbound.delta = DPS_BitVectorAllocLen(linkLen);
             if (!destNode->outbound.delta) {
                 ret = DPS_ERR_RESOURCES;
                 goto ErrExit;
             }
-        }
-        DPS_BitVectorXor(destNode->outbound.delta, destNode->outbound.interests, newInterests, &same);
-        if (same) {
-            assert(DPS_BitVectorEquals(destNode->outbound.needs, newNeeds));
-            *send = DPS_FALSE;
-        } else {
-            *send = DPS_TRUE;
+        } else if (!destNode->outbound.deferred) {
+            /*
+             * Changes that are being held back accumulate in the delta
+             */
+            DPS_BitVectorClear(destNode->outbound.delta);
         }
         destNode->outbound.deltaInd = DPS_TRUE;
     } else {
         /*
          * This is not a delta
          */
+        FreeOutboundInterests(destNode);
+        destNode->outbound.interests = DPS_BitVectorAllocLen(linkLen);
+        destNode->outbound.needs = DPS_BitVectorAllocFH();
+        if (!destNode->outbound.interests || !destNode->outbound.needs) {
+            FreeOutboundInterests(destNode);
+            ret = DPS_ERR_RESOURCES;
+            goto ErrExit;
+        }
         destNode->outbound.deltaInd = DPS_FALSE;
+        destNode->outbound.deferred = DPS_FALSE;
+    }
+    /*
+     * The outbound interests are updated in place. Inbound interests from
+     * the node we are updating are excluded and only the chunks that have
+     * changed since the last update are recomputed.
+     */
+    ret = DPS_CountVectorUpdateUnion(destNode->outbound.interests,
+                                     destNode->outbound.deltaInd ? destNode->outbound.delta : NULL,
+                                     node->interests, destNode->inbound.interests,
+                                     destNode->outbound.interestsRev, &sameInterests);
+    if (ret != DPS_OK) {
+        goto ErrExit;
+    }
+    destNode->outbound.interestsRev = DPS_CountVectorRevision(node->interests);
+    /*
+     * Needs only change when the node needs have changed
+     */
+    if (destNode->outbound.needsRev == DPS_CountVectorRevision(node->needs)) {
+        sameNeeds = DPS_TRUE;
+    } else {
+        assert(destNode->inbound.interests || !destNode->inbound.needs);
+        ret = DPS_CountVectorIntersectionExcluding(node->scratch.needs, node->needs, destNode->inbound.needs);
+        if (ret != DPS_OK) {
+            goto ErrExit;
+        }
+        /*
+         * Folding does not preserve the population count of the interests
+         */
+        if (linkLen != DPS_BitVectorLinkLen(0)) {
+            DPS_BitVectorFuzzyHashRelax(node->scratch.needs);
+        }
+        sameNeeds = DPS_BitVectorEquals(destNode->outbound.needs, node->scratch.needs);
+        if (!sameNeeds) {
+            if (!DPS_BitVectorIncludes(node->scratch.needs, destNode->outbound.needs)) {
+                destNode->outbound.needsRelaxed = DPS_TRUE;
+            }
+            DPS_BitVectorDup(destNode->outbound.needs, node->scratch.needs);
+        }
+        destNode->outbound.needsRev = DPS_CountVectorRevision(node->needs);
+    }
+    if (!destNode->outbound.deltaInd) {
+        *send = DPS_TRUE;
+    } else if (sameInterests && sameNeeds && !destNode->outbound.deferred) {
+        /*
+         * Nothing has changed so reduce the hold off. Note that folded
+         * interests can be the same when the needs are not.
+         */
+        if (destNode->outbound.backoff) {
+            --destNode->outbound.backoff;
+        }
+        *send = DPS_FALSE;
+    } else if (destNode->outbound.needsRelaxed ||
+               DPS_BitVectorIntersects(destNode->outbound.delta, destNode->outbound.interests)) {
+        /*
+         * Changes that add interests or relax needs affect which
+         * publications the remote node forwards to us so are not held
+         * back.
+         */
         *send = DPS_TRUE;
+    } else {
+        /*
+         * Changes that only remove interests can be held back
+         */
+        *send = uv_now(node->loop) >= (destNode->outbound.sendTime + SubsHoldOff(node, destNode));
+    }
+    if (*send) {
+        if (destNode->outbound.deltaInd) {
+            /*
+             * Back off further if the interests are still churning
+             * since the last update was sent, otherwise start over.
+             */
+            if (uv_now(node->loop) < (destNode->outbound.sendTime + 2 * SubsBaseInterval(node, destNode))) {
+                if (destNode->outbound.backoff < DPS_MAX_SUBSCRIPTION_BACKOFF) {
+                    ++destNode->outbound.backoff;
+                }
+            } else {
+                destNode->outbound.backoff = 0;
+            }
+        }
+        destNode->outbound.deferred = DPS_FALSE;
+        destNode->outbound.needsRelaxed = DPS_FALSE;
+    } else if (!sameInterests || !sameNeeds) {
+        DPS_DBGPRINT("Holding back interests update to %s\n", DESCRIBE(destNode));
+        destNode->outbound.deferred = DPS_TRUE;
     }
-    FreeOutboundInterests(destNode);
-    destNode->outbound.interests = newInterests;
-    destNode->outbound.needs = newNeeds;
     /*
      * Increment the revision number if we are sending a subscription
      */
@@ -391,12 +498,14 @@ DPS_Status DPS_UpdateOutboundInterests(DPS_Node* node, RemoteNode* destNode, uin
          * cannot exist without interests so we can just send
          * the maximum mesh id.
          */
-        if (DPS_BitVectorIsClear(newInterests)) {
+        if (DPS_BitVectorIsClear(destNode->outbound.interests)) {
             destNode->outbound.meshId = DPS_MaxMeshId;
         } else {
             destNode->outbound.meshId = *(MinMeshId(node, destNode));
         }
         ++destNode->outbound.revision;
+        DPS_SampleLoadFactor(&destNode->bloomStats.outbound, &node->bloomStats.outbound,
+                             destNode->outbound.interests);
     }
     if (DPS_DEBUG_ENABLED() && *send) {
         DPS_DBGPRINT("New outbound interests for %s: ", DESCRIBE(destNode));
@@ -406,9 +515,6 @@ DPS_Status DPS_UpdateOutboundInterests(DPS_Node* node, RemoteNode* destNode, uin
 
 ErrExit:
     DPS_ERRPRINT("DPS_UpdateOutboundInterests: %s\n", DPS_ErrTxt(ret));
-
-    DPS_BitVectorFree(newInterests);
-    DPS_BitVectorFree(newNeeds);
     return ret;
 }
 
@@ -495,6 +601,24 @@ RemoteNode* DPS_LookupRemoteNode(DPS_Node* node, const DPS_NodeAddress* addr)
     return NULL;
 }
 
+static void AddLoadFactorSample(DPS_LoadFactorStats* stats, float loadFactor)
+{
+    stats->current = loadFactor;
+    if (loadFactor > stats->peak) {
+        stats->peak = loadFactor;
+    }
+    ++stats->samples;
+    stats->mean += (loadFactor - stats->mean) / stats->samples;
+}
+
+void DPS_SampleLoadFactor(DPS_LoadFactorStats* link, DPS_LoadFactorStats* node, DPS_BitVector* bv)
+{
+    float loadFactor = bv ? DPS_BitVectorLoadFactor(bv) : 0.0f;
+
+    AddLoadFactorSample(link, loadFactor);
+    AddLoadFactorSample(node, loadFactor);
+}
+
 static OnOpCompletion* AllocCompletion(DPS_Node* node, RemoteNode* remote, OpType op, void* data,
                                        void* cb)
 {
@@ -597,6 +721,18 @@ void DPS_OnSendSubscriptionComplete(DPS_Node* node, void* appCtx, DPS_NetEndpoin
     DPS_NetFreeBufs(bufs, numBufs);
 }
 
+static void SendAggregatedAcks(uv_timer_t* handle)
+{
+    DPS_Node* node = (DPS_Node*)handle->data;
+
+    DPS_DBGTRACE();
+
+    DPS_LockNode(node);
+    DPS_AggregateAcks(node);
+    DPS_UnlockNode(node);
+    uv_async_send(&node->acksAsync);
+}
+
 static void SendAcksTask(uv_async_t* handle)
 {
     DPS_Node* node = (DPS_Node*)handle->data;
@@ -622,6 +758,43 @@ static void SendAcksTask(uv_async_t* handle)
             DPS_AckPublicationCompletion(ack);
         }
     }
+    /*
+     * Pending acks are sent when the aggregation delay expires
+     */
+    if (!DPS_QueueEmpty(&node->pendingAckQueue) && !uv_is_active((uv_handle_t*)&node->acksTimer) &&
+        (node->state == DPS_NODE_RUNNING)) {
+        uv_timer_start(&node->acksTimer, SendAggregatedAcks, node->ackAggregationDelay, 0);
+    }
+    DPS_UnlockNode(node);
+}
+
+static void PrewarmTask(uv_async_t* handle)
+{
+    DPS_Node* node = (DPS_Node*)handle->data;
+    DPS_NodeAddress addrs[MAX_PREWARM_CONNECTIONS];
+    RemoteNode* remote;
+    size_t numAddrs;
+    size_t i;
+    DPS_Status ret;
+
+    DPS_DBGTRACE();
+
+    numAddrs = DPS_LookupAckRoutes(&node->history, addrs, MAX_PREWARM_CONNECTIONS);
+    DPS_LockNode(node);
+    for (i = 0; (i < numAddrs) && (node->state == DPS_NODE_RUNNING); ++i) {
+        /*
+         * Nothing to do if the remote node already has a connection
+         */
+        remote = DPS_LookupRemoteNode(node, &addrs[i]);
+        if (remote && remote->ep.cn) {
+            continue;
+        }
+        ret = DPS_NetPrewarm(node, &addrs[i]);
+        if ((ret != DPS_OK) && (ret != DPS_ERR_EXISTS)) {
+            DPS_WARNPRINT("Failed to pre-warm connection to %s: %s\n", DPS_NodeAddrToString(&addrs[i]),
+                          DPS_ErrTxt(ret));
+        }
+    }
     DPS_UnlockNode(node);
 }
 
@@ -634,6 +807,38 @@ static void PublishCompletion(DPS_PublishRequest* req)
     }
 }
 
+/*
+ * Send a publication to a remote node if the remote node has matching
+ * interests. The caller is responsible for deleting the remote node if
+ * the send fails.
+ */
+static DPS_Status SendPubToRemote(DPS_Node* node, DPS_PublishRequest* req, DPS_Publication* pub, RemoteNode* remote)
+{
+    DPS_DBGPRINT("%s muted=%d/%d,interests=%p\n", DESCRIBE(remote), remote->outbound.muted,
+                 remote->inbound.muted, remote->inbound.interests);
+    if (remote->outbound.muted || remote->inbound.muted || !remote->inbound.interests) {
+        return DPS_OK;
+    }
+    /*
+     * We don't send publications to remote nodes we have received them from.
+     */
+    if (DPS_PublicationReceivedFrom(&node->history, &pub->pubId, req->sequenceNum,
+                                    &pub->senderAddr, &remote->ep.addr)) {
+        return DPS_OK;
+    }
+    /*
+     * This is the pub/sub matching code
+     */
+    DPS_BitVectorIntersection(node->scratch.interests, pub->bf, remote->inbound.interests);
+    DPS_BitVectorFuzzyHash(node->scratch.needs, node->scratch.interests);
+    if (!DPS_BitVectorIncludes(node->scratch.needs, remote->inbound.needs)) {
+        DPS_DBGPRINT("Rejected pub %d for %s\n", req->sequenceNum, DESCRIBE(remote));
+        return DPS_OK;
+    }
+    DPS_DBGPRINT("Sending pub %d to %s\n", req->sequenceNum, DESCRIBE(remote));
+    return DPS_SendPublication(req, pub, remote);
+}
+
 static void SendPubs(DPS_Node* node)
 {
     DPS_Publication* pub;
@@ -690,34 +895,15 @@ static void SendPubs(DPS_Node* node)
             }
             for (remote = node->remoteNodes; remote != NULL; remote = nextRemote) {
                 nextRemote = remote->next;
-                DPS_DBGPRINT("%s muted=%d/%d,interests=%p\n", DESCRIBE(remote), remote->outbound.muted,
-                             remote->inbound.muted, remote->inbound.interests);
-                if (remote->outbound.muted || remote->inbound.muted || !remote->inbound.interests) {
-                    continue;
-                }
-                /*
-                 * We don't send publications to remote nodes we have received them from.
-                 */
-                if (DPS_PublicationReceivedFrom(&node->history, &pub->pubId, req->sequenceNum,
-                                                &pub->senderAddr, &remote->ep.addr)) {
-                    continue;
-                }
-                /*
-                 * This is the pub/sub matching code
-                 */
-                DPS_BitVectorIntersection(node->scratch.interests, pub->bf, remote->inbound.interests);
-                DPS_BitVectorFuzzyHash(node->scratch.needs, node->scratch.interests);
-                if (!DPS_BitVectorIncludes(node->scratch.needs, remote->inbound.needs)) {
-                    DPS_DBGPRINT("Rejected pub %d for %s\n", req->sequenceNum, DESCRIBE(remote));
-                    continue;
-                }
-                DPS_DBGPRINT("Sending pub %d to %s\n", req->sequenceNum, DESCRIBE(remote));
-                ret = DPS_SendPublication(req, pub, remote);
+                ret = SendPubToRemote(node, req, pub, remote);
                 if (ret != DPS_OK) {
                     DPS_DeleteRemoteNode(node, remote);
                     DPS_ERRPRINT("SendPublication (unicast) returned %s\n", DPS_ErrTxt(ret));
                 }
             }
+            if (pub->window) {
+                DPS_ReliableRetain(node, req);
+            }
             if (!DPS_QueueEmpty(&pub->retainedQueue)) {
                 PublishCompletion(expired);
                 expired = (DPS_PublishRequest*)DPS_QueueFront(&pub->retainedQueue);
@@ -727,6 +913,7 @@ static void SendPubs(DPS_Node* node)
                 DPS_QueuePushBack(&pub->retainedQueue, &req->queue);
                 ++req->refCount;
                 reschedule = (req->expires < reschedule) ? req->expires : reschedule;
+                DPS_RetainedIndexAdd(&node->retained, pub);
             }
             DPS_PublishCompletion(req);
         }
@@ -742,7 +929,7 @@ static void SendPubs(DPS_Node* node)
             if (expired && ((pub->flags & PUB_FLAG_EXPIRED) == 0)) {
                 pub->flags |= PUB_FLAG_EXPIRED;
                 pub->ttl = expired->ttl = -1;
-                DPS_CallPubHandlers(expired);
+                DPS_CallPubHandlers(expired, NULL, NULL);
             }
             DPS_ExpirePub(node, pub);
         }
@@ -815,16 +1002,25 @@ static void SendSubsTimer(uv_timer_t* handle)
                 --remote->outbound.ackCountdown;
                 continue;
             }
+            /*
+             * Back off sending updates to a remote that is slow to ACK
+             */
+            if (remote->outbound.backoff < DPS_MAX_SUBSCRIPTION_BACKOFF) {
+                ++remote->outbound.backoff;
+            }
             send = !remote->outbound.subPending;
         } else {
             ret = DPS_UpdateOutboundInterests(node, remote, &send);
             if (ret != DPS_OK) {
                 break;
             }
+            if (remote->outbound.deferred) {
+                reschedule = DPS_TRUE;
+            }
             /*
              * See comment at end of DPS_Link for an explanation of this
              */
-            if (!send && remote->completion) {
+            if (!send && !remote->outbound.deferred && remote->completion) {
                 DPS_RemoteCompletion(node, remote, DPS_OK);
             }
         }
@@ -865,41 +1061,80 @@ static void SendSubsTask(uv_async_t* handle)
     DPS_UnlockNode(node);
 }
 
+typedef struct {
+    DPS_Node* node;
+    RemoteNode* remote;
+    uint64_t now;
+    int count;
+    DPS_Status ret;
+} ReplayContext;
+
+static void ReplayRetainedPub(DPS_Publication* pub, void* data)
+{
+    ReplayContext* ctx = (ReplayContext*)data;
+    DPS_PublishRequest* req;
+
+    if ((ctx->ret != DPS_OK) || DPS_QueueEmpty(&pub->retainedQueue)) {
+        return;
+    }
+    req = (DPS_PublishRequest*)DPS_QueueFront(&pub->retainedQueue);
+    if (req->expires <= ctx->now) {
+        return;
+    }
+    ++ctx->count;
+    ctx->ret = SendPubToRemote(ctx->node, req, pub, ctx->remote);
+}
+
 /*
- * Run checks of the publications against the current subscriptions
+ * Replay retained publications that match the changed interests of a
+ * remote node to that remote node only.
  */
-void DPS_UpdatePubs(DPS_Node* node)
+DPS_Status DPS_UpdatePubs(DPS_Node* node, RemoteNode* remote, const DPS_BitVector* added, int needsRelaxed)
 {
-    int count = 0;
+    ReplayContext ctx;
     DPS_Publication* pub;
     DPS_Publication* nextPub;
-    DPS_PublishRequest* req;
 
     DPS_DBGTRACE();
 
     DPS_LockNode(node);
-    if (node->state != DPS_NODE_RUNNING) {
+    if ((node->state != DPS_NODE_RUNNING) || !remote->inbound.interests) {
         DPS_UnlockNode(node);
-        return;
+        return DPS_OK;
     }
-    for (pub = node->publications; pub != NULL; pub = nextPub) {
-        nextPub = pub->next;
-        if (!DPS_QueueEmpty(&pub->sendQueue)) {
-            ++count;
-        } else if (DPS_QueueEmpty(&pub->retainedQueue)) {
-            DPS_ExpirePub(node, pub);
-        } else if (node->remoteNodes || node->mcastSender) {
-            req = (DPS_PublishRequest*)DPS_QueueFront(&pub->retainedQueue);
-            DPS_QueueRemove(&req->queue);
-            DPS_QueuePushBack(&pub->sendQueue, &req->queue);
-            ++count;
+    ctx.node = node;
+    ctx.remote = remote;
+    ctx.now = uv_now(node->loop);
+    ctx.count = 0;
+    ctx.ret = DPS_OK;
+    if (!needsRelaxed && !node->retained.incomplete) {
+        /*
+         * A publication can only newly match if it has at least one
+         * of the added bits
+         */
+        if (DPS_RetainedIndexMatch(&node->retained, added, ReplayRetainedPub, &ctx) != DPS_OK) {
+            needsRelaxed = DPS_TRUE;
         }
     }
-    if (count) {
-        DPS_DBGPRINT("DPS_UpdatePubs %d publications to send\n", count);
-        uv_async_send(&node->pubsAsync);
+    if (needsRelaxed || node->retained.incomplete) {
+        /*
+         * A publication that did not match before can match with
+         * relaxed needs without having any of the added bits so all
+         * the retained publications have to be checked.
+         */
+        for (pub = node->publications; pub != NULL; pub = nextPub) {
+            nextPub = pub->next;
+            ReplayRetainedPub(pub, &ctx);
+        }
+    }
+    if (ctx.count) {
+        DPS_DBGPRINT("DPS_UpdatePubs %d retained publications checked for %s\n", ctx.count, DESCRIBE(remote));
+    }
+    if (ctx.ret != DPS_OK) {
+        DPS_ERRPRINT("SendPublication (unicast) returned %s\n", DPS_ErrTxt(ctx.ret));
     }
     DPS_UnlockNode(node);
+    return ctx.ret;
 }
 
 void DPS_UpdateSubs(DPS_Node* node)
@@ -921,9 +1156,20 @@ void DPS_QueuePublicationAck(DPS_Node* node, PublicationAck* ack)
     DPS_UnlockNode(node);
 }
 
+void DPS_QueuePendingAck(DPS_Node* node, PublicationAck* ack)
+{
+    DPS_DBGTRACE();
+
+    DPS_LockNode(node);
+    DPS_QueuePushBack(&node->pendingAckQueue, &ack->queue);
+    uv_async_send(&node->acksAsync);
+    DPS_UnlockNode(node);
+}
+
 static DPS_Status DecodeRequest(DPS_Node* node, DPS_NetEndpoint* ep, DPS_NetRxBuffer* buf, int multicast)
 {
     DPS_RxBuffer* rxBuf = (DPS_RxBuffer*)buf;
+    DPS_NetRxBuffer* msgBuf = NULL;
     DPS_Status ret;
     uint8_t msgVersion;
     uint8_t msgType;
@@ -981,6 +1227,30 @@ static DPS_Status DecodeRequest(DPS_Node* node, DPS_NetEndpoint* ep, DPS_NetRxBu
             DPS_DBGPRINT("DPS_DecodeSubscriptionAck returned %s\n", DPS_ErrTxt(ret));
         }
         break;
+    case DPS_MSG_TYPE_FRAG:
+        ret = DPS_DecodeFragment(node, ep, buf, &msgBuf);
+        if (ret != DPS_OK) {
+            DPS_DBGPRINT("DPS_DecodeFragment returned %s\n", DPS_ErrTxt(ret));
+        } else if (msgBuf) {
+            DPS_DBGPRINT("Received fragmented publication via %s\n", DPS_NodeAddrToString(&ep->addr));
+            ret = DecodeRequest(node, ep, msgBuf, multicast);
+            DPS_NetRxBufferDecRef(msgBuf);
+        }
+        break;
+    case DPS_MSG_TYPE_NAK:
+        DPS_DBGPRINT("Received fragment request via %s\n", DPS_NodeAddrToString(&ep->addr));
+        ret = DPS_DecodeFragmentNak(node, ep, buf);
+        if (ret != DPS_OK) {
+            DPS_DBGPRINT("DPS_DecodeFragmentNak returned %s\n", DPS_ErrTxt(ret));
+        }
+        break;
+    case DPS_MSG_TYPE_RACK:
+        DPS_DBGPRINT("Received reliable window ack via %s\n", DPS_NodeAddrToString(&ep->addr));
+        ret = DPS_DecodeReliableAck(node, ep, buf);
+        if (ret != DPS_OK) {
+            DPS_DBGPRINT("DPS_DecodeReliableAck returned %s\n", DPS_ErrTxt(ret));
+        }
+        break;
     default:
         DPS_ERRPRINT("Invalid message type\n");
         break;
@@ -1138,7 +1408,11 @@ static void StopNode(DPS_Node* node)
     uv_close((uv_handle_t*)&node->pubsTimer, NULL);
     uv_close((uv_handle_t*)&node->subsAsync, NULL);
     uv_close((uv_handle_t*)&node->acksAsync, NULL);
+    uv_close((uv_handle_t*)&node->acksTimer, NULL);
+    uv_close((uv_handle_t*)&node->prewarmAsync, NULL);
     uv_close((uv_handle_t*)&node->subsTimer, NULL);
+    uv_close((uv_handle_t*)&node->fragments.timer, NULL);
+    uv_close((uv_handle_t*)&node->reliable.timer, NULL);
     /*
      * Cleanup any unresolved resolvers before closing the handle
      */
@@ -1159,21 +1433,37 @@ static void StopNode(DPS_Node* node)
         ack->status = DPS_ERR_WRITE;
         DPS_AckPublicationCompletion(ack);
     }
+    while (!DPS_QueueEmpty(&node->pendingAckQueue)) {
+        ack = (PublicationAck*)DPS_QueueFront(&node->pendingAckQueue);
+        DPS_QueueRemove(&ack->queue);
+        ack->status = DPS_ERR_WRITE;
+        DPS_AckPublicationCompletion(ack);
+    }
     /*
      * Run the event loop again to ensure that all cleanup is
      * completed
      */
     uv_run(node->loop, UV_RUN_DEFAULT);
+    /*
+     * Release the publish requests held for retransmission before
+     * freeing the publications
+     */
+    DPS_ReliableFree(&node->reliable);
     /*
      * Free data structures
      */
     DPS_FreeSubscriptions(node);
     DPS_FreePublications(node);
+    DPS_FreePubHeaders(node);
     DPS_CountVectorFree(node->interests);
     DPS_CountVectorFree(node->needs);
     DPS_BitVectorFree(node->scratch.interests);
     DPS_BitVectorFree(node->scratch.needs);
+    DPS_BitVectorFree(node->scratch.added);
     DPS_HistoryFree(&node->history);
+    DPS_RetainedIndexFree(&node->retained);
+    DPS_TopicTrieFree(&node->topicTrie);
+    DPS_FragmentsFree(&node->fragments);
     /*
      * Cleanup mutexes etc.
      */
@@ -1324,6 +1614,7 @@ DPS_Node* DPS_CreateNode(const char* separators, DPS_KeyStore* keyStore, const D
     strncpy_s(node->separators, sizeof(node->separators), separators, sizeof(node->separators) - 1);
     node->keyStore = keyStore;
     DPS_QueueInit(&node->ackQueue);
+    DPS_QueueInit(&node->pendingAckQueue);
     /*
      * Set default probe configuration and subscription rate parameters
      */
@@ -1385,6 +1676,14 @@ DPS_Status DPS_StartNode(DPS_Node* node, int mcast, DPS_NodeAddress* listenAddr)
     r = uv_async_init(node->loop, &node->acksAsync, SendAcksTask);
     assert(!r);
 
+    node->acksTimer.data = node;
+    r = uv_timer_init(node->loop, &node->acksTimer);
+    assert(!r);
+
+    node->prewarmAsync.data = node;
+    r = uv_async_init(node->loop, &node->prewarmAsync, PrewarmTask);
+    assert(!r);
+
     node->pubsAsync.data = node;
     r = uv_async_init(node->loop, &node->pubsAsync, SendPubsTask);
     assert(!r);
@@ -1409,6 +1708,14 @@ DPS_Status DPS_StartNode(DPS_Node* node, int mcast, DPS_NodeAddress* listenAddr)
     r = uv_timer_init(node->loop, &node->subsTimer);
     assert(!r);
 
+    node->fragments.timer.data = node;
+    r = uv_timer_init(node->loop, &node->fragments.timer);
+    assert(!r);
+
+    node->reliable.timer.data = node;
+    r = uv_timer_init(node->loop, &node->reliable.timer);
+    assert(!r);
+
     /*
      * Mutex for protecting the node
      */
@@ -1426,8 +1733,9 @@ DPS_Status DPS_StartNode(DPS_Node* node, int mcast, DPS_NodeAddress* listenAddr)
     node->needs = DPS_CountVectorAllocFH();
     node->scratch.interests = DPS_BitVectorAlloc();
     node->scratch.needs = DPS_BitVectorAllocFH();
+    node->scratch.added = DPS_BitVectorAlloc();
 
-    if (!node->interests || !node->needs || !node->scratch.interests || !node->scratch.needs) {
+    if (!node->interests || !node->needs || !node->scratch.interests || !node->scratch.needs || !node->scratch.added) {
         ret = DPS_ERR_RESOURCES;
         goto ErrExit;
     }
@@ -1437,15 +1745,22 @@ DPS_Status DPS_StartNode(DPS_Node* node, int mcast, DPS_NodeAddress* listenAddr)
     if (mcast & DPS_MCAST_PUB_ENABLE_SEND) {
         node->mcastSender = DPS_MulticastStartSend(node);
     }
-    node->netCtx = DPS_NetStart(node, listenAddr, OnNetReceive);
+    if (listenAddr) {
+        ret = DPS_SetNodeListenAddress(node, listenAddr);
+        if (ret != DPS_OK) {
+            goto ErrExit;
+        }
+    }
+    node->netCtx = DPS_NetStart(node, node->listenAddrs, node->numListenAddrs, OnNetReceive);
     if (!node->netCtx) {
         DPS_ERRPRINT("Failed to initialize network context on %s\n", DPS_NodeAddrToString(listenAddr));
         ret = DPS_ERR_NETWORK;
         goto ErrExit;
     }
     /*
-     * Make sure have the listening address before we return
+     * Make sure have the listening addresses before we return
      */
+    node->numListenAddrs = DPS_NetGetListenAddresses(node->listenAddrs, DPS_MAX_TRANSPORTS, node->netCtx);
     DPS_NetGetListenAddress(&node->addr, node->netCtx);
     strncpy_s(node->addrStr, sizeof(node->addrStr),
               DPS_NodeAddrToString(&node->addr), DPS_NODE_ADDRESS_MAX_STRING_LEN);
@@ -1485,6 +1800,37 @@ const char* DPS_GetListenAddressString(DPS_Node* node)
     return DPS_NodeAddrToString(&node->addr);
 }
 
+const DPS_NodeAddress* DPS_GetTransportListenAddress(DPS_Node* node, const char* transport)
+{
+    DPS_NodeAddressType type;
+    size_t i;
+
+    if (!node || !transport || !node->netCtx) {
+        return NULL;
+    }
+    type = DPS_NetTransportType(transport);
+    for (i = 0; i < node->numListenAddrs; ++i) {
+        if (node->listenAddrs[i].type == type) {
+            return &node->listenAddrs[i];
+        }
+    }
+    return NULL;
+}
+
+const DPS_NodeAddress* DPS_ListenAddressFor(DPS_Node* node, const DPS_NetEndpoint* ep)
+{
+    size_t i;
+
+    if (ep && (ep->addr.type != node->addr.type)) {
+        for (i = 0; i < node->numListenAddrs; ++i) {
+            if (node->listenAddrs[i].type == ep->addr.type) {
+                return &node->listenAddrs[i];
+            }
+        }
+    }
+    return &node->addr;
+}
+
 DPS_Status DPS_DestroyNode(DPS_Node* node, DPS_OnNodeDestroyed cb, void* data)
 {
     DPS_DBGTRACE();
@@ -1523,6 +1869,93 @@ void DPS_SetNodeSubscriptionUpdateDelay(DPS_Node* node, uint32_t subsRateMsecs)
     node->subsRate = subsRateMsecs;
 }
 
+void DPS_SetNodeFragmentRetransmit(DPS_Node* node, int retransmit)
+{
+    DPS_DBGTRACE();
+
+    node->fragments.retransmit = retransmit ? DPS_TRUE : DPS_FALSE;
+}
+
+void DPS_SetNodeAckAggregation(DPS_Node* node, uint32_t delayMsecs)
+{
+    DPS_DBGTRACE();
+
+    node->ackAggregationDelay = delayMsecs;
+}
+
+void DPS_SetNodeIoUring(DPS_Node* node, int enable)
+{
+    DPS_DBGTRACE();
+
+    node->noIoUring = enable ? DPS_FALSE : DPS_TRUE;
+}
+
+DPS_Status DPS_GetBloomStats(DPS_Node* node, const DPS_NodeAddress* addr, DPS_BloomStats* stats)
+{
+    DPS_Status ret = DPS_OK;
+    RemoteNode* remote;
+
+    DPS_DBGTRACE();
+
+    if (!node || !stats) {
+        return DPS_ERR_NULL;
+    }
+    DPS_LockNode(node);
+    if (addr) {
+        remote = DPS_LookupRemoteNode(node, addr);
+        if (remote) {
+            *stats = remote->bloomStats;
+        } else {
+            ret = DPS_ERR_MISSING;
+        }
+    } else {
+        *stats = node->bloomStats;
+    }
+    DPS_UnlockNode(node);
+    return ret;
+}
+
+DPS_Status DPS_PrewarmConnections(DPS_Node* node)
+{
+    DPS_DBGTRACE();
+
+    if (!node) {
+        return DPS_ERR_NULL;
+    }
+    if (node->state != DPS_NODE_RUNNING) {
+        return DPS_ERR_NOT_STARTED;
+    }
+    uv_async_send(&node->prewarmAsync);
+    return DPS_OK;
+}
+
+DPS_Status DPS_SetNodeListenAddress(DPS_Node* node, const DPS_NodeAddress* addr)
+{
+    size_t i;
+
+    DPS_DBGTRACE();
+
+    if (!node || !addr) {
+        return DPS_ERR_NULL;
+    }
+    if (node->state != DPS_NODE_CREATED) {
+        return DPS_ERR_INVALID;
+    }
+    for (i = 0; i < node->numListenAddrs; ++i) {
+        if (node->listenAddrs[i].type == addr->type) {
+            break;
+        }
+    }
+    if (i == DPS_MAX_TRANSPORTS) {
+        return DPS_ERR_RESOURCES;
+    }
+    node->listenAddrs[i] = *addr;
+    if (i == node->numListenAddrs) {
+        ++node->numListenAddrs;
+    }
+    return DPS_OK;
+}
+
 static DPS_Status Link(DPS_Node* node, const DPS_NodeAddress* addr, OnOpCompletion* completion)
 {
     RemoteNode* remote = NULL;
@@ -1567,8 +2000,17 @@ Exit:
 static void OnResolve(DPS_Node* node, const DPS_NodeAddress* addr, void* data)
 {
     OnOpCompletion* completion = (OnOpCompletion*)data;
+    DPS_NodeAddress resolved;
     DPS_Status ret;
 
+    /*
+     * The resolver does not know which transport the address is for
+     */
+    if (addr) {
+        resolved = *addr;
+        resolved.type = completion->addrType;
+        addr = &resolved;
+    }
     ret = Link(node, addr, completion);
     if (ret != DPS_OK) {
         DPS_RemoteCompletion(node, completion->remote, ret);
@@ -1580,10 +2022,9 @@ DPS_Status DPS_Link(DPS_Node* node, const char* addrText, DPS_OnLinkComplete cb,
     DPS_Status ret = DPS_OK;
     OnOpCompletion* completion = NULL;
     DPS_NodeAddress* addr = NULL;
-#if defined(DPS_USE_DTLS) || defined(DPS_USE_TCP) || defined(DPS_USE_UDP)
+    const char* text;
     char host[DPS_MAX_HOST_LEN + 1];
     char service[DPS_MAX_SERVICE_LEN + 1];
-#endif
 
     DPS_DBGTRACE();
 
@@ -1596,34 +2037,51 @@ DPS_Status DPS_Link(DPS_Node* node, const char* addrText, DPS_OnLinkComplete cb,
         ret = DPS_ERR_RESOURCES;
         goto Exit;
     }
-#if defined(DPS_USE_DTLS) || defined(DPS_USE_TCP) || defined(DPS_USE_UDP)
-    ret = DPS_SplitAddress(addrText, host, sizeof(host), service, sizeof(service));
-    if (ret != DPS_OK) {
-        DPS_ERRPRINT("DPS_SplitAddress returned %s\n", DPS_ErrTxt(ret));
-        goto Exit;
-    }
-    ret = DPS_ResolveAddress(node, host, service, OnResolve, completion);
-    if (ret != DPS_OK) {
-        DPS_ERRPRINT("DPS_ResolveAddress returned %s\n", DPS_ErrTxt(ret));
-        goto Exit;
-    }
-#elif defined(DPS_USE_PIPE)
-    addr = DPS_CreateAddress();
-    if (!addr) {
-        ret = DPS_ERR_RESOURCES;
-        goto Exit;
-    }
-    if (DPS_SetAddress(addr, addrText) == NULL) {
-        DPS_ERRPRINT("DPS_SetAddress failed\n");
+    /*
+     * The address may be prefixed with the name of the transport to link over
+     */
+    text = DPS_NetParseTransportPrefix(addrText, &completion->addrType);
+    if (!text) {
         ret = DPS_ERR_INVALID;
         goto Exit;
     }
-    ret = Link(node, addr, completion);
-    if (ret != DPS_OK) {
-        DPS_ERRPRINT("Link returned %s\n", DPS_ErrTxt(ret));
-        goto Exit;
+    switch (completion->addrType) {
+    case DPS_DTLS:
+    case DPS_TCP:
+    case DPS_UDP:
+        ret = DPS_SplitAddress(text, host, sizeof(host), service, sizeof(service));
+        if (ret != DPS_OK) {
+            DPS_ERRPRINT("DPS_SplitAddress returned %s\n", DPS_ErrTxt(ret));
+            goto Exit;
+        }
+        ret = DPS_ResolveAddress(node, host, service, OnResolve, completion);
+        if (ret != DPS_OK) {
+            DPS_ERRPRINT("DPS_ResolveAddress returned %s\n", DPS_ErrTxt(ret));
+            goto Exit;
+        }
+        break;
+    case DPS_PIPE:
+    case DPS_SHM:
+        addr = DPS_CreateAddress();
+        if (!addr) {
+            ret = DPS_ERR_RESOURCES;
+            goto Exit;
+        }
+        if (DPS_SetAddress(addr, addrText) == NULL) {
+            DPS_ERRPRINT("DPS_SetAddress failed\n");
+            ret = DPS_ERR_INVALID;
+            goto Exit;
+        }
+        ret = Link(node, addr, completion);
+        if (ret != DPS_OK) {
+            DPS_ERRPRINT("Link returned %s\n", DPS_ErrTxt(ret));
+            goto Exit;
+        }
+        break;
+    default:
+        ret = DPS_ERR_INVALID;
+        break;
     }
-#endif
 Exit:
     DPS_DestroyAddress(addr);
     if (ret != DPS_OK) {
@@ -1680,19 +2138,36 @@ DPS_Status DPS_Unlink(DPS_Node* node, const DPS_NodeAddress* addr, DPS_OnUnlinkC
 
 const char* DPS_NodeAddrToString(const DPS_NodeAddress* addr)
 {
-    if (addr) {
-        switch (addr->type) {
-        case DPS_DTLS:
-        case DPS_TCP:
-        case DPS_UDP:
-            return DPS_NetAddrText((const struct sockaddr*)&addr->u.inaddr);
-        case DPS_PIPE:
-            return addr->u.path;
-        default:
-            break;
-        }
+    static THREAD char str[DPS_TRANSPORT_PREFIX_MAX_LEN + DPS_NODE_ADDRESS_PATH_MAX];
+    const char* prefix;
+    const char* text;
+
+    if (!addr) {
+        return "NULL";
+    }
+    switch (addr->type) {
+    case DPS_DTLS:
+    case DPS_TCP:
+    case DPS_UDP:
+        text = DPS_NetAddrText((const struct sockaddr*)&addr->u.inaddr);
+        break;
+    case DPS_PIPE:
+    case DPS_SHM:
+        text = addr->u.path;
+        break;
+    default:
+        return "NULL";
+    }
+    /*
+     * Qualify addresses that are not for the default transport so the
+     * text can be passed to DPS_Link()
+     */
+    prefix = DPS_NetTransportPrefix(addr->type);
+    if (prefix) {
+        snprintf(str, sizeof(str), "%s:%s", prefix, text);
+        return str;
     }
-    return "NULL";
+    return text;
 }
 
 DPS_NodeAddress* DPS_CreateAddress()
@@ -27,6 +27,7 @@
 #include <dps/dbg.h>
 #include <dps/dps.h>
 #include <dps/private/network.h>
+#include <dps/private/cbor.h>
 #include "../mbedtls.h"
 #include "../node.h"
 #include "../queue.h"
@@ -39,6 +40,7 @@
 #include "mbedtls/ssl.h"
 #include "mbedtls/ssl_cache.h"
 #include "mbedtls/ssl_cookie.h"
+#include "mbedtls/ssl_ticket.h"
 
 /*
  * NOTES
@@ -66,6 +68,36 @@ DPS_DEBUG_CONTROL(DPS_DEBUG_ON);
 /* Personalization string for the DRBG */
 #define PERSONALIZATION_STRING "DPS_DRBG"
 
+/*
+ * Number of buckets in the connection and session hash tables, must
+ * be a power of 2.
+ */
+#define HASH_TABLE_SIZE 64
+
+/*
+ * Lifetime of sessions that can be resumed and the maximum number of
+ * sessions remembered. Resuming a session skips the certificate
+ * verification and key exchange of a full handshake.
+ */
+#define SESSION_TIMEOUT_SECS  (60 * 60)
+#define MAX_SESSIONS          64
+
+/*
+ * Records are sized to fit the path MTU. mbedtls does not discover
+ * the path MTU so assume the IPv6 minimum less the IPv6 and UDP
+ * headers.
+ */
+#define PATH_MTU              1280
+#define IP_UDP_OVERHEAD       (40 + 8)
+#define MAX_RECORD_EXPANSION  64
+
+/*
+ * When packing is negotiated each message in a record is preceded by
+ * its CBOR encoded length.
+ */
+#define PACKED_LEN_SIZE       CBOR_SIZEOF(uint32_t)
+#define MAX_PACKED            16
+
 typedef struct _RecvData {
     DPS_Queue queue;
     uv_buf_t buf;
@@ -89,7 +121,8 @@ typedef struct _SendRequest {
  * issues -- ensuring certain buffers are alive for enough time.
  */
 typedef struct _DPS_NetConnection {
-    DPS_NetContext* netCtx;
+    const DPS_NetTransport* transport; /* must be first, see DPS_NetTransport */
+    DPS_NetTransportContext* netCtx;
     DPS_Node* node;
     /*
      * The ref counting strategy is as follows:
@@ -135,6 +168,15 @@ typedef struct _DPS_NetConnection {
     int handshakeDone;
     int handshake;
 
+    /*
+     * Plaintext record buffer sized to the path MTU. Small messages
+     * are gathered here and, if the peer agreed to packing, several
+     * queued messages are written in a single record.
+     */
+    uint8_t* recordBuf;
+    size_t recordLen;
+    int packing;
+
     enum {
           CN_OPEN = 0,
           CN_CLOSE_NOTIFIED = 1,
@@ -170,19 +212,27 @@ typedef struct _DPS_NetConnection {
     uv_timer_t timer;
     int timerStatus;
 
-    /* For server connection. */
-    mbedtls_ssl_cookie_ctx cookieCtx;
-    mbedtls_ssl_cache_context cacheCtx;
-
     DPS_NetConnection* next;
+    DPS_NetConnection* hashNext;
 } DPS_NetConnection;
 
+/*
+ * A session saved by a client so the next connection to the same
+ * server can resume it.
+ */
+typedef struct _ClientSession {
+    DPS_NodeAddress addr;
+    mbedtls_ssl_session session;
+    uint64_t expires;
+    struct _ClientSession* next;
+} ClientSession;
+
 #define MAX_READ_LEN   65536
 
 #define NET_RUNNING  1          /**< Net layer is running */
 #define NET_STOPPING 2          /**< Net layer is stopping */
 
-struct _DPS_NetContext {
+struct _DPS_NetTransportContext {
     int state;
     uv_udp_t rxSocket;
     uv_udp_recv_cb dataCB;
@@ -191,8 +241,30 @@ struct _DPS_NetContext {
     DPS_Node* node;
     DPS_OnReceive receiveCB;
     DPS_NetConnection* cns;
+    /*
+     * Connections and saved client sessions hashed by peer address
+     */
+    DPS_NetConnection* cnTable[HASH_TABLE_SIZE];
+    ClientSession* sessions[HASH_TABLE_SIZE];
+    size_t numSessions;
+    /*
+     * The random number generator and the cookie, session cache, and
+     * ticket contexts are shared by all the connections so sessions
+     * can be resumed on a new connection.
+     */
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context drbg;
+    mbedtls_ssl_cookie_ctx cookieCtx;
+    mbedtls_ssl_cache_context cacheCtx;
+#if defined(MBEDTLS_SSL_TICKET_C)
+    mbedtls_ssl_ticket_context ticketCtx;
+    int ticketsEnabled;
+#endif
 };
 
+static void ConnectionIncRef(DPS_NetConnection* cn);
+static void ConnectionDecRef(DPS_NetConnection* cn);
+
 /*
  * Used when the key store supports certificates.
  */
@@ -210,6 +282,14 @@ static const int AllCipherSuites[] = {
     0
 };
 
+/*
+ * ALPN protocol used to negotiate packing multiple messages in a
+ * record. Peers that do not offer it get one message per record.
+ */
+#if defined(MBEDTLS_SSL_ALPN)
+static const char* PackingProtocols[] = { "dps-pack", NULL };
+#endif
+
 /*
  * Used when the key store supports only PSKs.
  */
@@ -235,17 +315,17 @@ static void AllocBuffer(uv_handle_t* handle, size_t suggestedSize, uv_buf_t* buf
 
 static void OnServerData(uv_udp_t* socket, ssize_t nread, const uv_buf_t* buf, const struct sockaddr* addr, unsigned flags)
 {
-    DPS_NetContext* netCtx = socket->data;
+    DPS_NetTransportContext* netCtx = socket->data;
     netCtx->dataCB(socket, nread, buf, addr, flags);
 }
 
 static void OnClientData(uv_udp_t* socket, ssize_t nread, const uv_buf_t* buf, const struct sockaddr* addr, unsigned flags)
 {
     DPS_NetConnection* cn = socket->data;
-    DPS_NetContext* netCtx = cn->netCtx;
+    DPS_NetTransportContext* netCtx = cn->netCtx;
     /*
      * Use the rxSocket here as it's only purpose in dataCB is to get
-     * to the DPS_NetContext
+     * to the DPS_NetTransportContext
      */
     netCtx->dataCB(&netCtx->rxSocket, nread, buf, addr, flags);
 }
@@ -253,18 +333,60 @@ static void OnClientData(uv_udp_t* socket, ssize_t nread, const uv_buf_t* buf, c
 static uv_udp_t* GetSocket(DPS_NetConnection* cn)
 {
     if (cn->type == MBEDTLS_SSL_IS_SERVER) {
-        DPS_NetContext* netCtx = cn->netCtx;
+        DPS_NetTransportContext* netCtx = cn->netCtx;
         return &netCtx->rxSocket;
     } else {
         return &cn->socket;
     }
 }
 
-static DPS_NetConnection* LookupConnection(DPS_NetContext* netCtx, DPS_NodeAddress* addr)
+/*
+ * FNV-1a hash of an IP address and port. IPv4 addresses and IPv4
+ * mapped IPv6 addresses hash to the same value so the hash agrees with
+ * DPS_SameAddr().
+ */
+static uint32_t HashAddr(const DPS_NodeAddress* addr)
+{
+    static const uint8_t v4mapped[12] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF };
+    const struct sockaddr* sa = (const struct sockaddr*)&addr->u.inaddr;
+    const uint8_t* ip = NULL;
+    const uint8_t* port = NULL;
+    size_t ipLen = 0;
+    uint32_t hash = 2166136261u;
+    size_t i;
+
+    if (sa->sa_family == AF_INET) {
+        const struct sockaddr_in* sa4 = (const struct sockaddr_in*)sa;
+        ip = (const uint8_t*)&sa4->sin_addr;
+        ipLen = 4;
+        port = (const uint8_t*)&sa4->sin_port;
+    } else if (sa->sa_family == AF_INET6) {
+        const struct sockaddr_in6* sa6 = (const struct sockaddr_in6*)sa;
+        ip = (const uint8_t*)&sa6->sin6_addr;
+        ipLen = 16;
+        if (memcmp(ip, v4mapped, sizeof(v4mapped)) == 0) {
+            ip += sizeof(v4mapped);
+            ipLen = 4;
+        }
+        port = (const uint8_t*)&sa6->sin6_port;
+    } else {
+        return 0;
+    }
+    for (i = 0; i < ipLen; ++i) {
+        hash = (hash ^ ip[i]) * 16777619u;
+    }
+    hash = (hash ^ port[0]) * 16777619u;
+    hash = (hash ^ port[1]) * 16777619u;
+    return hash;
+}
+
+#define HASH_BUCKET(addr)  (HashAddr(addr) & (HASH_TABLE_SIZE - 1))
+
+static DPS_NetConnection* LookupConnection(DPS_NetTransportContext* netCtx, DPS_NodeAddress* addr)
 {
     DPS_NetConnection* cn;
 
-    for (cn = netCtx->cns; cn != NULL; cn = cn->next) {
+    for (cn = netCtx->cnTable[HASH_BUCKET(addr)]; cn != NULL; cn = cn->hashNext) {
         if (DPS_SameAddr(cn->peerAddr, addr)) {
             return cn;
         }
@@ -272,6 +394,171 @@ static DPS_NetConnection* LookupConnection(DPS_NetContext* netCtx, DPS_NodeAddre
     return NULL;
 }
 
+static void AddConnection(DPS_NetTransportContext* netCtx, DPS_NetConnection* cn)
+{
+    uint32_t b = HASH_BUCKET(cn->peerAddr);
+
+    cn->next = netCtx->cns;
+    netCtx->cns = cn;
+    cn->hashNext = netCtx->cnTable[b];
+    netCtx->cnTable[b] = cn;
+}
+
+static void RemoveConnection(DPS_NetTransportContext* netCtx, DPS_NetConnection* cn)
+{
+    DPS_NetConnection** p;
+
+    for (p = &netCtx->cns; *p; p = &(*p)->next) {
+        if (*p == cn) {
+            *p = cn->next;
+            break;
+        }
+    }
+    if (cn->peerAddr) {
+        for (p = &netCtx->cnTable[HASH_BUCKET(cn->peerAddr)]; *p; p = &(*p)->hashNext) {
+            if (*p == cn) {
+                *p = cn->hashNext;
+                break;
+            }
+        }
+    }
+    cn->next = NULL;
+    cn->hashNext = NULL;
+}
+
+/*
+ * CLIENT SESSIONS
+ *
+ * When a client handshake completes the session is saved so that the
+ * next connection to the same server requests resumption of the
+ * session. The server finds the session in its session cache or in
+ * the session ticket the client presents.
+ */
+
+static void FreeSession(ClientSession* cs)
+{
+    mbedtls_ssl_session_free(&cs->session);
+    free(cs);
+}
+
+static ClientSession* LookupSession(DPS_NetTransportContext* netCtx, const DPS_NodeAddress* addr)
+{
+    ClientSession* cs;
+
+    for (cs = netCtx->sessions[HASH_BUCKET(addr)]; cs != NULL; cs = cs->next) {
+        if (DPS_SameAddr(&cs->addr, addr)) {
+            return cs;
+        }
+    }
+    return NULL;
+}
+
+static void DeleteSession(DPS_NetTransportContext* netCtx, ClientSession* cs)
+{
+    ClientSession** p;
+
+    for (p = &netCtx->sessions[HASH_BUCKET(&cs->addr)]; *p; p = &(*p)->next) {
+        if (*p == cs) {
+            *p = cs->next;
+            --netCtx->numSessions;
+            FreeSession(cs);
+            return;
+        }
+    }
+}
+
+/*
+ * Make room for a new session by deleting the session that expires first
+ */
+static void DeleteOldestSession(DPS_NetTransportContext* netCtx)
+{
+    ClientSession* oldest = NULL;
+    ClientSession* cs;
+    size_t i;
+
+    for (i = 0; i < HASH_TABLE_SIZE; ++i) {
+        for (cs = netCtx->sessions[i]; cs != NULL; cs = cs->next) {
+            if (!oldest || (cs->expires < oldest->expires)) {
+                oldest = cs;
+            }
+        }
+    }
+    if (oldest) {
+        DeleteSession(netCtx, oldest);
+    }
+}
+
+static void SaveSession(DPS_NetConnection* cn)
+{
+    DPS_NetTransportContext* netCtx = cn->netCtx;
+    ClientSession* cs;
+    uint32_t b;
+    int ret;
+
+    cs = LookupSession(netCtx, cn->peerAddr);
+    if (cs) {
+        DeleteSession(netCtx, cs);
+    }
+    if (netCtx->numSessions >= MAX_SESSIONS) {
+        DeleteOldestSession(netCtx);
+    }
+    cs = calloc(1, sizeof(ClientSession));
+    if (!cs) {
+        return;
+    }
+    mbedtls_ssl_session_init(&cs->session);
+    ret = mbedtls_ssl_get_session(&cn->ssl, &cs->session);
+    if (ret != 0) {
+        DPS_WARNPRINT("Get session failed: %s\n", TLSErrTxt(ret));
+        FreeSession(cs);
+        return;
+    }
+    cs->addr = *cn->peerAddr;
+    cs->expires = uv_now(cn->node->loop) + DPS_SECS_TO_MS(SESSION_TIMEOUT_SECS);
+    b = HASH_BUCKET(&cs->addr);
+    cs->next = netCtx->sessions[b];
+    netCtx->sessions[b] = cs;
+    ++netCtx->numSessions;
+    DPS_DBGPRINT("Saved session for %s\n", DPS_NodeAddrToString(&cs->addr));
+}
+
+static void ResumeSession(DPS_NetConnection* cn)
+{
+    DPS_NetTransportContext* netCtx = cn->netCtx;
+    ClientSession* cs;
+    int ret;
+
+    cs = LookupSession(netCtx, cn->peerAddr);
+    if (!cs) {
+        return;
+    }
+    if (cs->expires <= uv_now(cn->node->loop)) {
+        DeleteSession(netCtx, cs);
+        return;
+    }
+    ret = mbedtls_ssl_set_session(&cn->ssl, &cs->session);
+    if (ret != 0) {
+        DPS_WARNPRINT("Set session failed: %s\n", TLSErrTxt(ret));
+        DeleteSession(netCtx, cs);
+        return;
+    }
+    DPS_DBGPRINT("Resuming session with %s\n", DPS_NodeAddrToString(cn->peerAddr));
+}
+
+static void FreeSessions(DPS_NetTransportContext* netCtx)
+{
+    size_t i;
+
+    for (i = 0; i < HASH_TABLE_SIZE; ++i) {
+        while (netCtx->sessions[i]) {
+            ClientSession* cs = netCtx->sessions[i];
+            netCtx->sessions[i] = cs->next;
+            FreeSession(cs);
+        }
+    }
+    netCtx->numSessions = 0;
+}
+
 static RecvData* CreateRecvData(ssize_t nread, const uv_buf_t* buf)
 {
     RecvData* data;
@@ -336,7 +623,7 @@ static void CancelPending(DPS_NetConnection* cn)
     /*
      * Protect connection while we are modifying the queues.
      */
-    DPS_NetConnectionIncRef(cn);
+    ConnectionIncRef(cn);
 
     while (!DPS_QueueEmpty(&cn->sendQueue)) {
         SendRequest* req = (SendRequest*)DPS_QueueFront(&cn->sendQueue);
@@ -349,11 +636,11 @@ static void CancelPending(DPS_NetConnection* cn)
         SendRequest* req = (SendRequest*)DPS_QueueFront(&cn->sendCompletedQueue);
         DPS_QueueRemove(&req->queue);
         req->sendCompleteCB(cn->node, req->appCtx, &cn->peer, req->bufs, req->numBufs, req->status);
-        DPS_NetConnectionDecRef(cn);
+        ConnectionDecRef(cn);
         DestroySendRequest(req);
     }
 
-    DPS_NetConnectionDecRef(cn);
+    ConnectionDecRef(cn);
 }
 
 static void OnTLSDebug(void *ctx, int level, const char *file, int line, const char *str)
@@ -458,7 +745,7 @@ static void OnTimeout(uv_timer_t* timer)
         } else if (ret == DPS_FALSE) {
             CancelPending(cn);
         }
-        DPS_NetConnectionDecRef(cn);
+        ConnectionDecRef(cn);
     }
 }
 
@@ -474,7 +761,7 @@ static void OnTLSTimerSet(void* data, uint32_t int_ms, uint32_t fin_ms)
         cn->timerStatus = -1;
         if (active) {
             uv_timer_stop(&cn->timer);
-            DPS_NetConnectionDecRef(cn);
+            ConnectionDecRef(cn);
         }
         return;
     }
@@ -487,7 +774,7 @@ static void OnTLSTimerSet(void* data, uint32_t int_ms, uint32_t fin_ms)
     }
     uv_timer_start(&cn->timer, OnTimeout, int_ms, fin_ms - int_ms);
     if (!active) {
-        DPS_NetConnectionIncRef(cn);
+        ConnectionIncRef(cn);
     }
 }
 
@@ -539,7 +826,7 @@ static int OnTLSRecv(void* userData, unsigned char *buf, size_t len)
     memcpy_s(buf, data->buf.len, data->buf.base, dataLen);
 
     DPS_QueueRemove(&data->queue);
-    DPS_NetConnectionDecRef(cn);
+    ConnectionDecRef(cn);
     DestroyRecvData(data);
     return (int) dataLen;
 }
@@ -604,7 +891,7 @@ static void OnSendComplete(uv_udp_send_t *req, int status)
     if (status != 0) {
         DPS_ERRPRINT("Send failed: %s\n", uv_err_name(status));
     }
-    DPS_NetConnectionDecRef(sendReq->cn);
+    ConnectionDecRef(sendReq->cn);
     DestroySendReq(sendReq);
 }
 
@@ -637,7 +924,7 @@ static int OnTLSSend(void* data, const unsigned char *buf, size_t len)
         DPS_ERRPRINT("Send failed: %s\n", uv_err_name(err));
         goto ErrorExit;
     }
-    DPS_NetConnectionIncRef(cn);
+    ConnectionIncRef(cn);
 
     return (int) len;
 
@@ -648,8 +935,18 @@ static int OnTLSSend(void* data, const unsigned char *buf, size_t len)
 
 static void RxHandleClosed(uv_handle_t* handle)
 {
+    DPS_NetTransportContext* netCtx = handle->data;
+
     DPS_DBGPRINT("Closed Rx handle %p\n", handle);
-    free(handle->data);
+    FreeSessions(netCtx);
+#if defined(MBEDTLS_SSL_TICKET_C)
+    mbedtls_ssl_ticket_free(&netCtx->ticketCtx);
+#endif
+    mbedtls_ssl_cache_free(&netCtx->cacheCtx);
+    mbedtls_ssl_cookie_free(&netCtx->cookieCtx);
+    mbedtls_ctr_drbg_free(&netCtx->drbg);
+    mbedtls_entropy_free(&netCtx->entropy);
+    free(netCtx);
 }
 
 static void FreeConnection(DPS_NetConnection* cn)
@@ -659,29 +956,15 @@ static void FreeConnection(DPS_NetConnection* cn)
     mbedtls_pk_free(&cn->pkey);
     mbedtls_x509_crt_free(&cn->cacert);
     mbedtls_x509_crt_free(&cn->cert);
-    if (cn->type == MBEDTLS_SSL_IS_SERVER) {
-        mbedtls_ssl_cache_free(&cn->cacheCtx);
-        mbedtls_ssl_cookie_free(&cn->cookieCtx);
-    }
-    mbedtls_ctr_drbg_free(&cn->drbg);
-    mbedtls_entropy_free(&cn->entropy);
 
+    if (cn->netCtx) {
+        RemoveConnection(cn->netCtx, cn);
+    }
     if (cn->peerAddr) {
         DPS_DestroyAddress(cn->peerAddr);
     }
-
-    if (cn->netCtx) {
-        DPS_NetConnection* next = cn->next;
-        if (cn->netCtx->cns == cn) {
-            cn->netCtx->cns = next;
-        } else if (cn->netCtx->cns) {
-            DPS_NetConnection* prev = cn->netCtx->cns;
-            while (prev->next != cn) {
-                prev = prev->next;
-                assert(prev);
-            }
-            prev->next = next;
-        }
+    if (cn->recordBuf) {
+        free(cn->recordBuf);
     }
     /*
      * DPS_NetStop may have been called while some connections are
@@ -756,7 +1039,7 @@ static void DestroyConnection(DPS_NetConnection* cn)
         assert(!uv_is_active((uv_handle_t*)&cn->timer));
         if (uv_is_active((uv_handle_t*)&cn->idleForSendCallbacks)) {
             uv_idle_stop(&cn->idleForSendCallbacks);
-            DPS_NetConnectionDecRef(cn);
+            ConnectionDecRef(cn);
         }
         if (cn->type == MBEDTLS_SSL_IS_CLIENT) {
             uv_udp_recv_stop(&cn->socket);
@@ -878,11 +1161,11 @@ static DPS_Status SetKeyAndId(DPS_KeyStoreRequest* request, const DPS_Key* key,
     return DPS_OK;
 }
 
-static DPS_NetConnection* CreateConnection(DPS_Node* node, const struct sockaddr* addr, int type)
+static DPS_NetConnection* CreateConnection(DPS_NetTransportContext* netCtx, const struct sockaddr* addr, int type)
 {
     int ret;
     DPS_NetConnection* cn;
-    DPS_NetContext* netCtx = node->netCtx;
+    DPS_Node* node = netCtx->node;
     DPS_KeyStore* keyStore = node->keyStore;
     DPS_KeyStoreRequest request;
     const int* ciphersuites = AllCipherSuites;
@@ -900,6 +1183,7 @@ static DPS_NetConnection* CreateConnection(DPS_Node* node, const struct sockaddr
         return NULL;
     }
 
+    cn->transport = &DPS_DtlsTransport;
     cn->netCtx = netCtx;
     cn->node = node;
     cn->type = type;
@@ -950,32 +1234,6 @@ static DPS_NetConnection* CreateConnection(DPS_Node* node, const struct sockaddr
         }
     }
 
-    mbedtls_entropy_init(&cn->entropy);
-
-    /*
-     * The default implementation is in
-     * mbedtls_platform_entropy_poll() and will rely on getrandom or
-     * /dev/urandom in Linux; and on CryptGenRandom() on Windows.
-     */
-    mbedtls_ctr_drbg_init(&cn->drbg);
-    ret = mbedtls_ctr_drbg_seed(&cn->drbg, mbedtls_entropy_func, &cn->entropy,
-                                (const unsigned char*)PERSONALIZATION_STRING, sizeof(PERSONALIZATION_STRING) - 1);
-    if (ret != 0) {
-        DPS_ERRPRINT("Seeding mbedtls random byte generator failed: %s\n", TLSErrTxt(ret));
-        goto ErrorExit;
-    }
-
-    if (cn->type == MBEDTLS_SSL_IS_SERVER) {
-        mbedtls_ssl_cookie_init(&cn->cookieCtx);
-        ret = mbedtls_ssl_cookie_setup(&cn->cookieCtx, mbedtls_ctr_drbg_random, &cn->drbg);
-        if (ret != 0) {
-            DPS_ERRPRINT("Setting up mbedtls cookie context failed: %s\n", TLSErrTxt(ret));
-            goto ErrorExit;
-        }
-
-        mbedtls_ssl_cache_init(&cn->cacheCtx);
-    }
-
     mbedtls_ssl_config_init(&cn->conf);
     ret = mbedtls_ssl_config_defaults(&cn->conf, cn->type, MBEDTLS_SSL_TRANSPORT_DATAGRAM, MBEDTLS_SSL_PRESET_DEFAULT);
     if (ret != 0) {
@@ -983,7 +1241,7 @@ static DPS_NetConnection* CreateConnection(DPS_Node* node, const struct sockaddr
         goto ErrorExit;
     }
     mbedtls_ssl_conf_dbg(&cn->conf, OnTLSDebug, NULL);
-    mbedtls_ssl_conf_rng(&cn->conf, mbedtls_ctr_drbg_random, &cn->drbg);
+    mbedtls_ssl_conf_rng(&cn->conf, mbedtls_ctr_drbg_random, &netCtx->drbg);
     mbedtls_ssl_conf_handshake_timeout(&cn->conf, netCtx->handshakeTimeoutMin, netCtx->handshakeTimeoutMax);
 
     memset(&request, 0, sizeof(request));
@@ -1021,22 +1279,39 @@ static DPS_NetConnection* CreateConnection(DPS_Node* node, const struct sockaddr
     }
 
     if (cn->type == MBEDTLS_SSL_IS_SERVER) {
-        mbedtls_ssl_conf_session_cache(&cn->conf, &cn->cacheCtx, mbedtls_ssl_cache_get, mbedtls_ssl_cache_set);
-        mbedtls_ssl_conf_dtls_cookies(&cn->conf, mbedtls_ssl_cookie_write, mbedtls_ssl_cookie_check, &cn->cookieCtx);
+        mbedtls_ssl_conf_session_cache(&cn->conf, &netCtx->cacheCtx, mbedtls_ssl_cache_get, mbedtls_ssl_cache_set);
+#if defined(MBEDTLS_SSL_TICKET_C)
+        if (netCtx->ticketsEnabled) {
+            mbedtls_ssl_conf_session_tickets_cb(&cn->conf, mbedtls_ssl_ticket_write, mbedtls_ssl_ticket_parse,
+                                                &netCtx->ticketCtx);
+        }
+#endif
+        mbedtls_ssl_conf_dtls_cookies(&cn->conf, mbedtls_ssl_cookie_write, mbedtls_ssl_cookie_check, &netCtx->cookieCtx);
         mbedtls_ssl_conf_psk_cb(&cn->conf, OnTLSPSKGet, cn);
-    } else if (keyStore->keyAndIdHandler) {
-        request.setKeyAndId = SetKeyAndId;
-        ret = keyStore->keyAndIdHandler(&request);
-        if (ret != DPS_OK) {
-            DPS_WARNPRINT("Get PSK failed: %s\n", DPS_ErrTxt(ret));
+    } else {
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+        mbedtls_ssl_conf_session_tickets(&cn->conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+        if (keyStore->keyAndIdHandler) {
+            request.setKeyAndId = SetKeyAndId;
+            ret = keyStore->keyAndIdHandler(&request);
+            if (ret != DPS_OK) {
+                DPS_WARNPRINT("Get PSK failed: %s\n", DPS_ErrTxt(ret));
+            }
+            request.setKeyAndId = NULL;
         }
-        request.setKeyAndId = NULL;
     }
     for (const int* cs = ciphersuites; *cs; ++cs) {
         DPS_DBGPRINT("  %s\n", mbedtls_ssl_get_ciphersuite_name(*cs));
     }
     mbedtls_ssl_conf_ciphersuites(&cn->conf, ciphersuites);
     mbedtls_ssl_conf_authmode(&cn->conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+#if defined(MBEDTLS_SSL_ALPN)
+    ret = mbedtls_ssl_conf_alpn_protocols(&cn->conf, PackingProtocols);
+    if (ret != 0) {
+        DPS_WARNPRINT("Setting ALPN protocols failed: %s\n", TLSErrTxt(ret));
+    }
+#endif
 
     mbedtls_ssl_init(&cn->ssl);
     mbedtls_ssl_set_bio(&cn->ssl, cn, OnTLSSend, OnTLSRecv, NULL);
@@ -1053,10 +1328,11 @@ static DPS_NetConnection* CreateConnection(DPS_Node* node, const struct sockaddr
             DPS_ERRPRINT("Reset connection failed: %s\n", TLSErrTxt(ret));
             goto ErrorExit;
         }
+    } else {
+        ResumeSession(cn);
     }
 
-    cn->next = netCtx->cns;
-    netCtx->cns = cn;
+    AddConnection(netCtx, cn);
     DPS_DBGPRINT("Created cn=%p\n", cn);
     return cn;
 
@@ -1075,12 +1351,12 @@ static void OnIdleForSendCallbacks(uv_idle_t* idle)
         SendRequest* req = (SendRequest*)DPS_QueueFront(&cn->sendCompletedQueue);
         DPS_QueueRemove(&req->queue);
         req->sendCompleteCB(cn->node, req->appCtx, &cn->peer, req->bufs, req->numBufs, req->status);
-        DPS_NetConnectionDecRef(cn);
+        ConnectionDecRef(cn);
         DestroySendRequest(req);
     }
 
     uv_idle_stop(&cn->idleForSendCallbacks);
-    DPS_NetConnectionDecRef(cn);
+    ConnectionDecRef(cn);
 }
 
 /*
@@ -1095,12 +1371,75 @@ static void OnIdleForSendCallbacks(uv_idle_t* idle)
  * debugging and handling our data structures.
  */
 
+static void CompleteSend(DPS_NetConnection* cn, SendRequest* req)
+{
+    int ret;
+
+    DPS_QueueRemove(&req->queue);
+    DPS_QueuePushBack(&cn->sendCompletedQueue, &req->queue);
+    if (!uv_is_active((uv_handle_t*)&cn->idleForSendCallbacks)) {
+        ret = uv_idle_start(&cn->idleForSendCallbacks, OnIdleForSendCallbacks);
+        if (ret == 0) {
+            /*
+             * Add a ref while OnIdleForSendCallbacks is pending.
+             */
+            ConnectionIncRef(cn);
+        }
+    }
+}
+
+static size_t SendRequestLen(SendRequest* req)
+{
+    size_t len = 0;
+
+    for (size_t i = 0; i < req->numBufs; i++) {
+        len += req->bufs[i].len;
+    }
+    return len;
+}
+
+/*
+ * DPS_NetSend follows libuv and lets the user send multiple
+ * buffers. These are merged together since mbedtls expects a single
+ * buffer.
+ */
+static DPS_Status AppendSendRequest(DPS_NetConnection* cn, DPS_TxBuffer* txbuf, SendRequest* req)
+{
+    DPS_Status ret = DPS_OK;
+
+    if (cn->packing) {
+        ret = CBOR_EncodeUint32(txbuf, SendRequestLen(req));
+    }
+    for (size_t i = 0; (ret == DPS_OK) && (i < req->numBufs); i++) {
+        ret = DPS_TxBufferAppend(txbuf, (uint8_t*)req->bufs[i].base, req->bufs[i].len);
+    }
+    return ret;
+}
+
+static void AllocRecordBuffer(DPS_NetConnection* cn)
+{
+    int expansion = mbedtls_ssl_get_record_expansion(&cn->ssl);
+
+    if ((expansion < 0) || (expansion > MAX_RECORD_EXPANSION)) {
+        expansion = MAX_RECORD_EXPANSION;
+    }
+    cn->recordLen = PATH_MTU - IP_UDP_OVERHEAD - expansion;
+    cn->recordBuf = malloc(cn->recordLen);
+    if (!cn->recordBuf) {
+        cn->recordLen = 0;
+    }
+    DPS_DBGPRINT("Record buffer is %zu bytes cn=%p\n", cn->recordLen, cn);
+}
+
 static void TLSSend(DPS_NetConnection* cn)
 {
+    SendRequest* reqs[MAX_PACKED];
+    size_t numReqs = 0;
     int ret;
     uint8_t* base;
     DPS_TxBuffer txbuf;
     size_t total;
+    size_t i;
 
     DPS_DBGTRACEA("cn=%p\n", cn);
 
@@ -1108,54 +1447,68 @@ static void TLSSend(DPS_NetConnection* cn)
         DPS_DBGPRINT("No pending sends\n");
         return;
     }
-    SendRequest* req = (SendRequest*)DPS_QueueFront(&cn->sendQueue);
-    DPS_QueueRemove(&req->queue);
-
-    DPS_QueuePushBack(&cn->sendCompletedQueue, &req->queue);
-    if (!uv_is_active((uv_handle_t*)&cn->idleForSendCallbacks)) {
-        ret = uv_idle_start(&cn->idleForSendCallbacks, OnIdleForSendCallbacks);
-        if (ret == 0) {
-            /*
-             * Add a ref while OnIdleForSendCallbacks is pending.
-             */
-            DPS_NetConnectionIncRef(cn);
-        }
+    if (!cn->recordBuf) {
+        AllocRecordBuffer(cn);
     }
+    SendRequest* req = (SendRequest*)DPS_QueueFront(&cn->sendQueue);
     DPS_DBGPRINT("Using pending send with %d bufs\n", req->numBufs);
 
-    if (req->numBufs == 1) {
-        total = req->bufs[0].len;
+    DPS_TxBufferClear(&txbuf);
+    total = SendRequestLen(req) + (cn->packing ? PACKED_LEN_SIZE : 0);
+    if ((req->numBufs == 1) && !cn->packing) {
+        CompleteSend(cn, req);
+        reqs[numReqs++] = req;
         base = (uint8_t*)req->bufs[0].base;
-    } else {
-        total = 0;
-        for (size_t i = 0; i < req->numBufs; i++) {
-            total += req->bufs[i].len;
+    } else if (total <= cn->recordLen) {
+        /*
+         * Gather into the record buffer, packing in as many of the
+         * following requests as will fit if the peer supports it.
+         */
+        DPS_TxBufferInit(&txbuf, cn->recordBuf, cn->recordLen);
+        for (;;) {
+            ret = AppendSendRequest(cn, &txbuf, req);
+            assert(ret == DPS_OK);
+            CompleteSend(cn, req);
+            reqs[numReqs++] = req;
+            if (!cn->packing || (numReqs == MAX_PACKED) || DPS_QueueEmpty(&cn->sendQueue)) {
+                break;
+            }
+            req = (SendRequest*)DPS_QueueFront(&cn->sendQueue);
+            if ((SendRequestLen(req) + PACKED_LEN_SIZE) > DPS_TxBufferSpace(&txbuf)) {
+                break;
+            }
         }
-
+        base = txbuf.base;
+        total = DPS_TxBufferUsed(&txbuf);
+        DPS_TxBufferClear(&txbuf);
+    } else {
         /*
-         * DPS_NetSend follows libuv and let the user send multiple
-         * buffers. These are automatically merged together. However
-         * mbedtls expects a single buffer.
+         * Messages too large for the record buffer are rare so
+         * allocate a buffer to hold them.
          */
+        CompleteSend(cn, req);
+        reqs[numReqs++] = req;
         ret = DPS_TxBufferInit(&txbuf, NULL, total);
+        if (ret == DPS_OK) {
+            ret = AppendSendRequest(cn, &txbuf, req);
+        }
         if (ret != DPS_OK) {
+            DPS_TxBufferFree(&txbuf);
             req->status = DPS_ERR_RESOURCES;
             return;
         }
-        for (size_t i = 0; i < req->numBufs; i++) {
-            DPS_TxBufferAppend(&txbuf, (uint8_t*)req->bufs[i].base, req->bufs[i].len);
-        }
         base = txbuf.base;
+        total = DPS_TxBufferUsed(&txbuf);
     }
 
-    DPS_DBGPRINT("Writing %d bytes of plaintext via DTLS\n", total);
+    DPS_DBGPRINT("Writing %d bytes of plaintext from %d requests via DTLS\n", total, numReqs);
     DPS_DBGBYTES(base, total);
 
     /*
      * Protect cn since mbedtls_ssl_write may consume all the
      * references.
      */
-    DPS_NetConnectionIncRef(cn);
+    ConnectionIncRef(cn);
 
     /*
      * HERE: there's no data pointer to make a connection between this
@@ -1171,21 +1524,55 @@ static void TLSSend(DPS_NetConnection* cn)
         ret = mbedtls_ssl_write(&cn->ssl, base, total);
     } while (0 < ret && (size_t)ret < total);
 
-    DPS_NetConnectionDecRef(cn);
+    ConnectionDecRef(cn);
 
-    if (req->numBufs != 1) {
-        DPS_TxBufferFree(&txbuf);
-    }
+    DPS_TxBufferFree(&txbuf);
 
     if (ret < 0) {
         DPS_ERRPRINT("TLS write failed: %s\n", TLSErrTxt(ret));
-        req->status = DPS_ERR_NETWORK;
+        for (i = 0; i < numReqs; ++i) {
+            reqs[i]->status = DPS_ERR_NETWORK;
+        }
+    }
+}
+
+/*
+ * Delivers all but the last message in a packed record to the upper
+ * layer and leaves the buffer holding the last message.
+ */
+static DPS_Status UnpackRecord(DPS_NetConnection* cn, DPS_NetRxBuffer* buf)
+{
+    DPS_NetTransportContext* netCtx = cn->netCtx;
+    DPS_NetRxBuffer* msgBuf;
+    uint32_t msgLen;
+    DPS_Status ret;
+
+    for (;;) {
+        ret = CBOR_DecodeUint32(&buf->rx, &msgLen);
+        if (ret != DPS_OK) {
+            return ret;
+        }
+        if (msgLen > DPS_RxBufferAvail(&buf->rx)) {
+            return DPS_ERR_INVALID;
+        }
+        if (msgLen == DPS_RxBufferAvail(&buf->rx)) {
+            buf->rx.base = buf->rx.rxPos;
+            return DPS_OK;
+        }
+        msgBuf = DPS_CreateNetRxBuffer(msgLen);
+        if (!msgBuf) {
+            return DPS_ERR_RESOURCES;
+        }
+        memcpy_s(msgBuf->rx.base, DPS_RxBufferAvail(&msgBuf->rx), buf->rx.rxPos, msgLen);
+        buf->rx.rxPos += msgLen;
+        netCtx->receiveCB(netCtx->node, &cn->peer, DPS_OK, msgBuf);
+        DPS_NetRxBufferDecRef(msgBuf);
     }
 }
 
 static void TLSRecv(DPS_NetConnection* cn)
 {
-    DPS_NetContext* netCtx = cn->netCtx;
+    DPS_NetTransportContext* netCtx = cn->netCtx;
     DPS_NetRxBuffer* buf = NULL;
     int ret;
     DPS_Status status;
@@ -1194,7 +1581,7 @@ static void TLSRecv(DPS_NetConnection* cn)
      * Protect cn since mbedtls_ssl_read may consume all the
      * references.
      */
-    DPS_NetConnectionIncRef(cn);
+    ConnectionIncRef(cn);
 
     buf = DPS_CreateNetRxBuffer(MAX_READ_LEN);
     if (!buf) {
@@ -1228,7 +1615,11 @@ static void TLSRecv(DPS_NetConnection* cn)
         DPS_DBGPRINT("Decrypted into %d bytes of plaintext\n", buf->rx.eod - buf->rx.base);
         DPS_DBGBYTES(buf->rx.base, buf->rx.eod - buf->rx.base);
 
-        status = DPS_OK;
+        if (cn->packing) {
+            status = UnpackRecord(cn, buf);
+        } else {
+            status = DPS_OK;
+        }
     }
 
     ret = netCtx->receiveCB(netCtx->node, &cn->peer, status, buf);
@@ -1240,13 +1631,13 @@ static void TLSRecv(DPS_NetConnection* cn)
      */
     if (cn->handshake == MBEDTLS_ERR_SSL_WANT_READ) {
         assert(cn->refCount > 1);
-        DPS_NetConnectionDecRef(cn);
+        ConnectionDecRef(cn);
         cn->handshake = 0;
     }
 
 Exit:
     DPS_NetRxBufferDecRef(buf);
-    DPS_NetConnectionDecRef(cn);
+    ConnectionDecRef(cn);
 }
 
 static int TLSHandshake(DPS_NetConnection* cn)
@@ -1271,7 +1662,7 @@ static int TLSHandshake(DPS_NetConnection* cn)
     case MBEDTLS_ERR_SSL_WANT_WRITE:
         break;
     default:
-        DPS_NetConnectionIncRef(cn);
+        ConnectionIncRef(cn);
         break;
     }
 
@@ -1310,12 +1701,31 @@ static int TLSHandshake(DPS_NetConnection* cn)
      */
     if (ret != 0) {
         DPS_WARNPRINT("TLSHandshake failed- %s\n", TLSErrTxt(ret));
+        /*
+         * Don't try to resume the session again
+         */
+        if (cn->type == MBEDTLS_SSL_IS_CLIENT) {
+            ClientSession* cs = LookupSession(cn->netCtx, cn->peerAddr);
+            if (cs) {
+                DeleteSession(cn->netCtx, cs);
+            }
+        }
         goto Exit;
     }
 
     /* Handshake is done, consume anything pending. */
     cn->handshakeDone = DPS_TRUE;
     DPS_DBGPRINT("Handshake is done cn=%p\n", cn);
+    if (cn->type == MBEDTLS_SSL_IS_CLIENT) {
+        SaveSession(cn);
+    }
+#if defined(MBEDTLS_SSL_ALPN)
+    {
+        const char* alpn = mbedtls_ssl_get_alpn_protocol(&cn->ssl);
+        cn->packing = alpn && (strcmp(alpn, PackingProtocols[0]) == 0);
+    }
+#endif
+    DPS_DBGPRINT("Packing is %s cn=%p\n", cn->packing ? "on" : "off", cn);
 
     /*
      * There may not be anything pending yet for a server (incoming)
@@ -1336,7 +1746,7 @@ static int TLSHandshake(DPS_NetConnection* cn)
     case MBEDTLS_ERR_SSL_WANT_WRITE:
         break;
     default:
-        DPS_NetConnectionDecRef(cn);
+        ConnectionDecRef(cn);
         break;
     }
     return !ret;
@@ -1355,7 +1765,7 @@ static void ConsumePending(DPS_NetConnection* cn)
 
 static void OnUdpData(uv_udp_t* socket, ssize_t nread, const uv_buf_t* buf, const struct sockaddr* addr, unsigned flags)
 {
-    DPS_NetContext* netCtx = socket->data;
+    DPS_NetTransportContext* netCtx = socket->data;
     RecvData* data = NULL;
     DPS_NodeAddress* nodeAddr = NULL;
     DPS_NetConnection* cn;
@@ -1405,7 +1815,7 @@ static void OnUdpData(uv_udp_t* socket, ssize_t nread, const uv_buf_t* buf, cons
             DPS_DBGPRINT("Ignoring incoming data while stopping the network\n");
             goto Exit;
         }
-        cn = CreateConnection(netCtx->node, addr, MBEDTLS_SSL_IS_SERVER);
+        cn = CreateConnection(netCtx, addr, MBEDTLS_SSL_IS_SERVER);
         if (!cn) {
             DPS_ERRPRINT("Create server connection structure failed\n");
             goto Exit;
@@ -1426,7 +1836,7 @@ static void OnUdpData(uv_udp_t* socket, ssize_t nread, const uv_buf_t* buf, cons
 
     DPS_QueuePushBack(&cn->recvQueue, &data->queue);
     data = NULL;
-    DPS_NetConnectionIncRef(cn);
+    ConnectionIncRef(cn);
 
     if (!cn->handshakeDone) {
         int ret = TLSHandshake(cn);
@@ -1444,16 +1854,16 @@ static void OnUdpData(uv_udp_t* socket, ssize_t nread, const uv_buf_t* buf, cons
     DPS_DestroyAddress(nodeAddr);
 }
 
-DPS_NetContext* DPS_NetStart(DPS_Node* node, const DPS_NodeAddress* addr, DPS_OnReceive cb)
+static DPS_NetTransportContext* NetStart(DPS_Node* node, const DPS_NodeAddress* addr, DPS_OnReceive cb)
 {
     int ret;
-    DPS_NetContext* netCtx;
+    DPS_NetTransportContext* netCtx;
     struct sockaddr* sa;
     DPS_NodeAddress any;
 
     DPS_DBGTRACEA("node=%p,addr=%s,cb=%p\n", node, DPS_NodeAddrToString(addr), cb);
 
-    netCtx = calloc(1, sizeof(DPS_NetContext));
+    netCtx = calloc(1, sizeof(DPS_NetTransportContext));
     if (!netCtx) {
         return NULL;
     }
@@ -1463,11 +1873,47 @@ DPS_NetContext* DPS_NetStart(DPS_Node* node, const DPS_NodeAddress* addr, DPS_On
         free(netCtx);
         return NULL;
     }
+    netCtx->rxSocket.data = netCtx;
     netCtx->dataCB = OnUdpData;
     netCtx->handshakeTimeoutMin = MBEDTLS_SSL_DTLS_TIMEOUT_DFL_MIN;
     netCtx->handshakeTimeoutMax = MBEDTLS_SSL_DTLS_TIMEOUT_DFL_MAX;
     netCtx->node = node;
     netCtx->receiveCB = cb;
+
+    mbedtls_entropy_init(&netCtx->entropy);
+    mbedtls_ctr_drbg_init(&netCtx->drbg);
+    mbedtls_ssl_cookie_init(&netCtx->cookieCtx);
+    mbedtls_ssl_cache_init(&netCtx->cacheCtx);
+#if defined(MBEDTLS_SSL_TICKET_C)
+    mbedtls_ssl_ticket_init(&netCtx->ticketCtx);
+#endif
+    /*
+     * The default implementation is in
+     * mbedtls_platform_entropy_poll() and will rely on getrandom or
+     * /dev/urandom in Linux; and on CryptGenRandom() on Windows.
+     */
+    ret = mbedtls_ctr_drbg_seed(&netCtx->drbg, mbedtls_entropy_func, &netCtx->entropy,
+                                (const unsigned char*)PERSONALIZATION_STRING, sizeof(PERSONALIZATION_STRING) - 1);
+    if (ret != 0) {
+        DPS_ERRPRINT("Seeding mbedtls random byte generator failed: %s\n", TLSErrTxt(ret));
+        goto ErrorExit;
+    }
+    ret = mbedtls_ssl_cookie_setup(&netCtx->cookieCtx, mbedtls_ctr_drbg_random, &netCtx->drbg);
+    if (ret != 0) {
+        DPS_ERRPRINT("Setting up mbedtls cookie context failed: %s\n", TLSErrTxt(ret));
+        goto ErrorExit;
+    }
+    mbedtls_ssl_cache_set_timeout(&netCtx->cacheCtx, SESSION_TIMEOUT_SECS);
+    mbedtls_ssl_cache_set_max_entries(&netCtx->cacheCtx, MAX_SESSIONS);
+#if defined(MBEDTLS_SSL_TICKET_C)
+    ret = mbedtls_ssl_ticket_setup(&netCtx->ticketCtx, mbedtls_ctr_drbg_random, &netCtx->drbg,
+                                   MBEDTLS_CIPHER_AES_256_GCM, SESSION_TIMEOUT_SECS);
+    if (ret == 0) {
+        netCtx->ticketsEnabled = DPS_TRUE;
+    } else {
+        DPS_WARNPRINT("Setting up mbedtls session tickets failed: %s\n", TLSErrTxt(ret));
+    }
+#endif
     if (addr) {
         sa = (struct sockaddr*)&addr->u.inaddr;
     } else {
@@ -1476,7 +1922,6 @@ DPS_NetContext* DPS_NetStart(DPS_Node* node, const DPS_NodeAddress* addr, DPS_On
         }
         sa = (struct sockaddr*)&any.u.inaddr;
     }
-    netCtx->rxSocket.data = netCtx;
     ret = uv_udp_bind(&netCtx->rxSocket, sa, 0);
     if (ret) {
         goto ErrorExit;
@@ -1498,7 +1943,7 @@ ErrorExit:
     return NULL;
 }
 
-DPS_NodeAddress* DPS_NetGetListenAddress(DPS_NodeAddress* addr, DPS_NetContext* netCtx)
+static DPS_NodeAddress* NetGetListenAddress(DPS_NodeAddress* addr, DPS_NetTransportContext* netCtx)
 {
     int len;
 
@@ -1517,7 +1962,7 @@ DPS_NodeAddress* DPS_NetGetListenAddress(DPS_NodeAddress* addr, DPS_NetContext*
     return addr;
 }
 
-void DPS_NetStop(DPS_NetContext* netCtx)
+static void NetStop(DPS_NetTransportContext* netCtx)
 {
     DPS_NetConnection* cns;
 
@@ -1551,9 +1996,10 @@ void DPS_NetStop(DPS_NetContext* netCtx)
     }
 }
 
-DPS_Status DPS_NetSend(DPS_Node* node, void* appCtx, DPS_NetEndpoint* ep, uv_buf_t* bufs, size_t numBufs,
-                       DPS_NetSendComplete sendCompleteCB)
+static DPS_Status NetSend(DPS_NetTransportContext* netCtx, void* appCtx, DPS_NetEndpoint* ep, uv_buf_t* bufs,
+                          size_t numBufs, DPS_NetSendComplete sendCompleteCB)
 {
+    DPS_Node* node = netCtx->node;
     SendRequest* req;
 
     DPS_DBGTRACEA("node=%p,appCtx=%p,ep={addr=%s,cn=%p},bufs=%p,numBufs=%p,sendCompleteCB=%p\n",
@@ -1580,13 +2026,13 @@ DPS_Status DPS_NetSend(DPS_Node* node, void* appCtx, DPS_NetEndpoint* ep, uv_buf
         req->cn = ep->cn;
         queueEmpty= DPS_QueueEmpty(&ep->cn->sendQueue);
         DPS_QueuePushBack(&ep->cn->sendQueue, &req->queue);
-        DPS_NetConnectionIncRef(ep->cn);
+        ConnectionIncRef(ep->cn);
         if (queueEmpty && ep->cn->handshakeDone) {
             TLSSend(ep->cn);
         }
         return DPS_OK;
     }
-    ep->cn = CreateConnection(node, (const struct sockaddr*)&ep->addr.u.inaddr, MBEDTLS_SSL_IS_CLIENT);
+    ep->cn = CreateConnection(netCtx, (const struct sockaddr*)&ep->addr.u.inaddr, MBEDTLS_SSL_IS_CLIENT);
     if (!ep->cn) {
         goto ErrorExit;
     }
@@ -1602,12 +2048,12 @@ DPS_Status DPS_NetSend(DPS_Node* node, void* appCtx, DPS_NetEndpoint* ep, uv_buf
     req->cn = ep->cn;
     DPS_QueuePushBack(&ep->cn->sendQueue, &req->queue);
     req = NULL;
-    DPS_NetConnectionIncRef(ep->cn);
+    ConnectionIncRef(ep->cn);
     if (ep->cn->handshakeDone) {
         ConsumePending(ep->cn);
     }
     /* The caller gets a ref count to own. */
-    DPS_NetConnectionIncRef(ep->cn);
+    ConnectionIncRef(ep->cn);
     return DPS_OK;
 
  ErrorExit:
@@ -1619,7 +2065,7 @@ DPS_Status DPS_NetSend(DPS_Node* node, void* appCtx, DPS_NetEndpoint* ep, uv_buf
     return DPS_ERR_NETWORK;
 }
 
-void DPS_NetConnectionIncRef(DPS_NetConnection* cn)
+static void ConnectionIncRef(DPS_NetConnection* cn)
 {
     if (cn) {
         DPS_DBGTRACEA("cn=%p\n", cn);
@@ -1627,7 +2073,7 @@ void DPS_NetConnectionIncRef(DPS_NetConnection* cn)
     }
 }
 
-void DPS_NetConnectionDecRef(DPS_NetConnection* cn)
+static void ConnectionDecRef(DPS_NetConnection* cn)
 {
     if (cn) {
         DPS_DBGTRACEA("cn=%p\n", cn);
@@ -1638,10 +2084,22 @@ void DPS_NetConnectionDecRef(DPS_NetConnection* cn)
     }
 }
 
+const DPS_NetTransport DPS_DtlsTransport = {
+    "dtls",
+    DPS_DTLS,
+    NetStart,
+    NetGetListenAddress,
+    NetStop,
+    NetSend,
+    ConnectionIncRef,
+    ConnectionDecRef,
+    NULL
+};
+
 #ifdef DPS_USE_FUZZ
 uv_udp_recv_cb Fuzz_OnData(DPS_Node* node, uv_udp_recv_cb cb)
 {
-    DPS_NetContext* netCtx = node->netCtx;
+    DPS_NetTransportContext* netCtx = DPS_NetGetTransportContext(node->netCtx, &DPS_DtlsTransport);
     uv_udp_recv_cb ret;
 
     /*
@@ -0,0 +1,989 @@
+/*
+ *******************************************************************
+ *
+ * Copyright 2016 Intel Corporation All rights reserved.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ */
+
+#include <assert.h>
+#include <safe_lib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dps/dbg.h>
+#include <dps/dps.h>
+#include <dps/private/cbor.h>
+#include <dps/private/dps.h>
+#include <dps/private/network.h>
+#include "fragment.h"
+#include "history.h"
+#include "node.h"
+
+/*
+ * Debug control for this module
+ */
+DPS_DEBUG_CONTROL(DPS_DEBUG_ON);
+
+/*
+ * Publications longer than this are fragmented so each datagram fits
+ * in the IPv6 minimum MTU without relying on IP fragmentation.
+ */
+#define FRAGMENT_THRESHOLD      1200
+#define MAX_FRAGMENT_LEN        1024
+#define MAX_FRAGMENTS           1024
+
+/*
+ * All times are in milliseconds
+ */
+#define TIMER_INTERVAL          100   /* Interval for checking reassembly progress */
+#define REASSEMBLY_TIMEOUT      5000  /* Incomplete reassemblies are dropped after this long without progress */
+#define NAK_DELAY               200   /* Time without progress before requesting missing fragments */
+#define MAX_NAKS                3     /* Maximum requests for missing fragments without progress */
+#define RETAIN_TIME             5000  /* Time a sent publication is kept for resending fragments */
+
+/*
+ * Bounds on the memory used for reassembly and for resending fragments
+ */
+#define MAX_REASSEMBLY_BYTES    (4 * 1024 * 1024)
+#define MAX_SENT_BYTES          (4 * 1024 * 1024)
+
+#ifdef DPS_DEBUG
+/*
+ * Drops every Nth fragment the first time it is sent, used for testing
+ * retransmission
+ */
+int _DPS_FragmentDropRate = 0;
+#endif
+
+struct _DPS_FragmentedMsg {
+    DPS_Node* node;
+    DPS_UUID pubId;
+    uint32_t sequenceNum;
+    uint32_t msgLen;
+    uint16_t numFrags;
+    uint16_t fragLen;
+    uint32_t refCount;
+    uint8_t naks;             /* NAKs answered so far */
+    uint64_t expires;
+    DPS_FragmentedMsg* next;
+    uint8_t data[1];
+};
+
+struct _DPS_Reassembly {
+    DPS_NodeAddress addr;     /* Address the fragments are received from */
+    DPS_NetEndpoint ep;       /* Endpoint for requesting missing fragments */
+    DPS_UUID pubId;
+    uint32_t sequenceNum;
+    uint32_t msgLen;
+    uint16_t numFrags;
+    uint16_t fragLen;
+    uint16_t received;
+    uint8_t naks;
+    uint64_t expires;
+    uint64_t nakTime;
+    DPS_NetRxBuffer* buf;
+    DPS_Reassembly* next;
+    uint8_t bitmap[1];        /* Fragments received so far */
+};
+
+#define BITMAP_LEN(n)     ((size_t)(((n) + 7) / 8))
+#define TEST_BIT(m, i)    ((m)[(i) / 8] & (1 << ((i) % 8)))
+#define SET_BIT(m, i)     ((m)[(i) / 8] |= (1 << ((i) % 8)))
+
+static size_t BufsLen(const uv_buf_t* bufs, size_t numBufs)
+{
+    size_t len = 0;
+    size_t i;
+
+    for (i = 0; i < numBufs; ++i) {
+        len += bufs[i].len;
+    }
+    return len;
+}
+
+static void OnTimer(uv_timer_t* timer);
+
+static void StartTimer(DPS_Node* node)
+{
+    if (!uv_is_active((uv_handle_t*)&node->fragments.timer)) {
+        uv_timer_start(&node->fragments.timer, OnTimer, TIMER_INTERVAL, TIMER_INTERVAL);
+    }
+}
+
+static size_t ListenAddrSize(const DPS_NodeAddress* addr)
+{
+    switch (addr->type) {
+    case DPS_DTLS:
+    case DPS_TCP:
+    case DPS_UDP:
+        return CBOR_SIZEOF(uint8_t) + CBOR_SIZEOF(uint16_t);
+    case DPS_PIPE:
+    case DPS_SHM:
+        return CBOR_SIZEOF(uint8_t) + CBOR_SIZEOF_STRING(addr->u.path);
+    default:
+        return 0;
+    }
+}
+
+/*
+ * Map keys must be encoded in ascending order so the listen address is
+ * encoded by calling this function at the position of each of the
+ * keys, only the key that applies to the address is encoded.
+ */
+static DPS_Status EncodeListenAddr(const DPS_NodeAddress* addr, int32_t key, DPS_TxBuffer* buf)
+{
+    DPS_Status ret = DPS_OK;
+
+    switch (addr->type) {
+    case DPS_DTLS:
+    case DPS_TCP:
+    case DPS_UDP:
+        if (key == DPS_CBOR_KEY_PORT) {
+            ret = CBOR_EncodeUint8(buf, DPS_CBOR_KEY_PORT);
+            if (ret == DPS_OK) {
+                ret = CBOR_EncodeUint16(buf, DPS_NetAddrPort((const struct sockaddr*)&addr->u.inaddr));
+            }
+        }
+        break;
+    case DPS_PIPE:
+    case DPS_SHM:
+        if (key == DPS_CBOR_KEY_PATH) {
+            ret = CBOR_EncodeUint8(buf, DPS_CBOR_KEY_PATH);
+            if (ret == DPS_OK) {
+                ret = CBOR_EncodeString(buf, addr->u.path);
+            }
+        }
+        break;
+    default:
+        ret = DPS_ERR_INVALID;
+        break;
+    }
+    return ret;
+}
+
+/*
+ * Sent publications
+ */
+
+static void MsgDecRef(DPS_FragmentedMsg* msg)
+{
+    assert(msg->refCount > 0);
+    if (--msg->refCount == 0) {
+        free(msg);
+    }
+}
+
+static DPS_FragmentedMsg* LookupSent(DPS_Node* node, const DPS_UUID* pubId, uint32_t sequenceNum, uint32_t msgLen)
+{
+    DPS_FragmentedMsg* msg;
+
+    for (msg = node->fragments.sent; msg; msg = msg->next) {
+        if ((msg->sequenceNum == sequenceNum) && (msg->msgLen == msgLen) &&
+            (DPS_UUIDCompare(&msg->pubId, pubId) == 0)) {
+            break;
+        }
+    }
+    return msg;
+}
+
+static void RemoveSent(DPS_Node* node, DPS_FragmentedMsg* msg)
+{
+    DPS_FragmentedMsg** prev = &node->fragments.sent;
+
+    while (*prev != msg) {
+        prev = &(*prev)->next;
+    }
+    *prev = msg->next;
+    node->fragments.sentBytes -= msg->msgLen;
+    MsgDecRef(msg);
+}
+
+static void AddSent(DPS_Node* node, DPS_FragmentedMsg* msg)
+{
+    /*
+     * Make room by removing the oldest publications, these are at the
+     * end of the list
+     */
+    while (node->fragments.sent && ((node->fragments.sentBytes + msg->msgLen) > MAX_SENT_BYTES)) {
+        DPS_FragmentedMsg* last = node->fragments.sent;
+        while (last->next) {
+            last = last->next;
+        }
+        RemoveSent(node, last);
+    }
+    ++msg->refCount;
+    msg->expires = uv_now(node->loop) + RETAIN_TIME;
+    msg->next = node->fragments.sent;
+    node->fragments.sent = msg;
+    node->fragments.sentBytes += msg->msgLen;
+    StartTimer(node);
+}
+
+static DPS_FragmentedMsg* CreateMsg(DPS_Node* node, const DPS_UUID* pubId, uint32_t sequenceNum,
+                                    const uv_buf_t* bufs, size_t numBufs, size_t len)
+{
+    DPS_FragmentedMsg* msg;
+    uint8_t* pos;
+    size_t i;
+
+    msg = malloc(sizeof(DPS_FragmentedMsg) + len - 1);
+    if (!msg) {
+        return NULL;
+    }
+    msg->node = node;
+    msg->pubId = *pubId;
+    msg->sequenceNum = sequenceNum;
+    msg->msgLen = (uint32_t)len;
+    msg->numFrags = (uint16_t)((len + MAX_FRAGMENT_LEN - 1) / MAX_FRAGMENT_LEN);
+    /*
+     * Spread the message evenly over the fragments
+     */
+    msg->fragLen = (uint16_t)((len + msg->numFrags - 1) / msg->numFrags);
+    msg->refCount = 1;
+    msg->naks = 0;
+    msg->next = NULL;
+    pos = msg->data;
+    for (i = 0; i < numBufs; ++i) {
+        if (bufs[i].len) {
+            memcpy_s(pos, len - (pos - msg->data), bufs[i].base, bufs[i].len);
+            pos += bufs[i].len;
+        }
+    }
+    return msg;
+}
+
+static void OnNetSendComplete(DPS_Node* node, void* appCtx, DPS_NetEndpoint* ep, uv_buf_t* bufs,
+                              size_t numBufs, DPS_Status status)
+{
+    DPS_LockNode(node);
+    /*
+     * Only the first buffer belongs to us
+     */
+    DPS_SendComplete(node, ep ? &ep->addr : NULL, bufs, 1, status);
+    MsgDecRef((DPS_FragmentedMsg*)appCtx);
+    DPS_UnlockNode(node);
+}
+
+static void OnMulticastSendComplete(DPS_MulticastSender* sender, void* appCtx, uv_buf_t* bufs,
+                                    size_t numBufs, DPS_Status status)
+{
+    DPS_FragmentedMsg* msg = appCtx;
+    DPS_Node* node = msg->node;
+
+    DPS_LockNode(node);
+    DPS_NetFreeBufs(bufs, 1);
+    MsgDecRef(msg);
+    DPS_UnlockNode(node);
+}
+
+static DPS_Status SendFragment(DPS_Node* node, DPS_FragmentedMsg* msg, DPS_NetEndpoint* ep, uint16_t fragNum)
+{
+    const DPS_NodeAddress* listenAddr = DPS_ListenAddressFor(node, ep);
+    DPS_Status ret;
+    DPS_TxBuffer buf;
+    uv_buf_t bufs[2];
+    uint32_t offset = fragNum * msg->fragLen;
+    uint32_t fragLen = msg->fragLen;
+    size_t len;
+
+    if ((fragNum + 1) == msg->numFrags) {
+        fragLen = msg->msgLen - offset;
+    }
+    len = CBOR_SIZEOF_ARRAY(5) +
+        CBOR_SIZEOF(uint8_t) +
+        CBOR_SIZEOF(uint8_t) +
+        CBOR_SIZEOF_MAP(6) + 5 * CBOR_SIZEOF(uint8_t) +
+        ListenAddrSize(listenAddr) +
+        CBOR_SIZEOF_BYTES(sizeof(DPS_UUID)) +
+        CBOR_SIZEOF(uint32_t) +
+        2 * CBOR_SIZEOF(uint16_t) +
+        CBOR_SIZEOF(uint32_t) +
+        CBOR_SIZEOF_MAP(0) +
+        CBOR_SIZEOF_LEN(fragLen);
+    ret = DPS_TxBufferInit(&buf, NULL, len);
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeArray(&buf, 5);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint8(&buf, DPS_MSG_VERSION);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint8(&buf, DPS_MSG_TYPE_FRAG);
+    }
+    /*
+     * Encode the unprotected map
+     */
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeMap(&buf, 6);
+    }
+    if (ret == DPS_OK) {
+        ret = EncodeListenAddr(listenAddr, DPS_CBOR_KEY_PORT, &buf);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint8(&buf, DPS_CBOR_KEY_PUB_ID);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUUID(&buf, &msg->pubId);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint8(&buf, DPS_CBOR_KEY_SEQ_NUM);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint32(&buf, msg->sequenceNum);
+    }
+    if (ret == DPS_OK) {
+        ret = EncodeListenAddr(listenAddr, DPS_CBOR_KEY_PATH, &buf);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint8(&buf, DPS_CBOR_KEY_FRAG_NUM);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint16(&buf, fragNum);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint8(&buf, DPS_CBOR_KEY_NUM_FRAGS);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint16(&buf, msg->numFrags);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint8(&buf, DPS_CBOR_KEY_MSG_LEN);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint32(&buf, msg->msgLen);
+    }
+    /*
+     * Encode the (empty) protected map, the fragment is covered by
+     * the protection of the reassembled publication
+     */
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeMap(&buf, 0);
+    }
+    /*
+     * The fragment bytes are sent from the copy of the message
+     */
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeLength(&buf, fragLen, CBOR_BYTES);
+    }
+    if (ret != DPS_OK) {
+        DPS_TxBufferFree(&buf);
+        return ret;
+    }
+    bufs[0] = uv_buf_init((char*)buf.base, DPS_TxBufferUsed(&buf));
+    bufs[1] = uv_buf_init((char*)msg->data + offset, fragLen);
+    ++msg->refCount;
+    if (ep) {
+        ret = DPS_NetSend(node, msg, ep, bufs, 2, OnNetSendComplete);
+    } else {
+        ret = DPS_MulticastSend(node->mcastSender, msg, bufs, 2, OnMulticastSendComplete);
+    }
+    if (ret != DPS_OK) {
+        DPS_TxBufferFree(&buf);
+        --msg->refCount;
+    }
+    return ret;
+}
+
+int DPS_NeedsFragmenting(const DPS_NetEndpoint* ep, const uv_buf_t* bufs, size_t numBufs)
+{
+    if (ep && (ep->addr.type != DPS_UDP)) {
+        return DPS_FALSE;
+    }
+    return BufsLen(bufs, numBufs) > FRAGMENT_THRESHOLD;
+}
+
+DPS_Status DPS_SendFragments(DPS_Node* node, DPS_NetEndpoint* ep, const DPS_UUID* pubId, uint32_t sequenceNum,
+                             const uv_buf_t* bufs, size_t numBufs)
+{
+    DPS_Status ret = DPS_OK;
+    DPS_FragmentedMsg* msg;
+    size_t len = BufsLen(bufs, numBufs);
+    uint16_t i;
+
+    DPS_DBGTRACE();
+
+    if (len > (MAX_FRAGMENTS * MAX_FRAGMENT_LEN)) {
+        DPS_ERRPRINT("Publication is too large to fragment - %zu bytes\n", len);
+        return DPS_ERR_OVERFLOW;
+    }
+    if (!ep && !node->mcastSender) {
+        return DPS_ERR_NO_ROUTE;
+    }
+    /*
+     * The same message is often sent to several destinations so reuse
+     * the copy if it has not changed
+     */
+    msg = LookupSent(node, pubId, sequenceNum, (uint32_t)len);
+    if (msg) {
+        size_t offset = 0;
+        for (i = 0; i < numBufs; ++i) {
+            if (bufs[i].len && memcmp(msg->data + offset, bufs[i].base, bufs[i].len)) {
+                break;
+            }
+            offset += bufs[i].len;
+        }
+        if (i < numBufs) {
+            RemoveSent(node, msg);
+            msg = NULL;
+        } else {
+            ++msg->refCount;
+        }
+    }
+    if (!msg) {
+        msg = CreateMsg(node, pubId, sequenceNum, bufs, numBufs, len);
+        if (!msg) {
+            return DPS_ERR_RESOURCES;
+        }
+        AddSent(node, msg);
+    }
+    DPS_DBGPRINT("Sending %s/%d as %d fragments of %d bytes\n", DPS_UUIDToString(pubId), sequenceNum,
+                 msg->numFrags, msg->fragLen);
+    for (i = 0; i < msg->numFrags; ++i) {
+#ifdef DPS_DEBUG
+        if (_DPS_FragmentDropRate && ((i % _DPS_FragmentDropRate) == (_DPS_FragmentDropRate - 1))) {
+            DPS_DBGPRINT("Dropping fragment %d\n", i);
+            continue;
+        }
+#endif
+        ret = SendFragment(node, msg, ep, i);
+        if (ret != DPS_OK) {
+            DPS_ERRPRINT("Failed to send fragment %d - %s\n", i, DPS_ErrTxt(ret));
+            break;
+        }
+    }
+    MsgDecRef(msg);
+    return ret;
+}
+
+DPS_Status DPS_DecodeFragmentNak(DPS_Node* node, DPS_NetEndpoint* ep, DPS_NetRxBuffer* buf)
+{
+    static const int32_t UnprotectedKeys[] = { DPS_CBOR_KEY_PUB_ID, DPS_CBOR_KEY_SEQ_NUM, DPS_CBOR_KEY_MSG_LEN,
+                                               DPS_CBOR_KEY_MISSING };
+    static const int32_t UnprotectedOptKeys[] = { DPS_CBOR_KEY_PORT, DPS_CBOR_KEY_PATH };
+    DPS_RxBuffer* rxBuf = (DPS_RxBuffer*)buf;
+    DPS_Status ret;
+    CBOR_MapState mapState;
+    DPS_FragmentedMsg* msg;
+    DPS_UUID pubId;
+    uint32_t sequenceNum = 0;
+    uint32_t msgLen = 0;
+    uint8_t* missing = NULL;
+    size_t missingLen = 0;
+    uint16_t port = 0;
+    char* path = NULL;
+    size_t pathLen = 0;
+    uint32_t keysMask = 0;
+    uint16_t i;
+
+    DPS_DBGTRACE();
+
+    ret = DPS_ParseMapInit(&mapState, rxBuf, UnprotectedKeys, A_SIZEOF(UnprotectedKeys),
+                           UnprotectedOptKeys, A_SIZEOF(UnprotectedOptKeys));
+    if (ret != DPS_OK) {
+        return ret;
+    }
+    while (!DPS_ParseMapDone(&mapState)) {
+        int32_t key;
+        ret = DPS_ParseMapNext(&mapState, &key);
+        if (ret != DPS_OK) {
+            break;
+        }
+        switch (key) {
+        case DPS_CBOR_KEY_PORT:
+            keysMask |= (1 << key);
+            ret = CBOR_DecodeUint16(rxBuf, &port);
+            break;
+        case DPS_CBOR_KEY_PATH:
+            keysMask |= (1 << key);
+            ret = CBOR_DecodeString(rxBuf, &path, &pathLen);
+            if ((ret == DPS_OK) && (pathLen >= DPS_NODE_ADDRESS_PATH_MAX)) {
+                ret = DPS_ERR_INVALID;
+            }
+            break;
+        case DPS_CBOR_KEY_PUB_ID:
+            ret = CBOR_DecodeUUID(rxBuf, &pubId);
+            break;
+        case DPS_CBOR_KEY_SEQ_NUM:
+            ret = CBOR_DecodeUint32(rxBuf, &sequenceNum);
+            break;
+        case DPS_CBOR_KEY_MSG_LEN:
+            ret = CBOR_DecodeUint32(rxBuf, &msgLen);
+            break;
+        case DPS_CBOR_KEY_MISSING:
+            ret = CBOR_DecodeBytes(rxBuf, &missing, &missingLen);
+            break;
+        }
+        if (ret != DPS_OK) {
+            break;
+        }
+    }
+    if (ret != DPS_OK) {
+        return ret;
+    }
+    if (keysMask & (1 << DPS_CBOR_KEY_PORT)) {
+        DPS_EndpointSetPort(ep, port);
+    } else if (keysMask & (1 << DPS_CBOR_KEY_PATH)) {
+        DPS_EndpointSetPath(ep, path, pathLen);
+    } else {
+        DPS_WARNPRINT("Missing required key\n");
+        return DPS_ERR_INVALID;
+    }
+
+    DPS_LockNode(node);
+    /*
+     * Only answer NAKs if the application has opted in to retransmission
+     */
+    if (!node->fragments.retransmit) {
+        DPS_UnlockNode(node);
+        DPS_DBGPRINT("Ignoring NAK from %s\n", DPS_NodeAddrToString(&ep->addr));
+        return DPS_OK;
+    }
+    msg = LookupSent(node, &pubId, sequenceNum, msgLen);
+    if (!msg) {
+        DPS_DBGPRINT("Publication %s/%d is no longer available for resending\n", DPS_UUIDToString(&pubId),
+                     sequenceNum);
+    } else if (missingLen != BITMAP_LEN(msg->numFrags)) {
+        ret = DPS_ERR_INVALID;
+    } else if (msg->naks >= MAX_NAKS) {
+        /*
+         * Limit how often a publication is resent to bound the
+         * traffic that can be triggered by NAKs
+         */
+        DPS_DBGPRINT("Too many NAKs for %s/%d\n", DPS_UUIDToString(&pubId), sequenceNum);
+    } else {
+        ++msg->naks;
+        DPS_DBGPRINT("Resending fragments of %s/%d to %s\n", DPS_UUIDToString(&pubId), sequenceNum,
+                     DPS_NodeAddrToString(&ep->addr));
+        for (i = 0; (ret == DPS_OK) && (i < msg->numFrags); ++i) {
+            if (TEST_BIT(missing, i)) {
+                ret = SendFragment(node, msg, ep, i);
+            }
+        }
+    }
+    DPS_UnlockNode(node);
+    return ret;
+}
+
+/*
+ * Reassembly
+ */
+
+static void FreeReassembly(DPS_Node* node, DPS_Reassembly* r)
+{
+    DPS_Reassembly** prev = &node->fragments.reassemblies;
+
+    while (*prev != r) {
+        prev = &(*prev)->next;
+    }
+    *prev = r->next;
+    node->fragments.reassemblyBytes -= r->msgLen;
+    DPS_NetRxBufferDecRef(r->buf);
+    free(r);
+}
+
+static DPS_Reassembly* LookupReassembly(DPS_Node* node, const DPS_NodeAddress* addr, const DPS_UUID* pubId,
+                                        uint32_t sequenceNum)
+{
+    DPS_Reassembly* r;
+
+    for (r = node->fragments.reassemblies; r; r = r->next) {
+        if ((r->sequenceNum == sequenceNum) && (DPS_UUIDCompare(&r->pubId, pubId) == 0) &&
+            DPS_SameAddr(&r->addr, addr)) {
+            break;
+        }
+    }
+    return r;
+}
+
+static DPS_Reassembly* CreateReassembly(DPS_Node* node, const DPS_NodeAddress* addr, const DPS_UUID* pubId,
+                                        uint32_t sequenceNum, uint32_t msgLen, uint16_t numFrags)
+{
+    DPS_Reassembly* r;
+
+    if (msgLen > MAX_REASSEMBLY_BYTES) {
+        return NULL;
+    }
+    /*
+     * Make room by dropping the reassemblies that have gone longest
+     * without progress
+     */
+    while ((node->fragments.reassemblyBytes + msgLen) > MAX_REASSEMBLY_BYTES) {
+        DPS_Reassembly* oldest = node->fragments.reassemblies;
+        for (r = oldest->next; r; r = r->next) {
+            if (r->expires < oldest->expires) {
+                oldest = r;
+            }
+        }
+        DPS_WARNPRINT("Dropping incomplete publication %s/%d\n", DPS_UUIDToString(&oldest->pubId),
+                      oldest->sequenceNum);
+        FreeReassembly(node, oldest);
+    }
+    r = calloc(1, sizeof(DPS_Reassembly) + BITMAP_LEN(numFrags) - 1);
+    if (!r) {
+        return NULL;
+    }
+    r->buf = DPS_CreateNetRxBuffer(msgLen);
+    if (!r->buf) {
+        free(r);
+        return NULL;
+    }
+    r->addr = *addr;
+    r->pubId = *pubId;
+    r->sequenceNum = sequenceNum;
+    r->msgLen = msgLen;
+    r->numFrags = numFrags;
+    r->fragLen = (uint16_t)((msgLen + numFrags - 1) / numFrags);
+    r->next = node->fragments.reassemblies;
+    node->fragments.reassemblies = r;
+    node->fragments.reassemblyBytes += msgLen;
+    StartTimer(node);
+    return r;
+}
+
+/*
+ * Only publications are fragmented
+ */
+static DPS_Status CheckReassembled(DPS_NetRxBuffer* buf)
+{
+    DPS_RxBuffer rxBuf = buf->rx;
+    DPS_Status ret;
+    uint8_t msgVersion;
+    uint8_t msgType;
+    size_t len;
+
+    ret = CBOR_DecodeArray(&rxBuf, &len);
+    if ((ret == DPS_OK) && (len != 5)) {
+        ret = DPS_ERR_INVALID;
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_DecodeUint8(&rxBuf, &msgVersion);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_DecodeUint8(&rxBuf, &msgType);
+    }
+    if ((ret == DPS_OK) && ((msgVersion != DPS_MSG_VERSION) || (msgType != DPS_MSG_TYPE_PUB))) {
+        ret = DPS_ERR_INVALID;
+    }
+    return ret;
+}
+
+DPS_Status DPS_DecodeFragment(DPS_Node* node, DPS_NetEndpoint* ep, DPS_NetRxBuffer* buf, DPS_NetRxBuffer** msgBuf)
+{
+    static const int32_t UnprotectedKeys[] = { DPS_CBOR_KEY_PUB_ID, DPS_CBOR_KEY_SEQ_NUM, DPS_CBOR_KEY_FRAG_NUM,
+                                               DPS_CBOR_KEY_NUM_FRAGS, DPS_CBOR_KEY_MSG_LEN };
+    static const int32_t UnprotectedOptKeys[] = { DPS_CBOR_KEY_PORT, DPS_CBOR_KEY_PATH };
+    DPS_RxBuffer* rxBuf = (DPS_RxBuffer*)buf;
+    DPS_Status ret;
+    CBOR_MapState mapState;
+    DPS_Reassembly* r;
+    DPS_UUID pubId;
+    uint32_t sequenceNum = 0;
+    uint16_t fragNum = 0;
+    uint16_t numFrags = 0;
+    uint32_t msgLen = 0;
+    uint32_t fragLen;
+    uint8_t* data;
+    size_t len;
+    uint16_t port = 0;
+    char* path = NULL;
+    size_t pathLen = 0;
+    uint32_t keysMask = 0;
+    uint64_t now;
+
+    DPS_DBGTRACE();
+
+    *msgBuf = NULL;
+    ret = DPS_ParseMapInit(&mapState, rxBuf, UnprotectedKeys, A_SIZEOF(UnprotectedKeys),
+                           UnprotectedOptKeys, A_SIZEOF(UnprotectedOptKeys));
+    if (ret != DPS_OK) {
+        return ret;
+    }
+    while (!DPS_ParseMapDone(&mapState)) {
+        int32_t key;
+        ret = DPS_ParseMapNext(&mapState, &key);
+        if (ret != DPS_OK) {
+            break;
+        }
+        switch (key) {
+        case DPS_CBOR_KEY_PORT:
+            keysMask |= (1 << key);
+            ret = CBOR_DecodeUint16(rxBuf, &port);
+            break;
+        case DPS_CBOR_KEY_PATH:
+            keysMask |= (1 << key);
+            ret = CBOR_DecodeString(rxBuf, &path, &pathLen);
+            if ((ret == DPS_OK) && (pathLen >= DPS_NODE_ADDRESS_PATH_MAX)) {
+                ret = DPS_ERR_INVALID;
+            }
+            break;
+        case DPS_CBOR_KEY_PUB_ID:
+            ret = CBOR_DecodeUUID(rxBuf, &pubId);
+            break;
+        case DPS_CBOR_KEY_SEQ_NUM:
+            ret = CBOR_DecodeUint32(rxBuf, &sequenceNum);
+            break;
+        case DPS_CBOR_KEY_FRAG_NUM:
+            ret = CBOR_DecodeUint16(rxBuf, &fragNum);
+            break;
+        case DPS_CBOR_KEY_NUM_FRAGS:
+            ret = CBOR_DecodeUint16(rxBuf, &numFrags);
+            break;
+        case DPS_CBOR_KEY_MSG_LEN:
+            ret = CBOR_DecodeUint32(rxBuf, &msgLen);
+            break;
+        }
+        if (ret != DPS_OK) {
+            break;
+        }
+    }
+    if (ret != DPS_OK) {
+        return ret;
+    }
+    /*
+     * Skip the (empty) protected map
+     */
+    ret = CBOR_Skip(rxBuf, NULL, NULL);
+    if (ret == DPS_OK) {
+        ret = CBOR_DecodeBytes(rxBuf, &data, &len);
+    }
+    if (ret != DPS_OK) {
+        return ret;
+    }
+    if (!numFrags || (numFrags > MAX_FRAGMENTS) || (fragNum >= numFrags) ||
+        (msgLen > (numFrags * MAX_FRAGMENT_LEN)) || (msgLen < numFrags)) {
+        return DPS_ERR_INVALID;
+    }
+    fragLen = (msgLen + numFrags - 1) / numFrags;
+    /*
+     * Every fragment must start inside the message, otherwise the
+     * reassembly could never complete
+     */
+    if (((uint32_t)(numFrags - 1) * fragLen) >= msgLen) {
+        return DPS_ERR_INVALID;
+    }
+    if ((fragNum + 1) == numFrags) {
+        if (len != (msgLen - (fragNum * fragLen))) {
+            return DPS_ERR_INVALID;
+        }
+    } else if (len != fragLen) {
+        return DPS_ERR_INVALID;
+    }
+
+    DPS_LockNode(node);
+    /*
+     * Ignore fragments of publications that have already been received
+     */
+    if (DPS_PublicationIsStale(&node->history, &pubId, sequenceNum)) {
+        DPS_DBGPRINT("Publication %s/%d is stale\n", DPS_UUIDToString(&pubId), sequenceNum);
+        ret = DPS_ERR_STALE;
+        goto Exit;
+    }
+    r = LookupReassembly(node, &ep->addr, &pubId, sequenceNum);
+    if (r && ((r->msgLen != msgLen) || (r->numFrags != numFrags))) {
+        DPS_WARNPRINT("Inconsistent fragment of %s/%d\n", DPS_UUIDToString(&pubId), sequenceNum);
+        FreeReassembly(node, r);
+        r = NULL;
+    }
+    if (!r) {
+        r = CreateReassembly(node, &ep->addr, &pubId, sequenceNum, msgLen, numFrags);
+        if (!r) {
+            ret = DPS_ERR_RESOURCES;
+            goto Exit;
+        }
+    }
+    /*
+     * Record where to send requests for missing fragments
+     */
+    r->ep = *ep;
+    if (keysMask & (1 << DPS_CBOR_KEY_PORT)) {
+        DPS_EndpointSetPort(&r->ep, port);
+    } else if (keysMask & (1 << DPS_CBOR_KEY_PATH)) {
+        DPS_EndpointSetPath(&r->ep, path, pathLen);
+    }
+    if (TEST_BIT(r->bitmap, fragNum)) {
+        DPS_DBGPRINT("Duplicate fragment %d of %s/%d\n", fragNum, DPS_UUIDToString(&pubId), sequenceNum);
+        goto Exit;
+    }
+    if (memcpy_s(r->buf->rx.base + fragNum * r->fragLen, msgLen - fragNum * r->fragLen, data, len) != EOK) {
+        ret = DPS_ERR_INVALID;
+        goto Exit;
+    }
+    SET_BIT(r->bitmap, fragNum);
+    now = uv_now(node->loop);
+    r->expires = now + REASSEMBLY_TIMEOUT;
+    r->nakTime = now + NAK_DELAY;
+    r->naks = 0;
+    if (++r->received == r->numFrags) {
+        DPS_DBGPRINT("Reassembled %s/%d from %d fragments\n", DPS_UUIDToString(&pubId), sequenceNum, numFrags);
+        ret = CheckReassembled(r->buf);
+        if (ret == DPS_OK) {
+            *msgBuf = r->buf;
+            DPS_NetRxBufferIncRef(r->buf);
+        }
+        FreeReassembly(node, r);
+    }
+Exit:
+    DPS_UnlockNode(node);
+    return ret;
+}
+
+static DPS_Status SendNak(DPS_Node* node, DPS_Reassembly* r)
+{
+    const DPS_NodeAddress* listenAddr = DPS_ListenAddressFor(node, &r->ep);
+    DPS_Status ret;
+    DPS_TxBuffer buf;
+    uint8_t* missing;
+    size_t len;
+    uint16_t i;
+
+    len = CBOR_SIZEOF_ARRAY(5) +
+        CBOR_SIZEOF(uint8_t) +
+        CBOR_SIZEOF(uint8_t) +
+        CBOR_SIZEOF_MAP(5) + 4 * CBOR_SIZEOF(uint8_t) +
+        ListenAddrSize(listenAddr) +
+        CBOR_SIZEOF_BYTES(sizeof(DPS_UUID)) +
+        2 * CBOR_SIZEOF(uint32_t) +
+        CBOR_SIZEOF_BYTES(BITMAP_LEN(r->numFrags)) +
+        2 * CBOR_SIZEOF_MAP(0);
+    ret = DPS_TxBufferInit(&buf, NULL, len);
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeArray(&buf, 5);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint8(&buf, DPS_MSG_VERSION);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint8(&buf, DPS_MSG_TYPE_NAK);
+    }
+    /*
+     * Encode the unprotected map
+     */
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeMap(&buf, 5);
+    }
+    if (ret == DPS_OK) {
+        ret = EncodeListenAddr(listenAddr, DPS_CBOR_KEY_PORT, &buf);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint8(&buf, DPS_CBOR_KEY_PUB_ID);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUUID(&buf, &r->pubId);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint8(&buf, DPS_CBOR_KEY_SEQ_NUM);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint32(&buf, r->sequenceNum);
+    }
+    if (ret == DPS_OK) {
+        ret = EncodeListenAddr(listenAddr, DPS_CBOR_KEY_PATH, &buf);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint8(&buf, DPS_CBOR_KEY_MSG_LEN);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint32(&buf, r->msgLen);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint8(&buf, DPS_CBOR_KEY_MISSING);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_ReserveBytes(&buf, BITMAP_LEN(r->numFrags), &missing);
+    }
+    if (ret == DPS_OK) {
+        for (i = 0; i < BITMAP_LEN(r->numFrags); ++i) {
+            missing[i] = ~r->bitmap[i];
+        }
+    }
+    /*
+     * Encode the (empty) protected and encrypted maps
+     */
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeMap(&buf, 0);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeMap(&buf, 0);
+    }
+    if (ret == DPS_OK) {
+        uv_buf_t uvBuf = uv_buf_init((char*)buf.base, DPS_TxBufferUsed(&buf));
+        DPS_DBGPRINT("Requesting %d missing fragments of %s/%d from %s\n", r->numFrags - r->received,
+                     DPS_UUIDToString(&r->pubId), r->sequenceNum, DPS_NodeAddrToString(&r->ep.addr));
+        ret = DPS_NetSend(node, NULL, &r->ep, &uvBuf, 1, DPS_OnSendComplete);
+        if (ret != DPS_OK) {
+            DPS_SendComplete(node, &r->ep.addr, &uvBuf, 1, ret);
+        }
+    } else {
+        DPS_TxBufferFree(&buf);
+    }
+    return ret;
+}
+
+static void OnTimer(uv_timer_t* timer)
+{
+    DPS_Node* node = (DPS_Node*)timer->data;
+    DPS_Reassembly* r;
+    DPS_Reassembly* rNext;
+    DPS_FragmentedMsg* msg;
+    DPS_FragmentedMsg* msgNext;
+    uint64_t now;
+
+    DPS_LockNode(node);
+    now = uv_now(node->loop);
+    for (r = node->fragments.reassemblies; r; r = rNext) {
+        rNext = r->next;
+        if (now >= r->expires) {
+            DPS_WARNPRINT("Dropping incomplete publication %s/%d, received %d of %d fragments\n",
+                          DPS_UUIDToString(&r->pubId), r->sequenceNum, r->received, r->numFrags);
+            FreeReassembly(node, r);
+        } else if (node->fragments.retransmit && (now >= r->nakTime) && (r->naks < MAX_NAKS)) {
+            SendNak(node, r);
+            /*
+             * Back off if the sender does not respond
+             */
+            ++r->naks;
+            r->nakTime = now + (NAK_DELAY << r->naks);
+        }
+    }
+    for (msg = node->fragments.sent; msg; msg = msgNext) {
+        msgNext = msg->next;
+        if (now >= msg->expires) {
+            RemoveSent(node, msg);
+        }
+    }
+    if (!node->fragments.reassemblies && !node->fragments.sent) {
+        uv_timer_stop(timer);
+    }
+    DPS_UnlockNode(node);
+}
+
+void DPS_FragmentsFree(DPS_Fragments* fragments)
+{
+    while (fragments->reassemblies) {
+        DPS_Reassembly* r = fragments->reassemblies;
+        fragments->reassemblies = r->next;
+        DPS_NetRxBufferDecRef(r->buf);
+        free(r);
+    }
+    fragments->reassemblyBytes = 0;
+    while (fragments->sent) {
+        DPS_FragmentedMsg* msg = fragments->sent;
+        fragments->sent = msg->next;
+        MsgDecRef(msg);
+    }
+    fragments->sentBytes = 0;
+}
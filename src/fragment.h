@@ -0,0 +1,129 @@
+/**
+ * @file
+ * Fragmentation and reassembly of publications sent over datagram transports
+ */
+
+/*
+ *******************************************************************
+ *
+ * Copyright 2016 Intel Corporation All rights reserved.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ */
+
+#ifndef _DPS_FRAGMENT_H
+#define _DPS_FRAGMENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <uv.h>
+#include <dps/dps.h>
+#include <dps/uuid.h>
+#include <dps/private/network.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A publication that has been sent as fragments. These are kept for a
+ * while so missing fragments can be resent.
+ */
+typedef struct _DPS_FragmentedMsg DPS_FragmentedMsg;
+
+/**
+ * A publication being reassembled from fragments
+ */
+typedef struct _DPS_Reassembly DPS_Reassembly;
+
+/**
+ * Fragmentation state for a node
+ */
+typedef struct _DPS_Fragments {
+    uv_timer_t timer;              /**< Timer for expiring reassemblies and sending retransmission requests */
+    DPS_Reassembly* reassemblies;  /**< Publications being reassembled */
+    size_t reassemblyBytes;        /**< Total size of the publications being reassembled */
+    DPS_FragmentedMsg* sent;       /**< Publications recently sent as fragments */
+    size_t sentBytes;              /**< Total size of the recently sent publications */
+    uint8_t retransmit;            /**< TRUE to request retransmission of missing fragments */
+} DPS_Fragments;
+
+/**
+ * Check if a publication message must be fragmented. Only publications
+ * sent over UDP or multicast are fragmented.
+ *
+ * @param ep       The destination endpoint, NULL for multicast
+ * @param bufs     The serialized publication
+ * @param numBufs  The number of buffers
+ *
+ * @return TRUE if the publication must be fragmented
+ */
+int DPS_NeedsFragmenting(const DPS_NetEndpoint* ep, const uv_buf_t* bufs, size_t numBufs);
+
+/**
+ * Send a publication message as fragments. The buffers are copied so
+ * can be freed when this function returns.
+ *
+ * @param node         The node
+ * @param ep           The destination endpoint, NULL to multicast the fragments
+ * @param pubId        The publication ID
+ * @param sequenceNum  The publication sequence number
+ * @param bufs         The serialized publication
+ * @param numBufs      The number of buffers
+ *
+ * @return DPS_OK if the fragments were sent
+ */
+DPS_Status DPS_SendFragments(DPS_Node* node, DPS_NetEndpoint* ep, const DPS_UUID* pubId, uint32_t sequenceNum,
+                             const uv_buf_t* bufs, size_t numBufs);
+
+/**
+ * Decode a fragment and add it to the reassembly of its publication
+ *
+ * @param node    The node
+ * @param ep      The endpoint the fragment was received on
+ * @param buf     The fragment message, positioned after the message type
+ * @param msgBuf  Returns the reassembled publication message when the
+ *                last fragment is received, NULL otherwise. The caller
+ *                must release the buffer with DPS_NetRxBufferDecRef().
+ *
+ * @return DPS_OK if the fragment was decoded
+ */
+DPS_Status DPS_DecodeFragment(DPS_Node* node, DPS_NetEndpoint* ep, DPS_NetRxBuffer* buf, DPS_NetRxBuffer** msgBuf);
+
+/**
+ * Decode a request for missing fragments and resend them
+ *
+ * @param node    The node
+ * @param ep      The endpoint the request was received on
+ * @param buf     The request message, positioned after the message type
+ *
+ * @return DPS_OK if the request was decoded
+ */
+DPS_Status DPS_DecodeFragmentNak(DPS_Node* node, DPS_NetEndpoint* ep, DPS_NetRxBuffer* buf);
+
+/**
+ * Free resources allocated for fragmentation
+ *
+ * @param fragments  The fragmentation state
+ */
+void DPS_FragmentsFree(DPS_Fragments* fragments);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
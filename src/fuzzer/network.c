@@ -31,7 +31,7 @@
  */
 DPS_DEBUG_CONTROL(DPS_DEBUG_ON);
 
-struct _DPS_NetContext {
+struct _DPS_NetTransportContext {
     DPS_Node* node;
     DPS_OnReceive receiveCB;
 };
@@ -45,11 +45,11 @@ struct _DPS_MulticastSender {
     DPS_Node* node;
 };
 
-DPS_NetContext* DPS_NetStart(DPS_Node* node, const DPS_NodeAddress* addr, DPS_OnReceive cb)
+static DPS_NetTransportContext* NetStart(DPS_Node* node, const DPS_NodeAddress* addr, DPS_OnReceive cb)
 {
-    DPS_NetContext* netCtx = NULL;
+    DPS_NetTransportContext* netCtx = NULL;
 
-    netCtx = malloc(sizeof(DPS_NetContext));
+    netCtx = malloc(sizeof(DPS_NetTransportContext));
     if (netCtx) {
         netCtx->node = node;
         netCtx->receiveCB = cb;
@@ -57,12 +57,12 @@ DPS_NetContext* DPS_NetStart(DPS_Node* node, const DPS_NodeAddress* addr, DPS_On
     return netCtx;
 }
 
-void DPS_NetStop(DPS_NetContext* netCtx)
+static void NetStop(DPS_NetTransportContext* netCtx)
 {
     free(netCtx);
 }
 
-DPS_NodeAddress* DPS_NetGetListenAddress(DPS_NodeAddress* addr, DPS_NetContext* netCtx)
+static DPS_NodeAddress* NetGetListenAddress(DPS_NodeAddress* addr, DPS_NetTransportContext* netCtx)
 {
     struct sockaddr_in6* saddr;
 
@@ -75,21 +75,33 @@ DPS_NodeAddress* DPS_NetGetListenAddress(DPS_NodeAddress* addr, DPS_NetContext*
     return addr;
 }
 
-DPS_Status DPS_NetSend(DPS_Node* node, void* appCtx, DPS_NetEndpoint* endpoint,
-                       uv_buf_t* bufs, size_t numBufs,
-                       DPS_NetSendComplete sendCompleteCB)
+static DPS_Status NetSend(DPS_NetTransportContext* netCtx, void* appCtx, DPS_NetEndpoint* endpoint,
+                          uv_buf_t* bufs, size_t numBufs,
+                          DPS_NetSendComplete sendCompleteCB)
 {
     return DPS_ERR_NOT_IMPLEMENTED;
 }
 
-void DPS_NetConnectionIncRef(DPS_NetConnection* cn)
+static void ConnectionIncRef(DPS_NetConnection* cn)
 {
 }
 
-void DPS_NetConnectionDecRef(DPS_NetConnection* cn)
+static void ConnectionDecRef(DPS_NetConnection* cn)
 {
 }
 
+const DPS_NetTransport DPS_FuzzerTransport = {
+    "fuzzer",
+    DPS_UDP,
+    NetStart,
+    NetGetListenAddress,
+    NetStop,
+    NetSend,
+    ConnectionIncRef,
+    ConnectionDecRef,
+    NULL
+};
+
 DPS_MulticastReceiver* DPS_MulticastStartReceive(DPS_Node* node, DPS_OnReceive cb)
 {
     DPS_MulticastReceiver* receiver = NULL;
@@ -130,6 +142,7 @@ DPS_Status DPS_MulticastSend(DPS_MulticastSender* sender, void* appCtx, uv_buf_t
 
 void Fuzz_OnNetReceive(DPS_Node* node, const uint8_t* data, size_t len)
 {
+    DPS_NetTransportContext* netCtx;
     DPS_NetEndpoint ep;
     struct sockaddr_in sa;
     DPS_NetRxBuffer* buf;
@@ -144,7 +157,8 @@ void Fuzz_OnNetReceive(DPS_Node* node, const uint8_t* data, size_t len)
         return;
     }
     memcpy(buf->rx.rxPos, data, len);
-    node->netCtx->receiveCB(node, &ep, DPS_OK, buf);
+    netCtx = DPS_NetGetTransportContext(node->netCtx, &DPS_FuzzerTransport);
+    netCtx->receiveCB(node, &ep, DPS_OK, buf);
     DPS_NetRxBufferDecRef(buf);
 }
 
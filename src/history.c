@@ -309,8 +309,16 @@ DPS_Status DPS_UpdatePubHistory(DPS_History* history, DPS_UUID* pubId, uint32_t
          */
         FreePubHistory(phNew);
         UnlinkPub(history, ph);
+        /*
+         * A retransmission of a reliable publication is older than the
+         * latest publication
+         */
+        if (sequenceNum > ph->sn) {
+            ph->sn = sequenceNum;
+        }
+    } else {
+        ph->sn = sequenceNum;
     }
-    ph->sn = sequenceNum;
     ph->ackRequested = ackRequested;
     /*
      * The address is not set in publications being sent from the local node
@@ -393,6 +401,32 @@ DPS_Status DPS_LookupPublisherForAck(DPS_History* history, const DPS_UUID* pubId
     return ret;
 }
 
+size_t DPS_LookupAckRoutes(DPS_History* history, DPS_NodeAddress* addrs, size_t maxAddrs)
+{
+    DPS_PubHistory* ph;
+    size_t numAddrs = 0;
+    size_t i;
+
+    DPS_DBGTRACE();
+
+    uv_mutex_lock(&history->lock);
+    for (ph = history->latest; ph && (numAddrs < maxAddrs); ph = ph->prev) {
+        if (!ph->ackRequested || !ph->addrs) {
+            continue;
+        }
+        for (i = 0; i < numAddrs; ++i) {
+            if (DPS_SameAddr(&addrs[i], &ph->addrs->addr)) {
+                break;
+            }
+        }
+        if (i == numAddrs) {
+            addrs[numAddrs++] = ph->addrs->addr;
+        }
+    }
+    uv_mutex_unlock(&history->lock);
+    return numAddrs;
+}
+
 int DPS_PublicationReceivedFrom(DPS_History* history, DPS_UUID* pubId, uint32_t sequenceNum, DPS_NodeAddress* source, DPS_NodeAddress* destination)
 {
     DPS_PubHistory* ph;
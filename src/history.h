@@ -143,6 +143,19 @@ DPS_Status DPS_DeletePubHistory(DPS_History* history, DPS_UUID* pubId);
  */
 DPS_Status DPS_LookupPublisherForAck(DPS_History* history, const DPS_UUID* pubId, uint32_t* sequenceNum, DPS_NodeAddress** addr);
 
+/**
+ * Get the addresses acknowledgements will be sent to. These are the
+ * senders of publications in the history record that requested an
+ * acknowledgement, most recently received first.
+ *
+ * @param history       The history from a local node
+ * @param addrs         Returns the addresses, each address is only returned once
+ * @param maxAddrs      The maximum number of addresses to return
+ *
+ * @return The number of addresses returned
+ */
+size_t DPS_LookupAckRoutes(DPS_History* history, DPS_NodeAddress* addrs, size_t maxAddrs);
+
 /**
  * Determine if a publication has been received from the destination already.
  *
@@ -25,7 +25,6 @@
  *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
  */
 
-#include <ctype.h>
 #include <safe_lib.h>
 #include <string.h>
 #include <stdlib.h>
@@ -41,66 +40,91 @@ DPS_DEBUG_CONTROL(DPS_DEBUG_OFF);
 #define MAX_INPUT_STRING_LEN  (RSIZE_MAX_STR - 1)
 #define JSON_MAX_STRING_LEN   CBOR_MAX_STRING_LEN
 
+/*
+ * Structural scanning is done 16 characters at a time where SSE2 is
+ * available with a scalar loop for the remainder and on other targets
+ */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define JSON_SCAN_SSE2
+#if defined(__GNUC__)
+#define COUNT_TZ(n)    __builtin_ctz(n)
+#else
+#include <intrin.h>
+static inline uint32_t COUNT_TZ(uint32_t n)
+{
+    unsigned long index;
+    _BitScanForward(&index, n);
+    return index;
+}
+#endif
+#endif
+
+#define IS_WS(c)          (((c) == ' ') || ((c) == '\t') || ((c) == '\n') || ((c) == '\r'))
+#define IS_STRING_END(c)  (((c) == '"') || ((c) == '\r') || ((c) == '\n') || ((c) == '\0'))
+
 typedef struct {
     char* str;
     size_t len;
 } JSONBuffer;
 
-static DPS_Status CountItems(JSONBuffer* json, size_t* count)
+/*
+ * Returns the number of whitespace characters at the start of str
+ */
+static size_t SpanWS(const char* str, size_t len)
 {
-    int empty = 1;
-    size_t i;
-    int numBrackets = 0;
-    int numBraces = 0;
+    size_t i = 0;
+#ifdef JSON_SCAN_SSE2
+    const __m128i sp = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i nl = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
 
-    if (json->str[0] == '[') {
-        ++numBrackets;
-    } else {
-        ++numBraces;
+    while ((i + 16) <= len) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(str + i));
+        __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, tab)),
+                                  _mm_or_si128(_mm_cmpeq_epi8(v, nl), _mm_cmpeq_epi8(v, cr)));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(ws) ^ 0xFFFF;
+        if (mask) {
+            return i + COUNT_TZ(mask);
+        }
+        i += 16;
+    }
+#endif
+    while ((i < len) && IS_WS(str[i])) {
+        ++i;
     }
-    *count = 0;
+    return i;
+}
 
-    for (i = 1; i < json->len; ++i) {
-        switch (json->str[i]) {
-        case '[':
-            ++numBrackets;
-            break;
-        case ']':
-            --numBrackets;
-            break;
-        case '{':
-            ++numBraces;
-            break;
-        case '}':
-            --numBraces;
-            break;
-        case ',':
-            if ((numBrackets == 1 && numBraces == 0) || (numBraces == 1 && numBrackets == 0)) {
-                *count += 1;
-            }
-            break;
-        default:
-            if (!isspace(json->str[i])) {
-                empty = 0;
-            }
-            break;
-        }
-        if (numBrackets == 0 && numBraces == 0) {
-            // handles case of [] or {}
-            if (!empty) {
-                *count += 1;
-            }
-            break;
+/*
+ * Returns the number of characters at the start of str up to the
+ * closing quote or a character that cannot appear in a JSON string
+ */
+static size_t SpanString(const char* str, size_t len)
+{
+    size_t i = 0;
+#ifdef JSON_SCAN_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i nl = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i nul = _mm_setzero_si128();
+
+    while ((i + 16) <= len) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(str + i));
+        __m128i stop = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, nul)),
+                                    _mm_or_si128(_mm_cmpeq_epi8(v, nl), _mm_cmpeq_epi8(v, cr)));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(stop);
+        if (mask) {
+            return i + COUNT_TZ(mask);
         }
+        i += 16;
     }
-    if (numBrackets != 0 || numBraces != 0) {
-        // This indicates where the failure was encountered
-        json->str += (i - 1);
-        json->len -= (i - 1);
-        return DPS_ERR_INVALID;
-    } else {
-        return DPS_ERR_OK;
+#endif
+    while ((i < len) && !IS_STRING_END(str[i])) {
+        ++i;
     }
+    return i;
 }
 
 static DPS_Status ToCBORNumber(DPS_TxBuffer* cbor, JSONBuffer* json)
@@ -111,7 +135,7 @@ static DPS_Status ToCBORNumber(DPS_TxBuffer* cbor, JSONBuffer* json)
         DPS_ERRPRINT("Invalid number\n");
         return DPS_ERR_INVALID;
     }
-    if (*endPtr == '.') {
+    if (*endPtr == '.' || *endPtr == 'e' || *endPtr == 'E') {
         double d = strtod(json->str, &endPtr);
         if (endPtr == json->str) {
             DPS_ERRPRINT("Invalid number\n");
@@ -156,10 +180,9 @@ static int TestStr(JSONBuffer* json, const char* str)
 
 static inline void SkipWS(JSONBuffer* json)
 {
-    while (json->len && isspace(json->str[0])) {
-        ++json->str;
-        --json->len;
-    }
+    size_t n = SpanWS(json->str, json->len);
+    json->str += n;
+    json->len -= n;
 }
 
 static DPS_Status ExpectChar(JSONBuffer* json, char c)
@@ -177,6 +200,60 @@ static DPS_Status ExpectChar(JSONBuffer* json, char c)
     return DPS_OK;
 }
 
+/*
+ * Consumes the separator after an array element or map entry, more
+ * is set if another element or entry follows
+ */
+static DPS_Status NextItem(JSONBuffer* json, char close, int* more)
+{
+    SkipWS(json);
+    if (json->len == 0) {
+        return DPS_ERR_EOD;
+    }
+    if (json->str[0] == ',') {
+        *more = DPS_TRUE;
+    } else if (json->str[0] == close) {
+        *more = DPS_FALSE;
+    } else {
+        DPS_ERRPRINT("Expected ',' or '%c' character\n", close);
+        return DPS_ERR_INVALID;
+    }
+    ++json->str;
+    --json->len;
+    return DPS_OK;
+}
+
+/*
+ * The number of items in an array or map is not known until the end
+ * of the container is reached so a single byte is reserved for the
+ * header. If the count needs a longer header the encoded items are
+ * moved along to make room.
+ */
+static DPS_Status ReserveHeader(DPS_TxBuffer* cbor, uint8_t** hdr)
+{
+    if (DPS_TxBufferSpace(cbor) < 1) {
+        return DPS_ERR_OVERFLOW;
+    }
+    *hdr = cbor->txPos++;
+    return DPS_OK;
+}
+
+static DPS_Status PatchHeader(DPS_TxBuffer* cbor, uint8_t* hdr, size_t count, uint8_t maj)
+{
+    DPS_TxBuffer buf;
+    size_t extra = CBOR_SIZEOF_LEN(count) - 1;
+
+    if (extra) {
+        if (DPS_TxBufferSpace(cbor) < extra) {
+            return DPS_ERR_OVERFLOW;
+        }
+        memmove(hdr + 1 + extra, hdr + 1, cbor->txPos - (hdr + 1));
+        cbor->txPos += extra;
+    }
+    DPS_TxBufferInit(&buf, hdr, 1 + extra);
+    return CBOR_EncodeLength(&buf, count, maj);
+}
+
 static inline int CharToHex(uint8_t c)
 {
     if (c <= '9') {
@@ -186,6 +263,24 @@ static inline int CharToHex(uint8_t c)
     }
 }
 
+/*
+ * Converts pairs of hexadecimal characters to bytes
+ */
+static DPS_Status HexToBytes(uint8_t* bytes, const char* hex, size_t len)
+{
+    while (len--) {
+        int a = CharToHex(hex[0]);
+        int b = CharToHex(hex[1]);
+        if (a > 15 || b > 15) {
+            DPS_ERRPRINT("Expected hexadecimal character\n");
+            return DPS_ERR_INVALID;
+        }
+        *bytes++ = (a << 4) | b;
+        hex += 2;
+    }
+    return DPS_OK;
+}
+
 static DPS_Status ToCBORBytes(DPS_TxBuffer* cbor, JSONBuffer* json)
 {
     DPS_Status status = ExpectChar(json, ':');
@@ -194,38 +289,21 @@ static DPS_Status ToCBORBytes(DPS_TxBuffer* cbor, JSONBuffer* json)
     }
     if (status == DPS_OK) {
         uint8_t* ptr;
-        size_t len;
-        for (len = 0; len < json->len; ++len) {
-            if (json->str[len] == '"') {
-                break;
-            }
-        }
-        if (json->str[len] != '"') {
+        size_t len = SpanString(json->str, json->len);
+        if ((len == json->len) || (json->str[len] != '"')) {
             return DPS_ERR_INVALID;
         }
         if (len & 1) {
             DPS_ERRPRINT("Expected even number of hex characters\n");
             return DPS_ERR_INVALID;
         }
-        len /= 2;
-        status = CBOR_ReserveBytes(cbor, len, &ptr);
+        status = CBOR_ReserveBytes(cbor, len / 2, &ptr);
         if (status == DPS_OK) {
-            while (len--) {
-                int a = CharToHex(json->str[0]);
-                int b = CharToHex(json->str[1]);
-                if (a > 15 || b > 15) {
-                    DPS_ERRPRINT("Expected hexadecimal character\n");
-                    status = DPS_ERR_INVALID;
-                    break;
-                }
-                *ptr++ = (a << 4) | b;
-                json->str += 2;
-                json->len -= 2;
-            }
+            status = HexToBytes(ptr, json->str, len / 2);
         }
-        // Skip closing quote
-        ++json->str;
-        --json->len;
+        // Skip hex characters and closing quote
+        json->str += len + 1;
+        json->len -= len + 1;
     }
     if (status == DPS_OK) {
         status = ExpectChar(json, '}');
@@ -236,7 +314,9 @@ static DPS_Status ToCBORBytes(DPS_TxBuffer* cbor, JSONBuffer* json)
 static DPS_Status ToCBOR(DPS_TxBuffer* cbor, JSONBuffer* json)
 {
     DPS_Status status;
+    uint8_t* hdr = NULL;
     size_t len;
+    int more;
 
     SkipWS(json);
     if (json->len == 0) {
@@ -248,18 +328,11 @@ static DPS_Status ToCBOR(DPS_TxBuffer* cbor, JSONBuffer* json)
         status = DPS_ERR_EOD;
         break;
     case '"':
-        len = 0;
         --json->len;
         ++json->str;
-        while (json->len--) {
-            char c = json->str[len];
-            // newline chars are not allowed in JSON strings
-            if (c == '"' || c == '\r' || c == '\n' || c == '\0') {
-                break;
-            }
-            ++len;
-        }
-        if (json->str[len] != '"') {
+        // newline chars are not allowed in JSON strings
+        len = SpanString(json->str, json->len);
+        if ((len == json->len) || (json->str[len] != '"')) {
             status = DPS_ERR_INVALID;
         } else {
             // Encode string
@@ -268,44 +341,56 @@ static DPS_Status ToCBOR(DPS_TxBuffer* cbor, JSONBuffer* json)
                 status = CBOR_Copy(cbor, (uint8_t*)json->str, len);
             }
             json->str += len + 1;
+            json->len -= len + 1;
         }
         break;
     case '[':
-        status = CountItems(json, &len);
+        ++json->str;
+        --json->len;
+        len = 0;
+        status = ReserveHeader(cbor, &hdr);
         if (status == DPS_OK) {
-            ++json->str;
-            --json->len;
-            status = CBOR_EncodeArray(cbor, len);
+            SkipWS(json);
+            if (json->len && (json->str[0] == ']')) {
+                ++json->str;
+                --json->len;
+                more = DPS_FALSE;
+            } else {
+                more = DPS_TRUE;
+            }
         }
-        while (status == DPS_OK && len--) {
+        while (status == DPS_OK && more) {
             status = ToCBOR(cbor, json);
-            if (len && (status == DPS_OK)) {
-                status = ExpectChar(json, ',');
+            if (status == DPS_OK) {
+                ++len;
+                status = NextItem(json, ']', &more);
             }
         }
         if (status == DPS_OK) {
-            status = ExpectChar(json, ']');
+            status = PatchHeader(cbor, hdr, len, CBOR_ARRAY);
         }
         break;
     case '{':
-        status = CountItems(json, &len);
-        if (status != DPS_OK) {
-            break;
-        }
         ++json->str;
         --json->len;
         SkipWS(json);
         // Special case encodings
         if (TestStr(json, "\"$binary\"")) {
-            if (len == 1) {
-                status = ToCBORBytes(cbor, json);
+            status = ToCBORBytes(cbor, json);
+            break;
+        }
+        len = 0;
+        status = ReserveHeader(cbor, &hdr);
+        if (status == DPS_OK) {
+            if (json->len && (json->str[0] == '}')) {
+                ++json->str;
+                --json->len;
+                more = DPS_FALSE;
             } else {
-                status = DPS_ERR_INVALID;
+                more = DPS_TRUE;
             }
-            break;
         }
-        status = CBOR_EncodeMap(cbor, len);
-        while (status == DPS_OK && len--) {
+        while (status == DPS_OK && more) {
             // JSON requires map keys to be quoted strings
             status = ExpectChar(json, '"');
             if (status != DPS_OK) {
@@ -320,13 +405,14 @@ static DPS_Status ToCBOR(DPS_TxBuffer* cbor, JSONBuffer* json)
             }
             if (status == DPS_OK) {
                 status = ToCBOR(cbor, json);
-                if (len && (status == DPS_OK)) {
-                    status = ExpectChar(json, ',');
-                }
+            }
+            if (status == DPS_OK) {
+                ++len;
+                status = NextItem(json, '}', &more);
             }
         }
         if (status == DPS_OK) {
-            status = ExpectChar(json, '}');
+            status = PatchHeader(cbor, hdr, len, CBOR_MAP);
         }
         break;
     case 't':
@@ -454,6 +540,45 @@ static inline DPS_Status JSONAppendStr(JSONBuffer* json, const char* str)
     }
 }
 
+/*
+ * Decodes the header of a definite or indefinite length array or map
+ */
+static DPS_Status DecodeContainer(DPS_RxBuffer* cbor, uint8_t maj, size_t* len, int* indefinite)
+{
+    if (cbor->rxPos[0] == (maj | CBOR_INDEFINITE)) {
+        ++cbor->rxPos;
+        *len = 0;
+        *indefinite = DPS_TRUE;
+        return DPS_OK;
+    }
+    *indefinite = DPS_FALSE;
+    if (maj == CBOR_ARRAY) {
+        return CBOR_DecodeArray(cbor, len);
+    } else {
+        return CBOR_DecodeMap(cbor, len);
+    }
+}
+
+/*
+ * Indefinite length containers end with a break, definite length
+ * containers after the number of items in the header
+ */
+static int EndOfContainer(DPS_RxBuffer* cbor, int indefinite, size_t* len)
+{
+    if (indefinite) {
+        if ((DPS_RxBufferAvail(cbor) > 0) && (cbor->rxPos[0] == CBOR_BREAK)) {
+            ++cbor->rxPos;
+            return DPS_TRUE;
+        }
+        return DPS_FALSE;
+    }
+    if (*len == 0) {
+        return DPS_TRUE;
+    }
+    --(*len);
+    return DPS_FALSE;
+}
+
 static DPS_Status ToJSON(JSONBuffer* json, DPS_RxBuffer* cbor, int pretty, int indent)
 {
     char numStr[64];
@@ -465,6 +590,8 @@ static DPS_Status ToJSON(JSONBuffer* json, DPS_RxBuffer* cbor, int pretty, int i
     uint8_t maj;
     int64_t i64;
     uint64_t u64;
+    int indefinite;
+    size_t i;
 
     if (DPS_RxBufferAvail(cbor) < 1) {
         return DPS_ERR_EOD;
@@ -548,22 +675,22 @@ static DPS_Status ToJSON(JSONBuffer* json, DPS_RxBuffer* cbor, int pretty, int i
         }
         break;
     case CBOR_ARRAY:
-        status = CBOR_DecodeArray(cbor, &len);
+        status = DecodeContainer(cbor, CBOR_ARRAY, &len, &indefinite);
         if (status == DPS_OK) {
             status = JSONAppendChar(json, '[');
         }
         if (status == DPS_OK) {
-            while (len--) {
-                status = ToJSON(json, cbor, pretty, indent + 1);
-                if (status != DPS_OK) {
-                    break;
-                }
-                if (len) {
+            for (i = 0; !EndOfContainer(cbor, indefinite, &len); ++i) {
+                if (i) {
                     status = JSONAppendChar(json, ',');
                     if (status != DPS_OK) {
                         break;
                     }
                 }
+                status = ToJSON(json, cbor, pretty, indent + 1);
+                if (status != DPS_OK) {
+                    break;
+                }
             }
             if (status == DPS_OK) {
                 status = Indent(json, pretty, indent);
@@ -574,12 +701,18 @@ static DPS_Status ToJSON(JSONBuffer* json, DPS_RxBuffer* cbor, int pretty, int i
         }
         break;
     case CBOR_MAP:
-        status = CBOR_DecodeMap(cbor, &len);
+        status = DecodeContainer(cbor, CBOR_MAP, &len, &indefinite);
         if (status == DPS_OK) {
             status = JSONAppendChar(json, '{');
         }
         if (status == DPS_OK) {
-            while (len--) {
+            for (i = 0; !EndOfContainer(cbor, indefinite, &len); ++i) {
+                if (i) {
+                    status = JSONAppendChar(json, ',');
+                    if (status != DPS_OK) {
+                        break;
+                    }
+                }
                 status = ToJSON(json, cbor, pretty, indent + 1);
                 if (status == DPS_OK) {
                     status = JSONAppendChar(json, ':');
@@ -591,12 +724,6 @@ static DPS_Status ToJSON(JSONBuffer* json, DPS_RxBuffer* cbor, int pretty, int i
                 if (status != DPS_OK) {
                     break;
                 }
-                if (len) {
-                    status = JSONAppendChar(json, ',');
-                    if (status != DPS_OK) {
-                        break;
-                    }
-                }
             }
             if (status == DPS_OK) {
                 status = Indent(json, pretty, indent);
@@ -677,3 +804,977 @@ DPS_Status DPS_CBOR2JSON(const uint8_t* cbor, size_t cborLen, char* json, size_t
     }
     return status;
 }
+
+/*
+ * Maximum nesting of arrays and maps in the streaming converters
+ */
+#define JSON_STREAM_MAX_DEPTH  64
+
+/*
+ * Initial size of the token and output buffers of the JSON to CBOR
+ * converter, these grow as needed
+ */
+#define JSON_STREAM_BUF_SIZE   256
+
+/*
+ * JSON to CBOR converter states
+ */
+#define J_VALUE         0  /* Expecting a value */
+#define J_ARRAY_FIRST   1  /* Expecting the first value of an array or ']' */
+#define J_MAP_FIRST     2  /* Expecting the first key of a map or '}' */
+#define J_MAP_KEY       3  /* Expecting a key */
+#define J_COLON         4  /* Expecting ':' after a key */
+#define J_NEXT          5  /* Expecting ',' or the end of an array or map */
+#define J_TOKEN         6  /* Accumulating a string, number, or literal */
+#define J_BINARY_COLON  7  /* Expecting ':' after "$binary" */
+#define J_BINARY_VALUE  8  /* Expecting the hexadecimal string of a "$binary" */
+#define J_BINARY_END    9  /* Expecting '}' after a "$binary" */
+#define J_DONE         10  /* The top level value is complete */
+
+/*
+ * Token types
+ */
+#define TOK_KEY_FIRST  0  /* First key of a map, may be "$binary" */
+#define TOK_KEY        1
+#define TOK_STRING     2
+#define TOK_BINARY     3
+#define TOK_NUMBER     4
+#define TOK_LITERAL    5
+
+struct _DPS_JSON2CBORStream {
+    int state;
+    int token;
+    char* tok;           /* Token accumulated across input chunks */
+    size_t tokLen;
+    size_t tokSize;
+    uint8_t* out;        /* CBOR not yet returned to the caller */
+    size_t outLen;
+    size_t outPos;
+    size_t outSize;
+    char levels[JSON_STREAM_MAX_DEPTH]; /* '[', '{', or '$' for a "$binary" map */
+    size_t depth;
+    DPS_Status status;   /* Errors are sticky */
+};
+
+DPS_JSON2CBORStream* DPS_CreateJSON2CBORStream(void)
+{
+    DPS_JSON2CBORStream* stream = calloc(1, sizeof(DPS_JSON2CBORStream));
+    if (stream) {
+        stream->state = J_VALUE;
+    }
+    return stream;
+}
+
+void DPS_DestroyJSON2CBORStream(DPS_JSON2CBORStream* stream)
+{
+    if (stream) {
+        free(stream->tok);
+        free(stream->out);
+        free(stream);
+    }
+}
+
+static DPS_Status Grow(void** buf, size_t* size, size_t needed)
+{
+    size_t sz = *size ? *size : JSON_STREAM_BUF_SIZE;
+    void* p;
+
+    while (sz < needed) {
+        sz *= 2;
+    }
+    p = realloc(*buf, sz);
+    if (!p) {
+        return DPS_ERR_RESOURCES;
+    }
+    *buf = p;
+    *size = sz;
+    return DPS_OK;
+}
+
+static DPS_Status ReserveOut(DPS_JSON2CBORStream* stream, size_t len, uint8_t** ptr)
+{
+    if ((stream->outLen + len) > stream->outSize) {
+        DPS_Status ret = Grow((void**)&stream->out, &stream->outSize, stream->outLen + len);
+        if (ret != DPS_OK) {
+            return ret;
+        }
+    }
+    *ptr = stream->out + stream->outLen;
+    stream->outLen += len;
+    return DPS_OK;
+}
+
+static DPS_Status Emit(DPS_JSON2CBORStream* stream, const void* data, size_t len)
+{
+    uint8_t* ptr;
+    DPS_Status ret = ReserveOut(stream, len, &ptr);
+    if ((ret == DPS_OK) && len) {
+        memcpy_s(ptr, len, data, len);
+    }
+    return ret;
+}
+
+static DPS_Status EmitByte(DPS_JSON2CBORStream* stream, uint8_t b)
+{
+    return Emit(stream, &b, 1);
+}
+
+static DPS_Status EmitLength(DPS_JSON2CBORStream* stream, uint64_t len, uint8_t maj)
+{
+    uint8_t hdr[CBOR_MAX_LENGTH];
+    DPS_TxBuffer buf;
+    DPS_Status ret;
+
+    DPS_TxBufferInit(&buf, hdr, sizeof(hdr));
+    ret = CBOR_EncodeLength(&buf, len, maj);
+    if (ret == DPS_OK) {
+        ret = Emit(stream, hdr, DPS_TxBufferUsed(&buf));
+    }
+    return ret;
+}
+
+static DPS_Status EmitNumber(DPS_JSON2CBORStream* stream)
+{
+    uint8_t num[CBOR_MAX_LENGTH];
+    DPS_TxBuffer buf;
+    const char* str = stream->tok;
+    char* endPtr = NULL;
+    DPS_Status ret;
+
+    DPS_TxBufferInit(&buf, num, sizeof(num));
+    if (strpbrk(str, ".eE")) {
+        double d = strtod(str, &endPtr);
+        ret = CBOR_EncodeDouble(&buf, d);
+    } else {
+        int64_t i64 = strtoll(str, &endPtr, 10);
+        ret = CBOR_EncodeInt(&buf, i64);
+    }
+    if ((stream->tokLen == 0) || (endPtr != (str + stream->tokLen))) {
+        DPS_ERRPRINT("Invalid number \"%s\"\n", str);
+        return DPS_ERR_INVALID;
+    }
+    if (ret == DPS_OK) {
+        ret = Emit(stream, num, DPS_TxBufferUsed(&buf));
+    }
+    return ret;
+}
+
+static DPS_Status EmitLiteral(DPS_JSON2CBORStream* stream)
+{
+    const char* str = stream->tok;
+
+    if (strcmp(str, "true") == 0) {
+        return EmitByte(stream, CBOR_TRUE);
+    }
+    if (strcmp(str, "false") == 0) {
+        return EmitByte(stream, CBOR_FALSE);
+    }
+    if (strcmp(str, "null") == 0) {
+        return EmitByte(stream, CBOR_NULL);
+    }
+    DPS_ERRPRINT("Invalid literal \"%s\"\n", str);
+    return DPS_ERR_INVALID;
+}
+
+static DPS_Status EmitBinary(DPS_JSON2CBORStream* stream, const char* hex, size_t len)
+{
+    uint8_t* ptr;
+    DPS_Status ret;
+
+    if (len & 1) {
+        DPS_ERRPRINT("Expected even number of hex characters\n");
+        return DPS_ERR_INVALID;
+    }
+    len /= 2;
+    ret = EmitLength(stream, len, CBOR_BYTES);
+    if (ret == DPS_OK) {
+        ret = ReserveOut(stream, len, &ptr);
+    }
+    if (ret == DPS_OK) {
+        ret = HexToBytes(ptr, hex, len);
+    }
+    return ret;
+}
+
+static DPS_Status AppendToken(DPS_JSON2CBORStream* stream, const char* str, size_t len)
+{
+    /*
+     * Tokens are kept NUL terminated for the number conversions
+     */
+    if ((stream->tokLen + len + 1) > stream->tokSize) {
+        DPS_Status ret = Grow((void**)&stream->tok, &stream->tokSize, stream->tokLen + len + 1);
+        if (ret != DPS_OK) {
+            return ret;
+        }
+    }
+    if (len) {
+        memcpy_s(stream->tok + stream->tokLen, stream->tokSize - stream->tokLen, str, len);
+        stream->tokLen += len;
+    }
+    stream->tok[stream->tokLen] = '\0';
+    return DPS_OK;
+}
+
+static DPS_Status BeginToken(DPS_JSON2CBORStream* stream, int token)
+{
+    stream->state = J_TOKEN;
+    stream->token = token;
+    stream->tokLen = 0;
+    return AppendToken(stream, NULL, 0);
+}
+
+static void ValueDone(DPS_JSON2CBORStream* stream)
+{
+    stream->state = stream->depth ? J_NEXT : J_DONE;
+}
+
+static DPS_Status Push(DPS_JSON2CBORStream* stream, char level, int state)
+{
+    if (stream->depth == JSON_STREAM_MAX_DEPTH) {
+        DPS_ERRPRINT("JSON nested too deeply\n");
+        return DPS_ERR_INVALID;
+    }
+    stream->levels[stream->depth++] = level;
+    stream->state = state;
+    return DPS_OK;
+}
+
+static DPS_Status EmitString(DPS_JSON2CBORStream* stream, const char* str, size_t len)
+{
+    DPS_Status ret = EmitLength(stream, len, CBOR_STRING);
+    if (ret == DPS_OK) {
+        ret = Emit(stream, str, len);
+    }
+    return ret;
+}
+
+/*
+ * The token is either the accumulated token or, if it was entirely
+ * contained in the input chunk, a span of the input
+ */
+static DPS_Status EndToken(DPS_JSON2CBORStream* stream, const char* str, size_t len)
+{
+    DPS_Status ret = DPS_OK;
+
+    switch (stream->token) {
+    case TOK_KEY_FIRST:
+        if ((len == 7) && (memcmp(str, "$binary", 7) == 0)) {
+            stream->levels[stream->depth - 1] = '$';
+            stream->state = J_BINARY_COLON;
+            break;
+        }
+        /*
+         * The map header is deferred until the first key is known
+         */
+        ret = EmitByte(stream, CBOR_MAP | CBOR_INDEFINITE);
+        if (ret != DPS_OK) {
+            break;
+        }
+        /* FALLTHROUGH */
+    case TOK_KEY:
+        ret = EmitString(stream, str, len);
+        stream->state = J_COLON;
+        break;
+    case TOK_STRING:
+        ret = EmitString(stream, str, len);
+        ValueDone(stream);
+        break;
+    case TOK_BINARY:
+        ret = EmitBinary(stream, str, len);
+        stream->state = J_BINARY_END;
+        break;
+    case TOK_NUMBER:
+        ret = EmitNumber(stream);
+        ValueDone(stream);
+        break;
+    case TOK_LITERAL:
+        ret = EmitLiteral(stream);
+        ValueDone(stream);
+        break;
+    default:
+        ret = DPS_ERR_INVALID;
+        break;
+    }
+    return ret;
+}
+
+static int IsTokenChar(int token, char c)
+{
+    if (token == TOK_NUMBER) {
+        return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+    } else {
+        return (c >= 'a' && c <= 'z');
+    }
+}
+
+static DPS_Status ScanToken(DPS_JSON2CBORStream* stream, const char** pos, const char* end)
+{
+    const char* p = *pos;
+    size_t n;
+    DPS_Status ret;
+
+    if (stream->token < TOK_NUMBER) {
+        n = SpanString(p, end - p);
+        if ((stream->tokLen == 0) && ((p + n) < end) && (p[n] == '"')) {
+            *pos = p + n + 1;
+            return EndToken(stream, p, n);
+        }
+    } else {
+        for (n = 0; ((p + n) < end) && IsTokenChar(stream->token, p[n]); ++n) {
+        }
+    }
+    ret = AppendToken(stream, p, n);
+    p += n;
+    if ((ret == DPS_OK) && (p < end)) {
+        if (stream->token < TOK_NUMBER) {
+            if (*p != '"') {
+                DPS_ERRPRINT("Unterminated string\n");
+                ret = DPS_ERR_INVALID;
+            } else {
+                ++p;
+            }
+        }
+        if (ret == DPS_OK) {
+            ret = EndToken(stream, stream->tok, stream->tokLen);
+        }
+    }
+    *pos = p;
+    return ret;
+}
+
+static DPS_Status BeginValue(DPS_JSON2CBORStream* stream, char c, const char** pos)
+{
+    switch (c) {
+    case '"':
+        return BeginToken(stream, TOK_STRING);
+    case '[':
+        return Push(stream, '[', J_ARRAY_FIRST);
+    case '{':
+        return Push(stream, '{', J_MAP_FIRST);
+    case 't':
+    case 'f':
+    case 'n':
+        --(*pos);
+        return BeginToken(stream, TOK_LITERAL);
+    case '-':
+    case '+':
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    case '8':
+    case '9':
+        --(*pos);
+        return BeginToken(stream, TOK_NUMBER);
+    default:
+        DPS_ERRPRINT("Unexpected character '%c'\n", c);
+        return DPS_ERR_INVALID;
+    }
+}
+
+static DPS_Status ExpectStreamChar(char c, char expected)
+{
+    if (c != expected) {
+        DPS_ERRPRINT("Expected '%c' character\n", expected);
+        return DPS_ERR_INVALID;
+    }
+    return DPS_OK;
+}
+
+/*
+ * Consumes input up to the end of the next token or structural character
+ */
+static DPS_Status Scan(DPS_JSON2CBORStream* stream, const char** pos, const char* end)
+{
+    DPS_Status ret = DPS_OK;
+    const char* p = *pos;
+    char level;
+    char c;
+
+    if (stream->state == J_TOKEN) {
+        return ScanToken(stream, pos, end);
+    }
+    if (stream->state == J_DONE) {
+        /*
+         * Anything after the first element is ignored
+         */
+        *pos = end;
+        return DPS_OK;
+    }
+    p += SpanWS(p, end - p);
+    if (p == end) {
+        *pos = p;
+        return DPS_OK;
+    }
+    c = *p++;
+    switch (stream->state) {
+    case J_ARRAY_FIRST:
+        if (c == ']') {
+            --stream->depth;
+            ret = EmitByte(stream, CBOR_ARRAY);
+            ValueDone(stream);
+            break;
+        }
+        /*
+         * The array header is deferred so empty arrays are encoded
+         * with a definite length
+         */
+        ret = EmitByte(stream, CBOR_ARRAY | CBOR_INDEFINITE);
+        if (ret != DPS_OK) {
+            break;
+        }
+        /* FALLTHROUGH */
+    case J_VALUE:
+        ret = BeginValue(stream, c, &p);
+        break;
+    case J_MAP_FIRST:
+        if (c == '}') {
+            --stream->depth;
+            ret = EmitByte(stream, CBOR_MAP);
+            ValueDone(stream);
+            break;
+        }
+        ret = ExpectStreamChar(c, '"');
+        if (ret == DPS_OK) {
+            ret = BeginToken(stream, TOK_KEY_FIRST);
+        }
+        break;
+    case J_MAP_KEY:
+        ret = ExpectStreamChar(c, '"');
+        if (ret == DPS_OK) {
+            ret = BeginToken(stream, TOK_KEY);
+        }
+        break;
+    case J_COLON:
+        ret = ExpectStreamChar(c, ':');
+        stream->state = J_VALUE;
+        break;
+    case J_NEXT:
+        level = stream->levels[stream->depth - 1];
+        if (c == ',') {
+            stream->state = (level == '[') ? J_VALUE : J_MAP_KEY;
+        } else if ((level == '[' && c == ']') || (level == '{' && c == '}')) {
+            --stream->depth;
+            ret = EmitByte(stream, CBOR_BREAK);
+            ValueDone(stream);
+        } else {
+            DPS_ERRPRINT("Expected ',' or '%c' character\n", (level == '[') ? ']' : '}');
+            ret = DPS_ERR_INVALID;
+        }
+        break;
+    case J_BINARY_COLON:
+        ret = ExpectStreamChar(c, ':');
+        stream->state = J_BINARY_VALUE;
+        break;
+    case J_BINARY_VALUE:
+        ret = ExpectStreamChar(c, '"');
+        if (ret == DPS_OK) {
+            ret = BeginToken(stream, TOK_BINARY);
+        }
+        break;
+    case J_BINARY_END:
+        ret = ExpectStreamChar(c, '}');
+        --stream->depth;
+        ValueDone(stream);
+        break;
+    default:
+        ret = DPS_ERR_INVALID;
+        break;
+    }
+    *pos = p;
+    return ret;
+}
+
+static void FlushCBOR(DPS_JSON2CBORStream* stream, uint8_t* cbor, size_t cborSize, size_t* cborLen)
+{
+    size_t n = stream->outLen - stream->outPos;
+
+    if (n > (cborSize - *cborLen)) {
+        n = cborSize - *cborLen;
+    }
+    if (n) {
+        memcpy_s(cbor + *cborLen, cborSize - *cborLen, stream->out + stream->outPos, n);
+        *cborLen += n;
+        stream->outPos += n;
+    }
+    if (stream->outPos == stream->outLen) {
+        stream->outPos = 0;
+        stream->outLen = 0;
+    }
+}
+
+static DPS_Status FinishCBOR(DPS_JSON2CBORStream* stream)
+{
+    DPS_Status ret = DPS_OK;
+
+    /*
+     * Numbers and literals are only terminated by the next character
+     */
+    if ((stream->state == J_TOKEN) && (stream->token >= TOK_NUMBER)) {
+        ret = EndToken(stream, stream->tok, stream->tokLen);
+    }
+    if (ret == DPS_OK) {
+        // An empty input is ok
+        if ((stream->state != J_DONE) && !((stream->state == J_VALUE) && (stream->depth == 0))) {
+            DPS_ERRPRINT("Incomplete JSON\n");
+            ret = DPS_ERR_EOD;
+        }
+    }
+    return ret;
+}
+
+DPS_Status DPS_JSON2CBORStreamConvert(DPS_JSON2CBORStream* stream, const char* json, size_t jsonLen, int last,
+                                      size_t* jsonUsed, uint8_t* cbor, size_t cborSize, size_t* cborLen)
+{
+    DPS_Status ret = DPS_OK;
+    const char* pos = json;
+    const char* end = json + jsonLen;
+
+    DPS_DBGTRACEA("stream=%p,json=%p,jsonLen=%d,last=%d,cbor=%p,cborSize=%d\n",
+                  stream, json, jsonLen, last, cbor, cborSize);
+
+    if (!stream || (!json && jsonLen) || !jsonUsed || !cbor || !cborLen) {
+        return DPS_ERR_NULL;
+    }
+    *jsonUsed = 0;
+    *cborLen = 0;
+    if (stream->status != DPS_OK) {
+        return stream->status;
+    }
+    /*
+     * Input is only consumed while there is room for the output
+     */
+    FlushCBOR(stream, cbor, cborSize, cborLen);
+    while ((ret == DPS_OK) && (pos < end) && (stream->outLen == 0)) {
+        ret = Scan(stream, &pos, end);
+        FlushCBOR(stream, cbor, cborSize, cborLen);
+    }
+    if ((ret == DPS_OK) && last && (pos == end) && (stream->outLen == 0)) {
+        ret = FinishCBOR(stream);
+        FlushCBOR(stream, cbor, cborSize, cborLen);
+    }
+    *jsonUsed = pos - json;
+    if (ret != DPS_OK) {
+        stream->status = ret;
+    } else if (stream->outLen) {
+        ret = DPS_ERR_OVERFLOW;
+    }
+    return ret;
+}
+
+/*
+ * Size of the output buffer of the CBOR to JSON converter, this is
+ * enough for the largest output generated in a single step
+ */
+#define CBOR_STREAM_BUF_SIZE   512
+
+/*
+ * Maximum string or byte string payload converted in a single step
+ */
+#define CBOR_STREAM_PIECE      128
+
+/*
+ * CBOR to JSON converter states
+ */
+#define C_ITEM     0  /* Accumulating the header of a data item */
+#define C_STRING   1  /* Copying the payload of a text string */
+#define C_BYTES    2  /* Converting the payload of a byte string */
+#define C_CLOSE    3  /* Closing the innermost array or map */
+#define C_DONE     4  /* The top level data item is complete */
+
+typedef struct {
+    uint8_t maj;
+    uint8_t indefinite;
+    uint64_t count;   /* Number of data items in a definite length container */
+    uint64_t items;   /* Number of data items converted so far */
+} CBORLevel;
+
+struct _DPS_CBOR2JSONStream {
+    int pretty;
+    int state;
+    int started;
+    uint8_t hdr[CBOR_MAX_LENGTH];
+    size_t hdrLen;
+    size_t hdrNeed;
+    uint64_t remaining;  /* String or byte string payload remaining */
+    CBORLevel levels[JSON_STREAM_MAX_DEPTH];
+    size_t depth;
+    char out[CBOR_STREAM_BUF_SIZE];  /* JSON not yet returned to the caller */
+    size_t outLen;
+    size_t outPos;
+    DPS_Status status;   /* Errors are sticky */
+};
+
+DPS_CBOR2JSONStream* DPS_CreateCBOR2JSONStream(int pretty)
+{
+    DPS_CBOR2JSONStream* stream = calloc(1, sizeof(DPS_CBOR2JSONStream));
+    if (stream) {
+        stream->pretty = pretty;
+        stream->state = C_ITEM;
+    }
+    return stream;
+}
+
+void DPS_DestroyCBOR2JSONStream(DPS_CBOR2JSONStream* stream)
+{
+    free(stream);
+}
+
+static DPS_Status Put(DPS_CBOR2JSONStream* stream, const char* str, size_t len)
+{
+    if (len == 0) {
+        return DPS_OK;
+    }
+    if (memcpy_s(stream->out + stream->outLen, sizeof(stream->out) - stream->outLen, str, len) != EOK) {
+        return DPS_ERR_FAILURE;
+    }
+    stream->outLen += len;
+    return DPS_OK;
+}
+
+static DPS_Status PutStr(DPS_CBOR2JSONStream* stream, const char* str)
+{
+    return Put(stream, str, strnlen_s(str, JSON_MAX_STRING_LEN));
+}
+
+/*
+ * Same layout rules as Indent() above
+ */
+static DPS_Status StreamIndent(DPS_CBOR2JSONStream* stream, size_t indent)
+{
+    char* str;
+
+    if (!stream->pretty) {
+        return DPS_OK;
+    }
+    if (indent && stream->outLen && (stream->out[stream->outLen - 1] == ':')) {
+        return Put(stream, " ", 1);
+    }
+    indent *= 2;
+    if ((stream->outLen + indent + 1) > sizeof(stream->out)) {
+        return DPS_ERR_FAILURE;
+    }
+    str = stream->out + stream->outLen;
+    str[0] = '\n';
+    memset(str + 1, ' ', indent);
+    stream->outLen += indent + 1;
+    return DPS_OK;
+}
+
+static void ItemDone(DPS_CBOR2JSONStream* stream)
+{
+    CBORLevel* level;
+
+    if (stream->depth == 0) {
+        stream->state = C_DONE;
+        return;
+    }
+    level = &stream->levels[stream->depth - 1];
+    ++level->items;
+    if (!level->indefinite && (level->items == level->count)) {
+        stream->state = C_CLOSE;
+    } else {
+        stream->state = C_ITEM;
+    }
+}
+
+static DPS_Status CloseLevel(DPS_CBOR2JSONStream* stream)
+{
+    CBORLevel* level = &stream->levels[stream->depth - 1];
+    DPS_Status ret;
+
+    if ((level->maj == CBOR_MAP) && (level->items & 1)) {
+        DPS_ERRPRINT("Map key without a value\n");
+        return DPS_ERR_INVALID;
+    }
+    --stream->depth;
+    ret = StreamIndent(stream, stream->depth);
+    if (ret == DPS_OK) {
+        ret = Put(stream, (level->maj == CBOR_ARRAY) ? "]" : "}", 1);
+    }
+    ItemDone(stream);
+    return ret;
+}
+
+static DPS_Status EndBytes(DPS_CBOR2JSONStream* stream)
+{
+    DPS_Status ret = Put(stream, "\"", 1);
+    if (ret == DPS_OK) {
+        ret = StreamIndent(stream, stream->depth);
+    }
+    if (ret == DPS_OK) {
+        ret = Put(stream, "}", 1);
+    }
+    ItemDone(stream);
+    return ret;
+}
+
+static DPS_Status BeginItem(DPS_CBOR2JSONStream* stream)
+{
+    char numStr[64];
+    DPS_RxBuffer rxBuf;
+    CBORLevel* level = stream->depth ? &stream->levels[stream->depth - 1] : NULL;
+    uint8_t maj = stream->hdr[0] & 0xE0;
+    uint8_t info = stream->hdr[0] & 0x1F;
+    uint64_t val = 0;
+    int64_t i64;
+    double d;
+    size_t i;
+    DPS_Status ret;
+
+    if (stream->hdr[0] == CBOR_BREAK) {
+        if (!level || !level->indefinite) {
+            DPS_ERRPRINT("Unexpected break\n");
+            return DPS_ERR_INVALID;
+        }
+        stream->state = C_CLOSE;
+        return DPS_OK;
+    }
+    if (info == CBOR_INDEFINITE) {
+        if ((maj != CBOR_ARRAY) && (maj != CBOR_MAP)) {
+            DPS_ERRPRINT("Indefinite length strings are not supported\n");
+            return DPS_ERR_INVALID;
+        }
+    } else if (info < 24) {
+        val = info;
+    } else {
+        for (i = 1; i < stream->hdrNeed; ++i) {
+            val = (val << 8) | stream->hdr[i];
+        }
+    }
+    ret = DPS_OK;
+    if (level && level->items) {
+        ret = Put(stream, ((level->maj == CBOR_MAP) && (level->items & 1)) ? ":" : ",", 1);
+    }
+    if (ret == DPS_OK) {
+        ret = StreamIndent(stream, stream->depth);
+    }
+    if (ret != DPS_OK) {
+        return ret;
+    }
+    DPS_RxBufferInit(&rxBuf, stream->hdr, stream->hdrNeed);
+    switch (maj) {
+    case CBOR_UINT:
+        snprintf(numStr, sizeof(numStr), "%"PRIu64, val);
+        ret = PutStr(stream, numStr);
+        ItemDone(stream);
+        break;
+    case CBOR_NEG:
+        ret = CBOR_DecodeInt(&rxBuf, &i64);
+        if (ret == DPS_OK) {
+            snprintf(numStr, sizeof(numStr), "%"PRId64, i64);
+            ret = PutStr(stream, numStr);
+        }
+        ItemDone(stream);
+        break;
+    case CBOR_BYTES:
+        ret = Put(stream, "{", 1);
+        if (ret == DPS_OK) {
+            ret = StreamIndent(stream, stream->depth + 1);
+        }
+        if (ret == DPS_OK) {
+            ret = PutStr(stream, "\"$binary\":\"");
+        }
+        stream->remaining = val;
+        stream->state = C_BYTES;
+        if ((ret == DPS_OK) && (val == 0)) {
+            ret = EndBytes(stream);
+        }
+        break;
+    case CBOR_STRING:
+        ret = Put(stream, "\"", 1);
+        stream->remaining = val;
+        stream->state = C_STRING;
+        if ((ret == DPS_OK) && (val == 0)) {
+            ret = Put(stream, "\"", 1);
+            ItemDone(stream);
+        }
+        break;
+    case CBOR_ARRAY:
+    case CBOR_MAP:
+        if (stream->depth == JSON_STREAM_MAX_DEPTH) {
+            DPS_ERRPRINT("CBOR nested too deeply\n");
+            return DPS_ERR_INVALID;
+        }
+        if (val > (UINT64_MAX / 2)) {
+            return DPS_ERR_INVALID;
+        }
+        ret = Put(stream, (maj == CBOR_ARRAY) ? "[" : "{", 1);
+        level = &stream->levels[stream->depth++];
+        level->maj = maj;
+        level->indefinite = (info == CBOR_INDEFINITE);
+        level->count = (maj == CBOR_MAP) ? val * 2 : val;
+        level->items = 0;
+        if (!level->indefinite && (level->count == 0)) {
+            stream->state = C_CLOSE;
+        } else {
+            stream->state = C_ITEM;
+        }
+        break;
+    case CBOR_OTHER:
+        if (stream->hdr[0] == CBOR_TRUE) {
+            ret = PutStr(stream, "true");
+        } else if (stream->hdr[0] == CBOR_FALSE) {
+            ret = PutStr(stream, "false");
+        } else if (stream->hdr[0] == CBOR_NULL) {
+            ret = PutStr(stream, "null");
+        } else if (stream->hdr[0] == CBOR_FLOAT || stream->hdr[0] == CBOR_DOUBLE) {
+            ret = CBOR_DecodeDouble(&rxBuf, &d);
+            if (ret == DPS_OK) {
+                snprintf(numStr, sizeof(numStr), "%f", d);
+                ret = PutStr(stream, numStr);
+            }
+        } else {
+            ret = DPS_ERR_INVALID;
+        }
+        ItemDone(stream);
+        break;
+    default:
+        DPS_ERRPRINT("Invalid CBOR major %02x\n", maj);
+        ret = DPS_ERR_INVALID;
+        break;
+    }
+    return ret;
+}
+
+static DPS_Status ScanItem(DPS_CBOR2JSONStream* stream, const uint8_t** pos, const uint8_t* end)
+{
+    static const char HexToChar[16] = "0123456789ABCDEF";
+    const uint8_t* p = *pos;
+    DPS_Status ret = DPS_OK;
+    size_t n;
+    size_t i;
+
+    switch (stream->state) {
+    case C_ITEM:
+        if (stream->hdrLen == 0) {
+            uint8_t info = p[0] & 0x1F;
+            if (info < 24 || info == CBOR_INDEFINITE) {
+                stream->hdrNeed = 1;
+            } else if (info < 28) {
+                stream->hdrNeed = 1 + ((size_t)1 << (info - 24));
+            } else {
+                DPS_ERRPRINT("Invalid CBOR additional information %d\n", info);
+                ret = DPS_ERR_INVALID;
+                break;
+            }
+            stream->started = DPS_TRUE;
+        }
+        n = stream->hdrNeed - stream->hdrLen;
+        if (n > (size_t)(end - p)) {
+            n = end - p;
+        }
+        memcpy_s(stream->hdr + stream->hdrLen, sizeof(stream->hdr) - stream->hdrLen, p, n);
+        stream->hdrLen += n;
+        p += n;
+        if (stream->hdrLen == stream->hdrNeed) {
+            stream->hdrLen = 0;
+            ret = BeginItem(stream);
+        }
+        break;
+    case C_STRING:
+        n = (stream->remaining < (CBOR_STREAM_PIECE * 2)) ? (size_t)stream->remaining : (CBOR_STREAM_PIECE * 2);
+        if (n > (size_t)(end - p)) {
+            n = end - p;
+        }
+        ret = Put(stream, (const char*)p, n);
+        p += n;
+        stream->remaining -= n;
+        if ((ret == DPS_OK) && (stream->remaining == 0)) {
+            ret = Put(stream, "\"", 1);
+            ItemDone(stream);
+        }
+        break;
+    case C_BYTES:
+        n = (stream->remaining < CBOR_STREAM_PIECE) ? (size_t)stream->remaining : CBOR_STREAM_PIECE;
+        if (n > (size_t)(end - p)) {
+            n = end - p;
+        }
+        for (i = 0; i < n; ++i) {
+            stream->out[stream->outLen++] = HexToChar[p[i] >> 4];
+            stream->out[stream->outLen++] = HexToChar[p[i] & 0xF];
+        }
+        p += n;
+        stream->remaining -= n;
+        if (stream->remaining == 0) {
+            ret = EndBytes(stream);
+        }
+        break;
+    case C_CLOSE:
+        ret = CloseLevel(stream);
+        break;
+    case C_DONE:
+        /*
+         * Anything after the first data item is ignored
+         */
+        p = end;
+        break;
+    }
+    *pos = p;
+    return ret;
+}
+
+static void FlushJSON(DPS_CBOR2JSONStream* stream, char* json, size_t jsonSize, size_t* jsonLen)
+{
+    size_t n = stream->outLen - stream->outPos;
+
+    if (n > (jsonSize - *jsonLen)) {
+        n = jsonSize - *jsonLen;
+    }
+    if (n) {
+        memcpy_s(json + *jsonLen, jsonSize - *jsonLen, stream->out + stream->outPos, n);
+        *jsonLen += n;
+        stream->outPos += n;
+    }
+    if (stream->outPos == stream->outLen) {
+        stream->outPos = 0;
+        stream->outLen = 0;
+    }
+}
+
+DPS_Status DPS_CBOR2JSONStreamConvert(DPS_CBOR2JSONStream* stream, const uint8_t* cbor, size_t cborLen, int last,
+                                      size_t* cborUsed, char* json, size_t jsonSize, size_t* jsonLen)
+{
+    DPS_Status ret = DPS_OK;
+    const uint8_t* pos = cbor;
+    const uint8_t* end = cbor + cborLen;
+
+    DPS_DBGTRACEA("stream=%p,cbor=%p,cborLen=%d,last=%d,json=%p,jsonSize=%d\n",
+                  stream, cbor, cborLen, last, json, jsonSize);
+
+    if (!stream || (!cbor && cborLen) || !cborUsed || !json || !jsonLen) {
+        return DPS_ERR_NULL;
+    }
+    *cborUsed = 0;
+    *jsonLen = 0;
+    if (stream->status != DPS_OK) {
+        return stream->status;
+    }
+    /*
+     * Input is only consumed while there is room for the output,
+     * closing a container does not need any input
+     */
+    FlushJSON(stream, json, jsonSize, jsonLen);
+    while ((ret == DPS_OK) && (stream->outLen == 0) && ((pos < end) || (stream->state == C_CLOSE))) {
+        ret = ScanItem(stream, &pos, end);
+        FlushJSON(stream, json, jsonSize, jsonLen);
+    }
+    if ((ret == DPS_OK) && last && (pos == end) && (stream->outLen == 0)) {
+        // Empty CBOR is ok
+        if (stream->started && (stream->state != C_DONE)) {
+            DPS_ERRPRINT("Incomplete CBOR\n");
+            ret = DPS_ERR_EOD;
+        }
+    }
+    *cborUsed = pos - cbor;
+    if (ret != DPS_OK) {
+        stream->status = ret;
+    } else if (stream->outLen) {
+        ret = DPS_ERR_OVERFLOW;
+    }
+    return ret;
+}
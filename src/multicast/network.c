@@ -49,13 +49,56 @@ struct _DPS_MulticastReceiver {
 typedef struct {
     uv_udp_t udp;
     int family;
+    struct sockaddr_storage addr; /* Multicast group address for this interface */
 } TxSocket;
 
+/*
+ * Buffers held in a send request without a separate allocation
+ */
+#define MAX_BUFS 8
+
+/*
+ * Messages up to this size, including the CoAP envelope, are gathered
+ * into a single buffer in the send request. Sending a single buffer
+ * avoids libuv allocating a copy of the buffer array for each
+ * interface.
+ */
+#define MAX_GATHER_LEN 1536
+
+/*
+ * Largest CoAP envelope copied into a send request
+ */
+#define MAX_COAP_HDR_LEN 32
+
+/*
+ * Maximum number of send requests kept for reuse
+ */
+#define MAX_FREE_SENDS 16
+
+typedef struct _MulticastSend {
+    struct _MulticastSend* next;      /* Next send request in the free list */
+    DPS_MulticastSender* sender;
+    void* appCtx;
+    DPS_MulticastSendComplete onSendComplete;
+    DPS_Status ret;
+    size_t numTx;
+    size_t numBufs;
+    uv_buf_t* bufs;                   /* CoAP envelope followed by the caller's buffers */
+    uv_buf_t inlineBufs[MAX_BUFS];
+    uint8_t data[MAX_GATHER_LEN];     /* CoAP envelope, followed by the message if gathered */
+    uv_udp_send_t sendReqs[1];        /* One per interface */
+} MulticastSend;
+
 struct _DPS_MulticastSender {
     uint8_t ipVersions;
     TxSocket* udpTx;  /* Array of Tx sockets - one per interface */
     size_t numTx;     /* Number of Tx sockets */
+    size_t numReqs;   /* Number of uv_udp_send_t in each send request */
     DPS_Node* node;
+    DPS_TxBuffer coap;          /* CoAP envelope template */
+    uint16_t msgId;             /* Next CoAP message ID */
+    MulticastSend* freeSends;   /* Send requests available for reuse */
+    size_t numFreeSends;
 };
 
 static int UseInterface(uint8_t ipVersions, uv_interface_address_t* ifn)
@@ -88,6 +131,7 @@ static void OnMcastRx(uv_udp_t* handle, ssize_t nread, const uv_buf_t* uvBuf, co
     DPS_MulticastReceiver* receiver = (DPS_MulticastReceiver*)handle->data;
     DPS_NetRxBuffer* buf = NULL;
     DPS_NetEndpoint ep;
+    DPS_NodeAddressType type;
 
     DPS_DBGTRACEA("handle=%p,nread=%d,buf={base=%p,len=%d},addr=%p,flags=0x%x\n", handle, nread,
                   uvBuf->base, uvBuf->len, addr, flags);
@@ -114,7 +158,15 @@ static void OnMcastRx(uv_udp_t* handle, ssize_t nread, const uv_buf_t* uvBuf, co
         DPS_DBGPRINT("Received buffer of size %zd from %s\n", nread, DPS_NetAddrText(addr));
     }
     ep.cn = NULL;
-    DPS_NetSetAddr(&ep.addr, DPS_UDP, addr);
+    /*
+     * Multicast publications carry the port or path of the sender's
+     * default transport, a path replaces the address when it is decoded
+     */
+    type = DPS_NetDefaultType();
+    if ((type == DPS_PIPE) || (type == DPS_SHM)) {
+        type = DPS_UDP;
+    }
+    DPS_NetSetAddr(&ep.addr, type, addr);
     receiver->cb(receiver->node, &ep, DPS_OK, buf);
 Exit:
     DPS_NetRxBufferDecRef(buf);
@@ -266,6 +318,18 @@ static DPS_Status MulticastTxInit(DPS_MulticastSender* sender)
 
     DPS_DBGPRINT("MulticastTxInit\n");
 
+    /*
+     * The CoAP envelope is the same for every publication
+     */
+    ret = CoAP_WrapTemplate(&sender->coap);
+    if (ret != DPS_OK) {
+        return ret;
+    }
+    if (DPS_TxBufferUsed(&sender->coap) > MAX_COAP_HDR_LEN) {
+        return DPS_ERR_OVERFLOW;
+    }
+    sender->msgId = (sender->coap.base[COAP_MSG_ID_OFFSET] << 8) | sender->coap.base[COAP_MSG_ID_OFFSET + 1];
+
     uv_interface_addresses(&ifsAddrs, &numIfs);
     /*
      * Count the usable interfaces
@@ -299,6 +363,14 @@ static DPS_Status MulticastTxInit(DPS_MulticastSender* sender)
         if (ret) {
             continue;
         }
+        if (sock->family == AF_INET6) {
+            ret = uv_ip6_addr(COAP_MCAST_ALL_NODES_LINK_LOCAL_6, COAP_UDP_PORT, (struct sockaddr_in6*)&sock->addr);
+        } else {
+            ret = uv_ip4_addr(COAP_MCAST_ALL_NODES_LINK_LOCAL_4, COAP_UDP_PORT, (struct sockaddr_in*)&sock->addr);
+        }
+        if (ret) {
+            continue;
+        }
         /*
          * Initialize udp Tx socket
          */
@@ -339,6 +411,7 @@ static DPS_Status MulticastTxInit(DPS_MulticastSender* sender)
         ++sock;
     }
     uv_free_interface_addresses(ifsAddrs, numIfs);
+    sender->numReqs = sender->numTx;
     return DPS_OK;
 }
 
@@ -358,6 +431,7 @@ DPS_MulticastSender* DPS_MulticastStartSend(DPS_Node* node)
         if (sender->udpTx) {
             free(sender->udpTx);
         }
+        DPS_TxBufferFree(&sender->coap);
         free(sender);
         return NULL;
     }
@@ -366,6 +440,12 @@ DPS_MulticastSender* DPS_MulticastStartSend(DPS_Node* node)
 
 static void FreeSender(DPS_MulticastSender* sender)
 {
+    while (sender->freeSends) {
+        MulticastSend* send = sender->freeSends;
+        sender->freeSends = send->next;
+        free(send);
+    }
+    DPS_TxBufferFree(&sender->coap);
     free(sender->udpTx);
     free(sender);
 }
@@ -390,17 +470,45 @@ void DPS_MulticastStopSend(DPS_MulticastSender* sender)
     }
 }
 
-#define MAX_BUFS 4
+static MulticastSend* AllocSend(DPS_MulticastSender* sender, size_t numBufs)
+{
+    MulticastSend* send = sender->freeSends;
 
-typedef struct {
-    DPS_MulticastSender* sender;
-    void* appCtx;
-    DPS_MulticastSendComplete onSendComplete;
-    DPS_Status ret;
-    size_t numTx;
-    size_t numBufs;
-    uv_buf_t bufs[1];
-} MulticastSend;
+    if (send) {
+        sender->freeSends = send->next;
+        --sender->numFreeSends;
+    } else {
+        send = malloc(sizeof(MulticastSend) + (sender->numReqs - 1) * sizeof(uv_udp_send_t));
+        if (!send) {
+            return NULL;
+        }
+    }
+    if (numBufs <= MAX_BUFS) {
+        send->bufs = send->inlineBufs;
+    } else {
+        send->bufs = malloc(numBufs * sizeof(uv_buf_t));
+        if (!send->bufs) {
+            free(send);
+            return NULL;
+        }
+    }
+    send->numBufs = numBufs;
+    return send;
+}
+
+static void FreeSend(DPS_MulticastSender* sender, MulticastSend* send)
+{
+    if (send->bufs != send->inlineBufs) {
+        free(send->bufs);
+    }
+    if (sender->numFreeSends < MAX_FREE_SENDS) {
+        send->next = sender->freeSends;
+        sender->freeSends = send;
+        ++sender->numFreeSends;
+    } else {
+        free(send);
+    }
+}
 
 static void MulticastSendComplete(uv_udp_send_t* req, int status)
 {
@@ -421,26 +529,19 @@ static void MulticastSendComplete(uv_udp_send_t* req, int status)
         if (send->onSendComplete) {
             send->onSendComplete(send->sender, send->appCtx, &send->bufs[1], send->numBufs - 1, send->ret);
         }
-        DPS_NetFreeBufs(send->bufs, 1);
-        free(send);
+        FreeSend(send->sender, send);
     }
-    free(req);
 }
 
 DPS_Status DPS_MulticastSend(DPS_MulticastSender* sender, void* appCtx, uv_buf_t* bufs, size_t numBufs,
                              DPS_MulticastSendComplete sendCompleteCB)
 {
     MulticastSend* send = NULL;
+    uv_buf_t* txBufs;
+    unsigned int numTxBufs;
+    size_t hdrLen;
+    size_t len;
     size_t i;
-    DPS_Status ret;
-
-#ifdef DPS_DEBUG
-    size_t len = 0;
-    size_t j;
-    for (j = 0; j < numBufs; ++j) {
-        len += bufs[j].len;
-    }
-#endif
 
     /*
      * No usable multicast interfaces so return immediately
@@ -449,7 +550,7 @@ DPS_Status DPS_MulticastSend(DPS_MulticastSender* sender, void* appCtx, uv_buf_t
         return DPS_ERR_NO_ROUTE;
     }
 
-    send = malloc(sizeof(MulticastSend) + numBufs * sizeof(uv_buf_t));
+    send = AllocSend(sender, numBufs + 1);
     if (!send) {
         return DPS_ERR_RESOURCES;
     }
@@ -459,46 +560,61 @@ DPS_Status DPS_MulticastSend(DPS_MulticastSender* sender, void* appCtx, uv_buf_t
     send->ret = DPS_OK;
     send->numTx = 0;
     memcpy_s(&send->bufs[1], numBufs * sizeof(uv_buf_t), bufs, numBufs * sizeof(uv_buf_t));
-    send->numBufs = numBufs + 1;
-    ret = CoAP_Wrap(send->bufs, send->numBufs);
-    if (ret != DPS_OK) {
-        free(send);
-        return ret;
+    /*
+     * Copy the CoAP envelope template and set the message ID
+     */
+    hdrLen = DPS_TxBufferUsed(&sender->coap);
+    memcpy_s(send->data, sizeof(send->data), sender->coap.base, hdrLen);
+    send->data[COAP_MSG_ID_OFFSET] = sender->msgId >> 8;
+    send->data[COAP_MSG_ID_OFFSET + 1] = sender->msgId & 0xFF;
+    ++sender->msgId;
+    send->bufs[0] = uv_buf_init((char*)send->data, (unsigned int)hdrLen);
+
+    len = hdrLen;
+    for (i = 0; i < numBufs; ++i) {
+        len += bufs[i].len;
+    }
+    if (len <= sizeof(send->data)) {
+        /*
+         * Gather the message behind the envelope
+         */
+        uint8_t* pos = send->data + hdrLen;
+        for (i = 0; i < numBufs; ++i) {
+            if (bufs[i].len) {
+                memcpy_s(pos, sizeof(send->data) - (pos - send->data), bufs[i].base, bufs[i].len);
+                pos += bufs[i].len;
+            }
+        }
+        /*
+         * The envelope slot is not passed back to the caller so can
+         * hold the gathered message
+         */
+        send->bufs[0] = uv_buf_init((char*)send->data, (unsigned int)len);
+        txBufs = send->bufs;
+        numTxBufs = 1;
+    } else {
+        txBufs = send->bufs;
+        numTxBufs = (unsigned int)send->numBufs;
     }
 
     /*
-     * Send on each interface
+     * Send on each interface, all the sends share the buffers in the
+     * send request
      */
     for (i = 0; i < sender->numTx; ++i) {
+        uv_udp_send_t* sendReq = &send->sendReqs[i];
+        TxSocket* sock = &sender->udpTx[i];
         int ret;
-        struct sockaddr_storage addr;
-        uv_udp_send_t* sendReq;
-        if (sender->udpTx[i].family == AF_INET6) {
-            ret = uv_ip6_addr(COAP_MCAST_ALL_NODES_LINK_LOCAL_6, COAP_UDP_PORT, (struct sockaddr_in6*)&addr);
-        } else {
-            ret = uv_ip4_addr(COAP_MCAST_ALL_NODES_LINK_LOCAL_4, COAP_UDP_PORT, (struct sockaddr_in*)&addr);
-        }
-        if (ret) {
-            continue;
-        }
 
-        sendReq = malloc(sizeof(uv_udp_send_t));
-        if (!sendReq) {
-            DPS_ERRPRINT("uv_udp_send_t malloc failed\n");
-            send->ret = DPS_ERR_RESOURCES;
-            continue;
-        }
         sendReq->data = send;
-
-        ret = uv_udp_send(sendReq, &sender->udpTx[i].udp, send->bufs, (unsigned int)send->numBufs,
-                          (struct sockaddr*)&addr, MulticastSendComplete);
+        ret = uv_udp_send(sendReq, &sock->udp, txBufs, numTxBufs, (struct sockaddr*)&sock->addr,
+                          MulticastSendComplete);
         if (ret) {
-            DPS_ERRPRINT("uv_udp_send to %s failed: %s\n", DPS_NetAddrText((struct sockaddr*)&addr),
+            DPS_ERRPRINT("uv_udp_send to %s failed: %s\n", DPS_NetAddrText((struct sockaddr*)&sock->addr),
                          uv_err_name(ret));
-            free(sendReq);
         } else {
             DPS_DBGPRINT("DPS_MulticastSend total %zu bytes to %s\n", len,
-                         DPS_NetAddrText((struct sockaddr*)&addr));
+                         DPS_NetAddrText((struct sockaddr*)&sock->addr));
             ++send->numTx;
         }
     }
@@ -506,8 +622,7 @@ DPS_Status DPS_MulticastSend(DPS_MulticastSender* sender, void* appCtx, uv_buf_t
         /*
          * Not a single send was successful
          */
-        DPS_NetFreeBufs(send->bufs, 1);
-        free(send);
+        FreeSend(sender, send);
         return DPS_ERR_NETWORK;
     }
     return DPS_OK;
@@ -44,6 +44,18 @@
  */
 DPS_DEBUG_CONTROL(DPS_DEBUG_OFF);
 
+/*
+ * Receive buffer references may be released by application threads
+ */
+#if defined(__GNUC__) || defined(__MINGW64__)
+#define INC_REF(p)  __atomic_add_fetch((p), 1, __ATOMIC_RELAXED)
+#define DEC_REF(p)  __atomic_sub_fetch((p), 1, __ATOMIC_ACQ_REL)
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define INC_REF(p)  (uint32_t)_InterlockedIncrement((volatile long*)(p))
+#define DEC_REF(p)  (uint32_t)_InterlockedDecrement((volatile long*)(p))
+#endif
+
 const char* DPS_NetAddrText(const struct sockaddr* addr)
 {
     if (addr) {
@@ -151,6 +163,7 @@ int DPS_SameAddr(const DPS_NodeAddress* addr1, const DPS_NodeAddress* addr2)
         }
         return DPS_FALSE;
     case DPS_PIPE:
+    case DPS_SHM:
         return !strcmp(addr1->u.path, addr2->u.path);
     default:
         return DPS_FALSE;
@@ -298,6 +311,7 @@ DPS_NodeAddress* DPS_SetAddress(DPS_NodeAddress* addr, const char* addrText)
 {
     char host[DPS_MAX_HOST_LEN + 1];
     char service[DPS_MAX_SERVICE_LEN + 1];
+    const char* text;
     DPS_Status ret;
 
     DPS_DBGTRACE();
@@ -307,20 +321,15 @@ DPS_NodeAddress* DPS_SetAddress(DPS_NodeAddress* addr, const char* addrText)
     }
 
     memset(addr, 0, sizeof(DPS_NodeAddress));
-#if defined(DPS_USE_DTLS)
-    addr->type = DPS_DTLS;
-#elif defined(DPS_USE_TCP)
-    addr->type = DPS_TCP;
-#elif defined(DPS_USE_UDP)
-    addr->type = DPS_UDP;
-#elif defined(DPS_USE_PIPE)
-    addr->type = DPS_PIPE;
-#endif
+    text = DPS_NetParseTransportPrefix(addrText, &addr->type);
+    if (!text) {
+        goto ErrorExit;
+    }
     switch (addr->type) {
     case DPS_DTLS:
     case DPS_TCP:
     case DPS_UDP:
-        ret = DPS_SplitAddress(addrText, host, sizeof(host), service, sizeof(service));
+        ret = DPS_SplitAddress(text, host, sizeof(host), service, sizeof(service));
         if (ret != DPS_OK) {
             goto ErrorExit;
         }
@@ -330,7 +339,8 @@ DPS_NodeAddress* DPS_SetAddress(DPS_NodeAddress* addr, const char* addrText)
         }
         return addr;
     case DPS_PIPE:
-        strncpy(addr->u.path, addrText, DPS_NODE_ADDRESS_PATH_MAX - 1);
+    case DPS_SHM:
+        strncpy(addr->u.path, text, DPS_NODE_ADDRESS_PATH_MAX - 1);
         return addr;
     default:
         break;
@@ -392,8 +402,17 @@ void DPS_EndpointSetPath(DPS_NetEndpoint* ep, char* path, size_t pathLen)
 {
     switch (ep->addr.type) {
     case DPS_UDP:
+        /*
+         * The endpoint was learned from a multicast publication which
+         * carries the path of the default transport
+         */
+        ep->addr.type = DPS_NetDefaultType();
+        assert(pathLen < DPS_NODE_ADDRESS_PATH_MAX);
+        memcpy(ep->addr.u.path, path, pathLen);
+        ep->addr.u.path[pathLen] = 0;
+        break;
     case DPS_PIPE:
-        ep->addr.type = DPS_PIPE;
+    case DPS_SHM:
         assert(pathLen < DPS_NODE_ADDRESS_PATH_MAX);
         memcpy(ep->addr.u.path, path, pathLen);
         ep->addr.u.path[pathLen] = 0;
@@ -482,7 +501,7 @@ DPS_NetRxBuffer* DPS_CreateNetRxBuffer(size_t len)
 void DPS_NetRxBufferIncRef(DPS_NetRxBuffer* buf)
 {
     if (buf) {
-        ++buf->refCount;
+        INC_REF(&buf->refCount);
     }
 }
 
@@ -490,8 +509,309 @@ void DPS_NetRxBufferDecRef(DPS_NetRxBuffer* buf)
 {
     if (buf) {
         assert(buf->refCount > 0);
-        if (--buf->refCount == 0) {
+        if (DEC_REF(&buf->refCount) == 0) {
             freeNetRxBufferHandler(buf);
         }
     }
 }
+
+/*
+ * The transports built into the library. The first is the default
+ * transport, used for addresses without a transport name prefix.
+ */
+static const DPS_NetTransport* Transports[] = {
+#if defined(DPS_USE_FUZZER)
+    &DPS_FuzzerTransport,
+#elif defined(DPS_USE_SIM)
+    &DPS_SimTransport,
+#else
+#if defined(DPS_USE_DTLS)
+    &DPS_DtlsTransport,
+#endif
+#if defined(DPS_USE_TCP)
+    &DPS_TcpTransport,
+#endif
+#if defined(DPS_USE_UDP) && defined(DPS_USE_URING)
+    &DPS_UringTransport,
+#elif defined(DPS_USE_UDP)
+    &DPS_UdpTransport,
+#endif
+#if defined(DPS_USE_PIPE)
+    &DPS_PipeTransport,
+#endif
+#if defined(DPS_USE_SHM)
+    &DPS_ShmTransport,
+#endif
+#endif
+};
+
+#define NUM_TRANSPORTS (sizeof(Transports) / sizeof(Transports[0]))
+
+static const struct {
+    const char* name;
+    DPS_NodeAddressType type;
+} TransportNames[] = {
+    { "dtls", DPS_DTLS },
+    { "tcp", DPS_TCP },
+    { "udp", DPS_UDP },
+    { "pipe", DPS_PIPE },
+    { "shm", DPS_SHM }
+};
+
+struct _DPS_NetContext {
+    DPS_NetTransportContext* ctx[NUM_TRANSPORTS]; /* Indexed the same as Transports */
+    uint64_t msgsSent[NUM_TRANSPORTS];
+    uint64_t bytesSent[NUM_TRANSPORTS];
+};
+
+static int IsPathType(DPS_NodeAddressType type)
+{
+    return (type == DPS_PIPE) || (type == DPS_SHM);
+}
+
+static int FindTransport(DPS_NodeAddressType type)
+{
+    int i;
+
+    for (i = 0; i < (int)NUM_TRANSPORTS; ++i) {
+        if (Transports[i]->type == type) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Select the transport for sending to an endpoint. An existing
+ * connection determines the transport, otherwise the address type
+ * does. Fall back to a transport using the same kind of address, for
+ * example an endpoint learned from a multicast publication.
+ */
+static int SelectTransport(const DPS_NetEndpoint* ep)
+{
+    int i;
+
+    if (ep->cn) {
+        const DPS_NetTransport* transport = *(const DPS_NetTransport**)ep->cn;
+        for (i = 0; i < (int)NUM_TRANSPORTS; ++i) {
+            if (Transports[i] == transport) {
+                return i;
+            }
+        }
+        return -1;
+    }
+    i = FindTransport(ep->addr.type);
+    if (i < 0) {
+        for (i = 0; i < (int)NUM_TRANSPORTS; ++i) {
+            if (IsPathType(Transports[i]->type) == IsPathType(ep->addr.type)) {
+                return i;
+            }
+        }
+        i = 0;
+    }
+    return i;
+}
+
+DPS_NetContext* DPS_NetStart(DPS_Node* node, const DPS_NodeAddress* addrs, size_t numAddrs, DPS_OnReceive cb)
+{
+    DPS_NetContext* netCtx;
+    const DPS_NodeAddress* addr;
+    size_t i;
+    size_t j;
+
+    for (j = 0; j < numAddrs; ++j) {
+        if (FindTransport(addrs[j].type) < 0) {
+            DPS_ERRPRINT("No transport for %s\n", DPS_NodeAddrToString(&addrs[j]));
+            return NULL;
+        }
+    }
+    netCtx = calloc(1, sizeof(DPS_NetContext));
+    if (!netCtx) {
+        return NULL;
+    }
+    for (i = 0; i < NUM_TRANSPORTS; ++i) {
+        addr = NULL;
+        for (j = 0; j < numAddrs; ++j) {
+            if (addrs[j].type == Transports[i]->type) {
+                addr = &addrs[j];
+                break;
+            }
+        }
+        netCtx->ctx[i] = Transports[i]->start(node, addr, cb);
+        if (!netCtx->ctx[i]) {
+            DPS_ERRPRINT("Failed to start %s transport\n", Transports[i]->name);
+            DPS_NetStop(netCtx);
+            return NULL;
+        }
+    }
+    return netCtx;
+}
+
+DPS_NodeAddress* DPS_NetGetListenAddress(DPS_NodeAddress* addr, DPS_NetContext* netCtx)
+{
+    return Transports[0]->getListenAddress(addr, netCtx ? netCtx->ctx[0] : NULL);
+}
+
+size_t DPS_NetGetListenAddresses(DPS_NodeAddress* addrs, size_t maxAddrs, DPS_NetContext* netCtx)
+{
+    size_t i;
+
+    for (i = 0; (i < NUM_TRANSPORTS) && (i < maxAddrs); ++i) {
+        Transports[i]->getListenAddress(&addrs[i], netCtx ? netCtx->ctx[i] : NULL);
+    }
+    return i;
+}
+
+void DPS_NetStop(DPS_NetContext* netCtx)
+{
+    size_t i;
+
+    if (netCtx) {
+        for (i = 0; i < NUM_TRANSPORTS; ++i) {
+            if (netCtx->ctx[i]) {
+                Transports[i]->stop(netCtx->ctx[i]);
+            }
+        }
+        free(netCtx);
+    }
+}
+
+DPS_Status DPS_NetSend(DPS_Node* node, void* appCtx, DPS_NetEndpoint* ep, uv_buf_t* bufs, size_t numBufs,
+                       DPS_NetSendComplete sendCompleteCB)
+{
+    DPS_Status ret;
+    size_t len = 0;
+    size_t j;
+    int i;
+
+    if (!node->netCtx) {
+        return DPS_ERR_NETWORK;
+    }
+    i = SelectTransport(ep);
+    if (i < 0) {
+        DPS_ERRPRINT("No transport for %s\n", DPS_NodeAddrToString(&ep->addr));
+        return DPS_ERR_NETWORK;
+    }
+    /*
+     * The transport may complete the send and free the buffers before returning
+     */
+    for (j = 0; j < numBufs; ++j) {
+        len += bufs[j].len;
+    }
+    ret = Transports[i]->send(node->netCtx->ctx[i], appCtx, ep, bufs, numBufs, sendCompleteCB);
+    if (ret == DPS_OK) {
+        ++node->netCtx->msgsSent[i];
+        node->netCtx->bytesSent[i] += len;
+    }
+    return ret;
+}
+
+size_t DPS_NetGetStats(DPS_NetContext* netCtx, DPS_NetStats* stats, size_t maxStats)
+{
+    size_t i;
+
+    if (!netCtx) {
+        return 0;
+    }
+    for (i = 0; (i < NUM_TRANSPORTS) && (i < maxStats); ++i) {
+        stats[i].transport = Transports[i]->name;
+        stats[i].msgsSent = netCtx->msgsSent[i];
+        stats[i].bytesSent = netCtx->bytesSent[i];
+    }
+    return i;
+}
+
+DPS_Status DPS_NetPrewarm(DPS_Node* node, const DPS_NodeAddress* addr)
+{
+    int i;
+
+    if (!node->netCtx) {
+        return DPS_ERR_NETWORK;
+    }
+    i = FindTransport(addr->type);
+    if (i < 0) {
+        return DPS_ERR_NETWORK;
+    }
+    if (!Transports[i]->prewarm) {
+        return DPS_OK;
+    }
+    return Transports[i]->prewarm(node->netCtx->ctx[i], addr);
+}
+
+void DPS_NetConnectionIncRef(DPS_NetConnection* cn)
+{
+    if (cn) {
+        (*(const DPS_NetTransport**)cn)->connectionIncRef(cn);
+    }
+}
+
+void DPS_NetConnectionDecRef(DPS_NetConnection* cn)
+{
+    if (cn) {
+        (*(const DPS_NetTransport**)cn)->connectionDecRef(cn);
+    }
+}
+
+DPS_NetTransportContext* DPS_NetGetTransportContext(DPS_NetContext* netCtx, const DPS_NetTransport* transport)
+{
+    size_t i;
+
+    if (netCtx) {
+        for (i = 0; i < NUM_TRANSPORTS; ++i) {
+            if (Transports[i] == transport) {
+                return netCtx->ctx[i];
+            }
+        }
+    }
+    return NULL;
+}
+
+const char* DPS_NetTransportPrefix(DPS_NodeAddressType type)
+{
+    int i;
+
+    if ((NUM_TRANSPORTS > 1) && (type != Transports[0]->type)) {
+        i = FindTransport(type);
+        if (i >= 0) {
+            return Transports[i]->name;
+        }
+    }
+    return NULL;
+}
+
+const char* DPS_NetParseTransportPrefix(const char* addrText, DPS_NodeAddressType* type)
+{
+    size_t i;
+    size_t len;
+
+    for (i = 0; i < sizeof(TransportNames) / sizeof(TransportNames[0]); ++i) {
+        len = strlen(TransportNames[i].name);
+        if (!strncmp(addrText, TransportNames[i].name, len) && (addrText[len] == ':')) {
+            if (FindTransport(TransportNames[i].type) < 0) {
+                DPS_ERRPRINT("Transport %s is not available\n", TransportNames[i].name);
+                return NULL;
+            }
+            *type = TransportNames[i].type;
+            return addrText + len + 1;
+        }
+    }
+    *type = Transports[0]->type;
+    return addrText;
+}
+
+DPS_NodeAddressType DPS_NetDefaultType(void)
+{
+    return Transports[0]->type;
+}
+
+DPS_NodeAddressType DPS_NetTransportType(const char* name)
+{
+    size_t i;
+
+    for (i = 0; i < NUM_TRANSPORTS; ++i) {
+        if (!strcmp(Transports[i]->name, name)) {
+            return Transports[i]->type;
+        }
+    }
+    return DPS_UNKNOWN;
+}
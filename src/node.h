@@ -29,12 +29,17 @@
 #define _DPS_NODE_H
 
 #include <safe_lib.h>
+#include <dps/private/cbor.h>
 #include <dps/private/network.h>
 #include <uv.h>
 #include "bitvec.h"
 #include "cose.h"
+#include "fragment.h"
 #include "history.h"
+#include "reliable.h"
+#include "retained.h"
 #include "queue.h"
+#include "topictrie.h"
 
 #if UV_VERSION_MAJOR < 1 || UV_VERSION_MINOR < 15
 #error libuv version 1.15 or higher is required
@@ -53,6 +58,9 @@ extern "C" {
 #define DPS_MSG_TYPE_SUB  2   /**< Subscription */
 #define DPS_MSG_TYPE_ACK  3   /**< End-to-end publication acknowledgement */
 #define DPS_MSG_TYPE_SAK  4   /**< One-hop subscription acknowledgement */
+#define DPS_MSG_TYPE_FRAG 5   /**< Fragment of a publication */
+#define DPS_MSG_TYPE_NAK  6   /**< One-hop request for missing fragments */
+#define DPS_MSG_TYPE_RACK 7   /**< One-hop acknowledgement of a reliable publication window */
 
 #define DPS_NODE_CREATED      0 /**< Node is created */
 #define DPS_NODE_RUNNING      1 /**< Node is running */
@@ -84,6 +92,39 @@ typedef struct _LinkMonitorConfig {
     uint32_t probeTO;  /**< Probe repeat time */
 } LinkMonitorConfig;
 
+/**
+ * Maximum size of a publication message header, up to and including
+ * the unprotected map of port or path, TTL, and window
+ */
+#define DPS_PUB_HEADER_MAX  (CBOR_SIZEOF_ARRAY(5) + 2 * CBOR_SIZEOF(uint8_t) + CBOR_SIZEOF_MAP(3) + \
+                             3 * CBOR_SIZEOF(uint8_t) + CBOR_SIZEOF(int16_t) + CBOR_SIZEOF(uint16_t) + \
+                             CBOR_SIZEOF_STRING_AND_LENGTH(DPS_NODE_ADDRESS_PATH_MAX))
+
+/**
+ * A publication message header encoded once for a listen address
+ * with fixed width fields that are patched for each send
+ */
+typedef struct _DPS_PubHeaderTemplate {
+    const DPS_NodeAddress* addr;     /**< The listen address encoded in the template */
+    uint8_t reliable;                /**< DPS_TRUE if the template includes the window */
+    size_t len;                      /**< Length of the encoded template */
+    size_t ttlOffset;                /**< Offset of the TTL value */
+    size_t windowOffset;             /**< Offset of the window value */
+    uint8_t buf[DPS_PUB_HEADER_MAX]; /**< The encoded template */
+} DPS_PubHeaderTemplate;
+
+/**
+ * Publication header templates and a pool of buffers to copy them
+ * into. A template is built for each listen address, with and
+ * without the window of a reliable publication.
+ */
+typedef struct _DPS_PubHeaders {
+    DPS_PubHeaderTemplate templates[2 * (DPS_MAX_TRANSPORTS + 1)]; /**< The templates */
+    size_t numTemplates;             /**< Number of templates built */
+    void* pool;                      /**< Free list of header buffers */
+    size_t poolSize;                 /**< Number of buffers in the free list */
+} DPS_PubHeaders;
+
 /**
  * A local node
  */
@@ -91,7 +132,9 @@ typedef struct _DPS_Node {
     void* userData;                       /**< Application provided user data */
 
     uint8_t subsPending;                  /**< Used to rate-limit subscription messages */
-    DPS_NodeAddress addr;                 /**< Listening address */
+    DPS_NodeAddress addr;                 /**< Listening address of the default transport */
+    DPS_NodeAddress listenAddrs[DPS_MAX_TRANSPORTS]; /**< Listening address of each transport */
+    size_t numListenAddrs;                /**< Number of listening addresses */
     char addrStr[DPS_NODE_ADDRESS_MAX_STRING_LEN]; /**< Text of listening address */
     DPS_UUID meshId;                      /**< Randomly allocated mesh id for this node */
     DPS_UUID minMeshId;                   /**< Minimum mesh id seen by this node */
@@ -105,6 +148,7 @@ typedef struct _DPS_Node {
     uv_mutex_t condMutex;                 /**< Mutex for use with condition variables */
 
     uv_async_t acksAsync;                 /**< Async for sending acks */
+    uv_async_t prewarmAsync;              /**< Async for pre-warming connections to ack routes */
     uv_async_t pubsAsync;                 /**< Async for sending publications */
     uv_timer_t pubsTimer;                 /**< Timer for publication maintenance */
     uv_async_t stopAsync;                 /**< Async for shutting down the node */
@@ -114,12 +158,16 @@ typedef struct _DPS_Node {
     uv_timer_t subsTimer;                 /**< Timer for sending subscriptions */
 
     DPS_Queue ackQueue;                   /**< Queued acknowledgement packets */
+    DPS_Queue pendingAckQueue;            /**< Acknowledgements waiting to be aggregated */
+    uint32_t ackAggregationDelay;         /**< Time (in msecs) acks are held for aggregation, zero to disable */
+    uv_timer_t acksTimer;                 /**< Timer for sending aggregated acks */
 
     RemoteNode* remoteNodes;              /**< Linked list of remote nodes */
 
     struct {
         DPS_BitVector* needs;             /**< Preallocated needs bit vector */
         DPS_BitVector* interests;         /**< Preallocated interests bit vector */
+        DPS_BitVector* added;             /**< Preallocated bit vector for interests added by a remote node */
     } scratch;                            /**< Preallocated needs and interests */
 
     DPS_CountVector* interests;           /**< Tracks all interests for this node */
@@ -128,12 +176,19 @@ typedef struct _DPS_Node {
     DPS_History history;                  /**< History of recently sent publications */
 
     DPS_Publication* publications;        /**< Linked list of local and retained publications */
+    DPS_RetainedIndex retained;           /**< Retained publications indexed by Bloom filter bits */
     DPS_Subscription* subscriptions;      /**< Linked list of local subscriptions */
+    DPS_TopicTrie topicTrie;              /**< Topics of the local subscriptions */
+
+    DPS_Fragments fragments;              /**< Publications being sent or received as fragments */
+    DPS_Reliable reliable;                /**< Publications being sent or received reliably */
+    DPS_PubHeaders pubHeaders;            /**< Publication header templates and buffers */
 
     DPS_MulticastReceiver* mcastReceiver; /**< Multicast receiver context */
     DPS_MulticastSender* mcastSender;     /**< Multicast sender context */
 
     DPS_NetContext* netCtx;               /**< Network context */
+    int noIoUring;                        /**< Use the libuv UDP path even if io_uring is available */
 
     uint8_t state;                        /**< Indicates if the node is running, stopping, or stopped */
     DPS_OnNodeDestroyed onDestroyed;      /**< Function to call when the node is destroyed */
@@ -144,6 +199,8 @@ typedef struct _DPS_Node {
     uv_async_t resolverAsync;             /**< Async handler for address resolver */
     ResolverInfo* resolverList;           /**< Linked list of address resolution requests */
 
+    DPS_BloomStats bloomStats;            /**< Bloom filter counters for all links */
+
 } DPS_Node;
 
 /**
@@ -163,6 +220,7 @@ typedef struct _RemoteNode {
         uint8_t muted;                 /**< TRUE if the remote informed us the that link is muted */
         uint32_t revision;             /**< Revision number of last subscription received from this node */
         DPS_UUID meshId;               /**< The mesh id received from this remote node */
+        uint32_t bitLen;               /**< Bit vector length configured on the remote node, zero if not known */
         DPS_BitVector* needs;          /**< Bit vector of needs received from  this remote node */
         DPS_BitVector* interests;      /**< Bit vector of interests received from  this remote node */
     } inbound;
@@ -173,12 +231,20 @@ typedef struct _RemoteNode {
         uint8_t ackCountdown;          /**< Number of remaining subscription send retries + 1 */
         uint8_t includeSub;            /**< TRUE to include subscription in SAK */
         uint8_t subPending;            /**< TRUE if subscription send is pending */
+        uint8_t deferred;              /**< TRUE if changes to the interests are being held back */
+        uint8_t needsRelaxed;          /**< TRUE if bits have been removed from the needs since the last send */
+        uint8_t backoff;               /**< Exponent of the hold off time between subscription updates */
+        uint32_t rtt;                  /**< Smoothed subscription round trip time (msecs), zero if not known */
+        uint64_t sendTime;             /**< Time (msecs) the current revision was first sent */
         uint32_t revision;             /**< Revision number of last subscription sent to this node */
+        uint64_t interestsRev;         /**< Revision of the node interests the outbound interests are current to */
+        uint64_t needsRev;             /**< Revision of the node needs the outbound needs are current to */
         DPS_UUID meshId;               /**< The mesh id sent to this remote node */
         DPS_BitVector* needs;          /**< Needs bit vector sent outbound to this remote node */
         DPS_BitVector* interests;      /**< Full outbound interests bit vector to this remote node */
         DPS_BitVector* delta;          /**< Delta outbound bit vector sent to this remote node */
     } outbound;
+    DPS_BloomStats bloomStats;         /**< Bloom filter counters for this link */
     LinkMonitor* monitor;              /**< For monitoring muted links */
     DPS_NetEndpoint ep;                /**< The endpoint of the remote */
     RemoteNode* next;                  /**< Remotes are a linked list attached to the local node */
@@ -190,6 +256,15 @@ typedef struct _RemoteNode {
  */
 extern RemoteNode* DPS_LoopbackNode;
 
+/**
+ * Add a load factor sample to the link and node statistics
+ *
+ * @param link  The link statistics
+ * @param node  The node statistics
+ * @param bv    The interests, NULL if there are none
+ */
+void DPS_SampleLoadFactor(DPS_LoadFactorStats* link, DPS_LoadFactorStats* node, DPS_BitVector* bv);
+
 /**
  * Request to asynchronously updates subscriptions
  *
@@ -205,6 +280,15 @@ void DPS_UpdateSubs(DPS_Node* node);
  */
 void DPS_QueuePublicationAck(DPS_Node* node, PublicationAck* ack);
 
+/**
+ * Queue an acknowledgement to be aggregated with other acknowledgements
+ * for the same publication before being sent asynchronously
+ *
+ * @param node    The node
+ * @param ack     The unserialized acknowledgement to queue
+ */
+void DPS_QueuePendingAck(DPS_Node* node, PublicationAck* ack);
+
 /**
  * Callback function called when a subscription send operation completes
  *
@@ -228,6 +312,18 @@ void DPS_OnSendSubscriptionComplete(DPS_Node* node, void* appCtx, DPS_NetEndpoin
  */
 void DPS_MakeNonce(const DPS_UUID* uuid, uint32_t seqNum, uint8_t msgType, uint8_t nonce[COSE_NONCE_LEN]);
 
+/**
+ * Get the listening address to send to a remote endpoint. This is the
+ * address of the transport the endpoint is reached over so the remote
+ * node can reply over the same transport.
+ *
+ * @param node  The local node
+ * @param ep    The remote endpoint or NULL for multicast
+ *
+ * @return The listening address
+ */
+const DPS_NodeAddress* DPS_ListenAddressFor(DPS_Node* node, const DPS_NetEndpoint* ep);
+
 /**
  * Function to call when a send operation completes.
  *
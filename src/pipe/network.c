@@ -58,6 +58,8 @@ typedef struct _SendRequest {
 } SendRequest;
 
 typedef struct _DPS_NetConnection {
+    const DPS_NetTransport* transport; /* must be first, see DPS_NetTransport */
+    DPS_NetTransportContext* netCtx;
     DPS_Node* node;
     uv_pipe_t socket;
     DPS_NetEndpoint peerEp;
@@ -74,12 +76,15 @@ typedef struct _DPS_NetConnection {
     uv_idle_t idle;
 } DPS_NetConnection;
 
-struct _DPS_NetContext {
+struct _DPS_NetTransportContext {
     uv_pipe_t socket;   /* the listen socket */
     DPS_Node* node;
     DPS_OnReceive receiveCB;
 };
 
+static void ConnectionIncRef(DPS_NetConnection* cn);
+static void ConnectionDecRef(DPS_NetConnection* cn);
+
 #define MIN_BUF_ALLOC_SIZE   512
 #define MIN_READ_SIZE        CBOR_SIZEOF(uint32_t)
 
@@ -192,13 +197,13 @@ static void OnData(uv_stream_t* socket, ssize_t nread, const uv_buf_t* buf)
 {
     DPS_Status ret = DPS_OK;
     DPS_NetConnection* cn = (DPS_NetConnection*)socket->data;
-    DPS_NetContext* netCtx = cn->node->netCtx;
+    DPS_NetTransportContext* netCtx = cn->netCtx;
 
     DPS_DBGTRACE();
     /*
-     * netCtx will be null if we are shutting down
+     * The node network context will be null if we are shutting down
      */
-    if (!netCtx) {
+    if (!cn->node->netCtx) {
         return;
     }
     /*
@@ -285,7 +290,7 @@ static void OnData(uv_stream_t* socket, ssize_t nread, const uv_buf_t* buf)
 static void OnIncomingConnection(uv_stream_t* stream, int status)
 {
     int ret;
-    DPS_NetContext* netCtx = (DPS_NetContext*)stream->data;
+    DPS_NetTransportContext* netCtx = (DPS_NetTransportContext*)stream->data;
     DPS_NetConnection* cn;
     size_t sz;
 
@@ -310,6 +315,8 @@ static void OnIncomingConnection(uv_stream_t* stream, int status)
         free(cn);
         goto FailConnection;
     }
+    cn->transport = &DPS_PipeTransport;
+    cn->netCtx = netCtx;
     cn->node = netCtx->node;
     cn->socket.data = cn;
     cn->peerEp.cn = cn;
@@ -376,14 +383,14 @@ static int GetScopeId(struct sockaddr_in6* addr)
 
 #define LISTEN_BACKLOG  2
 
-DPS_NetContext* DPS_NetStart(DPS_Node* node, const DPS_NodeAddress* addr, DPS_OnReceive cb)
+static DPS_NetTransportContext* NetStart(DPS_Node* node, const DPS_NodeAddress* addr, DPS_OnReceive cb)
 {
     char path[DPS_NODE_ADDRESS_PATH_MAX] = { 0 };
-    DPS_NetContext* netCtx = NULL;
+    DPS_NetTransportContext* netCtx = NULL;
     DPS_UUID uuid;
     int ret;
 
-    netCtx = calloc(1, sizeof(DPS_NetContext));
+    netCtx = calloc(1, sizeof(DPS_NetTransportContext));
     if (!netCtx) {
         return NULL;
     }
@@ -446,7 +453,7 @@ ErrorExit:
     return NULL;
 }
 
-DPS_NodeAddress* DPS_NetGetListenAddress(DPS_NodeAddress* addr, DPS_NetContext* netCtx)
+static DPS_NodeAddress* NetGetListenAddress(DPS_NodeAddress* addr, DPS_NetTransportContext* netCtx)
 {
     size_t len;
 
@@ -470,7 +477,7 @@ DPS_NodeAddress* DPS_NetGetListenAddress(DPS_NodeAddress* addr, DPS_NetContext*
     return addr;
 }
 
-void DPS_NetStop(DPS_NetContext* netCtx)
+static void NetStop(DPS_NetTransportContext* netCtx)
 {
     if (netCtx) {
         netCtx->socket.data = netCtx;
@@ -491,7 +498,7 @@ static void OnWriteComplete(uv_write_t* writeReq, int status)
     }
     DPS_QueuePushBack(&cn->sendCompletedQueue, &req->queue);
     SendCompleted(cn);
-    DPS_NetConnectionDecRef(cn);
+    ConnectionDecRef(cn);
 }
 
 static void DoSend(DPS_NetConnection* cn)
@@ -503,7 +510,7 @@ static void DoSend(DPS_NetConnection* cn)
         int r = uv_write(&req->writeReq, (uv_stream_t*)&cn->socket, req->bufs, (uint32_t)req->numBufs,
                          OnWriteComplete);
         if (r == 0) {
-            DPS_NetConnectionIncRef(cn);
+            ConnectionIncRef(cn);
         } else {
             DPS_ERRPRINT("DoSend - write failed: %s\n", uv_err_name(r));
             req->status = DPS_ERR_NETWORK;
@@ -530,9 +537,10 @@ static void OnOutgoingConnection(uv_connect_t *req, int status)
     SendCompleted(cn);
 }
 
-DPS_Status DPS_NetSend(DPS_Node* node, void* appCtx, DPS_NetEndpoint* ep, uv_buf_t* bufs,
-                       size_t numBufs, DPS_NetSendComplete sendCompleteCB)
+static DPS_Status NetSend(DPS_NetTransportContext* netCtx, void* appCtx, DPS_NetEndpoint* ep, uv_buf_t* bufs,
+                          size_t numBufs, DPS_NetSendComplete sendCompleteCB)
 {
+    DPS_Node* node = netCtx->node;
     DPS_Status ret;
     DPS_TxBuffer lenBuf;
     SendRequest* req;
@@ -600,6 +608,8 @@ DPS_Status DPS_NetSend(DPS_Node* node, void* appCtx, DPS_NetEndpoint* ep, uv_buf
         goto ErrExit;
     }
     ep->cn->peerEp.addr = ep->addr;
+    ep->cn->transport = &DPS_PipeTransport;
+    ep->cn->netCtx = netCtx;
     ep->cn->node = node;
     DPS_QueueInit(&ep->cn->sendQueue);
     DPS_QueueInit(&ep->cn->sendCompletedQueue);
@@ -612,7 +622,7 @@ DPS_Status DPS_NetSend(DPS_Node* node, void* appCtx, DPS_NetEndpoint* ep, uv_buf
     ep->cn->peerEp.cn = ep->cn;
     DPS_QueuePushBack(&ep->cn->sendQueue, &req->queue);
     req->cn = ep->cn;
-    DPS_NetConnectionIncRef(ep->cn);
+    ConnectionIncRef(ep->cn);
     return DPS_OK;
 
 ErrExit:
@@ -632,7 +642,7 @@ ErrExit:
     return DPS_ERR_NETWORK;
 }
 
-void DPS_NetConnectionIncRef(DPS_NetConnection* cn)
+static void ConnectionIncRef(DPS_NetConnection* cn)
 {
     if (cn) {
         DPS_DBGTRACE();
@@ -640,7 +650,7 @@ void DPS_NetConnectionIncRef(DPS_NetConnection* cn)
     }
 }
 
-void DPS_NetConnectionDecRef(DPS_NetConnection* cn)
+static void ConnectionDecRef(DPS_NetConnection* cn)
 {
     if (cn) {
         DPS_DBGTRACE();
@@ -650,3 +660,15 @@ void DPS_NetConnectionDecRef(DPS_NetConnection* cn)
         }
     }
 }
+
+const DPS_NetTransport DPS_PipeTransport = {
+    "pipe",
+    DPS_PIPE,
+    NetStart,
+    NetGetListenAddress,
+    NetStop,
+    NetSend,
+    ConnectionIncRef,
+    ConnectionDecRef,
+    NULL
+};
@@ -46,6 +46,44 @@ DPS_DEBUG_CONTROL(DPS_DEBUG_ON);
 
 #define RemoteNodeAddressText(n)  DPS_NodeAddrToString(&(n)->ep.addr)
 
+/*
+ * Layout of the unprotected map of a publication
+ */
+typedef struct {
+    uint16_t port;
+    int16_t ttl;
+    CBOR_Span path;
+    uint16_t window;
+} PubUnprotected;
+
+enum { PUB_PORT, PUB_TTL, PUB_PATH, PUB_WINDOW };
+
+static const CBOR_MapField PubUnprotectedFields[] = {
+    CBOR_MAP_FIELD(DPS_CBOR_KEY_PORT, UINT16, CBOR_FIELD_OPTIONAL, PubUnprotected, port),
+    CBOR_MAP_FIELD(DPS_CBOR_KEY_TTL, INT16, CBOR_FIELD_FIXED, PubUnprotected, ttl),
+    CBOR_MAP_FIELD(DPS_CBOR_KEY_PATH, STRING, CBOR_FIELD_OPTIONAL, PubUnprotected, path),
+    CBOR_MAP_FIELD(DPS_CBOR_KEY_WINDOW, UINT16, CBOR_FIELD_OPTIONAL | CBOR_FIELD_FIXED, PubUnprotected, window)
+};
+
+/*
+ * Layout of the protected map of a publication
+ */
+typedef struct {
+    int16_t ttl;
+    DPS_UUID pubId;
+    uint32_t sequenceNum;
+    int ackRequested;
+    CBOR_Span bf;
+} PubProtected;
+
+static const CBOR_MapField PubProtectedFields[] = {
+    CBOR_MAP_FIELD(DPS_CBOR_KEY_TTL, INT16, 0, PubProtected, ttl),
+    CBOR_MAP_FIELD(DPS_CBOR_KEY_PUB_ID, UUID, 0, PubProtected, pubId),
+    CBOR_MAP_FIELD(DPS_CBOR_KEY_SEQ_NUM, UINT32, 0, PubProtected, sequenceNum),
+    CBOR_MAP_FIELD(DPS_CBOR_KEY_ACK_REQ, BOOLEAN, 0, PubProtected, ackRequested),
+    CBOR_MAP_FIELD(DPS_CBOR_KEY_BLOOM_FILTER, RAW, 0, PubProtected, bf)
+};
+
 static DPS_Status SetKey(DPS_KeyStoreRequest* request, const DPS_Key* key)
 {
     int8_t* alg = request->data;
@@ -226,6 +264,7 @@ static DPS_Publication* FreePublication(DPS_Node* node, DPS_Publication* pub)
     DPS_PublishRequest* req;
 
     if (!(pub->flags & PUB_FLAG_WAS_FREED)) {
+        DPS_RetainedIndexRemove(&node->retained, pub);
         if (node->publications == pub) {
             node->publications = next;
         } else {
@@ -280,11 +319,17 @@ void DPS_PublicationIncRef(DPS_Publication* pub)
     ++pub->refCount;
 }
 
+static void DestroyCopy(DPS_Publication* copy);
+
 void DPS_PublicationDecRef(DPS_Publication* pub)
 {
     assert(pub->refCount != 0);
     if ((--pub->refCount == 0) && (pub->flags & PUB_FLAG_WAS_FREED)) {
-        FreePublication(pub->node, pub);
+        if (pub->flags & PUB_FLAG_IS_COPY) {
+            DestroyCopy(pub);
+        } else {
+            FreePublication(pub->node, pub);
+        }
     }
 }
 
@@ -416,11 +461,10 @@ static DPS_Status UpdatePubHistory(DPS_PublishRequest* req)
 
 /*
  * @param pub the request to decrypt
- * @param plainTextBuf the storage for decrypted.  The caller needs to
- *                     call DPS_TxBufferFree when finished with the
- *                     decrypted data.
- * @param data pointer to decrypted data.  This is only valid during
- *             the lifetime of the plainTextBuf and the publication.
+ * @param data pointer to decrypted data.  This is only valid while
+ *             pub->rxBuf holds the buffer it points into.  The caller
+ *             needs to call DPS_NetRxBufferDecRef on pub->rxBuf when
+ *             finished with decrypted data.
  * @param dataLen the length of the decrypted data.
  *
  * @return
@@ -428,8 +472,7 @@ static DPS_Status UpdatePubHistory(DPS_PublishRequest* req)
  * - DPS_ERR_SECURITY - message failed to decrypt
  * - Other error - message failed to parse correctly
  */
-static DPS_Status DecryptAndParsePub(DPS_PublishRequest* req, DPS_TxBuffer* plainTextBuf, uint8_t** data,
-                                     size_t* dataLen)
+static DPS_Status DecryptAndParsePub(DPS_PublishRequest* req, uint8_t** data, size_t* dataLen)
 {
     static const int32_t EncryptedKeys[] = { DPS_CBOR_KEY_TOPICS, DPS_CBOR_KEY_DATA };
     DPS_Publication* pub = req->pub;
@@ -437,6 +480,8 @@ static DPS_Status DecryptAndParsePub(DPS_PublishRequest* req, DPS_TxBuffer* plai
     uint8_t nonce[COSE_NONCE_LEN];
     DPS_RxBuffer aadBuf;
     DPS_RxBuffer cipherTextBuf;
+    DPS_TxBuffer plainTextBuf;
+    DPS_NetRxBuffer* plainTextRxBuf;
     COSE_Entity recipient;
     DPS_RxBuffer encryptedBuf;
     CBOR_MapState mapState;
@@ -451,17 +496,32 @@ static DPS_Status DecryptAndParsePub(DPS_PublishRequest* req, DPS_TxBuffer* plai
     DPS_MakeNonce(&pub->pubId, req->sequenceNum, DPS_MSG_TYPE_PUB, nonce);
     DPS_TxBufferToRx(&req->bufs[0], &aadBuf);
     DPS_TxBufferToRx(&req->bufs[1], &cipherTextBuf);
-    DPS_TxBufferClear(plainTextBuf);
     ret = CBOR_Peek(&cipherTextBuf, &type, &tag);
     if (ret == DPS_OK) {
         if (type == CBOR_TAG) {
             if ((tag == COSE_TAG_ENCRYPT0) || (tag == COSE_TAG_ENCRYPT)) {
-                ret = COSE_Decrypt(nonce, &recipient, &aadBuf, &cipherTextBuf, keyStore, &pub->sender,
-                                   plainTextBuf);
+                /*
+                 * Decrypt into a receive buffer so the handlers can
+                 * retain a decrypted payload the same way as an
+                 * unencrypted one
+                 */
+                plainTextRxBuf = DPS_CreateNetRxBuffer(DPS_RxBufferAvail(&cipherTextBuf));
+                if (plainTextRxBuf) {
+                    DPS_TxBufferInit(&plainTextBuf, plainTextRxBuf->data, DPS_RxBufferAvail(&cipherTextBuf));
+                    ret = COSE_Decrypt(nonce, &recipient, &aadBuf, &cipherTextBuf, keyStore, &pub->sender,
+                                       &plainTextBuf);
+                    if (ret != DPS_OK) {
+                        DPS_NetRxBufferDecRef(plainTextRxBuf);
+                    }
+                } else {
+                    ret = DPS_ERR_RESOURCES;
+                }
                 if (ret == DPS_OK) {
                     DPS_DBGPRINT("Publication was decrypted\n");
-                    CBOR_Dump("plaintext", plainTextBuf->base, DPS_TxBufferUsed(plainTextBuf));
-                    DPS_TxBufferToRx(plainTextBuf, &encryptedBuf);
+                    CBOR_Dump("plaintext", plainTextBuf.base, DPS_TxBufferUsed(&plainTextBuf));
+                    DPS_TxBufferToRx(&plainTextBuf, &plainTextRxBuf->rx);
+                    encryptedBuf = plainTextRxBuf->rx;
+                    pub->rxBuf = plainTextRxBuf;
                     /*
                      * We will use the same key id when we encrypt the acknowledgement
                      */
@@ -581,15 +641,14 @@ static DPS_Status DecryptAndParsePub(DPS_PublishRequest* req, DPS_TxBuffer* plai
     return ret;
 }
 
-DPS_Status DPS_CallPubHandlers(DPS_PublishRequest* req)
+DPS_Status DPS_CallPubHandlers(DPS_PublishRequest* req, int* bloomMatch, int* topicMatch)
 {
     DPS_Publication* pub = req->pub;
     DPS_Node* node = pub->node;
     DPS_Status ret = DPS_OK;
     DPS_Subscription* sub;
     DPS_Subscription* nextSub;
-    DPS_TxBuffer plainTextBuf;
-    int match;
+    DPS_Status matchRet = DPS_ERR_INVALID;
     uint8_t* data = NULL;
     size_t dataLen = 0;
     int needsDecrypt = DPS_TRUE;
@@ -603,7 +662,12 @@ DPS_Status DPS_CallPubHandlers(DPS_PublishRequest* req)
         return DPS_ERR_ARGS;
     }
 
-    DPS_TxBufferClear(&plainTextBuf);
+    if (bloomMatch) {
+        *bloomMatch = DPS_FALSE;
+    }
+    if (topicMatch) {
+        *topicMatch = DPS_FALSE;
+    }
     /*
      * Iterate over the candidates and check that the pub strings are a match
      */
@@ -622,10 +686,15 @@ DPS_Status DPS_CallPubHandlers(DPS_PublishRequest* req)
         }
         if (needsDecrypt) {
             DPS_UnlockNode(node);
-            ret = DecryptAndParsePub(req, &plainTextBuf, &data, &dataLen);
+            ret = DecryptAndParsePub(req, &data, &dataLen);
             DPS_LockNode(node);
             if (ret == DPS_OK) {
                 needsDecrypt = DPS_FALSE;
+                /*
+                 * The topics are matched against all of the subscriptions
+                 * at once, a publication with invalid topics matches none
+                 */
+                matchRet = DPS_TopicTrieMatch(&node->topicTrie, pub->topics, pub->numTopics, node->separators);
             } else {
                 if (ret == DPS_ERR_SECURITY) {
                     /*
@@ -638,14 +707,18 @@ DPS_Status DPS_CallPubHandlers(DPS_PublishRequest* req)
                 break;
             }
         }
-        ret = DPS_MatchTopicList(pub->topics, pub->numTopics, sub->topics,
-                                 sub->numTopics, node->separators, DPS_FALSE, &match);
-        if (ret != DPS_OK) {
-            ret = DPS_OK;
-            goto Next;
+        /*
+         * A publication that cannot be decrypted is not counted as a Bloom
+         * filter match because the topics cannot be checked
+         */
+        if (bloomMatch) {
+            *bloomMatch = DPS_TRUE;
         }
-        if (match) {
+        if ((matchRet == DPS_OK) && DPS_TopicTrieMatched(&node->topicTrie, sub)) {
             DPS_DBGPRINT("Matched subscription\n");
+            if (topicMatch) {
+                *topicMatch = DPS_TRUE;
+            }
             UpdatePubHistory(req);
             DPS_UnlockNode(node);
             sub->handler(sub, pub, data, dataLen);
@@ -654,8 +727,13 @@ DPS_Status DPS_CallPubHandlers(DPS_PublishRequest* req)
     Next:
         DPS_SubscriptionDecRef(sub);
     }
+    if (pub->rxBuf != req->rxBuf) {
+        /*
+         * Release the decrypted payload, handlers may still hold references
+         */
+        DPS_NetRxBufferDecRef(pub->rxBuf);
+    }
     pub->rxBuf = NULL;
-    DPS_TxBufferFree(&plainTextBuf);
     /* Publication topics will be invalid now if the publication was encrypted */
     FreeTopics(pub);
     return ret;
@@ -666,7 +744,8 @@ static DPS_Publication* LookupRetained(DPS_Node* node, DPS_UUID* pubId)
     DPS_Publication* pub = NULL;
 
     for (pub = node->publications; pub != NULL; pub = pub->next) {
-        if ((pub->flags & PUB_FLAG_RETAINED) && (DPS_UUIDCompare(&pub->pubId, pubId) == 0)) {
+        if ((pub->flags & PUB_FLAG_RETAINED) && !(pub->flags & PUB_FLAG_RESENT) &&
+            (DPS_UUIDCompare(&pub->pubId, pubId) == 0)) {
             break;
         }
     }
@@ -678,37 +757,50 @@ static DPS_Publication* LookupPublication(DPS_Node* node, DPS_UUID* pubId)
     DPS_Publication* pub = NULL;
 
     for (pub = node->publications; pub != NULL; pub = pub->next) {
-        if (((pub->flags & PUB_FLAG_LOCAL) == 0) && (DPS_UUIDCompare(&pub->pubId, pubId) == 0)) {
+        if (((pub->flags & (PUB_FLAG_LOCAL | PUB_FLAG_RESENT)) == 0) &&
+            (DPS_UUIDCompare(&pub->pubId, pubId) == 0)) {
             break;
         }
     }
     return pub;
 }
 
+/*
+ * A publication that matched the Bloom filter of a subscription but none
+ * of the subscription topics is a false positive
+ */
+static void CountBloomMatch(DPS_BloomStats* stats, int bloomMatch, int topicMatch)
+{
+    ++stats->pubsReceived;
+    if (bloomMatch) {
+        ++stats->bloomMatches;
+        if (!topicMatch) {
+            ++stats->falsePositives;
+        }
+    }
+}
+
 DPS_Status DPS_DecodePublication(DPS_Node* node, DPS_NetEndpoint* ep, DPS_NetRxBuffer* buf, int multicast)
 {
-    static const int32_t UnprotectedKeys[] = { DPS_CBOR_KEY_TTL };
-    static const int32_t UnprotectedOptKeys[] = { DPS_CBOR_KEY_PORT, DPS_CBOR_KEY_PATH };
-    static const int32_t ProtectedKeys[] = { DPS_CBOR_KEY_TTL, DPS_CBOR_KEY_PUB_ID, DPS_CBOR_KEY_SEQ_NUM,
-                                             DPS_CBOR_KEY_ACK_REQ, DPS_CBOR_KEY_BLOOM_FILTER };
     DPS_RxBuffer* rxBuf = (DPS_RxBuffer*)buf;
     DPS_Status ret;
     RemoteNode* pubNode = NULL;
-    uint16_t port = 0;
     DPS_Publication* pub = NULL;
     DPS_PublishRequest* req = NULL;
     DPS_UUID pubId;
     DPS_RxBuffer bfBuf;
     uint8_t* protectedPtr;
-    CBOR_MapState mapState;
+    PubUnprotected hdr;
+    PubProtected prot;
+    int bloomMatch;
+    int topicMatch;
     uint32_t sequenceNum;
     int16_t ttl;
-    int16_t baseTTL;
     int ackRequested;
-    size_t len;
-    char* path = NULL;
-    size_t pathLen;
-    uint16_t keysMask;
+    uint32_t found;
+    uint16_t window = 0;
+    int resent = DPS_FALSE;
+    int superseded = DPS_FALSE;
 
     DPS_DBGTRACE();
 
@@ -716,45 +808,24 @@ DPS_Status DPS_DecodePublication(DPS_Node* node, DPS_NetEndpoint* ep, DPS_NetRxB
     /*
      * Parse keys from unprotected map
      */
-    ret = DPS_ParseMapInit(&mapState, rxBuf, UnprotectedKeys, A_SIZEOF(UnprotectedKeys),
-                           UnprotectedOptKeys, A_SIZEOF(UnprotectedOptKeys));
-    if (ret != DPS_OK) {
-        return ret;
-    }
-    keysMask = 0;
-    while (!DPS_ParseMapDone(&mapState)) {
-        int32_t key;
-        ret = DPS_ParseMapNext(&mapState, &key);
-        if (ret != DPS_OK) {
-            break;
-        }
-        switch (key) {
-        case DPS_CBOR_KEY_PORT:
-            keysMask |= (1 << key);
-            ret = CBOR_DecodeUint16(rxBuf, &port);
-            break;
-        case DPS_CBOR_KEY_TTL:
-            ret = CBOR_DecodeInt16(rxBuf, &ttl);
-            break;
-        case DPS_CBOR_KEY_PATH:
-            keysMask |= (1 << key);
-            ret = CBOR_DecodeString(rxBuf, &path, &pathLen);
-            if ((ret == DPS_OK) && (pathLen >= DPS_NODE_ADDRESS_PATH_MAX)) {
-                ret = DPS_ERR_INVALID;
-            }
-            break;
-        }
-        if (ret != DPS_OK) {
-            break;
-        }
-    }
+    ret = DPS_ParseMapFields(rxBuf, PubUnprotectedFields, A_SIZEOF(PubUnprotectedFields), &hdr, &found);
     if (ret != DPS_OK) {
         return ret;
     }
-    if ((keysMask & ((1 << DPS_CBOR_KEY_PORT) | (1 << DPS_CBOR_KEY_PATH))) == 0) {
+    if ((found & ((1 << PUB_PORT) | (1 << PUB_PATH))) == 0) {
         DPS_WARNPRINT("Missing required key\n");
         return DPS_ERR_INVALID;
     }
+    if ((found & (1 << PUB_PATH)) && (hdr.path.len >= DPS_NODE_ADDRESS_PATH_MAX)) {
+        return DPS_ERR_INVALID;
+    }
+    if (found & (1 << PUB_WINDOW)) {
+        window = hdr.window;
+        if (window > DPS_RELIABLE_WINDOW_MAX) {
+            return DPS_ERR_INVALID;
+        }
+    }
+    ttl = hdr.ttl;
     /*
      * Start of publication protected map
      */
@@ -762,72 +833,69 @@ DPS_Status DPS_DecodePublication(DPS_Node* node, DPS_NetEndpoint* ep, DPS_NetRxB
     /*
      * Parse keys from protected map
      */
-    ret = DPS_ParseMapInit(&mapState, rxBuf, ProtectedKeys, A_SIZEOF(ProtectedKeys), NULL, 0);
+    ret = DPS_ParseMapFields(rxBuf, PubProtectedFields, A_SIZEOF(PubProtectedFields), &prot, NULL);
     if (ret != DPS_OK) {
         return ret;
     }
     /*
-     * Parse out the protected fields
+     * Validate the current TTL against the base TTL
      */
-    while (!DPS_ParseMapDone(&mapState)) {
-        int32_t key;
-        ret = DPS_ParseMapNext(&mapState, &key);
-        if (ret != DPS_OK) {
-            break;
-        }
-        switch (key) {
-        case DPS_CBOR_KEY_TTL:
-            ret = CBOR_DecodeInt16(rxBuf, &baseTTL);
-            /*
-             * Validate the current TTL against the base TTL
-             */
-            if (ret == DPS_OK) {
-                if (((baseTTL < 0) && (ttl >= 0)) || (ttl > baseTTL)) {
-                    DPS_ERRPRINT("TTL inconsistency - ttl=%d, baseTTL=%d\n", ttl, baseTTL);
-                    ret = DPS_ERR_INVALID;
-                }
-            }
-            break;
-        case DPS_CBOR_KEY_PUB_ID:
-            ret = CBOR_DecodeUUID(rxBuf, &pubId);
-            break;
-        case DPS_CBOR_KEY_SEQ_NUM:
-            ret = CBOR_DecodeUint32(rxBuf, &sequenceNum);
-            if ((ret == DPS_OK) && (sequenceNum == 0)) {
-                ret = DPS_ERR_INVALID;
-            }
-            break;
-        case DPS_CBOR_KEY_ACK_REQ:
-            ret = CBOR_DecodeBoolean(rxBuf, &ackRequested);
-            break;
-        case DPS_CBOR_KEY_BLOOM_FILTER:
-            /*
-             * Skip the bloom filter for now
-             */
-            ret = CBOR_Skip(rxBuf, NULL, &len);
-            if (ret == DPS_OK) {
-                DPS_RxBufferInit(&bfBuf, rxBuf->rxPos - len, len);
-            }
-            break;
-        }
-        if (ret != DPS_OK) {
-            break;
-        }
+    if (((prot.ttl < 0) && (ttl >= 0)) || (ttl > prot.ttl)) {
+        DPS_ERRPRINT("TTL inconsistency - ttl=%d, baseTTL=%d\n", ttl, prot.ttl);
+        return DPS_ERR_INVALID;
     }
-    if (ret != DPS_OK) {
-        return ret;
+    if (prot.sequenceNum == 0) {
+        return DPS_ERR_INVALID;
     }
+    pubId = prot.pubId;
+    sequenceNum = prot.sequenceNum;
+    ackRequested = prot.ackRequested;
+    DPS_RxBufferInit(&bfBuf, prot.bf.data, prot.bf.len);
     /*
      * Record which port the sender is listening on
      */
-    if (keysMask & (1 << DPS_CBOR_KEY_PORT)) {
-        DPS_EndpointSetPort(ep, port);
+    if (found & (1 << PUB_PORT)) {
+        DPS_EndpointSetPort(ep, hdr.port);
     } else {
-        assert(keysMask & (1 << DPS_CBOR_KEY_PATH));
-        DPS_EndpointSetPath(ep, path, pathLen);
+        DPS_EndpointSetPath(ep, (char*)hdr.path.data, hdr.path.len);
     }
 
     DPS_LockNode(node);
+    /*
+     * Track the window of a reliable publication received from this
+     * hop. A retransmission filling a gap in the window is older than
+     * the latest publication so is not stale.
+     */
+    if (window && !multicast) {
+        switch (DPS_ReliableReceived(node, ep, &pubId, sequenceNum, window)) {
+        case DPS_RELIABLE_DUPLICATE:
+            DPS_DBGPRINT("Publication %s/%d is a duplicate\n", DPS_UUIDToString(&pubId), sequenceNum);
+            ret = DPS_ERR_STALE;
+            goto Exit;
+        case DPS_RELIABLE_RESENT:
+            resent = DPS_TRUE;
+            break;
+        default:
+            break;
+        }
+    }
+    /*
+     * A retransmission of a revision older than one this node already
+     * holds must not roll back the newer revision. It is delivered and
+     * forwarded using a publication of its own that is never retained.
+     */
+    if (resent) {
+        pub = LookupRetained(node, &pubId);
+        if (!pub) {
+            pub = LookupPublication(node, &pubId);
+        }
+        if (pub && (sequenceNum < pub->sequenceNum)) {
+            DPS_DBGPRINT("Publication %s/%d is superseded by /%d\n", DPS_UUIDToString(&pubId), sequenceNum,
+                         pub->sequenceNum);
+            superseded = DPS_TRUE;
+        }
+        pub = NULL;
+    }
     /*
      * Lookup an existing retained publication or create a new one.
      *
@@ -835,7 +903,7 @@ DPS_Status DPS_DecodePublication(DPS_Node* node, DPS_NetEndpoint* ep, DPS_NetRxB
      * it: the node lock will get released when we issue callbacks
      * into the application for crypto or subscription handlers below.
      */
-    pub = LookupRetained(node, &pubId);
+    pub = superseded ? NULL : LookupRetained(node, &pubId);
     if (pub) {
         /*
          * Retained publications can only be updated with newer revisions
@@ -872,12 +940,12 @@ DPS_Status DPS_DecodePublication(DPS_Node* node, DPS_NetEndpoint* ep, DPS_NetRxB
          * A stale publication is a publication that has the same or older sequence number than the
          * latest publication with the same pubId.
          */
-        if (DPS_PublicationIsStale(&node->history, &pubId, sequenceNum)) {
+        if (!resent && DPS_PublicationIsStale(&node->history, &pubId, sequenceNum)) {
             DPS_DBGPRINT("Publication %s/%d is stale\n", DPS_UUIDToString(&pubId), sequenceNum);
             ret = DPS_ERR_STALE;
             goto Exit;
         }
-        pub = LookupPublication(node, &pubId);
+        pub = superseded ? NULL : LookupPublication(node, &pubId);
         if (pub) {
             DPS_PublicationIncRef(pub);
         } else {
@@ -896,6 +964,10 @@ DPS_Status DPS_DecodePublication(DPS_Node* node, DPS_NetEndpoint* ep, DPS_NetRxB
                 goto Exit;
             }
             memcpy_s(&pub->pubId, sizeof(pub->pubId), &pubId, sizeof(DPS_UUID));
+            if (superseded) {
+                pub->flags |= PUB_FLAG_RESENT;
+                ttl = 0;
+            }
             /*
              * Link in the pub
              */
@@ -906,6 +978,7 @@ DPS_Status DPS_DecodePublication(DPS_Node* node, DPS_NetEndpoint* ep, DPS_NetRxB
     pub->sequenceNum = sequenceNum;
     pub->ackRequested = ackRequested;
     pub->senderAddr = ep->addr;
+    pub->window = window;
     /*
      * The topics array has pointers into pub->encryptedBuf which are now invalid
      */
@@ -964,16 +1037,22 @@ DPS_Status DPS_DecodePublication(DPS_Node* node, DPS_NetEndpoint* ep, DPS_NetRxB
         ttl = 0;
     }
     /*
-     * Now we can deserialize the bloom filter
+     * Now we can deserialize the bloom filter. The publication is
+     * indexed again when it is retained.
      */
+    DPS_RetainedIndexRemove(&node->retained, pub);
     ret = DPS_BitVectorDeserialize(pub->bf, &bfBuf);
     if (ret != DPS_OK) {
         goto Exit;
     }
-    ret = DPS_CallPubHandlers(req);
+    ret = DPS_CallPubHandlers(req, &bloomMatch, &topicMatch);
     if (ret != DPS_OK) {
         goto Exit;
     }
+    CountBloomMatch(&node->bloomStats, bloomMatch, topicMatch);
+    if (pubNode) {
+        CountBloomMatch(&pubNode->bloomStats, bloomMatch, topicMatch);
+    }
     req->ttl = ttl;
     req->expires = uv_now(node->loop) + DPS_SECS_TO_MS(ttl);
     UpdatePubHistory(req);
@@ -1010,6 +1089,139 @@ Exit:
     return ret;
 }
 
+/*
+ * Maximum number of free header buffers kept by a node
+ */
+#define PUB_HEADER_POOL_MAX  64
+
+#ifdef DPS_DEBUG
+int _DPS_NumPubHeaders = 0;
+int _DPS_NumPubHeaderAllocs = 0;
+#endif
+
+/*
+ * The message header and unprotected map only depend on the listen
+ * address the remote node reaches us on and the TTL and window of
+ * the publication, so they are encoded once per listen address into
+ * a template with fixed width TTL and window fields.
+ */
+static DPS_PubHeaderTemplate* GetPubHeaderTemplate(DPS_Node* node, const DPS_NodeAddress* listenAddr,
+                                                   int reliable)
+{
+    DPS_PubHeaders* headers = &node->pubHeaders;
+    DPS_PubHeaderTemplate* tmpl;
+    uint8_t* pos[A_SIZEOF(PubUnprotectedFields)];
+    PubUnprotected hdr;
+    uint32_t present;
+    DPS_TxBuffer buf;
+    DPS_Status ret;
+    size_t i;
+
+    for (i = 0; i < headers->numTemplates; ++i) {
+        tmpl = &headers->templates[i];
+        if ((tmpl->addr == listenAddr) && (tmpl->reliable == reliable)) {
+            return tmpl;
+        }
+    }
+    if (headers->numTemplates == A_SIZEOF(headers->templates)) {
+        DPS_ERRPRINT("No room for publication header template\n");
+        return NULL;
+    }
+    memset(&hdr, 0, sizeof(hdr));
+    present = (1 << PUB_TTL);
+    switch (listenAddr->type) {
+    case DPS_DTLS:
+    case DPS_TCP:
+    case DPS_UDP:
+        hdr.port = DPS_NetAddrPort((const struct sockaddr*)&listenAddr->u.inaddr);
+        present |= (1 << PUB_PORT);
+        break;
+    case DPS_PIPE:
+    case DPS_SHM:
+        hdr.path.data = (uint8_t*)listenAddr->u.path;
+        hdr.path.len = strnlen_s(listenAddr->u.path, DPS_NODE_ADDRESS_PATH_MAX);
+        present |= (1 << PUB_PATH);
+        break;
+    default:
+        return NULL;
+    }
+    if (reliable) {
+        present |= (1 << PUB_WINDOW);
+    }
+    tmpl = &headers->templates[headers->numTemplates];
+    DPS_TxBufferInit(&buf, tmpl->buf, sizeof(tmpl->buf));
+    ret = CBOR_EncodeArray(&buf, 5);
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint8(&buf, DPS_MSG_VERSION);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint8(&buf, DPS_MSG_TYPE_PUB);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeMapFields(&buf, PubUnprotectedFields, A_SIZEOF(PubUnprotectedFields), &hdr, present, pos);
+    }
+    if (ret != DPS_OK) {
+        return NULL;
+    }
+    tmpl->addr = listenAddr;
+    tmpl->reliable = (uint8_t)reliable;
+    tmpl->len = DPS_TxBufferUsed(&buf);
+    tmpl->ttlOffset = pos[PUB_TTL] - tmpl->buf;
+    tmpl->windowOffset = reliable ? (size_t)(pos[PUB_WINDOW] - tmpl->buf) : 0;
+    ++headers->numTemplates;
+    return tmpl;
+}
+
+static uint8_t* AllocPubHeader(DPS_Node* node)
+{
+    DPS_PubHeaders* headers = &node->pubHeaders;
+    uint8_t* hdr;
+
+#ifdef DPS_DEBUG
+    ++_DPS_NumPubHeaders;
+#endif
+    if (headers->pool) {
+        hdr = headers->pool;
+        headers->pool = *(void**)hdr;
+        --headers->poolSize;
+    } else {
+        hdr = malloc(DPS_PUB_HEADER_MAX);
+#ifdef DPS_DEBUG
+        ++_DPS_NumPubHeaderAllocs;
+#endif
+    }
+    return hdr;
+}
+
+static void FreePubHeader(DPS_Node* node, uint8_t* hdr)
+{
+    DPS_PubHeaders* headers = &node->pubHeaders;
+
+    if (!hdr) {
+        return;
+    }
+    if (headers->poolSize < PUB_HEADER_POOL_MAX) {
+        *(void**)hdr = headers->pool;
+        headers->pool = hdr;
+        ++headers->poolSize;
+    } else {
+        free(hdr);
+    }
+}
+
+void DPS_FreePubHeaders(DPS_Node* node)
+{
+    DPS_PubHeaders* headers = &node->pubHeaders;
+
+    while (headers->pool) {
+        void* next = *(void**)headers->pool;
+        free(headers->pool);
+        headers->pool = next;
+    }
+    headers->poolSize = 0;
+    headers->numTemplates = 0;
+}
+
 static void SendComplete(DPS_PublishRequest* req, DPS_NetEndpoint* ep, uv_buf_t* bufs, size_t numBufs,
                          DPS_Status status)
 {
@@ -1024,13 +1236,13 @@ static void SendComplete(DPS_PublishRequest* req, DPS_NetEndpoint* ep, uv_buf_t*
     if (req->status != DPS_OK) {
         req->status = status;
     }
+    DPS_SendComplete(node, ep ? &ep->addr : NULL, NULL, 0, status);
     /*
      * Only the first buffer belongs to us
      */
     if (numBufs > 0) {
-        numBufs = 1;
+        FreePubHeader(node, (uint8_t*)bufs[0].base);
     }
-    DPS_SendComplete(node, ep ? &ep->addr : NULL, bufs, numBufs, status);
 }
 
 static void OnNetSendComplete(DPS_Node* node, void* appCtx, DPS_NetEndpoint* ep, uv_buf_t* bufs,
@@ -1063,10 +1275,13 @@ static void OnMulticastSendComplete(DPS_MulticastSender* sender, void* appCtx, u
 DPS_Status DPS_SendPublication(DPS_PublishRequest* req, DPS_Publication* pub, RemoteNode* remote)
 {
     DPS_Node* node = pub->node;
+    const DPS_NodeAddress* listenAddr;
+    DPS_PubHeaderTemplate* tmpl;
+    uv_buf_t bufs[1 + NUM_INTERNAL_PUB_BUFS + DPS_BUFS_MAX];
     DPS_Status ret;
-    DPS_TxBuffer buf;
-    size_t len;
+    uint8_t* hdr;
     int16_t ttl = 0;
+    uint16_t window = 0;
     size_t i;
 
     DPS_DBGTRACE();
@@ -1074,6 +1289,20 @@ DPS_Status DPS_SendPublication(DPS_PublishRequest* req, DPS_Publication* pub, Re
     if (!node->netCtx) {
         return DPS_ERR_NETWORK;
     }
+    /*
+     * Tell the remote node where to reach us over the transport used to reach it
+     */
+    if (remote && (remote != DPS_LoopbackNode)) {
+        listenAddr = DPS_ListenAddressFor(node, &remote->ep);
+    } else {
+        listenAddr = DPS_ListenAddressFor(node, NULL);
+    }
+    /*
+     * Only unicast hops acknowledge the window of a reliable publication
+     */
+    if (remote && (remote != DPS_LoopbackNode)) {
+        window = pub->window;
+    }
 
     if (pub->flags & PUB_FLAG_RETAINED) {
         if (pub->flags & PUB_FLAG_EXPIRED) {
@@ -1093,118 +1322,89 @@ DPS_Status DPS_SendPublication(DPS_PublishRequest* req, DPS_Publication* pub, Re
         }
     }
 
-    len = CBOR_SIZEOF_ARRAY(5) +
-        CBOR_SIZEOF(uint8_t) +
-        CBOR_SIZEOF(uint8_t) +
-        CBOR_SIZEOF_MAP(2) + 2 * CBOR_SIZEOF(uint8_t) +
-        CBOR_SIZEOF(int16_t);   /* ttl */
-    switch (node->addr.type) {
-    case DPS_DTLS:
-    case DPS_TCP:
-    case DPS_UDP:
-        len += CBOR_SIZEOF(uint16_t); /* port */
-        break;
-    case DPS_PIPE:
-        len += CBOR_SIZEOF_STRING(node->addr.u.path); /* path */
-        break;
-    default:
+    /*
+     * Copy the header template and patch in the TTL and window
+     */
+    tmpl = GetPubHeaderTemplate(node, listenAddr, window != 0);
+    if (!tmpl) {
         return DPS_ERR_INVALID;
     }
-    ret = DPS_TxBufferInit(&buf, NULL, len);
-    if (ret == DPS_OK) {
-        ret = CBOR_EncodeArray(&buf, 5);
-    }
-    if (ret == DPS_OK) {
-        ret = CBOR_EncodeUint8(&buf, DPS_MSG_VERSION);
+    hdr = AllocPubHeader(node);
+    if (!hdr) {
+        return DPS_ERR_RESOURCES;
     }
-    if (ret == DPS_OK) {
-        ret = CBOR_EncodeUint8(&buf, DPS_MSG_TYPE_PUB);
+    memcpy(hdr, tmpl->buf, tmpl->len);
+    CBOR_PatchInt16(hdr + tmpl->ttlOffset, ttl);
+    if (window) {
+        CBOR_PatchUint16(hdr + tmpl->windowOffset, window);
     }
     /*
-     * Encode the unprotected map
+     * Protected and encrypted maps are already serialized
      */
-    if (ret == DPS_OK) {
-        ret = CBOR_EncodeMap(&buf, 2);
+    bufs[0] = uv_buf_init((char*)hdr, (uint32_t)tmpl->len);
+    for (i = 0; i < req->numBufs; ++i) {
+        bufs[1 + i] = uv_buf_init((char*)req->bufs[i].base, DPS_TxBufferUsed(&req->bufs[i]));
     }
-    switch (node->addr.type) {
-    case DPS_DTLS:
-    case DPS_TCP:
-    case DPS_UDP:
-        if (ret == DPS_OK) {
-            ret = CBOR_EncodeUint8(&buf, DPS_CBOR_KEY_PORT);
+    ++req->refCount;
+    if (remote == DPS_LoopbackNode) {
+        ret = DPS_LoopbackSend(node, bufs, 1 + req->numBufs);
+        SendComplete(req, NULL, bufs, 1 + req->numBufs, ret);
+    } else if (DPS_NeedsFragmenting(remote ? &remote->ep : NULL, bufs, 1 + req->numBufs)) {
+        /*
+         * The fragments are sent from a copy of the message so the
+         * send is complete as far as the request is concerned.
+         */
+        ret = DPS_SendFragments(node, remote ? &remote->ep : NULL, &pub->pubId, req->sequenceNum,
+                                bufs, 1 + req->numBufs);
+        if ((ret == DPS_OK) && remote) {
+            DPS_UpdatePubHistory(&node->history, &pub->pubId, req->sequenceNum,
+                                 pub->ackRequested, REQ_TTL(req), &remote->ep.addr);
+            if (window) {
+                DPS_ReliableSent(node, req, &remote->ep.addr);
+            }
         }
-        if (ret == DPS_OK) {
-            ret = CBOR_EncodeUint16(&buf,
-                                    DPS_NetAddrPort((const struct sockaddr*)&node->addr.u.inaddr));
+        SendComplete(req, NULL, bufs, 1 + req->numBufs, ret);
+        /*
+         * A publication that is too large to fragment is not a
+         * problem with the remote node, and no multicast
+         * interfaces makes this a no-op as for unfragmented sends.
+         */
+        if ((ret == DPS_ERR_OVERFLOW) || (!remote && (ret == DPS_ERR_NO_ROUTE))) {
+            ret = DPS_OK;
         }
-        break;
-    default:
-        break;
-    }
-    if (ret == DPS_OK) {
-        ret = CBOR_EncodeUint8(&buf, DPS_CBOR_KEY_TTL);
-    }
-    if (ret == DPS_OK) {
-        ret = CBOR_EncodeInt16(&buf, ttl);
-    }
-    switch (node->addr.type) {
-    case DPS_PIPE:
+    } else if (remote) {
+        ret = DPS_NetSend(node, req, &remote->ep, bufs, 1 + req->numBufs, OnNetSendComplete);
         if (ret == DPS_OK) {
-            ret = CBOR_EncodeUint8(&buf, DPS_CBOR_KEY_PATH);
+            /*
+             * Prevent the publication from being freed until the send completes.
+             */
+            DPS_PublicationIncRef(pub);
+            /*
+             * Update history to prevent retained publications from being resent.
+             */
+            DPS_UpdatePubHistory(&node->history, &pub->pubId, req->sequenceNum,
+                                 pub->ackRequested, REQ_TTL(req), &remote->ep.addr);
+            if (window) {
+                DPS_ReliableSent(node, req, &remote->ep.addr);
+            }
+        } else {
+            SendComplete(req, &remote->ep, bufs, 1 + req->numBufs, ret);
         }
+    } else {
+        ret = DPS_MulticastSend(node->mcastSender, req, bufs, 1 + req->numBufs, OnMulticastSendComplete);
         if (ret == DPS_OK) {
-            ret = CBOR_EncodeString(&buf, node->addr.u.path);
-        }
-        break;
-    default:
-        break;
-    }
-    /*
-     * Protected and encrypted maps are already serialized
-     */
-    if (ret == DPS_OK) {
-        uv_buf_t bufs[1 + NUM_INTERNAL_PUB_BUFS + DPS_BUFS_MAX];
-        bufs[0] = uv_buf_init((char*)buf.base, DPS_TxBufferUsed(&buf));
-        for (i = 0; i < req->numBufs; ++i) {
-            bufs[1 + i] = uv_buf_init((char*)req->bufs[i].base, DPS_TxBufferUsed(&req->bufs[i]));
-        }
-        ++req->refCount;
-        if (remote == DPS_LoopbackNode) {
-            ret = DPS_LoopbackSend(node, bufs, 1 + req->numBufs);
-            SendComplete(req, NULL, bufs, 1 + req->numBufs, ret);
-        } else if (remote) {
-            ret = DPS_NetSend(node, req, &remote->ep, bufs, 1 + req->numBufs, OnNetSendComplete);
-            if (ret == DPS_OK) {
-                /*
-                 * Prevent the publication from being freed until the send completes.
-                 */
-                DPS_PublicationIncRef(pub);
+            DPS_PublicationIncRef(pub);
+        } else {
+            DPS_WARNPRINT("DPS_MulticastSend failed - %s\n", DPS_ErrTxt(ret));
+            if (ret == DPS_ERR_NO_ROUTE) {
                 /*
-                 * Update history to prevent retained publications from being resent.
+                 * Rewrite the error to make DPS_SendPublication a no-op when
+                 * there are no multicast interfaces available.
                  */
-                DPS_UpdatePubHistory(&node->history, &pub->pubId, req->sequenceNum,
-                                     pub->ackRequested, REQ_TTL(req), &remote->ep.addr);
-            } else {
-                SendComplete(req, &remote->ep, bufs, 1 + req->numBufs, ret);
-            }
-        } else {
-            ret = DPS_MulticastSend(node->mcastSender, req, bufs, 1 + req->numBufs, OnMulticastSendComplete);
-            if (ret == DPS_OK) {
-                DPS_PublicationIncRef(pub);
-            } else {
-                DPS_WARNPRINT("DPS_MulticastSend failed - %s\n", DPS_ErrTxt(ret));
-                if (ret == DPS_ERR_NO_ROUTE) {
-                    /*
-                     * Rewrite the error to make DPS_SendPublication a no-op when
-                     * there are no multicast interfaces available.
-                     */
-                    ret = DPS_OK;
-                }
-                SendComplete(req, NULL, bufs, 1 + req->numBufs, ret);
+                ret = DPS_OK;
             }
+            SendComplete(req, NULL, bufs, 1 + req->numBufs, ret);
         }
-    } else {
-        DPS_TxBufferFree(&buf);
     }
     return ret;
 }
@@ -1265,6 +1465,7 @@ void DPS_ExpirePub(DPS_Node* node, DPS_Publication* pub)
 {
     DPS_DBGPRINT("Expiring %spub %s\n", pub->flags & PUB_FLAG_RETAINED ? "retained " : "",
                  DPS_UUIDToString(&pub->pubId));
+    DPS_RetainedIndexRemove(&node->retained, pub);
     if (pub->flags & PUB_FLAG_LOCAL) {
         pub->flags |= PUB_FLAG_EXPIRED;
     } else {
@@ -1297,7 +1498,13 @@ DPS_Publication* DPS_CreatePublication(DPS_Node* node)
 
 static void DestroyCopy(DPS_Publication* copy)
 {
-    if (copy && copy->refCount == 0) {
+    /*
+     * A copy referenced by a pending acknowledgement is destroyed when
+     * the acknowledgement releases it
+     */
+    if (copy && copy->refCount) {
+        copy->flags |= PUB_FLAG_WAS_FREED;
+    } else if (copy) {
         DPS_ClearKeyId(&copy->ack.sender.kid);
         FreeTopics(copy);
         FreeRecipients(copy);
@@ -1523,6 +1730,22 @@ void DPS_PublicationRemoveSubId(DPS_Publication* pub, const DPS_KeyId* keyId)
     }
 }
 
+DPS_Status DPS_SetPublicationReliable(DPS_Publication* pub, uint16_t window)
+{
+    DPS_DBGTRACE();
+
+    if (window > DPS_RELIABLE_WINDOW_MAX) {
+        return DPS_ERR_ARGS;
+    }
+    if (!IsValidPub(pub) || !(pub->flags & PUB_FLAG_LOCAL)) {
+        return DPS_ERR_MISSING;
+    }
+    DPS_LockNode(pub->node);
+    pub->window = window;
+    DPS_UnlockNode(pub->node);
+    return DPS_OK;
+}
+
 int DPS_PublicationIsEncrypted(const DPS_Publication* pub)
 {
     return pub && pub->recipients;
@@ -1703,6 +1926,16 @@ DPS_Status DPS_PublishBufs(DPS_Publication* pub, const DPS_Buffer* bufs, size_t
      */
     DPS_LockNode(node);
     DPS_PublicationIncRef(pub);
+    /*
+     * Apply backpressure when a hop has not acknowledged enough of the
+     * window of a reliable publication
+     */
+    if (pub->window) {
+        ret = DPS_ReliableCheckWindow(node, pub);
+        if (ret != DPS_OK) {
+            goto Exit;
+        }
+    }
     /*
      * Do some sanity checks for retained publication cancellation
      */
@@ -1852,6 +2085,19 @@ DPS_NetRxBuffer* DPS_PublicationGetNetRxBuffer(const DPS_Publication* pub)
     return NULL;
 }
 
+DPS_NetRxBuffer* DPS_PublicationRetainPayload(const DPS_Publication* pub)
+{
+    DPS_NetRxBuffer* buf = DPS_PublicationGetNetRxBuffer(pub);
+
+    DPS_NetRxBufferIncRef(buf);
+    return buf;
+}
+
+void DPS_ReleasePayload(DPS_NetRxBuffer* buf)
+{
+    DPS_NetRxBufferDecRef(buf);
+}
+
 #ifdef DPS_DEBUG
 void DPS_DumpPubs(DPS_Node* node)
 {
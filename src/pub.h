@@ -40,10 +40,13 @@ extern "C" {
 
 #define NUM_INTERNAL_PUB_BUFS 4 /**< Additional buffers needed for message serialization */
 
+#define PUB_FLAG_RESENT    (0x01) /**< The publication is a retransmission superseded by a newer revision */
 #define PUB_FLAG_LOCAL     (0x02) /**< The publication is local to this node */
 #define PUB_FLAG_RETAINED  (0x04) /**< The publication had a non-zero TTL */
+#define PUB_FLAG_INDEXED   (0x08) /**< The publication is in the retained publication index */
 #define PUB_FLAG_EXPIRED   (0x10) /**< The publication had a negative TTL */
 #define PUB_FLAG_WAS_FREED (0x20) /**< The publication has been freed but has a non-zero ref count */
+#define PUB_FLAG_UNINDEXED (0x40) /**< The publication could not be added to the retained publication index */
 #define PUB_FLAG_IS_COPY   (0x80) /**< This publication is a copy and can only be used for acknowledgements */
 
 typedef struct _DPS_PublishRequest DPS_PublishRequest;
@@ -82,12 +85,14 @@ typedef struct _DPS_Publication {
     } ack;                          /**< For ack messages */
     DPS_Queue sendQueue;            /**< Publication send requests */
     DPS_Queue retainedQueue;        /**< The retained publication send requests */
-    DPS_NetRxBuffer* rxBuf;         /**< For publication or ack handlers - the receive buffer being handled */
+    DPS_NetRxBuffer* rxBuf;         /**< For publication or ack handlers - the buffer holding the received or decrypted payload */
 
     uint8_t flags;                  /**< Internal state flags */
     uint32_t refCount;              /**< Ref count to prevent publication from being free while a send is in progress */
     uint32_t sequenceNum;           /**< Sequence number for this publication */
+    uint32_t retainedGen;           /**< Last generation of the retained index match that visited this publication */
     int16_t ttl;                    /**< Copy of publish request time to live */
+    uint16_t window;                /**< Reliable delivery window, zero if the publication is not reliable */
 
     DPS_Publication* next;          /**< Next publication in list */
 } DPS_Publication;
@@ -98,11 +103,18 @@ typedef struct _DPS_Publication {
 #define REQ_TTL(req)  (int16_t)((req->expires + 999 - uv_now((req->pub->node)->loop)) / 1000)
 
 /**
- * Run checks of the publications against the current subscriptions
+ * Run checks of the retained publications against the changed
+ * interests of a remote node and send any that now match to the
+ * remote node.
  *
- * @param node       The local node
+ * @param node          The local node
+ * @param remote        The remote node whose interests have changed
+ * @param added         The bits that were added to the interests of the remote node
+ * @param needsRelaxed  DPS_TRUE if bits were removed from the needs of the remote node
+ *
+ * @return DPS_OK or an error if sending to the remote node failed
  */
-void DPS_UpdatePubs(DPS_Node* node);
+DPS_Status DPS_UpdatePubs(DPS_Node* node, RemoteNode* remote, const DPS_BitVector* added, int needsRelaxed);
 
 /**
  * Decode and process a received publication
@@ -219,6 +231,13 @@ void DPS_ExpirePub(DPS_Node* node, DPS_Publication* pub);
  */
 void DPS_FreePublications(DPS_Node* node);
 
+/**
+ * Free the publication header templates and buffers of node
+ *
+ * @param node The node
+ */
+void DPS_FreePubHeaders(DPS_Node* node);
+
 /**
  * Increase a publication's refcount to prevent it from being freed
  * from inside a callback function
@@ -238,11 +257,15 @@ void DPS_PublicationDecRef(DPS_Publication* pub);
 /**
  * Check if there is a local subscription for this publication
  *
- * @param req The publish request
+ * @param req         The publish request
+ * @param bloomMatch  Optionally returns DPS_TRUE if the publication matched the
+ *                    Bloom filter of a subscription
+ * @param topicMatch  Optionally returns DPS_TRUE if the publication matched the
+ *                    topics of a subscription
  *
  * @return DPS_OK or an error
  */
-DPS_Status DPS_CallPubHandlers(DPS_PublishRequest* req);
+DPS_Status DPS_CallPubHandlers(DPS_PublishRequest* req, int* bloomMatch, int* topicMatch);
 
 /**
  * Print publications of node
@@ -91,6 +91,7 @@ static int IsLocalAddr(const DPS_NodeAddress* addr, const DPS_NodeAddress* local
         }
         break;
     case DPS_PIPE:
+    case DPS_SHM:
         local = !strcmp(addr->u.path, localAddr->u.path);
         break;
     default:
@@ -142,6 +143,7 @@ static int IsLocalAddrText(const char* addrText, const DPS_NodeAddress* localAdd
         }
         break;
     case DPS_PIPE:
+    case DPS_SHM:
         local = !strcmp(addrText, localAddr->u.path);
         break;
     default:
@@ -335,6 +337,7 @@ static DPS_Status BuildPutPayload(DPS_TxBuffer* payload, const DPS_NodeAddress*
         }
         break;
     case DPS_PIPE:
+    case DPS_SHM:
         ret = DPS_TxBufferInit(payload, NULL, CBOR_SIZEOF_UINT(1) + DPS_NODE_ADDRESS_MAX_STRING_LEN);
         if (ret != DPS_OK) {
             goto Exit;
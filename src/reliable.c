@@ -0,0 +1,807 @@
+/*
+ *******************************************************************
+ *
+ * Copyright 2016 Intel Corporation All rights reserved.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ */
+
+
+#include <assert.h>
+#include <inttypes.h>
+#include <safe_lib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dps/dbg.h>
+#include <dps/dps.h>
+#include <dps/private/cbor.h>
+#include <dps/private/dps.h>
+#include <dps/private/network.h>
+#include "node.h"
+#include "pub.h"
+#include "reliable.h"
+
+/*
+ * Debug control for this module
+ */
+DPS_DEBUG_CONTROL(DPS_DEBUG_ON);
+
+/*
+ * All times are in milliseconds
+ */
+#define TIMER_INTERVAL          20    /* Interval for sending deferred acknowledgements and probing */
+#define ACK_DELAY               20    /* Maximum time the acknowledgement of a window is deferred */
+#define NAK_DELAY               100   /* Time before requesting missing publications again */
+#define MAX_NAKS                3     /* Maximum requests for missing publications without progress */
+#define PROBE_DELAY             200   /* Time without an acknowledgement before probing the hop */
+#define MAX_PROBES              4     /* Hops that do not respond to this many probes are dropped */
+#define RETAIN_TIME             5000  /* Time sent publications are kept after the last one was sent */
+#define RX_TIMEOUT              10000 /* Receive windows are dropped after this long without receiving */
+
+#ifdef DPS_DEBUG
+/*
+ * Drops every Nth new reliable publication received, used for testing
+ * retransmission
+ */
+int _DPS_ReliableDropRate = 0;
+static uint32_t ReceivedCount = 0;
+#endif
+
+typedef struct _DPS_ReliablePeer {
+    DPS_NodeAddress addr;
+    uint32_t acked;           /* Sequence number up to which the hop has received everything */
+    uint8_t probes;
+    uint64_t probeTime;       /* When to probe the hop, 0 if everything sent has been acknowledged */
+    struct _DPS_ReliablePeer* next;
+} DPS_ReliablePeer;
+
+struct _DPS_ReliableTx {
+    DPS_UUID pubId;
+    uint16_t window;
+    uint32_t sequenceNum;     /* Highest sequence number sent */
+    uint64_t expires;
+    DPS_ReliablePeer* peers;  /* Hops the publication is being sent to */
+    DPS_ReliableTx* next;
+    DPS_PublishRequest* reqs[1]; /* Sent requests indexed by sequence number modulo the window */
+};
+
+struct _DPS_ReliableRx {
+    DPS_NodeAddress addr;     /* Address the publications are received from */
+    DPS_NetEndpoint ep;       /* Endpoint for sending acknowledgements */
+    DPS_UUID pubId;
+    uint16_t window;
+    uint32_t first;           /* First sequence number received */
+    uint32_t sequenceNum;     /* Highest sequence number received */
+    uint64_t missing;         /* Bit i is set if sequenceNum - 1 - i has not been received */
+    uint16_t unacked;         /* Publications received since the window was last acknowledged */
+    uint8_t naks;
+    uint64_t ackTime;         /* When to acknowledge the window, 0 if there is nothing to acknowledge */
+    uint64_t expires;
+    DPS_ReliableRx* next;
+};
+
+#define BITMAP_LEN(n)     ((size_t)(((n) + 7) / 8))
+
+static uint64_t WindowMask(uint16_t window)
+{
+    return (window >= 64) ? UINT64_MAX : ((1ull << window) - 1);
+}
+
+static void OnTimer(uv_timer_t* timer);
+
+static void StartTimer(DPS_Node* node)
+{
+    if (!uv_is_active((uv_handle_t*)&node->reliable.timer)) {
+        uv_timer_start(&node->reliable.timer, OnTimer, TIMER_INTERVAL, TIMER_INTERVAL);
+    }
+}
+
+/*
+ * Sending
+ */
+
+static void ReleaseRequest(DPS_PublishRequest* req)
+{
+    DPS_Publication* pub = req->pub;
+
+    assert(req->refCount > 0);
+    --req->refCount;
+    DPS_PublishCompletion(req);
+    DPS_PublicationDecRef(pub);
+}
+
+static void FreeTx(DPS_ReliableTx* tx)
+{
+    uint16_t i;
+
+    for (i = 0; i < tx->window; ++i) {
+        if (tx->reqs[i]) {
+            ReleaseRequest(tx->reqs[i]);
+        }
+    }
+    while (tx->peers) {
+        DPS_ReliablePeer* peer = tx->peers;
+        tx->peers = peer->next;
+        free(peer);
+    }
+    free(tx);
+}
+
+static void RemoveTx(DPS_Node* node, DPS_ReliableTx* tx)
+{
+    DPS_ReliableTx** prev = &node->reliable.tx;
+
+    while (*prev != tx) {
+        prev = &(*prev)->next;
+    }
+    *prev = tx->next;
+    FreeTx(tx);
+}
+
+static DPS_ReliableTx* LookupTx(DPS_Node* node, const DPS_UUID* pubId)
+{
+    DPS_ReliableTx* tx;
+
+    for (tx = node->reliable.tx; tx; tx = tx->next) {
+        if (DPS_UUIDCompare(&tx->pubId, pubId) == 0) {
+            break;
+        }
+    }
+    return tx;
+}
+
+static DPS_ReliableTx* GetTx(DPS_Node* node, const DPS_Publication* pub)
+{
+    DPS_ReliableTx* tx = LookupTx(node, &pub->pubId);
+
+    /*
+     * The sender changed the window so start again
+     */
+    if (tx && (tx->window != pub->window)) {
+        RemoveTx(node, tx);
+        tx = NULL;
+    }
+    if (!tx) {
+        tx = calloc(1, sizeof(DPS_ReliableTx) + (pub->window - 1) * sizeof(DPS_PublishRequest*));
+        if (!tx) {
+            return NULL;
+        }
+        tx->pubId = pub->pubId;
+        tx->window = pub->window;
+        tx->expires = uv_now(node->loop) + RETAIN_TIME;
+        tx->next = node->reliable.tx;
+        node->reliable.tx = tx;
+        StartTimer(node);
+    }
+    return tx;
+}
+
+static DPS_ReliablePeer* LookupPeer(DPS_ReliableTx* tx, const DPS_NodeAddress* addr)
+{
+    DPS_ReliablePeer* peer;
+
+    for (peer = tx->peers; peer; peer = peer->next) {
+        if (DPS_SameAddr(&peer->addr, addr)) {
+            break;
+        }
+    }
+    return peer;
+}
+
+static DPS_ReliablePeer* AddPeer(DPS_ReliableTx* tx, const DPS_NodeAddress* addr, uint32_t acked)
+{
+    DPS_ReliablePeer* peer = calloc(1, sizeof(DPS_ReliablePeer));
+
+    if (peer) {
+        DPS_DBGPRINT("Sending %s reliably to %s\n", DPS_UUIDToString(&tx->pubId), DPS_NodeAddrToString(addr));
+        peer->addr = *addr;
+        peer->acked = acked;
+        peer->next = tx->peers;
+        tx->peers = peer;
+    }
+    return peer;
+}
+
+static void RemovePeer(DPS_ReliableTx* tx, DPS_ReliablePeer* peer)
+{
+    DPS_ReliablePeer** prev = &tx->peers;
+
+    while (*prev != peer) {
+        prev = &(*prev)->next;
+    }
+    *prev = peer->next;
+    free(peer);
+}
+
+static DPS_Status Resend(DPS_ReliableTx* tx, RemoteNode* remote, uint32_t sequenceNum)
+{
+    DPS_PublishRequest* req = tx->reqs[sequenceNum % tx->window];
+
+    if (!req || (req->sequenceNum != sequenceNum)) {
+        DPS_DBGPRINT("Publication %s/%d is no longer available for resending\n", DPS_UUIDToString(&tx->pubId),
+                     sequenceNum);
+        return DPS_ERR_MISSING;
+    }
+    DPS_DBGPRINT("Resending %s/%d to %s\n", DPS_UUIDToString(&tx->pubId), sequenceNum,
+                 DPS_NodeAddrToString(&remote->ep.addr));
+    return DPS_SendPublication(req, req->pub, remote);
+}
+
+DPS_Status DPS_ReliableCheckWindow(DPS_Node* node, const DPS_Publication* pub)
+{
+    DPS_ReliableTx* tx = LookupTx(node, &pub->pubId);
+    DPS_ReliablePeer* peer;
+
+    if (tx) {
+        for (peer = tx->peers; peer; peer = peer->next) {
+            if ((pub->sequenceNum - peer->acked) >= tx->window) {
+                DPS_DBGPRINT("Window of %s is full, %s has acknowledged up to %d\n", DPS_UUIDToString(&pub->pubId),
+                             DPS_NodeAddrToString(&peer->addr), peer->acked);
+                return DPS_ERR_BUSY;
+            }
+        }
+    }
+    return DPS_OK;
+}
+
+void DPS_ReliableSent(DPS_Node* node, DPS_PublishRequest* req, const DPS_NodeAddress* addr)
+{
+    DPS_ReliableTx* tx = GetTx(node, req->pub);
+    DPS_ReliablePeer* peer;
+
+    if (!tx) {
+        return;
+    }
+    if (req->sequenceNum > tx->sequenceNum) {
+        tx->sequenceNum = req->sequenceNum;
+    }
+    peer = LookupPeer(tx, addr);
+    if (!peer) {
+        peer = AddPeer(tx, addr, req->sequenceNum - 1);
+        if (!peer) {
+            return;
+        }
+    }
+    if (!peer->probeTime) {
+        peer->probeTime = uv_now(node->loop) + PROBE_DELAY;
+    }
+}
+
+void DPS_ReliableRetain(DPS_Node* node, DPS_PublishRequest* req)
+{
+    DPS_ReliableTx* tx = LookupTx(node, &req->pub->pubId);
+    DPS_PublishRequest** slot;
+
+    /*
+     * Nothing to do if the publication was not sent to a reliable hop
+     */
+    if (!tx || (tx->window != req->pub->window)) {
+        return;
+    }
+    slot = &tx->reqs[req->sequenceNum % tx->window];
+    if (*slot) {
+        if ((*slot)->sequenceNum >= req->sequenceNum) {
+            return;
+        }
+        ReleaseRequest(*slot);
+    }
+    ++req->refCount;
+    DPS_PublicationIncRef(req->pub);
+    *slot = req;
+    tx->expires = uv_now(node->loop) + RETAIN_TIME;
+}
+
+DPS_Status DPS_DecodeReliableAck(DPS_Node* node, DPS_NetEndpoint* ep, DPS_NetRxBuffer* buf)
+{
+    static const int32_t UnprotectedKeys[] = { DPS_CBOR_KEY_PUB_ID, DPS_CBOR_KEY_SEQ_NUM, DPS_CBOR_KEY_MISSING };
+    static const int32_t UnprotectedOptKeys[] = { DPS_CBOR_KEY_PORT, DPS_CBOR_KEY_PATH };
+    DPS_RxBuffer* rxBuf = (DPS_RxBuffer*)buf;
+    DPS_Status ret;
+    CBOR_MapState mapState;
+    DPS_ReliableTx* tx;
+    DPS_ReliablePeer* peer;
+    RemoteNode* remote;
+    DPS_UUID pubId;
+    uint32_t sequenceNum = 0;
+    uint32_t acked;
+    uint8_t* bitmap = NULL;
+    size_t bitmapLen = 0;
+    uint64_t missing = 0;
+    uint16_t port = 0;
+    char* path = NULL;
+    size_t pathLen = 0;
+    uint32_t keysMask = 0;
+    size_t i;
+
+    DPS_DBGTRACE();
+
+    ret = DPS_ParseMapInit(&mapState, rxBuf, UnprotectedKeys, A_SIZEOF(UnprotectedKeys),
+                           UnprotectedOptKeys, A_SIZEOF(UnprotectedOptKeys));
+    if (ret != DPS_OK) {
+        return ret;
+    }
+    while (!DPS_ParseMapDone(&mapState)) {
+        int32_t key;
+        ret = DPS_ParseMapNext(&mapState, &key);
+        if (ret != DPS_OK) {
+            break;
+        }
+        switch (key) {
+        case DPS_CBOR_KEY_PORT:
+            keysMask |= (1 << key);
+            ret = CBOR_DecodeUint16(rxBuf, &port);
+            break;
+        case DPS_CBOR_KEY_PATH:
+            keysMask |= (1 << key);
+            ret = CBOR_DecodeString(rxBuf, &path, &pathLen);
+            if ((ret == DPS_OK) && (pathLen >= DPS_NODE_ADDRESS_PATH_MAX)) {
+                ret = DPS_ERR_INVALID;
+            }
+            break;
+        case DPS_CBOR_KEY_PUB_ID:
+            ret = CBOR_DecodeUUID(rxBuf, &pubId);
+            break;
+        case DPS_CBOR_KEY_SEQ_NUM:
+            ret = CBOR_DecodeUint32(rxBuf, &sequenceNum);
+            break;
+        case DPS_CBOR_KEY_MISSING:
+            ret = CBOR_DecodeBytes(rxBuf, &bitmap, &bitmapLen);
+            if ((ret == DPS_OK) && (bitmapLen > sizeof(missing))) {
+                ret = DPS_ERR_INVALID;
+            }
+            break;
+        }
+        if (ret != DPS_OK) {
+            break;
+        }
+    }
+    if (ret != DPS_OK) {
+        return ret;
+    }
+    if (keysMask & (1 << DPS_CBOR_KEY_PORT)) {
+        DPS_EndpointSetPort(ep, port);
+    } else if (keysMask & (1 << DPS_CBOR_KEY_PATH)) {
+        DPS_EndpointSetPath(ep, path, pathLen);
+    } else {
+        DPS_WARNPRINT("Missing required key\n");
+        return DPS_ERR_INVALID;
+    }
+    for (i = 0; i < bitmapLen; ++i) {
+        missing |= (uint64_t)bitmap[i] << (i * 8);
+    }
+
+    DPS_LockNode(node);
+    tx = LookupTx(node, &pubId);
+    if (!tx) {
+        DPS_DBGPRINT("Publication %s is no longer being sent reliably\n", DPS_UUIDToString(&pubId));
+        goto Exit;
+    }
+    if (!sequenceNum || (sequenceNum > tx->sequenceNum) || (bitmapLen != BITMAP_LEN(tx->window)) ||
+        (missing & ~WindowMask(tx->window)) || ((sequenceNum <= 64) && (missing >> (sequenceNum - 1)))) {
+        ret = DPS_ERR_INVALID;
+        goto Exit;
+    }
+    /*
+     * The hop has received everything up to the oldest missing
+     * publication
+     */
+    acked = sequenceNum;
+    for (i = tx->window; i > 0; --i) {
+        if (missing & (1ull << (i - 1))) {
+            acked = sequenceNum - i - 1;
+            break;
+        }
+    }
+    peer = LookupPeer(tx, &ep->addr);
+    if (!peer) {
+        peer = AddPeer(tx, &ep->addr, acked);
+        if (!peer) {
+            ret = DPS_ERR_RESOURCES;
+            goto Exit;
+        }
+    }
+    if (acked > peer->acked) {
+        peer->acked = acked;
+    }
+    peer->probes = 0;
+    peer->probeTime = (peer->acked < tx->sequenceNum) ? uv_now(node->loop) + PROBE_DELAY : 0;
+    if (missing) {
+        remote = DPS_LookupRemoteNode(node, &ep->addr);
+        if (!remote) {
+            goto Exit;
+        }
+        for (i = tx->window; i > 0; --i) {
+            if (missing & (1ull << (i - 1))) {
+                ret = Resend(tx, remote, sequenceNum - i);
+                if (ret == DPS_ERR_MISSING) {
+                    ret = DPS_OK;
+                } else if (ret != DPS_OK) {
+                    DPS_ERRPRINT("Failed to resend %s/%d - %s\n", DPS_UUIDToString(&pubId), sequenceNum - i,
+                                 DPS_ErrTxt(ret));
+                    break;
+                }
+            }
+        }
+    }
+Exit:
+    DPS_UnlockNode(node);
+    return ret;
+}
+
+/*
+ * Receiving
+ */
+
+static void FreeRx(DPS_Node* node, DPS_ReliableRx* rx)
+{
+    DPS_ReliableRx** prev = &node->reliable.rx;
+
+    while (*prev != rx) {
+        prev = &(*prev)->next;
+    }
+    *prev = rx->next;
+    free(rx);
+}
+
+static DPS_ReliableRx* LookupRx(DPS_Node* node, const DPS_NodeAddress* addr, const DPS_UUID* pubId)
+{
+    DPS_ReliableRx* rx;
+
+    for (rx = node->reliable.rx; rx; rx = rx->next) {
+        if ((DPS_UUIDCompare(&rx->pubId, pubId) == 0) && DPS_SameAddr(&rx->addr, addr)) {
+            break;
+        }
+    }
+    return rx;
+}
+
+static int IsReceived(const DPS_ReliableRx* rx, uint32_t sequenceNum)
+{
+    uint32_t i;
+
+    if ((sequenceNum < rx->first) || (sequenceNum > rx->sequenceNum)) {
+        return DPS_FALSE;
+    }
+    if (sequenceNum == rx->sequenceNum) {
+        return DPS_TRUE;
+    }
+    i = rx->sequenceNum - 1 - sequenceNum;
+    return (i < 64) && !(rx->missing & (1ull << i));
+}
+
+/*
+ * In a mesh the same publication may arrive over several hops
+ */
+static int IsReceivedFromOtherHop(DPS_Node* node, const DPS_ReliableRx* rx, uint32_t sequenceNum)
+{
+    DPS_ReliableRx* other;
+
+    for (other = node->reliable.rx; other; other = other->next) {
+        if ((other != rx) && (DPS_UUIDCompare(&other->pubId, &rx->pubId) == 0) &&
+            IsReceived(other, sequenceNum)) {
+            return DPS_TRUE;
+        }
+    }
+    return DPS_FALSE;
+}
+
+static DPS_Status SendAck(DPS_Node* node, DPS_ReliableRx* rx)
+{
+    const DPS_NodeAddress* listenAddr = DPS_ListenAddressFor(node, &rx->ep);
+    DPS_Status ret;
+    DPS_TxBuffer buf;
+    uint8_t* bitmap;
+    size_t len;
+    size_t i;
+
+    len = CBOR_SIZEOF_ARRAY(5) +
+        CBOR_SIZEOF(uint8_t) +
+        CBOR_SIZEOF(uint8_t) +
+        CBOR_SIZEOF_MAP(4) + 4 * CBOR_SIZEOF(uint8_t) +
+        CBOR_SIZEOF_BYTES(sizeof(DPS_UUID)) +
+        CBOR_SIZEOF(uint32_t) +
+        CBOR_SIZEOF_BYTES(BITMAP_LEN(rx->window)) +
+        2 * CBOR_SIZEOF_MAP(0);
+    switch (listenAddr->type) {
+    case DPS_DTLS:
+    case DPS_TCP:
+    case DPS_UDP:
+        len += CBOR_SIZEOF(uint16_t);
+        break;
+    case DPS_PIPE:
+    case DPS_SHM:
+        len += CBOR_SIZEOF_STRING(listenAddr->u.path);
+        break;
+    default:
+        return DPS_ERR_INVALID;
+    }
+    ret = DPS_TxBufferInit(&buf, NULL, len);
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeArray(&buf, 5);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint8(&buf, DPS_MSG_VERSION);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint8(&buf, DPS_MSG_TYPE_RACK);
+    }
+    /*
+     * Encode the unprotected map
+     */
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeMap(&buf, 4);
+    }
+    switch (listenAddr->type) {
+    case DPS_DTLS:
+    case DPS_TCP:
+    case DPS_UDP:
+        if (ret == DPS_OK) {
+            ret = CBOR_EncodeUint8(&buf, DPS_CBOR_KEY_PORT);
+        }
+        if (ret == DPS_OK) {
+            ret = CBOR_EncodeUint16(&buf, DPS_NetAddrPort((const struct sockaddr*)&listenAddr->u.inaddr));
+        }
+        break;
+    default:
+        break;
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint8(&buf, DPS_CBOR_KEY_PUB_ID);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUUID(&buf, &rx->pubId);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint8(&buf, DPS_CBOR_KEY_SEQ_NUM);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint32(&buf, rx->sequenceNum);
+    }
+    switch (listenAddr->type) {
+    case DPS_PIPE:
+    case DPS_SHM:
+        if (ret == DPS_OK) {
+            ret = CBOR_EncodeUint8(&buf, DPS_CBOR_KEY_PATH);
+        }
+        if (ret == DPS_OK) {
+            ret = CBOR_EncodeString(&buf, listenAddr->u.path);
+        }
+        break;
+    default:
+        break;
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint8(&buf, DPS_CBOR_KEY_MISSING);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_ReserveBytes(&buf, BITMAP_LEN(rx->window), &bitmap);
+    }
+    if (ret == DPS_OK) {
+        for (i = 0; i < BITMAP_LEN(rx->window); ++i) {
+            bitmap[i] = (uint8_t)(rx->missing >> (i * 8));
+        }
+    }
+    /*
+     * Encode the (empty) protected and encrypted maps
+     */
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeMap(&buf, 0);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeMap(&buf, 0);
+    }
+    if (ret == DPS_OK) {
+        uv_buf_t uvBuf = uv_buf_init((char*)buf.base, DPS_TxBufferUsed(&buf));
+        DPS_DBGPRINT("Acknowledging %s/%d to %s, missing 0x%" PRIx64 "\n", DPS_UUIDToString(&rx->pubId),
+                     rx->sequenceNum, DPS_NodeAddrToString(&rx->ep.addr), rx->missing);
+        ret = DPS_NetSend(node, NULL, &rx->ep, &uvBuf, 1, DPS_OnSendComplete);
+        if (ret != DPS_OK) {
+            DPS_SendComplete(node, &rx->ep.addr, &uvBuf, 1, ret);
+        }
+    } else {
+        DPS_TxBufferFree(&buf);
+    }
+    /*
+     * Keep asking for missing publications until they arrive or we
+     * give up on them
+     */
+    rx->unacked = 0;
+    if (rx->missing) {
+        rx->ackTime = uv_now(node->loop) + (NAK_DELAY << rx->naks);
+        ++rx->naks;
+    } else {
+        rx->ackTime = 0;
+    }
+    return ret;
+}
+
+static void ScheduleAck(DPS_Node* node, DPS_ReliableRx* rx)
+{
+    if (!rx->ackTime) {
+        rx->ackTime = uv_now(node->loop) + ACK_DELAY;
+    }
+}
+
+int DPS_ReliableReceived(DPS_Node* node, DPS_NetEndpoint* ep, const DPS_UUID* pubId, uint32_t sequenceNum,
+                         uint16_t window)
+{
+    DPS_ReliableRx* rx;
+    uint32_t shift;
+    uint32_t i;
+
+    rx = LookupRx(node, &ep->addr, pubId);
+    /*
+     * The sender changed the window so start again
+     */
+    if (rx && (rx->window != window)) {
+        FreeRx(node, rx);
+        rx = NULL;
+    }
+    if (!rx) {
+        rx = calloc(1, sizeof(DPS_ReliableRx));
+        if (!rx) {
+            /*
+             * The publication can still be delivered
+             */
+            return DPS_RELIABLE_NEW;
+        }
+        DPS_DBGPRINT("Receiving %s reliably from %s\n", DPS_UUIDToString(pubId), DPS_NodeAddrToString(&ep->addr));
+        rx->addr = ep->addr;
+        rx->pubId = *pubId;
+        rx->window = window;
+        rx->first = sequenceNum;
+        rx->sequenceNum = sequenceNum;
+        rx->next = node->reliable.rx;
+        node->reliable.rx = rx;
+        rx->ep = *ep;
+        rx->expires = uv_now(node->loop) + RX_TIMEOUT;
+        ScheduleAck(node, rx);
+        StartTimer(node);
+        return DPS_RELIABLE_NEW;
+    }
+    if (sequenceNum > rx->sequenceNum) {
+#ifdef DPS_DEBUG
+        if (_DPS_ReliableDropRate && ((++ReceivedCount % _DPS_ReliableDropRate) == 0)) {
+            DPS_DBGPRINT("Dropping %s/%d\n", DPS_UUIDToString(pubId), sequenceNum);
+            return DPS_RELIABLE_DUPLICATE;
+        }
+#endif
+        rx->ep = *ep;
+        rx->expires = uv_now(node->loop) + RX_TIMEOUT;
+        shift = sequenceNum - rx->sequenceNum;
+        rx->missing = (shift < 64) ? (rx->missing << shift) : 0;
+        if (shift > 1) {
+            rx->missing |= (shift <= 64) ? ((1ull << (shift - 1)) - 1) : UINT64_MAX;
+        }
+        /*
+         * Publications that have fallen out of the window cannot be
+         * resent
+         */
+        if (rx->missing & ~WindowMask(rx->window)) {
+            DPS_WARNPRINT("Lost publications of %s older than /%d\n", DPS_UUIDToString(pubId),
+                          sequenceNum - rx->window);
+            rx->missing &= WindowMask(rx->window);
+        }
+        rx->sequenceNum = sequenceNum;
+        /*
+         * Request missing publications immediately, otherwise
+         * acknowledge the window when it is half full
+         */
+        if (shift > 1) {
+            rx->naks = 0;
+            SendAck(node, rx);
+        } else if (++rx->unacked >= ((rx->window + 1) / 2)) {
+            SendAck(node, rx);
+        } else {
+            ScheduleAck(node, rx);
+        }
+        return DPS_RELIABLE_NEW;
+    }
+    if (sequenceNum < rx->sequenceNum) {
+        i = rx->sequenceNum - 1 - sequenceNum;
+        if ((i < 64) && (rx->missing & (1ull << i))) {
+            DPS_DBGPRINT("Received missing %s/%d\n", DPS_UUIDToString(pubId), sequenceNum);
+            rx->missing &= ~(1ull << i);
+            rx->naks = 0;
+            ScheduleAck(node, rx);
+            if (IsReceivedFromOtherHop(node, rx, sequenceNum)) {
+                return DPS_RELIABLE_DUPLICATE;
+            }
+            return DPS_RELIABLE_RESENT;
+        }
+    }
+    /*
+     * A duplicate means the sender has not seen our acknowledgement
+     */
+    ScheduleAck(node, rx);
+    return DPS_RELIABLE_DUPLICATE;
+}
+
+static void OnTimer(uv_timer_t* timer)
+{
+    DPS_Node* node = (DPS_Node*)timer->data;
+    DPS_ReliableTx* tx;
+    DPS_ReliableTx* txNext;
+    DPS_ReliablePeer* peer;
+    DPS_ReliablePeer* peerNext;
+    DPS_ReliableRx* rx;
+    DPS_ReliableRx* rxNext;
+    RemoteNode* remote;
+    uint64_t now;
+
+    DPS_LockNode(node);
+    now = uv_now(node->loop);
+    for (rx = node->reliable.rx; rx; rx = rxNext) {
+        rxNext = rx->next;
+        if (now >= rx->expires) {
+            FreeRx(node, rx);
+        } else if (rx->ackTime && (now >= rx->ackTime)) {
+            if (rx->naks >= MAX_NAKS) {
+                DPS_WARNPRINT("Giving up on missing publications of %s from %s\n", DPS_UUIDToString(&rx->pubId),
+                              DPS_NodeAddrToString(&rx->addr));
+                rx->missing = 0;
+                rx->naks = 0;
+            }
+            SendAck(node, rx);
+        }
+    }
+    for (tx = node->reliable.tx; tx; tx = txNext) {
+        txNext = tx->next;
+        if (now >= tx->expires) {
+            RemoveTx(node, tx);
+            continue;
+        }
+        for (peer = tx->peers; peer; peer = peerNext) {
+            peerNext = peer->next;
+            if (!peer->probeTime || (now < peer->probeTime)) {
+                continue;
+            }
+            remote = DPS_LookupRemoteNode(node, &peer->addr);
+            if (!remote || (peer->probes >= MAX_PROBES)) {
+                DPS_WARNPRINT("%s is not acknowledging %s\n", DPS_NodeAddrToString(&peer->addr),
+                              DPS_UUIDToString(&tx->pubId));
+                RemovePeer(tx, peer);
+                continue;
+            }
+            /*
+             * Resending the most recent publication tells the hop
+             * what it should have received
+             */
+            Resend(tx, remote, tx->sequenceNum);
+            ++peer->probes;
+            peer->probeTime = now + (PROBE_DELAY << peer->probes);
+        }
+    }
+    if (!node->reliable.tx && !node->reliable.rx) {
+        uv_timer_stop(timer);
+    }
+    DPS_UnlockNode(node);
+}
+
+void DPS_ReliableFree(DPS_Reliable* reliable)
+{
+    while (reliable->tx) {
+        DPS_ReliableTx* tx = reliable->tx;
+        reliable->tx = tx->next;
+        FreeTx(tx);
+    }
+    while (reliable->rx) {
+        DPS_ReliableRx* rx = reliable->rx;
+        reliable->rx = rx->next;
+        free(rx);
+    }
+}
@@ -0,0 +1,148 @@
+/**
+ * @file
+ * Reliable delivery of publications over lossy hops
+ */
+
+/*
+ *******************************************************************
+ *
+ * Copyright 2016 Intel Corporation All rights reserved.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ */
+
+#ifndef _DPS_RELIABLE_H
+#define _DPS_RELIABLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <uv.h>
+#include <dps/dps.h>
+#include <dps/uuid.h>
+#include <dps/private/network.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Maximum number of publications that can be in flight on a reliable
+ * hop. The window is tracked with a 64 bit bitmap.
+ */
+#define DPS_RELIABLE_WINDOW_MAX 64
+
+#if !defined(DOXYGEN_SKIP_FORWARD_DECLARATION)
+struct _DPS_PublishRequest;
+#endif
+
+/*
+ * Values returned by DPS_ReliableReceived()
+ */
+#define DPS_RELIABLE_NEW        0 /**< The publication is newer than any received from the hop */
+#define DPS_RELIABLE_RESENT     1 /**< The publication is a retransmission filling a gap in the window */
+#define DPS_RELIABLE_DUPLICATE  2 /**< The publication has already been received */
+
+/**
+ * Publications kept by the sender of a reliable publication for
+ * retransmission
+ */
+typedef struct _DPS_ReliableTx DPS_ReliableTx;
+
+/**
+ * The window of a reliable publication being received from a hop
+ */
+typedef struct _DPS_ReliableRx DPS_ReliableRx;
+
+/**
+ * Reliable delivery state for a node
+ */
+typedef struct _DPS_Reliable {
+    uv_timer_t timer;              /**< Timer for acknowledging windows and probing for lost publications */
+    DPS_ReliableTx* tx;            /**< Reliable publications being sent */
+    DPS_ReliableRx* rx;            /**< Reliable publications being received */
+} DPS_Reliable;
+
+/**
+ * Check if a local reliable publication can be published again without
+ * overrunning the window of any hop it is being sent to
+ *
+ * @param node  The node
+ * @param pub   The publication
+ *
+ * @return DPS_OK if the publication can be sent, DPS_ERR_BUSY if the
+ *         window is full
+ */
+DPS_Status DPS_ReliableCheckWindow(DPS_Node* node, const DPS_Publication* pub);
+
+/**
+ * Record that a reliable publication has been sent to a hop. The hop
+ * is expected to acknowledge the window.
+ *
+ * @param node  The node
+ * @param req   The publish request that was sent
+ * @param addr  The address of the hop
+ */
+void DPS_ReliableSent(DPS_Node* node, struct _DPS_PublishRequest* req, const DPS_NodeAddress* addr);
+
+/**
+ * Keep a sent publish request so it can be retransmitted. A reference
+ * to the request is held until it falls out of the window.
+ *
+ * @param node  The node
+ * @param req   The publish request
+ */
+void DPS_ReliableRetain(DPS_Node* node, struct _DPS_PublishRequest* req);
+
+/**
+ * Update the window of a reliable publication received from a hop
+ *
+ * @param node         The node
+ * @param ep           The endpoint the publication was received on
+ * @param pubId        The publication ID
+ * @param sequenceNum  The publication sequence number
+ * @param window       The window size requested by the sender
+ *
+ * @return DPS_RELIABLE_NEW, DPS_RELIABLE_RESENT, or DPS_RELIABLE_DUPLICATE
+ */
+int DPS_ReliableReceived(DPS_Node* node, DPS_NetEndpoint* ep, const DPS_UUID* pubId, uint32_t sequenceNum,
+                         uint16_t window);
+
+/**
+ * Decode the acknowledgement of a reliable publication window and
+ * resend any missing publications
+ *
+ * @param node    The node
+ * @param ep      The endpoint the acknowledgement was received on
+ * @param buf     The acknowledgement message, positioned after the message type
+ *
+ * @return DPS_OK if the acknowledgement was decoded
+ */
+DPS_Status DPS_DecodeReliableAck(DPS_Node* node, DPS_NetEndpoint* ep, DPS_NetRxBuffer* buf);
+
+/**
+ * Free resources allocated for reliable delivery, completing any
+ * publish requests being held for retransmission
+ *
+ * @param reliable  The reliable delivery state
+ */
+void DPS_ReliableFree(DPS_Reliable* reliable);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -54,7 +54,7 @@ static void GetAddrInfoCB(uv_getaddrinfo_t* req, int status, struct addrinfo* re
         addr.type = DPS_DTLS;
 #elif defined(DPS_USE_TCP)
         addr.type = DPS_TCP;
-#elif defined(DPS_USE_UDP)
+#elif defined(DPS_USE_UDP) || defined(DPS_USE_SIM)
         addr.type = DPS_UDP;
 #endif
         if (res->ai_family == AF_INET6) {
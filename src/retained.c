@@ -0,0 +1,187 @@
+/*
+ *******************************************************************
+ *
+ * Copyright 2016 Intel Corporation All rights reserved.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ */
+
+#include <assert.h>
+#include <safe_lib.h>
+#include <stdlib.h>
+#include <dps/dbg.h>
+#include "pub.h"
+#include "retained.h"
+
+/*
+ * Debug control for this module
+ */
+DPS_DEBUG_CONTROL(DPS_DEBUG_ON);
+
+#define MIN_BUCKET_CAPACITY  4
+
+static DPS_Status BucketAdd(DPS_RetainedBucket* bucket, DPS_Publication* pub)
+{
+    if (bucket->count == bucket->capacity) {
+        uint32_t capacity = bucket->capacity ? 2 * bucket->capacity : MIN_BUCKET_CAPACITY;
+        DPS_Publication** pubs = realloc(bucket->pubs, capacity * sizeof(DPS_Publication*));
+        if (!pubs) {
+            return DPS_ERR_RESOURCES;
+        }
+        bucket->pubs = pubs;
+        bucket->capacity = capacity;
+    }
+    bucket->pubs[bucket->count++] = pub;
+    return DPS_OK;
+}
+
+static void BucketRemove(DPS_RetainedBucket* bucket, DPS_Publication* pub)
+{
+    uint32_t i;
+
+    for (i = 0; i < bucket->count; ++i) {
+        if (bucket->pubs[i] == pub) {
+            bucket->pubs[i] = bucket->pubs[--bucket->count];
+            return;
+        }
+    }
+}
+
+static void FreeBuckets(DPS_RetainedIndex* index)
+{
+    size_t i;
+
+    if (index->buckets) {
+        for (i = 0; i < index->numBuckets; ++i) {
+            free(index->buckets[i].pubs);
+        }
+        free(index->buckets);
+    }
+    index->buckets = NULL;
+    index->numBuckets = 0;
+    index->count = 0;
+}
+
+static void RemoveBits(DPS_RetainedIndex* index, DPS_Publication* pub, size_t end)
+{
+    size_t bit;
+
+    for (bit = DPS_BitVectorNextBit(pub->bf, 0); bit < end; bit = DPS_BitVectorNextBit(pub->bf, bit + 1)) {
+        BucketRemove(&index->buckets[bit], pub);
+    }
+}
+
+DPS_Status DPS_RetainedIndexAdd(DPS_RetainedIndex* index, DPS_Publication* pub)
+{
+    DPS_Status ret = DPS_OK;
+    size_t len;
+    size_t bit;
+
+    if (pub->flags & PUB_FLAG_INDEXED) {
+        return DPS_OK;
+    }
+    if (pub->flags & PUB_FLAG_UNINDEXED) {
+        pub->flags &= ~PUB_FLAG_UNINDEXED;
+        --index->incomplete;
+    }
+    len = DPS_BitVectorLen(pub->bf);
+    if (!index->buckets) {
+        index->buckets = calloc(len, sizeof(DPS_RetainedBucket));
+        if (!index->buckets) {
+            ret = DPS_ERR_RESOURCES;
+            goto ErrExit;
+        }
+        index->numBuckets = len;
+    }
+    if (len != index->numBuckets) {
+        ret = DPS_ERR_ARGS;
+        goto ErrExit;
+    }
+    for (bit = DPS_BitVectorNextBit(pub->bf, 0); bit < len; bit = DPS_BitVectorNextBit(pub->bf, bit + 1)) {
+        ret = BucketAdd(&index->buckets[bit], pub);
+        if (ret != DPS_OK) {
+            RemoveBits(index, pub, bit);
+            goto ErrExit;
+        }
+    }
+    pub->flags |= PUB_FLAG_INDEXED;
+    ++index->count;
+    return DPS_OK;
+
+ErrExit:
+    DPS_ERRPRINT("Failed to index retained publication: %s\n", DPS_ErrTxt(ret));
+    pub->flags |= PUB_FLAG_UNINDEXED;
+    ++index->incomplete;
+    return ret;
+}
+
+void DPS_RetainedIndexRemove(DPS_RetainedIndex* index, DPS_Publication* pub)
+{
+    if (pub->flags & PUB_FLAG_UNINDEXED) {
+        /*
+         * The index is complete again once the publications that
+         * could not be added have all been removed
+         */
+        pub->flags &= ~PUB_FLAG_UNINDEXED;
+        assert(index->incomplete);
+        --index->incomplete;
+        return;
+    }
+    if (!(pub->flags & PUB_FLAG_INDEXED)) {
+        return;
+    }
+    RemoveBits(index, pub, index->numBuckets);
+    pub->flags &= ~PUB_FLAG_INDEXED;
+    assert(index->count);
+    if (--index->count == 0) {
+        /*
+         * Release the memory when there are no retained publications
+         */
+        FreeBuckets(index);
+    }
+}
+
+DPS_Status DPS_RetainedIndexMatch(DPS_RetainedIndex* index, const DPS_BitVector* bits, DPS_RetainedHandler handler, void* data)
+{
+    size_t bit;
+
+    if (!index->count) {
+        return DPS_OK;
+    }
+    if (DPS_BitVectorLen(bits) != index->numBuckets) {
+        return DPS_ERR_ARGS;
+    }
+    ++index->generation;
+    for (bit = DPS_BitVectorNextBit(bits, 0); bit < index->numBuckets; bit = DPS_BitVectorNextBit(bits, bit + 1)) {
+        DPS_RetainedBucket* bucket = &index->buckets[bit];
+        uint32_t i;
+        for (i = 0; i < bucket->count; ++i) {
+            DPS_Publication* pub = bucket->pubs[i];
+            if (pub->retainedGen != index->generation) {
+                pub->retainedGen = index->generation;
+                handler(pub, data);
+            }
+        }
+    }
+    return DPS_OK;
+}
+
+void DPS_RetainedIndexFree(DPS_RetainedIndex* index)
+{
+    FreeBuckets(index);
+    index->incomplete = 0;
+}
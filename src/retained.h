@@ -0,0 +1,125 @@
+/**
+ * @file
+ * Index of retained publications
+ */
+
+/*
+ *******************************************************************
+ *
+ * Copyright 2016 Intel Corporation All rights reserved.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ */
+
+#ifndef _DPS_RETAINED_H
+#define _DPS_RETAINED_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <dps/dps.h>
+#include <dps/private/dps.h>
+#include "bitvec.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * The retained publications that have a particular bit set in their
+ * Bloom filters
+ */
+typedef struct _DPS_RetainedBucket {
+    DPS_Publication** pubs;     /**< The publications */
+    uint32_t count;             /**< Number of publications in the bucket */
+    uint32_t capacity;          /**< Capacity of the publications array */
+} DPS_RetainedBucket;
+
+/**
+ * Retained publications indexed by the bits set in their Bloom filters.
+ * A publication can only match interests that have bits in common with
+ * it so the index is used to find the retained publications that may
+ * match interests that have been added.
+ */
+typedef struct _DPS_RetainedIndex {
+    DPS_RetainedBucket* buckets; /**< One bucket per bit, allocated when the first publication is added */
+    size_t numBuckets;           /**< Number of buckets */
+    uint32_t count;              /**< Number of publications in the index */
+    uint32_t generation;         /**< Used to visit each publication once in DPS_RetainedIndexMatch() */
+    uint32_t incomplete;         /**< Number of retained publications that could not be added to the index */
+} DPS_RetainedIndex;
+
+/**
+ * Function prototype for a function called for each publication found
+ * by DPS_RetainedIndexMatch(). The function must not add publications
+ * to or remove publications from the index.
+ *
+ * @param pub    A publication that has a bit in common with the bits being matched
+ * @param data   Data passed to DPS_RetainedIndexMatch()
+ */
+typedef void (*DPS_RetainedHandler)(DPS_Publication* pub, void* data);
+
+/**
+ * Add a retained publication to the index. This is a no-op if the
+ * publication is already in the index.
+ *
+ * @param index  The index
+ * @param pub    The retained publication
+ *
+ * @return DPS_OK if the publication was added, DPS_ERR_RESOURCES if
+ *         the index could not be grown. In this case the index is
+ *         marked as incomplete until the publication is added or
+ *         removed, or the index is emptied.
+ */
+DPS_Status DPS_RetainedIndexAdd(DPS_RetainedIndex* index, DPS_Publication* pub);
+
+/**
+ * Remove a publication from the index. This is a no-op if the
+ * publication is not in the index.
+ *
+ * @param index  The index
+ * @param pub    The publication
+ */
+void DPS_RetainedIndexRemove(DPS_RetainedIndex* index, DPS_Publication* pub);
+
+/**
+ * Calls a function for each publication in the index that has at least
+ * one bit in common with a bit vector. The function is called once for
+ * each publication.
+ *
+ * @param index    The index
+ * @param bits     The bits to match
+ * @param handler  The function to call
+ * @param data     Data to pass to the function
+ *
+ * @return
+ * - DPS_OK if the handler was called for every candidate publication
+ * - DPS_ERR_ARGS if the bit vector length does not match the index
+ */
+DPS_Status DPS_RetainedIndexMatch(DPS_RetainedIndex* index, const DPS_BitVector* bits, DPS_RetainedHandler handler, void* data);
+
+/**
+ * Free resources allocated for the index
+ *
+ * @param index  The index
+ */
+void DPS_RetainedIndexFree(DPS_RetainedIndex* index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
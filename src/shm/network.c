@@ -0,0 +1,1032 @@
+/*
+ *******************************************************************
+ *
+ * Copyright 2016 Intel Corporation All rights reserved.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ */
+
+/*
+ * Shared memory transport for nodes on the same host.
+ *
+ * A node listens on a Unix domain socket. A connecting node creates a
+ * shared memory segment holding a ring buffer for each direction and
+ * an eventfd for each side, and passes the file descriptors over the
+ * socket. After that the socket is only used to detect when the peer
+ * goes away; messages are copied directly into and out of the rings.
+ *
+ * Each ring has a single producer and a single consumer. Messages are
+ * written as a native uint32_t length followed by the message bytes,
+ * so a message may be larger than the ring and is streamed through
+ * it. The peer's eventfd is only signaled when the consumer is waiting
+ * for data or the producer is waiting for space, so a busy connection
+ * carries many messages per wakeup.
+ */
+
+#include <safe_lib.h>
+#include <assert.h>
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <dps/dbg.h>
+#include <dps/dps.h>
+#include <dps/uuid.h>
+#include <dps/private/network.h>
+#include "../node.h"
+#include "../queue.h"
+
+/*
+ * Debug control for this module
+ */
+DPS_DEBUG_CONTROL(DPS_DEBUG_ON);
+
+#define RING_SIZE    (256 * 1024) /* Must be a power of two */
+#define CACHE_LINE   64
+#define MAX_MSG_LEN  (64 * 1024 * 1024) /* Largest message that will be sent or received */
+
+typedef struct _Ring {
+    /*
+     * Written by the producer
+     */
+    uint64_t tail;
+    uint32_t producerWaiting;   /* Set by the producer when the ring is full, cleared by the consumer */
+    uint8_t pad0[CACHE_LINE - sizeof(uint64_t) - sizeof(uint32_t)];
+    /*
+     * Written by the consumer
+     */
+    uint64_t head;
+    uint32_t consumerWaiting;   /* Set by the consumer when the ring is empty, cleared by the producer */
+    uint8_t pad1[CACHE_LINE - sizeof(uint64_t) - sizeof(uint32_t)];
+    uint8_t data[RING_SIZE];
+} Ring;
+
+/*
+ * The connecting node produces into ring[0] and consumes from ring[1]
+ */
+typedef struct _Segment {
+    Ring ring[2];
+} Segment;
+
+#define NUM_FDS 3 /* The segment, the accepting node's eventfd, the connecting node's eventfd */
+
+typedef struct _SendRequest {
+    DPS_Queue queue;
+    DPS_NetConnection* cn;
+    DPS_NetSendComplete onSendComplete;
+    void* appCtx;
+    DPS_Status status;
+    size_t numBufs;
+    uint32_t len; /* message length written ahead of the message */
+    uv_buf_t bufs[1];
+} SendRequest;
+
+typedef struct _DPS_NetConnection {
+    const DPS_NetTransport* transport; /* must be first, see DPS_NetTransport */
+    DPS_NetTransportContext* netCtx;
+    DPS_Node* node;
+    DPS_NetEndpoint peerEp;
+    int refCount;
+    int disconnected;   /* I/O has stopped but the upper layer still holds references */
+    int closing;
+    int numHandles;     /* libuv handles to close before freeing the connection */
+    int sock;           /* Closed by the peer when it goes away */
+    int event;          /* Signaled by the peer */
+    int peerEvent;      /* Signaled to wake up the peer */
+    Segment* seg;
+    Ring* rx;
+    Ring* tx;
+    uv_poll_t sockPoll;
+    uv_poll_t eventPoll;
+    uv_idle_t idle;
+    /* Rx side */
+    uint8_t lenBuf[sizeof(uint32_t)];
+    size_t readLen; /* how much of the length has already been read */
+    DPS_NetRxBuffer* msgBuf;
+    /* Tx side */
+    DPS_Queue sendQueue;
+    DPS_Queue sendCompletedQueue;
+    size_t txBuf;    /* Buffer of the request at the front of the queue being written */
+    size_t txOffset; /* Bytes of that buffer already written */
+} DPS_NetConnection;
+
+struct _DPS_NetTransportContext {
+    int sock;           /* the listen socket */
+    uv_poll_t poll;
+    DPS_Node* node;
+    DPS_OnReceive receiveCB;
+    char path[DPS_NODE_ADDRESS_PATH_MAX];
+};
+
+#define LISTEN_BACKLOG  16
+
+static void Disconnect(DPS_NetConnection* cn);
+static void ConnectionIncRef(DPS_NetConnection* cn);
+static void ConnectionDecRef(DPS_NetConnection* cn);
+
+static void Signal(int fd)
+{
+    uint64_t one = 1;
+    if (write(fd, &one, sizeof(one)) < 0) {
+        DPS_DBGPRINT("eventfd write failed %d\n", errno);
+    }
+}
+
+static DPS_Status CopyToRing(Ring* ring, uint64_t pos, const uint8_t* src, size_t len)
+{
+    size_t off = (size_t)(pos & (RING_SIZE - 1));
+    size_t n = RING_SIZE - off;
+
+    if (len > RING_SIZE) {
+        return DPS_ERR_OVERFLOW;
+    }
+    if (n > len) {
+        n = len;
+    }
+    if (memcpy_s(ring->data + off, RING_SIZE - off, src, n) != EOK) {
+        return DPS_ERR_OVERFLOW;
+    }
+    if (n < len) {
+        if (memcpy_s(ring->data, RING_SIZE, src + n, len - n) != EOK) {
+            return DPS_ERR_OVERFLOW;
+        }
+    }
+    return DPS_OK;
+}
+
+static DPS_Status CopyFromRing(const Ring* ring, uint64_t pos, uint8_t* dst, size_t dstLen, size_t len)
+{
+    size_t off = (size_t)(pos & (RING_SIZE - 1));
+    size_t n = RING_SIZE - off;
+
+    if (n > len) {
+        n = len;
+    }
+    if (memcpy_s(dst, dstLen, ring->data + off, n) != EOK) {
+        return DPS_ERR_OVERFLOW;
+    }
+    if (n < len) {
+        if (memcpy_s(dst + n, dstLen - n, ring->data, len - n) != EOK) {
+            return DPS_ERR_OVERFLOW;
+        }
+    }
+    return DPS_OK;
+}
+
+static void SendCompleted(DPS_NetConnection* cn)
+{
+    while (!DPS_QueueEmpty(&cn->sendCompletedQueue)) {
+        SendRequest* req = (SendRequest*)DPS_QueueFront(&cn->sendCompletedQueue);
+        DPS_QueueRemove(&req->queue);
+        req->onSendComplete(cn->node, req->appCtx, &cn->peerEp, req->bufs, req->numBufs, req->status);
+        free(req);
+        /*
+         * Each request holds a reference until it completes
+         */
+        ConnectionDecRef(cn);
+    }
+}
+
+static void SendCompletedTask(uv_idle_t* idle)
+{
+    DPS_NetConnection* cn = idle->data;
+    uv_idle_stop(idle);
+    SendCompleted(cn);
+}
+
+static void CancelPendingSends(DPS_NetConnection* cn)
+{
+    while (!DPS_QueueEmpty(&cn->sendQueue)) {
+        SendRequest* req = (SendRequest*)DPS_QueueFront(&cn->sendQueue);
+        DPS_QueueRemove(&req->queue);
+        DPS_DBGPRINT("Canceling SendRequest=%p\n", req);
+        req->status = DPS_ERR_NETWORK;
+        DPS_QueuePushBack(&cn->sendCompletedQueue, &req->queue);
+    }
+    cn->txBuf = 0;
+    cn->txOffset = 0;
+}
+
+static void DoSend(DPS_NetConnection* cn)
+{
+    Ring* tx = cn->tx;
+    uint64_t tail;
+    uint64_t head;
+    int wrote = DPS_FALSE;
+
+    if (!tx || cn->disconnected) {
+        return;
+    }
+    tail = tx->tail;
+    for (;;) {
+        size_t space;
+
+        head = __atomic_load_n(&tx->head, __ATOMIC_ACQUIRE);
+        if ((tail - head) > RING_SIZE) {
+            /*
+             * The peer wrote an impossible head, the ring cannot be
+             * trusted so give up on the connection
+             */
+            DPS_ERRPRINT("Send ring is corrupt\n");
+            Disconnect(cn);
+            return;
+        }
+        space = RING_SIZE - (size_t)(tail - head);
+        while (space && !DPS_QueueEmpty(&cn->sendQueue)) {
+            SendRequest* req = (SendRequest*)DPS_QueueFront(&cn->sendQueue);
+            /*
+             * txBuf 0 is the message length, the buffers follow it
+             */
+            while (space && (cn->txBuf <= req->numBufs)) {
+                const uint8_t* base;
+                size_t len;
+                size_t n;
+
+                if (cn->txBuf == 0) {
+                    base = (const uint8_t*)&req->len;
+                    len = sizeof(req->len);
+                } else {
+                    base = (const uint8_t*)req->bufs[cn->txBuf - 1].base;
+                    len = req->bufs[cn->txBuf - 1].len;
+                }
+                n = len - cn->txOffset;
+                if (n > space) {
+                    n = space;
+                }
+                if (n) {
+                    if (CopyToRing(tx, tail, base + cn->txOffset, n) != DPS_OK) {
+                        DPS_ERRPRINT("Send ring is corrupt\n");
+                        Disconnect(cn);
+                        return;
+                    }
+                    tail += n;
+                    space -= n;
+                    cn->txOffset += n;
+                }
+                if (cn->txOffset == len) {
+                    ++cn->txBuf;
+                    cn->txOffset = 0;
+                }
+            }
+            if (cn->txBuf <= req->numBufs) {
+                break;
+            }
+            DPS_QueueRemove(&req->queue);
+            req->status = DPS_OK;
+            DPS_QueuePushBack(&cn->sendCompletedQueue, &req->queue);
+            cn->txBuf = 0;
+            cn->txOffset = 0;
+        }
+        if (tail != tx->tail) {
+            __atomic_store_n(&tx->tail, tail, __ATOMIC_SEQ_CST);
+            wrote = DPS_TRUE;
+        }
+        if (DPS_QueueEmpty(&cn->sendQueue)) {
+            break;
+        }
+        /*
+         * The ring is full so ask the consumer to wake us up when it
+         * frees some space, then check it didn't do that already.
+         */
+        __atomic_store_n(&tx->producerWaiting, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&tx->head, __ATOMIC_SEQ_CST) == head) {
+            break;
+        }
+    }
+    if (wrote && __atomic_exchange_n(&tx->consumerWaiting, 0, __ATOMIC_SEQ_CST)) {
+        Signal(cn->peerEvent);
+    }
+    if (!DPS_QueueEmpty(&cn->sendCompletedQueue)) {
+        uv_idle_start(&cn->idle, SendCompletedTask);
+    }
+}
+
+/*
+ * Returns the number of messages delivered to the receive callback
+ */
+static int DoReceive(DPS_NetConnection* cn)
+{
+    DPS_NetTransportContext* netCtx = cn->netCtx;
+    Ring* rx = cn->rx;
+    uint64_t head = rx->head;
+    int numMsgs = 0;
+    DPS_Status ret;
+
+    while (!cn->disconnected) {
+        uint64_t tail = __atomic_load_n(&rx->tail, __ATOMIC_ACQUIRE);
+        size_t avail = (size_t)(tail - head);
+        size_t n;
+
+        if ((tail - head) > RING_SIZE) {
+            /*
+             * The peer wrote an impossible tail, the ring cannot be
+             * trusted so give up on the connection
+             */
+            DPS_ERRPRINT("Receive ring is corrupt\n");
+            netCtx->receiveCB(cn->node, &cn->peerEp, DPS_ERR_NETWORK, NULL);
+            Disconnect(cn);
+            break;
+        }
+        if (!avail) {
+            /*
+             * Ask the producer to wake us up when there is more data,
+             * then check it didn't write any already.
+             */
+            __atomic_store_n(&rx->consumerWaiting, 1, __ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&rx->tail, __ATOMIC_SEQ_CST) == head) {
+                break;
+            }
+            continue;
+        }
+        if (!cn->msgBuf) {
+            uint32_t msgLen;
+
+            n = sizeof(cn->lenBuf) - cn->readLen;
+            if (n > avail) {
+                n = avail;
+            }
+            ret = CopyFromRing(rx, head, cn->lenBuf + cn->readLen, sizeof(cn->lenBuf) - cn->readLen, n);
+            if (ret != DPS_OK) {
+                netCtx->receiveCB(cn->node, &cn->peerEp, ret, NULL);
+                Disconnect(cn);
+                break;
+            }
+            cn->readLen += n;
+            head += n;
+            if (cn->readLen < sizeof(cn->lenBuf)) {
+                continue;
+            }
+            memcpy_s(&msgLen, sizeof(msgLen), cn->lenBuf, sizeof(cn->lenBuf));
+            if (msgLen > MAX_MSG_LEN) {
+                DPS_ERRPRINT("Message length %u is too large\n", msgLen);
+                ret = DPS_ERR_INVALID;
+            } else {
+                cn->msgBuf = DPS_CreateNetRxBuffer(msgLen);
+                ret = cn->msgBuf ? DPS_OK : DPS_ERR_RESOURCES;
+            }
+            if (ret != DPS_OK) {
+                /*
+                 * Report error to receive callback, the stream cannot
+                 * be resynchronized so give up on the connection
+                 */
+                netCtx->receiveCB(cn->node, &cn->peerEp, ret, NULL);
+                Disconnect(cn);
+                break;
+            }
+        } else {
+            n = DPS_RxBufferAvail(&cn->msgBuf->rx);
+            if (n > avail) {
+                n = avail;
+            }
+            ret = CopyFromRing(rx, head, cn->msgBuf->rx.rxPos, DPS_RxBufferAvail(&cn->msgBuf->rx), n);
+            if (ret != DPS_OK) {
+                netCtx->receiveCB(cn->node, &cn->peerEp, ret, NULL);
+                Disconnect(cn);
+                break;
+            }
+            cn->msgBuf->rx.rxPos += n;
+            head += n;
+        }
+        __atomic_store_n(&rx->head, head, __ATOMIC_SEQ_CST);
+        if (__atomic_exchange_n(&rx->producerWaiting, 0, __ATOMIC_SEQ_CST)) {
+            Signal(cn->peerEvent);
+        }
+        /*
+         * Keep reading if we don't have a complete message
+         */
+        if (DPS_RxBufferAvail(&cn->msgBuf->rx)) {
+            continue;
+        }
+        DPS_DBGPRINT("Received message of length %zd\n", cn->msgBuf->rx.eod - cn->msgBuf->rx.base);
+        /*
+         * Reset rxPos to beginning of complete message before passing up
+         */
+        cn->msgBuf->rx.rxPos = cn->msgBuf->rx.base;
+        ret = netCtx->receiveCB(cn->node, &cn->peerEp, DPS_OK, cn->msgBuf);
+        DPS_NetRxBufferDecRef(cn->msgBuf);
+        cn->msgBuf = NULL;
+        cn->readLen = 0;
+        ++numMsgs;
+        if (ret != DPS_OK) {
+            Disconnect(cn);
+        }
+    }
+    return numMsgs;
+}
+
+static void HandleClosed(uv_handle_t* handle)
+{
+    DPS_NetConnection* cn = (DPS_NetConnection*)handle->data;
+
+    if (--cn->numHandles) {
+        return;
+    }
+    DPS_DBGPRINT("Freeing connection %p\n", cn);
+    SendCompleted(cn);
+    DPS_NetRxBufferDecRef(cn->msgBuf);
+    if (cn->seg) {
+        munmap(cn->seg, sizeof(Segment));
+    }
+    if (cn->event >= 0) {
+        close(cn->event);
+    }
+    if (cn->peerEvent >= 0) {
+        close(cn->peerEvent);
+    }
+    free(cn);
+}
+
+/*
+ * Stop all I/O on a connection, the connection is freed when the last
+ * reference is released
+ */
+static void Disconnect(DPS_NetConnection* cn)
+{
+    if (cn->disconnected) {
+        return;
+    }
+    DPS_DBGPRINT("Disconnect connection %p\n", cn);
+    cn->disconnected = DPS_TRUE;
+    uv_poll_stop(&cn->sockPoll);
+    if (cn->seg) {
+        uv_poll_stop(&cn->eventPoll);
+    }
+    CancelPendingSends(cn);
+    if (!DPS_QueueEmpty(&cn->sendCompletedQueue)) {
+        uv_idle_start(&cn->idle, SendCompletedTask);
+    }
+}
+
+static void Shutdown(DPS_NetConnection* cn)
+{
+    if (cn->closing) {
+        return;
+    }
+    DPS_DBGPRINT("Shutdown connection %p\n", cn);
+    cn->disconnected = DPS_TRUE;
+    cn->closing = DPS_TRUE;
+    CancelPendingSends(cn);
+    /*
+     * Closing the socket tells the peer we have gone away
+     */
+    uv_close((uv_handle_t*)&cn->sockPoll, HandleClosed);
+    close(cn->sock);
+    cn->sock = -1;
+    if (cn->seg) {
+        uv_close((uv_handle_t*)&cn->eventPoll, HandleClosed);
+    }
+    uv_close((uv_handle_t*)&cn->idle, HandleClosed);
+}
+
+static void OnEvent(uv_poll_t* handle, int status, int events)
+{
+    DPS_NetConnection* cn = (DPS_NetConnection*)handle->data;
+    uint64_t count;
+    int numMsgs;
+
+    /*
+     * The node network context will be null if we are shutting down
+     */
+    if (!cn->node->netCtx) {
+        return;
+    }
+    if (read(cn->event, &count, sizeof(count)) < 0) {
+        if (errno != EAGAIN) {
+            DPS_ERRPRINT("eventfd read failed %d\n", errno);
+        }
+    }
+    numMsgs = DoReceive(cn);
+    DoSend(cn);
+    /*
+     * Shutdown the connection if the upper layer didn't IncRef to keep it alive
+     */
+    if (numMsgs && (cn->refCount == 0)) {
+        Shutdown(cn);
+    }
+}
+
+static DPS_Status MapSegment(DPS_NetConnection* cn, int fd, int connector)
+{
+    cn->seg = mmap(NULL, sizeof(Segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (cn->seg == MAP_FAILED) {
+        DPS_ERRPRINT("mmap failed %d\n", errno);
+        cn->seg = NULL;
+        return DPS_ERR_RESOURCES;
+    }
+    if (connector) {
+        cn->tx = &cn->seg->ring[0];
+        cn->rx = &cn->seg->ring[1];
+    } else {
+        cn->tx = &cn->seg->ring[1];
+        cn->rx = &cn->seg->ring[0];
+    }
+    return DPS_OK;
+}
+
+static DPS_Status StartEvents(DPS_NetConnection* cn)
+{
+    int r;
+
+    r = uv_poll_init(cn->node->loop, &cn->eventPoll, cn->event);
+    if (r) {
+        DPS_ERRPRINT("uv_poll_init failed %s\n", uv_err_name(r));
+        return DPS_ERR_NETWORK;
+    }
+    cn->eventPoll.data = cn;
+    ++cn->numHandles;
+    r = uv_poll_start(&cn->eventPoll, UV_READABLE, OnEvent);
+    if (r) {
+        DPS_ERRPRINT("uv_poll_start failed %s\n", uv_err_name(r));
+        return DPS_ERR_NETWORK;
+    }
+    return DPS_OK;
+}
+
+/*
+ * The first message on an accepted socket carries the segment and
+ * eventfds. After that the socket only becomes readable when the peer
+ * goes away.
+ */
+static DPS_Status ReceiveFds(DPS_NetConnection* cn)
+{
+    DPS_Status ret;
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr* cmsg;
+    char cbuf[CMSG_SPACE(NUM_FDS * sizeof(int))];
+    int fds[NUM_FDS];
+    uint8_t byte;
+    ssize_t n;
+
+    memzero_s(&msg, sizeof(msg));
+    iov.iov_base = &byte;
+    iov.iov_len = sizeof(byte);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+    n = recvmsg(cn->sock, &msg, MSG_CMSG_CLOEXEC);
+    if (n < 0) {
+        return (errno == EAGAIN) ? DPS_ERR_BUSY : DPS_ERR_NETWORK;
+    }
+    if (n == 0) {
+        return DPS_ERR_EOF;
+    }
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || (cmsg->cmsg_level != SOL_SOCKET) || (cmsg->cmsg_type != SCM_RIGHTS) ||
+        (cmsg->cmsg_len != CMSG_LEN(sizeof(fds)))) {
+        DPS_ERRPRINT("Expected shared memory file descriptors\n");
+        return DPS_ERR_INVALID;
+    }
+    memcpy_s(fds, sizeof(fds), CMSG_DATA(cmsg), sizeof(fds));
+    cn->event = fds[1];
+    cn->peerEvent = fds[2];
+    ret = MapSegment(cn, fds[0], DPS_FALSE);
+    close(fds[0]);
+    if (ret == DPS_OK) {
+        ret = StartEvents(cn);
+    }
+    return ret;
+}
+
+static void OnSocket(uv_poll_t* handle, int status, int events)
+{
+    DPS_NetConnection* cn = (DPS_NetConnection*)handle->data;
+    DPS_NetTransportContext* netCtx = cn->netCtx;
+    DPS_Status ret;
+    uint8_t byte;
+
+    DPS_DBGTRACE();
+    /*
+     * The node network context will be null if we are shutting down
+     */
+    if (!cn->node->netCtx || cn->disconnected) {
+        return;
+    }
+    if (!cn->seg) {
+        ret = ReceiveFds(cn);
+        if (ret == DPS_OK) {
+            /*
+             * The peer may not have written anything yet
+             */
+            if (DoReceive(cn) && (cn->refCount == 0)) {
+                Shutdown(cn);
+            }
+            return;
+        }
+        if (ret == DPS_ERR_BUSY) {
+            return;
+        }
+        DPS_ERRPRINT("Failed to set up connection: %s\n", DPS_ErrTxt(ret));
+        Shutdown(cn);
+        return;
+    }
+    if ((status == 0) && !(events & UV_DISCONNECT) && (recv(cn->sock, &byte, sizeof(byte), MSG_DONTWAIT) < 0) &&
+        (errno == EAGAIN)) {
+        return;
+    }
+    /*
+     * The peer has gone away, deliver anything it wrote first
+     */
+    DoReceive(cn);
+    if (!cn->disconnected) {
+        Disconnect(cn);
+        netCtx->receiveCB(cn->node, &cn->peerEp, DPS_ERR_EOF, NULL);
+    }
+    if (cn->refCount == 0) {
+        Shutdown(cn);
+    }
+}
+
+static DPS_NetConnection* CreateConnection(DPS_NetTransportContext* netCtx, int sock)
+{
+    DPS_Node* node = netCtx->node;
+    DPS_NetConnection* cn;
+    int r;
+
+    cn = calloc(1, sizeof(DPS_NetConnection));
+    if (!cn) {
+        return NULL;
+    }
+    cn->transport = &DPS_ShmTransport;
+    cn->netCtx = netCtx;
+    cn->node = node;
+    cn->sock = sock;
+    cn->event = -1;
+    cn->peerEvent = -1;
+    cn->peerEp.addr.type = DPS_SHM;
+    cn->peerEp.cn = cn;
+    DPS_QueueInit(&cn->sendQueue);
+    DPS_QueueInit(&cn->sendCompletedQueue);
+    uv_idle_init(node->loop, &cn->idle);
+    cn->idle.data = cn;
+    ++cn->numHandles;
+    r = uv_poll_init(node->loop, &cn->sockPoll, sock);
+    if (r) {
+        DPS_ERRPRINT("uv_poll_init failed %s\n", uv_err_name(r));
+        cn->closing = DPS_TRUE;
+        uv_close((uv_handle_t*)&cn->idle, HandleClosed);
+        return NULL;
+    }
+    cn->sockPoll.data = cn;
+    ++cn->numHandles;
+    return cn;
+}
+
+static void OnIncomingConnection(uv_poll_t* handle, int status, int events)
+{
+    DPS_NetTransportContext* netCtx = (DPS_NetTransportContext*)handle->data;
+    DPS_NetConnection* cn;
+    int sock;
+    int r;
+
+    DPS_DBGTRACE();
+
+    if (status < 0) {
+        DPS_ERRPRINT("OnIncomingConnection %s\n", uv_strerror(status));
+        return;
+    }
+    for (;;) {
+        sock = accept4(netCtx->sock, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (sock < 0) {
+            if (errno != EAGAIN) {
+                DPS_ERRPRINT("OnIncomingConnection accept failed %d\n", errno);
+            }
+            return;
+        }
+        if (netCtx->node->state != DPS_NODE_RUNNING) {
+            close(sock);
+            continue;
+        }
+        cn = CreateConnection(netCtx, sock);
+        if (!cn) {
+            close(sock);
+            continue;
+        }
+        r = uv_poll_start(&cn->sockPoll, UV_READABLE | UV_DISCONNECT, OnSocket);
+        if (r) {
+            DPS_ERRPRINT("OnIncomingConnection poll start %s\n", uv_strerror(r));
+            Shutdown(cn);
+        }
+    }
+}
+
+static void ListenSocketClosed(uv_handle_t* handle)
+{
+    DPS_NetTransportContext* netCtx = (DPS_NetTransportContext*)handle->data;
+
+    DPS_DBGPRINT("Closed handle %p\n", handle);
+    close(netCtx->sock);
+    unlink(netCtx->path);
+    free(netCtx);
+}
+
+static int Bind(int sock, const char* path)
+{
+    struct sockaddr_un sa;
+
+    memzero_s(&sa, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    if (strncpy_s(sa.sun_path, sizeof(sa.sun_path), path, sizeof(sa.sun_path) - 1) != EOK) {
+        return ENAMETOOLONG;
+    }
+    if (bind(sock, (struct sockaddr*)&sa, sizeof(sa))) {
+        return errno;
+    }
+    return 0;
+}
+
+static DPS_NetTransportContext* NetStart(DPS_Node* node, const DPS_NodeAddress* addr, DPS_OnReceive cb)
+{
+    DPS_NetTransportContext* netCtx = NULL;
+    DPS_UUID uuid;
+    int ret;
+
+    netCtx = calloc(1, sizeof(DPS_NetTransportContext));
+    if (!netCtx) {
+        return NULL;
+    }
+    netCtx->node = node;
+    netCtx->receiveCB = cb;
+    netCtx->sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (netCtx->sock < 0) {
+        DPS_ERRPRINT("socket failed %d\n", errno);
+        free(netCtx);
+        return NULL;
+    }
+    if (addr) {
+        ret = strncpy_s(netCtx->path, sizeof(netCtx->path), addr->u.path, sizeof(netCtx->path) - 1);
+        if (ret == EOK) {
+            ret = Bind(netCtx->sock, netCtx->path);
+        }
+    } else {
+        /*
+         * Create a unique temporary path
+         */
+        do {
+            size_t len = sizeof(netCtx->path);
+            ret = uv_os_tmpdir(netCtx->path, &len);
+            if (ret) {
+                break;
+            }
+            DPS_GenerateUUID(&uuid);
+            ret = strcat_s(netCtx->path, sizeof(netCtx->path), "/");
+            if (ret == EOK) {
+                ret = strcat_s(netCtx->path, sizeof(netCtx->path), DPS_UUIDToString(&uuid));
+            }
+            if (ret == EOK) {
+                ret = Bind(netCtx->sock, netCtx->path);
+            }
+        } while (ret == EADDRINUSE);
+    }
+    if (ret) {
+        DPS_ERRPRINT("Failed to bind %s: %d\n", netCtx->path, ret);
+        netCtx->path[0] = 0;
+        goto ErrorExit;
+    }
+    if (listen(netCtx->sock, LISTEN_BACKLOG)) {
+        DPS_ERRPRINT("listen failed %d\n", errno);
+        goto ErrorExit;
+    }
+    ret = uv_poll_init(node->loop, &netCtx->poll, netCtx->sock);
+    if (ret) {
+        DPS_ERRPRINT("uv_poll_init failed %s\n", uv_err_name(ret));
+        goto ErrorExit;
+    }
+    netCtx->poll.data = netCtx;
+    ret = uv_poll_start(&netCtx->poll, UV_READABLE, OnIncomingConnection);
+    if (ret) {
+        DPS_ERRPRINT("uv_poll_start failed %s\n", uv_err_name(ret));
+        uv_close((uv_handle_t*)&netCtx->poll, ListenSocketClosed);
+        return NULL;
+    }
+    DPS_DBGPRINT("Listening on %s\n", netCtx->path);
+    /*
+     * Writing to a socket the peer has closed must not raise SIGPIPE
+     */
+    signal(SIGPIPE, SIG_IGN);
+    return netCtx;
+
+ErrorExit:
+    close(netCtx->sock);
+    if (netCtx->path[0]) {
+        unlink(netCtx->path);
+    }
+    free(netCtx);
+    return NULL;
+}
+
+static DPS_NodeAddress* NetGetListenAddress(DPS_NodeAddress* addr, DPS_NetTransportContext* netCtx)
+{
+    DPS_DBGTRACEA("netCtx=%p\n", netCtx);
+
+    memzero_s(addr, sizeof(DPS_NodeAddress));
+    if (!netCtx) {
+        return addr;
+    }
+    addr->type = DPS_SHM;
+    strncpy_s(addr->u.path, sizeof(addr->u.path), netCtx->path, sizeof(addr->u.path) - 1);
+    DPS_DBGPRINT("Listener address = %s\n", addr->u.path);
+    return addr;
+}
+
+static void NetStop(DPS_NetTransportContext* netCtx)
+{
+    if (netCtx) {
+        uv_close((uv_handle_t*)&netCtx->poll, ListenSocketClosed);
+    }
+}
+
+/*
+ * Create the shared memory segment and eventfds and pass them to the
+ * node listening at the endpoint's path
+ */
+static DPS_NetConnection* Connect(DPS_NetTransportContext* netCtx, const DPS_NetEndpoint* ep)
+{
+    DPS_NetConnection* cn = NULL;
+    struct sockaddr_un sa;
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr* cmsg;
+    char cbuf[CMSG_SPACE(NUM_FDS * sizeof(int))];
+    int fds[NUM_FDS] = { -1, -1, -1 };
+    uint8_t byte = 0;
+    int sock;
+
+    sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        DPS_ERRPRINT("socket failed %d\n", errno);
+        return NULL;
+    }
+    memzero_s(&sa, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    strncpy_s(sa.sun_path, sizeof(sa.sun_path), ep->addr.u.path, sizeof(sa.sun_path) - 1);
+    /*
+     * Connecting to a local socket completes or fails immediately
+     */
+    if (connect(sock, (struct sockaddr*)&sa, sizeof(sa))) {
+        DPS_ERRPRINT("connect %s failed %d\n", ep->addr.u.path, errno);
+        close(sock);
+        return NULL;
+    }
+    cn = CreateConnection(netCtx, sock);
+    if (!cn) {
+        close(sock);
+        return NULL;
+    }
+    cn->peerEp.addr = ep->addr;
+
+    fds[0] = memfd_create("dps-shm", MFD_CLOEXEC);
+    fds[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    fds[2] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    cn->peerEvent = fds[1];
+    cn->event = fds[2];
+    if ((fds[0] < 0) || (fds[1] < 0) || (fds[2] < 0)) {
+        DPS_ERRPRINT("Failed to create shared memory %d\n", errno);
+        goto ErrorExit;
+    }
+    if (ftruncate(fds[0], sizeof(Segment))) {
+        DPS_ERRPRINT("ftruncate failed %d\n", errno);
+        goto ErrorExit;
+    }
+    if (MapSegment(cn, fds[0], DPS_TRUE) != DPS_OK) {
+        goto ErrorExit;
+    }
+    /*
+     * Neither side has started reading so both are waiting for data
+     */
+    cn->seg->ring[0].consumerWaiting = 1;
+    cn->seg->ring[1].consumerWaiting = 1;
+
+    memzero_s(&msg, sizeof(msg));
+    iov.iov_base = &byte;
+    iov.iov_len = sizeof(byte);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy_s(CMSG_DATA(cmsg), sizeof(fds), fds, sizeof(fds));
+    if (sendmsg(sock, &msg, MSG_NOSIGNAL) < 0) {
+        DPS_ERRPRINT("sendmsg failed %d\n", errno);
+        goto ErrorExit;
+    }
+    close(fds[0]);
+    fds[0] = -1;
+    if (StartEvents(cn) != DPS_OK) {
+        goto ErrorExit;
+    }
+    if (uv_poll_start(&cn->sockPoll, UV_READABLE | UV_DISCONNECT, OnSocket)) {
+        goto ErrorExit;
+    }
+    return cn;
+
+ErrorExit:
+    if (fds[0] >= 0) {
+        close(fds[0]);
+    }
+    Shutdown(cn);
+    return NULL;
+}
+
+static DPS_Status NetSend(DPS_NetTransportContext* netCtx, void* appCtx, DPS_NetEndpoint* ep, uv_buf_t* bufs,
+                          size_t numBufs, DPS_NetSendComplete sendCompleteCB)
+{
+    SendRequest* req;
+    size_t i;
+    size_t len = 0;
+
+    for (i = 0; i < numBufs; ++i) {
+        len += bufs[i].len;
+    }
+    if (len > MAX_MSG_LEN) {
+        return DPS_ERR_RESOURCES;
+    }
+
+    DPS_DBGPRINT("DPS_NetSend total %zu bytes to %s\n", len, DPS_NodeAddrToString(&ep->addr));
+
+    if (ep->cn && ep->cn->disconnected) {
+        return DPS_ERR_NETWORK;
+    }
+    req = malloc(sizeof(SendRequest) + (numBufs - 1) * sizeof(uv_buf_t));
+    if (!req) {
+        return DPS_ERR_RESOURCES;
+    }
+    req->len = (uint32_t)len;
+    memcpy_s(req->bufs, numBufs * sizeof(uv_buf_t), bufs, numBufs * sizeof(uv_buf_t));
+    req->numBufs = numBufs;
+    req->onSendComplete = sendCompleteCB;
+    req->appCtx = appCtx;
+    /*
+     * See if we already have a connection
+     */
+    if (!ep->cn) {
+        ep->cn = Connect(netCtx, ep);
+        if (!ep->cn) {
+            free(req);
+            return DPS_ERR_NETWORK;
+        }
+        /*
+         * This reference belongs to the endpoint
+         */
+        ConnectionIncRef(ep->cn);
+    }
+    req->cn = ep->cn;
+    ConnectionIncRef(ep->cn);
+    DPS_QueuePushBack(&ep->cn->sendQueue, &req->queue);
+    DoSend(ep->cn);
+    return DPS_OK;
+}
+
+static void ConnectionIncRef(DPS_NetConnection* cn)
+{
+    if (cn) {
+        DPS_DBGTRACE();
+        ++cn->refCount;
+    }
+}
+
+static void ConnectionDecRef(DPS_NetConnection* cn)
+{
+    if (cn) {
+        DPS_DBGTRACE();
+        assert(cn->refCount > 0);
+        if (--cn->refCount == 0) {
+            Shutdown(cn);
+        }
+    }
+}
+
+const DPS_NetTransport DPS_ShmTransport = {
+    "shm",
+    DPS_SHM,
+    NetStart,
+    NetGetListenAddress,
+    NetStop,
+    NetSend,
+    ConnectionIncRef,
+    ConnectionDecRef,
+    NULL
+};
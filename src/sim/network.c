@@ -0,0 +1,802 @@
+/*
+ *******************************************************************
+ *
+ * Copyright 2016 Intel Corporation All rights reserved.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ */
+
+/*
+ * An in-process network simulator. Messages sent by a node are queued
+ * with the virtual time at which the link model delivers them. A
+ * simulator thread hands the messages that are due to the event loops
+ * of the receiving nodes. The virtual clock follows real time while
+ * the nodes are busy and skips ahead to the earliest queued message
+ * once the simulation is quiescent.
+ */
+
+#include <assert.h>
+#include <safe_lib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dps/dbg.h>
+#include <dps/private/network.h>
+#include <dps/private/sim.h>
+#include "../node.h"
+
+/*
+ * Debug control for this module
+ */
+DPS_DEBUG_CONTROL(DPS_DEBUG_ON);
+
+#define NUM_PORTS    65536
+#define QUIET_USECS  2000   /* Default quiet period */
+
+typedef struct _SimMsg {
+    struct _SimMsg* next;       /* Next message queued for the receiving node */
+    uint64_t deliverAt;         /* Virtual delivery time in usecs */
+    uint64_t order;             /* Orders messages delivered at the same time */
+    uint16_t src;
+    uint16_t dst;
+    DPS_NetRxBuffer* buf;
+} SimMsg;
+
+typedef struct _SendRequest {
+    struct _SendRequest* next;
+    void* appCtx;
+    DPS_NetEndpoint ep;
+    DPS_NetSendComplete sendCompleteCB;
+    size_t numBufs;
+    uv_buf_t bufs[1];
+} SendRequest;
+
+/*
+ * State of a directed link from a node
+ */
+typedef struct _LinkState {
+    struct _LinkState* next;
+    uint16_t dst;
+    DPS_SimLink link;
+    uint64_t busyUntil;         /* Virtual time the link has finished transmitting */
+    uint64_t rng;               /* Random state for loss and jitter */
+} LinkState;
+
+/*
+ * A link model set with DPS_SimSetLink()
+ */
+typedef struct _LinkConfig {
+    struct _LinkConfig* next;
+    uint16_t port1;
+    uint16_t port2;
+    DPS_SimLink link;
+} LinkConfig;
+
+struct _DPS_NetTransportContext {
+    DPS_Node* node;
+    DPS_OnReceive receiveCB;
+    uv_async_t async;           /* Runs deliveries and send completions on the node's loop */
+    uint16_t port;
+    uint64_t seq;               /* Number of messages sent */
+    LinkState* links;
+    SimMsg* rxHead;
+    SimMsg* rxTail;
+    SendRequest* txHead;
+    SendRequest* txTail;
+    DPS_SimStats stats;
+};
+
+struct _DPS_MulticastReceiver {
+    DPS_Node* node;
+    DPS_OnReceive receiveCB;
+};
+
+struct _DPS_MulticastSender {
+    DPS_Node* node;
+};
+
+static uv_once_t once = UV_ONCE_INIT;
+
+static struct {
+    uv_mutex_t lock;
+    uv_cond_t cond;             /* Signals the simulator thread */
+    uv_cond_t idleCond;         /* Signals waiters for quiescence */
+    uv_thread_t thread;
+    int started;                /* A node has been started */
+    int idle;                   /* Quiescent with nothing queued */
+    uint64_t seed;
+    DPS_SimLink link;           /* Model of links without a configuration */
+    uint64_t quiet;             /* Quiet period in nsecs */
+    uint32_t speed;             /* Virtual usecs per real usec while not quiescent */
+    uint64_t now;               /* Virtual time in usecs */
+    uint64_t lastActivity;      /* Real time of the last send or receive */
+    uint64_t wallBase;          /* Real time at virtBase */
+    uint64_t virtBase;          /* Virtual time of the last skip ahead */
+    uint32_t inflight;          /* Messages handed to a node and not yet processed */
+    SimMsg** heap;
+    size_t heapLen;
+    size_t heapCap;
+    LinkConfig* configs;
+    uint16_t nextPort;
+    DPS_SimStats stats;
+    DPS_NetTransportContext* ports[NUM_PORTS];
+} sim;
+
+static int Before(const SimMsg* a, const SimMsg* b)
+{
+    return (a->deliverAt < b->deliverAt) || (a->deliverAt == b->deliverAt && a->order < b->order);
+}
+
+static int HeapPush(SimMsg* msg)
+{
+    size_t i;
+
+    if (sim.heapLen == sim.heapCap) {
+        size_t cap = sim.heapCap ? 2 * sim.heapCap : 1024;
+        SimMsg** heap = realloc(sim.heap, cap * sizeof(SimMsg*));
+        if (!heap) {
+            return DPS_FALSE;
+        }
+        sim.heap = heap;
+        sim.heapCap = cap;
+    }
+    i = sim.heapLen++;
+    while (i && Before(msg, sim.heap[(i - 1) / 2])) {
+        sim.heap[i] = sim.heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    sim.heap[i] = msg;
+    return DPS_TRUE;
+}
+
+static SimMsg* HeapPop(void)
+{
+    SimMsg* top = sim.heap[0];
+    SimMsg* last = sim.heap[--sim.heapLen];
+    size_t i = 0;
+    size_t c;
+
+    while ((c = 2 * i + 1) < sim.heapLen) {
+        if ((c + 1) < sim.heapLen && Before(sim.heap[c + 1], sim.heap[c])) {
+            ++c;
+        }
+        if (!Before(sim.heap[c], last)) {
+            break;
+        }
+        sim.heap[i] = sim.heap[c];
+        i = c;
+    }
+    sim.heap[i] = last;
+    return top;
+}
+
+/*
+ * splitmix64
+ */
+static uint64_t Random(uint64_t* state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static uint8_t MessageType(const uint8_t* data, size_t len)
+{
+    /*
+     * A DPS request is a CBOR array of 5 elements starting with the
+     * version and the message type
+     */
+    if (len >= 3 && data[0] == 0x85 && data[1] == DPS_MSG_VERSION && data[2] < DPS_SIM_MSG_TYPES) {
+        return data[2];
+    }
+    return 0;
+}
+
+static void SetAddr(DPS_NodeAddress* addr, uint16_t port)
+{
+    struct sockaddr_in6 sa;
+
+    memzero_s(&sa, sizeof(sa));
+    sa.sin6_family = AF_INET6;
+    sa.sin6_port = htons(port);
+    memcpy(&sa.sin6_addr, &in6addr_loopback, sizeof(sa.sin6_addr));
+    DPS_NetSetAddr(addr, DPS_UDP, (const struct sockaddr*)&sa);
+}
+
+static uint16_t GetPort(const DPS_NodeAddress* addr)
+{
+    if (addr->u.inaddr.ss_family == AF_INET6) {
+        return ntohs(((const struct sockaddr_in6*)&addr->u.inaddr)->sin6_port);
+    } else if (addr->u.inaddr.ss_family == AF_INET) {
+        return ntohs(((const struct sockaddr_in*)&addr->u.inaddr)->sin_port);
+    } else {
+        return 0;
+    }
+}
+
+/*
+ * Must be called with the simulator lock held
+ */
+static LinkState* GetLink(DPS_NetTransportContext* netCtx, uint16_t dst)
+{
+    LinkState* ls;
+    LinkConfig* cfg;
+
+    for (ls = netCtx->links; ls; ls = ls->next) {
+        if (ls->dst == dst) {
+            return ls;
+        }
+    }
+    ls = calloc(1, sizeof(LinkState));
+    if (!ls) {
+        return NULL;
+    }
+    ls->dst = dst;
+    ls->link = sim.link;
+    for (cfg = sim.configs; cfg; cfg = cfg->next) {
+        if ((cfg->port1 == netCtx->port && cfg->port2 == dst) || (cfg->port1 == dst && cfg->port2 == netCtx->port)) {
+            ls->link = cfg->link;
+            break;
+        }
+    }
+    /*
+     * Each directed link has its own random sequence so loss and
+     * jitter do not depend on the order in which nodes send
+     */
+    ls->rng = sim.seed ^ (((uint64_t)netCtx->port << 16) | dst);
+    Random(&ls->rng);
+    ls->next = netCtx->links;
+    netCtx->links = ls;
+    return ls;
+}
+
+/*
+ * Must be called with the simulator lock held
+ */
+static uint64_t Now(uint64_t wall)
+{
+    uint64_t now = sim.virtBase + ((wall - sim.wallBase) * sim.speed) / 1000;
+
+    if (now > sim.now) {
+        sim.now = now;
+    }
+    return sim.now;
+}
+
+/*
+ * Hands the messages due by the given virtual time to the receiving
+ * nodes in delivery order
+ */
+static void Deliver(uint64_t now)
+{
+    while (sim.heapLen && sim.heap[0]->deliverAt <= now) {
+        SimMsg* msg = HeapPop();
+        DPS_NetTransportContext* netCtx = sim.ports[msg->dst];
+        DPS_RxBuffer* rx = &msg->buf->rx;
+        size_t len = DPS_RxBufferAvail(rx);
+        uint8_t type = MessageType(rx->rxPos, len);
+
+        if (netCtx) {
+            ++netCtx->stats.received[type];
+            netCtx->stats.receivedBytes[type] += len;
+            ++sim.stats.received[type];
+            sim.stats.receivedBytes[type] += len;
+            msg->next = NULL;
+            if (netCtx->rxTail) {
+                netCtx->rxTail->next = msg;
+            } else {
+                netCtx->rxHead = msg;
+            }
+            netCtx->rxTail = msg;
+            ++sim.inflight;
+            uv_async_send(&netCtx->async);
+        } else {
+            ++sim.stats.undeliverable;
+            DPS_NetRxBufferDecRef(msg->buf);
+            free(msg);
+        }
+    }
+}
+
+static void SimThread(void* arg)
+{
+    uv_mutex_lock(&sim.lock);
+    for (;;) {
+        uint64_t wall = uv_hrtime();
+        uint64_t now = Now(wall);
+        uint64_t due;
+        int quiescent;
+
+        if (sim.heapLen && sim.heap[0]->deliverAt <= now) {
+            Deliver(now);
+            continue;
+        }
+        quiescent = !sim.inflight && (wall - sim.lastActivity) >= sim.quiet;
+        if (!sim.heapLen) {
+            if (quiescent) {
+                if (!sim.idle) {
+                    sim.idle = DPS_TRUE;
+                    uv_cond_broadcast(&sim.idleCond);
+                }
+                uv_cond_wait(&sim.cond, &sim.lock);
+            } else {
+                uv_cond_timedwait(&sim.cond, &sim.lock, sim.quiet);
+            }
+            continue;
+        }
+        if (quiescent) {
+            /*
+             * Nothing can happen before the next delivery so skip ahead
+             */
+            sim.now = sim.virtBase = sim.heap[0]->deliverAt;
+            sim.wallBase = wall;
+            Deliver(sim.now);
+            continue;
+        }
+        /*
+         * Wait until the next delivery is due in real time or the
+         * simulation may have become quiescent
+         */
+        due = ((sim.heap[0]->deliverAt - now) * 1000) / sim.speed;
+        uv_cond_timedwait(&sim.cond, &sim.lock, (due < sim.quiet) ? due + 1 : sim.quiet);
+    }
+    uv_mutex_unlock(&sim.lock);
+}
+
+static void InitSim(void)
+{
+    int r;
+
+    uv_mutex_init(&sim.lock);
+    uv_cond_init(&sim.cond);
+    uv_cond_init(&sim.idleCond);
+    sim.quiet = QUIET_USECS * 1000ull;
+    sim.speed = 1;
+    sim.nextPort = 1;
+    sim.idle = DPS_TRUE;
+    sim.lastActivity = sim.wallBase = uv_hrtime();
+    r = uv_thread_create(&sim.thread, SimThread, NULL);
+    if (r) {
+        DPS_ERRPRINT("Failed to start simulator thread - %s\n", uv_strerror(r));
+    }
+}
+
+DPS_Status DPS_SimConfigure(uint64_t seed, const DPS_SimLink* link, uint32_t quiet, uint32_t speed)
+{
+    DPS_Status ret = DPS_OK;
+
+    uv_once(&once, InitSim);
+    uv_mutex_lock(&sim.lock);
+    if (sim.started) {
+        ret = DPS_ERR_INVALID;
+    } else {
+        sim.seed = seed;
+        if (link) {
+            sim.link = *link;
+        } else {
+            memzero_s(&sim.link, sizeof(sim.link));
+        }
+        sim.quiet = (quiet ? quiet : QUIET_USECS) * 1000ull;
+        sim.speed = speed ? speed : 1;
+        sim.now = sim.virtBase = 0;
+        sim.wallBase = uv_hrtime();
+    }
+    uv_mutex_unlock(&sim.lock);
+    return ret;
+}
+
+DPS_Status DPS_SimSetLink(uint16_t port1, uint16_t port2, const DPS_SimLink* link)
+{
+    DPS_NetTransportContext* netCtx;
+    LinkConfig* cfg;
+    LinkState* ls;
+
+    uv_once(&once, InitSim);
+    uv_mutex_lock(&sim.lock);
+    for (cfg = sim.configs; cfg; cfg = cfg->next) {
+        if ((cfg->port1 == port1 && cfg->port2 == port2) || (cfg->port1 == port2 && cfg->port2 == port1)) {
+            break;
+        }
+    }
+    if (!cfg) {
+        cfg = malloc(sizeof(LinkConfig));
+        if (!cfg) {
+            uv_mutex_unlock(&sim.lock);
+            return DPS_ERR_RESOURCES;
+        }
+        cfg->port1 = port1;
+        cfg->port2 = port2;
+        cfg->next = sim.configs;
+        sim.configs = cfg;
+    }
+    cfg->link = *link;
+    /*
+     * Update links that are already in use
+     */
+    if ((netCtx = sim.ports[port1]) != NULL) {
+        for (ls = netCtx->links; ls; ls = ls->next) {
+            if (ls->dst == port2) {
+                ls->link = *link;
+            }
+        }
+    }
+    if ((netCtx = sim.ports[port2]) != NULL) {
+        for (ls = netCtx->links; ls; ls = ls->next) {
+            if (ls->dst == port1) {
+                ls->link = *link;
+            }
+        }
+    }
+    uv_mutex_unlock(&sim.lock);
+    return DPS_OK;
+}
+
+uint64_t DPS_SimNow(void)
+{
+    uint64_t now;
+
+    uv_once(&once, InitSim);
+    uv_mutex_lock(&sim.lock);
+    now = Now(uv_hrtime());
+    uv_mutex_unlock(&sim.lock);
+    return now;
+}
+
+DPS_Status DPS_SimWaitIdle(uint32_t settle, uint32_t timeout)
+{
+    DPS_Status ret = DPS_OK;
+    uint64_t settleNs = (uint64_t)settle * 1000000ull;
+    uint64_t start;
+    uint64_t wall;
+
+    uv_once(&once, InitSim);
+    uv_mutex_lock(&sim.lock);
+    if (settleNs < sim.quiet) {
+        settleNs = sim.quiet;
+    }
+    start = uv_hrtime();
+    /*
+     * Requests the caller made just before calling this may not have
+     * been sent yet so always wait for at least the settle time
+     */
+    for (;;) {
+        wall = uv_hrtime();
+        if (sim.idle && (wall - start) >= settleNs && (wall - sim.lastActivity) >= settleNs) {
+            break;
+        }
+        if ((wall - start) >= (uint64_t)timeout * 1000000ull) {
+            ret = DPS_ERR_TIMEOUT;
+            break;
+        }
+        uv_cond_timedwait(&sim.idleCond, &sim.lock, sim.quiet);
+    }
+    uv_mutex_unlock(&sim.lock);
+    return ret;
+}
+
+DPS_Status DPS_SimGetStats(uint16_t port, DPS_SimStats* stats)
+{
+    DPS_Status ret = DPS_OK;
+
+    uv_once(&once, InitSim);
+    uv_mutex_lock(&sim.lock);
+    if (!port) {
+        *stats = sim.stats;
+    } else if (sim.ports[port]) {
+        *stats = sim.ports[port]->stats;
+    } else {
+        ret = DPS_ERR_MISSING;
+    }
+    uv_mutex_unlock(&sim.lock);
+    return ret;
+}
+
+static void OnAsync(uv_async_t* handle)
+{
+    DPS_NetTransportContext* netCtx = handle->data;
+    DPS_NetEndpoint ep;
+    SendRequest* req;
+    SimMsg* msg;
+    uint32_t n = 0;
+
+    uv_mutex_lock(&sim.lock);
+    req = netCtx->txHead;
+    msg = netCtx->rxHead;
+    netCtx->txHead = netCtx->txTail = NULL;
+    netCtx->rxHead = netCtx->rxTail = NULL;
+    uv_mutex_unlock(&sim.lock);
+
+    while (req) {
+        SendRequest* next = req->next;
+        req->sendCompleteCB(netCtx->node, req->appCtx, &req->ep, req->bufs, req->numBufs, DPS_OK);
+        free(req);
+        req = next;
+    }
+    while (msg) {
+        SimMsg* next = msg->next;
+        SetAddr(&ep.addr, msg->src);
+        ep.cn = NULL;
+        netCtx->receiveCB(netCtx->node, &ep, DPS_OK, msg->buf);
+        DPS_NetRxBufferDecRef(msg->buf);
+        free(msg);
+        msg = next;
+        ++n;
+    }
+    if (n) {
+        uv_mutex_lock(&sim.lock);
+        sim.inflight -= n;
+        sim.lastActivity = uv_hrtime();
+        if (!sim.inflight) {
+            uv_cond_signal(&sim.cond);
+        }
+        uv_mutex_unlock(&sim.lock);
+    }
+}
+
+static void OnAsyncClosed(uv_handle_t* handle)
+{
+    DPS_NetTransportContext* netCtx = handle->data;
+    SendRequest* req;
+    SimMsg* msg;
+    uint32_t n = 0;
+
+    uv_mutex_lock(&sim.lock);
+    req = netCtx->txHead;
+    msg = netCtx->rxHead;
+    while (msg) {
+        SimMsg* next = msg->next;
+        DPS_NetRxBufferDecRef(msg->buf);
+        free(msg);
+        msg = next;
+        ++n;
+    }
+    sim.inflight -= n;
+    uv_cond_signal(&sim.cond);
+    uv_mutex_unlock(&sim.lock);
+
+    while (req) {
+        SendRequest* next = req->next;
+        req->sendCompleteCB(netCtx->node, req->appCtx, &req->ep, req->bufs, req->numBufs, DPS_ERR_NETWORK);
+        free(req);
+        req = next;
+    }
+    while (netCtx->links) {
+        LinkState* ls = netCtx->links;
+        netCtx->links = ls->next;
+        free(ls);
+    }
+    free(netCtx);
+}
+
+static DPS_NetTransportContext* NetStart(DPS_Node* node, const DPS_NodeAddress* addr, DPS_OnReceive cb)
+{
+    DPS_NetTransportContext* netCtx;
+    uint16_t port = addr ? GetPort(addr) : 0;
+    int i;
+    int r;
+
+    uv_once(&once, InitSim);
+    netCtx = calloc(1, sizeof(DPS_NetTransportContext));
+    if (!netCtx) {
+        return NULL;
+    }
+    netCtx->node = node;
+    netCtx->receiveCB = cb;
+    uv_mutex_lock(&sim.lock);
+    if (!port) {
+        for (i = 1; i < NUM_PORTS; ++i) {
+            if (!sim.ports[sim.nextPort]) {
+                port = sim.nextPort;
+            }
+            sim.nextPort = (sim.nextPort % (NUM_PORTS - 1)) + 1;
+            if (port) {
+                break;
+            }
+        }
+    }
+    if (!port || sim.ports[port]) {
+        uv_mutex_unlock(&sim.lock);
+        DPS_ERRPRINT("Simulated port %d is not available\n", port);
+        free(netCtx);
+        return NULL;
+    }
+    r = uv_async_init(node->loop, &netCtx->async, OnAsync);
+    if (r) {
+        uv_mutex_unlock(&sim.lock);
+        DPS_ERRPRINT("uv_async_init failed - %s\n", uv_strerror(r));
+        free(netCtx);
+        return NULL;
+    }
+    netCtx->async.data = netCtx;
+    netCtx->port = port;
+    sim.ports[port] = netCtx;
+    sim.started = DPS_TRUE;
+    uv_mutex_unlock(&sim.lock);
+    return netCtx;
+}
+
+static void NetStop(DPS_NetTransportContext* netCtx)
+{
+    uv_mutex_lock(&sim.lock);
+    sim.ports[netCtx->port] = NULL;
+    uv_mutex_unlock(&sim.lock);
+    uv_close((uv_handle_t*)&netCtx->async, OnAsyncClosed);
+}
+
+static DPS_NodeAddress* NetGetListenAddress(DPS_NodeAddress* addr, DPS_NetTransportContext* netCtx)
+{
+    SetAddr(addr, netCtx->port);
+    return addr;
+}
+
+static DPS_Status NetSend(DPS_NetTransportContext* netCtx, void* appCtx, DPS_NetEndpoint* endpoint,
+                          uv_buf_t* bufs, size_t numBufs,
+                          DPS_NetSendComplete sendCompleteCB)
+{
+    DPS_NetRxBuffer* buf;
+    SendRequest* req;
+    SimMsg* msg;
+    LinkState* ls;
+    uint64_t start;
+    uint64_t now;
+    uint8_t* pos;
+    uint16_t dst;
+    uint8_t type;
+    size_t len = 0;
+    size_t i;
+
+    dst = GetPort(&endpoint->addr);
+    if (!dst) {
+        return DPS_ERR_INVALID;
+    }
+    for (i = 0; i < numBufs; ++i) {
+        len += bufs[i].len;
+    }
+    req = malloc(sizeof(SendRequest) + (numBufs - 1) * sizeof(uv_buf_t));
+    msg = malloc(sizeof(SimMsg));
+    buf = DPS_CreateNetRxBuffer(len);
+    if (!req || !msg || !buf) {
+        free(req);
+        free(msg);
+        if (buf) {
+            DPS_NetRxBufferDecRef(buf);
+        }
+        return DPS_ERR_RESOURCES;
+    }
+    pos = buf->data;
+    for (i = 0; i < numBufs; ++i) {
+        if (bufs[i].len) {
+            memcpy(pos, bufs[i].base, bufs[i].len);
+            pos += bufs[i].len;
+        }
+    }
+    type = MessageType(buf->data, len);
+    req->next = NULL;
+    req->appCtx = appCtx;
+    req->ep = *endpoint;
+    req->sendCompleteCB = sendCompleteCB;
+    req->numBufs = numBufs;
+    memcpy(req->bufs, bufs, numBufs * sizeof(uv_buf_t));
+
+    uv_mutex_lock(&sim.lock);
+    ++netCtx->stats.sent[type];
+    netCtx->stats.sentBytes[type] += len;
+    ++sim.stats.sent[type];
+    sim.stats.sentBytes[type] += len;
+    sim.lastActivity = uv_hrtime();
+    sim.idle = DPS_FALSE;
+    now = Now(sim.lastActivity);
+    ls = GetLink(netCtx, dst);
+    if (ls && ls->link.loss && (Random(&ls->rng) % 1000000) < ls->link.loss) {
+        ++netCtx->stats.lost;
+        ++sim.stats.lost;
+        DPS_NetRxBufferDecRef(buf);
+        free(msg);
+    } else {
+        msg->src = netCtx->port;
+        msg->dst = dst;
+        msg->buf = buf;
+        msg->order = ((uint64_t)netCtx->port << 48) | (netCtx->seq++ & 0xFFFFFFFFFFFFull);
+        msg->deliverAt = now;
+        if (ls) {
+            start = now;
+            if (ls->link.bandwidth) {
+                if (ls->busyUntil > start) {
+                    start = ls->busyUntil;
+                }
+                ls->busyUntil = start + ((uint64_t)len * 8000) / ls->link.bandwidth;
+                start = ls->busyUntil;
+            }
+            msg->deliverAt = start + ls->link.latency;
+            if (ls->link.jitter) {
+                msg->deliverAt += Random(&ls->rng) % ((uint64_t)ls->link.jitter + 1);
+            }
+        }
+        if (!HeapPush(msg)) {
+            DPS_NetRxBufferDecRef(buf);
+            free(msg);
+        }
+    }
+    if (netCtx->txTail) {
+        netCtx->txTail->next = req;
+    } else {
+        netCtx->txHead = req;
+    }
+    netCtx->txTail = req;
+    uv_cond_signal(&sim.cond);
+    uv_mutex_unlock(&sim.lock);
+    uv_async_send(&netCtx->async);
+    return DPS_OK;
+}
+
+static void ConnectionIncRef(DPS_NetConnection* cn)
+{
+}
+
+static void ConnectionDecRef(DPS_NetConnection* cn)
+{
+}
+
+const DPS_NetTransport DPS_SimTransport = {
+    "sim",
+    DPS_UDP,
+    NetStart,
+    NetGetListenAddress,
+    NetStop,
+    NetSend,
+    ConnectionIncRef,
+    ConnectionDecRef,
+    NULL
+};
+
+DPS_MulticastReceiver* DPS_MulticastStartReceive(DPS_Node* node, DPS_OnReceive cb)
+{
+    DPS_MulticastReceiver* receiver = NULL;
+
+    receiver = malloc(sizeof(DPS_MulticastReceiver));
+    if (receiver) {
+        receiver->node = node;
+        receiver->receiveCB = cb;
+    }
+    return receiver;
+}
+
+void DPS_MulticastStopReceive(DPS_MulticastReceiver* receiver)
+{
+    free(receiver);
+}
+
+DPS_MulticastSender* DPS_MulticastStartSend(DPS_Node* node)
+{
+    DPS_MulticastSender* sender = NULL;
+
+    sender = malloc(sizeof(DPS_MulticastSender));
+    if (sender) {
+        sender->node = node;
+    }
+    return sender;
+}
+
+void DPS_MulticastStopSend(DPS_MulticastSender* sender)
+{
+    free(sender);
+}
+
+DPS_Status DPS_MulticastSend(DPS_MulticastSender* sender, void* appCtx, uv_buf_t* bufs, size_t numBufs, DPS_MulticastSendComplete sendCompleteCB)
+{
+    return DPS_ERR_NOT_IMPLEMENTED;
+}
@@ -56,6 +56,23 @@ DPS_DEBUG_CONTROL(DPS_DEBUG_ON);
 
 #define DESCRIBE(n)  DPS_NodeAddrToString(&(n)->ep.addr)
 
+/*
+ * Layout of the unprotected map of a subscription acknowledgement
+ */
+typedef struct {
+    uint16_t port;
+    uint32_t revision;
+    CBOR_Span path;
+} SubAckUnprotected;
+
+enum { SAK_PORT, SAK_REVISION, SAK_PATH };
+
+static const CBOR_MapField SubAckUnprotectedFields[] = {
+    CBOR_MAP_FIELD(DPS_CBOR_KEY_PORT, UINT16, CBOR_FIELD_OPTIONAL, SubAckUnprotected, port),
+    CBOR_MAP_FIELD(DPS_CBOR_KEY_ACK_SEQ_NUM, UINT32, 0, SubAckUnprotected, revision),
+    CBOR_MAP_FIELD(DPS_CBOR_KEY_PATH, STRING, CBOR_FIELD_OPTIONAL, SubAckUnprotected, path)
+};
+
 #define DPS_SUB_FLAG_DELTA_IND  0x01      /* Indicate interests is a delta */
 #define DPS_SUB_FLAG_MUTE_IND   0x02      /* Mute has been indicated */
 
@@ -139,6 +156,7 @@ static DPS_Subscription* FreeSubscription(DPS_Subscription* sub)
          * This removes this subscription's contributions to the interests and needs
          */
         if (unlinked) {
+            DPS_TopicTrieRemove(&node->topicTrie, sub, node->separators);
             if (DPS_CountVectorDel(node->interests, sub->bf) != DPS_OK) {
                 assert(!"Count error");
             }
@@ -235,8 +253,37 @@ DPS_Status DPS_DestroySubscription(DPS_Subscription* sub)
 int _DPS_NumSubs = 0;
 #endif
 
+/*
+ * The local bit length and number of hashes are sent with the
+ * interests so the remote can fold the interests it sends to us.
+ *
+ * Nodes that predate these keys fail to parse a map with unknown keys
+ * after the last key they want, so the keys are only sent when the
+ * parameters are not the compiled defaults. A remote that does not
+ * send them is assumed to be using the defaults.
+ */
+#define NUM_BLOOM_PARAMS()  (DPS_BitVectorIsDefaultConfig() ? 0 : 2)
+
+static DPS_Status EncodeBloomParams(DPS_TxBuffer* buf)
+{
+    DPS_Status ret;
+
+    ret = CBOR_EncodeUint8(buf, DPS_CBOR_KEY_BIT_LEN);
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint32(buf, (uint32_t)DPS_BitVectorLinkLen(0));
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint8(buf, DPS_CBOR_KEY_NUM_HASHES);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint8(buf, DPS_BitVectorNumHashes());
+    }
+    return ret;
+}
+
 DPS_Status DPS_SendSubscription(DPS_Node* node, RemoteNode* remote)
 {
+    const DPS_NodeAddress* listenAddr;
     DPS_Status ret;
     DPS_TxBuffer buf;
     DPS_BitVector* interests;
@@ -248,6 +295,7 @@ DPS_Status DPS_SendSubscription(DPS_Node* node, RemoteNode* remote)
     if (!node->netCtx) {
         return DPS_ERR_NETWORK;
     }
+    listenAddr = DPS_ListenAddressFor(node, &remote->ep);
 #ifdef DPS_DEBUG
     ++_DPS_NumSubs;
 #endif
@@ -269,25 +317,28 @@ DPS_Status DPS_SendSubscription(DPS_Node* node, RemoteNode* remote)
      */
     len += CBOR_SIZEOF_MAP(2) + 2 * CBOR_SIZEOF(uint8_t) +
            CBOR_SIZEOF(uint32_t);  /* seq_num */
-    switch (node->addr.type) {
+    switch (listenAddr->type) {
     case DPS_DTLS:
     case DPS_TCP:
     case DPS_UDP:
         len += CBOR_SIZEOF(uint16_t); /* port */
         break;
     case DPS_PIPE:
-        len += CBOR_SIZEOF_STRING(node->addr.u.path); /* path */
+    case DPS_SHM:
+        len += CBOR_SIZEOF_STRING(listenAddr->u.path); /* path */
         break;
     default:
         return DPS_ERR_INVALID;
     }
     if (!remote->unlink) {
         interests = remote->outbound.deltaInd ? remote->outbound.delta : remote->outbound.interests;
-        len += 4 * CBOR_SIZEOF(uint8_t) +
+        len += 6 * CBOR_SIZEOF(uint8_t) +
                CBOR_SIZEOF(uint8_t) +
                CBOR_SIZEOF_BYTES(sizeof(DPS_UUID)) +
                DPS_BitVectorSerializeMaxSize(interests) +
-               DPS_BitVectorSerializeFHSize();
+               DPS_BitVectorSerializeFHSize() +
+               CBOR_SIZEOF(uint32_t) + /* bit_len */
+               CBOR_SIZEOF(uint8_t);   /* num_hashes */
 
     } else {
         interests = NULL;
@@ -312,9 +363,9 @@ DPS_Status DPS_SendSubscription(DPS_Node* node, RemoteNode* remote)
      * Encode the unprotected map
      */
     if (ret == DPS_OK) {
-        ret = CBOR_EncodeMap(&buf, remote->unlink ? 2 : 6);
+        ret = CBOR_EncodeMap(&buf, remote->unlink ? 2 : 6 + NUM_BLOOM_PARAMS());
     }
-    switch (node->addr.type) {
+    switch (listenAddr->type) {
     case DPS_DTLS:
     case DPS_TCP:
     case DPS_UDP:
@@ -323,7 +374,7 @@ DPS_Status DPS_SendSubscription(DPS_Node* node, RemoteNode* remote)
         }
         if (ret == DPS_OK) {
             ret = CBOR_EncodeUint16(&buf,
-                                    DPS_NetAddrPort((const struct sockaddr*)&node->addr.u.inaddr));
+                                    DPS_NetAddrPort((const struct sockaddr*)&listenAddr->u.inaddr));
         }
         break;
     default:
@@ -365,18 +416,22 @@ DPS_Status DPS_SendSubscription(DPS_Node* node, RemoteNode* remote)
             ret = DPS_BitVectorSerialize(interests, &buf);
         }
     }
-    switch (node->addr.type) {
+    switch (listenAddr->type) {
     case DPS_PIPE:
+    case DPS_SHM:
         if (ret == DPS_OK) {
             ret = CBOR_EncodeUint8(&buf, DPS_CBOR_KEY_PATH);
         }
         if (ret == DPS_OK) {
-            ret = CBOR_EncodeString(&buf, node->addr.u.path);
+            ret = CBOR_EncodeString(&buf, listenAddr->u.path);
         }
         break;
     default:
         break;
     }
+    if (!remote->unlink && NUM_BLOOM_PARAMS() && (ret == DPS_OK)) {
+        ret = EncodeBloomParams(&buf);
+    }
     /*
      * Encode the (empty) protected map
      */
@@ -400,6 +455,7 @@ DPS_Status DPS_SendSubscription(DPS_Node* node, RemoteNode* remote)
                 --remote->outbound.ackCountdown;
             } else {
                 remote->outbound.ackCountdown = 1 + DPS_MAX_SUBSCRIPTION_RETRIES;
+                remote->outbound.sendTime = uv_now(node->loop);
             }
             assert(remote->outbound.ackCountdown);
         } else {
@@ -414,6 +470,7 @@ DPS_Status DPS_SendSubscription(DPS_Node* node, RemoteNode* remote)
 
 static DPS_Status SendSubscriptionAck(DPS_Node* node, RemoteNode* remote, uint32_t revision, int includeSub)
 {
+    const DPS_NodeAddress* listenAddr;
     DPS_Status ret;
     DPS_TxBuffer buf;
     DPS_BitVector* interests;
@@ -425,6 +482,7 @@ static DPS_Status SendSubscriptionAck(DPS_Node* node, RemoteNode* remote, uint32
     if (!node->netCtx) {
         return DPS_ERR_NETWORK;
     }
+    listenAddr = DPS_ListenAddressFor(node, &remote->ep);
 
     /*
      * Set flags
@@ -444,14 +502,15 @@ static DPS_Status SendSubscriptionAck(DPS_Node* node, RemoteNode* remote, uint32
      */
     len += CBOR_SIZEOF_MAP(2) + 2 * CBOR_SIZEOF(uint8_t) +
         CBOR_SIZEOF(uint32_t);  /* ack_seq_num */
-    switch (node->addr.type) {
+    switch (listenAddr->type) {
     case DPS_DTLS:
     case DPS_TCP:
     case DPS_UDP:
         len += CBOR_SIZEOF(uint16_t); /* port */
         break;
     case DPS_PIPE:
-        len += CBOR_SIZEOF_STRING(node->addr.u.path); /* path */
+    case DPS_SHM:
+        len += CBOR_SIZEOF_STRING(listenAddr->u.path); /* path */
         break;
     default:
         return DPS_ERR_INVALID;
@@ -459,11 +518,13 @@ static DPS_Status SendSubscriptionAck(DPS_Node* node, RemoteNode* remote, uint32
     if (includeSub) {
         len += CBOR_SIZEOF(uint8_t) + CBOR_SIZEOF(uint32_t);
         interests = remote->outbound.deltaInd ? remote->outbound.delta : remote->outbound.interests;
-        len += 4 * CBOR_SIZEOF(uint8_t) +
+        len += 6 * CBOR_SIZEOF(uint8_t) +
             CBOR_SIZEOF(uint8_t) +
             CBOR_SIZEOF_BYTES(sizeof(DPS_UUID)) +
             DPS_BitVectorSerializeMaxSize(interests) +
-            DPS_BitVectorSerializeMaxSize(remote->outbound.needs);
+            DPS_BitVectorSerializeMaxSize(remote->outbound.needs) +
+            CBOR_SIZEOF(uint32_t) + /* bit_len */
+            CBOR_SIZEOF(uint8_t);   /* num_hashes */
     } else {
         interests = NULL;
     }
@@ -487,9 +548,9 @@ static DPS_Status SendSubscriptionAck(DPS_Node* node, RemoteNode* remote, uint32
      * Encode the unprotected map
      */
     if (ret == DPS_OK) {
-        ret = CBOR_EncodeMap(&buf, includeSub ? 7 : 2);
+        ret = CBOR_EncodeMap(&buf, includeSub ? 7 + NUM_BLOOM_PARAMS() : 2);
     }
-    switch (node->addr.type) {
+    switch (listenAddr->type) {
     case DPS_DTLS:
     case DPS_TCP:
     case DPS_UDP:
@@ -498,7 +559,7 @@ static DPS_Status SendSubscriptionAck(DPS_Node* node, RemoteNode* remote, uint32
         }
         if (ret == DPS_OK) {
             ret = CBOR_EncodeUint16(&buf,
-                                    DPS_NetAddrPort((const struct sockaddr*)&node->addr.u.inaddr));
+                                    DPS_NetAddrPort((const struct sockaddr*)&listenAddr->u.inaddr));
         }
         break;
     default:
@@ -546,18 +607,22 @@ static DPS_Status SendSubscriptionAck(DPS_Node* node, RemoteNode* remote, uint32
     if (ret == DPS_OK) {
         ret = CBOR_EncodeUint32(&buf, revision);
     }
-    switch (node->addr.type) {
+    switch (listenAddr->type) {
     case DPS_PIPE:
+    case DPS_SHM:
         if (ret == DPS_OK) {
             ret = CBOR_EncodeUint8(&buf, DPS_CBOR_KEY_PATH);
         }
         if (ret == DPS_OK) {
-            ret = CBOR_EncodeString(&buf, node->addr.u.path);
+            ret = CBOR_EncodeString(&buf, listenAddr->u.path);
         }
         break;
     default:
         break;
     }
+    if (includeSub && NUM_BLOOM_PARAMS() && (ret == DPS_OK)) {
+        ret = EncodeBloomParams(&buf);
+    }
     /*
      * Encode the (empty) protected map
      */
@@ -582,6 +647,7 @@ static DPS_Status SendSubscriptionAck(DPS_Node* node, RemoteNode* remote, uint32
                     --remote->outbound.ackCountdown;
                 } else {
                     remote->outbound.ackCountdown = 1 + DPS_MAX_SUBSCRIPTION_RETRIES;
+                    remote->outbound.sendTime = uv_now(node->loop);
                 }
                 assert(remote->outbound.ackCountdown);
             }
@@ -596,9 +662,11 @@ static DPS_Status SendSubscriptionAck(DPS_Node* node, RemoteNode* remote, uint32
 }
 
 /*
- * Update the interests for a remote node
+ * Update the interests for a remote node. The interests that were added
+ * are returned in node->scratch.added.
  */
-static DPS_Status UpdateInboundInterests(DPS_Node* node, RemoteNode* remote, DPS_BitVector* interests, DPS_BitVector* needs, int isDelta)
+static DPS_Status UpdateInboundInterests(DPS_Node* node, RemoteNode* remote, DPS_BitVector* interests, DPS_BitVector* needs,
+                                         int isDelta, int* needsRelaxed)
 {
     DPS_DBGTRACE();
 
@@ -607,7 +675,16 @@ static DPS_Status UpdateInboundInterests(DPS_Node* node, RemoteNode* remote, DPS
             DPS_DBGPRINT("Received interests delta\n");
             DPS_BitVectorXor(interests, interests, remote->inbound.interests, NULL);
         }
+        /*
+         * Added interests are the bits in the new interests that are not in the old
+         */
+        DPS_BitVectorXor(node->scratch.added, interests, remote->inbound.interests, NULL);
+        DPS_BitVectorIntersection(node->scratch.added, node->scratch.added, interests);
+        *needsRelaxed = !DPS_BitVectorIncludes(needs, remote->inbound.needs);
         DPS_ClearInboundInterests(node, remote);
+    } else {
+        DPS_BitVectorDup(node->scratch.added, interests);
+        *needsRelaxed = DPS_TRUE;
     }
     if (DPS_BitVectorIsClear(interests)) {
         DPS_BitVectorFree(interests);
@@ -618,6 +695,7 @@ static DPS_Status UpdateInboundInterests(DPS_Node* node, RemoteNode* remote, DPS
         remote->inbound.interests = interests;
         remote->inbound.needs = needs;
     }
+    DPS_SampleLoadFactor(&remote->bloomStats.inbound, &node->bloomStats.inbound, remote->inbound.interests);
 
     if (DPS_DEBUG_ENABLED()) {
         DPS_DBGPRINT("New inbound interests from %s: ", DESCRIBE(remote));
@@ -630,7 +708,8 @@ static DPS_Status UpdateInboundInterests(DPS_Node* node, RemoteNode* remote, DPS
 DPS_Status DPS_DecodeSubscription(DPS_Node* node, DPS_NetEndpoint* ep, DPS_NetRxBuffer* buf)
 {
     static const int32_t NeedKeys[] = { DPS_CBOR_KEY_SEQ_NUM };
-    static const int32_t WantKeys[] = { DPS_CBOR_KEY_PORT, DPS_CBOR_KEY_SUB_FLAGS, DPS_CBOR_KEY_MESH_ID, DPS_CBOR_KEY_NEEDS, DPS_CBOR_KEY_INTERESTS, DPS_CBOR_KEY_PATH };
+    static const int32_t WantKeys[] = { DPS_CBOR_KEY_PORT, DPS_CBOR_KEY_SUB_FLAGS, DPS_CBOR_KEY_MESH_ID, DPS_CBOR_KEY_NEEDS, DPS_CBOR_KEY_INTERESTS, DPS_CBOR_KEY_PATH,
+                                        DPS_CBOR_KEY_BIT_LEN, DPS_CBOR_KEY_NUM_HASHES };
     static const int32_t WantKeysMask = (1 << DPS_CBOR_KEY_SUB_FLAGS) | (1 << DPS_CBOR_KEY_MESH_ID) | (1 << DPS_CBOR_KEY_NEEDS) | (1 << DPS_CBOR_KEY_INTERESTS);
     DPS_RxBuffer* rxBuf = (DPS_RxBuffer*)buf;
     DPS_Status ret;
@@ -642,8 +721,12 @@ DPS_Status DPS_DecodeSubscription(DPS_Node* node, DPS_NetEndpoint* ep, DPS_NetRx
     CBOR_MapState mapState;
     DPS_UUID meshId;
     uint8_t flags = 0;
+    uint32_t bitLen = 0;
+    uint8_t numHashes = 0;
     uint16_t keysMask;
     int remoteIsNew = DPS_FALSE;
+    int updatePubs = DPS_FALSE;
+    int needsRelaxed = DPS_FALSE;
     char* path = NULL;
     size_t pathLen = 0;
 
@@ -713,6 +796,12 @@ DPS_Status DPS_DecodeSubscription(DPS_Node* node, DPS_NetEndpoint* ep, DPS_NetRx
                 ret = DPS_ERR_INVALID;
             }
             break;
+        case DPS_CBOR_KEY_BIT_LEN:
+            ret = CBOR_DecodeUint32(rxBuf, &bitLen);
+            break;
+        case DPS_CBOR_KEY_NUM_HASHES:
+            ret = CBOR_DecodeUint8(rxBuf, &numHashes);
+            break;
         }
         if (ret != DPS_OK) {
             break;
@@ -722,6 +811,17 @@ DPS_Status DPS_DecodeSubscription(DPS_Node* node, DPS_NetEndpoint* ep, DPS_NetRx
         DPS_WARNPRINT("Missing required key\n");
         ret = DPS_ERR_INVALID;
     }
+    if ((keysMask & (1 << DPS_CBOR_KEY_INTERESTS)) && !bitLen && !numHashes) {
+        DPS_BitVectorDefaultConfig(&bitLen, &numHashes);
+    }
+    /*
+     * Bit vectors can be folded to a different length but there is
+     * no way to reconcile a different number of hashes.
+     */
+    if (numHashes && (numHashes != DPS_BitVectorNumHashes())) {
+        DPS_WARNPRINT("Remote is configured with %d hashes, expected %d\n", numHashes, DPS_BitVectorNumHashes());
+        ret = DPS_ERR_INVALID;
+    }
     if (ret != DPS_OK) {
         DPS_BitVectorFree(interests);
         DPS_BitVectorFree(needs);
@@ -803,6 +903,13 @@ DPS_Status DPS_DecodeSubscription(DPS_Node* node, DPS_NetEndpoint* ep, DPS_NetRx
         goto DiscardAndExit;
     }
     remote->inbound.revision = revision;
+    /*
+     * If the remote's bit length changed the interests we send will be
+     * folded to a different length, see DPS_UpdateOutboundInterests().
+     */
+    if (bitLen) {
+        remote->inbound.bitLen = bitLen;
+    }
 
     DPS_DBGPRINT("Node %s received mesh id %08x from %s\n", node->addrStr, UUID_32(&meshId),
                  DESCRIBE(remote));
@@ -830,13 +937,8 @@ DPS_Status DPS_DecodeSubscription(DPS_Node* node, DPS_NetEndpoint* ep, DPS_NetRx
     if (!remote->outbound.muted) {
         int isDelta = (flags & DPS_SUB_FLAG_DELTA_IND) != 0;
         memcpy_s(&remote->inbound.meshId, sizeof(remote->inbound.meshId), &meshId, sizeof(DPS_UUID));
-        ret = UpdateInboundInterests(node, remote, interests, needs, isDelta);
-        /*
-         * Evaluate impact of the change in interests
-         */
-        if (ret == DPS_OK) {
-            DPS_UpdatePubs(node);
-        }
+        ret = UpdateInboundInterests(node, remote, interests, needs, isDelta, &needsRelaxed);
+        updatePubs = (ret == DPS_OK);
     } else {
         DPS_BitVectorFree(interests);
         DPS_BitVectorFree(needs);
@@ -856,6 +958,17 @@ DPS_Status DPS_DecodeSubscription(DPS_Node* node, DPS_NetEndpoint* ep, DPS_NetRx
         }
         ret = SendSubscriptionAck(node, remote, revision, remote->outbound.includeSub);
     }
+    /*
+     * Evaluate impact of the change in interests after the ACK so the
+     * remote node sees the subscription acknowledged before any replayed
+     * retained publications.
+     */
+    if ((ret == DPS_OK) && updatePubs) {
+        ret = DPS_UpdatePubs(node, remote, node->scratch.added, needsRelaxed);
+        if (ret != DPS_OK) {
+            DPS_DeleteRemoteNode(node, remote);
+        }
+    }
     DPS_UnlockNode(node);
     DPS_UpdateSubs(node);
     return ret;
@@ -873,18 +986,13 @@ DiscardAndExit:
 
 DPS_Status DPS_DecodeSubscriptionAck(DPS_Node* node, DPS_NetEndpoint* ep, DPS_NetRxBuffer* buf)
 {
-    static const int32_t UnprotectedKeys[] = { DPS_CBOR_KEY_ACK_SEQ_NUM };
-    static const int32_t UnprotectedOptKeys[] = { DPS_CBOR_KEY_PORT, DPS_CBOR_KEY_PATH };
     DPS_RxBuffer* rxBuf = (DPS_RxBuffer*)buf;
     uint8_t* rxPos;
     DPS_Status ret;
-    uint16_t port;
-    uint32_t revision = 0;
+    uint32_t revision;
     RemoteNode* remote = NULL;
-    CBOR_MapState mapState;
-    char* path = NULL;
-    size_t pathLen;
-    uint16_t keysMask;
+    SubAckUnprotected hdr;
+    uint32_t found;
 
     DPS_DBGTRACE();
 
@@ -898,53 +1006,25 @@ DPS_Status DPS_DecodeSubscriptionAck(DPS_Node* node, DPS_NetEndpoint* ep, DPS_Ne
     /*
      * Parse keys from unprotected map
      */
-    ret = DPS_ParseMapInit(&mapState, rxBuf, UnprotectedKeys, A_SIZEOF(UnprotectedKeys),
-                           UnprotectedOptKeys, A_SIZEOF(UnprotectedOptKeys));
+    ret = DPS_ParseMapFields(rxBuf, SubAckUnprotectedFields, A_SIZEOF(SubAckUnprotectedFields), &hdr, &found);
     if (ret != DPS_OK) {
         return ret;
     }
-    keysMask = 0;
-    while (!DPS_ParseMapDone(&mapState)) {
-        int32_t key;
-        ret = DPS_ParseMapNext(&mapState, &key);
-        if (ret != DPS_OK) {
-            break;
-        }
-        switch (key) {
-        case DPS_CBOR_KEY_PORT:
-            keysMask |= (1 << key);
-            ret = CBOR_DecodeUint16(rxBuf, &port);
-            break;
-        case DPS_CBOR_KEY_ACK_SEQ_NUM:
-            ret = CBOR_DecodeUint32(rxBuf, &revision);
-            break;
-        case DPS_CBOR_KEY_PATH:
-            keysMask |= (1 << key);
-            ret = CBOR_DecodeString(rxBuf, &path, &pathLen);
-            if ((ret == DPS_OK) && (pathLen >= DPS_NODE_ADDRESS_PATH_MAX)) {
-                ret = DPS_ERR_INVALID;
-            }
-            break;
-        }
-        if (ret != DPS_OK) {
-            break;
-        }
-    }
-    if (ret != DPS_OK) {
-        return ret;
-    }
-    if ((keysMask & ((1 << DPS_CBOR_KEY_PORT) | (1 << DPS_CBOR_KEY_PATH))) == 0) {
+    if ((found & ((1 << SAK_PORT) | (1 << SAK_PATH))) == 0) {
         DPS_WARNPRINT("Missing required key\n");
         return DPS_ERR_INVALID;
     }
+    if ((found & (1 << SAK_PATH)) && (hdr.path.len >= DPS_NODE_ADDRESS_PATH_MAX)) {
+        return DPS_ERR_INVALID;
+    }
+    revision = hdr.revision;
     /*
      * Record which port the sender is listening on
      */
-    if (keysMask & (1 << DPS_CBOR_KEY_PORT)) {
-        DPS_EndpointSetPort(ep, port);
+    if (found & (1 << SAK_PORT)) {
+        DPS_EndpointSetPort(ep, hdr.port);
     } else {
-        assert(keysMask & (1 << DPS_CBOR_KEY_PATH));
-        DPS_EndpointSetPath(ep, path, pathLen);
+        DPS_EndpointSetPath(ep, (char*)hdr.path.data, hdr.path.len);
     }
 #if SIMULATE_PACKET_LOSS
     /*
@@ -960,6 +1040,17 @@ DPS_Status DPS_DecodeSubscriptionAck(DPS_Node* node, DPS_NetEndpoint* ep, DPS_Ne
     DPS_LockNode(node);
     remote = DPS_LookupRemoteNode(node, &ep->addr);
     if (remote && remote->outbound.revision == revision) {
+        /*
+         * Only sample the round trip time if the subscription was not resent
+         */
+        if (remote->outbound.ackCountdown >= DPS_MAX_SUBSCRIPTION_RETRIES) {
+            uint32_t rtt = (uint32_t)(uv_now(node->loop) - remote->outbound.sendTime);
+            if (remote->outbound.rtt) {
+                remote->outbound.rtt = (7 * remote->outbound.rtt + rtt) / 8;
+            } else {
+                remote->outbound.rtt = rtt ? rtt : 1;
+            }
+        }
         remote->outbound.includeSub = DPS_FALSE;
         remote->outbound.ackCountdown = 0;
         if (remote->completion) {
@@ -1017,6 +1108,14 @@ DPS_Status DPS_Subscribe(DPS_Subscription* sub, DPS_PublicationHandler handler)
      * Protect the node while we update it
      */
     DPS_LockNode(node);
+    /*
+     * Compile the topics into the trie used to match publications
+     */
+    ret = DPS_TopicTrieAdd(&node->topicTrie, sub, node->separators);
+    if (ret != DPS_OK) {
+        DPS_UnlockNode(node);
+        return ret;
+    }
     /*
      * We don't need a mesh id for this node until we have local subscriptions
      */
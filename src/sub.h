@@ -43,6 +43,12 @@ extern "C" {
  */
 #define DPS_MAX_SUBSCRIPTION_RETRIES  8
 
+/**
+ * Limit on the exponent of the hold off time between subscription
+ * updates to a remote node, see DPS_UpdateOutboundInterests()
+ */
+#define DPS_MAX_SUBSCRIPTION_BACKOFF  4
+
 #define SUB_FLAG_WAS_FREED      (0x01) /**< The subscription has been freed but has a non-zero ref count */
 #define SUB_FLAG_EXPIRED        (0x02) /**< Issue the callback function when a matching publication expires */
 
@@ -60,6 +66,8 @@ typedef struct _DPS_Subscription {
     DPS_Node* node;                 /**< Node for this subscription */
     uint32_t refCount;              /**< Ref count to prevent subscription from being freed while in use */
     uint8_t flags;                  /**< Internal state flags */
+    uint32_t matchGen;              /**< Generation of the last topic trie match that matched any topics */
+    size_t numMatched;              /**< Number of topics matched in that generation */
     DPS_Subscription* next;         /**< Next subscription in list */
     size_t numTopics;               /**< Number of subscription topics */
     char* topics[1];                /**< Subscription topics */
@@ -55,6 +55,8 @@ typedef struct _SendRequest {
 } SendRequest;
 
 typedef struct _DPS_NetConnection {
+    const DPS_NetTransport* transport; /* must be first, see DPS_NetTransport */
+    DPS_NetTransportContext* netCtx;
     DPS_Node* node;
     uv_tcp_t socket;
     DPS_NetEndpoint peerEp;
@@ -69,14 +71,41 @@ typedef struct _DPS_NetConnection {
     DPS_Queue sendQueue;
     DPS_Queue sendCompletedQueue;
     uv_idle_t idle;
+    /* Connection pool */
+    DPS_Queue poolQueue; /* Link in the idle pool, empty if the connection is not idle */
+    uint64_t idleSince;
+    int noReuse;         /* The connection has failed and must not be pooled */
 } DPS_NetConnection;
 
-struct _DPS_NetContext {
+struct _DPS_NetTransportContext {
     uv_tcp_t socket;   /* the listen socket */
     DPS_Node* node;
     DPS_OnReceive receiveCB;
+    uv_timer_t idleTimer; /* Closes connections that have been idle too long */
+    DPS_Queue idlePool;   /* Idle connections, least recently used first */
+    size_t numIdle;
+    int numHandles;
 };
 
+/*
+ * Connections no longer referenced by the upper layer are kept open for
+ * reuse by later sends to the same address. They are closed after
+ * being idle for IDLE_TIMEOUT msecs or, least recently used first, when
+ * there are more than MAX_IDLE_CONNECTIONS.
+ */
+#define IDLE_TIMEOUT          (30 * 1000)
+#define MAX_IDLE_CONNECTIONS  32
+
+#define POOL_CONNECTION(q)  ((DPS_NetConnection*)((uint8_t*)(q) - offsetof(DPS_NetConnection, poolQueue)))
+
+#ifdef DPS_DEBUG
+int _DPS_NumTcpConnects = 0;
+int _DPS_NumTcpPoolReuses = 0;
+#endif
+
+static void ConnectionIncRef(DPS_NetConnection* cn);
+static void ConnectionDecRef(DPS_NetConnection* cn);
+
 #define MIN_BUF_ALLOC_SIZE   512
 #define MIN_READ_SIZE        CBOR_SIZEOF(uint32_t)
 
@@ -93,10 +122,14 @@ static void AllocBuffer(uv_handle_t* handle, size_t suggestedSize, uv_buf_t* buf
     }
 }
 
-static void ListenSocketClosed(uv_handle_t* handle)
+static void HandleClosed(uv_handle_t* handle)
 {
+    DPS_NetTransportContext* netCtx = (DPS_NetTransportContext*)handle->data;
+
     DPS_DBGPRINT("Closed handle %p\n", handle);
-    free(handle->data);
+    if (--netCtx->numHandles == 0) {
+        free(netCtx);
+    }
 }
 
 static void CancelPendingSends(DPS_NetConnection* cn)
@@ -167,8 +200,30 @@ static void OnShutdownComplete(uv_shutdown_t* req, int status)
     }
 }
 
+static void PoolRemove(DPS_NetConnection* cn)
+{
+    if (!DPS_QueueEmpty(&cn->poolQueue)) {
+        DPS_QueueRemove(&cn->poolQueue);
+        DPS_QueueInit(&cn->poolQueue);
+        --cn->netCtx->numIdle;
+    }
+}
+
+static DPS_NetConnection* PoolLookup(DPS_NetTransportContext* netCtx, const DPS_NodeAddress* addr)
+{
+    DPS_Queue* q;
+
+    for (q = DPS_QueueFront(&netCtx->idlePool); q != &netCtx->idlePool; q = q->next) {
+        if (DPS_SameAddr(&POOL_CONNECTION(q)->peerEp.addr, addr)) {
+            return POOL_CONNECTION(q);
+        }
+    }
+    return NULL;
+}
+
 static void Shutdown(DPS_NetConnection* cn)
 {
+    PoolRemove(cn);
     if (!cn->shutdownReq.data) {
         int r;
         assert(cn->refCount == 0);
@@ -185,17 +240,80 @@ static void Shutdown(DPS_NetConnection* cn)
     }
 }
 
+static void OnIdleTimer(uv_timer_t* timer);
+
+static void StartIdleTimer(DPS_NetTransportContext* netCtx)
+{
+    DPS_NetConnection* cn;
+    uint64_t now;
+    uint64_t timeout = 0;
+
+    if (DPS_QueueEmpty(&netCtx->idlePool)) {
+        uv_timer_stop(&netCtx->idleTimer);
+        return;
+    }
+    cn = POOL_CONNECTION(DPS_QueueFront(&netCtx->idlePool));
+    now = uv_now(netCtx->node->loop);
+    if ((cn->idleSince + IDLE_TIMEOUT) > now) {
+        timeout = cn->idleSince + IDLE_TIMEOUT - now;
+    }
+    uv_timer_start(&netCtx->idleTimer, OnIdleTimer, timeout, 0);
+}
+
+static void OnIdleTimer(uv_timer_t* timer)
+{
+    DPS_NetTransportContext* netCtx = (DPS_NetTransportContext*)timer->data;
+    DPS_NetConnection* cn;
+    uint64_t now = uv_now(timer->loop);
+
+    while (!DPS_QueueEmpty(&netCtx->idlePool)) {
+        cn = POOL_CONNECTION(DPS_QueueFront(&netCtx->idlePool));
+        if ((now - cn->idleSince) < IDLE_TIMEOUT) {
+            break;
+        }
+        DPS_DBGPRINT("Closing idle connection to %s\n", DPS_NodeAddrToString(&cn->peerEp.addr));
+        Shutdown(cn);
+    }
+    StartIdleTimer(netCtx);
+}
+
+/*
+ * Called when the upper layer no longer references a connection
+ */
+static void ConnectionIdle(DPS_NetConnection* cn)
+{
+    DPS_NetTransportContext* netCtx = cn->netCtx;
+
+    assert(cn->refCount == 0);
+    /*
+     * The node network context will be null if we are shutting down
+     */
+    if (!cn->node->netCtx || cn->noReuse || cn->shutdownReq.data) {
+        Shutdown(cn);
+        return;
+    }
+    PoolRemove(cn);
+    cn->idleSince = uv_now(cn->node->loop);
+    DPS_QueuePushBack(&netCtx->idlePool, &cn->poolQueue);
+    if (++netCtx->numIdle > MAX_IDLE_CONNECTIONS) {
+        Shutdown(POOL_CONNECTION(DPS_QueueFront(&netCtx->idlePool)));
+    }
+    if (!uv_is_active((uv_handle_t*)&netCtx->idleTimer)) {
+        StartIdleTimer(netCtx);
+    }
+}
+
 static void OnData(uv_stream_t* socket, ssize_t nread, const uv_buf_t* buf)
 {
     DPS_Status ret = DPS_OK;
     DPS_NetConnection* cn = (DPS_NetConnection*)socket->data;
-    DPS_NetContext* netCtx = cn->node->netCtx;
+    DPS_NetTransportContext* netCtx = cn->netCtx;
 
     DPS_DBGTRACE();
     /*
-     * netCtx will be null if we are shutting down
+     * The node network context will be null if we are shutting down
      */
-    if (!netCtx) {
+    if (!cn->node->netCtx) {
         return;
     }
     /*
@@ -206,7 +324,11 @@ static void OnData(uv_stream_t* socket, ssize_t nread, const uv_buf_t* buf)
     }
     if (nread < 0) {
         uv_read_stop(socket);
+        cn->noReuse = DPS_TRUE;
         netCtx->receiveCB(cn->node, &cn->peerEp, nread == UV_EOF ? DPS_ERR_EOF : DPS_ERR_NETWORK, NULL);
+        if (cn->refCount == 0) {
+            Shutdown(cn);
+        }
         return;
     }
     assert(socket == (uv_stream_t*)&cn->socket);
@@ -270,19 +392,20 @@ static void OnData(uv_stream_t* socket, ssize_t nread, const uv_buf_t* buf)
      */
     if (ret != DPS_OK) {
         uv_read_stop(socket);
+        cn->noReuse = DPS_TRUE;
     }
     /*
-     * Shutdown the connection if the upper layer didn't IncRef to keep it alive
+     * Pool the connection if the upper layer didn't IncRef to keep it alive
      */
     if (cn->refCount == 0) {
-        Shutdown(cn);
+        ConnectionIdle(cn);
     }
 }
 
 static void OnIncomingConnection(uv_stream_t* stream, int status)
 {
     int ret;
-    DPS_NetContext* netCtx = (DPS_NetContext*)stream->data;
+    DPS_NetTransportContext* netCtx = (DPS_NetTransportContext*)stream->data;
     DPS_NetConnection* cn;
     int sz = sizeof(cn->peerEp.addr.u.inaddr);
 
@@ -307,11 +430,14 @@ static void OnIncomingConnection(uv_stream_t* stream, int status)
         free(cn);
         goto FailConnection;
     }
+    cn->transport = &DPS_TcpTransport;
+    cn->netCtx = netCtx;
     cn->node = netCtx->node;
     cn->socket.data = cn;
     cn->peerEp.cn = cn;
     DPS_QueueInit(&cn->sendQueue);
     DPS_QueueInit(&cn->sendCompletedQueue);
+    DPS_QueueInit(&cn->poolQueue);
     uv_idle_init(stream->loop, &cn->idle);
     cn->idle.data = cn;
 
@@ -367,14 +493,14 @@ static int GetScopeId(struct sockaddr_in6* addr)
 
 #define LISTEN_BACKLOG  2
 
-DPS_NetContext* DPS_NetStart(DPS_Node* node, const DPS_NodeAddress* addr, DPS_OnReceive cb)
+static DPS_NetTransportContext* NetStart(DPS_Node* node, const DPS_NodeAddress* addr, DPS_OnReceive cb)
 {
     int ret;
-    DPS_NetContext* netCtx;
+    DPS_NetTransportContext* netCtx;
     struct sockaddr* sa;
     DPS_NodeAddress any;
 
-    netCtx = calloc(1, sizeof(DPS_NetContext));
+    netCtx = calloc(1, sizeof(DPS_NetTransportContext));
     if (!netCtx) {
         return NULL;
     }
@@ -384,6 +510,12 @@ DPS_NetContext* DPS_NetStart(DPS_Node* node, const DPS_NodeAddress* addr, DPS_On
         free(netCtx);
         return NULL;
     }
+    netCtx->socket.data = netCtx;
+    ++netCtx->numHandles;
+    uv_timer_init(node->loop, &netCtx->idleTimer);
+    netCtx->idleTimer.data = netCtx;
+    ++netCtx->numHandles;
+    DPS_QueueInit(&netCtx->idlePool);
     netCtx->node = node;
     netCtx->receiveCB = cb;
     if (addr) {
@@ -398,7 +530,6 @@ DPS_NetContext* DPS_NetStart(DPS_Node* node, const DPS_NodeAddress* addr, DPS_On
     if (ret) {
         goto ErrorExit;
     }
-    netCtx->socket.data = netCtx;
     ret = uv_listen((uv_stream_t*)&netCtx->socket, LISTEN_BACKLOG, OnIncomingConnection);
     if (ret) {
         goto ErrorExit;
@@ -415,12 +546,12 @@ DPS_NetContext* DPS_NetStart(DPS_Node* node, const DPS_NodeAddress* addr, DPS_On
 ErrorExit:
 
     DPS_ERRPRINT("Failed to start net netCtx: error=%s\n", uv_err_name(ret));
-    netCtx->socket.data = netCtx;
-    uv_close((uv_handle_t*)&netCtx->socket, ListenSocketClosed);
+    uv_close((uv_handle_t*)&netCtx->idleTimer, HandleClosed);
+    uv_close((uv_handle_t*)&netCtx->socket, HandleClosed);
     return NULL;
 }
 
-DPS_NodeAddress* DPS_NetGetListenAddress(DPS_NodeAddress* addr, DPS_NetContext* netCtx)
+static DPS_NodeAddress* NetGetListenAddress(DPS_NodeAddress* addr, DPS_NetTransportContext* netCtx)
 {
     int len;
 
@@ -439,11 +570,14 @@ DPS_NodeAddress* DPS_NetGetListenAddress(DPS_NodeAddress* addr, DPS_NetContext*
     return addr;
 }
 
-void DPS_NetStop(DPS_NetContext* netCtx)
+static void NetStop(DPS_NetTransportContext* netCtx)
 {
     if (netCtx) {
-        netCtx->socket.data = netCtx;
-        uv_close((uv_handle_t*)&netCtx->socket, ListenSocketClosed);
+        while (!DPS_QueueEmpty(&netCtx->idlePool)) {
+            Shutdown(POOL_CONNECTION(DPS_QueueFront(&netCtx->idlePool)));
+        }
+        uv_close((uv_handle_t*)&netCtx->idleTimer, HandleClosed);
+        uv_close((uv_handle_t*)&netCtx->socket, HandleClosed);
     }
 }
 
@@ -460,7 +594,7 @@ static void OnWriteComplete(uv_write_t* writeReq, int status)
     }
     DPS_QueuePushBack(&cn->sendCompletedQueue, &req->queue);
     SendCompleted(cn);
-    DPS_NetConnectionDecRef(cn);
+    ConnectionDecRef(cn);
 }
 
 static void DoSend(DPS_NetConnection* cn)
@@ -472,7 +606,7 @@ static void DoSend(DPS_NetConnection* cn)
         int r = uv_write(&req->writeReq, (uv_stream_t*)&cn->socket, req->bufs, (uint32_t)req->numBufs,
                          OnWriteComplete);
         if (r == 0) {
-            DPS_NetConnectionIncRef(cn);
+            ConnectionIncRef(cn);
         } else {
             DPS_ERRPRINT("DoSend - write failed: %s\n", uv_err_name(r));
             req->status = DPS_ERR_NETWORK;
@@ -493,20 +627,70 @@ static void OnOutgoingConnection(uv_connect_t *req, int status)
     } else {
         DPS_ERRPRINT("OnOutgoingConnection - connect %s failed: %s\n", DPS_NodeAddrToString(&cn->peerEp.addr),
                      uv_err_name(status));
-        assert(!DPS_QueueEmpty(&cn->sendQueue));
+        cn->noReuse = DPS_TRUE;
         CancelPendingSends(cn);
     }
     SendCompleted(cn);
+    /*
+     * A pre-warmed connection is not referenced until it is used
+     */
+    if ((cn->refCount == 0) && cn->noReuse) {
+        Shutdown(cn);
+    }
 }
 
-DPS_Status DPS_NetSend(DPS_Node* node, void* appCtx, DPS_NetEndpoint* ep, uv_buf_t* bufs,
-                       size_t numBufs, DPS_NetSendComplete sendCompleteCB)
+static DPS_NetConnection* Connect(DPS_NetTransportContext* netCtx, DPS_NodeAddress* addr)
+{
+    DPS_Node* node = netCtx->node;
+    DPS_NetConnection* cn;
+    int r;
+
+    cn = calloc(1, sizeof(DPS_NetConnection));
+    if (!cn) {
+        return NULL;
+    }
+    r = uv_tcp_init(node->loop, &cn->socket);
+    if (r) {
+        free(cn);
+        return NULL;
+    }
+#ifdef DPS_DEBUG
+    ++_DPS_NumTcpConnects;
+#endif
+    cn->peerEp.addr = *addr;
+    cn->transport = &DPS_TcpTransport;
+    cn->netCtx = netCtx;
+    cn->node = node;
+    DPS_QueueInit(&cn->sendQueue);
+    DPS_QueueInit(&cn->sendCompletedQueue);
+    DPS_QueueInit(&cn->poolQueue);
+    uv_idle_init(node->loop, &cn->idle);
+    cn->idle.data = cn;
+
+    if (addr->u.inaddr.ss_family == AF_INET6) {
+        struct sockaddr_in6* in6 = (struct sockaddr_in6*)&addr->u.inaddr;
+        if (!in6->sin6_scope_id) {
+            in6->sin6_scope_id = GetScopeId(in6);
+        }
+    }
+    cn->connectReq.data = cn;
+    r = uv_tcp_connect(&cn->connectReq, &cn->socket, (struct sockaddr*)&addr->u.inaddr, OnOutgoingConnection);
+    if (r) {
+        DPS_ERRPRINT("uv_tcp_connect %s error=%s\n", DPS_NodeAddrToString(addr), uv_err_name(r));
+        cn->socket.data = cn;
+        uv_close((uv_handle_t*)&cn->socket, StreamClosed);
+        return NULL;
+    }
+    cn->peerEp.cn = cn;
+    return cn;
+}
+
+static DPS_Status NetSend(DPS_NetTransportContext* netCtx, void* appCtx, DPS_NetEndpoint* ep, uv_buf_t* bufs,
+                          size_t numBufs, DPS_NetSendComplete sendCompleteCB)
 {
     DPS_Status ret;
     DPS_TxBuffer lenBuf;
     SendRequest* req;
-    uv_handle_t* socket = NULL;
-    int r;
     size_t i;
     size_t len = 0;
 
@@ -542,6 +726,20 @@ DPS_Status DPS_NetSend(DPS_Node* node, void* appCtx, DPS_NetEndpoint* ep, uv_buf
     req->numBufs = numBufs + 1;
     req->onSendComplete = sendCompleteCB;
     req->appCtx = appCtx;
+    /*
+     * Reuse an idle connection to the same address. The reference is
+     * released with the endpoint, the same as for a new connection.
+     */
+    if (!ep->cn) {
+        ep->cn = PoolLookup(netCtx, &ep->addr);
+        if (ep->cn) {
+            DPS_DBGPRINT("Reusing idle connection to %s\n", DPS_NodeAddrToString(&ep->addr));
+#ifdef DPS_DEBUG
+            ++_DPS_NumTcpPoolReuses;
+#endif
+            ConnectionIncRef(ep->cn);
+        }
+    }
     /*
      * See if we already have a connection
      */
@@ -560,73 +758,71 @@ DPS_Status DPS_NetSend(DPS_Node* node, void* appCtx, DPS_NetEndpoint* ep, uv_buf
         return DPS_OK;
     }
 
-    ep->cn = calloc(1, sizeof(DPS_NetConnection));
+    ep->cn = Connect(netCtx, &ep->addr);
     if (!ep->cn) {
         goto ErrExit;
     }
-    r = uv_tcp_init(node->loop, &ep->cn->socket);
-    if (r) {
-        goto ErrExit;
-    }
-    ep->cn->peerEp.addr = ep->addr;
-    ep->cn->node = node;
-    DPS_QueueInit(&ep->cn->sendQueue);
-    DPS_QueueInit(&ep->cn->sendCompletedQueue);
-    uv_idle_init(node->loop, &ep->cn->idle);
-    ep->cn->idle.data = ep->cn;
-    socket = (uv_handle_t*)&ep->cn->socket;
-
-    if (ep->addr.u.inaddr.ss_family == AF_INET6) {
-        struct sockaddr_in6* in6 = (struct sockaddr_in6*)&ep->addr.u.inaddr;
-        if (!in6->sin6_scope_id) {
-            in6->sin6_scope_id = GetScopeId(in6);
-        }
-    }
-    ep->cn->connectReq.data = ep->cn;
-    r = uv_tcp_connect(&ep->cn->connectReq, &ep->cn->socket, (struct sockaddr*)&ep->addr.u.inaddr,
-                       OnOutgoingConnection);
-    if (r) {
-        DPS_ERRPRINT("uv_tcp_connect %s error=%s\n", DPS_NodeAddrToString(&ep->addr), uv_err_name(r));
-        goto ErrExit;
-    }
-    ep->cn->peerEp.cn = ep->cn;
     DPS_QueuePushBack(&ep->cn->sendQueue, &req->queue);
     req->cn = ep->cn;
-    DPS_NetConnectionIncRef(ep->cn);
+    ConnectionIncRef(ep->cn);
     return DPS_OK;
 
 ErrExit:
 
-    if (req) {
-        free(req);
+    free(req);
+    return DPS_ERR_NETWORK;
+}
+
+static DPS_Status NetPrewarm(DPS_NetTransportContext* netCtx, const DPS_NodeAddress* addr)
+{
+    DPS_NodeAddress connectAddr = *addr;
+    DPS_NetConnection* cn;
+
+    if (PoolLookup(netCtx, addr)) {
+        return DPS_ERR_EXISTS;
     }
-    if (socket) {
-        socket->data = ep->cn;
-        uv_close(socket, StreamClosed);
-    } else {
-        if (ep->cn) {
-            free(ep->cn);
-        }
+    DPS_DBGPRINT("Pre-warming connection to %s\n", DPS_NodeAddrToString(addr));
+    cn = Connect(netCtx, &connectAddr);
+    if (!cn) {
+        return DPS_ERR_NETWORK;
     }
-    ep->cn = NULL;
-    return DPS_ERR_NETWORK;
+    /*
+     * The connection is pooled while connecting, libuv holds any
+     * writes until the connection is up
+     */
+    ConnectionIdle(cn);
+    return DPS_OK;
 }
 
-void DPS_NetConnectionIncRef(DPS_NetConnection* cn)
+static void ConnectionIncRef(DPS_NetConnection* cn)
 {
     if (cn) {
         DPS_DBGTRACE();
-        ++cn->refCount;
+        if (++cn->refCount == 1) {
+            PoolRemove(cn);
+        }
     }
 }
 
-void DPS_NetConnectionDecRef(DPS_NetConnection* cn)
+static void ConnectionDecRef(DPS_NetConnection* cn)
 {
     if (cn) {
         DPS_DBGTRACE();
         assert(cn->refCount > 0);
         if (--cn->refCount == 0) {
-            Shutdown(cn);
+            ConnectionIdle(cn);
         }
     }
 }
+
+const DPS_NetTransport DPS_TcpTransport = {
+    "tcp",
+    DPS_TCP,
+    NetStart,
+    NetGetListenAddress,
+    NetStop,
+    NetSend,
+    ConnectionIncRef,
+    ConnectionDecRef,
+    NetPrewarm
+};
@@ -192,8 +192,12 @@ DPS_Status DPS_AddTopic(DPS_BitVector* bf, const char* topic, const char* separa
 int DPS_MatchTopic(DPS_BitVector* bf, const char* topic, const char* separators)
 {
     int match = DPS_FALSE;
-    DPS_BitVector* tmp = DPS_BitVectorAlloc();
+    DPS_BitVector* tmp;
 
+    if (!bf) {
+        return DPS_FALSE;
+    }
+    tmp = DPS_BitVectorAllocLen(DPS_BitVectorLen(bf));
     if (tmp) {
         if (DPS_AddTopic(tmp, topic, separators, DPS_SubTopic) == DPS_OK) {
             match = DPS_BitVectorIncludes(bf, tmp);
@@ -0,0 +1,406 @@
+/*
+ *******************************************************************
+ *
+ * Copyright 2016 Intel Corporation All rights reserved.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ */
+
+#include <assert.h>
+#include <safe_lib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dps/dbg.h>
+#include "sub.h"
+#include "topictrie.h"
+
+/*
+ * Debug control for this module
+ */
+DPS_DEBUG_CONTROL(DPS_DEBUG_ON);
+
+#define FINAL_WILDC    '#'
+#define INFIX_WILDC    '+'
+#define WILDCARDS     "+#"
+
+#define MIN_CAPACITY   4
+
+/*
+ * Length of the key for the first segment of a topic
+ */
+static size_t KeyLen(const char* topic, const char* separators, size_t* segLen)
+{
+    size_t len = strcspn(topic, separators);
+
+    if (segLen) {
+        *segLen = len;
+    }
+    return topic[len] ? len + 1 : len;
+}
+
+static DPS_TopicTrieNode* AllocNode(const char* key, size_t keyLen)
+{
+    DPS_TopicTrieNode* node = calloc(1, sizeof(DPS_TopicTrieNode) + keyLen);
+
+    if (node && keyLen) {
+        if (memcpy_s(node->key, keyLen + 1, key, keyLen) != EOK) {
+            free(node);
+            return NULL;
+        }
+        node->keyLen = keyLen;
+    }
+    return node;
+}
+
+static void FreeNode(DPS_TopicTrieNode* node)
+{
+    uint32_t i;
+
+    for (i = 0; i < node->numChildren; ++i) {
+        FreeNode(node->children[i]);
+    }
+    free(node->children);
+    free(node->entries);
+    free(node);
+}
+
+static int CompareKey(const DPS_TopicTrieNode* node, const char* key, size_t keyLen)
+{
+    int cmp = memcmp(node->key, key, node->keyLen < keyLen ? node->keyLen : keyLen);
+
+    if (cmp == 0) {
+        cmp = (node->keyLen > keyLen) - (node->keyLen < keyLen);
+    }
+    return cmp;
+}
+
+/*
+ * Binary search for a child, returns the position of the child or the
+ * position to insert it at
+ */
+static int FindChild(const DPS_TopicTrieNode* node, const char* key, size_t keyLen, uint32_t* pos)
+{
+    uint32_t lo = 0;
+    uint32_t hi = node->numChildren;
+
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        int cmp = CompareKey(node->children[mid], key, keyLen);
+        if (cmp == 0) {
+            *pos = mid;
+            return DPS_TRUE;
+        }
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    *pos = lo;
+    return DPS_FALSE;
+}
+
+static DPS_TopicTrieNode* GetChild(const DPS_TopicTrieNode* node, const char* key, size_t keyLen)
+{
+    uint32_t pos;
+
+    return FindChild(node, key, keyLen, &pos) ? node->children[pos] : NULL;
+}
+
+static DPS_TopicTrieNode* AddChild(DPS_TopicTrieNode* node, const char* key, size_t keyLen)
+{
+    DPS_TopicTrieNode* child;
+    uint32_t pos;
+
+    if (FindChild(node, key, keyLen, &pos)) {
+        return node->children[pos];
+    }
+    if (node->numChildren == node->childCapacity) {
+        uint32_t capacity = node->childCapacity ? 2 * node->childCapacity : MIN_CAPACITY;
+        DPS_TopicTrieNode** children = realloc(node->children, capacity * sizeof(DPS_TopicTrieNode*));
+        if (!children) {
+            return NULL;
+        }
+        node->children = children;
+        node->childCapacity = capacity;
+    }
+    child = AllocNode(key, keyLen);
+    if (!child) {
+        return NULL;
+    }
+    memmove(&node->children[pos + 1], &node->children[pos], (node->numChildren - pos) * sizeof(DPS_TopicTrieNode*));
+    node->children[pos] = child;
+    ++node->numChildren;
+    return child;
+}
+
+static void RemoveChild(DPS_TopicTrieNode* node, uint32_t pos)
+{
+    FreeNode(node->children[pos]);
+    --node->numChildren;
+    memmove(&node->children[pos], &node->children[pos + 1], (node->numChildren - pos) * sizeof(DPS_TopicTrieNode*));
+    if (!node->numChildren) {
+        free(node->children);
+        node->children = NULL;
+        node->childCapacity = 0;
+    }
+}
+
+static DPS_Status AddEntry(DPS_TopicTrieNode* node, DPS_Subscription* sub)
+{
+    if (node->numEntries == node->entryCapacity) {
+        uint32_t capacity = node->entryCapacity ? 2 * node->entryCapacity : MIN_CAPACITY;
+        DPS_TopicTrieEntry* entries = realloc(node->entries, capacity * sizeof(DPS_TopicTrieEntry));
+        if (!entries) {
+            return DPS_ERR_RESOURCES;
+        }
+        node->entries = entries;
+        node->entryCapacity = capacity;
+    }
+    node->entries[node->numEntries].sub = sub;
+    node->entries[node->numEntries].generation = 0;
+    ++node->numEntries;
+    return DPS_OK;
+}
+
+/*
+ * Removes one entry for the subscription, a subscription with the same
+ * topic more than once has an entry for each
+ */
+static void RemoveEntry(DPS_TopicTrieNode* node, DPS_Subscription* sub)
+{
+    uint32_t i;
+
+    for (i = 0; i < node->numEntries; ++i) {
+        if (node->entries[i].sub == sub) {
+            node->entries[i] = node->entries[--node->numEntries];
+            break;
+        }
+    }
+    if (!node->numEntries) {
+        free(node->entries);
+        node->entries = NULL;
+        node->entryCapacity = 0;
+    }
+}
+
+#define IS_EMPTY(n)  (!(n)->numChildren && !(n)->numEntries)
+
+/*
+ * Removes the entry for a topic and then any nodes on the path to it
+ * that are left empty
+ */
+static void RemoveTopic(DPS_TopicTrieNode* node, const char* topic, const char* separators, DPS_Subscription* sub)
+{
+    size_t keyLen;
+    uint32_t pos;
+
+    if (!*topic) {
+        RemoveEntry(node, sub);
+        return;
+    }
+    keyLen = KeyLen(topic, separators, NULL);
+    if (FindChild(node, topic, keyLen, &pos)) {
+        DPS_TopicTrieNode* child = node->children[pos];
+        RemoveTopic(child, topic + keyLen, separators, sub);
+        if (IS_EMPTY(child)) {
+            RemoveChild(node, pos);
+        }
+    }
+}
+
+static void RemoveTopics(DPS_TopicTrie* trie, DPS_Subscription* sub, size_t numTopics, const char* separators)
+{
+    if (!trie->root) {
+        return;
+    }
+    while (numTopics--) {
+        RemoveTopic(trie->root, sub->topics[numTopics], separators, sub);
+    }
+    if (IS_EMPTY(trie->root)) {
+        FreeNode(trie->root);
+        trie->root = NULL;
+    }
+}
+
+DPS_Status DPS_TopicTrieAdd(DPS_TopicTrie* trie, DPS_Subscription* sub, const char* separators)
+{
+    DPS_Status ret = DPS_OK;
+    size_t i;
+
+    if (!trie->root) {
+        trie->root = AllocNode(NULL, 0);
+        if (!trie->root) {
+            return DPS_ERR_RESOURCES;
+        }
+    }
+    for (i = 0; i < sub->numTopics; ++i) {
+        DPS_TopicTrieNode* node = trie->root;
+        const char* topic = sub->topics[i];
+        while (node && *topic) {
+            size_t keyLen = KeyLen(topic, separators, NULL);
+            node = AddChild(node, topic, keyLen);
+            topic += keyLen;
+        }
+        if (!node) {
+            ret = DPS_ERR_RESOURCES;
+        } else {
+            ret = AddEntry(node, sub);
+        }
+        if (ret != DPS_OK) {
+            /*
+             * Removing the failed topic prunes any nodes that were
+             * added for it
+             */
+            RemoveTopics(trie, sub, i + 1, separators);
+            break;
+        }
+    }
+    return ret;
+}
+
+void DPS_TopicTrieRemove(DPS_TopicTrie* trie, DPS_Subscription* sub, const char* separators)
+{
+    RemoveTopics(trie, sub, sub->numTopics, separators);
+}
+
+static void MarkEntries(DPS_TopicTrie* trie, DPS_TopicTrieNode* node)
+{
+    uint32_t i;
+
+    for (i = 0; i < node->numEntries; ++i) {
+        DPS_TopicTrieEntry* entry = &node->entries[i];
+        /*
+         * A subscription topic is only counted once even if it matches
+         * more than one of the publication topics
+         */
+        if (entry->generation != trie->generation) {
+            DPS_Subscription* sub = entry->sub;
+            entry->generation = trie->generation;
+            if (sub->matchGen != trie->generation) {
+                sub->matchGen = trie->generation;
+                sub->numMatched = 0;
+            }
+            ++sub->numMatched;
+        }
+    }
+}
+
+static void MatchTopic(DPS_TopicTrie* trie, DPS_TopicTrieNode* node, const char* topic, const char* separators)
+{
+    DPS_TopicTrieNode* child;
+    const char* next;
+    size_t segLen;
+    size_t keyLen;
+    char wild[2];
+
+    keyLen = KeyLen(topic, separators, &segLen);
+    next = topic + keyLen;
+    /*
+     * The literal segment
+     */
+    child = GetChild(node, topic, keyLen);
+    if (child) {
+        if (*next) {
+            MatchTopic(trie, child, next, separators);
+        } else {
+            MarkEntries(trie, child);
+        }
+    }
+    /*
+     * An infix wildcard matches any segment followed by the same separator
+     */
+    wild[0] = INFIX_WILDC;
+    wild[1] = topic[segLen];
+    child = GetChild(node, wild, keyLen - segLen + 1);
+    if (child) {
+        if (*next) {
+            MatchTopic(trie, child, next, separators);
+        } else {
+            MarkEntries(trie, child);
+        }
+    }
+    /*
+     * A final wildcard matches the remainder of the topic starting with a
+     * non-empty segment
+     */
+    if (segLen) {
+        wild[0] = FINAL_WILDC;
+        child = GetChild(node, wild, 1);
+        if (child) {
+            MarkEntries(trie, child);
+        }
+    }
+}
+
+/*
+ * The same checks that are applied to publication topics by
+ * DPS_MatchTopicString()
+ */
+static int IsValidPubTopic(const char* topic, const char* separators)
+{
+    size_t len;
+
+    if (!topic || !topic[0]) {
+        return DPS_FALSE;
+    }
+    len = strcspn(topic, WILDCARDS);
+    if (topic[len]) {
+        return DPS_FALSE;
+    }
+    return strchr(separators, topic[len - 1]) == NULL;
+}
+
+DPS_Status DPS_TopicTrieMatch(DPS_TopicTrie* trie, char* const* topics, size_t numTopics, const char* separators)
+{
+    size_t i;
+
+    /*
+     * Start a new generation before checking the topics so nothing
+     * matched earlier can match an invalid publication. Generation zero
+     * is skipped so entries and subscriptions that have never been
+     * visited are not mistaken for matches.
+     */
+    if (++trie->generation == 0) {
+        ++trie->generation;
+    }
+    for (i = 0; i < numTopics; ++i) {
+        if (!IsValidPubTopic(topics[i], separators)) {
+            DPS_ERRPRINT("Invalid publication topic string\n");
+            return DPS_ERR_INVALID;
+        }
+    }
+    if (trie->root) {
+        for (i = 0; i < numTopics; ++i) {
+            MatchTopic(trie, trie->root, topics[i], separators);
+        }
+    }
+    return DPS_OK;
+}
+
+int DPS_TopicTrieMatched(const DPS_TopicTrie* trie, const DPS_Subscription* sub)
+{
+    return (sub->matchGen == trie->generation) && (sub->numMatched == sub->numTopics);
+}
+
+void DPS_TopicTrieFree(DPS_TopicTrie* trie)
+{
+    if (trie->root) {
+        FreeNode(trie->root);
+        trie->root = NULL;
+    }
+}
@@ -0,0 +1,143 @@
+/**
+ * @file
+ * Index of retained publications
+ */
+
+/*
+ *******************************************************************
+ *
+ * Copyright 2016 Intel Corporation All rights reserved.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ */
+
+#ifndef _DPS_TOPICTRIE_H
+#define _DPS_TOPICTRIE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <dps/dps.h>
+#include <dps/private/dps.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if !defined(DOXYGEN_SKIP_FORWARD_DECLARATION)
+typedef struct _DPS_TopicTrieNode DPS_TopicTrieNode;
+#endif
+
+/**
+ * A subscription topic that ends at a node of the trie
+ */
+typedef struct _DPS_TopicTrieEntry {
+    DPS_Subscription* sub;      /**< The subscription */
+    uint32_t generation;        /**< Used to count each topic once in DPS_TopicTrieMatch() */
+} DPS_TopicTrieEntry;
+
+/**
+ * A node of the trie. The key of a node is a topic segment together
+ * with the separator that follows it, or just the segment if it is the
+ * last one in the topic, so topics that only differ in their
+ * separators do not share nodes. Wildcard segments are keyed the same
+ * way as any other segment.
+ */
+struct _DPS_TopicTrieNode {
+    DPS_TopicTrieNode** children; /**< Child nodes sorted by key */
+    uint32_t numChildren;         /**< Number of child nodes */
+    uint32_t childCapacity;       /**< Capacity of the children array */
+    DPS_TopicTrieEntry* entries;  /**< Subscription topics that end at this node */
+    uint32_t numEntries;          /**< Number of entries */
+    uint32_t entryCapacity;       /**< Capacity of the entries array */
+    size_t keyLen;                /**< Length of the key */
+    char key[1];                  /**< The key, not NUL terminated */
+};
+
+/**
+ * The topics of the subscriptions of a node compiled into a trie of
+ * topic segments. Matching a publication topic walks the trie once,
+ * following the literal segment and any '+' and '#' wildcard edges at
+ * each level, so the cost of matching does not depend on the number of
+ * subscriptions.
+ */
+typedef struct _DPS_TopicTrie {
+    DPS_TopicTrieNode* root;    /**< The root node, allocated when the first topic is added */
+    uint32_t generation;        /**< Incremented by each call to DPS_TopicTrieMatch() */
+} DPS_TopicTrie;
+
+/**
+ * Add the topics of a subscription to the trie. The topics must
+ * already have been validated.
+ *
+ * @param trie        The trie
+ * @param sub         The subscription
+ * @param separators  The separator characters of the node
+ *
+ * @return DPS_OK or DPS_ERR_RESOURCES, in which case none of the topics
+ *         are added
+ */
+DPS_Status DPS_TopicTrieAdd(DPS_TopicTrie* trie, DPS_Subscription* sub, const char* separators);
+
+/**
+ * Remove the topics of a subscription from the trie. This is a no-op
+ * for topics that are not in the trie.
+ *
+ * @param trie        The trie
+ * @param sub         The subscription
+ * @param separators  The separator characters of the node
+ */
+void DPS_TopicTrieRemove(DPS_TopicTrie* trie, DPS_Subscription* sub, const char* separators);
+
+/**
+ * Match publication topics against the subscriptions in the trie. A
+ * subscription matches if each of its topics matches one of the
+ * publication topics, use DPS_TopicTrieMatched() to check.
+ *
+ * @param trie        The trie
+ * @param topics      The publication topics
+ * @param numTopics   The number of publication topics
+ * @param separators  The separator characters of the node
+ *
+ * @return
+ * - DPS_OK if the topics were matched
+ * - DPS_ERR_INVALID if a publication topic is not valid, no subscriptions match
+ */
+DPS_Status DPS_TopicTrieMatch(DPS_TopicTrie* trie, char* const* topics, size_t numTopics, const char* separators);
+
+/**
+ * Check if a subscription matched the publication topics of the most
+ * recent call to DPS_TopicTrieMatch()
+ *
+ * @param trie  The trie
+ * @param sub   The subscription
+ *
+ * @return DPS_TRUE if the subscription matched
+ */
+int DPS_TopicTrieMatched(const DPS_TopicTrie* trie, const DPS_Subscription* sub);
+
+/**
+ * Free resources allocated for the trie
+ *
+ * @param trie  The trie
+ */
+void DPS_TopicTrieFree(DPS_TopicTrie* trie);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -36,7 +36,7 @@ DPS_DEBUG_CONTROL(DPS_DEBUG_ON);
 
 #define MAX_READ_LEN   65536
 
-struct _DPS_NetContext {
+struct _DPS_NetTransportContext {
     uv_udp_t rxSocket;
     DPS_Node* node;
     DPS_OnReceive receiveCB;
@@ -63,7 +63,7 @@ static void RxHandleClosed(uv_handle_t* handle)
 static void OnData(uv_udp_t* socket, ssize_t nread, const uv_buf_t* uvBuf, const struct sockaddr* addr,
                    unsigned flags)
 {
-    DPS_NetContext* netCtx = (DPS_NetContext*)socket->data;
+    DPS_NetTransportContext* netCtx = (DPS_NetTransportContext*)socket->data;
     DPS_NetRxBuffer* buf = NULL;
     DPS_NetEndpoint ep;
 
@@ -98,14 +98,14 @@ Exit:
     DPS_NetRxBufferDecRef(buf);
 }
 
-DPS_NetContext* DPS_NetStart(DPS_Node* node, const DPS_NodeAddress* addr, DPS_OnReceive cb)
+static DPS_NetTransportContext* NetStart(DPS_Node* node, const DPS_NodeAddress* addr, DPS_OnReceive cb)
 {
     int ret;
-    DPS_NetContext* netCtx;
+    DPS_NetTransportContext* netCtx;
     struct sockaddr* sa;
     DPS_NodeAddress any;
 
-    netCtx = calloc(1, sizeof(DPS_NetContext));
+    netCtx = calloc(1, sizeof(DPS_NetTransportContext));
     if (!netCtx) {
         return NULL;
     }
@@ -143,7 +143,7 @@ ErrorExit:
     return NULL;
 }
 
-DPS_NodeAddress* DPS_NetGetListenAddress(DPS_NodeAddress* addr, DPS_NetContext* netCtx)
+static DPS_NodeAddress* NetGetListenAddress(DPS_NodeAddress* addr, DPS_NetTransportContext* netCtx)
 {
     int len;
 
@@ -162,7 +162,7 @@ DPS_NodeAddress* DPS_NetGetListenAddress(DPS_NodeAddress* addr, DPS_NetContext*
     return addr;
 }
 
-void DPS_NetStop(DPS_NetContext* netCtx)
+static void NetStop(DPS_NetTransportContext* netCtx)
 {
     if (netCtx) {
         uv_udp_recv_stop(&netCtx->rxSocket);
@@ -180,11 +180,11 @@ typedef struct {
     DPS_NetSendComplete onSendComplete;
     size_t numBufs;
     uv_buf_t bufs[1];
-} NetSend;
+} SendRequest;
 
 static void OnSendComplete(uv_udp_send_t* req, int status)
 {
-    NetSend* send = (NetSend*)req->data;
+    SendRequest* send = (SendRequest*)req->data;
     DPS_Status dpsRet = DPS_OK;
 
     if (status) {
@@ -195,10 +195,12 @@ static void OnSendComplete(uv_udp_send_t* req, int status)
     free(send);
 }
 
-DPS_Status DPS_NetSend(DPS_Node* node, void* appCtx, DPS_NetEndpoint* ep, uv_buf_t* bufs, size_t numBufs, DPS_NetSendComplete sendCompleteCB)
+static DPS_Status NetSend(DPS_NetTransportContext* netCtx, void* appCtx, DPS_NetEndpoint* ep, uv_buf_t* bufs,
+                          size_t numBufs, DPS_NetSendComplete sendCompleteCB)
 {
+    DPS_Node* node = netCtx->node;
     int ret;
-    NetSend* send;
+    SendRequest* send;
 
     DPS_DBGTRACEA("node=%p,appCtx=%p,ep={addr=%s,cn=%p},bufs=%p,numBufs=%p,sendCompleteCB=%p\n",
                   node, appCtx, DPS_NodeAddrToString(&ep->addr), ep->cn, bufs, numBufs, sendCompleteCB);
@@ -214,7 +216,7 @@ DPS_Status DPS_NetSend(DPS_Node* node, void* appCtx, DPS_NetEndpoint* ep, uv_buf
     }
 #endif
 
-    send = malloc(sizeof(NetSend) + (numBufs - 1) * sizeof(uv_buf_t));
+    send = malloc(sizeof(SendRequest) + (numBufs - 1) * sizeof(uv_buf_t));
     if (!send) {
         return DPS_ERR_RESOURCES;
     }
@@ -231,7 +233,7 @@ DPS_Status DPS_NetSend(DPS_Node* node, void* appCtx, DPS_NetEndpoint* ep, uv_buf
     memcpy_s(&inaddr, sizeof(inaddr), &ep->addr.u.inaddr, sizeof(ep->addr.u.inaddr));
     DPS_MapAddrToV6((struct sockaddr *)&inaddr);
 
-    ret = uv_udp_send(&send->sendReq, &node->netCtx->rxSocket, send->bufs, (uint32_t)numBufs,
+    ret = uv_udp_send(&send->sendReq, &netCtx->rxSocket, send->bufs, (uint32_t)numBufs,
                       (const struct sockaddr *)&inaddr, OnSendComplete);
     if (ret) {
         DPS_ERRPRINT("DPS_NetSend status=%s\n", uv_err_name(ret));
@@ -241,12 +243,24 @@ DPS_Status DPS_NetSend(DPS_Node* node, void* appCtx, DPS_NetEndpoint* ep, uv_buf
     return DPS_OK;
 }
 
-void DPS_NetConnectionIncRef(DPS_NetConnection* cn)
+static void ConnectionIncRef(DPS_NetConnection* cn)
 {
     /* No-op for udp */
 }
 
-void DPS_NetConnectionDecRef(DPS_NetConnection* cn)
+static void ConnectionDecRef(DPS_NetConnection* cn)
 {
     /* No-op for udp */
 }
+
+const DPS_NetTransport DPS_UdpTransport = {
+    "udp",
+    DPS_UDP,
+    NetStart,
+    NetGetListenAddress,
+    NetStop,
+    NetSend,
+    ConnectionIncRef,
+    ConnectionDecRef,
+    NULL
+};
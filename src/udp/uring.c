@@ -0,0 +1,778 @@
+/*
+ *******************************************************************
+ *
+ * Copyright 2016 Intel Corporation All rights reserved.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ */
+
+/*
+ * UDP transport using io_uring on Linux.
+ *
+ * Datagrams are received by a single multishot receive into a ring of
+ * buffers registered with the kernel, so there is no readiness
+ * notification or read syscall per datagram. Sends are queued as
+ * submission queue entries and submitted together once per loop
+ * iteration, so fanning a publication out to many remote nodes costs a
+ * single syscall. The ring is polled for completions from the node's
+ * libuv loop.
+ *
+ * The libuv UDP transport is used instead if io_uring is disabled for
+ * the node or the kernel does not support the features required.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <safe_lib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <dps/dbg.h>
+#include <dps/dps.h>
+#include <dps/private/network.h>
+#include "../node.h"
+
+/*
+ * Debug control for this module
+ */
+DPS_DEBUG_CONTROL(DPS_DEBUG_ON);
+
+#define MAX_READ_LEN     65536
+#define RING_ENTRIES     256
+#define NUM_RX_BUFS      32     /* Must be a power of 2 */
+#define RX_BUF_GROUP     0
+#define RX_BUF_LEN       (sizeof(struct io_uring_recvmsg_out) + sizeof(struct sockaddr_in6) + MAX_READ_LEN)
+
+/*
+ * Buffers held in a send request without a separate allocation
+ */
+#define SEND_BUFS        8
+
+/*
+ * Maximum number of send requests kept for reuse
+ */
+#define MAX_FREE_SENDS   64
+
+/*
+ * The user data of the receive and cancel requests, send requests use
+ * the address of the request
+ */
+#define RECV_USER_DATA   0
+#define CANCEL_USER_DATA 1
+
+typedef struct _SendRequest {
+    struct _SendRequest* next;       /* Next send request in the free list */
+    DPS_Node* node;
+    void* appCtx;
+    DPS_NetEndpoint peerEp;
+    DPS_NetSendComplete onSendComplete;
+    struct msghdr msg;
+    struct sockaddr_storage addr;
+    size_t numBufs;
+    uv_buf_t* bufs;                  /* Points to inlineBufs unless there are more than SEND_BUFS */
+    uv_buf_t inlineBufs[SEND_BUFS];
+} SendRequest;
+
+struct _DPS_NetTransportContext {
+    DPS_Node* node;
+    DPS_OnReceive receiveCB;
+    DPS_NetTransportContext* udpCtx; /* The libuv transport if io_uring is not used */
+    uv_udp_t socket;
+    int fd;                          /* The socket file descriptor */
+    uv_poll_t poll;                  /* Polls the ring for completions */
+    uv_prepare_t prepare;            /* Submits queued requests before the loop blocks */
+    int numHandles;                  /* Handles that have not been closed yet */
+    int ringFd;
+    void* ringMem;
+    size_t ringMemLen;
+    struct io_uring_sqe* sqes;
+    size_t sqesLen;
+    uint32_t sqEntries;
+    uint32_t sqMask;
+    uint32_t* sqHead;
+    uint32_t* sqTail;
+    uint32_t* sqFlags;
+    uint32_t* sqArray;
+    uint32_t cqMask;
+    uint32_t* cqHead;
+    uint32_t* cqTail;
+    struct io_uring_cqe* cqes;
+    uint32_t toSubmit;               /* Queued entries not submitted yet */
+    uint32_t inFlight;               /* Requests submitted that have not completed */
+    struct io_uring_buf_ring* bufRing;
+    uint16_t bufTail;
+    uint8_t* rxBufs;
+    struct msghdr rxMsg;             /* Template for the multishot receive */
+    int stopping;
+    SendRequest* freeSends;          /* Send requests available for reuse */
+    size_t numFreeSends;
+};
+
+static int RingSetup(unsigned entries, struct io_uring_params* params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int RingEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0);
+}
+
+static int RingRegister(int fd, unsigned opcode, void* arg, unsigned numArgs)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, numArgs);
+}
+
+static void FreeRing(DPS_NetTransportContext* netCtx)
+{
+    if (netCtx->rxBufs) {
+        free(netCtx->rxBufs);
+        netCtx->rxBufs = NULL;
+    }
+    if (netCtx->bufRing) {
+        munmap(netCtx->bufRing, NUM_RX_BUFS * sizeof(struct io_uring_buf));
+        netCtx->bufRing = NULL;
+    }
+    if (netCtx->sqes) {
+        munmap(netCtx->sqes, netCtx->sqesLen);
+        netCtx->sqes = NULL;
+    }
+    if (netCtx->ringMem) {
+        munmap(netCtx->ringMem, netCtx->ringMemLen);
+        netCtx->ringMem = NULL;
+    }
+    if (netCtx->ringFd >= 0) {
+        close(netCtx->ringFd);
+        netCtx->ringFd = -1;
+    }
+}
+
+static void FreeContext(DPS_NetTransportContext* netCtx)
+{
+    FreeRing(netCtx);
+    while (netCtx->freeSends) {
+        SendRequest* send = netCtx->freeSends;
+        netCtx->freeSends = send->next;
+        free(send);
+    }
+    free(netCtx);
+}
+
+static void RecycleRxBuffer(DPS_NetTransportContext* netCtx, uint16_t bid)
+{
+    struct io_uring_buf* buf = &netCtx->bufRing->bufs[netCtx->bufTail & (NUM_RX_BUFS - 1)];
+
+    buf->addr = (uint64_t)(uintptr_t)(netCtx->rxBufs + (size_t)bid * RX_BUF_LEN);
+    buf->len = (uint32_t)RX_BUF_LEN;
+    buf->bid = bid;
+    ++netCtx->bufTail;
+    __atomic_store_n(&netCtx->bufRing->tail, netCtx->bufTail, __ATOMIC_RELEASE);
+}
+
+/*
+ * Multishot receive was added in the same kernel release as
+ * zero-copy send, which unlike receive flags can be probed for
+ */
+static int IsMultishotSupported(int fd)
+{
+    struct io_uring_probe* probe;
+    size_t len = sizeof(struct io_uring_probe) + IORING_OP_LAST * sizeof(struct io_uring_probe_op);
+    int supported = DPS_FALSE;
+
+    probe = calloc(1, len);
+    if (probe) {
+        if ((RingRegister(fd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) == 0) &&
+            (probe->last_op >= IORING_OP_SEND_ZC)) {
+            supported = (probe->ops[IORING_OP_SEND_ZC].flags & IO_URING_OP_SUPPORTED) ? DPS_TRUE : DPS_FALSE;
+        }
+        free(probe);
+    }
+    return supported;
+}
+
+static DPS_Status RingInit(DPS_NetTransportContext* netCtx)
+{
+    struct io_uring_params params;
+    struct io_uring_buf_reg reg;
+    size_t cqLen;
+    uint8_t* ring;
+    uint16_t i;
+
+    memzero_s(&params, sizeof(params));
+    netCtx->ringFd = RingSetup(RING_ENTRIES, &params);
+    if (netCtx->ringFd < 0) {
+        DPS_DBGPRINT("io_uring_setup failed: %s\n", strerror(errno));
+        return DPS_ERR_NOT_IMPLEMENTED;
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP) ||
+        !IsMultishotSupported(netCtx->ringFd)) {
+        DPS_DBGPRINT("io_uring does not support multishot receive\n");
+        return DPS_ERR_NOT_IMPLEMENTED;
+    }
+    /*
+     * The submission and completion queue rings share a single mapping
+     */
+    netCtx->ringMemLen = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    cqLen = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (cqLen > netCtx->ringMemLen) {
+        netCtx->ringMemLen = cqLen;
+    }
+    ring = mmap(NULL, netCtx->ringMemLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, netCtx->ringFd,
+                IORING_OFF_SQ_RING);
+    if (ring == MAP_FAILED) {
+        return DPS_ERR_RESOURCES;
+    }
+    netCtx->ringMem = ring;
+    netCtx->sqesLen = params.sq_entries * sizeof(struct io_uring_sqe);
+    netCtx->sqes = mmap(NULL, netCtx->sqesLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, netCtx->ringFd,
+                        IORING_OFF_SQES);
+    if (netCtx->sqes == MAP_FAILED) {
+        netCtx->sqes = NULL;
+        return DPS_ERR_RESOURCES;
+    }
+    netCtx->sqEntries = params.sq_entries;
+    netCtx->sqMask = *(uint32_t*)(ring + params.sq_off.ring_mask);
+    netCtx->sqHead = (uint32_t*)(ring + params.sq_off.head);
+    netCtx->sqTail = (uint32_t*)(ring + params.sq_off.tail);
+    netCtx->sqFlags = (uint32_t*)(ring + params.sq_off.flags);
+    netCtx->sqArray = (uint32_t*)(ring + params.sq_off.array);
+    netCtx->cqMask = *(uint32_t*)(ring + params.cq_off.ring_mask);
+    netCtx->cqHead = (uint32_t*)(ring + params.cq_off.head);
+    netCtx->cqTail = (uint32_t*)(ring + params.cq_off.tail);
+    netCtx->cqes = (struct io_uring_cqe*)(ring + params.cq_off.cqes);
+    /*
+     * Submission queue entries are always used in order
+     */
+    for (i = 0; i < netCtx->sqEntries; ++i) {
+        netCtx->sqArray[i] = i;
+    }
+    /*
+     * Register the receive buffers with the kernel
+     */
+    netCtx->bufRing = mmap(NULL, NUM_RX_BUFS * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (netCtx->bufRing == MAP_FAILED) {
+        netCtx->bufRing = NULL;
+        return DPS_ERR_RESOURCES;
+    }
+    netCtx->rxBufs = malloc(NUM_RX_BUFS * RX_BUF_LEN);
+    if (!netCtx->rxBufs) {
+        return DPS_ERR_RESOURCES;
+    }
+    memzero_s(&reg, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)netCtx->bufRing;
+    reg.ring_entries = NUM_RX_BUFS;
+    reg.bgid = RX_BUF_GROUP;
+    if (RingRegister(netCtx->ringFd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        DPS_DBGPRINT("Registering buffer ring failed: %s\n", strerror(errno));
+        return DPS_ERR_NOT_IMPLEMENTED;
+    }
+    for (i = 0; i < NUM_RX_BUFS; ++i) {
+        RecycleRxBuffer(netCtx, i);
+    }
+    netCtx->rxMsg.msg_namelen = sizeof(struct sockaddr_in6);
+    return DPS_OK;
+}
+
+static int Submit(DPS_NetTransportContext* netCtx)
+{
+    int ret = 0;
+
+    if (netCtx->toSubmit) {
+        ret = RingEnter(netCtx->ringFd, netCtx->toSubmit, 0, 0);
+        if (ret < 0) {
+            ret = -errno;
+            /*
+             * Busy means completions must be reaped first, the entries
+             * will be submitted on the next loop iteration
+             */
+            if ((ret != -EBUSY) && (ret != -EAGAIN) && (ret != -EINTR)) {
+                DPS_ERRPRINT("io_uring_enter failed: %s\n", strerror(-ret));
+            }
+        } else {
+            netCtx->toSubmit -= ret;
+        }
+    }
+    if (!netCtx->toSubmit) {
+        uv_prepare_stop(&netCtx->prepare);
+    }
+    return ret;
+}
+
+static void OnPrepare(uv_prepare_t* handle)
+{
+    Submit((DPS_NetTransportContext*)handle->data);
+}
+
+static struct io_uring_sqe* GetSqe(DPS_NetTransportContext* netCtx)
+{
+    struct io_uring_sqe* sqe;
+    uint32_t tail = *netCtx->sqTail;
+
+    if ((tail - __atomic_load_n(netCtx->sqHead, __ATOMIC_ACQUIRE)) >= netCtx->sqEntries) {
+        /*
+         * The submission queue is full so submit now instead of
+         * waiting for the loop
+         */
+        Submit(netCtx);
+        if ((tail - __atomic_load_n(netCtx->sqHead, __ATOMIC_ACQUIRE)) >= netCtx->sqEntries) {
+            return NULL;
+        }
+    }
+    sqe = &netCtx->sqes[tail & netCtx->sqMask];
+    memzero_s(sqe, sizeof(struct io_uring_sqe));
+    return sqe;
+}
+
+static void QueueSqe(DPS_NetTransportContext* netCtx)
+{
+    __atomic_store_n(netCtx->sqTail, *netCtx->sqTail + 1, __ATOMIC_RELEASE);
+    ++netCtx->inFlight;
+    if (netCtx->toSubmit++ == 0) {
+        uv_prepare_start(&netCtx->prepare, OnPrepare);
+    }
+}
+
+static DPS_Status StartReceive(DPS_NetTransportContext* netCtx)
+{
+    struct io_uring_sqe* sqe = GetSqe(netCtx);
+
+    if (!sqe) {
+        return DPS_ERR_RESOURCES;
+    }
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = netCtx->fd;
+    sqe->addr = (uint64_t)(uintptr_t)&netCtx->rxMsg;
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = RX_BUF_GROUP;
+    sqe->user_data = RECV_USER_DATA;
+    QueueSqe(netCtx);
+    return DPS_OK;
+}
+
+static void OnData(DPS_NetTransportContext* netCtx, uint8_t* data, size_t len)
+{
+    struct io_uring_recvmsg_out* out = (struct io_uring_recvmsg_out*)data;
+    DPS_NetRxBuffer* buf;
+    DPS_NetEndpoint ep;
+    uint8_t* payload;
+
+    DPS_DBGTRACEA("netCtx=%p,data=%p,len=%d\n", netCtx, data, len);
+
+    if (out->flags & MSG_TRUNC) {
+        DPS_ERRPRINT("Dropping partial message, read buffer too small\n");
+        return;
+    }
+    if (out->namelen > netCtx->rxMsg.msg_namelen) {
+        DPS_ERRPRINT("OnData no address\n");
+        return;
+    }
+    if (!out->payloadlen) {
+        return;
+    }
+    /*
+     * The receive buffer is returned to the kernel once the callback
+     * returns so copy the payload to a buffer the node can hold on to
+     */
+    buf = DPS_CreateNetRxBuffer(out->payloadlen);
+    if (!buf) {
+        DPS_ERRPRINT("OnData no buffer\n");
+        return;
+    }
+    payload = data + sizeof(*out) + netCtx->rxMsg.msg_namelen + netCtx->rxMsg.msg_controllen;
+    memcpy_s(buf->rx.base, out->payloadlen, payload, out->payloadlen);
+    ep.cn = NULL;
+    DPS_NetSetAddr(&ep.addr, DPS_UDP, (const struct sockaddr*)(data + sizeof(*out)));
+    netCtx->receiveCB(netCtx->node, &ep, DPS_OK, buf);
+    DPS_NetRxBufferDecRef(buf);
+}
+
+static void OnReceiveComplete(DPS_NetTransportContext* netCtx, const struct io_uring_cqe* cqe)
+{
+    uint16_t bid;
+
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+        bid = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+        if ((cqe->res >= 0) && !netCtx->stopping) {
+            OnData(netCtx, netCtx->rxBufs + (size_t)bid * RX_BUF_LEN, (size_t)cqe->res);
+        }
+        RecycleRxBuffer(netCtx, bid);
+    }
+    if (cqe->flags & IORING_CQE_F_MORE) {
+        return;
+    }
+    /*
+     * The multishot receive has terminated. This happens when all of
+     * the receive buffers are in use or when the thread that started
+     * the node exits.
+     */
+    --netCtx->inFlight;
+    if (netCtx->stopping) {
+        return;
+    }
+    if ((cqe->res >= 0) || (cqe->res == -ENOBUFS) || (cqe->res == -ECANCELED)) {
+        if (StartReceive(netCtx) != DPS_OK) {
+            DPS_ERRPRINT("Failed to restart receive\n");
+        }
+    } else {
+        DPS_ERRPRINT("OnData error %s\n", strerror(-cqe->res));
+    }
+}
+
+static SendRequest* AllocSend(DPS_NetTransportContext* netCtx, size_t numBufs)
+{
+    SendRequest* send = netCtx->freeSends;
+
+    if (send) {
+        netCtx->freeSends = send->next;
+        --netCtx->numFreeSends;
+    } else {
+        send = malloc(sizeof(SendRequest));
+        if (!send) {
+            return NULL;
+        }
+    }
+    if (numBufs > SEND_BUFS) {
+        send->bufs = malloc(numBufs * sizeof(uv_buf_t));
+        if (!send->bufs) {
+            free(send);
+            return NULL;
+        }
+    } else {
+        send->bufs = send->inlineBufs;
+    }
+    return send;
+}
+
+static void FreeSend(DPS_NetTransportContext* netCtx, SendRequest* send)
+{
+    if (send->bufs != send->inlineBufs) {
+        free(send->bufs);
+    }
+    if (netCtx->numFreeSends < MAX_FREE_SENDS) {
+        send->next = netCtx->freeSends;
+        netCtx->freeSends = send;
+        ++netCtx->numFreeSends;
+    } else {
+        free(send);
+    }
+}
+
+static void OnSendComplete(DPS_NetTransportContext* netCtx, SendRequest* send, int res)
+{
+    DPS_Status dpsRet = DPS_OK;
+
+    --netCtx->inFlight;
+    if (res < 0) {
+        if (res != -ECANCELED) {
+            DPS_ERRPRINT("OnSendComplete status=%s\n", strerror(-res));
+        }
+        dpsRet = DPS_ERR_NETWORK;
+    }
+    send->onSendComplete(send->node, send->appCtx, &send->peerEp, send->bufs, send->numBufs, dpsRet);
+    FreeSend(netCtx, send);
+}
+
+static void HandleClosed(uv_handle_t* handle)
+{
+    DPS_NetTransportContext* netCtx = (DPS_NetTransportContext*)handle->data;
+
+    DPS_DBGPRINT("Closed handle %p\n", handle);
+    if (--netCtx->numHandles == 0) {
+        FreeContext(netCtx);
+    }
+}
+
+static void CloseHandles(DPS_NetTransportContext* netCtx)
+{
+    uv_poll_stop(&netCtx->poll);
+    uv_close((uv_handle_t*)&netCtx->poll, HandleClosed);
+    uv_close((uv_handle_t*)&netCtx->prepare, HandleClosed);
+    uv_close((uv_handle_t*)&netCtx->socket, HandleClosed);
+}
+
+static void Reap(DPS_NetTransportContext* netCtx)
+{
+    struct io_uring_cqe cqe;
+    uint32_t head = *netCtx->cqHead;
+
+    for (;;) {
+        if (head == __atomic_load_n(netCtx->cqTail, __ATOMIC_ACQUIRE)) {
+            /*
+             * Completions that did not fit in the completion queue are
+             * flushed to it by entering the ring
+             */
+            if (!(__atomic_load_n(netCtx->sqFlags, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW)) {
+                break;
+            }
+            RingEnter(netCtx->ringFd, 0, 0, IORING_ENTER_GETEVENTS);
+            continue;
+        }
+        /*
+         * Release the entry before handling it, a send complete
+         * callback may queue more requests
+         */
+        cqe = netCtx->cqes[head & netCtx->cqMask];
+        __atomic_store_n(netCtx->cqHead, ++head, __ATOMIC_RELEASE);
+        if (cqe.user_data == RECV_USER_DATA) {
+            OnReceiveComplete(netCtx, &cqe);
+        } else if (cqe.user_data == CANCEL_USER_DATA) {
+            --netCtx->inFlight;
+        } else {
+            OnSendComplete(netCtx, (SendRequest*)(uintptr_t)cqe.user_data, cqe.res);
+        }
+    }
+}
+
+static void OnPoll(uv_poll_t* handle, int status, int events)
+{
+    DPS_NetTransportContext* netCtx = (DPS_NetTransportContext*)handle->data;
+
+    if (status) {
+        DPS_ERRPRINT("OnPoll error %s\n", uv_err_name(status));
+    }
+    Reap(netCtx);
+    if (netCtx->stopping && !netCtx->inFlight && !uv_is_closing((uv_handle_t*)&netCtx->poll)) {
+        CloseHandles(netCtx);
+    }
+}
+
+static DPS_NetTransportContext* NetStart(DPS_Node* node, const DPS_NodeAddress* addr, DPS_OnReceive cb)
+{
+    DPS_NetTransportContext* netCtx;
+    DPS_Status status = DPS_ERR_NOT_IMPLEMENTED;
+    struct sockaddr* sa;
+    DPS_NodeAddress any;
+    uv_os_fd_t fd;
+    int ret;
+
+    netCtx = calloc(1, sizeof(DPS_NetTransportContext));
+    if (!netCtx) {
+        return NULL;
+    }
+    netCtx->node = node;
+    netCtx->receiveCB = cb;
+    netCtx->ringFd = -1;
+    if (!node->noIoUring) {
+        status = RingInit(netCtx);
+    }
+    if (status != DPS_OK) {
+        DPS_DBGPRINT("Using libuv for UDP\n");
+        FreeRing(netCtx);
+        netCtx->udpCtx = DPS_UdpTransport.start(node, addr, cb);
+        if (!netCtx->udpCtx) {
+            FreeContext(netCtx);
+            return NULL;
+        }
+        return netCtx;
+    }
+    /*
+     * libuv binds the socket but all I/O on it goes through the ring
+     */
+    ret = uv_udp_init(node->loop, &netCtx->socket);
+    if (ret) {
+        DPS_ERRPRINT("uv_udp_init error=%s\n", uv_err_name(ret));
+        FreeContext(netCtx);
+        return NULL;
+    }
+    netCtx->socket.data = netCtx;
+    ++netCtx->numHandles;
+    uv_poll_init(node->loop, &netCtx->poll, netCtx->ringFd);
+    netCtx->poll.data = netCtx;
+    ++netCtx->numHandles;
+    uv_prepare_init(node->loop, &netCtx->prepare);
+    netCtx->prepare.data = netCtx;
+    ++netCtx->numHandles;
+    if (addr) {
+        sa = (struct sockaddr*)&addr->u.inaddr;
+    } else {
+        if (!DPS_SetAddress(&any, "[::]:0")) {
+            ret = UV_EINVAL;
+            goto ErrorExit;
+        }
+        sa = (struct sockaddr*)&any.u.inaddr;
+    }
+    ret = uv_udp_bind(&netCtx->socket, sa, 0);
+    if (ret) {
+        goto ErrorExit;
+    }
+    ret = uv_fileno((uv_handle_t*)&netCtx->socket, &fd);
+    if (ret) {
+        goto ErrorExit;
+    }
+    netCtx->fd = fd;
+    /*
+     * io_uring completes requests on a non-blocking socket with EAGAIN
+     * instead of waiting for the socket to become ready
+     */
+    if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK) < 0) {
+        ret = uv_translate_sys_error(errno);
+        goto ErrorExit;
+    }
+    /*
+     * The receive is submitted from the loop thread so completions are
+     * not handed off to the thread starting the node
+     */
+    if (StartReceive(netCtx) != DPS_OK) {
+        ret = UV_ENOBUFS;
+        goto ErrorExit;
+    }
+    ret = uv_poll_start(&netCtx->poll, UV_READABLE, OnPoll);
+    if (ret) {
+        goto ErrorExit;
+    }
+    return netCtx;
+
+ErrorExit:
+
+    DPS_ERRPRINT("Failed to start net netCtx: error=%s\n", uv_err_name(ret));
+    /*
+     * Closing the ring when the handles are closed cancels the receive
+     */
+    CloseHandles(netCtx);
+    return NULL;
+}
+
+static DPS_NodeAddress* NetGetListenAddress(DPS_NodeAddress* addr, DPS_NetTransportContext* netCtx)
+{
+    int len;
+
+    DPS_DBGTRACEA("netCtx=%p\n", netCtx);
+
+    if (netCtx && netCtx->udpCtx) {
+        return DPS_UdpTransport.getListenAddress(addr, netCtx->udpCtx);
+    }
+    memzero_s(addr, sizeof(DPS_NodeAddress));
+    if (!netCtx) {
+        return addr;
+    }
+    addr->type = DPS_UDP;
+    len = sizeof(struct sockaddr_in6);
+    if (uv_udp_getsockname(&netCtx->socket, (struct sockaddr*)&addr->u.inaddr, &len)) {
+        return addr;
+    }
+    DPS_DBGPRINT("Listener address = %s\n", DPS_NodeAddrToString(addr));
+    return addr;
+}
+
+static void NetStop(DPS_NetTransportContext* netCtx)
+{
+    struct io_uring_sqe* sqe;
+
+    if (!netCtx) {
+        return;
+    }
+    if (netCtx->udpCtx) {
+        DPS_UdpTransport.stop(netCtx->udpCtx);
+        FreeContext(netCtx);
+        return;
+    }
+    /*
+     * Cancel the receive and any sends in flight, the handles are
+     * closed once all of the requests have completed
+     */
+    netCtx->stopping = DPS_TRUE;
+    sqe = GetSqe(netCtx);
+    if (sqe) {
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+        sqe->user_data = CANCEL_USER_DATA;
+        QueueSqe(netCtx);
+        Submit(netCtx);
+    } else {
+        DPS_ERRPRINT("Failed to cancel requests\n");
+        CloseHandles(netCtx);
+    }
+}
+
+static DPS_Status NetSend(DPS_NetTransportContext* netCtx, void* appCtx, DPS_NetEndpoint* ep, uv_buf_t* bufs,
+                          size_t numBufs, DPS_NetSendComplete sendCompleteCB)
+{
+    DPS_Node* node = netCtx->node;
+    struct io_uring_sqe* sqe;
+    SendRequest* send;
+
+    if (netCtx->udpCtx) {
+        return DPS_UdpTransport.send(netCtx->udpCtx, appCtx, ep, bufs, numBufs, sendCompleteCB);
+    }
+
+    DPS_DBGTRACEA("node=%p,appCtx=%p,ep={addr=%s,cn=%p},bufs=%p,numBufs=%p,sendCompleteCB=%p\n",
+                  node, appCtx, DPS_NodeAddrToString(&ep->addr), ep->cn, bufs, numBufs, sendCompleteCB);
+
+    send = AllocSend(netCtx, numBufs);
+    if (!send) {
+        return DPS_ERR_RESOURCES;
+    }
+    sqe = GetSqe(netCtx);
+    if (!sqe) {
+        FreeSend(netCtx, send);
+        return DPS_ERR_RESOURCES;
+    }
+    send->onSendComplete = sendCompleteCB;
+    send->appCtx = appCtx;
+    send->peerEp = *ep;
+    send->node = node;
+    memcpy_s(send->bufs, numBufs * sizeof(uv_buf_t), bufs, numBufs * sizeof(uv_buf_t));
+    send->numBufs = numBufs;
+    memcpy_s(&send->addr, sizeof(send->addr), &ep->addr.u.inaddr, sizeof(ep->addr.u.inaddr));
+    DPS_MapAddrToV6((struct sockaddr*)&send->addr);
+    memzero_s(&send->msg, sizeof(send->msg));
+    send->msg.msg_name = &send->addr;
+    send->msg.msg_namelen = sizeof(struct sockaddr_in6);
+    /*
+     * On Unix a uv_buf_t has the same layout as a struct iovec
+     */
+    send->msg.msg_iov = (struct iovec*)send->bufs;
+    send->msg.msg_iovlen = numBufs;
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = netCtx->fd;
+    sqe->addr = (uint64_t)(uintptr_t)&send->msg;
+    sqe->len = 1;
+    sqe->user_data = (uint64_t)(uintptr_t)send;
+    QueueSqe(netCtx);
+    return DPS_OK;
+}
+
+static void ConnectionIncRef(DPS_NetConnection* cn)
+{
+    /* No-op for udp */
+}
+
+static void ConnectionDecRef(DPS_NetConnection* cn)
+{
+    /* No-op for udp */
+}
+
+const DPS_NetTransport DPS_UringTransport = {
+    "udp",
+    DPS_UDP,
+    NetStart,
+    NetGetListenAddress,
+    NetStop,
+    NetSend,
+    ConnectionIncRef,
+    ConnectionDecRef,
+    NULL
+};
@@ -58,16 +58,36 @@ const char* DPS_UUIDToString(const DPS_UUID* uuid)
     return str;
 }
 
+/*
+ * Number of rounds of the Feistel network used to scramble UUIDs
+ */
+#define NUM_ROUNDS 4
+
+/*
+ * Random round keys, these make the UUIDs unpredictable and
+ * different for each process
+ */
 static struct {
-    uint64_t nonce[2];
-    uint32_t seeds[4];
+    uint64_t keys[NUM_ROUNDS];
 } entropy;
 
 static struct {
     uv_once_t once;
     DPS_Status ret;
     uv_mutex_t mutex;
-} context = { UV_ONCE_INIT, DPS_OK, { 0 } };
+    uint64_t numThreads;
+} context = { UV_ONCE_INIT, DPS_OK, { 0 }, 0 };
+
+/*
+ * Each thread generates from its own thread number and a count of the
+ * values it has generated so far. Every (thread, count) pair in the
+ * process is different so no locking is needed once the thread number
+ * has been assigned.
+ */
+static THREAD struct {
+    uint64_t thread;
+    uint64_t count;
+} local;
 
 #ifdef _WIN32
 static void InitUUID(void)
@@ -94,7 +114,7 @@ static const char* randPath = "/dev/urandom";
 static void InitUUID(void)
 {
     uv_mutex_init(&context.mutex);
-    while (!entropy.nonce[0]) {
+    while (!entropy.keys[0]) {
         size_t sz;
         FILE* f = fopen(randPath, "r");
         if (!f) {
@@ -121,29 +141,53 @@ DPS_Status DPS_InitUUID()
 }
 
 /*
- * Very simple linear congruational generator based PRNG (Lehmer/Park-Miller generator)
+ * Finalizer from the SplitMix64 generator, used as the round function
  */
-#define LEPRNG(n)  (uint32_t)(((uint64_t)(n) * 279470273ull) % 4294967291ul)
+static inline uint64_t Mix(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
 
 /*
+ * A Feistel network is a permutation whatever the round function so
+ * distinct (thread, count) pairs always give distinct outputs.
+ *
  * This is fast - not secure
  */
-void DPS_GenerateUUID(DPS_UUID* uuid)
+static void Generate(uint64_t* out)
 {
-    uint64_t* s = (uint64_t*)entropy.seeds;
-    uint32_t s0;
+    uint64_t l;
+    uint64_t r;
+    uint64_t t;
+    int i;
+
+    if (!local.thread) {
+        uv_once(&context.once, InitUUID);
+        uv_mutex_lock(&context.mutex);
+        local.thread = ++context.numThreads;
+        uv_mutex_unlock(&context.mutex);
+    }
+    l = local.thread;
+    r = local.count++;
+    for (i = 0; i < NUM_ROUNDS; ++i) {
+        t = r;
+        r = l ^ Mix(r ^ entropy.keys[i]);
+        l = t;
+    }
+    out[0] = l;
+    out[1] = r;
+}
 
+void DPS_GenerateUUID(DPS_UUID* uuid)
+{
     DPS_DBGTRACE();
 
-    uv_mutex_lock(&context.mutex);
-    s0 = entropy.seeds[0];
-    entropy.seeds[0] = LEPRNG(entropy.seeds[1]);
-    entropy.seeds[1] = LEPRNG(entropy.seeds[2]);
-    entropy.seeds[2] = LEPRNG(entropy.seeds[3]);
-    entropy.seeds[3] = LEPRNG(s0);
-    uuid->val64[0] = s[0] ^ entropy.nonce[0];
-    uuid->val64[1] = s[1] ^ entropy.nonce[1];
-    uv_mutex_unlock(&context.mutex);
+    Generate(uuid->val64);
 }
 
 int DPS_UUIDCompare(const DPS_UUID* a, const DPS_UUID* b)
@@ -170,15 +214,8 @@ void DPS_RandUUIDLess(DPS_UUID* uuid)
 
 uint32_t DPS_Rand(void)
 {
-    uint32_t s0;
-
-    uv_mutex_lock(&context.mutex);
-    s0 = entropy.seeds[0];
-    entropy.seeds[0] = LEPRNG(entropy.seeds[1]);
-    entropy.seeds[1] = LEPRNG(entropy.seeds[2]);
-    entropy.seeds[2] = LEPRNG(entropy.seeds[3]);
-    entropy.seeds[3] = LEPRNG(s0);
-    s0 = entropy.seeds[0];
-    uv_mutex_unlock(&context.mutex);
-    return s0;
+    uint64_t n[2];
+
+    Generate(n);
+    return (uint32_t)n[1];
 }
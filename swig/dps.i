@@ -29,6 +29,11 @@
 
 %ignore DPS_AckPublicationBufs;
 %ignore DPS_CBOR2JSON;
+%ignore DPS_CBOR2JSONStreamConvert;
+%ignore DPS_CreateCBOR2JSONStream;
+%ignore DPS_CreateJSON2CBORStream;
+%ignore DPS_DestroyCBOR2JSONStream;
+%ignore DPS_DestroyJSON2CBORStream;
 %ignore DPS_DestroyKeyStore;
 %ignore DPS_DestroyPublication;
 %ignore DPS_DestroySubscription;
@@ -38,13 +43,19 @@
 %ignore DPS_GetPublicationData;
 %ignore DPS_GetSubscriptionData;
 %ignore DPS_JSON2CBOR;
+%ignore DPS_JSON2CBORStreamConvert;
 %ignore DPS_KeyStoreHandle;
+%ignore DPS_LogFileSink;
+%ignore DPS_LogSyslogSink;
 %ignore DPS_MemoryKeyStoreHandle;
 %ignore DPS_NodeAddrToString;
 %ignore DPS_PublicationGetNumTopics;
 %ignore DPS_PublicationGetTopic;
+%ignore DPS_PublicationRetainPayload;
 %ignore DPS_PublishBufs;
+%ignore DPS_ReleasePayload;
 %ignore DPS_SetKeyStoreData;
+%ignore DPS_SetLogSink;
 %ignore DPS_SetNodeData;
 %ignore DPS_SetPublicationData;
 %ignore DPS_SetSubscriptionData;
@@ -0,0 +1,266 @@
+/*
+ *******************************************************************
+ *
+ * Copyright 2016 Intel Corporation All rights reserved.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ */
+
+/*
+ * Simulates folding the interests for a set of subscription topics to
+ * successively smaller bit lengths and reports the bandwidth needed to
+ * send the interests against the false positive rate for publications
+ * that do not match any of the subscriptions.
+ */
+
+#include "test.h"
+#include "bitvec.h"
+#include "topics.h"
+
+#define MAX_TOPICS      4096
+#define MAX_TOPIC_LEN   256
+#define MIN_BITS        64
+
+static const char separators[] = "/.";
+
+static char* topics[MAX_TOPICS];
+static size_t numTopics = 0;
+
+static char* GenerateTopic(uint32_t i)
+{
+    char topic[MAX_TOPIC_LEN];
+
+    snprintf(topic, sizeof(topic), "site%u/floor%u/sensor%u/%s", i % 7, i % 13, i,
+             (i & 1) ? "temperature" : "humidity");
+    return strdup(topic);
+}
+
+static DPS_Status ReadTopics(const char* fileName)
+{
+    char line[MAX_TOPIC_LEN];
+    FILE* f = fopen(fileName, "r");
+
+    if (!f) {
+        DPS_ERRPRINT("Could not open %s\n", fileName);
+        return DPS_ERR_ARGS;
+    }
+    while (fgets(line, sizeof(line), f) && (numTopics < MAX_TOPICS)) {
+        size_t len = strcspn(line, "\r\n");
+        if (len) {
+            line[len] = 0;
+            topics[numTopics++] = strdup(line);
+        }
+    }
+    fclose(f);
+    return numTopics ? DPS_OK : DPS_ERR_ARGS;
+}
+
+static int MatchesAny(const char* pubTopic)
+{
+    size_t i;
+
+    for (i = 0; i < numTopics; ++i) {
+        int match = DPS_FALSE;
+        if ((DPS_MatchTopicString(pubTopic, topics[i], separators, DPS_FALSE, &match) == DPS_OK) && match) {
+            return DPS_TRUE;
+        }
+    }
+    return DPS_FALSE;
+}
+
+static size_t SerializedSize(DPS_BitVector* bv)
+{
+    DPS_Status ret;
+    DPS_TxBuffer buf;
+    DPS_BitVector* out;
+    DPS_RxBuffer rxBuf;
+    size_t sz;
+
+    ret = DPS_TxBufferInit(&buf, NULL, DPS_BitVectorSerializeMaxSize(bv));
+    ASSERT(ret == DPS_OK);
+    ret = DPS_BitVectorSerialize(bv, &buf);
+    ASSERT(ret == DPS_OK);
+    sz = DPS_TxBufferUsed(&buf);
+    /*
+     * Check the folded bit vector survives the round trip
+     */
+    out = DPS_BitVectorAllocLen(DPS_BitVectorLen(bv));
+    ASSERT(out);
+    DPS_TxBufferToRx(&buf, &rxBuf);
+    ret = DPS_BitVectorDeserialize(out, &rxBuf);
+    ASSERT(ret == DPS_OK);
+    ASSERT(DPS_BitVectorEquals(out, bv));
+    DPS_BitVectorFree(out);
+    DPS_TxBufferFree(&buf);
+    return sz;
+}
+
+int main(int argc, char** argv)
+{
+    DPS_Status ret;
+    char** arg = argv + 1;
+    const char* fileName = NULL;
+    int filterBits = 8192;
+    int numHashes = 4;
+    int numGenerated = 100;
+    int numProbes = 1000;
+    DPS_BitVector** subs;
+    DPS_BitVector* interests;
+    DPS_BitVector* pub;
+    size_t bits;
+    size_t i;
+
+    DPS_Debug = DPS_FALSE;
+    while (--argc) {
+        if (IntArg("-b", &arg, &argc, &filterBits, MIN_BITS, 64 * 1024)) {
+            continue;
+        }
+        if (IntArg("-n", &arg, &argc, &numHashes, 1, 8)) {
+            continue;
+        }
+        if (IntArg("-t", &arg, &argc, &numGenerated, 1, MAX_TOPICS)) {
+            continue;
+        }
+        if (IntArg("-p", &arg, &argc, &numProbes, 1, INT32_MAX)) {
+            continue;
+        }
+        if (strcmp(*arg, "-f") == 0) {
+            ++arg;
+            if (!--argc) {
+                goto Usage;
+            }
+            fileName = *arg++;
+            continue;
+        }
+        if (strcmp(*arg, "-d") == 0) {
+            ++arg;
+            DPS_Debug = DPS_TRUE;
+            continue;
+        }
+        goto Usage;
+    }
+
+    ret = DPS_Configure(filterBits, numHashes);
+    if (ret != DPS_OK) {
+        DPS_ERRPRINT("Invalid configuration parameters\n");
+        goto Usage;
+    }
+    if (fileName) {
+        ret = ReadTopics(fileName);
+        if (ret != DPS_OK) {
+            goto Usage;
+        }
+    } else {
+        for (i = 0; i < (size_t)numGenerated; ++i) {
+            topics[numTopics++] = GenerateTopic((uint32_t)i);
+        }
+    }
+
+    subs = calloc(numTopics, sizeof(DPS_BitVector*));
+    interests = DPS_BitVectorAlloc();
+    pub = DPS_BitVectorAlloc();
+    ASSERT(subs && interests && pub);
+    for (i = 0; i < numTopics; ++i) {
+        subs[i] = DPS_BitVectorAlloc();
+        ASSERT(subs[i]);
+        ret = DPS_AddTopic(subs[i], topics[i], separators, DPS_SubTopic);
+        ASSERT(ret == DPS_OK);
+        DPS_BitVectorUnion(interests, subs[i]);
+    }
+
+    DPS_PRINT("%zu topics, %d hashes, %d probes\n", numTopics, numHashes, numProbes);
+    DPS_PRINT("%8s %10s %8s %10s\n", "bits", "bytes", "load%", "false+%");
+    /*
+     * Folding is exact when the folded length divides the configured
+     * length so halve the length each time.
+     */
+    for (bits = (size_t)filterBits; bits >= MIN_BITS; bits /= 2) {
+        DPS_BitVector* folded = DPS_BitVectorAllocLen(bits);
+        DPS_BitVector* foldedPub = DPS_BitVectorAllocLen(bits);
+        DPS_BitVector** foldedSubs = calloc(numTopics, sizeof(DPS_BitVector*));
+        size_t falsePos = 0;
+        size_t negatives = 0;
+        int p;
+
+        ASSERT(folded && foldedPub && foldedSubs);
+        DPS_BitVectorFold(folded, interests);
+        for (i = 0; i < numTopics; ++i) {
+            foldedSubs[i] = DPS_BitVectorAllocLen(bits);
+            ASSERT(foldedSubs[i]);
+            DPS_BitVectorFold(foldedSubs[i], subs[i]);
+        }
+        /*
+         * Publications to the subscribed topics must still match
+         */
+        if (!fileName) {
+            for (i = 0; i < numTopics; ++i) {
+                DPS_BitVectorClear(pub);
+                ret = DPS_AddTopic(pub, topics[i], separators, DPS_PubTopic);
+                ASSERT(ret == DPS_OK);
+                DPS_BitVectorFold(foldedPub, pub);
+                ASSERT(DPS_BitVectorIncludes(foldedPub, foldedSubs[i]));
+            }
+        }
+        for (p = 0; p < numProbes; ++p) {
+            char* topic = GenerateTopic((uint32_t)(MAX_TOPICS + p));
+            ASSERT(topic);
+            if (!MatchesAny(topic)) {
+                ++negatives;
+                DPS_BitVectorClear(pub);
+                ret = DPS_AddTopic(pub, topic, separators, DPS_PubTopic);
+                ASSERT(ret == DPS_OK);
+                DPS_BitVectorFold(foldedPub, pub);
+                for (i = 0; i < numTopics; ++i) {
+                    if (DPS_BitVectorIncludes(foldedPub, foldedSubs[i])) {
+                        ++falsePos;
+                        break;
+                    }
+                }
+            }
+            free(topic);
+        }
+        DPS_PRINT("%8zu %10zu %8.2f %10.3f\n", bits, SerializedSize(folded),
+                  DPS_BitVectorLoadFactor(folded), negatives ? (100.0 * falsePos) / negatives : 0.0);
+        for (i = 0; i < numTopics; ++i) {
+            DPS_BitVectorFree(foldedSubs[i]);
+        }
+        free(foldedSubs);
+        DPS_BitVectorFree(foldedPub);
+        DPS_BitVectorFree(folded);
+        if (bits % 128) {
+            break;
+        }
+    }
+
+    for (i = 0; i < numTopics; ++i) {
+        DPS_BitVectorFree(subs[i]);
+        free(topics[i]);
+    }
+    free(subs);
+    DPS_BitVectorFree(interests);
+    DPS_BitVectorFree(pub);
+    return EXIT_SUCCESS;
+
+Usage:
+    DPS_PRINT("Usage %s: [-d] [-b <filter-bits>] [-n <num-hashes>] [-t <num-topics>|-f <topic-file>] [-p <num-probes>]\n", argv[0]);
+    DPS_PRINT("       -b: Configured bit length, folded lengths are found by halving.\n");
+    DPS_PRINT("       -n: Number of hashes.\n");
+    DPS_PRINT("       -t: Number of subscription topics to generate.\n");
+    DPS_PRINT("       -f: File of subscription topics, one per line.\n");
+    DPS_PRINT("       -p: Number of non-matching publications to probe with.\n");
+    return EXIT_FAILURE;
+}
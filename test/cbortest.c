@@ -20,6 +20,7 @@
  *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
  */
 
+#include <uv.h>
 #include "test.h"
 #include "float.h"
 #include "math.h"
@@ -170,6 +171,318 @@ Failed:
     return ret;
 }
 
+/*
+ * A map with the same layout as the protected map of a publication
+ */
+typedef struct {
+    uint16_t port;
+    int16_t ttl;
+    DPS_UUID pubId;
+    uint32_t sequenceNum;
+    int ackRequested;
+    CBOR_Span bf;
+    CBOR_Span path;
+} TestFields;
+
+static const CBOR_MapField MapFields[] = {
+    CBOR_MAP_FIELD(1, UINT16, CBOR_FIELD_OPTIONAL, TestFields, port),
+    CBOR_MAP_FIELD(2, INT16, CBOR_FIELD_FIXED, TestFields, ttl),
+    CBOR_MAP_FIELD(3, UUID, 0, TestFields, pubId),
+    CBOR_MAP_FIELD(4, UINT32, 0, TestFields, sequenceNum),
+    CBOR_MAP_FIELD(5, BOOLEAN, 0, TestFields, ackRequested),
+    CBOR_MAP_FIELD(6, BYTES, 0, TestFields, bf),
+    CBOR_MAP_FIELD(14, STRING, CBOR_FIELD_OPTIONAL, TestFields, path)
+};
+
+#define ALL_FIELDS ((1 << A_SIZEOF(MapFields)) - 1)
+
+static uint8_t BloomFilter[128];
+
+static void InitTestFields(TestFields* f)
+{
+    static const char path[] = "/tmp/dps";
+
+    memset(f, 0, sizeof(TestFields));
+    f->port = 10000;
+    f->ttl = -1;
+    DPS_GenerateUUID(&f->pubId);
+    f->sequenceNum = 123456;
+    f->ackRequested = DPS_TRUE;
+    f->bf.data = BloomFilter;
+    f->bf.len = sizeof(BloomFilter);
+    f->path.data = (uint8_t*)path;
+    f->path.len = sizeof(path) - 1;
+}
+
+static DPS_Status EncodeFieldByField(DPS_TxBuffer* txBuffer, const TestFields* f)
+{
+    DPS_Status ret;
+
+    ret = CBOR_EncodeMap(txBuffer, 7);
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint8(txBuffer, 1);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint16(txBuffer, f->port);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint8(txBuffer, 2);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeInt16(txBuffer, f->ttl);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint8(txBuffer, 3);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUUID(txBuffer, &f->pubId);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint8(txBuffer, 4);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint32(txBuffer, f->sequenceNum);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint8(txBuffer, 5);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeBoolean(txBuffer, f->ackRequested);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint8(txBuffer, 6);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeBytes(txBuffer, f->bf.data, f->bf.len);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint8(txBuffer, 14);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeStringAndLength(txBuffer, (const char*)f->path.data, f->path.len);
+    }
+    return ret;
+}
+
+static DPS_Status DecodeKeyByKey(DPS_RxBuffer* rxBuffer, TestFields* f)
+{
+    static const int32_t keys[] = { 2, 3, 4, 5, 6 };
+    static const int32_t optKeys[] = { 1, 14 };
+    CBOR_MapState mapState;
+    DPS_Status ret;
+    char* str;
+
+    ret = DPS_ParseMapInit(&mapState, rxBuffer, keys, A_SIZEOF(keys), optKeys, A_SIZEOF(optKeys));
+    while ((ret == DPS_OK) && !DPS_ParseMapDone(&mapState)) {
+        int32_t key;
+        ret = DPS_ParseMapNext(&mapState, &key);
+        if (ret != DPS_OK) {
+            break;
+        }
+        switch (key) {
+        case 1:
+            ret = CBOR_DecodeUint16(rxBuffer, &f->port);
+            break;
+        case 2:
+            ret = CBOR_DecodeInt16(rxBuffer, &f->ttl);
+            break;
+        case 3:
+            ret = CBOR_DecodeUUID(rxBuffer, &f->pubId);
+            break;
+        case 4:
+            ret = CBOR_DecodeUint32(rxBuffer, &f->sequenceNum);
+            break;
+        case 5:
+            ret = CBOR_DecodeBoolean(rxBuffer, &f->ackRequested);
+            break;
+        case 6:
+            ret = CBOR_DecodeBytes(rxBuffer, &f->bf.data, &f->bf.len);
+            break;
+        case 14:
+            ret = CBOR_DecodeString(rxBuffer, &str, &f->path.len);
+            f->path.data = (uint8_t*)str;
+            break;
+        }
+    }
+    return ret;
+}
+
+static int SameFields(const TestFields* a, const TestFields* b)
+{
+    return (a->port == b->port) && (a->ttl == b->ttl) && !DPS_UUIDCompare(&a->pubId, &b->pubId) &&
+        (a->sequenceNum == b->sequenceNum) && (a->ackRequested == b->ackRequested) &&
+        (a->bf.len == b->bf.len) && !memcmp(a->bf.data, b->bf.data, a->bf.len) &&
+        (a->path.len == b->path.len) && !memcmp(a->path.data, b->path.data, a->path.len);
+}
+
+static DPS_Status TestMapFields(void)
+{
+    DPS_TxBuffer txBuffer;
+    DPS_RxBuffer rxBuffer;
+    TestFields in;
+    TestFields out;
+    uint8_t* pos[A_SIZEOF(MapFields)];
+    uint32_t found;
+    DPS_Status ret;
+
+    InitTestFields(&in);
+    /*
+     * Round trip all fields, the encoded size must be exact
+     */
+    DPS_TxBufferInit(&txBuffer, buf, CBOR_SizeOfMapFields(MapFields, A_SIZEOF(MapFields), &in, ALL_FIELDS));
+    ret = CBOR_EncodeMapFields(&txBuffer, MapFields, A_SIZEOF(MapFields), &in, ALL_FIELDS, pos);
+    CHECK(ret);
+    ASSERT(DPS_TxBufferSpace(&txBuffer) == 0);
+    DPS_TxBufferToRx(&txBuffer, &rxBuffer);
+    memset(&out, 0, sizeof(out));
+    ret = DPS_ParseMapFields(&rxBuffer, MapFields, A_SIZEOF(MapFields), &out, &found);
+    CHECK(ret);
+    ASSERT(found == ALL_FIELDS);
+    ASSERT(SameFields(&in, &out));
+    ASSERT(!DPS_RxBufferAvail(&rxBuffer));
+    /*
+     * Patch the fixed width TTL in place, both signs use the same width
+     */
+    CBOR_PatchInt16(pos[1], 300);
+    DPS_TxBufferToRx(&txBuffer, &rxBuffer);
+    ret = DPS_ParseMapFields(&rxBuffer, MapFields, A_SIZEOF(MapFields), &out, &found);
+    CHECK(ret);
+    ASSERT(out.ttl == 300);
+    CBOR_PatchInt16(pos[1], INT16_MIN);
+    DPS_TxBufferToRx(&txBuffer, &rxBuffer);
+    ret = DPS_ParseMapFields(&rxBuffer, MapFields, A_SIZEOF(MapFields), &out, &found);
+    CHECK(ret);
+    ASSERT(out.ttl == INT16_MIN);
+    /*
+     * Maps encoded field by field decode the same
+     */
+    DPS_TxBufferInit(&txBuffer, buf, sizeof(buf));
+    ret = EncodeFieldByField(&txBuffer, &in);
+    CHECK(ret);
+    DPS_TxBufferToRx(&txBuffer, &rxBuffer);
+    memset(&out, 0, sizeof(out));
+    ret = DPS_ParseMapFields(&rxBuffer, MapFields, A_SIZEOF(MapFields), &out, &found);
+    CHECK(ret);
+    ASSERT(SameFields(&in, &out));
+    /*
+     * Optional fields may be absent
+     */
+    DPS_TxBufferInit(&txBuffer, buf, sizeof(buf));
+    ret = CBOR_EncodeMapFields(&txBuffer, MapFields, A_SIZEOF(MapFields), &in, ALL_FIELDS & ~0x41, NULL);
+    CHECK(ret);
+    DPS_TxBufferToRx(&txBuffer, &rxBuffer);
+    ret = DPS_ParseMapFields(&rxBuffer, MapFields, A_SIZEOF(MapFields), &out, &found);
+    CHECK(ret);
+    ASSERT(found == (ALL_FIELDS & ~0x41));
+    /*
+     * Required fields may not be absent, whether in the middle or at the end
+     */
+    DPS_TxBufferInit(&txBuffer, buf, sizeof(buf));
+    ret = CBOR_EncodeMapFields(&txBuffer, MapFields, A_SIZEOF(MapFields), &in, ALL_FIELDS & ~0x08, NULL);
+    CHECK(ret);
+    DPS_TxBufferToRx(&txBuffer, &rxBuffer);
+    ret = DPS_ParseMapFields(&rxBuffer, MapFields, A_SIZEOF(MapFields), &out, &found);
+    ASSERT(ret == DPS_ERR_MISSING);
+    DPS_TxBufferInit(&txBuffer, buf, sizeof(buf));
+    ret = CBOR_EncodeMapFields(&txBuffer, MapFields, A_SIZEOF(MapFields), &in, ALL_FIELDS & ~0x60, NULL);
+    CHECK(ret);
+    DPS_TxBufferToRx(&txBuffer, &rxBuffer);
+    ret = DPS_ParseMapFields(&rxBuffer, MapFields, A_SIZEOF(MapFields), &out, &found);
+    ASSERT(ret == DPS_ERR_MISSING);
+    /*
+     * Unknown keys are skipped
+     */
+    DPS_TxBufferInit(&txBuffer, buf, sizeof(buf));
+    ret = CBOR_EncodeMapFields(&txBuffer, MapFields + 1, 5, &in, 0x1F, NULL);
+    CHECK(ret);
+    DPS_TxBufferToRx(&txBuffer, &rxBuffer);
+    ret = DPS_ParseMapFields(&rxBuffer, MapFields + 2, 3, &out, &found);
+    CHECK(ret);
+    ASSERT(found == 0x7);
+    ASSERT(!DPS_RxBufferAvail(&rxBuffer));
+    return DPS_OK;
+
+Failed:
+    printf("Failed at line %d %s\n", ln, DPS_ErrTxt(ret));
+    return ret;
+}
+
+#define BENCHMARK_ITERATIONS 100000
+
+/*
+ * Compare the throughput of encoding and decoding a publication
+ * sized map field by field with the table-driven codec and with
+ * copying and patching a template
+ */
+static DPS_Status BenchmarkMapFields(void)
+{
+    DPS_TxBuffer txBuffer;
+    DPS_TxBuffer template;
+    DPS_RxBuffer rxBuffer;
+    TestFields in;
+    TestFields out;
+    uint8_t* pos[A_SIZEOF(MapFields)];
+    uint64_t start;
+    DPS_Status ret = DPS_OK;
+    int i;
+
+    InitTestFields(&in);
+
+    start = uv_hrtime();
+    for (i = 0; (ret == DPS_OK) && (i < BENCHMARK_ITERATIONS); ++i) {
+        DPS_TxBufferInit(&txBuffer, buf, sizeof(buf));
+        ret = EncodeFieldByField(&txBuffer, &in);
+    }
+    CHECK(ret);
+    printf("Encode field by field: %.1f nsecs\n", (double)(uv_hrtime() - start) / BENCHMARK_ITERATIONS);
+
+    start = uv_hrtime();
+    for (i = 0; (ret == DPS_OK) && (i < BENCHMARK_ITERATIONS); ++i) {
+        DPS_TxBufferInit(&txBuffer, buf, sizeof(buf));
+        ret = CBOR_EncodeMapFields(&txBuffer, MapFields, A_SIZEOF(MapFields), &in, ALL_FIELDS, NULL);
+    }
+    CHECK(ret);
+    printf("Encode table-driven: %.1f nsecs\n", (double)(uv_hrtime() - start) / BENCHMARK_ITERATIONS);
+
+    DPS_TxBufferInit(&template, buf + sizeof(buf) / 2, sizeof(buf) / 2);
+    ret = CBOR_EncodeMapFields(&template, MapFields, A_SIZEOF(MapFields), &in, ALL_FIELDS, pos);
+    CHECK(ret);
+    start = uv_hrtime();
+    for (i = 0; (ret == DPS_OK) && (i < BENCHMARK_ITERATIONS); ++i) {
+        DPS_TxBufferInit(&txBuffer, buf, sizeof(buf) / 2);
+        ret = CBOR_Copy(&txBuffer, template.base, DPS_TxBufferUsed(&template));
+        CBOR_PatchInt16(txBuffer.base + (pos[1] - template.base), (int16_t)i);
+    }
+    CHECK(ret);
+    printf("Encode template and patch: %.1f nsecs\n", (double)(uv_hrtime() - start) / BENCHMARK_ITERATIONS);
+
+    DPS_TxBufferInit(&txBuffer, buf, sizeof(buf));
+    ret = EncodeFieldByField(&txBuffer, &in);
+    CHECK(ret);
+    start = uv_hrtime();
+    for (i = 0; (ret == DPS_OK) && (i < BENCHMARK_ITERATIONS); ++i) {
+        DPS_TxBufferToRx(&txBuffer, &rxBuffer);
+        ret = DecodeKeyByKey(&rxBuffer, &out);
+    }
+    CHECK(ret);
+    printf("Decode key by key: %.1f nsecs\n", (double)(uv_hrtime() - start) / BENCHMARK_ITERATIONS);
+    ASSERT(SameFields(&in, &out));
+
+    start = uv_hrtime();
+    for (i = 0; (ret == DPS_OK) && (i < BENCHMARK_ITERATIONS); ++i) {
+        DPS_TxBufferToRx(&txBuffer, &rxBuffer);
+        ret = DPS_ParseMapFields(&rxBuffer, MapFields, A_SIZEOF(MapFields), &out, NULL);
+    }
+    CHECK(ret);
+    printf("Decode table-driven: %.1f nsecs\n", (double)(uv_hrtime() - start) / BENCHMARK_ITERATIONS);
+    ASSERT(SameFields(&in, &out));
+    return DPS_OK;
+
+Failed:
+    printf("Failed at line %d %s\n", ln, DPS_ErrTxt(ret));
+    return ret;
+}
+
 #define NUM_ENCODED_VALS   84
 
 int main(int argc, char** argv)
@@ -194,6 +507,10 @@ int main(int argc, char** argv)
     CHECK(ret);
     ret = TestTextString();
     CHECK(ret);
+    ret = TestMapFields();
+    CHECK(ret);
+    ret = BenchmarkMapFields();
+    CHECK(ret);
 
     DPS_TxBufferInit(&txBuffer, buf, sizeof(buf));
 
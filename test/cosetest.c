@@ -447,6 +447,7 @@ int main(int argc, char** argv)
     }
     DPS_TxBufferToRx(&txBuf, &input);
     DPS_RxBufferInit(&aadBuf, (uint8_t*)aad, sizeof(aad));
+    DPS_TxBufferClear(&plainText);
     ret = COSE_Decrypt(nonce, &recipient, &aadBuf, &input, keyStore, NULL, &plainText);
     if (ret != DPS_OK) {
         DPS_ERRPRINT("COSE_Decrypt failed: %s\n", DPS_ErrTxt(ret));
@@ -81,6 +81,96 @@ static void TestDel(DPS_CountVector* cv, uint8_t n)
     DPS_BitVectorFree(bv);
 }
 
+#define NUM_BVS    8
+#define NUM_OPS    1000
+
+static void RandomBits(DPS_BitVector* bv)
+{
+    uint8_t buf[1024 / 8];
+    size_t i;
+
+    for (i = 0; i < sizeof(buf); ++i) {
+        /*
+         * Sparse so that some chunks are left clear
+         */
+        buf[i] = (rand() % 4) ? 0 : (uint8_t)rand();
+    }
+    DPS_BitVectorSet(bv, buf, sizeof(buf));
+}
+
+/*
+ * Checks incrementally updating the union excluding one of the bit
+ * vectors against deleting the bit vector and taking the full union
+ */
+static void TestIncremental(void)
+{
+    DPS_Status ret;
+    DPS_CountVector* cv;
+    DPS_BitVector* bvs[NUM_BVS];
+    DPS_BitVector* incr = DPS_BitVectorAllocLen(1024);
+    DPS_BitVector* folded = DPS_BitVectorAllocLen(256);
+    DPS_BitVector* delta = DPS_BitVectorAllocLen(256);
+    DPS_BitVector* prev = DPS_BitVectorAllocLen(256);
+    DPS_BitVector* check = DPS_BitVectorAllocLen(256);
+    DPS_BitVector* bvU;
+    uint64_t rev = 0;
+    int same;
+    int i;
+
+    DPS_PRINT("Incremental union\n");
+    DPS_Configure(1024, 4);
+    cv = DPS_CountVectorAlloc();
+    ASSERT(cv && incr && folded && delta && prev && check);
+    for (i = 0; i < NUM_BVS; ++i) {
+        bvs[i] = DPS_BitVectorAlloc();
+        RandomBits(bvs[i]);
+        ret = DPS_CountVectorAdd(cv, bvs[i]);
+        ASSERT(ret == DPS_OK);
+    }
+    for (i = 0; i < NUM_OPS; ++i) {
+        int n = rand() % NUM_BVS;
+        /*
+         * Replace one of the bit vectors other than the excluded one
+         */
+        if (n) {
+            ret = DPS_CountVectorDel(cv, bvs[n]);
+            ASSERT(ret == DPS_OK);
+            RandomBits(bvs[n]);
+            ret = DPS_CountVectorAdd(cv, bvs[n]);
+            ASSERT(ret == DPS_OK);
+        }
+        DPS_BitVectorDup(prev, folded);
+        DPS_BitVectorClear(delta);
+        ret = DPS_CountVectorUpdateUnion(incr, NULL, cv, bvs[0], rev, NULL);
+        ASSERT(ret == DPS_OK);
+        ret = DPS_CountVectorUpdateUnion(folded, delta, cv, bvs[0], rev, &same);
+        ASSERT(ret == DPS_OK);
+        rev = DPS_CountVectorRevision(cv);
+
+        ret = DPS_CountVectorDel(cv, bvs[0]);
+        ASSERT(ret == DPS_OK);
+        bvU = DPS_CountVectorToUnion(cv);
+        ret = DPS_CountVectorAdd(cv, bvs[0]);
+        ASSERT(ret == DPS_OK);
+        ASSERT(DPS_BitVectorEquals(incr, bvU));
+        DPS_BitVectorFold(check, bvU);
+        ASSERT(DPS_BitVectorEquals(folded, check));
+        DPS_BitVectorXor(check, prev, folded, NULL);
+        ASSERT(DPS_BitVectorEquals(check, delta));
+        ASSERT(same == DPS_BitVectorIsClear(delta));
+        DPS_BitVectorFree(bvU);
+    }
+    for (i = 0; i < NUM_BVS; ++i) {
+        DPS_BitVectorFree(bvs[i]);
+    }
+    DPS_BitVectorFree(incr);
+    DPS_BitVectorFree(folded);
+    DPS_BitVectorFree(delta);
+    DPS_BitVectorFree(prev);
+    DPS_BitVectorFree(check);
+    DPS_CountVectorFree(cv);
+}
+
 int main(int argc, char** argv)
 {
     DPS_CountVector* cv;
@@ -110,5 +200,7 @@ int main(int argc, char** argv)
 
     DPS_CountVectorFree(cv);
 
+    TestIncremental();
+
     return EXIT_SUCCESS;
 }
@@ -57,11 +57,13 @@ int main(int argc, char** argv)
 #elif defined(DPS_USE_TCP)
     addr.type = DPS_TCP;
     addr.u.inaddr.ss_family = AF_INET6;
-#elif defined(DPS_USE_UDP)
+#elif defined(DPS_USE_UDP) || defined(DPS_USE_SIM)
     addr.type = DPS_UDP;
     addr.u.inaddr.ss_family = AF_INET6;
 #elif defined(DPS_USE_PIPE)
     addr.type = DPS_PIPE;
+#elif defined(DPS_USE_SHM)
+    addr.type = DPS_SHM;
 #endif
 
     ret = DPS_InitUUID();
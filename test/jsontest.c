@@ -20,6 +20,7 @@
  *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
  */
 
+#include <uv.h>
 #include "test.h"
 #include <dps/json.h>
 
@@ -97,6 +98,283 @@ static const char* invalid[] = {
 static uint8_t cbor1[1024];
 static uint8_t cbor2[1024];
 static char json[4096];
+static char jsonOut[4096];
+
+/*
+ * Input and output chunk sizes for the streaming tests
+ */
+static const size_t chunks[] = { 1, 3, 16, SIZE_MAX };
+
+static DPS_Status StreamJSON2CBOR(const char* json, size_t jsonLen, size_t inChunk, size_t outChunk,
+                                  uint8_t* cbor, size_t cborSize, size_t* cborLen)
+{
+    DPS_Status ret = DPS_OK;
+    DPS_JSON2CBORStream* stream = DPS_CreateJSON2CBORStream();
+    size_t pos = 0;
+    size_t used;
+    size_t len;
+    int last;
+
+    if (!stream) {
+        return DPS_ERR_RESOURCES;
+    }
+    *cborLen = 0;
+    do {
+        size_t in = (jsonLen - pos) < inChunk ? (jsonLen - pos) : inChunk;
+        size_t out = (cborSize - *cborLen) < outChunk ? (cborSize - *cborLen) : outChunk;
+        last = (pos + in) == jsonLen;
+        ret = DPS_JSON2CBORStreamConvert(stream, json + pos, in, last, &used, cbor + *cborLen, out, &len);
+        pos += used;
+        *cborLen += len;
+        if (ret == DPS_ERR_OVERFLOW && *cborLen < cborSize) {
+            ret = DPS_OK;
+            last = DPS_FALSE;
+        }
+    } while (ret == DPS_OK && !last);
+    DPS_DestroyJSON2CBORStream(stream);
+    return ret;
+}
+
+static DPS_Status StreamCBOR2JSON(const uint8_t* cbor, size_t cborLen, size_t inChunk, size_t outChunk,
+                                  char* json, size_t jsonSize, size_t* jsonLen, int pretty)
+{
+    DPS_Status ret = DPS_OK;
+    DPS_CBOR2JSONStream* stream = DPS_CreateCBOR2JSONStream(pretty);
+    size_t pos = 0;
+    size_t used;
+    size_t len;
+    int last;
+
+    if (!stream) {
+        return DPS_ERR_RESOURCES;
+    }
+    *jsonLen = 0;
+    do {
+        size_t in = (cborLen - pos) < inChunk ? (cborLen - pos) : inChunk;
+        size_t out = (jsonSize - *jsonLen) < outChunk ? (jsonSize - *jsonLen) : outChunk;
+        last = (pos + in) == cborLen;
+        ret = DPS_CBOR2JSONStreamConvert(stream, cbor + pos, in, last, &used, json + *jsonLen, out, &len);
+        pos += used;
+        *jsonLen += len;
+        if (ret == DPS_ERR_OVERFLOW && *jsonLen < jsonSize) {
+            ret = DPS_OK;
+            last = DPS_FALSE;
+        }
+    } while (ret == DPS_OK && !last);
+    DPS_DestroyCBOR2JSONStream(stream);
+    return ret;
+}
+
+static DPS_Status TestStreams(void)
+{
+    DPS_Status status = DPS_OK;
+    int pretty;
+    size_t cbor1Len;
+    size_t cbor2Len;
+    size_t jsonLen;
+    size_t i;
+    size_t in;
+    size_t out;
+
+    for (pretty = 0; pretty <= 1; ++pretty) {
+        for (i = 0; i < (sizeof(tests) / sizeof(tests[0])); ++i) {
+            status = DPS_JSON2CBOR(tests[i], cbor1, sizeof(cbor1), &cbor1Len);
+            CHECK(status);
+            status = DPS_CBOR2JSON(cbor1, cbor1Len, json, sizeof(json), pretty);
+            CHECK(status);
+            for (in = 0; in < (sizeof(chunks) / sizeof(chunks[0])); ++in) {
+                for (out = 0; out < (sizeof(chunks) / sizeof(chunks[0])); ++out) {
+                    /*
+                     * The streamed CBOR uses indefinite length arrays and
+                     * maps so compare the JSON generated from it
+                     */
+                    status = StreamJSON2CBOR(tests[i], strlen(tests[i]), chunks[in], chunks[out], cbor2,
+                                             sizeof(cbor2), &cbor2Len);
+                    CHECK(status);
+                    status = DPS_CBOR2JSON(cbor2, cbor2Len, jsonOut, sizeof(jsonOut), pretty);
+                    CHECK(status);
+                    if (strcmp(json, jsonOut) != 0) {
+                        printf("Stream test %zu failed:\n%s\n\n%s\n\n", i, json, jsonOut);
+                        CHECK(DPS_ERR_FAILURE);
+                    }
+                    status = StreamCBOR2JSON(cbor1, cbor1Len, chunks[in], chunks[out], jsonOut, sizeof(jsonOut),
+                                             &jsonLen, pretty);
+                    CHECK(status);
+                    if (jsonLen != strlen(json) || memcmp(json, jsonOut, jsonLen) != 0) {
+                        printf("Stream test %zu failed:\n%s\n\n%.*s\n\n", i, json, (int)jsonLen, jsonOut);
+                        CHECK(DPS_ERR_FAILURE);
+                    }
+                    status = StreamCBOR2JSON(cbor2, cbor2Len, chunks[in], chunks[out], jsonOut, sizeof(jsonOut),
+                                             &jsonLen, pretty);
+                    CHECK(status);
+                    if (jsonLen != strlen(json) || memcmp(json, jsonOut, jsonLen) != 0) {
+                        printf("Stream test %zu failed:\n%s\n\n%.*s\n\n", i, json, (int)jsonLen, jsonOut);
+                        CHECK(DPS_ERR_FAILURE);
+                    }
+                }
+            }
+        }
+    }
+    // These should all fail
+    for (i = 0; i < (sizeof(invalid) / sizeof(invalid[0])); ++i) {
+        for (in = 0; in < (sizeof(chunks) / sizeof(chunks[0])); ++in) {
+            status = StreamJSON2CBOR(invalid[i], strlen(invalid[i]), chunks[in], SIZE_MAX, cbor1, sizeof(cbor1),
+                                     &cbor1Len);
+            if (status == DPS_OK) {
+                printf("Stream test of invalid input %zu failed\n\n", i);
+                CHECK(DPS_ERR_FAILURE);
+            }
+        }
+    }
+    // Truncated CBOR should fail
+    status = DPS_JSON2CBOR(tests[11], cbor1, sizeof(cbor1), &cbor1Len);
+    CHECK(status);
+    status = StreamCBOR2JSON(cbor1, cbor1Len - 1, SIZE_MAX, SIZE_MAX, jsonOut, sizeof(jsonOut), &jsonLen, DPS_FALSE);
+    if (status != DPS_ERR_EOD) {
+        printf("Stream test of truncated CBOR failed\n\n");
+        CHECK(DPS_ERR_FAILURE);
+    }
+    return DPS_OK;
+
+Failed:
+    printf("Failed at test %zu line %d %s\n", i, ln, DPS_ErrTxt(status));
+    return status;
+}
+
+#define BENCHMARK_RECORDS  10000
+#define BENCHMARK_CHUNK    4096
+
+static const char record[] =
+    "  {\n"
+    "    \"id\": %d,\n"
+    "    \"name\": \"sensor-%d\",\n"
+    "    \"location\": \"building 7, floor 3, room %d\",\n"
+    "    \"temperature\": %d.25,\n"
+    "    \"humidity\": -%d,\n"
+    "    \"online\": true,\n"
+    "    \"tags\": [ \"hvac\", \"north\", null ],\n"
+    "    \"raw\": { \"$binary\": \"00112233445566778899AABBCCDDEEFF\" }\n"
+    "  }";
+
+/*
+ * Generates a document resembling a batch of telemetry records
+ */
+static size_t Telemetry(char* text, size_t size, int numRecords)
+{
+    size_t len = 0;
+    int i;
+
+    text[len++] = '[';
+    for (i = 0; i < numRecords; ++i) {
+        if (i) {
+            text[len++] = ',';
+        }
+        text[len++] = '\n';
+        len += snprintf(text + len, size - len, record, i, i, i % 100, i % 40, i % 100);
+    }
+    text[len++] = '\n';
+    text[len++] = ']';
+    text[len] = '\0';
+    return len;
+}
+
+static void PrintRate(const char* what, size_t bytes, int iterations, uint64_t ns)
+{
+    printf("%s: %.1f MB/sec\n", what, ((double)bytes * iterations) / (ns / 1.0e3));
+}
+
+/*
+ * Compares the one-shot and streaming converters. The one-shot JSON
+ * to CBOR conversion is limited to RSIZE_MAX_STR characters so is
+ * compared on a small document, the streaming converters are also run
+ * on a large document in chunks.
+ */
+static DPS_Status BenchmarkStreams(void)
+{
+    DPS_Status status = DPS_OK;
+    char* text = NULL;
+    char* out = NULL;
+    uint8_t* cbor = NULL;
+    size_t size = BENCHMARK_RECORDS * sizeof(record) * 2;
+    size_t textLen;
+    size_t cborLen;
+    size_t len;
+    uint64_t start;
+    int iterations;
+    int numRecords;
+    int i;
+
+    text = malloc(size);
+    out = malloc(size);
+    cbor = malloc(size);
+    if (!text || !out || !cbor) {
+        status = DPS_ERR_RESOURCES;
+        goto Exit;
+    }
+    numRecords = 4000 / sizeof(record);
+    iterations = 2000;
+    textLen = Telemetry(text, size, numRecords);
+    printf("Small document %zu bytes\n", textLen);
+    start = uv_hrtime();
+    for (i = 0; i < iterations; ++i) {
+        status = DPS_JSON2CBOR(text, cbor, size, &cborLen);
+        if (status != DPS_OK) {
+            goto Exit;
+        }
+    }
+    PrintRate("DPS_JSON2CBOR", textLen, iterations, uv_hrtime() - start);
+    start = uv_hrtime();
+    for (i = 0; i < iterations; ++i) {
+        status = StreamJSON2CBOR(text, textLen, textLen, size, (uint8_t*)out, size, &len);
+        if (status != DPS_OK) {
+            goto Exit;
+        }
+    }
+    PrintRate("DPS_JSON2CBORStreamConvert", textLen, iterations, uv_hrtime() - start);
+    start = uv_hrtime();
+    for (i = 0; i < iterations; ++i) {
+        status = DPS_CBOR2JSON(cbor, cborLen, out, size, DPS_TRUE);
+        if (status != DPS_OK) {
+            goto Exit;
+        }
+    }
+    PrintRate("DPS_CBOR2JSON", cborLen, iterations, uv_hrtime() - start);
+    start = uv_hrtime();
+    for (i = 0; i < iterations; ++i) {
+        status = StreamCBOR2JSON(cbor, cborLen, cborLen, size, out, size, &len, DPS_TRUE);
+        if (status != DPS_OK) {
+            goto Exit;
+        }
+    }
+    PrintRate("DPS_CBOR2JSONStreamConvert", cborLen, iterations, uv_hrtime() - start);
+
+    numRecords = BENCHMARK_RECORDS;
+    iterations = 10;
+    textLen = Telemetry(text, size, numRecords);
+    printf("Large document %zu bytes in %d byte chunks\n", textLen, BENCHMARK_CHUNK);
+    start = uv_hrtime();
+    for (i = 0; i < iterations; ++i) {
+        status = StreamJSON2CBOR(text, textLen, BENCHMARK_CHUNK, BENCHMARK_CHUNK, cbor, size, &cborLen);
+        if (status != DPS_OK) {
+            goto Exit;
+        }
+    }
+    PrintRate("DPS_JSON2CBORStreamConvert", textLen, iterations, uv_hrtime() - start);
+    start = uv_hrtime();
+    for (i = 0; i < iterations; ++i) {
+        status = StreamCBOR2JSON(cbor, cborLen, BENCHMARK_CHUNK, BENCHMARK_CHUNK, out, size, &len, DPS_TRUE);
+        if (status != DPS_OK) {
+            goto Exit;
+        }
+    }
+    PrintRate("DPS_CBOR2JSONStreamConvert", cborLen, iterations, uv_hrtime() - start);
+
+Exit:
+    free(cbor);
+    free(out);
+    free(text);
+    return status;
+}
 
 int main(int argc, char** argv)
 {
@@ -163,6 +441,11 @@ int main(int argc, char** argv)
         }
     }
 
+    status = TestStreams();
+    CHECK(status);
+    status = BenchmarkStreams();
+    CHECK(status);
+
     printf("Passed\n");
     return EXIT_SUCCESS;
 
@@ -0,0 +1,297 @@
+/*
+ *******************************************************************
+ *
+ * Copyright 2016 Intel Corporation All rights reserved.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ */
+
+/*
+ * Unicast link benchmark for comparing transports. A subscriber node
+ * links to a publisher node in the same process. Measures the round
+ * trip latency of publications and acknowledgements sent one at a
+ * time, then the throughput with a window of publications in flight.
+ * Publications lost by an unreliable transport are reported, not
+ * waited for. When built with io_uring the libuv UDP path can be
+ * selected for comparison.
+ */
+
+#include <uv.h>
+#include <dps/synchronous.h>
+#include "test.h"
+
+#define MAX_WINDOW 256
+
+static uv_mutex_t lock;
+static int NumPubs;
+static int Published;
+static int Sent;
+static int Received;
+static uint64_t LastReceived;
+static DPS_Buffer Payload;
+static DPS_Event* ackEvent;
+static DPS_Event* sendEvent;
+static DPS_Event* recvEvent;
+
+static void OnPubMatch(DPS_Subscription* sub, const DPS_Publication* pub, uint8_t* data, size_t len)
+{
+    int done;
+
+    if (DPS_PublicationIsAckRequested(pub)) {
+        DPS_AckPublication(pub, NULL, 0);
+        return;
+    }
+    uv_mutex_lock(&lock);
+    done = (++Received == NumPubs);
+    LastReceived = uv_hrtime();
+    uv_mutex_unlock(&lock);
+    if (done) {
+        DPS_SignalEvent(recvEvent, DPS_OK);
+    }
+}
+
+static void OnAck(DPS_Publication* pub, uint8_t* data, size_t len)
+{
+    DPS_SignalEvent(ackEvent, DPS_OK);
+}
+
+static DPS_Status Publish(DPS_Publication* pub);
+
+static void OnPublishComplete(DPS_Publication* pub, const DPS_Buffer* bufs, size_t numBufs, DPS_Status status,
+                              void* data)
+{
+    int done;
+
+    if (status != DPS_OK) {
+        DPS_ERRPRINT("Publish failed: %s\n", DPS_ErrTxt(status));
+    }
+    uv_mutex_lock(&lock);
+    done = (++Sent == NumPubs);
+    uv_mutex_unlock(&lock);
+    if (done) {
+        DPS_SignalEvent(sendEvent, DPS_OK);
+    } else {
+        /*
+         * Keep the window full by publishing again as soon as the
+         * previous publication has been sent
+         */
+        Publish(pub);
+    }
+}
+
+static DPS_Status Publish(DPS_Publication* pub)
+{
+    DPS_Status ret = DPS_OK;
+    int publish;
+
+    uv_mutex_lock(&lock);
+    publish = (Published < NumPubs);
+    if (publish) {
+        ++Published;
+    }
+    uv_mutex_unlock(&lock);
+    if (publish) {
+        ret = DPS_PublishBufs(pub, &Payload, Payload.len ? 1 : 0, 0, OnPublishComplete, NULL);
+        if (ret != DPS_OK) {
+            DPS_ERRPRINT("DPS_PublishBufs failed: %s\n", DPS_ErrTxt(ret));
+        }
+    }
+    return ret;
+}
+
+static void OnNodeDestroyed(DPS_Node* node, void* data)
+{
+    DPS_SignalEvent((DPS_Event*)data, DPS_OK);
+}
+
+int main(int argc, char** argv)
+{
+    DPS_Status ret;
+    char** arg = argv + 1;
+    const char* topics[] = { "dps/link_perf" };
+    DPS_Node* pubNode = NULL;
+    DPS_Node* subNode = NULL;
+    DPS_NodeAddress* addr = NULL;
+    DPS_Publication* ackPub = NULL;
+    DPS_Publication* pubs[MAX_WINDOW];
+    DPS_Subscription* sub = NULL;
+    DPS_Event* event = NULL;
+    int numRoundTrips = 1000;
+    int payloadLen = 100;
+    int window = 16;
+    int wait = 1000;
+    int ioUring = DPS_TRUE;
+    uint64_t minNs = UINT64_MAX;
+    uint64_t maxNs = 0;
+    uint64_t totalNs = 0;
+    uint64_t start;
+    uint64_t ns;
+    int i;
+
+    NumPubs = 100000;
+    DPS_Debug = DPS_FALSE;
+    while (--argc) {
+        if (IntArg("-n", &arg, &argc, &NumPubs, 1, INT32_MAX)) {
+            continue;
+        }
+        if (IntArg("-r", &arg, &argc, &numRoundTrips, 1, INT32_MAX)) {
+            continue;
+        }
+        if (IntArg("-s", &arg, &argc, &payloadLen, 0, 1024 * 1024)) {
+            continue;
+        }
+        if (IntArg("-p", &arg, &argc, &window, 1, MAX_WINDOW)) {
+            continue;
+        }
+        if (IntArg("-w", &arg, &argc, &wait, 0, UINT16_MAX)) {
+            continue;
+        }
+        if (strcmp(*arg, "-l") == 0) {
+            ++arg;
+            ioUring = DPS_FALSE;
+            continue;
+        }
+        if (strcmp(*arg, "-d") == 0) {
+            ++arg;
+            DPS_Debug = DPS_TRUE;
+            continue;
+        }
+        goto Usage;
+    }
+    uv_mutex_init(&lock);
+    ackEvent = DPS_CreateEvent();
+    sendEvent = DPS_CreateEvent();
+    recvEvent = DPS_CreateEvent();
+    event = DPS_CreateEvent();
+    ASSERT(ackEvent && sendEvent && recvEvent && event);
+    if (payloadLen) {
+        Payload.base = calloc(1, payloadLen);
+        ASSERT(Payload.base);
+    }
+    Payload.len = payloadLen;
+
+    pubNode = DPS_CreateNode("/.", NULL, NULL);
+    ASSERT(pubNode);
+    DPS_SetNodeIoUring(pubNode, ioUring);
+    ret = DPS_StartNode(pubNode, DPS_MCAST_PUB_DISABLED, NULL);
+    ASSERT(ret == DPS_OK);
+
+    subNode = DPS_CreateNode("/.", NULL, NULL);
+    ASSERT(subNode);
+    DPS_SetNodeIoUring(subNode, ioUring);
+    ret = DPS_StartNode(subNode, DPS_MCAST_PUB_DISABLED, NULL);
+    ASSERT(ret == DPS_OK);
+    sub = DPS_CreateSubscription(subNode, topics, 1);
+    ASSERT(sub);
+    ret = DPS_Subscribe(sub, OnPubMatch);
+    ASSERT(ret == DPS_OK);
+    addr = DPS_CreateAddress();
+    ASSERT(addr);
+    ret = DPS_LinkTo(subNode, DPS_GetListenAddressString(pubNode), addr);
+    ASSERT(ret == DPS_OK);
+
+    ackPub = DPS_CreatePublication(pubNode);
+    ASSERT(ackPub);
+    ret = DPS_InitPublication(ackPub, topics, 1, DPS_FALSE, NULL, OnAck);
+    ASSERT(ret == DPS_OK);
+    /*
+     * Retain the first publication so it is delivered once the
+     * subscription has reached the publisher node
+     */
+    ret = DPS_Publish(ackPub, Payload.base, Payload.len, 10);
+    ASSERT(ret == DPS_OK);
+    ret = DPS_TimedWaitForEvent(ackEvent, 5000);
+    ASSERT(ret == DPS_OK);
+
+    for (i = 0; i < numRoundTrips; ++i) {
+        start = uv_hrtime();
+        ret = DPS_Publish(ackPub, Payload.base, Payload.len, 0);
+        ASSERT(ret == DPS_OK);
+        ret = DPS_TimedWaitForEvent(ackEvent, 5000);
+        ASSERT(ret == DPS_OK);
+        ns = uv_hrtime() - start;
+        totalNs += ns;
+        if (ns < minNs) {
+            minNs = ns;
+        }
+        if (ns > maxNs) {
+            maxNs = ns;
+        }
+    }
+    DPS_PRINT("Round trip of %d bytes: min %.1f avg %.1f max %.1f usecs\n", payloadLen, minNs / 1.0e3,
+              totalNs / (numRoundTrips * 1.0e3), maxNs / 1.0e3);
+
+    if (window > NumPubs) {
+        window = NumPubs;
+    }
+    for (i = 0; i < window; ++i) {
+        pubs[i] = DPS_CreatePublication(pubNode);
+        ASSERT(pubs[i]);
+        ret = DPS_InitPublication(pubs[i], topics, 1, DPS_FALSE, NULL, NULL);
+        ASSERT(ret == DPS_OK);
+    }
+    /*
+     * Each publication in the window is published again when the
+     * previous send completes
+     */
+    start = uv_hrtime();
+    for (i = 0; i < window; ++i) {
+        ret = Publish(pubs[i]);
+        ASSERT(ret == DPS_OK);
+    }
+    DPS_WaitForEvent(sendEvent);
+    /*
+     * Allow time for the publications in flight to be received
+     */
+    DPS_TimedWaitForEvent(recvEvent, (uint16_t)wait);
+    uv_mutex_lock(&lock);
+    if (Received) {
+        ns = LastReceived - start;
+        DPS_PRINT("Received %d publications of %d bytes in %.1f msecs, %.0f pubs/sec, %.1f MB/sec\n", Received,
+                  payloadLen, ns / 1.0e6, Received / (ns / 1.0e9), ((double)Received * payloadLen) / (ns / 1.0e3));
+    }
+    DPS_PRINT("%.1f%% of %d publications lost\n", 100.0 * (Sent - Received) / Sent, Sent);
+    uv_mutex_unlock(&lock);
+
+    for (i = 0; i < window; ++i) {
+        DPS_DestroyPublication(pubs[i]);
+    }
+    DPS_DestroyPublication(ackPub);
+    DPS_DestroySubscription(sub);
+    DPS_DestroyAddress(addr);
+    DPS_DestroyNode(subNode, OnNodeDestroyed, event);
+    DPS_WaitForEvent(event);
+    DPS_DestroyNode(pubNode, OnNodeDestroyed, event);
+    DPS_WaitForEvent(event);
+    DPS_DestroyEvent(event);
+    DPS_DestroyEvent(recvEvent);
+    DPS_DestroyEvent(sendEvent);
+    DPS_DestroyEvent(ackEvent);
+    free(Payload.base);
+    return EXIT_SUCCESS;
+
+Usage:
+    DPS_PRINT("Usage %s: [-d] [-l] [-n <num-pubs>] [-r <round-trips>] [-p <window>] [-s <payload-size>] [-w <msecs>]\n",
+              argv[0]);
+    DPS_PRINT("       -l: Use the libuv UDP path even if io_uring is available.\n");
+    DPS_PRINT("       -n: Number of publications to send when measuring throughput.\n");
+    DPS_PRINT("       -r: Number of round trips when measuring latency.\n");
+    DPS_PRINT("       -p: Number of publications in flight.\n");
+    DPS_PRINT("       -s: Size of the publication payload in bytes.\n");
+    DPS_PRINT("       -w: Time to wait for publications in flight to be received.\n");
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,235 @@
+/*
+ *******************************************************************
+ *
+ * Copyright 2016 Intel Corporation All rights reserved.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ */
+
+/*
+ * Checks the log sinks, asynchronous logging, and rate limiting, then
+ * compares the cost of logging synchronously and asynchronously.
+ */
+
+#include <uv.h>
+#include "test.h"
+
+#ifdef _WIN32
+#define NULL_DEVICE "NUL"
+#else
+#define NULL_DEVICE "/dev/null"
+#endif
+
+#define NUM_THREADS   4
+#define NUM_MESSAGES  2000
+
+static uv_mutex_t lock;
+static uint64_t Received;
+
+#ifdef DPS_DEBUG
+extern int _DPS_NumLogRings;
+#endif
+
+static void CountingSink(DPS_LogLevel level, const char* msg, size_t len, void* data)
+{
+    ASSERT(len && msg[len - 1] == '\n');
+    uv_mutex_lock(&lock);
+    ++Received;
+    uv_mutex_unlock(&lock);
+}
+
+static void LogThread(void* arg)
+{
+    int i;
+
+    for (i = 0; i < NUM_MESSAGES; ++i) {
+        DPS_ERRPRINT("Message %d from thread %p\n", i, arg);
+    }
+}
+
+static uint64_t GetReceived(void)
+{
+    uint64_t n;
+
+    uv_mutex_lock(&lock);
+    n = Received;
+    Received = 0;
+    uv_mutex_unlock(&lock);
+    return n;
+}
+
+static void TestSyncSink(void)
+{
+    uint8_t bytes[40] = { 0 };
+    uint64_t received;
+    int i;
+
+    DPS_SetLogSink(CountingSink, NULL);
+    for (i = 0; i < 100; ++i) {
+        DPS_ERRPRINT("Message %d\n", i);
+    }
+    received = GetReceived();
+    ASSERT(received == 100);
+    /*
+     * One message per line of 16 bytes
+     */
+    DPS_LogBytes(DPS_LOG_ERROR, __FILE__, __LINE__, __FUNCTION__, bytes, sizeof(bytes));
+    received = GetReceived();
+    ASSERT(received == 3);
+    DPS_SetLogSink(NULL, NULL);
+}
+
+static void TestTruncated(void)
+{
+    static char longStr[2048];
+    uint64_t received;
+
+    memset(longStr, 'x', sizeof(longStr) - 1);
+    /*
+     * The sink checks that the truncated message still ends with a newline
+     */
+    DPS_SetLogSink(CountingSink, NULL);
+    DPS_ERRPRINT("%s\n", longStr);
+    received = GetReceived();
+    ASSERT(received == 1);
+    DPS_SetLogSink(NULL, NULL);
+}
+
+static void TestAsync(void)
+{
+    uv_thread_t threads[NUM_THREADS];
+    DPS_Status ret;
+    uint64_t dropped;
+    uint64_t received;
+    int i;
+    int r;
+    int pass;
+
+    DPS_SetLogSink(CountingSink, NULL);
+    dropped = DPS_GetLogDropCount();
+    ret = DPS_StartAsyncLog();
+    ASSERT(ret == DPS_OK);
+    for (pass = 0; pass < 2; ++pass) {
+        for (i = 0; i < NUM_THREADS; ++i) {
+            r = uv_thread_create(&threads[i], LogThread, &threads[i]);
+            ASSERT(r == 0);
+        }
+        for (i = 0; i < NUM_THREADS; ++i) {
+            uv_thread_join(&threads[i]);
+        }
+    }
+#ifdef DPS_DEBUG
+    /*
+     * The second set of threads reuses the rings of the first
+     */
+    ASSERT(_DPS_NumLogRings <= NUM_THREADS);
+#endif
+    DPS_StopAsyncLog();
+    /*
+     * Every message is either written or counted as dropped
+     */
+    received = GetReceived();
+    dropped = DPS_GetLogDropCount() - dropped;
+    DPS_SetLogSink(NULL, NULL);
+    DPS_PRINT("Async: %d logged, %d written, %d dropped\n", 2 * NUM_THREADS * NUM_MESSAGES, (int)received,
+              (int)dropped);
+    ASSERT((received + dropped) == (2 * NUM_THREADS * NUM_MESSAGES));
+    ASSERT(received > 0);
+}
+
+static void TestRateLimit(void)
+{
+    uint64_t dropped;
+    uint64_t received;
+    int i;
+
+    DPS_SetLogSink(CountingSink, NULL);
+    DPS_SetLogRateLimit(10);
+    dropped = DPS_GetLogDropCount();
+    for (i = 0; i < 100; ++i) {
+        DPS_ERRPRINT("Message %d\n", i);
+    }
+    /*
+     * DPS_PRINT is not rate limited
+     */
+    for (i = 0; i < 20; ++i) {
+        DPS_PRINT("Message %d\n", i);
+    }
+    DPS_SetLogRateLimit(0);
+    received = GetReceived();
+    dropped = DPS_GetLogDropCount() - dropped;
+    /*
+     * The limit may be applied in two different seconds
+     */
+    ASSERT(received >= 30 && received <= 40);
+    ASSERT((received + dropped) == 120);
+    DPS_SetLogSink(NULL, NULL);
+}
+
+static void Benchmark(int async, FILE* f)
+{
+    uv_thread_t threads[NUM_THREADS];
+    uint64_t start;
+    uint64_t ns;
+    uint64_t dropped;
+    int i;
+    int r;
+
+    DPS_SetLogSink(DPS_LogFileSink, f);
+    dropped = DPS_GetLogDropCount();
+    if (async) {
+        DPS_StartAsyncLog();
+    }
+    start = uv_hrtime();
+    for (i = 0; i < NUM_THREADS; ++i) {
+        r = uv_thread_create(&threads[i], LogThread, &threads[i]);
+        ASSERT(r == 0);
+    }
+    for (i = 0; i < NUM_THREADS; ++i) {
+        uv_thread_join(&threads[i]);
+    }
+    ns = uv_hrtime() - start;
+    if (async) {
+        DPS_StopAsyncLog();
+    }
+    dropped = DPS_GetLogDropCount() - dropped;
+    DPS_SetLogSink(NULL, NULL);
+    DPS_PRINT("%-5s %d threads: %6.1f nsecs per message, %d dropped\n", async ? "Async" : "Sync", NUM_THREADS,
+              (double)ns / (NUM_THREADS * NUM_MESSAGES), (int)dropped);
+}
+
+int main(int argc, char** argv)
+{
+    FILE* f;
+
+    DPS_Debug = DPS_FALSE;
+    uv_mutex_init(&lock);
+
+    TestSyncSink();
+    TestTruncated();
+    TestAsync();
+    TestRateLimit();
+
+    f = fopen(NULL_DEVICE, "w");
+    ASSERT(f);
+    Benchmark(DPS_FALSE, f);
+    Benchmark(DPS_TRUE, f);
+    fclose(f);
+
+    DPS_PRINT("Passed\n");
+    return EXIT_SUCCESS;
+}
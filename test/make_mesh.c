@@ -130,27 +130,6 @@ static LINK* AddLink(uint16_t src, uint16_t dst)
     return l;
 }
 
-static int StrArg(char* opt, char*** argp, int* argcp, const char** val)
-{
-    char** arg = *argp;
-    int argc = *argcp;
-
-    if (strcmp(*arg++, opt) != 0) {
-        return 0;
-    }
-    if (!--argc) {
-        return 0;
-    }
-    *val = *arg++;
-    if (**val == '-') {
-        DPS_PRINT("Value for option %s must be a string\n", opt);
-        return 0;
-    }
-    *argp = arg;
-    *argcp = argc;
-    return 1;
-}
-
 static uint16_t GetPort(const DPS_NodeAddress* nodeAddr)
 {
     const struct sockaddr* addr = (const struct sockaddr*)&nodeAddr->u.inaddr;
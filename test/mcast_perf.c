@@ -0,0 +1,216 @@
+/*
+ *******************************************************************
+ *
+ * Copyright 2016 Intel Corporation All rights reserved.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ */
+
+/*
+ * Multicast throughput benchmark. Publishes as fast as possible from a
+ * multicast sender node to a multicast receiver node in the same
+ * process, relying on multicast loopback to deliver the publications.
+ * A window of publications is kept in flight. Reports the send rate
+ * and the number of publications received.
+ */
+
+#include <uv.h>
+#include "test.h"
+
+#define MAX_WINDOW 256
+
+static uv_mutex_t lock;
+static int NumPubs;
+static int Published;
+static int Sent;
+static int Received;
+static DPS_Buffer Payload;
+static DPS_Event* sendEvent;
+
+static void OnPubMatch(DPS_Subscription* sub, const DPS_Publication* pub, uint8_t* data, size_t len)
+{
+    uv_mutex_lock(&lock);
+    ++Received;
+    uv_mutex_unlock(&lock);
+}
+
+static DPS_Status Publish(DPS_Publication* pub);
+
+static void OnPublishComplete(DPS_Publication* pub, const DPS_Buffer* bufs, size_t numBufs, DPS_Status status,
+                              void* data)
+{
+    int done;
+
+    if (status != DPS_OK) {
+        DPS_ERRPRINT("Publish failed: %s\n", DPS_ErrTxt(status));
+    }
+    uv_mutex_lock(&lock);
+    done = (++Sent == NumPubs);
+    uv_mutex_unlock(&lock);
+    if (done) {
+        DPS_SignalEvent(sendEvent, DPS_OK);
+    } else {
+        /*
+         * Keep the window full by publishing again as soon as the
+         * previous publication has been sent
+         */
+        Publish(pub);
+    }
+}
+
+static DPS_Status Publish(DPS_Publication* pub)
+{
+    DPS_Status ret = DPS_OK;
+    int publish;
+
+    uv_mutex_lock(&lock);
+    publish = (Published < NumPubs);
+    if (publish) {
+        ++Published;
+    }
+    uv_mutex_unlock(&lock);
+    if (publish) {
+        ret = DPS_PublishBufs(pub, &Payload, Payload.len ? 1 : 0, 0, OnPublishComplete, NULL);
+        if (ret != DPS_OK) {
+            DPS_ERRPRINT("DPS_PublishBufs failed: %s\n", DPS_ErrTxt(ret));
+        }
+    }
+    return ret;
+}
+
+static void OnNodeDestroyed(DPS_Node* node, void* data)
+{
+    DPS_SignalEvent((DPS_Event*)data, DPS_OK);
+}
+
+int main(int argc, char** argv)
+{
+    DPS_Status ret;
+    char** arg = argv + 1;
+    const char* topics[] = { "dps/mcast_perf" };
+    DPS_Node* pubNode = NULL;
+    DPS_Node* subNode = NULL;
+    DPS_Publication* pubs[MAX_WINDOW];
+    DPS_Subscription* sub = NULL;
+    DPS_Event* event = NULL;
+    int payloadLen = 100;
+    int window = 16;
+    int wait = 1000;
+    uint64_t start;
+    uint64_t sendNs;
+    int i;
+
+    NumPubs = 10000;
+    DPS_Debug = DPS_FALSE;
+    while (--argc) {
+        if (IntArg("-n", &arg, &argc, &NumPubs, 1, INT32_MAX)) {
+            continue;
+        }
+        if (IntArg("-s", &arg, &argc, &payloadLen, 0, 65536)) {
+            continue;
+        }
+        if (IntArg("-w", &arg, &argc, &wait, 0, UINT16_MAX)) {
+            continue;
+        }
+        if (IntArg("-p", &arg, &argc, &window, 1, MAX_WINDOW)) {
+            continue;
+        }
+        if (strcmp(*arg, "-d") == 0) {
+            ++arg;
+            DPS_Debug = DPS_TRUE;
+            continue;
+        }
+        goto Usage;
+    }
+    uv_mutex_init(&lock);
+    sendEvent = DPS_CreateEvent();
+    event = DPS_CreateEvent();
+    ASSERT(sendEvent && event);
+    if (payloadLen) {
+        Payload.base = calloc(1, payloadLen);
+        ASSERT(Payload.base);
+    }
+    Payload.len = payloadLen;
+
+    subNode = DPS_CreateNode("/.", NULL, NULL);
+    ASSERT(subNode);
+    ret = DPS_StartNode(subNode, DPS_MCAST_PUB_ENABLE_RECV, NULL);
+    ASSERT(ret == DPS_OK);
+    sub = DPS_CreateSubscription(subNode, topics, 1);
+    ASSERT(sub);
+    ret = DPS_Subscribe(sub, OnPubMatch);
+    ASSERT(ret == DPS_OK);
+
+    pubNode = DPS_CreateNode("/.", NULL, NULL);
+    ASSERT(pubNode);
+    ret = DPS_StartNode(pubNode, DPS_MCAST_PUB_ENABLE_SEND, NULL);
+    ASSERT(ret == DPS_OK);
+    if (window > NumPubs) {
+        window = NumPubs;
+    }
+    for (i = 0; i < window; ++i) {
+        pubs[i] = DPS_CreatePublication(pubNode);
+        ASSERT(pubs[i]);
+        ret = DPS_InitPublication(pubs[i], topics, 1, DPS_FALSE, NULL, NULL);
+        ASSERT(ret == DPS_OK);
+    }
+
+    /*
+     * Each publication in the window is published again when the
+     * previous send completes
+     */
+    start = uv_hrtime();
+    for (i = 0; i < window; ++i) {
+        ret = Publish(pubs[i]);
+        if (ret != DPS_OK) {
+            return EXIT_FAILURE;
+        }
+    }
+    DPS_WaitForEvent(sendEvent);
+    sendNs = uv_hrtime() - start;
+    /*
+     * Allow time for the publications in flight to be received
+     */
+    DPS_TimedWaitForEvent(event, (uint16_t)wait);
+
+    uv_mutex_lock(&lock);
+    DPS_PRINT("Sent %d publications of %d bytes in %.1f msecs, %.0f pubs/sec\n", Sent, payloadLen, sendNs / 1.0e6,
+              Sent / (sendNs / 1.0e9));
+    DPS_PRINT("Received %d publications (%.1f%% lost)\n", Received, 100.0 * (Sent - Received) / Sent);
+    uv_mutex_unlock(&lock);
+
+    for (i = 0; i < window; ++i) {
+        DPS_DestroyPublication(pubs[i]);
+    }
+    DPS_DestroySubscription(sub);
+    DPS_DestroyNode(pubNode, OnNodeDestroyed, event);
+    DPS_WaitForEvent(event);
+    DPS_DestroyNode(subNode, OnNodeDestroyed, event);
+    DPS_WaitForEvent(event);
+    DPS_DestroyEvent(event);
+    DPS_DestroyEvent(sendEvent);
+    free(Payload.base);
+    return EXIT_SUCCESS;
+
+Usage:
+    DPS_PRINT("Usage %s: [-d] [-n <num-pubs>] [-p <window>] [-s <payload-size>] [-w <msecs>]\n", argv[0]);
+    DPS_PRINT("       -n: Number of publications to send.\n");
+    DPS_PRINT("       -p: Number of publications in flight.\n");
+    DPS_PRINT("       -s: Size of the publication payload in bytes.\n");
+    DPS_PRINT("       -w: Time to wait for publications in flight to be received.\n");
+    return EXIT_FAILURE;
+}
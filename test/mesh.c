@@ -0,0 +1,120 @@
+/*
+*******************************************************************
+*
+* Copyright 2018 Intel Corporation All rights reserved.
+*
+*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+
+#include "test.h"
+#include "mesh.h"
+
+MeshLink* AddMeshLink(MeshLink** links, uint16_t src, uint16_t dst)
+{
+    MeshLink* l;
+
+    for (l = *links; l != NULL; l = l->next) {
+        if ((l->src == src && l->dst == dst) || (l->src == dst && l->dst == src)) {
+            return l;
+        }
+    }
+    l = calloc(1, sizeof(MeshLink));
+    if (l) {
+        l->src = src;
+        l->dst = dst;
+        l->next = *links;
+        *links = l;
+    }
+    return l;
+}
+
+int ReadMeshLinks(const char* fn, MeshLink** links, uint16_t* ids, int maxIds)
+{
+    uint8_t* seen = NULL;
+    int numIds = 0;
+    FILE* f;
+    char line[32];
+
+    *links = NULL;
+    f = fopen(fn, "r");
+    if (!f) {
+        DPS_PRINT("Could not open file %s\n", fn);
+        return 0;
+    }
+    seen = calloc(UINT16_MAX, sizeof(uint8_t));
+    if (!seen) {
+        goto ErrExit;
+    }
+    while (fgets(line, sizeof(line), f) != NULL) {
+        char* l = line;
+        char* e;
+        long ep[2];
+        int i;
+
+        ep[0] = strtol(l, &e, 10);
+        if (l == e) {
+            continue;
+        }
+        l = e;
+        ep[1] = strtol(l, &e, 10);
+        if (l == e) {
+            DPS_PRINT("Link requires two nodes\n");
+            goto ErrExit;
+        }
+        if (ep[0] == ep[1]) {
+            DPS_PRINT("Cannot link to self\n");
+            goto ErrExit;
+        }
+        for (i = 0; i < 2; ++i) {
+            if ((ep[i] < 0) || (ep[i] >= UINT16_MAX)) {
+                DPS_PRINT("Node id %ld is out of range\n", ep[i]);
+                goto ErrExit;
+            }
+            if (!seen[ep[i]]) {
+                if (numIds == maxIds) {
+                    DPS_PRINT("Too many nodes, the limit is %d\n", maxIds);
+                    goto ErrExit;
+                }
+                seen[ep[i]] = DPS_TRUE;
+                ids[numIds++] = (uint16_t)ep[i];
+            }
+        }
+        if (!AddMeshLink(links, (uint16_t)ep[0], (uint16_t)ep[1])) {
+            goto ErrExit;
+        }
+    }
+    free(seen);
+    fclose(f);
+    return numIds;
+
+ErrExit:
+
+    free(seen);
+    fclose(f);
+    FreeMeshLinks(*links);
+    *links = NULL;
+    return 0;
+}
+
+void FreeMeshLinks(MeshLink* links)
+{
+    while (links) {
+        MeshLink* next = links->next;
+        free(links);
+        links = next;
+    }
+}
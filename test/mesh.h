@@ -0,0 +1,69 @@
+/*
+*******************************************************************
+*
+* Copyright 2018 Intel Corporation All rights reserved.
+*
+*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+
+#ifndef _MESH_H
+#define _MESH_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A link between two nodes of a test mesh
+ */
+typedef struct _MeshLink {
+    uint16_t src;
+    uint16_t dst;
+    struct _MeshLink* next;
+} MeshLink;
+
+/*
+ * Add a link to a list of links unless the nodes are already linked
+ *
+ * Returns the new or existing link, NULL if the link could not be allocated
+ */
+MeshLink* AddMeshLink(MeshLink** links, uint16_t src, uint16_t dst);
+
+/*
+ * Read the links from a mesh file (see test/meshes). Each line of the
+ * file holds the ids of two nodes to link, lines without a node id are
+ * ignored.
+ *
+ * The ids are returned in the order they first appear in the file.
+ *
+ * Returns the number of node ids, 0 if the file could not be read or
+ * holds more than maxIds node ids
+ */
+int ReadMeshLinks(const char* fn, MeshLink** links, uint16_t* ids, int maxIds);
+
+/*
+ * Free a list of links
+ */
+void FreeMeshLinks(MeshLink* links);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
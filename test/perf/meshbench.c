@@ -0,0 +1,493 @@
+/*
+ *******************************************************************
+ *
+ * Copyright 2018 Intel Corporation All rights reserved.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ */
+
+/*
+ * Macro-benchmark that builds an in-process mesh from a mesh file (see
+ * test/meshes) and measures subscription convergence time, publication
+ * throughput, delivery latency, and the bytes sent by each transport.
+ * The publisher and subscriber nodes are picked with a seeded generator
+ * so runs with the same arguments are repeatable. The results are
+ * printed as a single JSON object.
+ */
+
+#include <uv.h>
+#include <dps/private/network.h>
+#include "../test.h"
+#include "../mesh.h"
+#include "node.h"
+
+#define MAX_TRANSPORTS  8
+
+/*
+ * Maps node id's to DPS nodes
+ */
+static DPS_Node* NodeMap[UINT16_MAX];
+
+/*
+ * List of node id's from the input file
+ */
+static uint16_t NodeList[UINT16_MAX];
+
+static MeshLink* links = NULL;
+
+/*
+ * Publications carry the time they were sent and the phase of the
+ * benchmark they belong to
+ */
+#define PHASE_PROBE    0
+#define PHASE_MEASURE  1
+
+typedef struct {
+    uint64_t sent;
+    uint32_t phase;
+} Payload;
+
+static uv_mutex_t lock;
+static uv_cond_t cond;
+
+static int LinksUp;
+static int LinksFailed;
+static int NodesDestroyed;
+
+static int NumSubscribers;
+static int Converged;
+static uint64_t ConvergedTime;
+
+static uint64_t* Latencies;
+static size_t NumLatencies;
+static size_t MaxLatencies;
+static uint64_t LastDelivery;
+
+static void OnPub(DPS_Subscription* sub, const DPS_Publication* pub, uint8_t* data, size_t len)
+{
+    uint64_t now = uv_hrtime();
+    int* gotProbe = DPS_GetSubscriptionData(sub);
+    Payload p;
+
+    if (len < sizeof(p)) {
+        return;
+    }
+    memcpy(&p, data, sizeof(p));
+    uv_mutex_lock(&lock);
+    if (p.phase == PHASE_PROBE) {
+        if (!*gotProbe) {
+            *gotProbe = DPS_TRUE;
+            if (++Converged == NumSubscribers) {
+                ConvergedTime = now;
+                uv_cond_signal(&cond);
+            }
+        }
+    } else {
+        if (NumLatencies < MaxLatencies) {
+            Latencies[NumLatencies++] = now - p.sent;
+        }
+        LastDelivery = now;
+        uv_cond_signal(&cond);
+    }
+    uv_mutex_unlock(&lock);
+}
+
+static void OnLinked(DPS_Node* node, DPS_NodeAddress* addr, DPS_Status status, void* data)
+{
+    uv_mutex_lock(&lock);
+    if (status == DPS_OK) {
+        ++LinksUp;
+    } else {
+        DPS_ERRPRINT("Failed to Link to %s - %s\n", DPS_NodeAddrToString(addr), DPS_ErrTxt(status));
+        ++LinksFailed;
+    }
+    uv_cond_signal(&cond);
+    uv_mutex_unlock(&lock);
+}
+
+static void OnNodeDestroyed(DPS_Node* node, void* data)
+{
+    uv_mutex_lock(&lock);
+    ++NodesDestroyed;
+    uv_cond_signal(&cond);
+    uv_mutex_unlock(&lock);
+}
+
+/*
+ * Sum the transport counters over all the nodes
+ */
+static size_t GetStats(DPS_NetStats* stats)
+{
+    DPS_NetStats nodeStats[MAX_TRANSPORTS];
+    size_t numStats = 0;
+    size_t n;
+    size_t i;
+    size_t j;
+
+    memset(stats, 0, MAX_TRANSPORTS * sizeof(DPS_NetStats));
+    for (i = 0; i < A_SIZEOF(NodeMap); ++i) {
+        if (NodeMap[i]) {
+            DPS_LockNode(NodeMap[i]);
+            n = DPS_NetGetStats(NodeMap[i]->netCtx, nodeStats, MAX_TRANSPORTS);
+            DPS_UnlockNode(NodeMap[i]);
+            for (j = 0; j < n; ++j) {
+                stats[j].transport = nodeStats[j].transport;
+                stats[j].msgsSent += nodeStats[j].msgsSent;
+                stats[j].bytesSent += nodeStats[j].bytesSent;
+            }
+            numStats = n;
+        }
+    }
+    return numStats;
+}
+
+static uint32_t NextRand(uint32_t* seed)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return *seed >> 16;
+}
+
+static int CompareLatencies(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static double Percentile(size_t p)
+{
+    size_t i;
+
+    if (!NumLatencies) {
+        return 0.0;
+    }
+    i = (NumLatencies * p) / 100;
+    if (i >= NumLatencies) {
+        i = NumLatencies - 1;
+    }
+    return (double)Latencies[i] / 1000.0;
+}
+
+static DPS_Status Publish(DPS_Publication* pub, uint8_t* buf, size_t len, uint32_t phase)
+{
+    Payload p;
+
+    p.sent = uv_hrtime();
+    p.phase = phase;
+    memcpy(buf, &p, sizeof(p));
+    return DPS_Publish(pub, buf, len, 0);
+}
+
+int main(int argc, char** argv)
+{
+    static const char* topics[] = { "dps/perf/mesh" };
+    DPS_Status ret;
+    char** arg = argv + 1;
+    const char* inFn = NULL;
+    const char* meshName;
+    MeshLink* l;
+    DPS_Node* pubNode;
+    DPS_Publication* pub = NULL;
+    DPS_Subscription** subs = NULL;
+    int* gotProbe = NULL;
+    uint8_t* buf = NULL;
+    DPS_NetStats before[MAX_TRANSPORTS];
+    DPS_NetStats converged[MAX_TRANSPORTS];
+    DPS_NetStats after[MAX_TRANSPORTS];
+    size_t numStats;
+    uint64_t start;
+    uint64_t linkNs;
+    uint64_t convergeNs = 0;
+    uint64_t measureNs = 0;
+    uint64_t expected;
+    uint64_t writtenOff = 0;
+    uint32_t seed = 1;
+    int numIds = 0;
+    int numLinks = 0;
+    int numSubs = 1;
+    int numPubs = 1000;
+    int payloadLen = 64;
+    int window = 16;
+    int subsRate = -1;
+    int seedArg = 1;
+    int numNodes;
+    int i;
+    int r;
+
+    DPS_Debug = DPS_FALSE;
+    while (--argc) {
+        if (StrArg("-f", &arg, &argc, &inFn)) {
+            continue;
+        }
+        if (IntArg("-n", &arg, &argc, &numPubs, 1, 10000000)) {
+            continue;
+        }
+        if (IntArg("-s", &arg, &argc, &numSubs, 1, UINT16_MAX)) {
+            continue;
+        }
+        if (IntArg("-l", &arg, &argc, &payloadLen, sizeof(Payload), UINT16_MAX)) {
+            continue;
+        }
+        if (IntArg("-w", &arg, &argc, &window, 1, 100000)) {
+            continue;
+        }
+        if (IntArg("-r", &arg, &argc, &subsRate, 0, 10000)) {
+            continue;
+        }
+        if (IntArg("-S", &arg, &argc, &seedArg, 0, INT32_MAX)) {
+            continue;
+        }
+        if (strcmp(*arg, "-d") == 0) {
+            ++arg;
+            DPS_Debug = DPS_TRUE;
+            continue;
+        }
+        if (*arg[0] == '-') {
+            goto Usage;
+        }
+        inFn = *arg++;
+    }
+    if (!inFn) {
+        goto Usage;
+    }
+    numIds = ReadMeshLinks(inFn, &links, NodeList, A_SIZEOF(NodeList));
+    if (numIds == 0) {
+        return EXIT_FAILURE;
+    }
+    if (numSubs >= numIds) {
+        DPS_PRINT("Need more nodes than subscribers\n");
+        return EXIT_FAILURE;
+    }
+    meshName = strrchr(inFn, '/');
+    meshName = meshName ? meshName + 1 : inFn;
+    seed = (uint32_t)seedArg;
+
+    uv_mutex_init(&lock);
+    uv_cond_init(&cond);
+    expected = (uint64_t)numPubs * numSubs;
+    MaxLatencies = (size_t)expected;
+    Latencies = malloc(MaxLatencies * sizeof(uint64_t));
+    subs = calloc(numSubs, sizeof(DPS_Subscription*));
+    gotProbe = calloc(numSubs, sizeof(int));
+    buf = calloc(1, payloadLen);
+    if (!Latencies || !subs || !gotProbe || !buf) {
+        DPS_ERRPRINT("Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    /*
+     * Start the nodes
+     */
+    for (i = 0; i < numIds; ++i) {
+        DPS_NodeAddress* listenAddr;
+        DPS_Node* node = DPS_CreateNode("/", NULL, NULL);
+
+        if (subsRate >= 0) {
+            DPS_SetNodeSubscriptionUpdateDelay(node, subsRate);
+        }
+        listenAddr = DPS_CreateAddress();
+        if (!listenAddr) {
+            DPS_ERRPRINT("Failed to create address: %s\n", DPS_ErrTxt(DPS_ERR_RESOURCES));
+            return EXIT_FAILURE;
+        }
+        DPS_SetAddress(listenAddr, "[::1]:0");
+        ret = DPS_StartNode(node, DPS_FALSE, listenAddr);
+        DPS_DestroyAddress(listenAddr);
+        if (ret != DPS_OK) {
+            DPS_ERRPRINT("Failed to start node: %s\n", DPS_ErrTxt(ret));
+            return EXIT_FAILURE;
+        }
+        NodeMap[NodeList[i]] = node;
+    }
+    /*
+     * Link the nodes asynchronously and wait until all the links are up
+     */
+    start = uv_hrtime();
+    for (l = links; l != NULL; l = l->next) {
+        ret = DPS_Link(NodeMap[l->src], DPS_GetListenAddressString(NodeMap[l->dst]), OnLinked, NULL);
+        if (ret != DPS_OK) {
+            DPS_ERRPRINT("DPS_Link returned %s\n", DPS_ErrTxt(ret));
+            return EXIT_FAILURE;
+        }
+        ++numLinks;
+    }
+    uv_mutex_lock(&lock);
+    while ((LinksUp + LinksFailed) < numLinks) {
+        uv_cond_wait(&cond, &lock);
+    }
+    uv_mutex_unlock(&lock);
+    linkNs = uv_hrtime() - start;
+    if (LinksFailed) {
+        DPS_ERRPRINT("%d links failed\n", LinksFailed);
+        return EXIT_FAILURE;
+    }
+    /*
+     * Brief delay to let the links settle down
+     */
+    SLEEP(1000);
+    /*
+     * Pick the publisher and subscribers by shuffling the node list
+     */
+    for (i = numIds - 1; i > 0; --i) {
+        int j = NextRand(&seed) % (i + 1);
+        uint16_t id = NodeList[i];
+        NodeList[i] = NodeList[j];
+        NodeList[j] = id;
+    }
+    pubNode = NodeMap[NodeList[0]];
+    pub = DPS_CreatePublication(pubNode);
+    ret = DPS_InitPublication(pub, topics, A_SIZEOF(topics), DPS_FALSE, NULL, NULL);
+    if (ret != DPS_OK) {
+        DPS_ERRPRINT("Failed to initialize publication: %s\n", DPS_ErrTxt(ret));
+        return EXIT_FAILURE;
+    }
+    /*
+     * Subscription convergence is the time from subscribing until every
+     * subscriber has received a probe publication from the publisher
+     */
+    GetStats(before);
+    NumSubscribers = numSubs;
+    start = uv_hrtime();
+    for (i = 0; i < numSubs; ++i) {
+        subs[i] = DPS_CreateSubscription(NodeMap[NodeList[i + 1]], topics, A_SIZEOF(topics));
+        if (!subs[i]) {
+            DPS_ERRPRINT("Failed to create subscription\n");
+            return EXIT_FAILURE;
+        }
+        DPS_SetSubscriptionData(subs[i], &gotProbe[i]);
+        ret = DPS_Subscribe(subs[i], OnPub);
+        if (ret != DPS_OK) {
+            DPS_ERRPRINT("Failed to subscribe: %s\n", DPS_ErrTxt(ret));
+            return EXIT_FAILURE;
+        }
+    }
+    uv_mutex_lock(&lock);
+    while (Converged < numSubs) {
+        uv_mutex_unlock(&lock);
+        ret = Publish(pub, buf, payloadLen, PHASE_PROBE);
+        if (ret != DPS_OK) {
+            DPS_ERRPRINT("Failed to publish: %s\n", DPS_ErrTxt(ret));
+            return EXIT_FAILURE;
+        }
+        uv_mutex_lock(&lock);
+        uv_cond_timedwait(&cond, &lock, 1000000ull);
+        if ((uv_hrtime() - start) > 60 * 1000000000ull) {
+            break;
+        }
+    }
+    if (Converged == numSubs) {
+        convergeNs = ConvergedTime - start;
+    }
+    uv_mutex_unlock(&lock);
+    if (!convergeNs) {
+        DPS_ERRPRINT("Subscriptions did not converge\n");
+        return EXIT_FAILURE;
+    }
+    /*
+     * Let any probes in flight drain before measuring
+     */
+    SLEEP(100);
+    GetStats(converged);
+    /*
+     * Publish with at most window publications outstanding. A
+     * publication that is not delivered within 100ms is written off so a
+     * lost publication does not stall the publisher.
+     */
+    start = uv_hrtime();
+    for (i = 0; i < numPubs; ++i) {
+        uv_mutex_lock(&lock);
+        while (((uint64_t)i - writtenOff) * numSubs >= NumLatencies + (uint64_t)window * numSubs) {
+            r = uv_cond_timedwait(&cond, &lock, 100 * 1000000ull);
+            if (r == UV_ETIMEDOUT) {
+                writtenOff = i - (NumLatencies / numSubs) - window + 1;
+                break;
+            }
+        }
+        uv_mutex_unlock(&lock);
+        ret = Publish(pub, buf, payloadLen, PHASE_MEASURE);
+        if (ret != DPS_OK) {
+            DPS_ERRPRINT("Failed to publish: %s\n", DPS_ErrTxt(ret));
+            return EXIT_FAILURE;
+        }
+    }
+    /*
+     * Wait for the remaining deliveries or until they stop arriving
+     */
+    uv_mutex_lock(&lock);
+    while (NumLatencies < expected) {
+        if (uv_cond_timedwait(&cond, &lock, 1000 * 1000000ull) == UV_ETIMEDOUT) {
+            break;
+        }
+    }
+    if (NumLatencies) {
+        measureNs = LastDelivery - start;
+    }
+    uv_mutex_unlock(&lock);
+    SLEEP(100);
+    numStats = GetStats(after);
+
+    qsort(Latencies, NumLatencies, sizeof(uint64_t), CompareLatencies);
+    printf("{\"suite\":\"mesh\",\"mesh\":\"%s\",\"nodes\":%d,\"links\":%d,\"subscribers\":%d,\"pubs\":%d,"
+           "\"payload\":%d,\"window\":%d,\"seed\":%d,",
+           meshName, numIds, numLinks, numSubs, numPubs, payloadLen, window, seedArg);
+    printf("\"link_ms\":%.1f,\"convergence_ms\":%.1f,\"pubs_per_sec\":%.1f,\"delivered\":%llu,\"expected\":%llu,",
+           (double)linkNs / 1e6, (double)convergeNs / 1e6, measureNs ? numPubs / ((double)measureNs / 1e9) : 0.0,
+           (unsigned long long)NumLatencies, (unsigned long long)expected);
+    printf("\"latency_p50_us\":%.1f,\"latency_p99_us\":%.1f,\"latency_max_us\":%.1f,\"transports\":[",
+           Percentile(50), Percentile(99), Percentile(100));
+    for (i = 0; i < (int)numStats; ++i) {
+        uint64_t pubBytes = after[i].bytesSent - converged[i].bytesSent;
+        printf("%s{\"name\":\"%s\",\"convergence_msgs\":%llu,\"convergence_bytes\":%llu,\"msgs\":%llu,"
+               "\"bytes\":%llu,\"bytes_per_pub\":%.1f}", i ? "," : "", after[i].transport,
+               (unsigned long long)(converged[i].msgsSent - before[i].msgsSent),
+               (unsigned long long)(converged[i].bytesSent - before[i].bytesSent),
+               (unsigned long long)(after[i].msgsSent - converged[i].msgsSent),
+               (unsigned long long)pubBytes, (double)pubBytes / numPubs);
+    }
+    printf("]}\n");
+    fflush(stdout);
+    /*
+     * Cleanup
+     */
+    for (i = 0; i < numSubs; ++i) {
+        DPS_DestroySubscription(subs[i]);
+    }
+    DPS_DestroyPublication(pub);
+    numNodes = 0;
+    for (i = 0; i < (int)A_SIZEOF(NodeMap); ++i) {
+        if (NodeMap[i]) {
+            DPS_DestroyNode(NodeMap[i], OnNodeDestroyed, NULL);
+            NodeMap[i] = NULL;
+            ++numNodes;
+        }
+    }
+    uv_mutex_lock(&lock);
+    while (NodesDestroyed < numNodes) {
+        uv_cond_wait(&cond, &lock);
+    }
+    uv_mutex_unlock(&lock);
+    FreeMeshLinks(links);
+    free(buf);
+    free(gotProbe);
+    free(subs);
+    free(Latencies);
+    return EXIT_SUCCESS;
+
+Usage:
+    DPS_PRINT("Usage %s: [-d] [-n <pubs>] [-s <subscribers>] [-l <payload-len>] [-w <window>] [-r <subs-rate-msecs>]\n"
+              "    [-S <seed>] [-f] <mesh-file>\n", argv[0]);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,665 @@
+/*
+ *******************************************************************
+ *
+ * Copyright 2018 Intel Corporation All rights reserved.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ */
+
+/*
+ * Micro-benchmarks for the bit vector, topic, CBOR, COSE, and history
+ * code. Each benchmark is calibrated to run for a minimum time and then
+ * repeated, the median and minimum time per operation are printed as
+ * one JSON object per line so results can be compared run to run.
+ */
+
+#include <uv.h>
+#include <dps/private/network.h>
+#include "bitvec.h"
+#include "cose.h"
+#include "history.h"
+#include "sub.h"
+#include "topics.h"
+#include "topictrie.h"
+#include "../keys.h"
+#include "../test.h"
+
+#define MAX_REPS     32
+#define NUM_TOPICS   64
+#define NUM_UUIDS    1024
+#define PAYLOAD_LEN  256
+#define NUM_SUBS     256
+
+static volatile int Sink;
+
+static DPS_BitVector* bvA;
+static DPS_BitVector* bvB;
+static DPS_BitVector* bvOut;
+static DPS_BitVector* fh;
+static uint8_t* serialized;
+static size_t serializedLen;
+static size_t serializedMax;
+
+static char pubTopics[NUM_TOPICS][64];
+static const char* subTopics[] = {
+    "building/floor2/room3/temperature",
+    "building/+/room7/#",
+    "building/floor9/room1/humidity",
+    "+/+/+/occupancy"
+};
+
+static DPS_Subscription* subs[NUM_SUBS];
+static DPS_TopicTrie trie;
+
+static uint8_t cborBuf[512];
+static size_t cborLen;
+
+static DPS_MemoryKeyStore* keyStore;
+static uint8_t* cipherText;
+static size_t cipherTextLen;
+
+static DPS_History history;
+static DPS_UUID uuids[NUM_UUIDS];
+static DPS_NodeAddress addr;
+
+static uint8_t payload[PAYLOAD_LEN];
+static const uint8_t aad[] = { 0xa1, 0x01, 0x02 };
+static const uint8_t nonce[COSE_NONCE_LEN] = { 0x01, 0x00, 0x00, 0x00, 0x38, 0x5e, 0x9a, 0xdd, 0xd5, 0x55, 0x88, 0xc4 };
+
+static void BenchBloomInsert(uint64_t n)
+{
+    uint64_t i;
+
+    for (i = 0; i < n; ++i) {
+        DPS_BitVectorBloomInsert(bvOut, (const uint8_t*)pubTopics[i % NUM_TOPICS], 16);
+    }
+}
+
+static void BenchBloomTest(uint64_t n)
+{
+    uint64_t i;
+    int r = 0;
+
+    for (i = 0; i < n; ++i) {
+        r += DPS_BitVectorBloomTest(bvA, (const uint8_t*)pubTopics[i % NUM_TOPICS], 16);
+    }
+    Sink = r;
+}
+
+static void BenchUnion(uint64_t n)
+{
+    uint64_t i;
+
+    for (i = 0; i < n; ++i) {
+        DPS_BitVectorUnion(bvOut, bvA);
+    }
+}
+
+static void BenchIncludes(uint64_t n)
+{
+    uint64_t i;
+    int r = 0;
+
+    for (i = 0; i < n; ++i) {
+        r += DPS_BitVectorIncludes(bvA, bvB);
+    }
+    Sink = r;
+}
+
+static void BenchFuzzyHash(uint64_t n)
+{
+    uint64_t i;
+
+    for (i = 0; i < n; ++i) {
+        DPS_BitVectorFuzzyHash(fh, bvA);
+    }
+}
+
+static void BenchSerialize(uint64_t n)
+{
+    DPS_TxBuffer buf;
+    uint64_t i;
+
+    for (i = 0; i < n; ++i) {
+        DPS_TxBufferInit(&buf, serialized, serializedMax);
+        DPS_BitVectorSerialize(bvA, &buf);
+    }
+}
+
+static void BenchDeserialize(uint64_t n)
+{
+    DPS_RxBuffer buf;
+    uint64_t i;
+
+    for (i = 0; i < n; ++i) {
+        DPS_RxBufferInit(&buf, serialized, serializedLen);
+        DPS_BitVectorDeserialize(bvOut, &buf);
+    }
+}
+
+static void BenchAddTopic(uint64_t n)
+{
+    uint64_t i;
+
+    for (i = 0; i < n; ++i) {
+        DPS_BitVectorClear(bvOut);
+        DPS_AddTopic(bvOut, pubTopics[i % NUM_TOPICS], "/", DPS_PubTopic);
+    }
+}
+
+static void BenchMatchTopic(uint64_t n)
+{
+    uint64_t i;
+    int r = 0;
+
+    for (i = 0; i < n; ++i) {
+        r += DPS_MatchTopic(bvA, subTopics[i % A_SIZEOF(subTopics)], "/");
+    }
+    Sink = r;
+}
+
+static void BenchMatchTopicString(uint64_t n)
+{
+    uint64_t i;
+    int match;
+    int r = 0;
+
+    for (i = 0; i < n; ++i) {
+        DPS_MatchTopicString(pubTopics[i % NUM_TOPICS], subTopics[i % A_SIZEOF(subTopics)], "/", DPS_FALSE,
+                             &match);
+        r += match;
+    }
+    Sink = r;
+}
+
+/*
+ * Matches one publication against all of the subscriptions
+ */
+static void BenchMatchTopicList(uint64_t n)
+{
+    uint64_t i;
+    size_t j;
+    int match;
+    int r = 0;
+
+    for (i = 0; i < n; ++i) {
+        char* topic = pubTopics[i % NUM_TOPICS];
+        for (j = 0; j < NUM_SUBS; ++j) {
+            DPS_MatchTopicList(&topic, 1, subs[j]->topics, subs[j]->numTopics, "/", DPS_FALSE, &match);
+            r += match;
+        }
+    }
+    Sink = r;
+}
+
+static void BenchTrieMatch(uint64_t n)
+{
+    uint64_t i;
+    size_t j;
+    int r = 0;
+
+    for (i = 0; i < n; ++i) {
+        char* topic = pubTopics[i % NUM_TOPICS];
+        DPS_TopicTrieMatch(&trie, &topic, 1, "/");
+        for (j = 0; j < NUM_SUBS; ++j) {
+            r += DPS_TopicTrieMatched(&trie, subs[j]);
+        }
+    }
+    Sink = r;
+}
+
+/*
+ * Roughly the shape of a publication header
+ */
+static DPS_Status EncodeHeader(DPS_TxBuffer* buf, uint32_t sn)
+{
+    DPS_Status ret;
+
+    ret = CBOR_EncodeMap(buf, 5);
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint(buf, 1);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUUID(buf, &uuids[0]);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint(buf, 2);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint(buf, sn);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint(buf, 3);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeString(buf, pubTopics[sn % NUM_TOPICS]);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint(buf, 4);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeBytes(buf, payload, 64);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeUint(buf, 5);
+    }
+    if (ret == DPS_OK) {
+        ret = CBOR_EncodeBoolean(buf, DPS_TRUE);
+    }
+    return ret;
+}
+
+static DPS_Status DecodeHeader(DPS_RxBuffer* buf)
+{
+    DPS_Status ret;
+    DPS_UUID uuid;
+    size_t size;
+    uint64_t key;
+    uint32_t sn;
+    char* str;
+    uint8_t* bytes;
+    int b;
+    size_t i;
+
+    ret = CBOR_DecodeMap(buf, &size);
+    for (i = 0; (ret == DPS_OK) && (i < size); ++i) {
+        ret = CBOR_DecodeUint(buf, &key);
+        if (ret != DPS_OK) {
+            break;
+        }
+        switch (key) {
+        case 1:
+            ret = CBOR_DecodeUUID(buf, &uuid);
+            break;
+        case 2:
+            ret = CBOR_DecodeUint32(buf, &sn);
+            break;
+        case 3:
+            ret = CBOR_DecodeString(buf, &str, &size);
+            break;
+        case 4:
+            ret = CBOR_DecodeBytes(buf, &bytes, &size);
+            break;
+        case 5:
+            ret = CBOR_DecodeBoolean(buf, &b);
+            break;
+        default:
+            ret = CBOR_Skip(buf, NULL, NULL);
+            break;
+        }
+    }
+    return ret;
+}
+
+static void BenchCBOREncode(uint64_t n)
+{
+    DPS_TxBuffer buf;
+    uint64_t i;
+
+    for (i = 0; i < n; ++i) {
+        DPS_TxBufferInit(&buf, cborBuf, sizeof(cborBuf));
+        EncodeHeader(&buf, (uint32_t)i);
+    }
+}
+
+static void BenchCBORDecode(uint64_t n)
+{
+    DPS_RxBuffer buf;
+    uint64_t i;
+
+    for (i = 0; i < n; ++i) {
+        DPS_RxBufferInit(&buf, cborBuf, cborLen);
+        DecodeHeader(&buf);
+    }
+}
+
+static DPS_Status Encrypt(DPS_TxBuffer* buf)
+{
+    DPS_Status ret;
+    COSE_Entity recipient;
+    DPS_RxBuffer aadBuf;
+    DPS_TxBuffer parts[3];
+    size_t i;
+
+    recipient.alg = COSE_ALG_A256KW;
+    recipient.kid = PskId[0];
+    DPS_RxBufferInit(&aadBuf, (uint8_t*)aad, sizeof(aad));
+    DPS_TxBufferInit(&parts[1], payload, sizeof(payload));
+    parts[1].txPos = parts[1].eob;
+    ret = COSE_Encrypt(COSE_ALG_A256GCM, nonce, NULL, &recipient, 1, &aadBuf, &parts[0], &parts[1], 1, &parts[2],
+                       DPS_MemoryKeyStoreHandle(keyStore));
+    if (ret == DPS_OK && buf) {
+        ret = DPS_TxBufferInit(buf, NULL, DPS_TxBufferUsed(&parts[0]) + DPS_TxBufferUsed(&parts[1]) +
+                               DPS_TxBufferUsed(&parts[2]));
+        for (i = 0; (ret == DPS_OK) && (i < 3); ++i) {
+            ret = DPS_TxBufferAppend(buf, parts[i].base, DPS_TxBufferUsed(&parts[i]));
+        }
+    }
+    if (ret == DPS_OK) {
+        DPS_TxBufferFree(&parts[0]);
+        DPS_TxBufferFree(&parts[2]);
+    }
+    return ret;
+}
+
+static void BenchCOSEEncrypt(uint64_t n)
+{
+    uint64_t i;
+
+    for (i = 0; i < n; ++i) {
+        Encrypt(NULL);
+    }
+}
+
+static void BenchCOSEDecrypt(uint64_t n)
+{
+    DPS_Status ret;
+    COSE_Entity recipient;
+    DPS_RxBuffer aadBuf;
+    DPS_RxBuffer input;
+    DPS_TxBuffer plainText;
+    uint64_t i;
+
+    for (i = 0; i < n; ++i) {
+        DPS_RxBufferInit(&aadBuf, (uint8_t*)aad, sizeof(aad));
+        DPS_RxBufferInit(&input, cipherText, cipherTextLen);
+        DPS_TxBufferClear(&plainText);
+        ret = COSE_Decrypt(nonce, &recipient, &aadBuf, &input, DPS_MemoryKeyStoreHandle(keyStore), NULL,
+                           &plainText);
+        if (ret == DPS_OK) {
+            DPS_TxBufferFree(&plainText);
+        }
+    }
+}
+
+static void BenchHistoryUpdate(uint64_t n)
+{
+    static uint32_t sn = 1;
+    uint64_t i;
+
+    for (i = 0; i < n; ++i) {
+        if ((i % NUM_UUIDS) == 0) {
+            ++sn;
+        }
+        DPS_UpdatePubHistory(&history, &uuids[i % NUM_UUIDS], sn, DPS_FALSE, 0, &addr);
+    }
+}
+
+static void BenchHistoryLookup(uint64_t n)
+{
+    DPS_NodeAddress* addrPtr;
+    uint64_t i;
+    uint32_t sn;
+    int r = 0;
+
+    for (i = 0; i < n; ++i) {
+        r += DPS_LookupPublisherForAck(&history, &uuids[i % NUM_UUIDS], &sn, &addrPtr) == DPS_OK;
+    }
+    Sink = r;
+}
+
+static void BenchHistoryIsStale(uint64_t n)
+{
+    uint64_t i;
+    int r = 0;
+
+    for (i = 0; i < n; ++i) {
+        r += DPS_PublicationIsStale(&history, &uuids[i % NUM_UUIDS], 1);
+    }
+    Sink = r;
+}
+
+typedef struct {
+    const char* name;
+    void (*run)(uint64_t n);
+} Benchmark;
+
+static const Benchmark Benchmarks[] = {
+    { "bitvec.bloom_insert",  BenchBloomInsert },
+    { "bitvec.bloom_test",    BenchBloomTest },
+    { "bitvec.union",         BenchUnion },
+    { "bitvec.includes",      BenchIncludes },
+    { "bitvec.fuzzy_hash",    BenchFuzzyHash },
+    { "bitvec.serialize",     BenchSerialize },
+    { "bitvec.deserialize",   BenchDeserialize },
+    { "topics.add",           BenchAddTopic },
+    { "topics.match",         BenchMatchTopic },
+    { "topics.match_string",  BenchMatchTopicString },
+    { "topics.match_list",    BenchMatchTopicList },
+    { "topics.trie_match",    BenchTrieMatch },
+    { "cbor.encode",          BenchCBOREncode },
+    { "cbor.decode",          BenchCBORDecode },
+    { "cose.encrypt",         BenchCOSEEncrypt },
+    { "cose.decrypt",         BenchCOSEDecrypt },
+    { "history.update",       BenchHistoryUpdate },
+    { "history.lookup",       BenchHistoryLookup },
+    { "history.is_stale",     BenchHistoryIsStale }
+};
+
+static DPS_Status Setup(void)
+{
+    DPS_Status ret;
+    DPS_TxBuffer buf;
+    uint32_t r = 1;
+    size_t i;
+
+    for (i = 0; i < NUM_TOPICS; ++i) {
+        snprintf(pubTopics[i], sizeof(pubTopics[i]), "building/floor%d/room%d/%s", (int)(i % 10), (int)(i % 8),
+                 (i & 1) ? "temperature" : "humidity");
+    }
+    for (i = 0; i < sizeof(payload); ++i) {
+        r = r * 1103515245 + 12345;
+        payload[i] = (uint8_t)(r >> 16);
+    }
+    /*
+     * Bit vectors loaded like a node with a few dozen subscriptions
+     */
+    bvA = DPS_BitVectorAlloc();
+    bvB = DPS_BitVectorAlloc();
+    bvOut = DPS_BitVectorAlloc();
+    fh = DPS_BitVectorAllocFH();
+    if (!bvA || !bvB || !bvOut || !fh) {
+        return DPS_ERR_RESOURCES;
+    }
+    for (i = 0; i < NUM_TOPICS; ++i) {
+        DPS_AddTopic(bvA, pubTopics[i], "/", DPS_PubTopic);
+        if (i < NUM_TOPICS / 4) {
+            DPS_AddTopic(bvB, pubTopics[i], "/", DPS_PubTopic);
+        }
+    }
+    /*
+     * Subscriptions to single topics, one in four has a wildcard
+     */
+    for (i = 0; i < NUM_SUBS; ++i) {
+        char topic[64];
+        switch (i % 4) {
+        case 0:
+            snprintf(topic, sizeof(topic), "building/+/room%d/#", (int)(i % 16));
+            break;
+        default:
+            snprintf(topic, sizeof(topic), "building/floor%d/room%d/%s", (int)(i % 20), (int)(i % 16),
+                     (i & 1) ? "temperature" : "humidity");
+            break;
+        }
+        subs[i] = calloc(1, sizeof(DPS_Subscription));
+        if (!subs[i]) {
+            return DPS_ERR_RESOURCES;
+        }
+        subs[i]->topics[0] = strdup(topic);
+        if (!subs[i]->topics[0]) {
+            return DPS_ERR_RESOURCES;
+        }
+        subs[i]->numTopics = 1;
+        ret = DPS_TopicTrieAdd(&trie, subs[i], "/");
+        if (ret != DPS_OK) {
+            return ret;
+        }
+    }
+    serializedMax = DPS_BitVectorSerializeMaxSize(bvA);
+    serialized = malloc(serializedMax);
+    if (!serialized) {
+        return DPS_ERR_RESOURCES;
+    }
+    DPS_TxBufferInit(&buf, serialized, serializedMax);
+    ret = DPS_BitVectorSerialize(bvA, &buf);
+    if (ret != DPS_OK) {
+        return ret;
+    }
+    serializedLen = DPS_TxBufferUsed(&buf);
+
+    for (i = 0; i < NUM_UUIDS; ++i) {
+        DPS_GenerateUUID(&uuids[i]);
+    }
+    DPS_TxBufferInit(&buf, cborBuf, sizeof(cborBuf));
+    ret = EncodeHeader(&buf, 1);
+    if (ret != DPS_OK) {
+        return ret;
+    }
+    cborLen = DPS_TxBufferUsed(&buf);
+
+    keyStore = DPS_CreateMemoryKeyStore();
+    if (!keyStore) {
+        return DPS_ERR_RESOURCES;
+    }
+    ret = DPS_SetContentKey(keyStore, &PskId[0], &Psk[0]);
+    if (ret != DPS_OK) {
+        return ret;
+    }
+    ret = Encrypt(&buf);
+    if (ret != DPS_OK) {
+        return ret;
+    }
+    cipherText = buf.base;
+    cipherTextLen = DPS_TxBufferUsed(&buf);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.type = DPS_NetDefaultType();
+    history.loop = uv_default_loop();
+    uv_mutex_init(&history.lock);
+    for (i = 0; i < NUM_UUIDS; ++i) {
+        ret = DPS_UpdatePubHistory(&history, &uuids[i], 1, DPS_TRUE, 0, &addr);
+        if (ret != DPS_OK) {
+            return ret;
+        }
+    }
+    return DPS_OK;
+}
+
+static void Cleanup(void)
+{
+    size_t i;
+
+    DPS_TopicTrieFree(&trie);
+    for (i = 0; i < NUM_SUBS; ++i) {
+        if (subs[i]) {
+            free(subs[i]->topics[0]);
+            free(subs[i]);
+        }
+    }
+    DPS_HistoryFree(&history);
+    free(cipherText);
+    DPS_DestroyMemoryKeyStore(keyStore);
+    free(serialized);
+    DPS_BitVectorFree(fh);
+    DPS_BitVectorFree(bvOut);
+    DPS_BitVectorFree(bvB);
+    DPS_BitVectorFree(bvA);
+}
+
+static uint64_t TimeRun(const Benchmark* b, uint64_t n)
+{
+    uint64_t start = uv_hrtime();
+    b->run(n);
+    return uv_hrtime() - start;
+}
+
+static int CompareDoubles(const void* a, const void* b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void Run(const Benchmark* b, uint64_t minNs, int reps)
+{
+    double nsPerOp[MAX_REPS];
+    uint64_t n = 1;
+    int i;
+
+    /*
+     * Double the iteration count until a run takes at least the minimum time
+     */
+    while (TimeRun(b, n) < minNs) {
+        n *= 2;
+    }
+    for (i = 0; i < reps; ++i) {
+        nsPerOp[i] = (double)TimeRun(b, n) / n;
+    }
+    qsort(nsPerOp, reps, sizeof(double), CompareDoubles);
+    printf("{\"suite\":\"micro\",\"name\":\"%s\",\"iterations\":%llu,\"reps\":%d,"
+           "\"ns_per_op\":%.2f,\"min_ns_per_op\":%.2f}\n",
+           b->name, (unsigned long long)n, reps, nsPerOp[reps / 2], nsPerOp[0]);
+    fflush(stdout);
+}
+
+int main(int argc, char** argv)
+{
+    DPS_Status ret;
+    char** arg = argv + 1;
+    const char* filter = NULL;
+    int msecs = 100;
+    int reps = 5;
+    size_t i;
+
+    DPS_Debug = DPS_FALSE;
+    while (--argc) {
+        if (IntArg("-t", &arg, &argc, &msecs, 1, 10000)) {
+            continue;
+        }
+        if (IntArg("-r", &arg, &argc, &reps, 1, MAX_REPS)) {
+            continue;
+        }
+        if (strcmp(*arg, "-b") == 0) {
+            ++arg;
+            if (!--argc) {
+                goto Usage;
+            }
+            filter = *arg++;
+            continue;
+        }
+        goto Usage;
+    }
+    ret = DPS_InitUUID();
+    if (ret == DPS_OK) {
+        ret = Setup();
+    }
+    if (ret != DPS_OK) {
+        DPS_ERRPRINT("Setup failed: %s\n", DPS_ErrTxt(ret));
+        return EXIT_FAILURE;
+    }
+    for (i = 0; i < A_SIZEOF(Benchmarks); ++i) {
+        if (!filter || !strncmp(Benchmarks[i].name, filter, strlen(filter))) {
+            Run(&Benchmarks[i], (uint64_t)msecs * 1000000, reps);
+        }
+    }
+    Cleanup();
+    return EXIT_SUCCESS;
+
+Usage:
+    DPS_PRINT("Usage %s: [-t <msecs-per-run>] [-r <runs>] [-b <benchmark-prefix>]\n", argv[0]);
+    return EXIT_FAILURE;
+}
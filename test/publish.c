@@ -20,6 +20,7 @@
 *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 */
 
+#include <uv.h>
 #include "test.h"
 #include "keys.h"
 
@@ -99,9 +100,8 @@ static void TestLoopbackLargeMessage(DPS_Node* node, DPS_KeyStore* keyStore)
     ret = DPS_Publish(pub, largeMessage, A_SIZEOF(largeMessage), 0);
     ASSERT(ret == DPS_OK);
     /*
-     * We expect the large message to be dropped by the network layer
-     * as it exceeds the maximum UDP datagram size.  But it should be
-     * looped back to the local subscriber.
+     * The large message may be dropped or fragmented by the network
+     * layer, but it should be looped back to the local subscriber.
      */
     ret = DPS_WaitForEvent(event);
     ASSERT(ret == DPS_OK);
@@ -240,6 +240,105 @@ static void TestDelayedAck(DPS_Node* node, DPS_KeyStore* keyStore)
     DPS_DestroyEvent(ackEvent);
 }
 
+static size_t numAggregatedAcks;
+
+#ifdef DPS_DEBUG
+extern int _DPS_NumAckMsgs;
+extern int _DPS_NumAggregatedAckMsgs;
+#endif
+
+static void AggregatedAckHandler(DPS_Publication* pub, uint8_t* payload, size_t len)
+{
+    DPS_Event* event = (DPS_Event*)DPS_GetPublicationData(pub);
+    uint32_t ackSequenceNum = DPS_AckGetSequenceNum(pub);
+
+    ASSERT(len == sizeof(ackSequenceNum));
+    ASSERT(memcmp(payload, &ackSequenceNum, len) == 0);
+    if (++numAggregatedAcks == HISTORY_CAP) {
+        DPS_SignalEvent(event, DPS_OK);
+    }
+}
+
+static void TestAggregatedAcks(DPS_Node* node, DPS_KeyStore* keyStore)
+{
+    static const char* topics[] = { __FUNCTION__ };
+    static const size_t numTopics = 1;
+    DPS_Event* event = NULL;
+    DPS_Publication* pub = NULL;
+    DPS_Event* ackEvent = NULL;
+    DPS_Subscription* sub = NULL;
+    uint32_t sequenceNum;
+#ifdef DPS_DEBUG
+    int numAckMsgs;
+    int numAggregatedAckMsgs;
+#endif
+    DPS_Status ret;
+    size_t i;
+
+    DPS_PRINT("%s\n", __FUNCTION__);
+
+    memset(pubs, 0, sizeof(pubs));
+    numAggregatedAcks = 0;
+    DPS_SetNodeAckAggregation(node, 100);
+
+    /*
+     * Encrypt the publication so the aggregated ack is encrypted too
+     */
+    pub = DPS_CreatePublication(node);
+    ASSERT(pub);
+    ret = DPS_InitPublication(pub, topics, numTopics, DPS_FALSE, &PskId[0], AggregatedAckHandler);
+    ASSERT(ret == DPS_OK);
+    ackEvent = DPS_CreateEvent();
+    ASSERT(ackEvent);
+    ret = DPS_SetPublicationData(pub, ackEvent);
+    ASSERT(ret == DPS_OK);
+
+    sub = DPS_CreateSubscription(node, topics, numTopics);
+    ASSERT(sub);
+    event = DPS_CreateEvent();
+    ASSERT(event);
+    ret = DPS_SetSubscriptionData(sub, event);
+    ASSERT(ret == DPS_OK);
+    ret = DPS_Subscribe(sub, HistoryHandler);
+    ASSERT(ret == DPS_OK);
+
+    for (i = 0; i < HISTORY_CAP; ++i) {
+        ret = DPS_Publish(pub, NULL, 0, 0);
+        ASSERT(ret == DPS_OK);
+        ret = DPS_WaitForEvent(event);
+        ASSERT(ret == DPS_OK);
+    }
+
+    /*
+     * The acks are sent in one message when the aggregation delay
+     * expires and each is delivered to the ack handler
+     */
+#ifdef DPS_DEBUG
+    numAckMsgs = _DPS_NumAckMsgs;
+    numAggregatedAckMsgs = _DPS_NumAggregatedAckMsgs;
+#endif
+    for (i = 1; i <= HISTORY_CAP; ++i) {
+        sequenceNum = DPS_PublicationGetSequenceNum(pubs[i]);
+        ret = DPS_AckPublication(pubs[i], (const uint8_t*)&sequenceNum, sizeof(sequenceNum));
+        ASSERT(ret == DPS_OK);
+        DPS_DestroyPublication(pubs[i]);
+    }
+    ret = DPS_TimedWaitForEvent(ackEvent, 5000);
+    ASSERT(ret == DPS_OK);
+#ifdef DPS_DEBUG
+    numAckMsgs = _DPS_NumAckMsgs - numAckMsgs;
+    numAggregatedAckMsgs = _DPS_NumAggregatedAckMsgs - numAggregatedAckMsgs;
+    DPS_PRINT("%d acks received in %d messages, %d aggregated\n", HISTORY_CAP, numAckMsgs, numAggregatedAckMsgs);
+    ASSERT(numAggregatedAckMsgs > 0);
+    ASSERT(numAckMsgs < HISTORY_CAP);
+#endif
+
+    DPS_DestroySubscription(sub);
+    DPS_DestroyEvent(event);
+    DPS_DestroyPublication(pub);
+    DPS_DestroyEvent(ackEvent);
+}
+
 static void BackToBackPublishHandler(DPS_Subscription* sub, const DPS_Publication* pub, uint8_t* payload, size_t len)
 {
     uint32_t* expectedSequenceNum = (uint32_t*)DPS_GetSubscriptionData(sub);
@@ -249,102 +348,821 @@ static void BackToBackPublishHandler(DPS_Subscription* sub, const DPS_Publicatio
     ++(*expectedSequenceNum);
 }
 
-static void TestBackToBackPublish(DPS_Node* node, DPS_KeyStore* keyStore)
+static void TestBackToBackPublish(DPS_Node* node, DPS_KeyStore* keyStore)
+{
+    static const char* topics[] = { __FUNCTION__ };
+    static const size_t numTopics = 1;
+    DPS_Publication* pub = NULL;
+    size_t depth = 10000;
+    DPS_Subscription* sub = NULL;
+    uint32_t seqNum;
+    DPS_Status ret;
+    size_t i;
+
+    DPS_PRINT("%s\n", __FUNCTION__);
+
+    pub = CreatePublication(node, topics, numTopics, NULL);
+
+    sub = DPS_CreateSubscription(node, topics, numTopics);
+    ASSERT(sub);
+    ret = DPS_SetSubscriptionData(sub, &seqNum);
+    ASSERT(ret == DPS_OK);
+    ret = DPS_Subscribe(sub, BackToBackPublishHandler);
+    ASSERT(ret == DPS_OK);
+
+    seqNum = DPS_PublicationGetSequenceNum(pub) + 1;
+    for (i = 0; i < depth; ++i) {
+        ret = DPS_Publish(pub, NULL, 0, 0);
+        ASSERT(ret == DPS_OK);
+    }
+
+    /*
+     * Give some time to receive the publications since we don't
+     * explicitly wait for the acks in this test.
+     */
+    SLEEP(1000);
+
+    DPS_DestroySubscription(sub);
+    DPS_DestroyPublication(pub);
+}
+
+#if defined(DPS_USE_TCP)
+static void OnLinkComplete(DPS_Node* node, DPS_NodeAddress* addr, DPS_Status status, void* data)
+{
+    if (data) {
+        DPS_SignalEvent((DPS_Event*)data, status);
+    }
+}
+static void TestBackToBackPublishSeparateNodes(DPS_Node* node, DPS_KeyStore* keyStore)
+{
+    static const char* topics[] = { __FUNCTION__ };
+    static const size_t numTopics = 1;
+    DPS_Publication* pub = NULL;
+    size_t depth = 10000;
+    DPS_Event* event = NULL;
+    DPS_Node* subNode = NULL;
+    DPS_Subscription* sub = NULL;
+    DPS_NodeAddress* addr = NULL;
+    uint32_t seqNum;
+    DPS_Status ret;
+    size_t i;
+
+    DPS_PRINT("%s\n", __FUNCTION__);
+
+    pub = CreatePublication(node, topics, numTopics, NULL);
+
+    event = DPS_CreateEvent();
+    ASSERT(event);
+
+    subNode = DPS_CreateNode("/.", keyStore, NULL);
+    ASSERT(subNode);
+    ret = DPS_StartNode(subNode, DPS_MCAST_PUB_DISABLED, NULL);
+    ASSERT(ret == DPS_OK);
+
+    sub = DPS_CreateSubscription(subNode, topics, numTopics);
+    ASSERT(sub);
+    ret = DPS_SetSubscriptionData(sub, &seqNum);
+    ASSERT(ret == DPS_OK);
+    ret = DPS_Subscribe(sub, BackToBackPublishHandler);
+    ASSERT(ret == DPS_OK);
+
+    addr = DPS_CreateAddress();
+    ASSERT(addr);
+    ret = DPS_LinkTo(subNode, DPS_GetListenAddressString(node), addr);
+    ASSERT(ret == DPS_OK);
+
+    seqNum = DPS_PublicationGetSequenceNum(pub) + 1;
+    for (i = 0; i < depth; ++i) {
+        ret = DPS_Publish(pub, NULL, 0, 0);
+        ASSERT(ret == DPS_OK);
+    }
+
+    /*
+     * Give some time to receive the publications since we don't
+     * explicitly wait for the acks in this test.
+     */
+    SLEEP(1000);
+
+    DPS_DestroyAddress(addr);
+    DPS_DestroySubscription(sub);
+    DPS_DestroyNode(subNode, OnNodeDestroyed, event);
+    DPS_WaitForEvent(event);
+    DPS_DestroyEvent(event);
+    DPS_DestroyPublication(pub);
+}
+
+#ifdef DPS_DEBUG
+extern int _DPS_NumTcpConnects;
+extern int _DPS_NumTcpPoolReuses;
+#endif
+
+typedef struct _AckSeparateNodesReceiver {
+    DPS_Event* event;
+    int ack;
+} AckSeparateNodesReceiver;
+
+static void AckSeparateNodesHandler(DPS_Subscription* sub, const DPS_Publication* pub, uint8_t* payload, size_t len)
+{
+    AckSeparateNodesReceiver* receiver = (AckSeparateNodesReceiver*)DPS_GetSubscriptionData(sub);
+    DPS_Status ret;
+
+    if (receiver->ack && DPS_PublicationIsAckRequested(pub)) {
+        ret = DPS_AckPublication(pub, NULL, 0);
+        ASSERT(ret == DPS_OK);
+    }
+    DPS_SignalEvent(receiver->event, DPS_OK);
+}
+
+static void TestAckSeparateNodes(DPS_Node* node, DPS_KeyStore* keyStore)
+{
+    static const char* topics[] = { __FUNCTION__ };
+    static const size_t numTopics = 1;
+    static AckSeparateNodesReceiver receiver;
+    DPS_Publication* pub = NULL;
+    DPS_Event* event = NULL;
+    DPS_Node* subNode = NULL;
+    DPS_Subscription* sub = NULL;
+#ifdef DPS_DEBUG
+    int numConnects;
+    int numReuses;
+#endif
+    DPS_Status ret;
+    size_t i;
+
+    DPS_PRINT("%s\n", __FUNCTION__);
+
+    memset(&receiver, 0, sizeof(receiver));
+    pub = CreatePublication(node, topics, numTopics, LoopbackAckHandler);
+
+    event = DPS_CreateEvent();
+    ASSERT(event);
+    ret = DPS_SetPublicationData(pub, event);
+    ASSERT(ret == DPS_OK);
+    receiver.event = DPS_CreateEvent();
+    ASSERT(receiver.event);
+
+    /*
+     * The subscriber node is not linked to the publisher node, the
+     * publications are received over multicast so there is no
+     * connection to the node the acks are routed to
+     */
+    subNode = DPS_CreateNode("/.", keyStore, NULL);
+    ASSERT(subNode);
+    ret = DPS_PrewarmConnections(subNode);
+    ASSERT(ret == DPS_ERR_NOT_STARTED);
+    ret = DPS_StartNode(subNode, DPS_MCAST_PUB_ENABLE_RECV, NULL);
+    ASSERT(ret == DPS_OK);
+
+    sub = DPS_CreateSubscription(subNode, topics, numTopics);
+    ASSERT(sub);
+    ret = DPS_SetSubscriptionData(sub, &receiver);
+    ASSERT(ret == DPS_OK);
+    ret = DPS_Subscribe(sub, AckSeparateNodesHandler);
+    ASSERT(ret == DPS_OK);
+
+    ret = DPS_Publish(pub, NULL, 0, 0);
+    ASSERT(ret == DPS_OK);
+    ret = DPS_TimedWaitForEvent(receiver.event, 5000);
+    ASSERT(ret == DPS_OK);
+    /*
+     * Pre-warming opens a connection to the ack route of the
+     * publication that was received
+     */
+#ifdef DPS_DEBUG
+    numConnects = _DPS_NumTcpConnects;
+#endif
+    ret = DPS_PrewarmConnections(subNode);
+    ASSERT(ret == DPS_OK);
+#ifdef DPS_DEBUG
+    for (i = 0; (_DPS_NumTcpConnects == numConnects) && (i < 500); ++i) {
+        SLEEP(10);
+    }
+    ASSERT(_DPS_NumTcpConnects == (numConnects + 1));
+    numConnects = _DPS_NumTcpConnects;
+    numReuses = _DPS_NumTcpPoolReuses;
+#else
+    SLEEP(100);
+#endif
+    /*
+     * The acks must be sent over the pre-warmed connection without
+     * opening any new ones
+     */
+    receiver.ack = DPS_TRUE;
+    for (i = 0; i < 100; ++i) {
+        ret = DPS_Publish(pub, NULL, 0, 0);
+        ASSERT(ret == DPS_OK);
+        ret = DPS_TimedWaitForEvent(event, 5000);
+        ASSERT(ret == DPS_OK);
+    }
+#ifdef DPS_DEBUG
+    DPS_PRINT("%d connections opened, %d pooled connections reused\n", _DPS_NumTcpConnects - numConnects,
+              _DPS_NumTcpPoolReuses - numReuses);
+    ASSERT(_DPS_NumTcpConnects == numConnects);
+    ASSERT(_DPS_NumTcpPoolReuses > numReuses);
+#endif
+
+    DPS_DestroySubscription(sub);
+    DPS_DestroyNode(subNode, OnNodeDestroyed, event);
+    DPS_WaitForEvent(event);
+    DPS_DestroyEvent(receiver.event);
+    DPS_DestroyEvent(event);
+    DPS_DestroyPublication(pub);
+}
+#endif
+
+#if defined(DPS_USE_TCP) && defined(DPS_USE_UDP)
+static void ForwardHandler(DPS_Subscription* sub, const DPS_Publication* pub, uint8_t* payload, size_t len)
+{
+    DPS_SignalEvent((DPS_Event*)DPS_GetSubscriptionData(sub), DPS_OK);
+}
+
+static DPS_Node* CreateLinkedNode(DPS_Node* node, DPS_KeyStore* keyStore, const char* transport,
+                                  DPS_NodeAddress* addr)
+{
+    char addrText[128];
+    DPS_Node* linkedNode;
+    DPS_Status ret;
+
+    linkedNode = DPS_CreateNode("/.", keyStore, NULL);
+    ASSERT(linkedNode);
+    ret = DPS_StartNode(linkedNode, DPS_MCAST_PUB_DISABLED, NULL);
+    ASSERT(ret == DPS_OK);
+    /*
+     * Copy the address text since the string returned is overwritten
+     * by the next call
+     */
+    strncpy(addrText, DPS_NodeAddrToString(DPS_GetTransportListenAddress(node, transport)), sizeof(addrText) - 1);
+    addrText[sizeof(addrText) - 1] = 0;
+    ret = DPS_LinkTo(linkedNode, addrText, addr);
+    ASSERT(ret == DPS_OK);
+    return linkedNode;
+}
+
+static void TestForwardBetweenTransports(DPS_Node* node, DPS_KeyStore* keyStore)
+{
+    static const char* topics[] = { __FUNCTION__ };
+    static const size_t numTopics = 1;
+    DPS_Publication* pub = NULL;
+    DPS_Event* event = NULL;
+    DPS_Node* pubNode = NULL;
+    DPS_Node* subNode = NULL;
+    DPS_Subscription* sub = NULL;
+    DPS_NodeAddress* pubAddr = NULL;
+    DPS_NodeAddress* subAddr = NULL;
+    DPS_Status ret;
+
+    DPS_PRINT("%s\n", __FUNCTION__);
+
+    event = DPS_CreateEvent();
+    ASSERT(event);
+    pubAddr = DPS_CreateAddress();
+    ASSERT(pubAddr);
+    subAddr = DPS_CreateAddress();
+    ASSERT(subAddr);
+    /*
+     * The node under test listens on both transports and forwards
+     * between a publisher linked over TCP and a subscriber linked
+     * over UDP
+     */
+    ASSERT(DPS_GetTransportListenAddress(node, "tcp"));
+    ASSERT(DPS_GetTransportListenAddress(node, "udp"));
+    pubNode = CreateLinkedNode(node, keyStore, "tcp", pubAddr);
+    subNode = CreateLinkedNode(node, keyStore, "udp", subAddr);
+
+    sub = DPS_CreateSubscription(subNode, topics, numTopics);
+    ASSERT(sub);
+    ret = DPS_SetSubscriptionData(sub, event);
+    ASSERT(ret == DPS_OK);
+    ret = DPS_Subscribe(sub, ForwardHandler);
+    ASSERT(ret == DPS_OK);
+
+    pub = CreatePublication(pubNode, topics, numTopics, NULL);
+    /*
+     * Retain the publication so it is forwarded once the subscription
+     * has propagated to the publisher
+     */
+    ret = DPS_Publish(pub, NULL, 0, 10);
+    ASSERT(ret == DPS_OK);
+    ret = DPS_TimedWaitForEvent(event, 5000);
+    ASSERT(ret == DPS_OK);
+
+    DPS_DestroyPublication(pub);
+    DPS_DestroySubscription(sub);
+    DPS_DestroyNode(subNode, OnNodeDestroyed, event);
+    DPS_WaitForEvent(event);
+    DPS_DestroyNode(pubNode, OnNodeDestroyed, event);
+    DPS_WaitForEvent(event);
+    DPS_DestroyAddress(subAddr);
+    DPS_DestroyAddress(pubAddr);
+    DPS_DestroyEvent(event);
+}
+#endif
+
+#ifdef DPS_DEBUG
+#define RELIABLE_WINDOW   8
+#define NUM_RELIABLE_PUBS 200
+
+extern int _DPS_ReliableDropRate;
+
+typedef struct _ReliableReceiver {
+    DPS_Event* event;
+    uint8_t received[NUM_RELIABLE_PUBS + 1];
+    size_t numReceived;
+    size_t numDuplicates;
+} ReliableReceiver;
+
+static void ReliableHandler(DPS_Subscription* sub, const DPS_Publication* pub, uint8_t* payload, size_t len)
+{
+    ReliableReceiver* receiver = (ReliableReceiver*)DPS_GetSubscriptionData(sub);
+    uint32_t sn = DPS_PublicationGetSequenceNum(pub);
+
+    ASSERT(sn && (sn <= NUM_RELIABLE_PUBS));
+    if (receiver->received[sn]) {
+        ++receiver->numDuplicates;
+        return;
+    }
+    receiver->received[sn] = DPS_TRUE;
+    ++receiver->numReceived;
+    /*
+     * Signal when the first publication has arrived and again when
+     * all of them have arrived
+     */
+    if ((receiver->numReceived == 1) || (receiver->numReceived == NUM_RELIABLE_PUBS)) {
+        DPS_SignalEvent(receiver->event, DPS_OK);
+    }
+}
+
+static void TestReliableDelivery(DPS_Node* node, DPS_KeyStore* keyStore)
+{
+    static const char* topics[] = { __FUNCTION__ };
+    static const size_t numTopics = 1;
+    static ReliableReceiver receiver;
+    DPS_Publication* pub = NULL;
+    DPS_Event* event = NULL;
+    DPS_Node* subNode = NULL;
+    DPS_Subscription* sub = NULL;
+    DPS_NodeAddress* addr = NULL;
+    size_t numBusy = 0;
+    DPS_Status ret;
+    size_t i;
+
+    DPS_PRINT("%s\n", __FUNCTION__);
+
+    memset(&receiver, 0, sizeof(receiver));
+    pub = CreatePublication(node, topics, numTopics, NULL);
+    ret = DPS_SetPublicationReliable(pub, 65);
+    ASSERT(ret == DPS_ERR_ARGS);
+    ret = DPS_SetPublicationReliable(pub, RELIABLE_WINDOW);
+    ASSERT(ret == DPS_OK);
+
+    event = DPS_CreateEvent();
+    ASSERT(event);
+    receiver.event = DPS_CreateEvent();
+    ASSERT(receiver.event);
+
+    subNode = DPS_CreateNode("/.", keyStore, NULL);
+    ASSERT(subNode);
+    ret = DPS_StartNode(subNode, DPS_MCAST_PUB_DISABLED, NULL);
+    ASSERT(ret == DPS_OK);
+
+    sub = DPS_CreateSubscription(subNode, topics, numTopics);
+    ASSERT(sub);
+    ret = DPS_SetSubscriptionData(sub, &receiver);
+    ASSERT(ret == DPS_OK);
+    ret = DPS_Subscribe(sub, ReliableHandler);
+    ASSERT(ret == DPS_OK);
+
+    addr = DPS_CreateAddress();
+    ASSERT(addr);
+    ret = DPS_LinkTo(subNode, DPS_GetListenAddressString(node), addr);
+    ASSERT(ret == DPS_OK);
+    /*
+     * Retain the first publication so it is sent when the subscription
+     * arrives
+     */
+    ret = DPS_Publish(pub, NULL, 0, 10);
+    ASSERT(ret == DPS_OK);
+    ret = DPS_TimedWaitForEvent(receiver.event, 5000);
+    ASSERT(ret == DPS_OK);
+    /*
+     * Drop some of the publications the first time they are received
+     * and publish as fast as the window allows
+     */
+    _DPS_ReliableDropRate = 5;
+    for (i = 1; i < NUM_RELIABLE_PUBS;) {
+        ret = DPS_Publish(pub, NULL, 0, 0);
+        if (ret == DPS_ERR_BUSY) {
+            ++numBusy;
+            SLEEP(1);
+            continue;
+        }
+        ASSERT(ret == DPS_OK);
+        ++i;
+    }
+    ret = DPS_TimedWaitForEvent(receiver.event, 10000);
+    _DPS_ReliableDropRate = 0;
+    ASSERT(ret == DPS_OK);
+    ASSERT(receiver.numDuplicates == 0);
+    ASSERT(numBusy > 0);
+
+    DPS_DestroyAddress(addr);
+    DPS_DestroySubscription(sub);
+    DPS_DestroyNode(subNode, OnNodeDestroyed, event);
+    DPS_WaitForEvent(event);
+    DPS_DestroyEvent(receiver.event);
+    DPS_DestroyEvent(event);
+    DPS_DestroyPublication(pub);
+}
+
+typedef struct _RevisionReceiver {
+    DPS_Event* event;
+    uint32_t sequenceNums[4];
+    size_t numReceived;
+    size_t numExpected;
+} RevisionReceiver;
+
+static void RevisionHandler(DPS_Subscription* sub, const DPS_Publication* pub, uint8_t* payload, size_t len)
+{
+    RevisionReceiver* receiver = (RevisionReceiver*)DPS_GetSubscriptionData(sub);
+
+    if (receiver->numReceived < A_SIZEOF(receiver->sequenceNums)) {
+        receiver->sequenceNums[receiver->numReceived] = DPS_PublicationGetSequenceNum(pub);
+    }
+    if (++receiver->numReceived == receiver->numExpected) {
+        DPS_SignalEvent(receiver->event, DPS_OK);
+    }
+}
+
+static DPS_Node* CreateRevisionReceiver(DPS_KeyStore* keyStore, const char** topics, size_t numTopics,
+                                        RevisionReceiver* receiver, DPS_Subscription** sub)
+{
+    DPS_Node* node;
+    DPS_Status ret;
+
+    receiver->event = DPS_CreateEvent();
+    ASSERT(receiver->event);
+    node = DPS_CreateNode("/.", keyStore, NULL);
+    ASSERT(node);
+    ret = DPS_StartNode(node, DPS_MCAST_PUB_DISABLED, NULL);
+    ASSERT(ret == DPS_OK);
+    *sub = DPS_CreateSubscription(node, topics, numTopics);
+    ASSERT(*sub);
+    ret = DPS_SetSubscriptionData(*sub, receiver);
+    ASSERT(ret == DPS_OK);
+    ret = DPS_Subscribe(*sub, RevisionHandler);
+    ASSERT(ret == DPS_OK);
+    return node;
+}
+
+static void TestResentRevision(DPS_Node* node, DPS_KeyStore* keyStore)
+{
+    static const char* topics[] = { __FUNCTION__ };
+    static const size_t numTopics = 1;
+    static RevisionReceiver relayReceiver;
+    static RevisionReceiver lateReceiver;
+    DPS_Publication* pub = NULL;
+    DPS_Event* event = NULL;
+    DPS_Node* relayNode = NULL;
+    DPS_Node* lateNode = NULL;
+    DPS_Subscription* relaySub = NULL;
+    DPS_Subscription* lateSub = NULL;
+    DPS_NodeAddress* addr = NULL;
+    uint32_t sequenceNum;
+    DPS_Status ret;
+
+    DPS_PRINT("%s\n", __FUNCTION__);
+
+    memset(&relayReceiver, 0, sizeof(relayReceiver));
+    memset(&lateReceiver, 0, sizeof(lateReceiver));
+    pub = CreatePublication(node, topics, numTopics, NULL);
+    ret = DPS_SetPublicationReliable(pub, RELIABLE_WINDOW);
+    ASSERT(ret == DPS_OK);
+    event = DPS_CreateEvent();
+    ASSERT(event);
+    addr = DPS_CreateAddress();
+    ASSERT(addr);
+
+    relayNode = CreateRevisionReceiver(keyStore, topics, numTopics, &relayReceiver, &relaySub);
+    ret = DPS_LinkTo(relayNode, DPS_GetListenAddressString(node), addr);
+    ASSERT(ret == DPS_OK);
+    relayReceiver.numExpected = 1;
+    ret = DPS_Publish(pub, NULL, 0, 10);
+    ASSERT(ret == DPS_OK);
+    ret = DPS_TimedWaitForEvent(relayReceiver.event, 5000);
+    ASSERT(ret == DPS_OK);
+    /*
+     * Drop revision N the first time it is received so it is resent
+     * after revision N + 1 has been retained by the relay
+     */
+    _DPS_ReliableDropRate = 1;
+    ret = DPS_Publish(pub, NULL, 0, 10);
+    ASSERT(ret == DPS_OK);
+    sequenceNum = DPS_PublicationGetSequenceNum(pub);
+    SLEEP(100);
+    _DPS_ReliableDropRate = 0;
+    relayReceiver.numExpected = 3;
+    ret = DPS_Publish(pub, NULL, 0, 10);
+    ASSERT(ret == DPS_OK);
+    ret = DPS_TimedWaitForEvent(relayReceiver.event, 5000);
+    ASSERT(ret == DPS_OK);
+    ASSERT(relayReceiver.sequenceNums[1] == sequenceNum + 1);
+    ASSERT(relayReceiver.sequenceNums[2] == sequenceNum);
+    /*
+     * The relay must still be retaining revision N + 1
+     */
+    lateNode = CreateRevisionReceiver(keyStore, topics, numTopics, &lateReceiver, &lateSub);
+    lateReceiver.numExpected = 1;
+    ret = DPS_LinkTo(lateNode, DPS_GetListenAddressString(relayNode), addr);
+    ASSERT(ret == DPS_OK);
+    ret = DPS_TimedWaitForEvent(lateReceiver.event, 5000);
+    ASSERT(ret == DPS_OK);
+    SLEEP(100);
+    ASSERT(lateReceiver.numReceived == 1);
+    ASSERT(lateReceiver.sequenceNums[0] == sequenceNum + 1);
+
+    DPS_DestroySubscription(lateSub);
+    DPS_DestroyNode(lateNode, OnNodeDestroyed, event);
+    DPS_WaitForEvent(event);
+    DPS_DestroySubscription(relaySub);
+    DPS_DestroyNode(relayNode, OnNodeDestroyed, event);
+    DPS_WaitForEvent(event);
+    DPS_DestroyAddress(addr);
+    DPS_DestroyEvent(lateReceiver.event);
+    DPS_DestroyEvent(relayReceiver.event);
+    DPS_DestroyEvent(event);
+    DPS_DestroyPublication(pub);
+}
+#endif
+
+#ifdef DPS_DEBUG
+#define NUM_FANOUT_NODES 8
+#define NUM_FANOUT_PUBS  20
+
+extern int _DPS_NumPubHeaders;
+extern int _DPS_NumPubHeaderAllocs;
+
+typedef struct _FanoutReceiver {
+    DPS_Event* event;
+    uv_mutex_t lock;
+    size_t numReceived;
+} FanoutReceiver;
+
+static void FanoutHandler(DPS_Subscription* sub, const DPS_Publication* pub, uint8_t* payload, size_t len)
+{
+    FanoutReceiver* receiver = (FanoutReceiver*)DPS_GetSubscriptionData(sub);
+    size_t n;
+
+    uv_mutex_lock(&receiver->lock);
+    n = ++receiver->numReceived;
+    uv_mutex_unlock(&receiver->lock);
+    if (n == NUM_FANOUT_NODES) {
+        DPS_SignalEvent(receiver->event, DPS_OK);
+    }
+}
+
+static void TestPubHeaderPool(DPS_Node* node, DPS_KeyStore* keyStore)
 {
     static const char* topics[] = { __FUNCTION__ };
     static const size_t numTopics = 1;
+    static FanoutReceiver receiver;
     DPS_Publication* pub = NULL;
-    size_t depth = 10000;
-    DPS_Subscription* sub = NULL;
-    uint32_t seqNum;
+    DPS_Event* event = NULL;
+    DPS_Node* subNodes[NUM_FANOUT_NODES];
+    DPS_Subscription* subs[NUM_FANOUT_NODES];
+    DPS_NodeAddress* addr = NULL;
+    int numHeaders;
+    int numAllocs;
     DPS_Status ret;
     size_t i;
 
     DPS_PRINT("%s\n", __FUNCTION__);
 
+    memset(&receiver, 0, sizeof(receiver));
+    uv_mutex_init(&receiver.lock);
+    receiver.event = DPS_CreateEvent();
+    ASSERT(receiver.event);
+    event = DPS_CreateEvent();
+    ASSERT(event);
+    addr = DPS_CreateAddress();
+    ASSERT(addr);
+    for (i = 0; i < NUM_FANOUT_NODES; ++i) {
+        subNodes[i] = DPS_CreateNode("/.", keyStore, NULL);
+        ASSERT(subNodes[i]);
+        ret = DPS_StartNode(subNodes[i], DPS_MCAST_PUB_DISABLED, NULL);
+        ASSERT(ret == DPS_OK);
+        subs[i] = DPS_CreateSubscription(subNodes[i], topics, numTopics);
+        ASSERT(subs[i]);
+        ret = DPS_SetSubscriptionData(subs[i], &receiver);
+        ASSERT(ret == DPS_OK);
+        ret = DPS_Subscribe(subs[i], FanoutHandler);
+        ASSERT(ret == DPS_OK);
+        ret = DPS_LinkTo(subNodes[i], DPS_GetListenAddressString(node), addr);
+        ASSERT(ret == DPS_OK);
+    }
     pub = CreatePublication(node, topics, numTopics, NULL);
-
-    sub = DPS_CreateSubscription(node, topics, numTopics);
-    ASSERT(sub);
-    ret = DPS_SetSubscriptionData(sub, &seqNum);
+    /*
+     * Retain the first publication so it reaches every subscriber
+     */
+    ret = DPS_Publish(pub, NULL, 0, 10);
     ASSERT(ret == DPS_OK);
-    ret = DPS_Subscribe(sub, BackToBackPublishHandler);
+    ret = DPS_TimedWaitForEvent(receiver.event, 5000);
     ASSERT(ret == DPS_OK);
-
-    seqNum = DPS_PublicationGetSequenceNum(pub) + 1;
-    for (i = 0; i < depth; ++i) {
+    /*
+     * Every publication is sent to each of the linked nodes, once
+     * the pool is primed the headers should come from the pool
+     */
+    numHeaders = _DPS_NumPubHeaders;
+    numAllocs = _DPS_NumPubHeaderAllocs;
+    for (i = 0; i < NUM_FANOUT_PUBS; ++i) {
+        uv_mutex_lock(&receiver.lock);
+        receiver.numReceived = 0;
+        uv_mutex_unlock(&receiver.lock);
         ret = DPS_Publish(pub, NULL, 0, 0);
         ASSERT(ret == DPS_OK);
+        ret = DPS_TimedWaitForEvent(receiver.event, 5000);
+        ASSERT(ret == DPS_OK);
     }
+    numHeaders = _DPS_NumPubHeaders - numHeaders;
+    numAllocs = _DPS_NumPubHeaderAllocs - numAllocs;
+    DPS_PRINT("%d publication headers sent, %d allocated\n", numHeaders, numAllocs);
+    ASSERT(numHeaders >= NUM_FANOUT_NODES * NUM_FANOUT_PUBS);
+    ASSERT(numAllocs <= NUM_FANOUT_NODES);
 
-    /*
-     * Give some time to receive the publications since we don't
-     * explicitly wait for the acks in this test.
-     */
-    SLEEP(1000);
-
-    DPS_DestroySubscription(sub);
     DPS_DestroyPublication(pub);
+    for (i = 0; i < NUM_FANOUT_NODES; ++i) {
+        DPS_DestroySubscription(subs[i]);
+        DPS_DestroyNode(subNodes[i], OnNodeDestroyed, event);
+        DPS_WaitForEvent(event);
+    }
+    DPS_DestroyAddress(addr);
+    DPS_DestroyEvent(receiver.event);
+    DPS_DestroyEvent(event);
+    uv_mutex_destroy(&receiver.lock);
 }
+#endif
 
-#if defined(DPS_USE_TCP)
-static void OnLinkComplete(DPS_Node* node, DPS_NodeAddress* addr, DPS_Status status, void* data)
+#if defined(DPS_USE_UDP)
+#define FRAGMENTED_LEN (200 * 1024)
+
+#ifdef DPS_DEBUG
+extern int _DPS_FragmentDropRate;
+#endif
+
+static void FragmentedMessageHandler(DPS_Subscription* sub, const DPS_Publication* pub, uint8_t* payload, size_t len)
 {
-    if (data) {
-        DPS_SignalEvent((DPS_Event*)data, status);
+    DPS_Event* event = (DPS_Event*)DPS_GetSubscriptionData(sub);
+    size_t i;
+
+    for (i = 0; i < len; ++i) {
+        if (payload[i] != (uint8_t)i) {
+            break;
+        }
     }
+    DPS_SignalEvent(event, ((i == len) && (len == FRAGMENTED_LEN)) ? DPS_OK : DPS_ERR_INVALID);
 }
-static void TestBackToBackPublishSeparateNodes(DPS_Node* node, DPS_KeyStore* keyStore)
+
+static void FragmentedPublish(DPS_Node* node, DPS_KeyStore* keyStore, const char* topic)
 {
-    static const char* topics[] = { __FUNCTION__ };
-    static const size_t numTopics = 1;
+    const char* topics[] = { topic };
+    static uint8_t payload[FRAGMENTED_LEN];
     DPS_Publication* pub = NULL;
-    size_t depth = 10000;
     DPS_Event* event = NULL;
     DPS_Node* subNode = NULL;
     DPS_Subscription* sub = NULL;
     DPS_NodeAddress* addr = NULL;
-    uint32_t seqNum;
     DPS_Status ret;
     size_t i;
 
-    DPS_PRINT("%s\n", __FUNCTION__);
-
-    pub = CreatePublication(node, topics, numTopics, NULL);
+    for (i = 0; i < A_SIZEOF(payload); ++i) {
+        payload[i] = (uint8_t)i;
+    }
+    pub = CreatePublication(node, topics, 1, NULL);
 
     event = DPS_CreateEvent();
     ASSERT(event);
 
     subNode = DPS_CreateNode("/.", keyStore, NULL);
     ASSERT(subNode);
+    /*
+     * Fragments sent over loopback can still be dropped when the
+     * receiver falls behind, both the sender and the receiver must
+     * enable retransmission
+     */
+    DPS_SetNodeFragmentRetransmit(node, DPS_TRUE);
+    DPS_SetNodeFragmentRetransmit(subNode, DPS_TRUE);
     ret = DPS_StartNode(subNode, DPS_MCAST_PUB_DISABLED, NULL);
     ASSERT(ret == DPS_OK);
 
-    sub = DPS_CreateSubscription(subNode, topics, numTopics);
+    sub = DPS_CreateSubscription(subNode, topics, 1);
     ASSERT(sub);
-    ret = DPS_SetSubscriptionData(sub, &seqNum);
+    ret = DPS_SetSubscriptionData(sub, event);
     ASSERT(ret == DPS_OK);
-    ret = DPS_Subscribe(sub, BackToBackPublishHandler);
+    ret = DPS_Subscribe(sub, FragmentedMessageHandler);
     ASSERT(ret == DPS_OK);
 
     addr = DPS_CreateAddress();
     ASSERT(addr);
     ret = DPS_LinkTo(subNode, DPS_GetListenAddressString(node), addr);
     ASSERT(ret == DPS_OK);
-
-    seqNum = DPS_PublicationGetSequenceNum(pub) + 1;
-    for (i = 0; i < depth; ++i) {
-        ret = DPS_Publish(pub, NULL, 0, 0);
-        ASSERT(ret == DPS_OK);
-    }
-
     /*
-     * Give some time to receive the publications since we don't
-     * explicitly wait for the acks in this test.
+     * Retain the publication so it is sent when the subscription
+     * arrives
      */
-    SLEEP(1000);
+    ret = DPS_Publish(pub, payload, A_SIZEOF(payload), 10);
+    ASSERT(ret == DPS_OK);
+    ret = DPS_TimedWaitForEvent(event, 5000);
+    ASSERT(ret == DPS_OK);
 
     DPS_DestroyAddress(addr);
+    DPS_SetNodeFragmentRetransmit(node, DPS_FALSE);
+    DPS_DestroySubscription(sub);
+    DPS_DestroyNode(subNode, OnNodeDestroyed, event);
+    DPS_WaitForEvent(event);
+    DPS_DestroyEvent(event);
+    DPS_DestroyPublication(pub);
+}
+
+static void TestFragmentedMessage(DPS_Node* node, DPS_KeyStore* keyStore)
+{
+    DPS_PRINT("%s\n", __FUNCTION__);
+
+    FragmentedPublish(node, keyStore, __FUNCTION__);
+}
+
+#ifdef DPS_DEBUG
+static void TestFragmentRetransmit(DPS_Node* node, DPS_KeyStore* keyStore)
+{
+    DPS_PRINT("%s\n", __FUNCTION__);
+
+    _DPS_FragmentDropRate = 7;
+    FragmentedPublish(node, keyStore, __FUNCTION__);
+    _DPS_FragmentDropRate = 0;
+}
+#endif
+#endif
+
+#if defined(DPS_USE_PIPE)
+#define MCAST_FRAGMENTED_LEN (8 * 1024)
+
+static void MulticastFragmentedHandler(DPS_Subscription* sub, const DPS_Publication* pub, uint8_t* payload,
+                                       size_t len)
+{
+    DPS_Event* event = (DPS_Event*)DPS_GetSubscriptionData(sub);
+    size_t i;
+
+    for (i = 0; i < len; ++i) {
+        if (payload[i] != (uint8_t)i) {
+            break;
+        }
+    }
+    DPS_SignalEvent(event, ((i == len) && (len == MCAST_FRAGMENTED_LEN)) ? DPS_OK : DPS_ERR_INVALID);
+}
+
+/*
+ * Multicast publications are fragmented whatever the unicast transport
+ * is, the fragments carry the path a pipe node listens on
+ */
+static void TestMulticastFragmentedMessage(DPS_Node* node, DPS_KeyStore* keyStore)
+{
+    static const char* topics[] = { __FUNCTION__ };
+    static uint8_t payload[MCAST_FRAGMENTED_LEN];
+    DPS_Publication* pub = NULL;
+    DPS_Event* event = NULL;
+    DPS_Node* subNode = NULL;
+    DPS_Subscription* sub = NULL;
+    DPS_Status ret;
+    size_t i;
+
+    DPS_PRINT("%s\n", __FUNCTION__);
+
+    for (i = 0; i < A_SIZEOF(payload); ++i) {
+        payload[i] = (uint8_t)i;
+    }
+    pub = CreatePublication(node, topics, 1, NULL);
+
+    event = DPS_CreateEvent();
+    ASSERT(event);
+
+    subNode = DPS_CreateNode("/.", keyStore, NULL);
+    ASSERT(subNode);
+    DPS_SetNodeFragmentRetransmit(node, DPS_TRUE);
+    DPS_SetNodeFragmentRetransmit(subNode, DPS_TRUE);
+    ret = DPS_StartNode(subNode, DPS_MCAST_PUB_ENABLE_RECV, NULL);
+    ASSERT(ret == DPS_OK);
+
+    sub = DPS_CreateSubscription(subNode, topics, 1);
+    ASSERT(sub);
+    ret = DPS_SetSubscriptionData(sub, event);
+    ASSERT(ret == DPS_OK);
+    ret = DPS_Subscribe(sub, MulticastFragmentedHandler);
+    ASSERT(ret == DPS_OK);
+
+    ret = DPS_Publish(pub, payload, A_SIZEOF(payload), 0);
+    ASSERT(ret == DPS_OK);
+    ret = DPS_TimedWaitForEvent(event, 5000);
+    ASSERT(ret == DPS_OK);
+
+    DPS_SetNodeFragmentRetransmit(node, DPS_FALSE);
     DPS_DestroySubscription(sub);
     DPS_DestroyNode(subNode, OnNodeDestroyed, event);
     DPS_WaitForEvent(event);
@@ -520,6 +1338,223 @@ static void TestPublishNoRoutes(DPS_Node* node, DPS_KeyStore* keyStore)
     DPS_DestroyEvent(event);
 }
 
+static void BloomStatsHandler(DPS_Subscription* sub, const DPS_Publication* pub, uint8_t* payload, size_t len)
+{
+    DPS_SignalEvent((DPS_Event*)DPS_GetSubscriptionData(sub), DPS_OK);
+}
+
+static void TestBloomStats(DPS_Node* node, DPS_KeyStore* keyStore)
+{
+    /*
+     * The publication topics together set the Bloom filter bits of the
+     * subscription topic but neither of them matches it
+     */
+    static const char* subTopics[] = { "goo/+/gorn" };
+    static const char* fpTopics[] = { "goo/bar", "foo/baz/gorn" };
+    static const char* matchTopics[] = { "goo/bar/gorn" };
+    DPS_Publication* fpPub = NULL;
+    DPS_Publication* matchPub = NULL;
+    DPS_Event* event = NULL;
+    DPS_Event* received = NULL;
+    DPS_Node* subNode = NULL;
+    DPS_Subscription* sub = NULL;
+    DPS_NodeAddress* addr = NULL;
+    DPS_BloomStats stats;
+    DPS_BloomStats linkStats;
+    DPS_Status ret;
+    int i;
+
+    DPS_PRINT("%s\n", __FUNCTION__);
+
+    event = DPS_CreateEvent();
+    ASSERT(event);
+    received = DPS_CreateEvent();
+    ASSERT(received);
+
+    subNode = DPS_CreateNode("/.", keyStore, NULL);
+    ASSERT(subNode);
+    ret = DPS_StartNode(subNode, DPS_MCAST_PUB_DISABLED, NULL);
+    ASSERT(ret == DPS_OK);
+
+    sub = DPS_CreateSubscription(subNode, subTopics, A_SIZEOF(subTopics));
+    ASSERT(sub);
+    ret = DPS_SetSubscriptionData(sub, received);
+    ASSERT(ret == DPS_OK);
+    ret = DPS_Subscribe(sub, BloomStatsHandler);
+    ASSERT(ret == DPS_OK);
+
+    addr = DPS_CreateAddress();
+    ASSERT(addr);
+    ret = DPS_LinkTo(subNode, DPS_GetListenAddressString(node), addr);
+    ASSERT(ret == DPS_OK);
+    /*
+     * Retain the publications so they are sent when the subscription
+     * arrives
+     */
+    fpPub = CreatePublication(node, fpTopics, A_SIZEOF(fpTopics), NULL);
+    ret = DPS_Publish(fpPub, NULL, 0, 10);
+    ASSERT(ret == DPS_OK);
+    matchPub = CreatePublication(node, matchTopics, A_SIZEOF(matchTopics), NULL);
+    ret = DPS_Publish(matchPub, NULL, 0, 10);
+    ASSERT(ret == DPS_OK);
+    ret = DPS_TimedWaitForEvent(received, 5000);
+    ASSERT(ret == DPS_OK);
+    /*
+     * The publications may arrive in either order
+     */
+    for (i = 0; i < 50; ++i) {
+        ret = DPS_GetBloomStats(subNode, NULL, &stats);
+        ASSERT(ret == DPS_OK);
+        if (stats.pubsReceived >= 2) {
+            break;
+        }
+        SLEEP(100);
+    }
+    ASSERT(stats.pubsReceived == 2);
+    ASSERT(stats.bloomMatches == 2);
+    ASSERT(stats.falsePositives == 1);
+    ret = DPS_GetBloomStats(subNode, addr, &linkStats);
+    ASSERT(ret == DPS_OK);
+    ASSERT(linkStats.pubsReceived == 2);
+    ASSERT(linkStats.falsePositives == 1);
+    /*
+     * The subscriber sent interests and the publisher received them
+     */
+    ASSERT(linkStats.outbound.samples > 0);
+    ASSERT(linkStats.outbound.current > 0.0f);
+    ASSERT(linkStats.outbound.peak >= linkStats.outbound.current);
+    ASSERT(linkStats.outbound.peak >= linkStats.outbound.mean);
+    ret = DPS_GetBloomStats(node, NULL, &stats);
+    ASSERT(ret == DPS_OK);
+    ASSERT(stats.inbound.samples > 0);
+    ASSERT(stats.inbound.peak > 0.0f);
+    ASSERT(stats.falsePositives == 0);
+
+    DPS_DestroyAddress(addr);
+    DPS_DestroySubscription(sub);
+    DPS_DestroyNode(subNode, OnNodeDestroyed, event);
+    DPS_WaitForEvent(event);
+    DPS_DestroyPublication(matchPub);
+    DPS_DestroyPublication(fpPub);
+    DPS_DestroyEvent(received);
+    DPS_DestroyEvent(event);
+}
+
+typedef struct _RetainedPayload {
+    DPS_Event* event;
+    DPS_NetRxBuffer* buf;
+    uint8_t* payload;
+    size_t len;
+} RetainedPayload;
+
+static void RetainPayloadHandler(DPS_Subscription* sub, const DPS_Publication* pub, uint8_t* payload, size_t len)
+{
+    RetainedPayload* retained = (RetainedPayload*)DPS_GetSubscriptionData(sub);
+
+    retained->buf = DPS_PublicationRetainPayload(pub);
+    retained->payload = payload;
+    retained->len = len;
+    DPS_SignalEvent(retained->event, DPS_OK);
+}
+
+static void TestRetainPayload(DPS_Node* node, DPS_KeyStore* keyStore)
+{
+    static const char* topics[] = { __FUNCTION__ };
+    static const DPS_KeyId* keyIds[] = { NULL, &PskId[0] };
+    static const uint8_t message[] = "retained payload";
+    uint8_t largeMessage[1024];
+    DPS_Publication* pub = NULL;
+    DPS_Event* event = NULL;
+    DPS_Node* subNode = NULL;
+    DPS_Subscription* sub = NULL;
+    DPS_NodeAddress* addr = NULL;
+    RetainedPayload retained;
+    DPS_NetRxBuffer* firstBuf;
+    uint8_t* firstPayload;
+    DPS_Status ret;
+    size_t i;
+
+    DPS_PRINT("%s\n", __FUNCTION__);
+
+    for (i = 0; i < sizeof(largeMessage); ++i) {
+        largeMessage[i] = (uint8_t)i;
+    }
+    memset(&retained, 0, sizeof(retained));
+    event = DPS_CreateEvent();
+    ASSERT(event);
+    retained.event = DPS_CreateEvent();
+    ASSERT(retained.event);
+
+    ASSERT(DPS_PublicationRetainPayload(NULL) == NULL);
+    DPS_ReleasePayload(NULL);
+
+    subNode = DPS_CreateNode("/.", keyStore, NULL);
+    ASSERT(subNode);
+    ret = DPS_StartNode(subNode, DPS_MCAST_PUB_DISABLED, NULL);
+    ASSERT(ret == DPS_OK);
+
+    sub = DPS_CreateSubscription(subNode, topics, A_SIZEOF(topics));
+    ASSERT(sub);
+    ret = DPS_SetSubscriptionData(sub, &retained);
+    ASSERT(ret == DPS_OK);
+    ret = DPS_Subscribe(sub, RetainPayloadHandler);
+    ASSERT(ret == DPS_OK);
+
+    addr = DPS_CreateAddress();
+    ASSERT(addr);
+    ret = DPS_LinkTo(subNode, DPS_GetListenAddressString(node), addr);
+    ASSERT(ret == DPS_OK);
+
+    /*
+     * The payloads of unencrypted and decrypted publications are both
+     * held in receive buffers
+     */
+    for (i = 0; i < A_SIZEOF(keyIds); ++i) {
+        pub = DPS_CreatePublication(node);
+        ASSERT(pub);
+        ret = DPS_InitPublication(pub, topics, A_SIZEOF(topics), DPS_FALSE, keyIds[i], NULL);
+        ASSERT(ret == DPS_OK);
+        /*
+         * Retain the first publication so it is sent when the
+         * subscription arrives
+         */
+        ret = DPS_Publish(pub, message, sizeof(message), 10);
+        ASSERT(ret == DPS_OK);
+        ret = DPS_TimedWaitForEvent(retained.event, 5000);
+        ASSERT(ret == DPS_OK);
+        ASSERT(retained.buf);
+        ASSERT(retained.len == sizeof(message));
+        /*
+         * Receive another publication before releasing the first
+         * payload, the first payload must be unchanged
+         */
+        firstBuf = retained.buf;
+        firstPayload = retained.payload;
+        ret = DPS_Publish(pub, largeMessage, sizeof(largeMessage), 0);
+        ASSERT(ret == DPS_OK);
+        ret = DPS_TimedWaitForEvent(retained.event, 5000);
+        ASSERT(ret == DPS_OK);
+        ASSERT(retained.buf && (retained.buf != firstBuf));
+        ASSERT(memcmp(firstPayload, message, sizeof(message)) == 0);
+        DPS_ReleasePayload(firstBuf);
+        ASSERT(retained.len == sizeof(largeMessage));
+        ASSERT(memcmp(retained.payload, largeMessage, sizeof(largeMessage)) == 0);
+        /*
+         * The payload stays valid after the publication is destroyed
+         */
+        DPS_DestroyPublication(pub);
+        ASSERT(memcmp(retained.payload, largeMessage, sizeof(largeMessage)) == 0);
+        DPS_ReleasePayload(retained.buf);
+    }
+
+    DPS_DestroyAddress(addr);
+    DPS_DestroySubscription(sub);
+    DPS_DestroyNode(subNode, OnNodeDestroyed, event);
+    DPS_WaitForEvent(event);
+    DPS_DestroyEvent(retained.event);
+    DPS_DestroyEvent(event);
+}
+
 typedef void (*TEST)(DPS_Node*, DPS_KeyStore*);
 
 int main(int argc, char** argv)
@@ -529,6 +1564,7 @@ int main(int argc, char** argv)
         TestLoopbackLargeMessage,
         TestLoopbackAckLargeMessage,
         TestDelayedAck,
+        TestAggregatedAcks,
         /*
          * Reliability is only expected for loopback and reliable
          * transports.
@@ -536,11 +1572,31 @@ int main(int argc, char** argv)
         TestBackToBackPublish,
 #if defined(DPS_USE_TCP)
         TestBackToBackPublishSeparateNodes,
+        TestAckSeparateNodes,
+#endif
+#if defined(DPS_USE_TCP) && defined(DPS_USE_UDP)
+        TestForwardBetweenTransports,
+#endif
+#ifdef DPS_DEBUG
+        TestReliableDelivery,
+        TestResentRevision,
+        TestPubHeaderPool,
+#endif
+#if defined(DPS_USE_UDP)
+        TestFragmentedMessage,
+#ifdef DPS_DEBUG
+        TestFragmentRetransmit,
+#endif
+#endif
+#if defined(DPS_USE_PIPE)
+        TestMulticastFragmentedMessage,
 #endif
         TestRetainedMessage,
         TestRetainedExpired,
         TestSequenceNumbers,
         TestPublishNoRoutes,
+        TestBloomStats,
+        TestRetainPayload,
         NULL
     };
     TEST* test;
@@ -564,6 +1620,7 @@ int main(int argc, char** argv)
     for (test = tests; *test; ++test) {
         memoryKeyStore = DPS_CreateMemoryKeyStore();
         DPS_SetNetworkKey(memoryKeyStore, &NetworkKeyId, &NetworkKey);
+        DPS_SetContentKey(memoryKeyStore, &PskId[0], &Psk[0]);
         node = DPS_CreateNode("/.", DPS_MemoryKeyStoreHandle(memoryKeyStore), NULL);
         ASSERT(node);
         ret = DPS_StartNode(node, DPS_MCAST_PUB_ENABLE_SEND | DPS_MCAST_PUB_ENABLE_RECV, NULL);
@@ -0,0 +1,174 @@
+/*
+ *******************************************************************
+ *
+ * Copyright 2016 Intel Corporation All rights reserved.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ */
+
+/*
+ * Reconnect benchmark. Repeatedly links and unlinks two local nodes
+ * and reports the latency of the first link against the latency of
+ * the links that follow. With the DTLS transport the first link runs
+ * a full handshake and the links that follow can resume the session.
+ */
+
+#include "test.h"
+#include "keys.h"
+#include "node.h"
+
+static void OnNodeDestroyed(DPS_Node* node, void* data)
+{
+    DPS_SignalEvent((DPS_Event*)data, DPS_OK);
+}
+
+static DPS_MemoryKeyStore* CreateKeyStore(const Id* self, int usePsk)
+{
+    DPS_MemoryKeyStore* keyStore;
+    const Id* id;
+
+    keyStore = DPS_CreateMemoryKeyStore();
+    if (!keyStore) {
+        return NULL;
+    }
+    if (usePsk) {
+        DPS_SetNetworkKey(keyStore, &NetworkKeyId, &NetworkKey);
+        return keyStore;
+    }
+    DPS_SetTrustedCA(keyStore, TrustedCAs);
+    for (id = Ids; id->keyId.id; ++id) {
+        if (id == self) {
+            DPS_SetCertificate(keyStore, id->cert, id->privateKey, id->password);
+        } else {
+            DPS_SetCertificate(keyStore, id->cert, NULL, NULL);
+        }
+    }
+    return keyStore;
+}
+
+static DPS_Node* CreateNode(DPS_MemoryKeyStore* keyStore, const Id* self, int subsRate)
+{
+    DPS_NodeAddress* listenAddr = DPS_CreateAddress();
+    DPS_Node* node;
+    DPS_Status ret;
+
+    ASSERT(listenAddr);
+    node = DPS_CreateNode("/.", DPS_MemoryKeyStoreHandle(keyStore), self ? &self->keyId : NULL);
+    ASSERT(node);
+    DPS_SetNodeSubscriptionUpdateDelay(node, subsRate);
+    DPS_SetAddress(listenAddr, "[::1]:0");
+    ret = DPS_StartNode(node, DPS_MCAST_PUB_DISABLED, listenAddr);
+    DPS_DestroyAddress(listenAddr);
+    ASSERT(ret == DPS_OK);
+    return node;
+}
+
+int main(int argc, char** argv)
+{
+    DPS_Status ret;
+    char** arg = argv + 1;
+    DPS_MemoryKeyStore* keyStoreA;
+    DPS_MemoryKeyStore* keyStoreB;
+    DPS_Node* a;
+    DPS_Node* b;
+    DPS_NodeAddress* addr;
+    DPS_Event* event;
+    int numLinks = 100;
+    int subsRate = 10;
+    int usePsk = DPS_FALSE;
+    uint64_t first = 0;
+    uint64_t total = 0;
+    uint64_t min = UINT64_MAX;
+    uint64_t max = 0;
+    uint64_t start;
+    int i;
+
+    DPS_Debug = DPS_FALSE;
+    while (--argc) {
+        if (IntArg("-n", &arg, &argc, &numLinks, 2, INT32_MAX)) {
+            continue;
+        }
+        if (IntArg("-r", &arg, &argc, &subsRate, 1, 10000)) {
+            continue;
+        }
+        if (strcmp(*arg, "-p") == 0) {
+            ++arg;
+            usePsk = DPS_TRUE;
+            continue;
+        }
+        if (strcmp(*arg, "-d") == 0) {
+            ++arg;
+            DPS_Debug = DPS_TRUE;
+            continue;
+        }
+        goto Usage;
+    }
+
+    keyStoreA = CreateKeyStore(&Ids[0], usePsk);
+    keyStoreB = CreateKeyStore(&Ids[1], usePsk);
+    ASSERT(keyStoreA && keyStoreB);
+    a = CreateNode(keyStoreA, usePsk ? NULL : &Ids[0], subsRate);
+    b = CreateNode(keyStoreB, usePsk ? NULL : &Ids[1], subsRate);
+    addr = DPS_CreateAddress();
+    ASSERT(addr);
+
+    for (i = 0; i < numLinks; ++i) {
+        uint64_t t;
+
+        start = uv_hrtime();
+        ret = DPS_LinkTo(a, DPS_GetListenAddressString(b), addr);
+        t = uv_hrtime() - start;
+        if (ret != DPS_OK) {
+            DPS_ERRPRINT("Link %d failed: %s\n", i, DPS_ErrTxt(ret));
+            return EXIT_FAILURE;
+        }
+        if (i == 0) {
+            first = t;
+        } else {
+            total += t;
+            min = (t < min) ? t : min;
+            max = (t > max) ? t : max;
+        }
+        ret = DPS_UnlinkFrom(a, addr);
+        if (ret != DPS_OK) {
+            DPS_ERRPRINT("Unlink %d failed: %s\n", i, DPS_ErrTxt(ret));
+            return EXIT_FAILURE;
+        }
+    }
+    DPS_PRINT("First link %.3f msecs\n", first / 1.0e6);
+    DPS_PRINT("Reconnect avg %.3f min %.3f max %.3f msecs\n", total / 1.0e6 / (numLinks - 1), min / 1.0e6, max / 1.0e6);
+    DPS_PRINT("%.1f links/sec\n", (numLinks - 1) / (total / 1.0e9));
+
+    DPS_DestroyAddress(addr);
+    event = DPS_CreateEvent();
+    ASSERT(event);
+    DPS_DestroyNode(a, OnNodeDestroyed, event);
+    DPS_WaitForEvent(event);
+    DPS_DestroyNode(b, OnNodeDestroyed, event);
+    DPS_WaitForEvent(event);
+    DPS_DestroyEvent(event);
+    DPS_DestroyMemoryKeyStore(keyStoreA);
+    DPS_DestroyMemoryKeyStore(keyStoreB);
+    return EXIT_SUCCESS;
+
+Usage:
+    DPS_PRINT("Usage %s: [-d] [-p] [-n <num-links>] [-r <subs-rate>]\n", argv[0]);
+    DPS_PRINT("       -p: Use the network PSK instead of certificates.\n");
+    DPS_PRINT("       -n: Number of times to link and unlink.\n");
+    DPS_PRINT("       -r: Subscription update delay in msecs, kept short so the handshake dominates.\n");
+    return EXIT_FAILURE;
+}
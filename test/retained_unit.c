@@ -0,0 +1,206 @@
+/*
+ *******************************************************************
+ *
+ * Copyright 2016 Intel Corporation All rights reserved.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ */
+
+
+/*
+ * Unit test for the retained publication index
+ */
+#include "test.h"
+#include "pub.h"
+#include "retained.h"
+#include "topics.h"
+
+#define NUM_PUBS   500
+#define NUM_SUBS   50
+
+static DPS_Publication pubs[NUM_PUBS];
+static int visits[NUM_PUBS];
+
+static void OnCandidate(DPS_Publication* pub, void* data)
+{
+    ++visits[pub - pubs];
+}
+
+static void MakeTopic(char* topic, size_t len, int i)
+{
+    snprintf(topic, len, "building%d/room%d/sensor%d", i % 5, i % 17, i);
+}
+
+static int CheckMatch(DPS_RetainedIndex* index, DPS_BitVector* sub, int removed)
+{
+    DPS_Status ret;
+    int i;
+
+    memset(visits, 0, sizeof(visits));
+    ret = DPS_RetainedIndexMatch(index, sub, OnCandidate, NULL);
+    if (ret != DPS_OK) {
+        DPS_PRINT("Match failed %s\n", DPS_ErrTxt(ret));
+        return DPS_FALSE;
+    }
+    for (i = 0; i < NUM_PUBS; ++i) {
+        if (visits[i] > 1) {
+            DPS_PRINT("Publication %d visited %d times\n", i, visits[i]);
+            return DPS_FALSE;
+        }
+        if (i < removed) {
+            if (visits[i]) {
+                DPS_PRINT("Removed publication %d was visited\n", i);
+                return DPS_FALSE;
+            }
+        } else if (DPS_BitVectorIncludes(pubs[i].bf, sub) && !visits[i]) {
+            DPS_PRINT("Matching publication %d was not visited\n", i);
+            return DPS_FALSE;
+        }
+    }
+    return DPS_TRUE;
+}
+
+int main(int argc, char** argv)
+{
+    DPS_Status ret;
+    DPS_RetainedIndex index;
+    DPS_BitVector* sub;
+    char topic[64];
+    int i;
+
+    DPS_Debug = DPS_FALSE;
+    for (i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-d")) {
+            DPS_Debug = DPS_TRUE;
+        }
+    }
+    memset(&index, 0, sizeof(index));
+
+    for (i = 0; i < NUM_PUBS; ++i) {
+        pubs[i].bf = DPS_BitVectorAlloc();
+        ASSERT(pubs[i].bf);
+        MakeTopic(topic, sizeof(topic), i);
+        ret = DPS_AddTopic(pubs[i].bf, topic, "/", DPS_PubTopic);
+        ASSERT(ret == DPS_OK);
+        ret = DPS_RetainedIndexAdd(&index, &pubs[i]);
+        ASSERT(ret == DPS_OK);
+        ASSERT(pubs[i].flags & PUB_FLAG_INDEXED);
+    }
+    /*
+     * Adding twice is harmless
+     */
+    ret = DPS_RetainedIndexAdd(&index, &pubs[0]);
+    ASSERT(ret == DPS_OK);
+    ASSERT(index.count == NUM_PUBS);
+
+    sub = DPS_BitVectorAlloc();
+    ASSERT(sub);
+    DPS_PRINT("Match all publications\n");
+    for (i = 0; i < NUM_SUBS; ++i) {
+        DPS_BitVectorClear(sub);
+        MakeTopic(topic, sizeof(topic), rand() % NUM_PUBS);
+        ret = DPS_AddTopic(sub, topic, "/", DPS_SubTopic);
+        ASSERT(ret == DPS_OK);
+        ASSERT(CheckMatch(&index, sub, 0));
+    }
+    DPS_PRINT("Match after removing publications\n");
+    for (i = 0; i < NUM_PUBS / 2; ++i) {
+        DPS_RetainedIndexRemove(&index, &pubs[i]);
+        ASSERT(!(pubs[i].flags & PUB_FLAG_INDEXED));
+    }
+    for (i = 0; i < NUM_SUBS; ++i) {
+        DPS_BitVectorClear(sub);
+        MakeTopic(topic, sizeof(topic), rand() % NUM_PUBS);
+        ret = DPS_AddTopic(sub, topic, "/", DPS_SubTopic);
+        ASSERT(ret == DPS_OK);
+        ASSERT(CheckMatch(&index, sub, NUM_PUBS / 2));
+    }
+    /*
+     * Wildcard subscriptions must find the same publications
+     */
+    DPS_BitVectorClear(sub);
+    ret = DPS_AddTopic(sub, "building3/#", "/", DPS_SubTopic);
+    ASSERT(ret == DPS_OK);
+    ASSERT(CheckMatch(&index, sub, NUM_PUBS / 2));
+    /*
+     * A bit vector of the wrong length is rejected
+     */
+    {
+        DPS_BitVector* folded = DPS_BitVectorAllocLen(DPS_BitVectorLen(sub) / 2);
+        ASSERT(folded);
+        DPS_BitVectorFold(folded, sub);
+        ret = DPS_RetainedIndexMatch(&index, folded, OnCandidate, NULL);
+        ASSERT(ret == DPS_ERR_ARGS);
+        DPS_BitVectorFree(folded);
+    }
+    DPS_PRINT("Remove remaining publications\n");
+    for (i = NUM_PUBS / 2; i < NUM_PUBS; ++i) {
+        DPS_RetainedIndexRemove(&index, &pubs[i]);
+    }
+    ASSERT(index.count == 0);
+    ASSERT(index.buckets == NULL);
+    ASSERT(CheckMatch(&index, sub, NUM_PUBS));
+
+    DPS_PRINT("Match after a failed add\n");
+    {
+        DPS_Publication unindexed;
+
+        memset(&unindexed, 0, sizeof(unindexed));
+        unindexed.bf = DPS_BitVectorAllocLen(DPS_BitVectorLen(sub) / 2);
+        ASSERT(unindexed.bf);
+        for (i = 0; i < NUM_PUBS; ++i) {
+            ret = DPS_RetainedIndexAdd(&index, &pubs[i]);
+            ASSERT(ret == DPS_OK);
+        }
+        ret = DPS_RetainedIndexAdd(&index, &unindexed);
+        ASSERT(ret == DPS_ERR_ARGS);
+        ASSERT(index.incomplete);
+        /*
+         * The index stays incomplete while the publication that could
+         * not be added is retained
+         */
+        for (i = 0; i < NUM_PUBS; ++i) {
+            DPS_RetainedIndexRemove(&index, &pubs[i]);
+        }
+        ASSERT(index.count == 0);
+        ASSERT(index.incomplete);
+        DPS_RetainedIndexRemove(&index, &unindexed);
+        ASSERT(!index.incomplete);
+        /*
+         * Refill and query the index again
+         */
+        for (i = 0; i < NUM_PUBS; ++i) {
+            ret = DPS_RetainedIndexAdd(&index, &pubs[i]);
+            ASSERT(ret == DPS_OK);
+        }
+        ASSERT(!index.incomplete);
+        ASSERT(CheckMatch(&index, sub, 0));
+        for (i = 0; i < NUM_PUBS; ++i) {
+            DPS_RetainedIndexRemove(&index, &pubs[i]);
+        }
+        ASSERT(index.count == 0);
+        DPS_BitVectorFree(unindexed.bf);
+    }
+
+    DPS_RetainedIndexFree(&index);
+    DPS_BitVectorFree(sub);
+    for (i = 0; i < NUM_PUBS; ++i) {
+        DPS_BitVectorFree(pubs[i].bf);
+    }
+    DPS_PRINT("Unit test passed\n");
+    return EXIT_SUCCESS;
+}
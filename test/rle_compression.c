@@ -20,6 +20,7 @@
  *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
  */
 
+#include <uv.h>
 #include "test.h"
 #include "bitvec.h"
 
@@ -31,6 +32,50 @@ static const double Report[] = {
     -1.0, 0.0, 0.1, 0.2, 0.5, 1.0, 2.0, 5.0, 10.0, 15.0, 20.0, 30.0, 50.0, 70.0, 80.0, 95.0, 97.0, 98.0, 99.0, 100.0
 };
 
+/*
+ * Checks the serialized bit vector decodes to the original and reports
+ * the encode and decode throughput over the requested number of iterations.
+ */
+static void Benchmark(DPS_BitVector* bf, size_t filterBits, int iterations)
+{
+    DPS_Status ret;
+    DPS_BitVector* out = DPS_BitVectorAlloc();
+    size_t bufLen = DPS_BitVectorSerializeMaxSize(bf);
+    uint8_t* buf = malloc(bufLen);
+    DPS_TxBuffer txBuf;
+    DPS_RxBuffer rxBuf;
+    uint64_t encodeNs = 0;
+    uint64_t decodeNs = 0;
+    uint64_t start;
+    size_t encLen = 0;
+    int i;
+
+    ASSERT(out && buf);
+    for (i = 0; i < iterations; ++i) {
+        DPS_TxBufferInit(&txBuf, buf, bufLen);
+        start = uv_hrtime();
+        ret = DPS_BitVectorSerialize(bf, &txBuf);
+        encodeNs += uv_hrtime() - start;
+        ASSERT(ret == DPS_OK);
+        encLen = DPS_TxBufferUsed(&txBuf);
+
+        DPS_TxBufferToRx(&txBuf, &rxBuf);
+        start = uv_hrtime();
+        ret = DPS_BitVectorDeserialize(out, &rxBuf);
+        decodeNs += uv_hrtime() - start;
+        ASSERT(ret == DPS_OK);
+    }
+    ASSERT(DPS_BitVectorEquals(bf, out));
+    if (iterations) {
+        DPS_PRINT("    serialized %zu/%zu bytes, encode %.0f ns (%.1f MB/s), decode %.0f ns (%.1f MB/s)\n",
+                  encLen, filterBits / 8,
+                  (double)encodeNs / iterations, (filterBits / 8.0) * iterations * 1000.0 / (encodeNs + 1),
+                  (double)decodeNs / iterations, (filterBits / 8.0) * iterations * 1000.0 / (decodeNs + 1));
+    }
+    free(buf);
+    DPS_BitVectorFree(out);
+}
+
 int main(int argc, char** argv)
 {
     DPS_Status ret;
@@ -40,6 +85,7 @@ int main(int argc, char** argv)
     size_t filterBits = 4096;
     size_t numHashes = 4;
     size_t report = 0;
+    int iterations = 100;
     const size_t base = 0xa1c46f01;
 
     DPS_Debug = DPS_FALSE;
@@ -67,6 +113,9 @@ int main(int argc, char** argv)
             }
             continue;
         }
+        if (IntArg("-i", &arg, &argc, &iterations, 0, INT32_MAX)) {
+            continue;
+        }
         if (strcmp(*arg, "-d") == 0) {
             ++arg;
             DPS_Debug = DPS_TRUE;
@@ -87,6 +136,7 @@ int main(int argc, char** argv)
         if (load > Report[report]) {
             DPS_PRINT("Added %d: ", (int)(i - base));
             DPS_BitVectorDump(bf, 0);
+            Benchmark(bf, filterBits, iterations);
             load = Report[report];
             ++report;
         }
@@ -98,12 +148,13 @@ int main(int argc, char** argv)
 
     DPS_PRINT("Added %d: ", (int)(i - base));
     DPS_BitVectorDump(bf, 0);
+    Benchmark(bf, filterBits, iterations);
     DPS_BitVectorFree(bf);
 
     return EXIT_SUCCESS;
 
 Usage:
 
-    DPS_PRINT("Usage %s: [-d] [-b <filter-bits>] [-n <num-hashes>]\n", argv[0]);
+    DPS_PRINT("Usage %s: [-d] [-b <filter-bits>] [-n <num-hashes>] [-i <iterations>]\n", argv[0]);
     return EXIT_FAILURE;
 }
@@ -0,0 +1,507 @@
+/*
+ *******************************************************************
+ *
+ * Copyright 2016 Intel Corporation All rights reserved.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ */
+
+/*
+ * Runs a mesh of nodes over the simulated network (build with
+ * transport=sim) and measures how subscriptions propagate and how
+ * publications are forwarded. The mesh is read from a mesh file (see
+ * test/meshes) or generated by linking each node to random earlier
+ * nodes. Subscribers and publishers are picked with a seeded generator
+ * so runs with the same arguments are repeatable. Times are virtual
+ * and the results are printed as a single JSON object.
+ */
+
+#include <uv.h>
+#include <dps/private/sim.h>
+#include "test.h"
+#include "mesh.h"
+#include "node.h"
+
+#define MAX_NODES    (UINT16_MAX - 1)
+#define MAX_TOPIC    32
+
+static DPS_Node** Nodes;
+static int NumNodes;
+static MeshLink* Links;
+static int NumLinks;
+
+static uv_mutex_t lock;
+static uv_cond_t cond;
+static int LinksUp;
+static int LinksFailed;
+static int NodesDestroyed;
+static uint64_t Delivered;
+static uint64_t LastDelivery;
+
+static uint32_t NextRand(uint32_t* seed)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return *seed >> 16;
+}
+
+/*
+ * Links each node to up to degree random earlier nodes so the mesh is
+ * connected and has loops when the degree is more than 1
+ */
+static int GenerateLinks(int numNodes, int degree, uint32_t* seed)
+{
+    int i;
+    int j;
+
+    for (i = 1; i < numNodes; ++i) {
+        for (j = 0; j < degree && j < i; ++j) {
+            if (!AddMeshLink(&Links, i, NextRand(seed) % i)) {
+                return 0;
+            }
+        }
+    }
+    return numNodes;
+}
+
+/*
+ * Reads a mesh file, the node ids are mapped to indexes in the order
+ * they first appear
+ */
+static int ReadLinks(const char* fn)
+{
+    static uint16_t idMap[UINT16_MAX];
+    uint16_t* ids;
+    MeshLink* l;
+    int numIds;
+    int i;
+
+    ids = calloc(MAX_NODES, sizeof(uint16_t));
+    if (!ids) {
+        return 0;
+    }
+    numIds = ReadMeshLinks(fn, &Links, ids, MAX_NODES);
+    for (i = 0; i < numIds; ++i) {
+        idMap[ids[i]] = (uint16_t)i;
+    }
+    for (l = Links; l != NULL; l = l->next) {
+        l->src = idMap[l->src];
+        l->dst = idMap[l->dst];
+    }
+    free(ids);
+    return numIds;
+}
+
+static void OnPub(DPS_Subscription* sub, const DPS_Publication* pub, uint8_t* data, size_t len)
+{
+    uint64_t now = DPS_SimNow();
+
+    uv_mutex_lock(&lock);
+    ++Delivered;
+    if (now > LastDelivery) {
+        LastDelivery = now;
+    }
+    uv_mutex_unlock(&lock);
+}
+
+static void OnLinked(DPS_Node* node, DPS_NodeAddress* addr, DPS_Status status, void* data)
+{
+    uv_mutex_lock(&lock);
+    if (status == DPS_OK) {
+        ++LinksUp;
+    } else {
+        DPS_ERRPRINT("Failed to Link to %s - %s\n", DPS_NodeAddrToString(addr), DPS_ErrTxt(status));
+        ++LinksFailed;
+    }
+    uv_cond_signal(&cond);
+    uv_mutex_unlock(&lock);
+}
+
+static void OnNodeDestroyed(DPS_Node* node, void* data)
+{
+    uv_mutex_lock(&lock);
+    ++NodesDestroyed;
+    uv_cond_signal(&cond);
+    uv_mutex_unlock(&lock);
+}
+
+static void GetNodeStats(DPS_SimStats* stats)
+{
+    int i;
+
+    for (i = 0; i < NumNodes; ++i) {
+        DPS_SimGetStats(i + 1, &stats[i]);
+    }
+}
+
+static uint64_t SumStats(const uint64_t* counts)
+{
+    uint64_t sum = 0;
+    int i;
+
+    for (i = 0; i < DPS_SIM_MSG_TYPES; ++i) {
+        sum += counts[i];
+    }
+    return sum;
+}
+
+int main(int argc, char** argv)
+{
+    DPS_Status ret;
+    char** arg = argv + 1;
+    const char* inFn = NULL;
+    DPS_SimLink link;
+    MeshLink* l;
+    DPS_SimStats start;
+    DPS_SimStats linked;
+    DPS_SimStats subscribed;
+    DPS_SimStats published;
+    DPS_SimStats* before = NULL;
+    DPS_SimStats* after = NULL;
+    char (*topics)[MAX_TOPIC] = NULL;
+    int* subTopic = NULL;
+    int* topicSubs = NULL;
+    DPS_Subscription** subs = NULL;
+    uint64_t linkUs;
+    uint64_t subsUs;
+    uint64_t t0;
+    uint64_t latencyUs = 0;
+    uint64_t maxLatencyUs = 0;
+    uint64_t expected = 0;
+    uint64_t pubRx = 0;
+    uint64_t dupRx = 0;
+    uint64_t deadEnds = 0;
+    uint64_t forwarders = 0;
+    DPS_BloomStats bloom;
+    uint64_t bloomMatches = 0;
+    uint64_t bloomFalsePositives = 0;
+    double loadSum = 0.0;
+    uint64_t loadSamples = 0;
+    float loadPeak = 0.0f;
+    uint32_t seed;
+    int numNodes = 1000;
+    int degree = 2;
+    int numSubs = 100;
+    int numTopics = 10;
+    int numPubs = 20;
+    int latency = 1000;
+    int jitter = 0;
+    int loss = 0;
+    int bandwidth = 0;
+    int quiet = 0;
+    int subsRate = 20;
+    int filterBits = 8192;
+    int numHashes = 3;
+    int settle;
+    int seedArg = 1;
+    int i;
+    int j;
+
+    DPS_Debug = DPS_FALSE;
+    while (--argc) {
+        if (strcmp(*arg, "-f") == 0 && argc > 1) {
+            ++arg;
+            --argc;
+            inFn = *arg++;
+            continue;
+        }
+        if (IntArg("-n", &arg, &argc, &numNodes, 2, MAX_NODES)) {
+            continue;
+        }
+        if (IntArg("-k", &arg, &argc, &degree, 1, 64)) {
+            continue;
+        }
+        if (IntArg("-s", &arg, &argc, &numSubs, 1, MAX_NODES)) {
+            continue;
+        }
+        if (IntArg("-t", &arg, &argc, &numTopics, 1, 100000)) {
+            continue;
+        }
+        if (IntArg("-p", &arg, &argc, &numPubs, 1, 100000)) {
+            continue;
+        }
+        if (IntArg("-L", &arg, &argc, &latency, 0, INT32_MAX)) {
+            continue;
+        }
+        if (IntArg("-j", &arg, &argc, &jitter, 0, INT32_MAX)) {
+            continue;
+        }
+        if (IntArg("-x", &arg, &argc, &loss, 0, 1000000)) {
+            continue;
+        }
+        if (IntArg("-b", &arg, &argc, &bandwidth, 0, INT32_MAX)) {
+            continue;
+        }
+        if (IntArg("-q", &arg, &argc, &quiet, 0, 1000000)) {
+            continue;
+        }
+        if (IntArg("-r", &arg, &argc, &subsRate, 0, 10000)) {
+            continue;
+        }
+        if (IntArg("-S", &arg, &argc, &seedArg, 0, INT32_MAX)) {
+            continue;
+        }
+        if (IntArg("-m", &arg, &argc, &filterBits, 64, 64 * 1024)) {
+            continue;
+        }
+        if (IntArg("-H", &arg, &argc, &numHashes, 1, 8)) {
+            continue;
+        }
+        if (strcmp(*arg, "-d") == 0) {
+            ++arg;
+            DPS_Debug = DPS_TRUE;
+            continue;
+        }
+        goto Usage;
+    }
+    /*
+     * Updates held back by the subscription update delay must be sent
+     * before the network is considered idle
+     */
+    settle = 2 * subsRate + 10;
+    ret = DPS_Configure(filterBits, numHashes);
+    if (ret != DPS_OK) {
+        goto Usage;
+    }
+    seed = (uint32_t)seedArg;
+    NumNodes = inFn ? ReadLinks(inFn) : GenerateLinks(numNodes, degree, &seed);
+    if (NumNodes == 0) {
+        return EXIT_FAILURE;
+    }
+    for (l = Links; l != NULL; l = l->next) {
+        ++NumLinks;
+    }
+    if (numSubs > NumNodes) {
+        numSubs = NumNodes;
+    }
+
+    uv_mutex_init(&lock);
+    uv_cond_init(&cond);
+    link.latency = latency;
+    link.jitter = jitter;
+    link.loss = loss;
+    link.bandwidth = bandwidth;
+    ret = DPS_SimConfigure(seedArg, &link, quiet, 0);
+    ASSERT(ret == DPS_OK);
+
+    Nodes = calloc(NumNodes, sizeof(DPS_Node*));
+    before = calloc(NumNodes, sizeof(DPS_SimStats));
+    after = calloc(NumNodes, sizeof(DPS_SimStats));
+    topics = calloc(numTopics, MAX_TOPIC);
+    topicSubs = calloc(numTopics, sizeof(int));
+    subTopic = calloc(NumNodes, sizeof(int));
+    subs = calloc(numSubs, sizeof(DPS_Subscription*));
+    if (!Nodes || !before || !after || !topics || !topicSubs || !subTopic || !subs) {
+        DPS_ERRPRINT("Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    for (i = 0; i < numTopics; ++i) {
+        snprintf(topics[i], MAX_TOPIC, "sim/topic/%d", i);
+    }
+    /*
+     * Node i listens on simulated port i + 1
+     */
+    for (i = 0; i < NumNodes; ++i) {
+        DPS_NodeAddress* listenAddr = DPS_CreateAddress();
+        char addrStr[32];
+
+        Nodes[i] = DPS_CreateNode("/", NULL, NULL);
+        ASSERT(Nodes[i] && listenAddr);
+        DPS_SetNodeSubscriptionUpdateDelay(Nodes[i], subsRate);
+        snprintf(addrStr, sizeof(addrStr), "[::1]:%d", i + 1);
+        DPS_SetAddress(listenAddr, addrStr);
+        ret = DPS_StartNode(Nodes[i], DPS_MCAST_PUB_DISABLED, listenAddr);
+        DPS_DestroyAddress(listenAddr);
+        if (ret != DPS_OK) {
+            DPS_ERRPRINT("Failed to start node %d: %s\n", i, DPS_ErrTxt(ret));
+            return EXIT_FAILURE;
+        }
+    }
+    /*
+     * Link the nodes and wait until the network is quiescent
+     */
+    DPS_SimGetStats(0, &start);
+    t0 = DPS_SimNow();
+    for (l = Links; l != NULL; l = l->next) {
+        ret = DPS_Link(Nodes[l->src], DPS_GetListenAddressString(Nodes[l->dst]), OnLinked, NULL);
+        if (ret != DPS_OK) {
+            DPS_ERRPRINT("DPS_Link returned %s\n", DPS_ErrTxt(ret));
+            return EXIT_FAILURE;
+        }
+    }
+    uv_mutex_lock(&lock);
+    while ((LinksUp + LinksFailed) < NumLinks) {
+        uv_cond_wait(&cond, &lock);
+    }
+    uv_mutex_unlock(&lock);
+    if (LinksFailed) {
+        DPS_ERRPRINT("%d links failed\n", LinksFailed);
+        return EXIT_FAILURE;
+    }
+    ret = DPS_SimWaitIdle(settle, 60000);
+    ASSERT(ret == DPS_OK);
+    linkUs = DPS_SimNow() - t0;
+    DPS_SimGetStats(0, &linked);
+    /*
+     * Subscribe to a random topic on random nodes, subscription
+     * propagation is the virtual time until the network is quiescent
+     */
+    for (i = 0; i < NumNodes; ++i) {
+        subTopic[i] = -1;
+    }
+    t0 = DPS_SimNow();
+    for (i = 0; i < numSubs; ++i) {
+        const char* topic;
+        int n;
+        do {
+            n = NextRand(&seed) % NumNodes;
+        } while (subTopic[n] >= 0);
+        subTopic[n] = NextRand(&seed) % numTopics;
+        ++topicSubs[subTopic[n]];
+        topic = topics[subTopic[n]];
+        subs[i] = DPS_CreateSubscription(Nodes[n], &topic, 1);
+        ASSERT(subs[i]);
+        ret = DPS_Subscribe(subs[i], OnPub);
+        ASSERT(ret == DPS_OK);
+    }
+    ret = DPS_SimWaitIdle(settle, 60000);
+    ASSERT(ret == DPS_OK);
+    subsUs = DPS_SimNow() - t0;
+    DPS_SimGetStats(0, &subscribed);
+    /*
+     * Publish one at a time from random nodes. A node that receives a
+     * publication but neither has a matching subscription nor forwards it
+     * was sent it because of a false positive match in the interests of
+     * the sender.
+     */
+    for (i = 0; i < numPubs; ++i) {
+        const char* topic;
+        DPS_Publication* pub;
+        int pubNode = NextRand(&seed) % NumNodes;
+        int t = NextRand(&seed) % numTopics;
+
+        topic = topics[t];
+        pub = DPS_CreatePublication(Nodes[pubNode]);
+        ASSERT(pub);
+        ret = DPS_InitPublication(pub, &topic, 1, DPS_FALSE, NULL, NULL);
+        ASSERT(ret == DPS_OK);
+        GetNodeStats(before);
+        uv_mutex_lock(&lock);
+        LastDelivery = 0;
+        uv_mutex_unlock(&lock);
+        t0 = DPS_SimNow();
+        ret = DPS_Publish(pub, NULL, 0, 0);
+        ASSERT(ret == DPS_OK);
+        ret = DPS_SimWaitIdle(settle, 60000);
+        ASSERT(ret == DPS_OK);
+        GetNodeStats(after);
+        expected += topicSubs[t];
+        uv_mutex_lock(&lock);
+        if (LastDelivery > t0) {
+            latencyUs += LastDelivery - t0;
+            if ((LastDelivery - t0) > maxLatencyUs) {
+                maxLatencyUs = LastDelivery - t0;
+            }
+        }
+        uv_mutex_unlock(&lock);
+        for (j = 0; j < NumNodes; ++j) {
+            uint64_t rx = after[j].received[DPS_MSG_TYPE_PUB] - before[j].received[DPS_MSG_TYPE_PUB];
+            uint64_t tx = after[j].sent[DPS_MSG_TYPE_PUB] - before[j].sent[DPS_MSG_TYPE_PUB];
+            if (!rx) {
+                continue;
+            }
+            pubRx += rx;
+            dupRx += rx - 1;
+            if (tx) {
+                ++forwarders;
+            } else if (subTopic[j] != t) {
+                ++deadEnds;
+            }
+        }
+        DPS_DestroyPublication(pub);
+    }
+    DPS_SimGetStats(0, &published);
+    /*
+     * The load factor of the interests received by each node over the
+     * whole run shows how full the Bloom filters got
+     */
+    for (i = 0; i < NumNodes; ++i) {
+        ret = DPS_GetBloomStats(Nodes[i], NULL, &bloom);
+        ASSERT(ret == DPS_OK);
+        bloomMatches += bloom.bloomMatches;
+        bloomFalsePositives += bloom.falsePositives;
+        loadSum += (double)bloom.inbound.mean * bloom.inbound.samples;
+        loadSamples += bloom.inbound.samples;
+        if (bloom.inbound.peak > loadPeak) {
+            loadPeak = bloom.inbound.peak;
+        }
+    }
+
+    printf("{\"suite\":\"sim\",\"mesh\":\"%s\",\"nodes\":%d,\"links\":%d,\"subscribers\":%d,\"topics\":%d,"
+           "\"pubs\":%d,\"latency_us\":%d,\"jitter_us\":%d,\"loss_ppm\":%d,\"bandwidth_kbps\":%d,\"seed\":%d,"
+           "\"filter_bits\":%d,\"hashes\":%d,",
+           inFn ? inFn : "generated", NumNodes, NumLinks, numSubs, numTopics, numPubs, latency, jitter, loss,
+           bandwidth, seedArg, filterBits, numHashes);
+    printf("\"link_us\":%llu,\"link_msgs\":%llu,\"subs_us\":%llu,\"subs_msgs\":%llu,\"subs_bytes\":%llu,",
+           (unsigned long long)linkUs,
+           (unsigned long long)(SumStats(linked.sent) - SumStats(start.sent)),
+           (unsigned long long)subsUs,
+           (unsigned long long)(subscribed.sent[DPS_MSG_TYPE_SUB] - linked.sent[DPS_MSG_TYPE_SUB]),
+           (unsigned long long)(subscribed.sentBytes[DPS_MSG_TYPE_SUB] - linked.sentBytes[DPS_MSG_TYPE_SUB]));
+    printf("\"delivered\":%llu,\"expected\":%llu,\"pub_latency_avg_us\":%.1f,\"pub_latency_max_us\":%llu,",
+           (unsigned long long)Delivered, (unsigned long long)expected, (double)latencyUs / numPubs,
+           (unsigned long long)maxLatencyUs);
+    printf("\"bloom_matches\":%llu,\"bloom_false_positives\":%llu,\"inbound_load_mean\":%.2f,"
+           "\"inbound_load_peak\":%.2f,",
+           (unsigned long long)bloomMatches, (unsigned long long)bloomFalsePositives,
+           loadSamples ? loadSum / loadSamples : 0.0, (double)loadPeak);
+    printf("\"pub_msgs\":%llu,\"pub_bytes\":%llu,\"pub_receptions\":%llu,\"duplicates\":%llu,"
+           "\"forwarders\":%llu,\"false_positive_forwards\":%llu,\"lost\":%llu}\n",
+           (unsigned long long)(published.sent[DPS_MSG_TYPE_PUB] - subscribed.sent[DPS_MSG_TYPE_PUB]),
+           (unsigned long long)(published.sentBytes[DPS_MSG_TYPE_PUB] - subscribed.sentBytes[DPS_MSG_TYPE_PUB]),
+           (unsigned long long)pubRx, (unsigned long long)dupRx, (unsigned long long)forwarders,
+           (unsigned long long)deadEnds, (unsigned long long)(published.lost - start.lost));
+    fflush(stdout);
+    /*
+     * Cleanup
+     */
+    for (i = 0; i < numSubs; ++i) {
+        DPS_DestroySubscription(subs[i]);
+    }
+    for (i = 0; i < NumNodes; ++i) {
+        DPS_DestroyNode(Nodes[i], OnNodeDestroyed, NULL);
+    }
+    uv_mutex_lock(&lock);
+    while (NodesDestroyed < NumNodes) {
+        uv_cond_wait(&cond, &lock);
+    }
+    uv_mutex_unlock(&lock);
+    free(subs);
+    free(subTopic);
+    free(topicSubs);
+    free(topics);
+    free(after);
+    free(before);
+    free(Nodes);
+    FreeMeshLinks(Links);
+    return EXIT_SUCCESS;
+
+Usage:
+    DPS_PRINT("Usage %s: [-d] [-n <nodes>] [-k <links-per-node>] [-f <mesh-file>] [-s <subscribers>] [-t <topics>]\n"
+              "    [-p <pubs>] [-L <latency-usecs>] [-j <jitter-usecs>] [-x <loss-ppm>] [-b <bandwidth-kbps>]\n"
+              "    [-q <quiet-usecs>] [-r <subs-rate-msecs>] [-S <seed>] [-m <filter-bits>] [-H <hashes>]\n", argv[0]);
+    return EXIT_FAILURE;
+}
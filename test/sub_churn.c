@@ -0,0 +1,293 @@
+/*
+ *******************************************************************
+ *
+ * Copyright 2016 Intel Corporation All rights reserved.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ */
+
+/*
+ * Subscription churn benchmark. Builds a mesh from a link file (see
+ * mesh_stress), then subscribes and unsubscribes as fast as possible on
+ * random nodes to simulate a mass reconnect. Reports the number of
+ * subscription messages sent during the churn and the time taken for
+ * the mesh to go quiet, then checks that publications reach every
+ * remaining subscription.
+ */
+
+#include "test.h"
+#include "mesh.h"
+#include "node.h"
+
+#define MAX_NODES   256
+#define MAX_TOPICS  26
+
+/*
+ * Maps node id's to DPS nodes
+ */
+static DPS_Node* NodeMap[UINT16_MAX];
+
+/*
+ * List of node id's from the input file
+ */
+static uint16_t NodeList[MAX_NODES];
+
+/*
+ * Subscriptions indexed by position in the node list and topic
+ */
+static DPS_Subscription* Subs[MAX_NODES][MAX_TOPICS];
+
+static MeshLink* links = NULL;
+
+static uv_mutex_t lock;
+static int LinksUp;
+static int LinksFailed;
+static int Matches;
+
+static void OnPubMatch(DPS_Subscription* sub, const DPS_Publication* pub, uint8_t* data, size_t len)
+{
+    uv_mutex_lock(&lock);
+    ++Matches;
+    uv_mutex_unlock(&lock);
+}
+
+static void OnLinked(DPS_Node* node, DPS_NodeAddress* addr, DPS_Status status, void* data)
+{
+    uv_mutex_lock(&lock);
+    if (status == DPS_OK) {
+        ++LinksUp;
+    } else {
+        DPS_ERRPRINT("Failed to Link to %s - %s\n", DPS_NodeAddrToString(addr), DPS_ErrTxt(status));
+        ++LinksFailed;
+    }
+    uv_mutex_unlock(&lock);
+}
+
+static void OnNodeDestroyed(DPS_Node* node, void* data)
+{
+}
+
+static int NumSubsSent(void)
+{
+#ifdef DPS_DEBUG
+    extern int _DPS_NumSubs;
+    return _DPS_NumSubs;
+#else
+    return 0;
+#endif
+}
+
+static DPS_Status Subscribe(int n, int t)
+{
+    DPS_Status ret;
+    char topic[2] = { (char)('A' + t), 0 };
+    const char* topicList[] = { topic };
+
+    Subs[n][t] = DPS_CreateSubscription(NodeMap[NodeList[n]], topicList, 1);
+    if (!Subs[n][t]) {
+        return DPS_ERR_RESOURCES;
+    }
+    ret = DPS_Subscribe(Subs[n][t], OnPubMatch);
+    if (ret != DPS_OK) {
+        DPS_DestroySubscription(Subs[n][t]);
+        Subs[n][t] = NULL;
+    }
+    return ret;
+}
+
+int main(int argc, char** argv)
+{
+    DPS_Status ret;
+    char** arg = argv + 1;
+    MeshLink* l;
+    DPS_Event* sleeper;
+    const char* inFn = NULL;
+    int numIds;
+    int numLinks = 0;
+    int numOps = 1000;
+    int numTopics = 8;
+    int subsRate = 100;
+    int duration = 0;
+    int sent;
+    int quiet;
+    int expected = 0;
+    int failed = 0;
+    uint64_t start;
+    uint64_t churnNs;
+    uint64_t settleNs;
+    int i;
+    int t;
+
+    DPS_Debug = DPS_FALSE;
+    while (--argc) {
+        if (IntArg("-n", &arg, &argc, &numOps, 1, INT32_MAX)) {
+            continue;
+        }
+        if (IntArg("-t", &arg, &argc, &numTopics, 1, MAX_TOPICS)) {
+            continue;
+        }
+        if (IntArg("-r", &arg, &argc, &subsRate, 1, 10000)) {
+            continue;
+        }
+        if (IntArg("-s", &arg, &argc, &duration, 0, 3600)) {
+            continue;
+        }
+        if (strcmp(*arg, "-d") == 0) {
+            ++arg;
+            DPS_Debug = DPS_TRUE;
+            continue;
+        }
+        if (*arg[0] == '-') {
+            goto Usage;
+        }
+        inFn = *arg++;
+    }
+    if (!inFn) {
+        goto Usage;
+    }
+    numIds = ReadMeshLinks(inFn, &links, NodeList, MAX_NODES);
+    if (numIds == 0) {
+        return EXIT_FAILURE;
+    }
+    sleeper = DPS_CreateEvent();
+    uv_mutex_init(&lock);
+
+    for (i = 0; i < numIds; ++i) {
+        DPS_NodeAddress* listenAddr = DPS_CreateAddress();
+        DPS_Node* node = DPS_CreateNode("/.", NULL, NULL);
+
+        ASSERT(listenAddr && node);
+        DPS_SetNodeSubscriptionUpdateDelay(node, subsRate);
+        DPS_SetAddress(listenAddr, "[::1]:0");
+        ret = DPS_StartNode(node, DPS_FALSE, listenAddr);
+        DPS_DestroyAddress(listenAddr);
+        if (ret != DPS_OK) {
+            DPS_ERRPRINT("Failed to start node: %s\n", DPS_ErrTxt(ret));
+            return EXIT_FAILURE;
+        }
+        NodeMap[NodeList[i]] = node;
+    }
+    for (l = links; l != NULL; l = l->next) {
+        ret = DPS_Link(NodeMap[l->src], DPS_GetListenAddressString(NodeMap[l->dst]), OnLinked, NULL);
+        if (ret != DPS_OK) {
+            DPS_ERRPRINT("DPS_Link returned %s\n", DPS_ErrTxt(ret));
+            return EXIT_FAILURE;
+        }
+        ++numLinks;
+    }
+    uv_mutex_lock(&lock);
+    while ((LinksUp + LinksFailed) < numLinks) {
+        uv_mutex_unlock(&lock);
+        DPS_TimedWaitForEvent(sleeper, 100);
+        uv_mutex_lock(&lock);
+    }
+    uv_mutex_unlock(&lock);
+    DPS_PRINT("%d nodes %d links up %d links failed\n", numIds, LinksUp, LinksFailed);
+    if (LinksFailed) {
+        return EXIT_FAILURE;
+    }
+    DPS_TimedWaitForEvent(sleeper, 1000);
+
+    /*
+     * Churn the subscriptions
+     */
+    sent = NumSubsSent();
+    start = uv_hrtime();
+    for (i = 0; i < numOps; ++i) {
+        int n = DPS_Rand() % numIds;
+        /*
+         * Spread the operations over the duration in 10 msec steps
+         */
+        if (duration && i && ((i % (numOps / (duration * 100) + 1)) == 0)) {
+            DPS_TimedWaitForEvent(sleeper, 10);
+        }
+        t = DPS_Rand() % numTopics;
+        if (Subs[n][t]) {
+            DPS_DestroySubscription(Subs[n][t]);
+            Subs[n][t] = NULL;
+        } else {
+            ret = Subscribe(n, t);
+            if (ret != DPS_OK) {
+                DPS_ERRPRINT("Subscribe failed %s\n", DPS_ErrTxt(ret));
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    churnNs = uv_hrtime() - start;
+    /*
+     * Wait for the subscription updates to stop
+     */
+    for (quiet = 0; quiet < 10; ) {
+        int prev = NumSubsSent();
+        DPS_TimedWaitForEvent(sleeper, (uint16_t)subsRate);
+        quiet = (NumSubsSent() == prev) ? quiet + 1 : 0;
+    }
+    settleNs = uv_hrtime() - start - 10 * (uint64_t)subsRate * 1000000ull;
+    DPS_PRINT("%d churn operations in %.1f msecs\n", numOps, churnNs / 1.0e6);
+    DPS_PRINT("Settled in %.1f msecs\n", settleNs / 1.0e6);
+    DPS_PRINT("Sent %d subs\n", NumSubsSent() - sent);
+
+    /*
+     * Check each topic is delivered to all the remaining subscriptions
+     */
+    for (t = 0; t < numTopics; ++t) {
+        char topic[2] = { (char)('A' + t), 0 };
+        const char* topicList[] = { topic };
+        DPS_Publication* pub = DPS_CreatePublication(NodeMap[NodeList[DPS_Rand() % numIds]]);
+        int subs = 0;
+
+        for (i = 0; i < numIds; ++i) {
+            if (Subs[i][t]) {
+                ++subs;
+            }
+        }
+        uv_mutex_lock(&lock);
+        Matches = 0;
+        uv_mutex_unlock(&lock);
+        ASSERT(pub);
+        ret = DPS_InitPublication(pub, topicList, 1, DPS_FALSE, NULL, NULL);
+        ASSERT(ret == DPS_OK);
+        ret = DPS_Publish(pub, NULL, 0, 0);
+        ASSERT(ret == DPS_OK);
+        DPS_TimedWaitForEvent(sleeper, 500);
+        uv_mutex_lock(&lock);
+        if (Matches != subs) {
+            DPS_ERRPRINT("Topic %s expected %d matches got %d\n", topic, subs, Matches);
+            ++failed;
+        }
+        uv_mutex_unlock(&lock);
+        expected += subs;
+        DPS_DestroyPublication(pub);
+    }
+    DPS_PRINT("%d subscriptions %d topics failed\n", expected, failed);
+
+    for (i = 0; i < numIds; ++i) {
+        DPS_DestroyNode(NodeMap[NodeList[i]], OnNodeDestroyed, NULL);
+    }
+    DPS_TimedWaitForEvent(sleeper, 500);
+    DPS_DestroyEvent(sleeper);
+    FreeMeshLinks(links);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+
+Usage:
+    DPS_PRINT("Usage %s: [-d] [-n <churn-ops>] [-s <secs>] [-t <num-topics>] [-r <subs-rate>] <link-file>\n", argv[0]);
+    DPS_PRINT("       -n: Number of subscribe or unsubscribe operations.\n");
+    DPS_PRINT("       -s: Spread the operations over this many seconds, default is a single burst.\n");
+    DPS_PRINT("       -t: Number of distinct topics to subscribe to.\n");
+    DPS_PRINT("       -r: Subscription update delay in msecs.\n");
+    return EXIT_FAILURE;
+}
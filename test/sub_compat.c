@@ -0,0 +1,215 @@
+/*
+*******************************************************************
+*
+* Copyright 2018 Intel Corporation All rights reserved.
+*
+*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+
+/*
+ * Checks that the subscriptions sent by a node can be parsed by nodes
+ * built before the bit length and number of hashes were added to the
+ * subscription exchange.
+ */
+
+#include <uv.h>
+#include "test.h"
+#include "bitvec.h"
+#include "node.h"
+
+#define A_SIZEOF(a)  (sizeof(a) / sizeof((a)[0]))
+
+#if defined(DPS_USE_UDP)
+
+#define MAX_MSG_LEN  4096
+
+typedef struct _Capture {
+    uv_udp_t udp;
+    uv_timer_t timer;
+    uint8_t alloc[MAX_MSG_LEN];
+    uint8_t msg[MAX_MSG_LEN];
+    size_t len;
+} Capture;
+
+static void AllocBuffer(uv_handle_t* handle, size_t suggestedSize, uv_buf_t* buf)
+{
+    Capture* capture = (Capture*)handle->data;
+    buf->base = (char*)capture->alloc;
+    buf->len = sizeof(capture->alloc);
+}
+
+static void OnData(uv_udp_t* udp, ssize_t nread, const uv_buf_t* buf, const struct sockaddr* addr,
+                   unsigned flags)
+{
+    Capture* capture = (Capture*)udp->data;
+
+    /*
+     * Keep the first subscription, the version and type follow the array header
+     */
+    if ((nread > 3) && !capture->len && (buf->base[2] == DPS_MSG_TYPE_SUB)) {
+        memcpy(capture->msg, buf->base, nread);
+        capture->len = (size_t)nread;
+        uv_stop(udp->loop);
+    }
+}
+
+static void OnTimeout(uv_timer_t* timer)
+{
+    uv_stop(timer->loop);
+}
+
+static void OnLinked(DPS_Node* node, DPS_NodeAddress* addr, DPS_Status status, void* data)
+{
+}
+
+static void OnNodeDestroyed(DPS_Node* node, void* data)
+{
+    DPS_SignalEvent((DPS_Event*)data, DPS_OK);
+}
+
+/*
+ * Link a node to a UDP socket and capture the subscription it sends
+ */
+static void CaptureSubscription(Capture* capture)
+{
+    uv_loop_t loop;
+    struct sockaddr_in6 addr;
+    int addrLen = sizeof(addr);
+    char addrText[DPS_NODE_ADDRESS_MAX_STRING_LEN];
+    DPS_Event* event;
+    DPS_Node* node;
+    DPS_Status ret;
+    int r;
+
+    r = uv_loop_init(&loop);
+    ASSERT(r == 0);
+    r = uv_udp_init(&loop, &capture->udp);
+    ASSERT(r == 0);
+    capture->udp.data = capture;
+    r = uv_timer_init(&loop, &capture->timer);
+    ASSERT(r == 0);
+    r = uv_ip6_addr("::1", 0, &addr);
+    ASSERT(r == 0);
+    r = uv_udp_bind(&capture->udp, (const struct sockaddr*)&addr, 0);
+    ASSERT(r == 0);
+    r = uv_udp_getsockname(&capture->udp, (struct sockaddr*)&addr, &addrLen);
+    ASSERT(r == 0);
+    snprintf(addrText, sizeof(addrText), "[::1]:%d", ntohs(addr.sin6_port));
+    r = uv_udp_recv_start(&capture->udp, AllocBuffer, OnData);
+    ASSERT(r == 0);
+    r = uv_timer_start(&capture->timer, OnTimeout, 5000, 0);
+    ASSERT(r == 0);
+
+    event = DPS_CreateEvent();
+    ASSERT(event);
+    node = DPS_CreateNode("/.", NULL, NULL);
+    ASSERT(node);
+    ret = DPS_StartNode(node, DPS_MCAST_PUB_DISABLED, NULL);
+    ASSERT(ret == DPS_OK);
+    capture->len = 0;
+    ret = DPS_Link(node, addrText, OnLinked, NULL);
+    ASSERT(ret == DPS_OK);
+    uv_run(&loop, UV_RUN_DEFAULT);
+    DPS_DestroyNode(node, OnNodeDestroyed, event);
+    DPS_WaitForEvent(event);
+    DPS_DestroyEvent(event);
+
+    uv_close((uv_handle_t*)&capture->udp, NULL);
+    uv_close((uv_handle_t*)&capture->timer, NULL);
+    uv_run(&loop, UV_RUN_DEFAULT);
+    uv_loop_close(&loop);
+    ASSERT(capture->len);
+}
+
+/*
+ * Parse the unprotected map of a subscription the way a node built
+ * before this release does. It parsed with these key tables and
+ * decoded whatever key was last returned, so returning without a key
+ * would have made it decode a value with the wrong key.
+ */
+static void ParseBaseline(Capture* capture, int* numSkipped)
+{
+    static const int32_t NeedKeys[] = { DPS_CBOR_KEY_SEQ_NUM };
+    static const int32_t WantKeys[] = { DPS_CBOR_KEY_PORT, DPS_CBOR_KEY_SUB_FLAGS, DPS_CBOR_KEY_MESH_ID,
+                                        DPS_CBOR_KEY_NEEDS, DPS_CBOR_KEY_INTERESTS, DPS_CBOR_KEY_PATH };
+    DPS_RxBuffer rxBuf;
+    CBOR_MapState mapState;
+    size_t len;
+    uint8_t u8;
+    DPS_Status ret;
+
+    DPS_RxBufferInit(&rxBuf, capture->msg, capture->len);
+    ret = CBOR_DecodeArray(&rxBuf, &len);
+    ASSERT(ret == DPS_OK);
+    ret = CBOR_DecodeUint8(&rxBuf, &u8);
+    ASSERT((ret == DPS_OK) && (u8 == DPS_MSG_VERSION));
+    ret = CBOR_DecodeUint8(&rxBuf, &u8);
+    ASSERT((ret == DPS_OK) && (u8 == DPS_MSG_TYPE_SUB));
+    ret = DPS_ParseMapInit(&mapState, &rxBuf, NeedKeys, A_SIZEOF(NeedKeys), WantKeys, A_SIZEOF(WantKeys));
+    ASSERT(ret == DPS_OK);
+    *numSkipped = 0;
+    while (!DPS_ParseMapDone(&mapState)) {
+        int32_t key;
+        ret = DPS_ParseMapNext(&mapState, &key);
+        ASSERT(ret == DPS_OK);
+        if (key == 0) {
+            ++*numSkipped;
+            continue;
+        }
+        ret = CBOR_Skip(&rxBuf, NULL, NULL);
+        ASSERT(ret == DPS_OK);
+    }
+}
+
+#endif
+
+int main(int argc, char** argv)
+{
+#if defined(DPS_USE_UDP)
+    Capture* capture;
+    int numSkipped;
+    DPS_Status ret;
+
+    DPS_Debug = DPS_FALSE;
+    if ((argc > 1) && (strcmp(argv[1], "-d") == 0)) {
+        DPS_Debug = DPS_TRUE;
+    }
+    capture = calloc(1, sizeof(Capture));
+    ASSERT(capture);
+    /*
+     * Nodes with the default configuration must send subscriptions
+     * that older nodes can parse
+     */
+    CaptureSubscription(capture);
+    ParseBaseline(capture, &numSkipped);
+    ASSERT(numSkipped == 0);
+    /*
+     * Nodes with a different configuration send the bit length and
+     * number of hashes, older nodes could not have linked with them
+     */
+    ret = DPS_Configure(4096, 3);
+    ASSERT(ret == DPS_OK);
+    CaptureSubscription(capture);
+    ParseBaseline(capture, &numSkipped);
+    ASSERT(numSkipped == 1);
+
+    free(capture);
+#else
+    DPS_PRINT("Subscriptions are captured from the UDP transport, skipping\n");
+#endif
+    return EXIT_SUCCESS;
+}
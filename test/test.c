@@ -47,6 +47,27 @@ int IntArg(char* opt, char*** argp, int* argcp, int* val, int min, int max)
     return 1;
 }
 
+int StrArg(char* opt, char*** argp, int* argcp, const char** val)
+{
+    char** arg = *argp;
+    int argc = *argcp;
+
+    if (strcmp(*arg++, opt) != 0) {
+        return 0;
+    }
+    if (!--argc) {
+        return 0;
+    }
+    *val = *arg++;
+    if (**val == '-') {
+        DPS_PRINT("Value for option %s must be a string\n", opt);
+        return 0;
+    }
+    *argp = arg;
+    *argcp = argc;
+    return 1;
+}
+
 int AddressArg(char* opt, char*** argp, int* argcp, DPS_NodeAddress** addr)
 {
     char** arg = *argp;
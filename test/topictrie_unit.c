@@ -0,0 +1,238 @@
+/*
+ *******************************************************************
+ *
+ * Copyright 2016 Intel Corporation All rights reserved.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ */
+
+/*
+ * Unit test for the subscription topic trie, the trie must give the same
+ * results as DPS_MatchTopicList()
+ */
+#include "test.h"
+#include "sub.h"
+#include "topics.h"
+#include "topictrie.h"
+
+#define NUM_SUBS      500
+#define NUM_PUBS      2000
+#define MAX_TOPICS    3
+#define MAX_SEGMENTS  4
+#define MAX_TOPIC     64
+
+static const char separators[] = "/.";
+static const char* segments[] = { "a", "b", "cc", "" };
+
+static DPS_Subscription* subs[NUM_SUBS];
+static int subscribed[NUM_SUBS];
+
+/*
+ * Wildcards are only generated for subscriptions, empty segments are
+ * only generated between separators
+ */
+static void MakeTopic(char* topic, int wildcards)
+{
+    int n = 1 + rand() % MAX_SEGMENTS;
+    int i;
+
+    topic[0] = 0;
+    for (i = 0; i < n; ++i) {
+        const char* seg;
+        int r = rand() % 10;
+        if (i) {
+            size_t len = strlen(topic);
+            topic[len] = separators[rand() % 2];
+            topic[len + 1] = 0;
+        }
+        if (wildcards && r == 0) {
+            seg = "+";
+        } else if (wildcards && r == 1 && i == n - 1) {
+            seg = "#";
+        } else if (i == 0 || i == n - 1) {
+            seg = segments[rand() % (A_SIZEOF(segments) - 1)];
+        } else {
+            seg = segments[rand() % A_SIZEOF(segments)];
+        }
+        strcat_s(topic, MAX_TOPIC, seg);
+    }
+}
+
+static DPS_Subscription* CreateSub(void)
+{
+    DPS_BitVector* bf = DPS_BitVectorAlloc();
+    DPS_Subscription* sub;
+    size_t numTopics = 1 + rand() % MAX_TOPICS;
+    size_t i;
+
+    sub = calloc(1, sizeof(DPS_Subscription) + sizeof(char*) * (numTopics - 1));
+    ASSERT(sub && bf);
+    for (i = 0; i < numTopics; ++i) {
+        char topic[MAX_TOPIC];
+        MakeTopic(topic, DPS_TRUE);
+        ASSERT(DPS_AddTopic(bf, topic, separators, DPS_SubTopic) == DPS_OK);
+        sub->topics[i] = strdup(topic);
+        ASSERT(sub->topics[i]);
+        ++sub->numTopics;
+    }
+    DPS_BitVectorFree(bf);
+    return sub;
+}
+
+static void FreeSub(DPS_Subscription* sub)
+{
+    while (sub->numTopics) {
+        free(sub->topics[--sub->numTopics]);
+    }
+    free(sub);
+}
+
+static int CheckMatch(DPS_TopicTrie* trie, char** pubs, size_t numPubs)
+{
+    DPS_Status ret;
+    int i;
+
+    ret = DPS_TopicTrieMatch(trie, pubs, numPubs, separators);
+    if (ret != DPS_OK) {
+        DPS_PRINT("Trie match failed %s\n", DPS_ErrTxt(ret));
+        return DPS_FALSE;
+    }
+    for (i = 0; i < NUM_SUBS; ++i) {
+        int expect = DPS_FALSE;
+        int match;
+        if (subscribed[i]) {
+            ret = DPS_MatchTopicList(pubs, numPubs, subs[i]->topics, subs[i]->numTopics, separators, DPS_FALSE,
+                                     &expect);
+            if (ret != DPS_OK) {
+                expect = DPS_FALSE;
+            }
+        }
+        match = DPS_TopicTrieMatched(trie, subs[i]);
+        if (match != expect) {
+            size_t j;
+            DPS_PRINT("Subscription %d %s:", i, expect ? "did not match" : "matched");
+            for (j = 0; j < subs[i]->numTopics; ++j) {
+                DPS_PRINT(" %s", subs[i]->topics[j]);
+            }
+            DPS_PRINT("\nPublication:");
+            for (j = 0; j < numPubs; ++j) {
+                DPS_PRINT(" %s", pubs[j]);
+            }
+            DPS_PRINT("\n");
+            return DPS_FALSE;
+        }
+    }
+    return DPS_TRUE;
+}
+
+static int CheckPubs(DPS_TopicTrie* trie)
+{
+    char topics[MAX_TOPICS][MAX_TOPIC];
+    char* pubs[MAX_TOPICS];
+    int i;
+    int j;
+
+    for (i = 0; i < NUM_PUBS; ++i) {
+        int numPubs = 1 + rand() % MAX_TOPICS;
+        for (j = 0; j < numPubs; ++j) {
+            MakeTopic(topics[j], DPS_FALSE);
+            pubs[j] = topics[j];
+        }
+        if (!CheckMatch(trie, pubs, numPubs)) {
+            return DPS_FALSE;
+        }
+    }
+    return DPS_TRUE;
+}
+
+int main(int argc, char** argv)
+{
+    static const char* dupTopics[] = { "a/+", "a/+" };
+    static char* invalid[] = { "a/b", "a/+" };
+    DPS_TopicTrie trie;
+    DPS_Status ret;
+    int numMatched;
+    int i;
+
+    DPS_Debug = DPS_FALSE;
+    for (i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-d")) {
+            DPS_Debug = DPS_TRUE;
+        }
+    }
+    memset(&trie, 0, sizeof(trie));
+
+    for (i = 0; i < NUM_SUBS; ++i) {
+        subs[i] = CreateSub();
+        ret = DPS_TopicTrieAdd(&trie, subs[i], separators);
+        ASSERT(ret == DPS_OK);
+        subscribed[i] = DPS_TRUE;
+    }
+    /*
+     * A subscription can have the same topic more than once
+     */
+    DPS_TopicTrieRemove(&trie, subs[0], separators);
+    FreeSub(subs[0]);
+    subs[0] = calloc(1, sizeof(DPS_Subscription) + sizeof(char*));
+    ASSERT(subs[0]);
+    for (i = 0; i < (int)A_SIZEOF(dupTopics); ++i) {
+        subs[0]->topics[i] = strdup(dupTopics[i]);
+        ASSERT(subs[0]->topics[i]);
+        ++subs[0]->numTopics;
+    }
+    ret = DPS_TopicTrieAdd(&trie, subs[0], separators);
+    ASSERT(ret == DPS_OK);
+
+    DPS_PRINT("Match all subscriptions\n");
+    ASSERT(CheckPubs(&trie));
+    /*
+     * A publication with an invalid topic matches nothing
+     */
+    numMatched = 0;
+    ASSERT(CheckMatch(&trie, invalid, 1));
+    for (i = 0; i < NUM_SUBS; ++i) {
+        numMatched += DPS_TopicTrieMatched(&trie, subs[i]);
+    }
+    ASSERT(numMatched > 0);
+    ret = DPS_TopicTrieMatch(&trie, invalid, A_SIZEOF(invalid), separators);
+    ASSERT(ret == DPS_ERR_INVALID);
+    for (i = 0; i < NUM_SUBS; ++i) {
+        ASSERT(!DPS_TopicTrieMatched(&trie, subs[i]));
+    }
+
+    DPS_PRINT("Match after removing subscriptions\n");
+    for (i = 0; i < NUM_SUBS; i += 2) {
+        DPS_TopicTrieRemove(&trie, subs[i], separators);
+        subscribed[i] = DPS_FALSE;
+    }
+    ASSERT(CheckPubs(&trie));
+
+    DPS_PRINT("Remove remaining subscriptions\n");
+    for (i = 1; i < NUM_SUBS; i += 2) {
+        DPS_TopicTrieRemove(&trie, subs[i], separators);
+        subscribed[i] = DPS_FALSE;
+    }
+    ASSERT(trie.root == NULL);
+    ASSERT(CheckPubs(&trie));
+
+    DPS_TopicTrieFree(&trie);
+    for (i = 0; i < NUM_SUBS; ++i) {
+        FreeSub(subs[i]);
+    }
+    DPS_PRINT("Unit test passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,151 @@
+/*
+ *******************************************************************
+ *
+ * Copyright 2016 Intel Corporation All rights reserved.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ */
+
+/*
+ * Checks that UUIDs generated concurrently on several threads are
+ * distinct and measures the generation rate as threads are added.
+ * A shared generator behind a mutex is measured for comparison.
+ */
+
+#include <uv.h>
+#include "test.h"
+
+#define MAX_THREADS  16
+
+static int NumUUIDs = 200000;
+static DPS_UUID* uuids;
+static uv_mutex_t lock;
+static uint32_t seeds[4];
+
+/*
+ * Shared generator protected by a mutex for comparison
+ */
+#define LEPRNG(n)  (uint32_t)(((uint64_t)(n) * 279470273ull) % 4294967291ul)
+
+static void LockedGenerateUUID(DPS_UUID* uuid)
+{
+    uint32_t s0;
+
+    uv_mutex_lock(&lock);
+    s0 = seeds[0];
+    seeds[0] = LEPRNG(seeds[1]);
+    seeds[1] = LEPRNG(seeds[2]);
+    seeds[2] = LEPRNG(seeds[3]);
+    seeds[3] = LEPRNG(s0);
+    memcpy(uuid->val, seeds, sizeof(uuid->val));
+    uv_mutex_unlock(&lock);
+}
+
+typedef struct {
+    uv_thread_t thread;
+    DPS_UUID* uuids;
+    void (*generate)(DPS_UUID* uuid);
+} Worker;
+
+static void GenerateThread(void* arg)
+{
+    Worker* worker = arg;
+    int i;
+
+    for (i = 0; i < NumUUIDs; ++i) {
+        worker->generate(&worker->uuids[i]);
+    }
+}
+
+static int CompareUUIDs(const void* a, const void* b)
+{
+    return DPS_UUIDCompare((const DPS_UUID*)a, (const DPS_UUID*)b);
+}
+
+static uint64_t Run(int numThreads, void (*generate)(DPS_UUID* uuid))
+{
+    Worker workers[MAX_THREADS];
+    uint64_t start;
+    int i;
+    int r;
+
+    start = uv_hrtime();
+    for (i = 0; i < numThreads; ++i) {
+        workers[i].uuids = uuids + (size_t)i * NumUUIDs;
+        workers[i].generate = generate;
+        r = uv_thread_create(&workers[i].thread, GenerateThread, &workers[i]);
+        ASSERT(r == 0);
+    }
+    for (i = 0; i < numThreads; ++i) {
+        uv_thread_join(&workers[i].thread);
+    }
+    return uv_hrtime() - start;
+}
+
+int main(int argc, char** argv)
+{
+    DPS_Status ret;
+    char** arg = argv + 1;
+    int maxThreads = 8;
+    uint64_t ns;
+    uint64_t lockedNs;
+    size_t total;
+    size_t i;
+    int n;
+
+    DPS_Debug = DPS_FALSE;
+    while (--argc) {
+        if (IntArg("-n", &arg, &argc, &NumUUIDs, 1, INT32_MAX)) {
+            continue;
+        }
+        if (IntArg("-t", &arg, &argc, &maxThreads, 1, MAX_THREADS)) {
+            continue;
+        }
+        goto Usage;
+    }
+    ret = DPS_InitUUID();
+    ASSERT(ret == DPS_OK);
+    uv_mutex_init(&lock);
+    seeds[0] = 1;
+    seeds[1] = 2;
+    seeds[2] = 3;
+    seeds[3] = 4;
+    uuids = malloc((size_t)maxThreads * NumUUIDs * sizeof(DPS_UUID));
+    ASSERT(uuids);
+
+    for (n = 1; n <= maxThreads; n *= 2) {
+        total = (size_t)n * NumUUIDs;
+        ns = Run(n, DPS_GenerateUUID);
+        /*
+         * Every UUID from every thread must be distinct
+         */
+        qsort(uuids, total, sizeof(DPS_UUID), CompareUUIDs);
+        for (i = 1; i < total; ++i) {
+            ASSERT(DPS_UUIDCompare(&uuids[i - 1], &uuids[i]) != 0);
+        }
+        lockedNs = Run(n, LockedGenerateUUID);
+        DPS_PRINT("%2d threads: %6.1f nsecs per UUID, %6.1f nsecs with a shared locked generator\n", n,
+                  (double)ns / total, (double)lockedNs / total);
+    }
+    free(uuids);
+    DPS_PRINT("Passed\n");
+    return EXIT_SUCCESS;
+
+Usage:
+    DPS_PRINT("Usage %s: [-n <uuids-per-thread>] [-t <max-threads>]\n", argv[0]);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,100 @@
+#!/usr/bin/python
+
+#
+# Runs the benchmark suite (built with scons perf=yes) and writes the
+# results as one JSON object per line. When a baseline file from an
+# earlier run is given the results are compared with it and any metric
+# that is worse by more than the threshold is reported as a regression.
+#
+
+from __future__ import print_function
+import argparse
+import glob
+import json
+import os
+import subprocess
+import sys
+
+BIN = os.path.join('build', 'test', 'perf', 'bin')
+
+# Metrics that are compared with the baseline, True if a higher value is better
+MICRO_METRICS = {'ns_per_op': False}
+MESH_METRICS = {'pubs_per_sec': True, 'latency_p50_us': False, 'latency_p99_us': False, 'convergence_ms': False}
+TRANSPORT_METRICS = {'bytes_per_pub': False, 'convergence_bytes': False}
+
+def _run(cmd):
+    print(' '.join(cmd), file=sys.stderr)
+    out = subprocess.check_output(cmd)
+    if not isinstance(out, str):
+        out = out.decode()
+    return [json.loads(line) for line in out.splitlines() if line.startswith('{')]
+
+def _key(result):
+    if result['suite'] == 'micro':
+        return ('micro', result['name'])
+    return ('mesh', result['mesh'], result['subscribers'], result['pubs'], result['payload'],
+            result['window'], result['seed'])
+
+def _metrics(result):
+    if result['suite'] == 'micro':
+        for name, higher in MICRO_METRICS.items():
+            yield result['name'] + '.' + name, result[name], higher
+    else:
+        for name, higher in MESH_METRICS.items():
+            yield name, result[name], higher
+        for transport in result['transports']:
+            for name, higher in TRANSPORT_METRICS.items():
+                yield transport['name'] + '.' + name, transport[name], higher
+
+def _compare(results, baseline, threshold):
+    base = dict((_key(r), r) for r in baseline)
+    regressions = 0
+    for result in results:
+        prev = base.get(_key(result))
+        if prev is None:
+            continue
+        old = dict((name, value) for name, value, higher in _metrics(prev))
+        for name, value, higher in _metrics(result):
+            if name not in old or old[name] == 0:
+                continue
+            change = 100.0 * (value - old[name]) / old[name]
+            if (change < -threshold) if higher else (change > threshold):
+                print('REGRESSION {} {}: {} -> {} ({:+.1f}%)'.format(' '.join(str(k) for k in _key(result)[1:]),
+                                                                     name, old[name], value, change))
+                regressions += 1
+    return regressions
+
+parser = argparse.ArgumentParser()
+parser.add_argument('-o', '--output', help='File to write the results to')
+parser.add_argument('-b', '--baseline', help='Results of an earlier run to compare with')
+parser.add_argument('-t', '--threshold', type=float, default=10.0,
+                    help='Percentage change that is reported as a regression')
+parser.add_argument('-m', '--meshes', default=os.path.join('test', 'meshes', '*.txt'),
+                    help='Mesh files for the macro-benchmarks')
+parser.add_argument('-n', '--pubs', default='1000', help='Publications per macro-benchmark')
+parser.add_argument('-s', '--subscribers', default='1', help='Subscribers per macro-benchmark')
+parser.add_argument('-S', '--seed', default='1', help='Seed for picking publisher and subscriber nodes')
+parser.add_argument('--micro-only', action='store_true', help='Only run the micro-benchmarks')
+args = parser.parse_args()
+
+results = _run([os.path.join(BIN, 'microbench')])
+if not args.micro_only:
+    for mesh in sorted(glob.glob(args.meshes)):
+        # Skip meshes without enough nodes for the publisher and the subscribers
+        with open(mesh) as f:
+            if len(set(f.read().split())) <= int(args.subscribers):
+                continue
+        results += _run([os.path.join(BIN, 'meshbench'), '-n', args.pubs, '-s', args.subscribers,
+                         '-S', args.seed, mesh])
+
+out = open(args.output, 'w') if args.output else sys.stdout
+for result in results:
+    print(json.dumps(result, sort_keys=True), file=out)
+if args.output:
+    out.close()
+
+if args.baseline:
+    with open(args.baseline) as f:
+        baseline = [json.loads(line) for line in f if line.startswith('{')]
+    if _compare(results, baseline, args.threshold):
+        sys.exit(1)
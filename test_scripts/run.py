@@ -10,7 +10,8 @@ import platform
 import sys
 
 if 'FSAN' not in os.environ or os.environ['FSAN'] == 'no':
-    tests = [os.path.join('build', 'test', 'bin', 'cbortest'),
+    tests = [os.path.join('build', 'test', 'bin', 'bloom_sim'),
+             os.path.join('build', 'test', 'bin', 'cbortest'),
              os.path.join('build', 'test', 'bin', 'cosetest'),
              os.path.join('build', 'test', 'bin', 'countvec'),
              os.path.join('build', 'test', 'bin', 'hist_unit'),
@@ -19,8 +20,13 @@ if 'FSAN' not in os.environ or os.environ['FSAN'] == 'no':
              os.path.join('build', 'test', 'bin', 'packtest'),
              os.path.join('build', 'test', 'bin', 'publish'),
              os.path.join('build', 'test', 'bin', 'pubsub'),
+             os.path.join('build', 'test', 'bin', 'retained_unit'),
+             os.path.join('build', 'test', 'bin', 'topictrie_unit'),
+             os.path.join('build', 'test', 'bin', 'sub_compat'),
              os.path.join('build', 'test', 'bin', 'rle_compression'),
              os.path.join('build', 'test', 'bin', 'keystoretest'),
+             os.path.join('build', 'test', 'bin', 'uuidtest'),
+             os.path.join('build', 'test', 'bin', 'logtest'),
              os.path.join('test_scripts', 'auth.py'),
              os.path.join('test_scripts', 'chain_test.py'),
              os.path.join('test_scripts', 'e2esec.py'),
@@ -50,7 +50,7 @@ expect_error(sub1, 'Expected message version 1, received 2')
 reset_logs()
 
 sub1 = sub('A')
-ver('-v 1 -t 5')
+ver('-v 1 -t 255')
 
 expect_error(sub1, 'Invalid message type')
 
@@ -58,6 +58,6 @@ expect_error(sub1, 'Invalid message type')
 reset_logs()
 
 sub1 = sub('A')
-ver('-p {} -v 1 -t 5'.format(sub1.port))
+ver('-p {} -v 1 -t 255'.format(sub1.port))
 
 expect_error(sub1, 'Invalid message type')